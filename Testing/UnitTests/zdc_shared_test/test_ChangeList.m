@@ -0,0 +1,253 @@
+/**
+ * ZeroDark.cloud
+ * <GitHub wiki link goes here>
+**/
+
+#import <XCTest/XCTest.h>
+
+#import "ZDCChangeList.h"
+#import "ZDCChangeItem.h"
+#import "ZDCCloudPath.h"
+#import "ZDCNode.h"
+
+@interface test_ChangeList : XCTestCase
+@end
+
+static NSString *const treeID = @"com.4th-a.test";
+
+@implementation test_ChangeList {
+
+	NSUInteger nextChangeID;
+}
+
+- (void)setUp
+{
+	[super setUp];
+	nextChangeID = 1;
+}
+
+- (NSString *)pathInDir:(NSString *)dirPrefix
+{
+	ZDCCloudPath *cloudPath =
+	  [[ZDCCloudPath alloc] initWithTreeID: treeID
+	                             dirPrefix: dirPrefix
+	                              fileName: [ZDCNode randomCloudName]];
+	
+	return [cloudPath pathWithExt:@"rcrd"];
+}
+
+- (ZDCChangeItem *)change:(NSString *)command path:(NSString *)path
+{
+	NSString *changeID = [NSString stringWithFormat:@"%lu", (unsigned long)nextChangeID++];
+	NSString *fileID = [[NSUUID UUID] UUIDString];
+	
+	NSDictionary *dict = @{
+		@"id"      : changeID,
+		@"command" : command,
+		@"path"    : path,
+		@"fileID"  : fileID,
+		@"eTag"    : [NSString stringWithFormat:@"etag-%@", changeID]
+	};
+	
+	ZDCChangeItem *change = [ZDCChangeItem parseChangeInfo:dict];
+	XCTAssert(change != nil);
+	
+	return change;
+}
+
+- (ZDCChangeList *)changeListWithChanges:(NSArray<ZDCChangeItem *> *)changes
+{
+	ZDCChangeList *changeList = [[ZDCChangeList alloc] initWithLatestChangeID_remote:@"0"];
+	[changeList didCompleteFullPull];
+	[changeList didFetchChanges:changes since:@"0" latest:[changes lastObject].uuid];
+	
+	XCTAssert(changeList.hasPendingChange);
+	return changeList;
+}
+
+- (NSArray<NSString *> *)pop:(ZDCChangeList *)changeList inFlight:(NSArray<ZDCChangeItem *> *)inFlight
+{
+	NSMutableSet<NSString *> *inFlightChangeIDs = [NSMutableSet set];
+	for (ZDCChangeItem *change in inFlight) {
+		[inFlightChangeIDs addObject:change.uuid];
+	}
+	
+	NSArray<NSOrderedSet<NSString *> *> *changeIDs = nil;
+	NSArray<ZDCChangeItem *> *changes =
+	  [changeList popIndependentPendingChanges: 100
+	                         inFlightChangeIDs: inFlightChangeIDs
+	                                 changeIDs: &changeIDs];
+	
+	XCTAssert(changes.count == changeIDs.count);
+	
+	NSMutableArray<NSString *> *result = [NSMutableArray arrayWithCapacity:changes.count];
+	for (ZDCChangeItem *change in changes) {
+		[result addObject:change.uuid];
+	}
+	return result;
+}
+
+- (void)process:(NSArray<ZDCChangeItem *> *)changes in:(ZDCChangeList *)changeList
+{
+	NSMutableSet<NSString *> *changeIDs = [NSMutableSet set];
+	for (ZDCChangeItem *change in changes) {
+		[changeIDs addObject:change.uuid];
+	}
+	
+	[changeList didProcessChangeIDs:changeIDs];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark put-if-nonexistent
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)test_putIfNonexistent_siblings
+{
+	// New nodes within the same directory can be pulled concurrently.
+	
+	NSString *dirA = [ZDCNode randomDirPrefix];
+	
+	ZDCChangeItem *a1 = [self change:@"put-if-nonexistent" path:[self pathInDir:dirA]];
+	ZDCChangeItem *a2 = [self change:@"put-if-nonexistent" path:[self pathInDir:dirA]];
+	ZDCChangeItem *a3 = [self change:@"put-if-nonexistent" path:[self pathInDir:dirA]];
+	
+	ZDCChangeList *changeList = [self changeListWithChanges:@[ a1, a2, a3 ]];
+	
+	NSArray *popped = [self pop:changeList inFlight:nil];
+	XCTAssert([popped isEqualToArray:(@[ a1.uuid, a2.uuid, a3.uuid ])]);
+}
+
+- (void)test_putIfNonexistent_differentDirPrefix
+{
+	// A put-if-nonexistent in a different directory may be a child of an earlier put-if-nonexistent.
+	// So it has to wait, and everything after it has to wait too.
+	
+	NSString *dirA = [ZDCNode randomDirPrefix];
+	NSString *dirB = [ZDCNode randomDirPrefix];
+	
+	ZDCChangeItem *a1 = [self change:@"put-if-nonexistent" path:[self pathInDir:dirA]];
+	ZDCChangeItem *a2 = [self change:@"put-if-nonexistent" path:[self pathInDir:dirA]];
+	ZDCChangeItem *b1 = [self change:@"put-if-nonexistent" path:[self pathInDir:dirB]];
+	ZDCChangeItem *a3 = [self change:@"put-if-nonexistent" path:[self pathInDir:dirA]];
+	
+	ZDCChangeList *changeList = [self changeListWithChanges:@[ a1, a2, b1, a3 ]];
+	
+	NSArray *popped = [self pop:changeList inFlight:nil];
+	XCTAssert([popped isEqualToArray:(@[ a1.uuid, a2.uuid ])]);
+	
+	// An in-flight put-if-nonexistent still allows its siblings to start
+	
+	popped = [self pop:changeList inFlight:@[ a1 ]];
+	XCTAssert([popped isEqualToArray:(@[ a2.uuid ])]);
+	
+	// While a1 & a2 are in-flight, nothing else can start
+	
+	popped = [self pop:changeList inFlight:@[ a1, a2 ]];
+	XCTAssert(popped.count == 0);
+	
+	[self process:@[ a1, a2 ] in:changeList];
+	
+	// b1 blocks a3, since a3 may depend on b1 (and vice versa)
+	
+	popped = [self pop:changeList inFlight:nil];
+	XCTAssert([popped isEqualToArray:(@[ b1.uuid ])]);
+	
+	[self process:@[ b1 ] in:changeList];
+	
+	popped = [self pop:changeList inFlight:nil];
+	XCTAssert([popped isEqualToArray:(@[ a3.uuid ])]);
+}
+
+- (void)test_putIfNonexistent_putIfMatch
+{
+	// The dirPrefix rule only applies to put-if-nonexistent.
+	// Modifications to existing nodes can run alongside new nodes in another directory.
+	
+	NSString *dirA = [ZDCNode randomDirPrefix];
+	NSString *dirB = [ZDCNode randomDirPrefix];
+	
+	ZDCChangeItem *a1 = [self change:@"put-if-nonexistent" path:[self pathInDir:dirA]];
+	ZDCChangeItem *b1 = [self change:@"put-if-match"       path:[self pathInDir:dirB]];
+	ZDCChangeItem *a2 = [self change:@"put-if-nonexistent" path:[self pathInDir:dirA]];
+	
+	ZDCChangeList *changeList = [self changeListWithChanges:@[ a1, b1, a2 ]];
+	
+	NSArray *popped = [self pop:changeList inFlight:nil];
+	XCTAssert([popped isEqualToArray:(@[ a1.uuid, b1.uuid, a2.uuid ])]);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Barriers
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A barrier waits for everything before it, and everything after it waits for the barrier.
+ */
+- (void)_testBarrier:(NSString *)command
+{
+	NSString *dirA = [ZDCNode randomDirPrefix];
+	NSString *dirB = [ZDCNode randomDirPrefix];
+	
+	ZDCChangeItem *p1      = [self change:@"put-if-match" path:[self pathInDir:dirA]];
+	ZDCChangeItem *barrier = [self change:command         path:[self pathInDir:dirB]];
+	ZDCChangeItem *p2      = [self change:@"put-if-match" path:[self pathInDir:dirA]];
+	
+	ZDCChangeList *changeList = [self changeListWithChanges:@[ p1, barrier, p2 ]];
+	
+	NSArray *popped = [self pop:changeList inFlight:nil];
+	XCTAssert([popped isEqualToArray:(@[ p1.uuid ])], @"command: %@", command);
+	
+	// The barrier can't start while anything is in-flight
+	
+	popped = [self pop:changeList inFlight:@[ p1 ]];
+	XCTAssert(popped.count == 0, @"command: %@", command);
+	
+	[self process:@[ p1 ] in:changeList];
+	
+	// The barrier runs alone
+	
+	popped = [self pop:changeList inFlight:nil];
+	XCTAssert([popped isEqualToArray:(@[ barrier.uuid ])], @"command: %@", command);
+	
+	// Nothing can start while the barrier is in-flight
+	
+	popped = [self pop:changeList inFlight:@[ barrier ]];
+	XCTAssert(popped.count == 0, @"command: %@", command);
+	
+	[self process:@[ barrier ] in:changeList];
+	
+	popped = [self pop:changeList inFlight:nil];
+	XCTAssert([popped isEqualToArray:(@[ p2.uuid ])], @"command: %@", command);
+}
+
+- (void)test_barrier_move
+{
+	[self _testBarrier:@"move"];
+}
+
+- (void)test_barrier_deleteNode
+{
+	[self _testBarrier:@"delete-node"];
+}
+
+- (void)test_barrier_unknown
+{
+	[self _testBarrier:@"some-future-command"];
+}
+
+- (void)test_deleteLeaf_notBarrier
+{
+	NSString *dirA = [ZDCNode randomDirPrefix];
+	NSString *dirB = [ZDCNode randomDirPrefix];
+	
+	ZDCChangeItem *p1 = [self change:@"put-if-match" path:[self pathInDir:dirA]];
+	ZDCChangeItem *d1 = [self change:@"delete-leaf"  path:[self pathInDir:dirB]];
+	ZDCChangeItem *p2 = [self change:@"put-if-match" path:[self pathInDir:dirA]];
+	
+	ZDCChangeList *changeList = [self changeListWithChanges:@[ p1, d1, p2 ]];
+	
+	NSArray *popped = [self pop:changeList inFlight:nil];
+	XCTAssert([popped isEqualToArray:(@[ p1.uuid, d1.uuid, p2.uuid ])]);
+}
+
+@end
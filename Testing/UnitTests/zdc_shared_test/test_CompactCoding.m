@@ -0,0 +1,293 @@
+/**
+ * ZeroDark.cloud
+ * <GitHub wiki link goes here>
+**/
+
+#import <XCTest/XCTest.h>
+
+#import "ZDCCompactCoding.h"
+#import "ZDCNodePrivate.h"
+#import "ZDCNodeAggregates.h"
+#import "ZDCShareList.h"
+#import "ZDCShareItem.h"
+#import "ZDCTrunkNodePrivate.h"
+#import "ZDCUserPrivate.h"
+
+@interface test_CompactCoding : XCTestCase
+@end
+
+static NSString *const localUserID = @"z55tqmfr9kix1p1gntotqpwkacpuoyno";
+static NSString *const otherUserID = @"ncn3tcwifzxzohnt1id6cbdyq5739d44";
+
+@implementation test_CompactCoding
+
+- (ZDCNode *)sampleNode
+{
+	ZDCNode *node = [[ZDCNode alloc] initWithLocalUserID:localUserID];
+	
+	node.parentID = [[NSUUID UUID] UUIDString];
+	node.name = @"Photos – März 2019.jpg"; // non-ascii
+	node.burnDate = [NSDate dateWithTimeIntervalSinceNow:3600];
+	
+	node.senderID = otherUserID;
+	node.pendingRecipients = [NSSet setWithObjects:localUserID, otherUserID, nil];
+	
+	node.cloudID = @"t8ufp3ku8cnwg6oefk8ez6ye63k1p7ty";
+	node.eTag_rcrd = @"\"5bd95b06d6a0b8e1e5f0c7c2a1b2c3d4\"";
+	node.eTag_data = @"\"4c5d6e7f8a9b0c1d2e3f4a5b6c7d8e9f\"";
+	node.lastModified_rcrd = [NSDate dateWithTimeIntervalSinceReferenceDate:580000000.125];
+	node.lastModified_data = [NSDate dateWithTimeIntervalSinceReferenceDate:580000001.5];
+	
+	ZDCCloudFileHeader header;
+	bzero(&header, sizeof(header));
+	header.metadataSize = 123;
+	header.thumbnailSize = 4567;
+	header.dataSize = 8901234567;
+	header.thumbnailxxHash64 = UINT64_MAX;
+	
+	node.cloudDataInfo =
+	  [[ZDCCloudDataInfo alloc] initWithCloudFileHeader: header
+	                                               eTag: node.eTag_data
+	                                       lastModified: node.lastModified_data];
+	
+	node.explicitCloudName = @"abc123";
+	node.anchor = [[ZDCNodeAnchor alloc] initWithUserID:otherUserID treeID:@"com.4th-a.test" dirPrefix:@"0123abcd"];
+	
+	ZDCShareItem *item = [[ZDCShareItem alloc] init];
+	[item addPermission:ZDCSharePermission_Read];
+	[item addPermission:ZDCSharePermission_Write];
+	item.key = [NSData dataWithBytes:"key" length:3];
+	item.canAddKey = YES;
+	
+	[node.shareList addShareItem:item forUserID:otherUserID];
+	
+	return node;
+}
+
+- (void)test_node
+{
+	ZDCNode *node = [self sampleNode];
+	
+	NSData *data = [ZDCCompactSerialization dataWithObject:node];
+	XCTAssert(data != nil);
+	XCTAssert([ZDCCompactSerialization isCompactData:data]);
+	
+	ZDCNode *decoded = [ZDCCompactSerialization objectWithData:data];
+	XCTAssert([decoded isMemberOfClass:[ZDCNode class]]);
+	
+	XCTAssert([decoded.uuid isEqualToString:node.uuid]);
+	XCTAssert([decoded.localUserID isEqualToString:node.localUserID]);
+	XCTAssert([decoded.parentID isEqualToString:node.parentID]);
+	XCTAssert([decoded.name isEqualToString:node.name]);
+	XCTAssert([decoded.burnDate isEqualToDate:node.burnDate]);
+	
+	XCTAssert([decoded.senderID isEqualToString:node.senderID]);
+	XCTAssert([decoded.pendingRecipients isEqualToSet:node.pendingRecipients]);
+	
+	XCTAssert([decoded.encryptionKey isEqualToData:node.encryptionKey]);
+	XCTAssert([decoded.dirSalt isEqualToData:node.dirSalt]);
+	XCTAssert([decoded.dirPrefix isEqualToString:node.dirPrefix]);
+	
+	XCTAssert([decoded.cloudID isEqualToString:node.cloudID]);
+	XCTAssert([decoded.eTag_rcrd isEqualToString:node.eTag_rcrd]);
+	XCTAssert([decoded.eTag_data isEqualToString:node.eTag_data]);
+	XCTAssert([decoded.lastModified_rcrd isEqualToDate:node.lastModified_rcrd]);
+	XCTAssert([decoded.lastModified_data isEqualToDate:node.lastModified_data]);
+	XCTAssert([decoded.explicitCloudName isEqualToString:node.explicitCloudName]);
+	XCTAssert(decoded.pointeeID == nil);
+	
+	XCTAssert(decoded.cloudDataInfo.metadataSize == node.cloudDataInfo.metadataSize);
+	XCTAssert(decoded.cloudDataInfo.thumbnailSize == node.cloudDataInfo.thumbnailSize);
+	XCTAssert(decoded.cloudDataInfo.dataSize == node.cloudDataInfo.dataSize);
+	XCTAssert(decoded.cloudDataInfo.thumbnailxxHash64 == node.cloudDataInfo.thumbnailxxHash64);
+	XCTAssert([decoded.cloudDataInfo.eTag isEqualToString:node.cloudDataInfo.eTag]);
+	
+	XCTAssert([decoded.anchor.userID isEqualToString:node.anchor.userID]);
+	XCTAssert([decoded.anchor.treeID isEqualToString:node.anchor.treeID]);
+	XCTAssert([decoded.anchor.dirPrefix isEqualToString:node.anchor.dirPrefix]);
+	
+	XCTAssert([decoded.shareList isEqualToShareList:node.shareList]);
+	XCTAssert([decoded.shareList hasChanges] == NO);
+	
+	ZDCShareItem *item = [decoded.shareList shareItemForUserID:otherUserID];
+	XCTAssert([item hasPermission:ZDCSharePermission_Read]);
+	XCTAssert([item hasPermission:ZDCSharePermission_Write]);
+	XCTAssert([item hasPermission:ZDCSharePermission_Share] == NO);
+	XCTAssert([item.key isEqualToData:[NSData dataWithBytes:"key" length:3]]);
+	XCTAssert(item.canAddKey);
+}
+
+- (void)test_user
+{
+	ZDCUser *user = [[ZDCUser alloc] initWithUUID:otherUserID];
+	user.publicKeyID = @"yKqYwSgs/gkQ4RMYl0OpaQ==";
+	user.aws_region = AWSRegion_US_West_2;
+	user.aws_bucket = @"com.4th-a.user.ncn3tcwifzxzohnt1id6cbdyq5739d44-35a6b2bc";
+	user.accountBlocked = YES;
+	user.lastRefresh_profile = [NSDate dateWithTimeIntervalSinceReferenceDate:580000000];
+	
+	NSData *data = [ZDCCompactSerialization dataWithObject:user];
+	XCTAssert(data != nil);
+	
+	ZDCUser *decoded = [ZDCCompactSerialization objectWithData:data];
+	XCTAssert([decoded isMemberOfClass:[ZDCUser class]]);
+	
+	XCTAssert([decoded.uuid isEqualToString:user.uuid]);
+	XCTAssert([decoded.publicKeyID isEqualToString:user.publicKeyID]);
+	XCTAssert([decoded.random_uuid isEqualToString:user.random_uuid]);
+	XCTAssert([decoded.random_encryptionKey isEqualToData:user.random_encryptionKey]);
+	XCTAssert(decoded.aws_region == AWSRegion_US_West_2);
+	XCTAssert([decoded.aws_bucket isEqualToString:user.aws_bucket]);
+	XCTAssert(decoded.accountBlocked == YES);
+	XCTAssert(decoded.accountDeleted == NO);
+	XCTAssert([decoded.lastRefresh_profile isEqualToDate:user.lastRefresh_profile]);
+	XCTAssert([decoded.lastRefresh_blockchain isEqualToDate:user.lastRefresh_blockchain]);
+	XCTAssert(decoded.identities.count == user.identities.count);
+	
+	// Missing region must decode as invalid (not as the first enum value)
+	
+	ZDCUser *user2 = [[ZDCUser alloc] initWithUUID:localUserID];
+	ZDCUser *decoded2 = [ZDCCompactSerialization objectWithData:[ZDCCompactSerialization dataWithObject:user2]];
+	
+	XCTAssert(decoded2.aws_region == AWSRegion_Invalid);
+}
+
+- (void)test_aggregates
+{
+	ZDCNodeAggregates *aggregates =
+	  [[ZDCNodeAggregates alloc] initWithParentID: @"abc123"
+	                                     dataSize: 1024
+	                           pendingUploadCount: 0
+	                              descendantCount: 3
+	                           descendantDataSize: 4096
+	                 descendantPendingUploadCount: 2];
+	
+	ZDCNodeAggregates *decoded =
+	  [ZDCCompactSerialization objectWithData:[ZDCCompactSerialization dataWithObject:aggregates]];
+	
+	XCTAssert([decoded.parentID isEqualToString:@"abc123"]);
+	XCTAssert(decoded.dataSize == 1024);
+	XCTAssert(decoded.pendingUploadCount == 0);
+	XCTAssert(decoded.descendantCount == 3);
+	XCTAssert(decoded.descendantDataSize == 4096);
+	XCTAssert(decoded.descendantPendingUploadCount == 2);
+}
+
+- (void)test_fallback
+{
+	// Subclasses aren't supported (they use NSKeyedArchiver)
+	
+	ZDCTrunkNode *trunkNode =
+	  [[ZDCTrunkNode alloc] initWithLocalUserID: localUserID
+	                                     treeID: @"com.4th-a.test"
+	                                      trunk: ZDCTreesystemTrunk_Home];
+	
+	XCTAssert([ZDCCompactSerialization dataWithObject:trunkNode] == nil);
+	XCTAssert([ZDCCompactSerialization dataWithObject:@"string"] == nil);
+	
+	// Archives are never mistaken for compact data
+	
+	NSData *archive = [NSKeyedArchiver archivedDataWithRootObject:[self sampleNode]];
+	XCTAssert([ZDCCompactSerialization isCompactData:archive] == NO);
+}
+
+- (void)test_malformed
+{
+	NSData *data = [ZDCCompactSerialization dataWithObject:[self sampleNode]];
+	
+	// Truncated data must fail cleanly (rather than returning a partially decoded object)
+	
+	for (NSUInteger length = 4; length < data.length; length += 7)
+	{
+		NSData *truncated = [data subdataWithRange:NSMakeRange(0, length)];
+		
+		id decoded = [ZDCCompactSerialization objectWithData:truncated];
+		if (decoded)
+		{
+			// Only possible if the cut happens to land exactly on a field boundary
+			XCTAssert([decoded isKindOfClass:[ZDCNode class]]);
+		}
+	}
+	
+	// Unknown format version
+	
+	NSMutableData *future = [data mutableCopy];
+	((uint8_t *)future.mutableBytes)[3] = 0xEE;
+	
+	XCTAssert([ZDCCompactSerialization objectWithData:future] == nil);
+}
+
+/**
+ * Compares encode/decode throughput & size against NSKeyedArchiver,
+ * for a typical set of nodes (as stored in the database).
+ */
+- (void)test_benchmark
+{
+	NSUInteger const count = 10000;
+	
+	NSMutableArray<ZDCNode*> *nodes = [NSMutableArray arrayWithCapacity:count];
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		ZDCNode *node = [self sampleNode];
+		node.name = [NSString stringWithFormat:@"file-%lu.dat", (unsigned long)i];
+		
+		[nodes addObject:node];
+	}
+	
+	__block NSUInteger compactBytes = 0;
+	__block NSUInteger archiveBytes = 0;
+	
+	__block CFAbsoluteTime compactEncodeTime = 0;
+	__block CFAbsoluteTime compactDecodeTime = 0;
+	__block CFAbsoluteTime archiveEncodeTime = 0;
+	__block CFAbsoluteTime archiveDecodeTime = 0;
+	
+	[self measureBlock:^{
+	
+		NSMutableArray<NSData*> *compact = [NSMutableArray arrayWithCapacity:count];
+		NSMutableArray<NSData*> *archives = [NSMutableArray arrayWithCapacity:count];
+		
+		CFAbsoluteTime t0 = CFAbsoluteTimeGetCurrent();
+		for (ZDCNode *node in nodes) {
+			[compact addObject:[ZDCCompactSerialization dataWithObject:node]];
+		}
+		
+		CFAbsoluteTime t1 = CFAbsoluteTimeGetCurrent();
+		for (NSData *data in compact) {
+			(void)[ZDCCompactSerialization objectWithData:data];
+		}
+		
+		CFAbsoluteTime t2 = CFAbsoluteTimeGetCurrent();
+		for (ZDCNode *node in nodes) {
+			[archives addObject:[NSKeyedArchiver archivedDataWithRootObject:node]];
+		}
+		
+		CFAbsoluteTime t3 = CFAbsoluteTimeGetCurrent();
+		for (NSData *data in archives) {
+			(void)[NSKeyedUnarchiver unarchiveObjectWithData:data];
+		}
+		
+		CFAbsoluteTime t4 = CFAbsoluteTimeGetCurrent();
+		
+		compactEncodeTime = t1 - t0;
+		compactDecodeTime = t2 - t1;
+		archiveEncodeTime = t3 - t2;
+		archiveDecodeTime = t4 - t3;
+		
+		compactBytes = 0;
+		archiveBytes = 0;
+		for (NSData *data in compact)  { compactBytes += data.length; }
+		for (NSData *data in archives) { archiveBytes += data.length; }
+	}];
+	
+	XCTAssert(compactBytes < archiveBytes);
+	
+	NSLog(@"Compact        : encode %.0f nodes/sec, decode %.0f nodes/sec, %lu bytes/node",
+	      (double)count / compactEncodeTime, (double)count / compactDecodeTime,
+	      (unsigned long)(compactBytes / count));
+	NSLog(@"NSKeyedArchiver: encode %.0f nodes/sec, decode %.0f nodes/sec, %lu bytes/node",
+	      (double)count / archiveEncodeTime, (double)count / archiveDecodeTime,
+	      (unsigned long)(archiveBytes / count));
+}
+
+@end
@@ -0,0 +1,290 @@
+/**
+ * ZeroDark.cloud
+ * <GitHub wiki link goes here>
+**/
+
+#import <XCTest/XCTest.h>
+
+#import <ZeroDarkCloud/ZeroDarkCloud.h>
+#import <ZeroDarkCloud/ZDCFrequencySketch.h>
+
+/**
+ * Replays an access trace against a cache of fixed capacity (in items),
+ * using the same trimming algorithm as the DiskManager's cache pools.
+ */
+@interface ZDCCachePolicySimulator : NSObject
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity policy:(ZDCDiskCachePolicy)policy;
+
+@property (nonatomic, readonly) NSUInteger hits;
+@property (nonatomic, readonly) NSUInteger misses;
+@property (nonatomic, readonly) double hitRate;
+
+- (void)accessKey:(NSString *)key;
+
+@end
+
+@implementation ZDCCachePolicySimulator {
+
+	NSUInteger capacity;
+	ZDCDiskCachePolicy policy;
+	
+	NSMutableOrderedSet<NSString *> *window;     // least recent first
+	NSMutableOrderedSet<NSString *> *mainRegion; // least recent first
+	ZDCFrequencySketch *sketch;
+}
+
+@synthesize hits = hits;
+@synthesize misses = misses;
+
+- (instancetype)initWithCapacity:(NSUInteger)inCapacity policy:(ZDCDiskCachePolicy)inPolicy
+{
+	if ((self = [super init]))
+	{
+		capacity = inCapacity;
+		policy = inPolicy;
+		
+		window = [[NSMutableOrderedSet alloc] init];
+		mainRegion = [[NSMutableOrderedSet alloc] init];
+		sketch = [[ZDCFrequencySketch alloc] initWithCapacity:inCapacity];
+	}
+	return self;
+}
+
+- (double)hitRate
+{
+	NSUInteger total = hits + misses;
+	return (total > 0) ? ((double)hits / (double)total) : 0.0;
+}
+
+- (void)accessKey:(NSString *)key
+{
+	[sketch incrementKey:key];
+	
+	if ([window containsObject:key])
+	{
+		[window removeObject:key];
+		[window addObject:key];
+		hits++;
+		return;
+	}
+	if ([mainRegion containsObject:key])
+	{
+		[mainRegion removeObject:key];
+		[mainRegion addObject:key];
+		hits++;
+		return;
+	}
+	
+	misses++;
+	
+	if (policy == ZDCDiskCachePolicy_TinyLFU)
+		[window addObject:key];
+	else
+		[mainRegion addObject:key];
+	
+	[self trim];
+}
+
+- (void)trim
+{
+	NSMutableArray<NSString *> *candidates = [NSMutableArray array];
+	
+	if (policy == ZDCDiskCachePolicy_TinyLFU)
+	{
+		NSUInteger windowCapacity = MAX(1, capacity / 10);
+		
+		while (window.count > windowCapacity)
+		{
+			NSString *key = window.firstObject;
+			[window removeObjectAtIndex:0];
+			
+			[mainRegion addObject:key];
+			[candidates addObject:key];
+		}
+	}
+	
+	NSUInteger candidateIndex = 0;
+	
+	while ((window.count + mainRegion.count) > capacity)
+	{
+		NSString *victim = mainRegion.firstObject ?: window.firstObject;
+		
+		NSString *candidate = nil;
+		while (candidateIndex < candidates.count)
+		{
+			NSString *key = candidates[candidateIndex];
+			if ([mainRegion containsObject:key])
+			{
+				candidate = key;
+				break;
+			}
+			
+			candidateIndex++;
+		}
+		
+		NSString *evict = victim;
+		if (candidate && ![candidate isEqualToString:victim])
+		{
+			if (![sketch shouldAdmitKey:candidate overKey:victim])
+			{
+				evict = candidate;
+				candidateIndex++;
+			}
+		}
+		
+		[mainRegion removeObject:evict];
+		[window removeObject:evict];
+	}
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface test_DiskCachePolicy : XCTestCase
+@end
+
+@implementation test_DiskCachePolicy
+
+/**
+ * Deterministic PRNG (xorshift64*), so every run replays the same trace.
+ */
+static uint64_t NextRandom(uint64_t *state)
+{
+	uint64_t x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+ * Generates a trace of accesses to a working set of items, with a Zipf-like popularity distribution.
+ * Every `scanInterval` accesses, a scan of `scanLength` one-off items is inserted.
+ * (e.g. the user scrolls through a large photo library, or exports a folder)
+ */
+- (NSArray<NSString *> *)traceWithWorkingSetSize:(NSUInteger)workingSetSize
+                                            skew:(double)skew
+                                          length:(NSUInteger)length
+                                    scanInterval:(NSUInteger)scanInterval
+                                      scanLength:(NSUInteger)scanLength
+{
+	double *cdf = malloc(sizeof(double) * workingSetSize);
+	double sum = 0;
+	for (NSUInteger i = 0; i < workingSetSize; i++)
+	{
+		sum += 1.0 / pow((double)(i + 1), skew);
+		cdf[i] = sum;
+	}
+	
+	uint64_t state = 0x9E3779B97F4A7C15ULL;
+	NSUInteger scanCounter = 0;
+	
+	NSMutableArray<NSString *> *trace = [NSMutableArray arrayWithCapacity:length];
+	while (trace.count < length)
+	{
+		if (scanInterval > 0 && trace.count > 0 && (trace.count % scanInterval) == 0)
+		{
+			for (NSUInteger i = 0; i < scanLength; i++)
+			{
+				[trace addObject:[NSString stringWithFormat:@"scan-%lu", (unsigned long)scanCounter++]];
+			}
+		}
+		
+		double r = ((double)(NextRandom(&state) >> 11) / (double)(1ULL << 53)) * sum;
+		
+		NSUInteger lo = 0;
+		NSUInteger hi = workingSetSize - 1;
+		while (lo < hi)
+		{
+			NSUInteger mid = (lo + hi) / 2;
+			if (cdf[mid] < r)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		
+		[trace addObject:[NSString stringWithFormat:@"item-%lu", (unsigned long)lo]];
+	}
+	
+	free(cdf);
+	return trace;
+}
+
+- (double)replayTrace:(NSArray<NSString *> *)trace
+         withCapacity:(NSUInteger)capacity
+               policy:(ZDCDiskCachePolicy)policy
+{
+	ZDCCachePolicySimulator *cache = [[ZDCCachePolicySimulator alloc] initWithCapacity:capacity policy:policy];
+	
+	for (NSString *key in trace)
+	{
+		[cache accessKey:key];
+	}
+	
+	return cache.hitRate;
+}
+
+- (void)test_scanResistance
+{
+	NSArray<NSString *> *trace =
+	  [self traceWithWorkingSetSize: 2000
+	                           skew: 0.9
+	                         length: 100000
+	                   scanInterval: 2000
+	                     scanLength: 1000];
+	
+	NSUInteger capacity = 250;
+	
+	double lru = [self replayTrace:trace withCapacity:capacity policy:ZDCDiskCachePolicy_LRU];
+	double tinyLFU = [self replayTrace:trace withCapacity:capacity policy:ZDCDiskCachePolicy_TinyLFU];
+	
+	NSLog(@"Zipf + scans: hit rate: LRU(%.2f%%) TinyLFU(%.2f%%)", lru * 100, tinyLFU * 100);
+	
+	XCTAssert(tinyLFU > lru, @"TinyLFU should out-perform LRU on a trace with scans");
+}
+
+- (void)test_noScans
+{
+	NSArray<NSString *> *trace =
+	  [self traceWithWorkingSetSize: 2000
+	                           skew: 0.9
+	                         length: 100000
+	                   scanInterval: 0
+	                     scanLength: 0];
+	
+	NSUInteger capacity = 250;
+	
+	double lru = [self replayTrace:trace withCapacity:capacity policy:ZDCDiskCachePolicy_LRU];
+	double tinyLFU = [self replayTrace:trace withCapacity:capacity policy:ZDCDiskCachePolicy_TinyLFU];
+	
+	NSLog(@"Zipf: hit rate: LRU(%.2f%%) TinyLFU(%.2f%%)", lru * 100, tinyLFU * 100);
+	
+	XCTAssert(tinyLFU >= lru, @"TinyLFU should not under-perform LRU on a skewed trace");
+}
+
+- (void)test_sketchPerformance
+{
+	NSMutableArray<NSString *> *keys = [NSMutableArray arrayWithCapacity:10000];
+	for (NSUInteger i = 0; i < 10000; i++)
+	{
+		[keys addObject:[[NSUUID UUID] UUIDString]];
+	}
+	
+	ZDCFrequencySketch *sketch = [[ZDCFrequencySketch alloc] initWithCapacity:keys.count];
+	
+	[self measureBlock:^{
+	
+		for (NSString *key in keys)
+		{
+			[sketch incrementKey:key];
+			[sketch frequencyForKey:key];
+		}
+	}];
+}
+
+@end
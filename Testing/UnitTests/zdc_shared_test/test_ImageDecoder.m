@@ -0,0 +1,311 @@
+/**
+ * ZeroDark.cloud
+ * <GitHub wiki link goes here>
+**/
+
+#import <XCTest/XCTest.h>
+
+#import <ZeroDarkCloud/ZeroDarkCloud.h>
+#import <ZeroDarkCloud/ZDCImageDecoder.h>
+
+#import "ZDCImageManagerPrivate.h"
+
+#import <ImageIO/ImageIO.h>
+
+/**
+ * Stands in for the DownloadManager: every thumbnail "download" returns the same image data.
+ */
+@interface TestThumbnailDownloader : NSObject
+
+@property (nonatomic, strong, readwrite) NSData *thumbnailData;
+
+@end
+
+@implementation TestThumbnailDownloader
+
+- (ZDCDownloadTicket *)downloadNodeMeta:(ZDCNode *)node
+                             components:(ZDCNodeMetaComponents)components
+                                options:(ZDCDownloadOptions *)options
+                        completionQueue:(dispatch_queue_t)completionQueue
+                        completionBlock:(NodeMetaDownloadCompletionBlock)completionBlock
+{
+	NSData *thumbnail = self.thumbnailData;
+	
+	dispatch_async(completionQueue ?: dispatch_get_main_queue(), ^{
+		completionBlock(nil, nil, thumbnail, nil);
+	});
+	
+	return nil;
+}
+
+@end
+
+/**
+ * Stands in for the ZeroDarkCloud instance that owns the ImageManager.
+ * There's no DiskManager (so every cache miss is a download), and no database.
+ */
+@interface TestImageManagerOwner : NSObject
+
+@property (nonatomic, strong, readwrite) TestThumbnailDownloader *downloadManager;
+@property (nonatomic, strong, readwrite) id diskManager;
+@property (nonatomic, strong, readwrite) id databaseManager;
+
+@end
+
+@implementation TestImageManagerOwner
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface test_ImageDecoder : XCTestCase
+@end
+
+@implementation test_ImageDecoder
+
+/**
+ * Generates a PNG with a gradient (so the encoder can't compress it down to nothing).
+ */
+- (NSData *)pngDataWithWidth:(size_t)width height:(size_t)height seed:(uint8_t)seed
+{
+	CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+	CGContextRef context =
+	  CGBitmapContextCreate(NULL, width, height, 8, 0, colorSpace, kCGImageAlphaPremultipliedLast);
+	
+	uint8_t *pixels = CGBitmapContextGetData(context);
+	size_t bytesPerRow = CGBitmapContextGetBytesPerRow(context);
+	
+	for (size_t y = 0; y < height; y++)
+	{
+		uint8_t *row = pixels + (y * bytesPerRow);
+		for (size_t x = 0; x < width; x++)
+		{
+			row[(x * 4) + 0] = (uint8_t)(x + seed);
+			row[(x * 4) + 1] = (uint8_t)(y + seed);
+			row[(x * 4) + 2] = (uint8_t)(x ^ y);
+			row[(x * 4) + 3] = 0xFF;
+		}
+	}
+	
+	CGImageRef cgImage = CGBitmapContextCreateImage(context);
+	
+	NSMutableData *data = [NSMutableData data];
+	CGImageDestinationRef destination =
+	  CGImageDestinationCreateWithData((__bridge CFMutableDataRef)data, CFSTR("public.png"), 1, NULL);
+	
+	CGImageDestinationAddImage(destination, cgImage, NULL);
+	CGImageDestinationFinalize(destination);
+	
+	CFRelease(destination);
+	CGImageRelease(cgImage);
+	CGContextRelease(context);
+	CGColorSpaceRelease(colorSpace);
+	
+	return data;
+}
+
+- (void)test_downsample
+{
+	NSData *data = [self pngDataWithWidth:1200 height:800 seed:0];
+	
+	OSImage *full = [ZDCImageDecoder decodeImageData:data maxPixelSize:0];
+	XCTAssertNotNil(full);
+	XCTAssert(CGImageGetWidth([full CGImage]) == 1200);
+	XCTAssert(CGImageGetHeight([full CGImage]) == 800);
+	
+	OSImage *small = [ZDCImageDecoder decodeImageData:data maxPixelSize:120];
+	XCTAssertNotNil(small);
+	XCTAssert(CGImageGetWidth([small CGImage]) <= 120);
+	XCTAssert(CGImageGetHeight([small CGImage]) <= 120);
+	
+	NSUInteger fullCost = [ZDCImageDecoder decodedByteCountForImage:full];
+	NSUInteger smallCost = [ZDCImageDecoder decodedByteCountForImage:small];
+	
+	XCTAssert(fullCost == CGImageGetBytesPerRow([full CGImage]) * CGImageGetHeight([full CGImage]));
+	XCTAssert(fullCost >= (1200 * 800 * 4));
+	XCTAssert(smallCost < (fullCost / 50));
+	
+	XCTAssertNil([ZDCImageDecoder decodeImageData:[NSData dataWithBytes:"junk" length:4] maxPixelSize:0]);
+}
+
+/**
+ * Measures decode throughput (decodes/sec) with varying levels of concurrency.
+ */
+- (void)test_concurrentDecodeThroughput
+{
+	NSUInteger const imageCount = 48;
+	CGFloat const maxPixelSize = 256;
+	
+	NSMutableArray<NSData *> *images = [NSMutableArray arrayWithCapacity:imageCount];
+	for (NSUInteger i = 0; i < imageCount; i++)
+	{
+		[images addObject:[self pngDataWithWidth:1024 height:768 seed:(uint8_t)i]];
+	}
+	
+	dispatch_queue_t completionQueue = dispatch_queue_create("test_ImageDecoder", DISPATCH_QUEUE_SERIAL);
+	
+	for (NSUInteger maxConcurrentDecodes = 1; maxConcurrentDecodes <= 4; maxConcurrentDecodes *= 2)
+	{
+		ZDCImageDecoder *decoder = [[ZDCImageDecoder alloc] initWithMaxConcurrentDecodes:maxConcurrentDecodes];
+		dispatch_group_t group = dispatch_group_create();
+		
+		__block NSUInteger failures = 0;
+		
+		CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+		
+		for (NSData *data in images)
+		{
+			dispatch_group_enter(group);
+			[decoder decodeImageData: data
+			            maxPixelSize: maxPixelSize
+			         processingBlock: nil
+			         completionQueue: completionQueue
+			         completionBlock:^(OSImage *image, NSUInteger cost, NSError *error)
+			{
+				CGImageRef cgImage = [image CGImage];
+				
+				if (image == nil || error
+				 || CGImageGetWidth(cgImage) > maxPixelSize
+				 || CGImageGetHeight(cgImage) > maxPixelSize
+				 || cost != (CGImageGetBytesPerRow(cgImage) * CGImageGetHeight(cgImage)))
+				{
+					failures++;
+				}
+				
+				dispatch_group_leave(group);
+			}];
+		}
+		
+		dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+		
+		CFAbsoluteTime elapsed = CFAbsoluteTimeGetCurrent() - start;
+		
+		NSLog(@"Decode throughput: maxConcurrentDecodes(%lu) => %.1f decodes/sec",
+		      (unsigned long)maxConcurrentDecodes, (double)imageCount / elapsed);
+		
+		XCTAssert(failures == 0);
+		XCTAssert(decoder.decodeCount == imageCount);
+	}
+	
+	ZDCImageDecoder *decoder = [[ZDCImageDecoder alloc] init];
+	
+	[self measureBlock:^{
+	
+		dispatch_group_t group = dispatch_group_create();
+		for (NSData *data in images)
+		{
+			dispatch_group_enter(group);
+			[decoder decodeImageData: data
+			            maxPixelSize: maxPixelSize
+			         processingBlock: nil
+			         completionQueue: completionQueue
+			         completionBlock:^(OSImage *image, NSUInteger cost, NSError *error)
+			{
+				dispatch_group_leave(group);
+			}];
+		}
+		dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+	}];
+}
+
+/**
+ * Simulates scrolling back & forth through a grid of thumbnails (via `fetchNodeThumbnail:`),
+ * and reports the hit rate of the ImageManager's cache (which is charged the decoded bitmap size).
+ *
+ * The hit rate depends on NSCache's eviction policy. So it's reported, but not asserted.
+ */
+- (void)test_scrollingHitRate
+{
+	NSUInteger const imageCount = 300;
+	NSUInteger const visibleCount = 24;
+	CGFloat const maxPixelSize = 128;
+	
+	NSData *data = [self pngDataWithWidth:512 height:512 seed:7];
+	
+	OSImage *thumbnail = [ZDCImageDecoder decodeImageData:data maxPixelSize:maxPixelSize];
+	NSUInteger cost = [ZDCImageDecoder decodedByteCountForImage:thumbnail];
+	
+	TestImageManagerOwner *owner NS_VALID_UNTIL_END_OF_SCOPE = [[TestImageManagerOwner alloc] init];
+	owner.downloadManager = [[TestThumbnailDownloader alloc] init];
+	owner.downloadManager.thumbnailData = data;
+	
+	ZDCImageManager *imageManager = [[ZDCImageManager alloc] initWithOwner:(ZeroDarkCloud *)owner];
+	
+	// Budget for roughly 4 screens worth of thumbnails
+	
+	imageManager.nodeThumbnailsCacheBudget = cost * visibleCount * 4;
+	
+	NSMutableArray<ZDCNode *> *nodes = [NSMutableArray arrayWithCapacity:imageCount];
+	for (NSUInteger i = 0; i < imageCount; i++)
+	{
+		[nodes addObject:[[ZDCNode alloc] initWithLocalUserID:@"z55tqmfr9kix1p1gntotqpwkacpuoyno"]];
+	}
+	
+	ZDCFetchOptions *options = [[ZDCFetchOptions alloc] init];
+	options.maxPixelSize = maxPixelSize;
+	options.downloadIfMarkedAsNeedsDownload = NO; // there's no database to check
+	
+	NSUInteger requestCount = 0;
+	__block NSUInteger failures = 0;
+	
+	// Scroll down, back up a bit, and down again. Repeat.
+	
+	NSUInteger position = 0;
+	NSInteger const steps[] = { 6, 6, 6, -4, -4, 6, 6, 6, 6, -8 };
+	NSUInteger const stepCount = sizeof(steps) / sizeof(steps[0]);
+	
+	for (NSUInteger i = 0; i < 400; i++)
+	{
+		NSInteger next = (NSInteger)position + steps[i % stepCount];
+		position = (NSUInteger)MAX(0, MIN((NSInteger)(imageCount - visibleCount), next));
+		
+		XCTestExpectation *loaded = [self expectationWithDescription:@"loaded"];
+		__block NSUInteger fetchCount = 0;
+		
+		for (NSUInteger index = position; index < (position + visibleCount); index++)
+		{
+			requestCount++;
+			
+			[imageManager fetchNodeThumbnail: nodes[index]
+			                     withOptions: options
+			                   preFetchBlock:^(OSImage *image, BOOL willFetch)
+			{
+				if (willFetch) {
+					fetchCount++;
+				}
+				
+			} postFetchBlock:^(OSImage *image, NSError *error) {
+				
+				if (image == nil || error) {
+					failures++;
+				}
+				[loaded fulfill];
+			}];
+		}
+		
+		// Let this screen's thumbnails load before scrolling on.
+		// (The postFetchBlocks are invoked on the main thread, so none of them have fired yet.)
+		
+		if (fetchCount > 0) {
+			loaded.expectedFulfillmentCount = fetchCount;
+		} else {
+			[loaded fulfill];
+		}
+		
+		[self waitForExpectationsWithTimeout:10.0 handler:nil];
+	}
+	
+	uint64_t hits = imageManager.nodeThumbnailsCacheHitCount;
+	uint64_t misses = imageManager.nodeThumbnailsCacheMissCount;
+	
+	double hitRate = (double)hits / (double)(hits + misses);
+	
+	NSLog(@"Scrolling hit rate: %.1f%% (hits: %llu, misses: %llu, cost per thumbnail: %lu bytes, budget: %lu bytes)",
+	      hitRate * 100.0, hits, misses, (unsigned long)cost, (unsigned long)imageManager.nodeThumbnailsCacheBudget);
+	
+	XCTAssert(failures == 0);
+	XCTAssert((hits + misses) == requestCount);
+}
+
+@end
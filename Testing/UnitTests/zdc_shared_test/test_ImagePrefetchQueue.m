@@ -0,0 +1,211 @@
+/**
+ * ZeroDark.cloud
+ * <GitHub wiki link goes here>
+**/
+
+#import <XCTest/XCTest.h>
+
+#import <ZeroDarkCloud/ZeroDarkCloud.h>
+#import <ZeroDarkCloud/ZDCImagePrefetchQueue.h>
+
+@interface test_ImagePrefetchQueue : XCTestCase
+@end
+
+@implementation test_ImagePrefetchQueue {
+
+	dispatch_queue_t startQueue;
+	NSMutableArray<ZDCImagePrefetchTask *> *started; // accessed via startQueue
+}
+
+- (void)setUp
+{
+	[super setUp];
+	
+	startQueue = dispatch_queue_create("test_ImagePrefetchQueue", DISPATCH_QUEUE_SERIAL);
+	started = [NSMutableArray array];
+}
+
+- (ZDCImagePrefetchQueue *)prefetchQueueWithMaxInFlight:(NSUInteger)maxInFlight
+{
+	NSMutableArray<ZDCImagePrefetchTask *> *_started = started;
+	
+	ZDCImagePrefetchQueue *prefetchQueue =
+	  [[ZDCImagePrefetchQueue alloc] initWithStartQueue: startQueue
+	                                         startBlock:^(ZDCImagePrefetchTask *task)
+	{
+		[_started addObject:task];
+	}];
+	
+	prefetchQueue.maxInFlight = maxInFlight;
+	return prefetchQueue;
+}
+
+- (NSArray<ZDCImagePrefetchTask *> *)tasksWithKeys:(NSArray<NSString *> *)keys
+{
+	NSMutableArray<ZDCImagePrefetchTask *> *tasks = [NSMutableArray arrayWithCapacity:keys.count];
+	for (NSString *key in keys)
+	{
+		[tasks addObject:[[ZDCImagePrefetchTask alloc] initWithKey: key
+		                                                identifier: key
+		                                                   options: nil
+		                                              processingID: nil
+		                                           processingBlock: nil]];
+	}
+	return tasks;
+}
+
+/**
+ * Returns the keys of the started tasks (in start order).
+ * Waits for any queued start blocks to run first.
+ */
+- (NSArray<NSString *> *)startedKeys:(ZDCImagePrefetchQueue *)prefetchQueue
+{
+	(void)prefetchQueue.inFlightCount; // flush the prefetchQueue
+	
+	__block NSArray<NSString *> *result = nil;
+	dispatch_sync(startQueue, ^{
+		result = [self->started valueForKey:@"key"];
+	});
+	
+	return result;
+}
+
+- (ZDCImagePrefetchTask *)startedTaskWithKey:(NSString *)key
+{
+	__block ZDCImagePrefetchTask *result = nil;
+	dispatch_sync(startQueue, ^{
+	
+		for (ZDCImagePrefetchTask *task in self->started)
+		{
+			if ([task.key isEqualToString:key]) {
+				result = task;
+			}
+		}
+	});
+	
+	return result;
+}
+
+- (void)test_orderAndLimit
+{
+	ZDCImagePrefetchQueue *prefetchQueue = [self prefetchQueueWithMaxInFlight:2];
+	
+	[prefetchQueue setTasks:[self tasksWithKeys:@[ @"a", @"b", @"a", @"c", @"d" ]]];
+	
+	XCTAssertEqualObjects([self startedKeys:prefetchQueue], (@[ @"a", @"b" ]));
+	XCTAssert(prefetchQueue.inFlightCount == 2);
+	XCTAssert(prefetchQueue.pendingCount == 2); // duplicate "a" was coalesced
+	
+	[[self startedTaskWithKey:@"a"] finish];
+	[[self startedTaskWithKey:@"a"] finish]; // extra invocations are ignored
+	
+	XCTAssertEqualObjects([self startedKeys:prefetchQueue], (@[ @"a", @"b", @"c" ]));
+	
+	[[self startedTaskWithKey:@"b"] finish];
+	[[self startedTaskWithKey:@"c"] finish];
+	
+	XCTAssertEqualObjects([self startedKeys:prefetchQueue], (@[ @"a", @"b", @"c", @"d" ]));
+	
+	[[self startedTaskWithKey:@"d"] finish];
+	
+	XCTAssert(prefetchQueue.inFlightCount == 0);
+	XCTAssert(prefetchQueue.pendingCount == 0);
+	XCTAssert(prefetchQueue.cancelledCount == 0);
+}
+
+- (void)test_reprioritize
+{
+	ZDCImagePrefetchQueue *prefetchQueue = [self prefetchQueueWithMaxInFlight:2];
+	
+	[prefetchQueue setTasks:[self tasksWithKeys:@[ @"a", @"b", @"c", @"d" ]]];
+	XCTAssertEqualObjects([self startedKeys:prefetchQueue], (@[ @"a", @"b" ]));
+	
+	ZDCImagePrefetchTask *a = [self startedTaskWithKey:@"a"];
+	ZDCImagePrefetchTask *b = [self startedTaskWithKey:@"b"];
+	
+	// Visible range moves: "a" scrolled away, "b" is still wanted (and not restarted), "e" jumps the queue.
+	
+	[prefetchQueue setTasks:[self tasksWithKeys:@[ @"e", @"b", @"c" ]]];
+	
+	XCTAssertEqualObjects([self startedKeys:prefetchQueue], (@[ @"a", @"b", @"e" ]));
+	XCTAssertTrue(a.isCancelled);
+	XCTAssertFalse(b.isCancelled);
+	XCTAssert(prefetchQueue.cancelledCount == 1);
+	
+	// Finishing a cancelled task doesn't free another slot
+	
+	[a finish];
+	XCTAssert(prefetchQueue.inFlightCount == 2);
+	XCTAssertEqualObjects([self startedKeys:prefetchQueue], (@[ @"a", @"b", @"e" ]));
+	
+	// Empty list cancels everything
+	
+	[prefetchQueue setTasks:@[]];
+	
+	XCTAssertTrue(b.isCancelled);
+	XCTAssertTrue([self startedTaskWithKey:@"e"].isCancelled);
+	XCTAssert(prefetchQueue.inFlightCount == 0);
+	XCTAssert(prefetchQueue.pendingCount == 0);
+	XCTAssert(prefetchQueue.cancelledCount == 3);
+}
+
+/**
+ * Simulates a fast scroll through a long list, where each prefetch takes a while to complete.
+ *
+ * Reports how many prefetches were started, completed, and cancelled (because they scrolled out of range).
+ */
+- (void)test_scrollingSimulation
+{
+	NSUInteger const itemCount = 1000;
+	NSUInteger const rangeLength = 20;
+	NSUInteger const stepsPerItem = 4; // each prefetch completes 2 scroll events (of 2 items each) after it starts
+	
+	ZDCImagePrefetchQueue *prefetchQueue = [self prefetchQueueWithMaxInFlight:4];
+	
+	NSMutableDictionary<NSString*, NSNumber*> *startStep = [NSMutableDictionary dictionary]; // task => step
+	NSUInteger completed = 0;
+	
+	for (NSUInteger step = 0; step < (itemCount - rangeLength); step += 2)
+	{
+		NSMutableArray<NSString *> *keys = [NSMutableArray arrayWithCapacity:rangeLength];
+		for (NSUInteger i = step; i < (step + rangeLength); i++)
+		{
+			[keys addObject:[NSString stringWithFormat:@"%lu", (unsigned long)i]];
+		}
+		
+		[prefetchQueue setTasks:[self tasksWithKeys:keys]];
+		(void)[self startedKeys:prefetchQueue];
+		
+		__block NSArray<ZDCImagePrefetchTask *> *tasks = nil;
+		dispatch_sync(startQueue, ^{
+			tasks = [self->started copy];
+		});
+		
+		for (ZDCImagePrefetchTask *task in tasks)
+		{
+			NSString *taskID = [NSString stringWithFormat:@"%p", task];
+			if (startStep[taskID] == nil)
+			{
+				startStep[taskID] = @(step);
+				continue;
+			}
+			
+			if (!task.isCancelled && (step - startStep[taskID].unsignedIntegerValue) == stepsPerItem)
+			{
+				[task finish];
+				completed++;
+			}
+		}
+	}
+	
+	NSUInteger startedCount = [self startedKeys:prefetchQueue].count;
+	NSUInteger cancelledCount = prefetchQueue.cancelledCount;
+	
+	NSLog(@"Scrolling simulation: started(%lu) completed(%lu) cancelled(%lu)",
+	      (unsigned long)startedCount, (unsigned long)completed, (unsigned long)cancelledCount);
+	
+	XCTAssert(prefetchQueue.inFlightCount <= 4);
+	XCTAssert(completed > 0);
+}
+
+@end
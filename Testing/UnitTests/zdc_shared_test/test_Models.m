@@ -6,6 +6,7 @@
 #import <XCTest/XCTest.h>
 
 #import "ZDCNode.h"
+#import "ZDCNodeAggregates.h"
 #import "ZDCShareList.h"
 #import "ZDCShareItem.h"
 
@@ -140,6 +141,30 @@ static NSString *const userC = @"jag15iacxneuco7owmegke63msbgyuyx";
 	XCTAssert(itemB.isImmutable == YES);
 }
 
+- (void)test_nodeAggregates_coding
+{
+	ZDCNodeAggregates *aggregates =
+	  [[ZDCNodeAggregates alloc] initWithParentID: @"abc123"
+	                                     dataSize: 5000000000 // > UINT32_MAX
+	                           pendingUploadCount: 1
+	                              descendantCount: 42
+	                           descendantDataSize: 1234
+	                 descendantPendingUploadCount: 3];
+	
+	NSData *data = [NSKeyedArchiver archivedDataWithRootObject:aggregates];
+	ZDCNodeAggregates *decoded = [NSKeyedUnarchiver unarchiveObjectWithData:data];
+	
+	XCTAssert([decoded.parentID isEqualToString:@"abc123"]);
+	XCTAssert(decoded.dataSize == 5000000000);
+	XCTAssert(decoded.pendingUploadCount == 1);
+	XCTAssert(decoded.descendantCount == 42);
+	XCTAssert(decoded.descendantDataSize == 1234);
+	XCTAssert(decoded.descendantPendingUploadCount == 3);
+	
+	XCTAssert(decoded.totalDataSize == 5000001234);
+	XCTAssert(decoded.totalPendingUploadCount == 4);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark -
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,335 @@
+/**
+ * ZeroDark.cloud
+ * <GitHub wiki link goes here>
+**/
+
+#import <XCTest/XCTest.h>
+
+#import "ZDCConstants.h"
+#import "ZDCDatabaseManager.h"
+#import "ZDCNamingConflictIndex.h"
+#import "ZDCNodeManager.h"
+
+#import <YapDatabase/YapDatabase.h>
+#import <YapDatabase/YapDatabaseAutoView.h>
+#import <YapDatabase/YapDatabaseHooks.h>
+
+static NSString *const localUserID = @"z55tqmfr9kix1p1gntotqpwkacpuoyno";
+
+@interface test_NamingConflictIndex : XCTestCase
+@end
+
+@implementation test_NamingConflictIndex {
+
+	YapDatabase *database;
+	YapDatabaseConnection *connection;
+	
+	ZDCNode *parent;
+}
+
+- (void)setUp
+{
+	[super setUp];
+	
+	NSString *databasePath =
+	  [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+	
+	database = [[YapDatabase alloc] initWithURL:[NSURL fileURLWithPath:databasePath]];
+	connection = [database newConnection];
+	
+	// The ZDCNodeManager uses the treesystem view to find siblings by name.
+	// So a stand-in (grouped by parentID, sorted by name) is registered under the same name.
+	
+	YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withObjectBlock:
+		^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key, id object)
+	{
+		return [(ZDCNode *)object parentID];
+	}];
+	
+	YapDatabaseViewSorting *sorting = [YapDatabaseViewSorting withObjectBlock:
+		^(YapDatabaseReadTransaction *transaction, NSString *group,
+		    NSString *collection1, NSString *key1, id obj1,
+		    NSString *collection2, NSString *key2, id obj2)
+	{
+		__unsafe_unretained ZDCNode *node1 = (ZDCNode *)obj1;
+		__unsafe_unretained ZDCNode *node2 = (ZDCNode *)obj2;
+		
+		NSComparisonResult result = [node1.name localizedCaseInsensitiveCompare:node2.name];
+		if (result == NSOrderedSame) {
+			result = [node1.uuid compare:node2.uuid];
+		}
+		
+		return result;
+	}];
+	
+	YapDatabaseViewOptions *options = [[YapDatabaseViewOptions alloc] init];
+	options.allowedCollections =
+	  [[YapWhitelistBlacklist alloc] initWithWhitelist:[NSSet setWithObject:kZDCCollection_Nodes]];
+	
+	YapDatabaseAutoView *view =
+	  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting versionTag:@"1" options:options];
+	
+	XCTAssertTrue([database registerExtension:view withName:Ext_View_Treesystem_Name]);
+	
+	// In the framework, node modifications are reported to the index by ZDCCloudTransaction.
+	// Here they're reported by a stand-in hooks extension.
+	
+	YapDatabaseHooks *hooks = [[YapDatabaseHooks alloc] init];
+	hooks.allowedCollections =
+	  [[YapWhitelistBlacklist alloc] initWithWhitelist:[NSSet setWithObject:kZDCCollection_Nodes]];
+	
+	hooks.didModifyRow = ^(YapDatabaseReadWriteTransaction *transaction, NSString *collection, NSString *key,
+	                       YapProxyObject *proxyObject, YapProxyObject *proxyMetadata,
+	                       YapDatabaseHooksBitMask flags)
+	{
+		[[ZDCNamingConflictIndex existingIndexForTransaction:transaction] didUpdateNode:proxyObject.realObject
+		                                                                    transaction:transaction];
+	};
+	
+	hooks.didRemoveRow = ^(YapDatabaseReadWriteTransaction *transaction, NSString *collection, NSString *key) {
+	
+		[[ZDCNamingConflictIndex existingIndexForTransaction:transaction] didRemoveNodeID:key
+		                                                                      transaction:transaction];
+	};
+	
+	XCTAssertTrue([database registerExtension:hooks withName:@"test:hooks"]);
+	
+	parent = [[ZDCNode alloc] initWithLocalUserID:localUserID];
+	parent.parentID = [[NSUUID UUID] UUIDString];
+	parent.name = @"Photos";
+	
+	[self insert:@[ parent ]];
+}
+
+- (void)tearDown
+{
+	connection = nil;
+	database = nil;
+	
+	[super tearDown];
+}
+
+- (ZDCNode *)nodeNamed:(NSString *)name
+{
+	ZDCNode *node = [[ZDCNode alloc] initWithLocalUserID:localUserID];
+	node.parentID = parent.uuid;
+	node.name = name;
+	
+	return node;
+}
+
+- (NSArray<ZDCNode *> *)insertNamed:(NSArray<NSString *> *)names
+{
+	NSMutableArray<ZDCNode *> *nodes = [NSMutableArray arrayWithCapacity:names.count];
+	for (NSString *name in names) {
+		[nodes addObject:[self nodeNamed:name]];
+	}
+	
+	[self insert:nodes];
+	return nodes;
+}
+
+- (void)insert:(NSArray<ZDCNode *> *)nodes
+{
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+	
+		for (ZDCNode *node in nodes) {
+			[transaction setObject:node forKey:node.uuid inCollection:kZDCCollection_Nodes];
+		}
+	}];
+}
+
+- (void)remove:(ZDCNode *)node
+{
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+	
+		[transaction removeObjectForKey:node.uuid inCollection:kZDCCollection_Nodes];
+	}];
+}
+
+/**
+ * Imports a file the way the framework does: resolving the conflict (if any), and then inserting the node.
+ */
+- (NSString *)import:(NSString *)name transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+	ZDCNodeManager *nodeManager = [ZDCNodeManager sharedInstance];
+	ZDCNode *node = [self nodeNamed:name];
+	
+	if ([nodeManager findNodeWithName:name parentID:parent.uuid transaction:transaction]) {
+		node.name = [nodeManager resolveNamingConflict:node transaction:transaction];
+	}
+	
+	[transaction setObject:node forKey:node.uuid inCollection:kZDCCollection_Nodes];
+	return node.name;
+}
+
+- (NSString *)import:(NSString *)name
+{
+	__block NSString *result = nil;
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+	
+		result = [self import:name transaction:transaction];
+	}];
+	
+	return result;
+}
+
+- (NSString *)resolve:(NSString *)name
+{
+	__block NSString *result = nil;
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+	
+		result = [[ZDCNodeManager sharedInstance] resolveNamingConflict:[self nodeNamed:name] transaction:transaction];
+	}];
+	
+	return result;
+}
+
+- (NSUInteger)entryCount
+{
+	__block NSUInteger result = 0;
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+	
+		result = [ZDCNamingConflictIndex indexForTransaction:transaction].entryCount;
+	}];
+	
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Tests
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)test_highestSuffix
+{
+	[self insertNamed:@[ @"IMG.jpg", @"IMG 2.jpg", @"IMG 7.jpg", @"IMG 9.png", @"IMG 12b.jpg" ]];
+	
+	XCTAssertEqualObjects([self resolve:@"IMG.jpg"], @"IMG 8.jpg");
+	XCTAssertEqualObjects([self resolve:@"img.JPG"], @"img 8.JPG");
+	XCTAssertEqualObjects([self resolve:@"IMG.png"], @"IMG 10.png");
+	
+	// Read-only transactions (on the latest snapshot) publish what they find
+	XCTAssert([self entryCount] == 2);
+}
+
+- (void)test_deleteThenReimport
+{
+	[self insertNamed:@[ @"IMG.jpg" ]];
+	NSString *parentID = parent.uuid;
+	
+	XCTAssertEqualObjects([self import:@"IMG.jpg"], @"IMG 2.jpg");
+	XCTAssertEqualObjects([self resolve:@"IMG.jpg"], @"IMG 3.jpg");
+	
+	__block ZDCNode *img2 = nil;
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+	
+		img2 = [[ZDCNodeManager sharedInstance] findNodeWithName: @"IMG 2.jpg"
+		                                                 parentID: parentID
+		                                              transaction: transaction];
+	}];
+	XCTAssert(img2 != nil);
+	
+	// Deleting the holder of the highest number must remove the entry
+	
+	[self remove:img2];
+	XCTAssertEqualObjects([self import:@"IMG.jpg"], @"IMG 2.jpg");
+	XCTAssertEqualObjects([self resolve:@"IMG.jpg"], @"IMG 3.jpg");
+	
+	// Renaming the holder must remove the entry too
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+	
+		ZDCNode *holder = [[ZDCNodeManager sharedInstance] findNodeWithName: @"IMG 2.jpg"
+		                                                            parentID: parentID
+		                                                         transaction: transaction];
+		holder = [holder copy];
+		holder.name = @"Beach.jpg";
+		
+		[transaction setObject:holder forKey:holder.uuid inCollection:kZDCCollection_Nodes];
+	}];
+	XCTAssertEqualObjects([self resolve:@"IMG.jpg"], @"IMG 2.jpg");
+	
+	// Deleting a sibling that doesn't hold the highest number doesn't change anything
+	
+	NSArray<ZDCNode *> *nodes = [self insertNamed:@[ @"IMG 2.jpg", @"IMG 5.jpg" ]];
+	XCTAssertEqualObjects([self resolve:@"IMG.jpg"], @"IMG 6.jpg");
+	
+	[self remove:nodes[0]];
+	XCTAssertEqualObjects([self resolve:@"IMG.jpg"], @"IMG 6.jpg");
+}
+
+- (void)test_higherNumberInserted
+{
+	[self insertNamed:@[ @"IMG.jpg", @"IMG 2.jpg" ]];
+	XCTAssertEqualObjects([self resolve:@"IMG.jpg"], @"IMG 3.jpg");
+	
+	// E.g. a sibling that arrived via a pull (i.e. without going through resolveNamingConflict)
+	
+	[self insertNamed:@[ @"IMG 40.jpg" ]];
+	XCTAssertEqualObjects([self resolve:@"IMG.jpg"], @"IMG 41.jpg");
+}
+
+- (void)test_multipleImportsInTransaction
+{
+	[self insertNamed:@[ @"IMG.jpg" ]];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+	
+		XCTAssertEqualObjects([self import:@"IMG.jpg" transaction:transaction], @"IMG 2.jpg");
+		XCTAssertEqualObjects([self import:@"IMG.jpg" transaction:transaction], @"IMG 3.jpg");
+		XCTAssertEqualObjects([self import:@"IMG.jpg" transaction:transaction], @"IMG 4.jpg");
+	}];
+	
+	XCTAssertEqualObjects([self resolve:@"IMG.jpg"], @"IMG 5.jpg");
+}
+
+- (void)test_rollback
+{
+	[self insertNamed:@[ @"IMG.jpg" ]];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+	
+		XCTAssertEqualObjects([self import:@"IMG.jpg" transaction:transaction], @"IMG 2.jpg");
+		XCTAssertEqualObjects([self import:@"IMG.jpg" transaction:transaction], @"IMG 3.jpg");
+		
+		[transaction rollback];
+	}];
+	
+	// Give the transaction's completion block (which runs on the main queue) a chance to publish anything.
+	
+	XCTestExpectation *expectation = [self expectationWithDescription:@"completion"];
+	dispatch_async(dispatch_get_main_queue(), ^{
+		[expectation fulfill];
+	});
+	[self waitForExpectationsWithTimeout:5.0 handler:nil];
+	
+	XCTAssertEqualObjects([self resolve:@"IMG.jpg"], @"IMG 2.jpg");
+	XCTAssertEqualObjects([self import:@"IMG.jpg"], @"IMG 2.jpg");
+}
+
+- (void)test_olderSnapshot
+{
+	[self insertNamed:@[ @"IMG.jpg", @"IMG 2.jpg" ]];
+	
+	YapDatabaseConnection *oldConnection = [database newConnection];
+	
+	[oldConnection readWithBlock:^(YapDatabaseReadTransaction *oldTransaction) {
+	
+		// A newer snapshot publishes a higher number...
+		
+		[self insertNamed:@[ @"IMG 9.jpg" ]];
+		XCTAssertEqualObjects([self resolve:@"IMG.jpg"], @"IMG 10.jpg");
+		
+		// ... which doesn't apply to a reader on the older snapshot.
+		
+		NSString *name =
+		  [[ZDCNodeManager sharedInstance] resolveNamingConflict: [self nodeNamed:@"IMG.jpg"]
+		                                             transaction: oldTransaction];
+		
+		XCTAssertEqualObjects(name, @"IMG 3.jpg");
+	}];
+	
+	XCTAssertEqualObjects([self resolve:@"IMG.jpg"], @"IMG 10.jpg");
+}
+
+@end
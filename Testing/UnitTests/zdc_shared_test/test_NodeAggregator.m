@@ -0,0 +1,359 @@
+/**
+ * ZeroDark.cloud
+ * <GitHub wiki link goes here>
+**/
+
+#import <XCTest/XCTest.h>
+
+#import "ZDCConstants.h"
+#import "ZDCDatabaseManager.h"
+#import "ZDCNodeAggregates.h"
+#import "ZDCNodeAggregator.h"
+#import "ZDCNodePrivate.h"
+
+#import <YapDatabase/YapDatabase.h>
+#import <YapDatabase/YapDatabaseAutoView.h>
+
+static NSString *const localUserID = @"z55tqmfr9kix1p1gntotqpwkacpuoyno";
+
+@interface test_NodeAggregator : XCTestCase
+@end
+
+@implementation test_NodeAggregator {
+
+	YapDatabase *database;
+	YapDatabaseConnection *connection;
+}
+
+- (void)setUp
+{
+	[super setUp];
+	
+	NSString *databasePath =
+	  [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+	
+	database = [[YapDatabase alloc] initWithURL:[NSURL fileURLWithPath:databasePath]];
+	connection = [database newConnection];
+	
+	// The aggregator uses the treesystem view to find children that were inserted before their parent.
+	// We only need the grouping (by parentID), so a simple stand-in is registered under the same name.
+	
+	YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withObjectBlock:
+		^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key, id object)
+	{
+		return [(ZDCNode *)object parentID];
+	}];
+	
+	YapDatabaseViewSorting *sorting = [YapDatabaseViewSorting withKeyBlock:
+		^(YapDatabaseReadTransaction *transaction, NSString *group,
+		    NSString *collection1, NSString *key1,
+		    NSString *collection2, NSString *key2)
+	{
+		return [key1 compare:key2];
+	}];
+	
+	YapDatabaseViewOptions *options = [[YapDatabaseViewOptions alloc] init];
+	options.allowedCollections =
+	  [[YapWhitelistBlacklist alloc] initWithWhitelist:[NSSet setWithObject:kZDCCollection_Nodes]];
+	
+	YapDatabaseAutoView *view =
+	  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting versionTag:@"1" options:options];
+	
+	XCTAssertTrue([database registerExtension:view withName:Ext_View_Treesystem_Name]);
+	XCTAssertTrue([database registerExtension:[ZDCNodeAggregator hooksExtension]
+	                                 withName:Ext_Hooks_NodeAggregates]);
+}
+
+- (void)tearDown
+{
+	connection = nil;
+	database = nil;
+	
+	[super tearDown];
+}
+
+- (ZDCNode *)nodeWithParent:(ZDCNode *)parent dataSize:(uint64_t)dataSize
+{
+	ZDCNode *node = [[ZDCNode alloc] initWithLocalUserID:localUserID];
+	node.parentID = parent.uuid;
+	
+	if (dataSize > 0) {
+		node.cloudDataInfo = [self dataInfoWithSize:dataSize];
+	}
+	
+	return node;
+}
+
+- (ZDCCloudDataInfo *)dataInfoWithSize:(uint64_t)dataSize
+{
+	ZDCCloudFileHeader header;
+	bzero(&header, sizeof(header));
+	header.dataSize = dataSize;
+	
+	return [[ZDCCloudDataInfo alloc] initWithCloudFileHeader:header eTag:@"etag" lastModified:[NSDate date]];
+}
+
+- (void)insert:(NSArray<ZDCNode *> *)nodes
+{
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+	
+		for (ZDCNode *node in nodes) {
+			[transaction setObject:node forKey:node.uuid inCollection:kZDCCollection_Nodes];
+		}
+	}];
+}
+
+- (ZDCNodeAggregates *)aggregatesFor:(ZDCNode *)node
+{
+	__block ZDCNodeAggregates *aggregates = nil;
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+	
+		aggregates = [transaction objectForKey:node.uuid inCollection:kZDCCollection_NodeAggregates];
+	}];
+	
+	return aggregates;
+}
+
+- (void)assertNode:(ZDCNode *)node
+       descendants:(uint64_t)count
+          dataSize:(uint64_t)totalDataSize
+    pendingUploads:(uint64_t)totalPendingUploads
+{
+	ZDCNodeAggregates *aggregates = [self aggregatesFor:node];
+	
+	XCTAssert(aggregates != nil);
+	XCTAssert(aggregates.descendantCount == count,
+	          @"descendantCount: %llu != %llu", aggregates.descendantCount, count);
+	XCTAssert(aggregates.totalDataSize == totalDataSize,
+	          @"totalDataSize: %llu != %llu", aggregates.totalDataSize, totalDataSize);
+	XCTAssert(aggregates.totalPendingUploadCount == totalPendingUploads,
+	          @"totalPendingUploadCount: %llu != %llu", aggregates.totalPendingUploadCount, totalPendingUploads);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Tests
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)test_insert
+{
+	ZDCNode *root  = [self nodeWithParent:nil dataSize:0];
+	ZDCNode *dirA  = [self nodeWithParent:root dataSize:0];
+	ZDCNode *fileA = [self nodeWithParent:dirA dataSize:100];
+	ZDCNode *fileB = [self nodeWithParent:dirA dataSize:20];
+	ZDCNode *fileC = [self nodeWithParent:root dataSize:3];
+	
+	[self insert:@[ root, dirA, fileA, fileB, fileC ]];
+	
+	[self assertNode:root  descendants:4 dataSize:123 pendingUploads:0];
+	[self assertNode:dirA  descendants:2 dataSize:120 pendingUploads:0];
+	[self assertNode:fileA descendants:0 dataSize:100 pendingUploads:0];
+	[self assertNode:fileC descendants:0 dataSize:3   pendingUploads:0];
+}
+
+- (void)test_insert_childBeforeParent
+{
+	ZDCNode *root  = [self nodeWithParent:nil dataSize:0];
+	ZDCNode *dirA  = [self nodeWithParent:root dataSize:0];
+	ZDCNode *fileA = [self nodeWithParent:dirA dataSize:100];
+	ZDCNode *fileB = [self nodeWithParent:dirA dataSize:20];
+	
+	// E.g. during a pull, the children may be downloaded before their parent.
+	
+	[self insert:@[ root ]];
+	[self insert:@[ fileA, fileB ]];
+	
+	[self assertNode:root descendants:0 dataSize:0 pendingUploads:0];
+	
+	[self insert:@[ dirA ]];
+	
+	[self assertNode:dirA descendants:2 dataSize:120 pendingUploads:0];
+	[self assertNode:root descendants:3 dataSize:120 pendingUploads:0];
+}
+
+- (void)test_modify
+{
+	ZDCNode *root  = [self nodeWithParent:nil dataSize:0];
+	ZDCNode *dirA  = [self nodeWithParent:root dataSize:0];
+	ZDCNode *fileA = [self nodeWithParent:dirA dataSize:100];
+	
+	[self insert:@[ root, dirA, fileA ]];
+	
+	fileA = [fileA copy];
+	fileA.cloudDataInfo = [self dataInfoWithSize:250];
+	[self insert:@[ fileA ]];
+	
+	[self assertNode:fileA descendants:0 dataSize:250 pendingUploads:0];
+	[self assertNode:dirA  descendants:1 dataSize:250 pendingUploads:0];
+	[self assertNode:root  descendants:2 dataSize:250 pendingUploads:0];
+}
+
+- (void)test_move
+{
+	ZDCNode *root  = [self nodeWithParent:nil dataSize:0];
+	ZDCNode *dirA  = [self nodeWithParent:root dataSize:0];
+	ZDCNode *dirB  = [self nodeWithParent:root dataSize:0];
+	ZDCNode *dirC  = [self nodeWithParent:dirA dataSize:0];
+	ZDCNode *fileA = [self nodeWithParent:dirC dataSize:100];
+	ZDCNode *fileB = [self nodeWithParent:dirC dataSize:20];
+	
+	[self insert:@[ root, dirA, dirB, dirC, fileA, fileB ]];
+	
+	[self assertNode:dirA descendants:3 dataSize:120 pendingUploads:0];
+	[self assertNode:dirB descendants:0 dataSize:0   pendingUploads:0];
+	
+	// Move dirC (and its subtree) from dirA to dirB
+	
+	dirC = [dirC copy];
+	dirC.parentID = dirB.uuid;
+	[self insert:@[ dirC ]];
+	
+	[self assertNode:dirA descendants:0 dataSize:0   pendingUploads:0];
+	[self assertNode:dirB descendants:3 dataSize:120 pendingUploads:0];
+	[self assertNode:dirC descendants:2 dataSize:120 pendingUploads:0];
+	[self assertNode:root descendants:5 dataSize:120 pendingUploads:0];
+}
+
+- (void)test_delete
+{
+	ZDCNode *root  = [self nodeWithParent:nil dataSize:0];
+	ZDCNode *dirA  = [self nodeWithParent:root dataSize:0];
+	ZDCNode *fileA = [self nodeWithParent:dirA dataSize:100];
+	ZDCNode *fileB = [self nodeWithParent:dirA dataSize:20];
+	
+	[self insert:@[ root, dirA, fileA, fileB ]];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+	
+		[transaction removeObjectForKey:fileA.uuid inCollection:kZDCCollection_Nodes];
+	}];
+	
+	XCTAssert([self aggregatesFor:fileA] == nil);
+	[self assertNode:dirA descendants:1 dataSize:20 pendingUploads:0];
+	[self assertNode:root descendants:2 dataSize:20 pendingUploads:0];
+	
+	// Delete a subtree (parent first, then the orphaned children)
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+	
+		[transaction removeObjectForKey:dirA.uuid inCollection:kZDCCollection_Nodes];
+		[transaction removeObjectForKey:fileB.uuid inCollection:kZDCCollection_Nodes];
+	}];
+	
+	[self assertNode:root descendants:0 dataSize:0 pendingUploads:0];
+}
+
+- (void)test_pendingUploads
+{
+	ZDCNode *root  = [self nodeWithParent:nil dataSize:0];
+	ZDCNode *dirA  = [self nodeWithParent:root dataSize:0];
+	ZDCNode *fileA = [self nodeWithParent:dirA dataSize:100];
+	
+	NSUUID *earlyOp = [NSUUID UUID];
+	NSUUID *op1 = [NSUUID UUID];
+	NSUUID *op2 = [NSUUID UUID];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+	
+		// Queued before the node was inserted - so it isn't counted
+		
+		[ZDCNodeAggregator didAddUploadOperation:earlyOp forNodeID:fileA.uuid transaction:transaction];
+		
+		for (ZDCNode *node in @[ root, dirA, fileA ]) {
+			[transaction setObject:node forKey:node.uuid inCollection:kZDCCollection_Nodes];
+		}
+		
+		[ZDCNodeAggregator didAddUploadOperation:op1 forNodeID:fileA.uuid transaction:transaction];
+		[ZDCNodeAggregator didAddUploadOperation:op2 forNodeID:fileA.uuid transaction:transaction];
+	}];
+	
+	[self assertNode:fileA descendants:0 dataSize:100 pendingUploads:2];
+	[self assertNode:root  descendants:2 dataSize:100 pendingUploads:2];
+	
+	// Completing the uncounted operation must not lower the count of the others
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+	
+		[ZDCNodeAggregator didRemoveUploadOperation:earlyOp transaction:transaction];
+	}];
+	
+	[self assertNode:fileA descendants:0 dataSize:100 pendingUploads:2];
+	[self assertNode:root  descendants:2 dataSize:100 pendingUploads:2];
+	
+	// Each counted operation is only subtracted once
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+	
+		[ZDCNodeAggregator didRemoveUploadOperation:op1 transaction:transaction];
+		[ZDCNodeAggregator didRemoveUploadOperation:op1 transaction:transaction];
+	}];
+	
+	[self assertNode:fileA descendants:0 dataSize:100 pendingUploads:1];
+	[self assertNode:root  descendants:2 dataSize:100 pendingUploads:1];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+	
+		[ZDCNodeAggregator didRemoveUploadOperation:op2 transaction:transaction];
+	}];
+	
+	[self assertNode:fileA descendants:0 dataSize:100 pendingUploads:0];
+	[self assertNode:root  descendants:2 dataSize:100 pendingUploads:0];
+}
+
+- (void)test_rebuild
+{
+	ZDCNode *root  = [self nodeWithParent:nil dataSize:0];
+	ZDCNode *dirA  = [self nodeWithParent:root dataSize:0];
+	ZDCNode *fileA = [self nodeWithParent:dirA dataSize:100];
+	ZDCNode *fileB = [self nodeWithParent:dirA dataSize:20];
+	ZDCNode *fileC = [self nodeWithParent:root dataSize:3];
+	
+	[self insert:@[ root, dirA, fileA, fileB, fileC ]];
+	
+	NSArray<ZDCNode *> *nodes = @[ root, dirA, fileA, fileB, fileC ];
+	NSMutableArray<ZDCNodeAggregates *> *before = [NSMutableArray array];
+	for (ZDCNode *node in nodes) {
+		[before addObject:[self aggregatesFor:node]];
+	}
+	
+	// Simulate a database created by an older version of the framework
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+	
+		[transaction removeAllObjectsInCollection:kZDCCollection_NodeAggregates];
+	}];
+	
+	XCTAssert([self aggregatesFor:root] == nil);
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+	
+		[ZDCNodeAggregator rebuildIfNeeded:transaction];
+	}];
+	
+	// The rebuild must produce the same values as the incremental updates
+	
+	for (NSUInteger i = 0; i < nodes.count; i++)
+	{
+		ZDCNodeAggregates *expected = before[i];
+		ZDCNodeAggregates *rebuilt = [self aggregatesFor:nodes[i]];
+		
+		XCTAssert(rebuilt != nil);
+		XCTAssert([rebuilt.parentID isEqualToString:expected.parentID] || (!rebuilt.parentID && !expected.parentID));
+		XCTAssert(rebuilt.dataSize == expected.dataSize);
+		XCTAssert(rebuilt.pendingUploadCount == expected.pendingUploadCount);
+		XCTAssert(rebuilt.descendantCount == expected.descendantCount);
+		XCTAssert(rebuilt.descendantDataSize == expected.descendantDataSize);
+		XCTAssert(rebuilt.descendantPendingUploadCount == expected.descendantPendingUploadCount);
+	}
+	
+	[self assertNode:root descendants:4 dataSize:123 pendingUploads:0];
+	[self assertNode:dirA descendants:2 dataSize:120 pendingUploads:0];
+	
+	// The rebuilt aggregates are maintained incrementally from then on
+	
+	ZDCNode *fileD = [self nodeWithParent:dirA dataSize:7];
+	[self insert:@[ fileD ]];
+	
+	[self assertNode:root descendants:5 dataSize:130 pendingUploads:0];
+}
+
+@end
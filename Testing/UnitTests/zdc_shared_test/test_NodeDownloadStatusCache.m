@@ -0,0 +1,193 @@
+/**
+ * ZeroDark.cloud
+ * <GitHub wiki link goes here>
+**/
+
+#import <XCTest/XCTest.h>
+
+#import <ZeroDarkCloud/ZeroDarkCloud.h>
+#import <ZeroDarkCloud/ZDCNodeDownloadStatusCache.h>
+
+#import <YapDatabase/YapDatabase.h>
+
+@interface test_NodeDownloadStatusCache : XCTestCase
+@end
+
+@implementation test_NodeDownloadStatusCache
+
+- (void)test_lookup
+{
+	ZDCNodeDownloadStatusCache *cache = [[ZDCNodeDownloadStatusCache alloc] init];
+	
+	NSString *nodeA = [[NSUUID UUID] UUIDString];
+	NSString *nodeB = [[NSUUID UUID] UUIDString];
+	
+	ZDCNodeComponents components = 0;
+	XCTAssertFalse([cache getMarkedComponents:&components forNodeID:nodeA]);
+	
+	[cache setMarkedComponents:ZDCNodeComponents_Thumbnail forNodeID:nodeA ifGenerationMatches:cache.generation];
+	[cache setMarkedComponents:0 forNodeID:nodeB ifGenerationMatches:cache.generation];
+	
+	XCTAssertTrue([cache getMarkedComponents:&components forNodeID:nodeA]);
+	XCTAssert(components == ZDCNodeComponents_Thumbnail);
+	
+	XCTAssertTrue([cache getMarkedComponents:&components forNodeID:nodeB]);
+	XCTAssert(components == 0);
+	
+	[cache applyChanges:@{ nodeA: @(0), nodeB: @(ZDCNodeComponents_All) }];
+	
+	XCTAssertTrue([cache getMarkedComponents:&components forNodeID:nodeA]);
+	XCTAssert(components == 0);
+	
+	XCTAssertTrue([cache getMarkedComponents:&components forNodeID:nodeB]);
+	XCTAssert(components == ZDCNodeComponents_All);
+	
+	[cache removeNodeIDs:@[ nodeA ]];
+	
+	XCTAssertFalse([cache getMarkedComponents:&components forNodeID:nodeA]);
+	XCTAssert(cache.count == 1);
+}
+
+- (void)test_untrackedChanges
+{
+	ZDCNodeDownloadStatusCache *cache = [[ZDCNodeDownloadStatusCache alloc] init];
+	
+	NSString *nodeID = [[NSUUID UUID] UUIDString];
+	
+	// Changes for untracked nodes aren't stored
+	
+	[cache applyChanges:@{ nodeID: @(ZDCNodeComponents_Thumbnail) }];
+	XCTAssertFalse([cache getMarkedComponents:NULL forNodeID:nodeID]);
+	
+	// A database read that started before a change was committed must be discarded
+	
+	uint64_t generation = cache.generation;
+	
+	[cache applyChanges:@{ nodeID: @(ZDCNodeComponents_Thumbnail) }];
+	[cache setMarkedComponents:0 forNodeID:nodeID ifGenerationMatches:generation];
+	
+	XCTAssertFalse([cache getMarkedComponents:NULL forNodeID:nodeID]);
+	
+	// A database read must not overwrite a newer change
+	
+	generation = cache.generation;
+	[cache setMarkedComponents:0 forNodeID:nodeID ifGenerationMatches:generation];
+	
+	[cache applyChanges:@{ nodeID: @(ZDCNodeComponents_Thumbnail) }];
+	[cache setMarkedComponents:0 forNodeID:nodeID ifGenerationMatches:generation];
+	
+	ZDCNodeComponents components = 0;
+	XCTAssertTrue([cache getMarkedComponents:&components forNodeID:nodeID]);
+	XCTAssert(components == ZDCNodeComponents_Thumbnail);
+}
+
+/**
+ * Measures the number of thumbnail cache hits per second.
+ *
+ * Compares the hit path with a database read per fetch (how the ImageManager used to check the download status),
+ * against a lookup in the ZDCNodeDownloadStatusCache.
+ */
+- (void)test_cacheHitPerformance
+{
+	NSUInteger const count = 5000;
+	NSUInteger const rounds = 20;
+	
+	NSMutableArray<NSString *> *nodeIDs = [NSMutableArray arrayWithCapacity:count];
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		[nodeIDs addObject:[[NSUUID UUID] UUIDString]];
+	}
+	
+	NSCache<NSString*, NSObject*> *thumbnailsCache = [[NSCache alloc] init];
+	ZDCNodeDownloadStatusCache *statusCache = [[ZDCNodeDownloadStatusCache alloc] init];
+	
+	for (NSString *nodeID in nodeIDs)
+	{
+		[thumbnailsCache setObject:[[NSObject alloc] init] forKey:nodeID];
+		[statusCache setMarkedComponents:0 forNodeID:nodeID ifGenerationMatches:statusCache.generation];
+	}
+	
+	NSString *databasePath =
+	  [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+	
+	YapDatabase *database = [[YapDatabase alloc] initWithURL:[NSURL fileURLWithPath:databasePath]];
+	YapDatabaseConnection *connection = [database newConnection];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+	
+		for (NSString *nodeID in nodeIDs)
+		{
+			[transaction setObject:@(0) forKey:nodeID inCollection:@"tags"];
+		}
+	}];
+	
+	NSUInteger willFetchCount = 0;
+	
+	// Before: database read per fetch
+	
+	CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+	
+	for (NSUInteger round = 0; round < rounds; round++)
+	{
+		for (NSString *nodeID in nodeIDs)
+		{
+			__block BOOL isMarked = NO;
+			[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+			
+				NSNumber *tag = [transaction objectForKey:nodeID inCollection:@"tags"];
+				isMarked = ([tag unsignedIntegerValue] & ZDCNodeComponents_Thumbnail) != 0;
+			}];
+			
+			if ([thumbnailsCache objectForKey:nodeID] == nil || isMarked) {
+				willFetchCount++;
+			}
+		}
+	}
+	
+	CFAbsoluteTime databaseElapsed = CFAbsoluteTimeGetCurrent() - start;
+	
+	// After: in-memory lookup
+	
+	start = CFAbsoluteTimeGetCurrent();
+	
+	for (NSUInteger round = 0; round < rounds; round++)
+	{
+		for (NSString *nodeID in nodeIDs)
+		{
+			ZDCNodeComponents components = 0;
+			[statusCache getMarkedComponents:&components forNodeID:nodeID];
+			
+			BOOL isMarked = (components & ZDCNodeComponents_Thumbnail) != 0;
+			
+			if ([thumbnailsCache objectForKey:nodeID] == nil || isMarked) {
+				willFetchCount++;
+			}
+		}
+	}
+	
+	CFAbsoluteTime memoryElapsed = CFAbsoluteTimeGetCurrent() - start;
+	
+	double fetches = (double)(count * rounds);
+	
+	NSLog(@"Thumbnail cache hits: database read(%.0f fetches/sec) in-memory(%.0f fetches/sec)",
+	      fetches / databaseElapsed, fetches / memoryElapsed);
+	
+	XCTAssert(willFetchCount == 0);
+	XCTAssert(memoryElapsed < databaseElapsed);
+	
+	connection = nil;
+	database = nil;
+	[[NSFileManager defaultManager] removeItemAtPath:databasePath error:nil];
+	
+	[self measureBlock:^{
+	
+		for (NSString *nodeID in nodeIDs)
+		{
+			ZDCNodeComponents components = 0;
+			[statusCache getMarkedComponents:&components forNodeID:nodeID];
+			[thumbnailsCache objectForKey:nodeID];
+		}
+	}];
+}
+
+@end
@@ -0,0 +1,411 @@
+/**
+ * ZeroDark.cloud
+ * <GitHub wiki link goes here>
+**/
+
+#import <XCTest/XCTest.h>
+
+#import "ZDCConstants.h"
+#import "ZDCDatabaseManager.h"
+#import "ZDCNodeManager.h"
+#import "ZDCNodePathCache.h"
+#import "ZDCTrunkNodePrivate.h"
+
+#import <YapDatabase/YapDatabase.h>
+#import <YapDatabase/YapDatabaseAutoView.h>
+#import <YapDatabase/YapDatabaseHooks.h>
+
+static NSString *const localUserID = @"z55tqmfr9kix1p1gntotqpwkacpuoyno";
+static NSString *const treeID = @"com.4th-a.test";
+
+@interface test_NodePathCache : XCTestCase
+@end
+
+@implementation test_NodePathCache {
+
+	YapDatabase *database;
+	YapDatabaseConnection *connection;
+	
+	// home:/Photos/2019/IMG.jpg
+	// home:/Docs
+	
+	ZDCTrunkNode *home;
+	ZDCNode *photos;
+	ZDCNode *year;
+	ZDCNode *img;
+	ZDCNode *docs;
+}
+
+- (void)setUp
+{
+	[super setUp];
+	
+	NSString *databasePath =
+	  [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+	
+	database = [[YapDatabase alloc] initWithURL:[NSURL fileURLWithPath:databasePath]];
+	connection = [database newConnection];
+	
+	// The ZDCNodeManager uses the treesystem view to find children by name.
+	// So a stand-in (grouped by parentID, sorted by name) is registered under the same name.
+	
+	YapDatabaseViewGrouping *grouping = [YapDatabaseViewGrouping withObjectBlock:
+		^NSString *(YapDatabaseReadTransaction *transaction, NSString *collection, NSString *key, id object)
+	{
+		return [(ZDCNode *)object parentID];
+	}];
+	
+	YapDatabaseViewSorting *sorting = [YapDatabaseViewSorting withObjectBlock:
+		^(YapDatabaseReadTransaction *transaction, NSString *group,
+		    NSString *collection1, NSString *key1, id obj1,
+		    NSString *collection2, NSString *key2, id obj2)
+	{
+		__unsafe_unretained ZDCNode *node1 = (ZDCNode *)obj1;
+		__unsafe_unretained ZDCNode *node2 = (ZDCNode *)obj2;
+		
+		NSComparisonResult result = [node1.name localizedCaseInsensitiveCompare:node2.name];
+		if (result == NSOrderedSame) {
+			result = [node1.uuid compare:node2.uuid];
+		}
+		
+		return result;
+	}];
+	
+	YapDatabaseViewOptions *options = [[YapDatabaseViewOptions alloc] init];
+	options.allowedCollections =
+	  [[YapWhitelistBlacklist alloc] initWithWhitelist:[NSSet setWithObject:kZDCCollection_Nodes]];
+	
+	YapDatabaseAutoView *view =
+	  [[YapDatabaseAutoView alloc] initWithGrouping:grouping sorting:sorting versionTag:@"1" options:options];
+	
+	XCTAssertTrue([database registerExtension:view withName:Ext_View_Treesystem_Name]);
+	
+	// In the framework, node modifications are reported to the cache by ZDCCloudTransaction.
+	// Here they're reported by a stand-in hooks extension.
+	
+	YapDatabaseHooks *hooks = [[YapDatabaseHooks alloc] init];
+	hooks.allowedCollections =
+	  [[YapWhitelistBlacklist alloc] initWithWhitelist:[NSSet setWithObject:kZDCCollection_Nodes]];
+	
+	hooks.didModifyRow = ^(YapDatabaseReadWriteTransaction *transaction, NSString *collection, NSString *key,
+	                       YapProxyObject *proxyObject, YapProxyObject *proxyMetadata,
+	                       YapDatabaseHooksBitMask flags)
+	{
+		[[ZDCNodePathCache existingCacheForTransaction:transaction] didUpdateNode:proxyObject.realObject
+		                                                              transaction:transaction];
+	};
+	
+	hooks.didRemoveRow = ^(YapDatabaseReadWriteTransaction *transaction, NSString *collection, NSString *key) {
+	
+		[[ZDCNodePathCache existingCacheForTransaction:transaction] didRemoveNodeID:key
+		                                                                transaction:transaction];
+	};
+	
+	XCTAssertTrue([database registerExtension:hooks withName:@"test:hooks"]);
+	
+	home = [[ZDCTrunkNode alloc] initWithLocalUserID:localUserID treeID:treeID trunk:ZDCTreesystemTrunk_Home];
+	
+	photos = [self nodeNamed:@"Photos" parent:home];
+	year   = [self nodeNamed:@"2019" parent:photos];
+	img    = [self nodeNamed:@"IMG.jpg" parent:year];
+	docs   = [self nodeNamed:@"Docs" parent:home];
+	
+	NSArray<ZDCNode *> *nodes = @[ home, photos, year, img, docs ];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+	
+		for (ZDCNode *node in nodes) {
+			[transaction setObject:node forKey:node.uuid inCollection:kZDCCollection_Nodes];
+		}
+	}];
+}
+
+- (void)tearDown
+{
+	connection = nil;
+	database = nil;
+	
+	[super tearDown];
+}
+
+- (ZDCNode *)nodeNamed:(NSString *)name parent:(ZDCNode *)parent
+{
+	ZDCNode *node = [[ZDCNode alloc] initWithLocalUserID:localUserID];
+	node.parentID = parent.uuid;
+	node.name = name;
+	
+	return node;
+}
+
+- (ZDCNode *)update:(ZDCNode *)node name:(NSString *)name parent:(ZDCNode *)parent
+{
+	node = [node copy];
+	node.name = name;
+	node.parentID = parent.uuid;
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+	
+		[transaction setObject:node forKey:node.uuid inCollection:kZDCCollection_Nodes];
+	}];
+	
+	return node;
+}
+
+- (ZDCTreesystemPath *)path:(NSArray<NSString *> *)components
+{
+	return [[ZDCTreesystemPath alloc] initWithPathComponents:components trunk:ZDCTreesystemTrunk_Home];
+}
+
+- (NSString *)findNodeWithPath:(ZDCTreesystemPath *)path transaction:(YapDatabaseReadTransaction *)transaction
+{
+	ZDCNode *node =
+	  [[ZDCNodeManager sharedInstance] findNodeWithPath: path
+	                                        localUserID: localUserID
+	                                             treeID: treeID
+	                                        transaction: transaction];
+	
+	return node.uuid;
+}
+
+- (NSString *)findNodeWithPath:(ZDCTreesystemPath *)path
+{
+	__block NSString *nodeID = nil;
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+	
+		nodeID = [self findNodeWithPath:path transaction:transaction];
+	}];
+	
+	return nodeID;
+}
+
+- (NSString *)pathForNode:(ZDCNode *)node transaction:(YapDatabaseReadTransaction *)transaction
+{
+	return [[ZDCNodeManager sharedInstance] pathForNode:node transaction:transaction].fullPath;
+}
+
+- (NSString *)pathForNode:(ZDCNode *)node
+{
+	__block NSString *path = nil;
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+	
+		path = [self pathForNode:node transaction:transaction];
+	}];
+	
+	return path;
+}
+
+- (ZDCNodePathCache *)cache
+{
+	__block ZDCNodePathCache *cache = nil;
+	[connection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+	
+		cache = [ZDCNodePathCache cacheForTransaction:transaction];
+	}];
+	
+	return cache;
+}
+
+/**
+ * Populates the cache with the edges & paths for home:/Photos/2019/IMG.jpg
+ */
+- (void)warmCache
+{
+	XCTAssertEqualObjects([self findNodeWithPath:[self path:@[ @"Photos", @"2019", @"IMG.jpg" ]]], img.uuid);
+	XCTAssertEqualObjects([self pathForNode:img], @"home:/Photos/2019/IMG.jpg");
+	
+	XCTAssert(self.cache.edgeCount == 3);
+	XCTAssert(self.cache.pathCount == 3); // home, Photos, 2019
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Invalidation
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)test_cacheHit
+{
+	[self warmCache];
+	
+	// Repeated lookups are served from the cache, and don't add anything
+	
+	XCTAssertEqualObjects([self findNodeWithPath:[self path:@[ @"Photos", @"2019", @"IMG.jpg" ]]], img.uuid);
+	XCTAssertEqualObjects([self findNodeWithPath:[self path:@[ @"photos", @"2019", @"img.JPG" ]]], img.uuid);
+	XCTAssertEqualObjects([self pathForNode:img], @"home:/Photos/2019/IMG.jpg");
+	
+	XCTAssert(self.cache.edgeCount == 3);
+	XCTAssert(self.cache.pathCount == 3);
+}
+
+- (void)test_renameAncestor
+{
+	[self warmCache];
+	
+	photos = [self update:photos name:@"Pictures" parent:home];
+	
+	XCTAssertNil([self findNodeWithPath:[self path:@[ @"Photos", @"2019", @"IMG.jpg" ]]]);
+	XCTAssertEqualObjects([self findNodeWithPath:[self path:@[ @"Pictures", @"2019", @"IMG.jpg" ]]], img.uuid);
+	
+	XCTAssertEqualObjects([self pathForNode:img], @"home:/Pictures/2019/IMG.jpg");
+	XCTAssertEqualObjects([self pathForNode:year], @"home:/Pictures/2019");
+}
+
+- (void)test_moveAncestor
+{
+	[self warmCache];
+	
+	year = [self update:year name:year.name parent:docs];
+	
+	XCTAssertNil([self findNodeWithPath:[self path:@[ @"Photos", @"2019", @"IMG.jpg" ]]]);
+	XCTAssertEqualObjects([self findNodeWithPath:[self path:@[ @"Docs", @"2019", @"IMG.jpg" ]]], img.uuid);
+	
+	XCTAssertEqualObjects([self pathForNode:img], @"home:/Docs/2019/IMG.jpg");
+}
+
+- (void)test_deleteAncestor
+{
+	[self warmCache];
+	
+	NSString *yearID = year.uuid;
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+	
+		[transaction removeObjectForKey:yearID inCollection:kZDCCollection_Nodes];
+	}];
+	
+	XCTAssertNil([self findNodeWithPath:[self path:@[ @"Photos", @"2019", @"IMG.jpg" ]]]);
+	XCTAssertNotEqualObjects([self pathForNode:img], @"home:/Photos/2019/IMG.jpg");
+	
+	// A new node at the same path must be found (rather than the deleted one)
+	
+	ZDCNode *newYear = [self nodeNamed:@"2019" parent:photos];
+	ZDCNode *newImg = [self nodeNamed:@"IMG.jpg" parent:newYear];
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+	
+		[transaction setObject:newYear forKey:newYear.uuid inCollection:kZDCCollection_Nodes];
+		[transaction setObject:newImg forKey:newImg.uuid inCollection:kZDCCollection_Nodes];
+	}];
+	
+	XCTAssertEqualObjects([self findNodeWithPath:[self path:@[ @"Photos", @"2019", @"IMG.jpg" ]]], newImg.uuid);
+	XCTAssertEqualObjects([self pathForNode:newImg], @"home:/Photos/2019/IMG.jpg");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Transactions
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)test_olderSnapshot
+{
+	YapDatabaseConnection *oldConnection = [database newConnection];
+	
+	ZDCNode *_photos = photos;
+	ZDCNode *_home = home;
+	ZDCNode *_img = img;
+	NSString *imgID = img.uuid;
+	
+	[oldConnection readWithBlock:^(YapDatabaseReadTransaction *oldTransaction) {
+	
+		XCTAssert([oldTransaction hasObjectForKey:imgID inCollection:kZDCCollection_Nodes]);
+		
+		// Meanwhile, a newer snapshot renames "Photos", and populates the cache
+		
+		[self update:_photos name:@"Pictures" parent:_home];
+		
+		XCTAssertEqualObjects([self findNodeWithPath:[self path:@[ @"Pictures", @"2019", @"IMG.jpg" ]]], imgID);
+		XCTAssertEqualObjects([self pathForNode:_img], @"home:/Pictures/2019/IMG.jpg");
+		
+		NSUInteger edgeCount = self.cache.edgeCount;
+		NSUInteger pathCount = self.cache.pathCount;
+		
+		// The older snapshot must not use the cache...
+		
+		XCTAssertNil([self findNodeWithPath:[self path:@[ @"Pictures", @"2019", @"IMG.jpg" ]] transaction:oldTransaction]);
+		XCTAssertEqualObjects([self findNodeWithPath:[self path:@[ @"Photos", @"2019", @"IMG.jpg" ]]
+		                                 transaction:oldTransaction], imgID);
+		
+		ZDCNode *oldImg = [oldTransaction objectForKey:imgID inCollection:kZDCCollection_Nodes];
+		XCTAssertEqualObjects([self pathForNode:oldImg transaction:oldTransaction], @"home:/Photos/2019/IMG.jpg");
+		
+		// ... or populate it
+		
+		XCTAssert(self.cache.edgeCount == edgeCount);
+		XCTAssert(self.cache.pathCount == pathCount);
+	}];
+	
+	XCTAssertEqualObjects([self findNodeWithPath:[self path:@[ @"Pictures", @"2019", @"IMG.jpg" ]]], img.uuid);
+	XCTAssertEqualObjects([self pathForNode:img], @"home:/Pictures/2019/IMG.jpg");
+}
+
+- (void)test_readWriteDoesNotPopulate
+{
+	ZDCNode *_img = img;
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+	
+		XCTAssertEqualObjects([self findNodeWithPath:[self path:@[ @"Photos", @"2019", @"IMG.jpg" ]]
+		                                 transaction:transaction], _img.uuid);
+		XCTAssertEqualObjects([self pathForNode:_img transaction:transaction], @"home:/Photos/2019/IMG.jpg");
+		
+		ZDCNodePathCache *cache = [ZDCNodePathCache cacheForTransaction:transaction];
+		XCTAssert(cache.edgeCount == 0);
+		XCTAssert(cache.pathCount == 0);
+	}];
+	
+	XCTAssert(self.cache.edgeCount == 0);
+	XCTAssert(self.cache.pathCount == 0);
+}
+
+- (void)test_readWriteSeesOwnChanges
+{
+	[self warmCache];
+	
+	ZDCNode *renamed = [photos copy];
+	renamed.name = @"Pictures";
+	
+	ZDCNode *_img = img;
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+	
+		[transaction setObject:renamed forKey:renamed.uuid inCollection:kZDCCollection_Nodes];
+		
+		XCTAssertNil([self findNodeWithPath:[self path:@[ @"Photos", @"2019", @"IMG.jpg" ]] transaction:transaction]);
+		XCTAssertEqualObjects([self findNodeWithPath:[self path:@[ @"Pictures", @"2019", @"IMG.jpg" ]]
+		                                 transaction:transaction], _img.uuid);
+		XCTAssertEqualObjects([self pathForNode:_img transaction:transaction], @"home:/Pictures/2019/IMG.jpg");
+	}];
+	
+	XCTAssertEqualObjects([self pathForNode:img], @"home:/Pictures/2019/IMG.jpg");
+}
+
+- (void)test_rollback
+{
+	[self warmCache];
+	
+	ZDCNode *renamed = [photos copy];
+	renamed.name = @"Pictures";
+	
+	ZDCNode *_img = img;
+	
+	[connection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+	
+		[transaction setObject:renamed forKey:renamed.uuid inCollection:kZDCCollection_Nodes];
+		
+		XCTAssertEqualObjects([self pathForNode:_img transaction:transaction], @"home:/Pictures/2019/IMG.jpg");
+		
+		[transaction rollback];
+	}];
+	
+	// Nothing from the rolled back transaction may linger in the cache
+	
+	XCTAssertNil([self findNodeWithPath:[self path:@[ @"Pictures", @"2019", @"IMG.jpg" ]]]);
+	XCTAssertEqualObjects([self findNodeWithPath:[self path:@[ @"Photos", @"2019", @"IMG.jpg" ]]], img.uuid);
+	XCTAssertEqualObjects([self pathForNode:img], @"home:/Photos/2019/IMG.jpg");
+	
+	// The rolled back transaction didn't produce a new snapshot.
+	// So the cache sits idle until the next commit, after which it repopulates as usual.
+	
+	docs = [self update:docs name:docs.name parent:home];
+	
+	[self warmCache];
+}
+
+@end
@@ -0,0 +1,344 @@
+/**
+ * ZeroDark.cloud
+ * <GitHub wiki link goes here>
+**/
+
+#import <XCTest/XCTest.h>
+
+#import "ZDCProxyFetch.h"
+#import "ZDCPullState.h"
+
+@interface ZDCPullState ()
+- (instancetype)initWithLocalUserID:(NSString *)localUserID treeID:(NSString *)treeID;
+@end
+
+/**
+ * A local stand-in for the API gateway.
+ * Serves the fetch-proxy from an in-memory set of files, or replies with a canned response.
+ */
+@interface ZDCFakeProxyGateway : NSObject
+
+@property (atomic, assign, readwrite) NSInteger statusCode;   // 0 => no reply (network error)
+@property (atomic, strong, readwrite) id cannedResponseObject; // if nil, serves `files`
+@property (atomic, strong, readwrite) NSDictionary<NSString*, NSData*> *files;
+
+@property (atomic, assign, readonly) NSUInteger requestCount;
+@property (atomic, strong, readonly) NSArray<NSArray<NSString*>*> *requestedPaths;
+
+- (ZDCProxyFetchTransport)transport;
+
+@end
+
+@implementation ZDCFakeProxyGateway {
+
+	NSMutableArray<NSArray<NSString*>*> *requests;
+}
+
+@synthesize statusCode;
+@synthesize cannedResponseObject;
+@synthesize files;
+@dynamic requestCount;
+@dynamic requestedPaths;
+
+- (instancetype)init
+{
+	if ((self = [super init]))
+	{
+		statusCode = 200;
+		requests = [[NSMutableArray alloc] init];
+	}
+	return self;
+}
+
+- (NSUInteger)requestCount
+{
+	@synchronized (self) {
+		return requests.count;
+	}
+}
+
+- (NSArray<NSArray<NSString*>*> *)requestedPaths
+{
+	@synchronized (self) {
+		return [requests copy];
+	}
+}
+
+- (ZDCProxyFetchTransport)transport
+{
+	__weak ZDCFakeProxyGateway *weakSelf = self;
+	
+	return ^(NSArray<NSString *> *paths, NSString *bucket, AWSRegion region, ZDCPullState *pullState,
+	         ZDCProxyFetchTransportCompletion completion)
+	{
+		ZDCFakeProxyGateway *gateway = weakSelf;
+		@synchronized (gateway) {
+			[gateway->requests addObject:paths];
+		}
+		
+		NSInteger status = gateway.statusCode;
+		if (status == 0)
+		{
+			NSError *error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorNotConnectedToInternet userInfo:nil];
+			completion(nil, nil, error);
+			return;
+		}
+		
+		NSURL *url = [NSURL URLWithString:@"https://gateway.test/fetchProxy"];
+		NSHTTPURLResponse *response =
+		  [[NSHTTPURLResponse alloc] initWithURL:url statusCode:status HTTPVersion:@"HTTP/1.1" headerFields:nil];
+		
+		id responseObject = gateway.cannedResponseObject;
+		if (responseObject == nil)
+		{
+			NSMutableDictionary *served = [NSMutableDictionary dictionary];
+			for (NSString *path in paths)
+			{
+				NSData *data = gateway.files[path];
+				if (data)
+				{
+					served[path] = @{
+						@"data"        : [data base64EncodedStringWithOptions:0],
+						@"eTag"        : [NSString stringWithFormat:@"\"etag-%@\"", path],
+						@"lastModified": @"2019-06-01T12:00:00.000Z"
+					};
+				}
+			}
+			responseObject = @{ @"files": served };
+		}
+		
+		dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+			completion(response, responseObject, nil);
+		});
+	};
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface test_ProxyFetch : XCTestCase
+@end
+
+static NSString *const treeID = @"com.4th-a.test";
+static NSString *const bucket = @"com.4th-a.user.z55tqmfr9kix1p1gntotqpwkacpuoyno-35a6b2bc";
+
+@implementation test_ProxyFetch
+
+- (ZDCPullState *)pullState
+{
+	return [[ZDCPullState alloc] initWithLocalUserID:@"z55tqmfr9kix1p1gntotqpwkacpuoyno" treeID:treeID];
+}
+
+- (NSString *)fullPath:(NSString *)relativePath
+{
+	return [NSString stringWithFormat:@"%@/%@", treeID, relativePath];
+}
+
+/**
+ * Fetches all the given paths concurrently, and waits for every completion.
+ * Returns the items, keyed by relative path. (Missing items map to NSNull.)
+ */
+- (NSDictionary<NSString*, id> *)fetch:(NSArray<NSString*> *)paths
+                                  with:(ZDCProxyFetch *)proxyFetch
+                             pullState:(ZDCPullState *)pullState
+{
+	NSMutableDictionary *results = [NSMutableDictionary dictionary];
+	NSMutableArray<XCTestExpectation*> *expectations = [NSMutableArray array];
+	
+	for (NSString *path in paths)
+	{
+		XCTestExpectation *expectation = [self expectationWithDescription:path];
+		[expectations addObject:expectation];
+		
+		[proxyFetch fetchRcrdWithPath: [self fullPath:path]
+		                       bucket: bucket
+		                       region: AWSRegion_US_West_2
+		                    pullState: pullState
+		              completionQueue: dispatch_get_main_queue()
+		              completionBlock:^(ZDCProxyFetchItem *item)
+		{
+			results[path] = item ?: [NSNull null];
+			[expectation fulfill];
+		}];
+	}
+	
+	[self waitForExpectations:expectations timeout:5.0];
+	return results;
+}
+
+- (void)test_batching
+{
+	ZDCFakeProxyGateway *gateway = [[ZDCFakeProxyGateway alloc] init];
+	gateway.files = @{
+		@"dirA/one.rcrd"   : [@"{\"one\":1}" dataUsingEncoding:NSUTF8StringEncoding],
+		@"dirA/two.rcrd"   : [@"{\"two\":2}" dataUsingEncoding:NSUTF8StringEncoding],
+		@"dirB/three.rcrd" : [@"{\"three\":3}" dataUsingEncoding:NSUTF8StringEncoding],
+	};
+	
+	ZDCProxyFetch *proxyFetch = [[ZDCProxyFetch alloc] initWithTransport:[gateway transport]];
+	
+	NSArray *paths = @[ @"dirA/one.rcrd", @"dirA/two.rcrd", @"dirB/three.rcrd", @"dirB/missing.rcrd" ];
+	NSDictionary *results = [self fetch:paths with:proxyFetch pullState:[self pullState]];
+	
+	// All concurrent fetches are coalesced into a single request, using paths relative to the treeID
+	
+	XCTAssert(gateway.requestCount == 1);
+	XCTAssert([[NSSet setWithArray:gateway.requestedPaths[0]] isEqualToSet:[NSSet setWithArray:paths]]);
+	
+	for (NSString *path in gateway.files)
+	{
+		ZDCProxyFetchItem *item = results[path];
+		
+		XCTAssert([item isKindOfClass:[ZDCProxyFetchItem class]]);
+		XCTAssert([item.path isEqualToString:[self fullPath:path]]);
+		XCTAssert([item.data isEqualToData:gateway.files[path]]);
+		XCTAssert(item.eTag.length > 0);
+		XCTAssert(item.lastModified != nil);
+	}
+	
+	// Paths the gateway doesn't serve fall back to a direct fetch
+	
+	XCTAssert(results[@"dirB/missing.rcrd"] == [NSNull null]);
+	
+	// And the proxy is still used afterwards
+	
+	[self fetch:@[ @"dirA/one.rcrd" ] with:proxyFetch pullState:[self pullState]];
+	XCTAssert(gateway.requestCount == 2);
+}
+
+- (void)test_maxBatchSize
+{
+	ZDCFakeProxyGateway *gateway = [[ZDCFakeProxyGateway alloc] init];
+	ZDCProxyFetch *proxyFetch = [[ZDCProxyFetch alloc] initWithTransport:[gateway transport]];
+	
+	NSMutableArray *paths = [NSMutableArray array];
+	for (NSUInteger i = 0; i < 250; i++)
+	{
+		[paths addObject:[NSString stringWithFormat:@"dir/%lu.rcrd", (unsigned long)i]];
+	}
+	
+	[self fetch:paths with:proxyFetch pullState:[self pullState]];
+	
+	XCTAssert(gateway.requestCount == 3);
+	for (NSArray *batch in gateway.requestedPaths)
+	{
+		XCTAssert(batch.count <= 100);
+	}
+}
+
+/**
+ * API Gateway replies with a 403 ("Missing Authentication Token") for a resource that isn't deployed.
+ */
+- (void)test_unsupported_403
+{
+	ZDCFakeProxyGateway *gateway = [[ZDCFakeProxyGateway alloc] init];
+	gateway.statusCode = 403;
+	gateway.cannedResponseObject = @{ @"message": @"Missing Authentication Token" };
+	
+	[self _testUnsupportedWithGateway:gateway];
+}
+
+- (void)test_unsupported_404
+{
+	ZDCFakeProxyGateway *gateway = [[ZDCFakeProxyGateway alloc] init];
+	gateway.statusCode = 404;
+	gateway.cannedResponseObject = [@"<html>Not Found</html>" dataUsingEncoding:NSUTF8StringEncoding];
+	
+	[self _testUnsupportedWithGateway:gateway];
+}
+
+- (void)_testUnsupportedWithGateway:(ZDCFakeProxyGateway *)gateway
+{
+	gateway.files = @{ @"dir/a.rcrd": [NSData dataWithBytes:"a" length:1] };
+	
+	ZDCProxyFetch *proxyFetch = [[ZDCProxyFetch alloc] initWithTransport:[gateway transport]];
+	
+	NSDictionary *results = [self fetch:@[ @"dir/a.rcrd" ] with:proxyFetch pullState:[self pullState]];
+	XCTAssert(results[@"dir/a.rcrd"] == [NSNull null]);
+	XCTAssert(gateway.requestCount == 1);
+	
+	// The region is now known to be unsupported: subsequent fetches skip the gateway entirely
+	
+	results = [self fetch:@[ @"dir/a.rcrd", @"dir/b.rcrd" ] with:proxyFetch pullState:[self pullState]];
+	XCTAssert(results[@"dir/a.rcrd"] == [NSNull null]);
+	XCTAssert(results[@"dir/b.rcrd"] == [NSNull null]);
+	XCTAssert(gateway.requestCount == 1);
+}
+
+- (void)test_networkError
+{
+	ZDCFakeProxyGateway *gateway = [[ZDCFakeProxyGateway alloc] init];
+	gateway.files = @{ @"dir/a.rcrd": [NSData dataWithBytes:"a" length:1] };
+	gateway.statusCode = 0;
+	
+	ZDCProxyFetch *proxyFetch = [[ZDCProxyFetch alloc] initWithTransport:[gateway transport]];
+	
+	NSDictionary *results = [self fetch:@[ @"dir/a.rcrd" ] with:proxyFetch pullState:[self pullState]];
+	XCTAssert(results[@"dir/a.rcrd"] == [NSNull null]);
+	
+	// No reply from the gateway only fails that batch
+	
+	gateway.statusCode = 200;
+	
+	results = [self fetch:@[ @"dir/a.rcrd" ] with:proxyFetch pullState:[self pullState]];
+	XCTAssert([results[@"dir/a.rcrd"] isKindOfClass:[ZDCProxyFetchItem class]]);
+	XCTAssert(gateway.requestCount == 2);
+}
+
+- (void)test_unavailable_503
+{
+	ZDCFakeProxyGateway *gateway = [[ZDCFakeProxyGateway alloc] init];
+	gateway.statusCode = 503;
+	gateway.cannedResponseObject = @{ @"message": @"Service Unavailable" };
+	
+	[self _testTransientFailureWithGateway:gateway];
+}
+
+- (void)test_invalidResponse
+{
+	ZDCFakeProxyGateway *gateway = [[ZDCFakeProxyGateway alloc] init];
+	gateway.statusCode = 200;
+	gateway.cannedResponseObject = [@"<html>Bad Gateway</html>" dataUsingEncoding:NSUTF8StringEncoding];
+	
+	[self _testTransientFailureWithGateway:gateway];
+}
+
+- (void)_testTransientFailureWithGateway:(ZDCFakeProxyGateway *)gateway
+{
+	gateway.files = @{ @"dir/a.rcrd": [NSData dataWithBytes:"a" length:1] };
+	
+	ZDCProxyFetch *proxyFetch = [[ZDCProxyFetch alloc] initWithTransport:[gateway transport]];
+	
+	NSDictionary *results = [self fetch:@[ @"dir/a.rcrd" ] with:proxyFetch pullState:[self pullState]];
+	XCTAssert(results[@"dir/a.rcrd"] == [NSNull null]);
+	XCTAssert(gateway.requestCount == 1);
+	
+	// Only that batch failed: the next batch still goes through the proxy (after backing off)
+	
+	gateway.statusCode = 200;
+	gateway.cannedResponseObject = nil;
+	
+	NSDate *start = [NSDate date];
+	
+	results = [self fetch:@[ @"dir/a.rcrd" ] with:proxyFetch pullState:[self pullState]];
+	XCTAssert([results[@"dir/a.rcrd"] isKindOfClass:[ZDCProxyFetchItem class]]);
+	XCTAssert(gateway.requestCount == 2);
+	
+	NSTimeInterval elapsed = [[NSDate date] timeIntervalSinceDate:start];
+	XCTAssert(elapsed >= 0.25, @"elapsed: %f", elapsed);
+	
+	// A successful batch resets the backoff
+	
+	start = [NSDate date];
+	
+	results = [self fetch:@[ @"dir/a.rcrd" ] with:proxyFetch pullState:[self pullState]];
+	XCTAssert([results[@"dir/a.rcrd"] isKindOfClass:[ZDCProxyFetchItem class]]);
+	XCTAssert(gateway.requestCount == 3);
+	
+	NSLog(@"Fetch after successful batch: %.3f seconds", [[NSDate date] timeIntervalSinceDate:start]);
+}
+
+@end
@@ -7,6 +7,7 @@
 
 #import <ZeroDarkCloud/ZeroDarkCloud.h>
 #import <ZeroDarkCloud/ZDCNodePrivate.h>
+#import <ZeroDarkCloud/CloudFile2CacheFileWriter.h>
 
 @interface test_Streams : XCTestCase
 @end
@@ -586,6 +587,128 @@ abort:
 	}
 }
 
+/**
+ * Feeds a cloudFile (with metadata & thumbnail sections) into a CloudFile2CacheFileWriter using odd-sized chunks,
+ * as would happen when streaming from the network.
+ * The result should be identical to the original cacheFile.
+ */
+- (void)test_CloudFile2CacheFileWriter
+{
+	NSURL *testFilesURL = [[NSBundle bundleForClass:[self class]] URLForResource:@"Test Files" withExtension:nil];
+	
+	NSDirectoryEnumerator<NSURL *> *enumerator =
+	  [[NSFileManager defaultManager] enumeratorAtURL:testFilesURL
+	                       includingPropertiesForKeys:nil
+	                                          options:NSDirectoryEnumerationSkipsSubdirectoryDescendants
+	                                     errorHandler:nil];
+	
+	NSData *metadata = [self rawMetadata];
+	NSData *thumbnail = [self rawThumbnail];
+	
+	NSUInteger const chunkSizes[] = { 1, 7, 63, 64, 65, 1023, 4096, 65537 };
+	NSUInteger const chunkSizesCount = sizeof(chunkSizes) / sizeof(chunkSizes[0]);
+	
+	for (NSURL *fileURL in enumerator)
+	{
+		ZDCNode *node = [[ZDCNode alloc] initWithLocalUserID:@"abc123"];
+		
+		NSError *error = nil;
+		NSURL *cacheFile1URL = nil;
+		NSURL *cloudFileURL  = nil;
+		NSURL *cacheFile2URL = [NSURL fileURLWithPath:
+		  [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]]];
+		
+		cacheFile1URL = [self _convertCleartextFile:fileURL toCacheFileFor:node error:&error];
+		XCTAssert(cacheFile1URL != nil);
+		
+		if (cacheFile1URL)
+		{
+			__block NSURL *outFileURL = nil;
+			
+			dispatch_queue_t bgQueue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+			dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+			
+			[ZDCFileConversion convertCacheFile: cacheFile1URL
+			                        retainToken: nil
+			                      encryptionKey: node.encryptionKey
+			                 toCloudFileWithKey: node.encryptionKey
+			                           metadata: metadata
+			                          thumbnail: thumbnail
+			                    completionQueue: bgQueue
+			                    completionBlock:^(NSURL *outputFileURL, NSError *error)
+			{
+				outFileURL = outputFileURL;
+				dispatch_semaphore_signal(semaphore);
+			}];
+			
+			dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+			
+			cloudFileURL = outFileURL;
+			XCTAssert(cloudFileURL != nil);
+		}
+		
+		if (cloudFileURL)
+		{
+			NSData *cloudFileData = [NSData dataWithContentsOfURL:cloudFileURL];
+			
+			CloudFile2CacheFileWriter *writer =
+			  [[CloudFile2CacheFileWriter alloc] initWithCacheFileURL: cacheFile2URL
+			                                            encryptionKey: node.encryptionKey];
+			
+			NSUInteger offset = 0;
+			NSUInteger chunkIndex = 0;
+			
+			while (offset < cloudFileData.length)
+			{
+				NSUInteger length = MIN(chunkSizes[chunkIndex++ % chunkSizesCount], cloudFileData.length - offset);
+				
+				BOOL result = [writer writeCloudFileData: [cloudFileData subdataWithRange:NSMakeRange(offset, length)]
+				                                   error: &error];
+				XCTAssert(result, @"Error: %@", error);
+				
+				offset += length;
+			}
+			
+			XCTAssert(writer.hasCloudFileHeader);
+			XCTAssert(writer.cloudFileHeader.metadataSize == metadata.length);
+			XCTAssert(writer.cloudFileHeader.thumbnailSize == thumbnail.length);
+			
+			BOOL finished = [writer finish:&error];
+			XCTAssert(finished, @"Error: %@", error);
+			
+			BOOL same = [[NSFileManager defaultManager] contentsEqualAtPath:[cacheFile1URL path]
+			                                                        andPath:[cacheFile2URL path]];
+			
+			XCTAssert(same, @"CacheFile diff: %@", [fileURL lastPathComponent]);
+			
+			// Truncated input must be rejected
+			
+			if (cloudFileData.length > node.encryptionKey.length)
+			{
+				NSUInteger truncatedLength = cloudFileData.length - node.encryptionKey.length;
+				
+				CloudFile2CacheFileWriter *truncatedWriter =
+				  [[CloudFile2CacheFileWriter alloc] initWithCacheFileURL: cacheFile2URL
+				                                            encryptionKey: node.encryptionKey];
+				
+				[truncatedWriter writeCloudFileData: [cloudFileData subdataWithRange:NSMakeRange(0, truncatedLength)]
+				                              error: nil];
+				
+				XCTAssertFalse([truncatedWriter finish:nil]);
+				XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:[cacheFile2URL path]]);
+			}
+		}
+		
+		if (cacheFile1URL) {
+			[[NSFileManager defaultManager] removeItemAtURL:cacheFile1URL error:nil];
+		}
+		if (cloudFileURL) {
+			[[NSFileManager defaultManager] removeItemAtURL:cloudFileURL error:nil];
+		}
+		[[NSFileManager defaultManager] removeItemAtURL:cacheFile2URL error:nil];
+	}
+}
+
 - (NSURL *)_convertCleartextFile:(NSURL *)cleartextFileURL
                   toCacheFileFor:(ZDCNode *)node
                            error:(NSError **)errorPtr
@@ -0,0 +1,136 @@
+/**
+ * ZeroDark.cloud
+ * <GitHub wiki link goes here>
+**/
+
+#import <XCTest/XCTest.h>
+
+#import <ZeroDarkCloud/ZeroDarkCloud.h>
+#import <ZeroDarkCloud/ZDCTransferCounters.h>
+
+@interface test_TransferCounters : XCTestCase
+@end
+
+@implementation test_TransferCounters
+
+- (void)test_concurrentAdds
+{
+	ZDCTransferCounters *all = [[ZDCTransferCounters alloc] initWithParent:nil];
+	ZDCTransferCounters *alice = [[ZDCTransferCounters alloc] initWithParent:all];
+	ZDCTransferCounters *bob = [[ZDCTransferCounters alloc] initWithParent:all];
+	
+	size_t const iterations = 100000;
+	
+	dispatch_apply(iterations, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+	
+		ZDCTransferCounters *counters = (i % 2 == 0) ? alice : bob;
+		
+		[counters addBytesSent:1];
+		[counters addBytesReceived:2];
+		[counters addBytesReceived:-5]; // ignored
+	});
+	
+	XCTAssert(alice.bytesSent == iterations / 2);
+	XCTAssert(alice.bytesReceived == iterations);
+	XCTAssert(bob.bytesSent == iterations / 2);
+	XCTAssert(bob.bytesReceived == iterations);
+	
+	XCTAssert(all.bytesSent == iterations);
+	XCTAssert(all.bytesReceived == iterations * 2);
+}
+
+- (void)test_sampling
+{
+	ZDCTransferCounters *counters = [[ZDCTransferCounters alloc] initWithParent:nil];
+	counters.minSampleInterval = 0.25;
+	
+	double up = -1;
+	double down = -1;
+	CFAbsoluteTime now = 1000;
+	
+	// First sample establishes the baseline
+	
+	[counters sampleAtTime:now uploadThroughput:&up downloadThroughput:&down];
+	XCTAssert(up == 0);
+	XCTAssert(down == 0);
+	
+	// Steady rate: 1,000 bytes/sec up, 4,000 bytes/sec down
+	
+	for (NSUInteger i = 0; i < 50; i++)
+	{
+		[counters addBytesSent:500];
+		[counters addBytesReceived:2000];
+		now += 0.5;
+		
+		[counters sampleAtTime:now uploadThroughput:&up downloadThroughput:&down];
+	}
+	
+	XCTAssertEqualWithAccuracy(up, 1000, 1);
+	XCTAssertEqualWithAccuracy(down, 4000, 1);
+	
+	// Samples closer together than minSampleInterval return the previous values
+	
+	[counters addBytesReceived:1000000];
+	
+	double down2 = 0;
+	[counters sampleAtTime:(now + 0.1) uploadThroughput:NULL downloadThroughput:&down2];
+	XCTAssert(down2 == down);
+	
+	// Stalled connection decays toward zero
+	
+	for (NSUInteger i = 0; i < 50; i++)
+	{
+		now += 0.5;
+		[counters sampleAtTime:now uploadThroughput:&up downloadThroughput:&down];
+	}
+	
+	XCTAssertEqualWithAccuracy(up, 0, 1);
+	XCTAssertEqualWithAccuracy(down, 0, 1);
+}
+
+/**
+ * Compares the cost of reporting a chunk via the atomic counters,
+ * versus updating an NSProgress (which is what every network callback used to pay for).
+ */
+- (void)test_benchmark
+{
+	size_t const iterations = 1000000;
+	
+	ZDCTransferCounters *counters = [[ZDCTransferCounters alloc] initWithParent:
+	                                  [[ZDCTransferCounters alloc] initWithParent:nil]];
+	
+	NSProgress *progress = [NSProgress progressWithTotalUnitCount:(int64_t)iterations];
+	
+	__block CFAbsoluteTime countersTime = 0;
+	__block CFAbsoluteTime progressTime = 0;
+	
+	[self measureBlock:^{
+	
+		CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+		
+		dispatch_apply(iterations, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+		
+			[counters addBytesReceived:1];
+		});
+		
+		CFAbsoluteTime mid = CFAbsoluteTimeGetCurrent();
+		
+		progress.completedUnitCount = 0;
+		dispatch_apply(iterations, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+		
+			@synchronized (progress) {
+				progress.completedUnitCount += 1;
+			}
+		});
+		
+		CFAbsoluteTime end = CFAbsoluteTimeGetCurrent();
+		
+		countersTime = mid - start;
+		progressTime = end - mid;
+	}];
+	
+	NSLog(@"Atomic counters: %.0f updates/sec", (double)iterations / countersTime);
+	NSLog(@"NSProgress     : %.0f updates/sec", (double)iterations / progressTime);
+}
+
+@end
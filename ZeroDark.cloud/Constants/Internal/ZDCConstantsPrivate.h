@@ -14,11 +14,16 @@ NS_ASSUME_NONNULL_BEGIN
 
 extern NSString *const kZDCDirPrefix_Fake; // Used for "static" nodes with a fixed set of children
 
+extern NSString *const kZDCCollection_PullCheckpoint; // Progress of an in-flight full pull (see ZDCPullCheckpoint)
+
 extern NSString *const kZDCContext_Conflict;
 
 extern NSString *const ZDCSkippedOperationsNotification;
 extern NSString *const ZDCSkippedOperationsNotification_UserInfo_Ops;
 
+extern NSString *const ZDCNodeDownloadStatusChangedNotification;
+extern NSString *const ZDCNodeDownloadStatusChangedNotification_UserInfo_Changes; // nodeID => @(ZDCNodeComponents)
+
 //
 // Dictionary keys within .rcrd files
 //
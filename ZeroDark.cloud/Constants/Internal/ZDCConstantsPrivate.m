@@ -11,11 +11,16 @@
 
 NSString *const kZDCDirPrefix_Fake = @"FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF";
 
+NSString *const kZDCCollection_PullCheckpoint = @"ZDCPullCheckpoint";
+
 NSString *const kZDCContext_Conflict = @"ZDC:Conflict";
 
 NSString *const ZDCSkippedOperationsNotification = @"ZDCSkippedOperationsNotification";
 NSString *const ZDCSkippedOperationsNotification_UserInfo_Ops = @"ops";
 
+NSString *const ZDCNodeDownloadStatusChangedNotification = @"ZDCNodeDownloadStatusChangedNotification";
+NSString *const ZDCNodeDownloadStatusChangedNotification_UserInfo_Changes = @"changes";
+
 //
 // Dictionary keys used in "*.rcrd" files.
 // See header file for explanation.
@@ -54,6 +54,8 @@ extern NSString *const kZDCCollection_CloudNodes;
 /** Name of collection in YapDatabase. All ZeroDark collection constants start with "ZDC" */
 extern NSString *const kZDCCollection_Nodes;
 /** Name of collection in YapDatabase. All ZeroDark collection constants start with "ZDC" */
+extern NSString *const kZDCCollection_NodeAggregates;
+/** Name of collection in YapDatabase. All ZeroDark collection constants start with "ZDC" */
 extern NSString *const kZDCCollection_Prefs;
 /** Name of collection in YapDatabase. All ZeroDark collection constants start with "ZDC" */
 extern NSString *const kZDCCollection_PublicKeys;
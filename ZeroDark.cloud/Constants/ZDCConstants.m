@@ -14,6 +14,7 @@
 /* extern */ NSString *const kZDCCollection_CachedResponse  = @"ZDCCachedResponse";
 /* extern */ NSString *const kZDCCollection_CloudNodes      = @"ZDCCloudNodes";
 /* extern */ NSString *const kZDCCollection_Nodes           = @"ZDCNodes";
+/* extern */ NSString *const kZDCCollection_NodeAggregates  = @"ZDCNodeAggregates";
 /* extern */ NSString *const kZDCCollection_Prefs           = @"ZDCPrefs";
 /* extern */ NSString *const kZDCCollection_PublicKeys      = @"ZDCPublicKeys";
 /* extern */ NSString *const kZDCCollection_PullState       = @"ZDCSyncState";
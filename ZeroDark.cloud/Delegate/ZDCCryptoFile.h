@@ -45,6 +45,10 @@ NS_ASSUME_NONNULL_BEGIN
  * - To read a cryptoFile as a stream, you can use either `CloudFile2CleartextInputStream` or `CacheFile2CleartextInputStream` depending on the fileFormat.
  * - To randomly access data within a cryptoFile, use the `ZDCFileReader` class.
  *
+ * Small files managed by the DiskManager (e.g. thumbnails & avatars) may be packed into a larger slab file.
+ * In this case, `fileRange` specifies where the encrypted file is located within `fileURL`.
+ * All of the tools listed above handle packed files automatically.
+ *
  * @see `ZDCFileConversion`
  * @see `ZDCFileReader`
  * @see `CloudFile2CleartextInputStream`
@@ -52,17 +56,44 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @interface ZDCCryptoFile : NSObject
 
-/** Designated initializer */
+/** Standard initializer (for a file that occupies the entire fileURL) */
+- (instancetype)initWithFileURL:(NSURL *)fileURL
+                     fileFormat:(ZDCCryptoFileFormat)fileFormat
+                  encryptionKey:(NSData *)encryptionKey
+                    retainToken:(nullable id)retainToken;
+
+/**
+ * Designated initializer
+ *
+ * @param fileRange
+ *   The location of the encrypted file within fileURL.
+ *   Pass {NSNotFound, 0} if the encrypted file occupies the entire fileURL.
+ */
 - (instancetype)initWithFileURL:(NSURL *)fileURL
+                      fileRange:(NSRange)fileRange
                      fileFormat:(ZDCCryptoFileFormat)fileFormat
                   encryptionKey:(NSData *)encryptionKey
                     retainToken:(nullable id)retainToken;
 
 /**
  * The location of the file on disk.
+ *
+ * If the file is packed (see `isPacked`), this is the location of the slab file,
+ * and the encrypted file is only the `fileRange` portion of it.
  */
 @property (nonatomic, strong, readonly) NSURL *fileURL;
 
+/**
+ * The location of the encrypted file within `fileURL`.
+ * If the encrypted file occupies the entire fileURL, the location will be NSNotFound.
+ */
+@property (nonatomic, assign, readonly) NSRange fileRange;
+
+/**
+ * Returns YES if the encrypted file is only a portion of `fileURL`.
+ */
+@property (nonatomic, readonly) BOOL isPacked;
+
 /**
  * The encryption format being used to store the file.
  */
@@ -82,6 +113,12 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property (nonatomic, strong, readonly, nullable) id retainToken;
 
+/**
+ * Maps the `fileRange` portion of a packed file into memory.
+ * Returns nil (with an error) if the file isn't packed, or couldn't be read.
+ */
+- (nullable NSData *)readPackedData:(NSError *_Nullable *_Nullable)outError;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -9,9 +9,19 @@
 
 #import "ZDCCryptoFile.h"
 
+// Categories
+#import "NSError+POSIX.h"
+#import "NSError+ZeroDark.h"
+
+// Libraries
+#import <fcntl.h>
+#import <sys/mman.h>
+#import <unistd.h>
+
 @implementation ZDCCryptoFile
 
 @synthesize fileURL = _fileURL;
+@synthesize fileRange = _fileRange;
 @synthesize fileFormat = _fileFormat;
 @synthesize encryptionKey = _encryptionKey;
 @synthesize retainToken = _retainToken;
@@ -20,10 +30,24 @@
                      fileFormat:(ZDCCryptoFileFormat)fileFormat
                   encryptionKey:(NSData *)encryptionKey
                     retainToken:(nullable id)retainToken
+{
+	return [self initWithFileURL: fileURL
+	                   fileRange: NSMakeRange(NSNotFound, 0)
+	                  fileFormat: fileFormat
+	               encryptionKey: encryptionKey
+	                 retainToken: retainToken];
+}
+
+- (instancetype)initWithFileURL:(NSURL *)fileURL
+                      fileRange:(NSRange)fileRange
+                     fileFormat:(ZDCCryptoFileFormat)fileFormat
+                  encryptionKey:(NSData *)encryptionKey
+                    retainToken:(nullable id)retainToken
 {
 	if ((self = [super init]))
 	{
 		_fileURL = fileURL;
+		_fileRange = fileRange;
 		_fileFormat = fileFormat;
 		_encryptionKey = [encryptionKey copy]; // mutable data protection
 		_retainToken = retainToken;
@@ -31,4 +55,57 @@
 	return self;
 }
 
+- (BOOL)isPacked
+{
+	return (_fileRange.location != NSNotFound);
+}
+
+- (NSData *)readPackedData:(NSError **)outError
+{
+	if (!self.isPacked)
+	{
+		if (outError) *outError = [NSError errorWithClass:[self class] code:400 description:@"File isn't packed"];
+		return nil;
+	}
+	
+	if (_fileRange.length == 0)
+	{
+		if (outError) *outError = nil;
+		return [NSData data];
+	}
+	
+	int fd = open([_fileURL.path fileSystemRepresentation], O_RDONLY);
+	if (fd < 0)
+	{
+		if (outError) *outError = [NSError errorWithPOSIXCode:errno];
+		return nil;
+	}
+	
+	// mmap requires a page-aligned offset
+	
+	off_t pageSize = (off_t)getpagesize();
+	off_t mapOffset = ((off_t)_fileRange.location / pageSize) * pageSize;
+	size_t mapDelta = (size_t)((off_t)_fileRange.location - mapOffset);
+	size_t mapLength = mapDelta + _fileRange.length;
+	
+	void *map = mmap(NULL, mapLength, PROT_READ, MAP_PRIVATE, fd, mapOffset);
+	int mapErrno = errno;
+	
+	close(fd);
+	
+	if (map == MAP_FAILED)
+	{
+		if (outError) *outError = [NSError errorWithPOSIXCode:mapErrno];
+		return nil;
+	}
+	
+	if (outError) *outError = nil;
+	return [[NSData alloc] initWithBytesNoCopy: ((uint8_t *)map + mapDelta)
+	                                    length: _fileRange.length
+	                               deallocator:^(void *bytes, NSUInteger length)
+	{
+		munmap(map, mapLength);
+	}];
+}
+
 @end
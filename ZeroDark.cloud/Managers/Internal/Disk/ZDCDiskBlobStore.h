@@ -0,0 +1,106 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * A single encrypted file, shared by every cached item with the same content.
+ *
+ * Blobs are shared with the DiskManager (via ZDCFileInfo.blob).
+ * Once the last item referencing a blob is removed, the blob is retired.
+ * The file of a retired blob is deleted when the last reference to the blob object goes away.
+ * Thus anybody holding onto a blob (e.g. a ZDCFileRetainToken) can continue reading from it.
+ */
+@interface ZDCDiskBlob : NSObject
+
+/** The blob's filename: "<digest>.<generation>" */
+@property (nonatomic, copy, readonly) NSString *name;
+
+/** The (keyed) digest of the cleartext content. */
+@property (nonatomic, copy, readonly) NSString *digest;
+
+@property (nonatomic, strong, readonly) NSURL *fileURL;
+
+/** The size of the (encrypted) file. */
+@property (nonatomic, assign, readonly) uint64_t length;
+
+/** The number of items referencing the blob. */
+@property (nonatomic, assign, readonly) NSUInteger refCount;
+
+@end
+
+/**
+ * When the same content is cached under several nodes (e.g. copied nodes, or a message sent to several recipients),
+ * storing a separate encrypted copy for each node wastes both disk space & encryption work.
+ *
+ * The blob store instead keeps a single encrypted copy per distinct content, keyed by a digest of the content.
+ * Each item that refers to the blob holds a reference, and the blob is deleted when the last reference is released.
+ *
+ * The store doesn't persist the reference counts.
+ * At launch, every blob starts with zero references. The DiskManager re-adds the references it restores
+ * from its journal, and then invokes `removeUnreferencedBlobs`.
+ *
+ * Blobs are stored in a hidden subdirectory, so they're skipped by the DiskManager's directory scans.
+ *
+ * This class is NOT thread-safe.
+ * The DiskManager only accesses it from within its cacheQueue.
+ */
+@interface ZDCDiskBlobStore : NSObject
+
+- (instancetype)initWithDirectoryURL:(NSURL *)directoryURL;
+
+@property (nonatomic, strong, readonly) NSURL *directoryURL;
+
+/**
+ * Creates the directory (if needed), and indexes the blob files within it.
+ */
+- (void)open;
+
+/** The number of blobs. */
+@property (nonatomic, readonly) NSUInteger count;
+
+/** The combined size of every blob file. */
+@property (nonatomic, readonly) uint64_t totalSize;
+
+/** Returns the current blob for the given content digest. */
+- (nullable ZDCDiskBlob *)blobForDigest:(NSString *)digest;
+
+/** Returns the blob with the given filename (as recorded in the DiskManager's journal). */
+- (nullable ZDCDiskBlob *)blobWithName:(NSString *)name;
+
+/**
+ * Moves the (already encrypted) file into the store.
+ * The returned blob has a single reference, which belongs to the caller.
+ *
+ * If a blob already exists for the digest, it's superseded (but remains readable by anybody holding it).
+ */
+- (nullable ZDCDiskBlob *)storeFileAtURL:(NSURL *)srcURL
+                                  digest:(NSString *)digest
+                                   error:(NSError *_Nullable *_Nullable)outError;
+
+/** Adds a reference to the blob. */
+- (void)retainBlob:(ZDCDiskBlob *)blob;
+
+/**
+ * Releases a reference to the blob.
+ * When the last reference is released, the blob is removed from the store & retired.
+ */
+- (void)releaseBlob:(ZDCDiskBlob *)blob;
+
+/**
+ * Retires every blob without any references.
+ * Returns the number of blobs that were retired.
+ */
+- (NSUInteger)removeUnreferencedBlobs;
+
+@end
+
+NS_ASSUME_NONNULL_END
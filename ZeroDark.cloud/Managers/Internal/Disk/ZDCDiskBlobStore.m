@@ -0,0 +1,288 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import "ZDCDiskBlobStore.h"
+
+#import "ZDCLogging.h"
+
+// Libraries
+#import <unistd.h>
+
+// Log Levels: off, error, warn, info, verbose
+// Log Flags : trace
+#if DEBUG && robbie_hanson
+  static const int zdcLogLevel = ZDCLogLevelInfo;
+#elif DEBUG
+  static const int zdcLogLevel = ZDCLogLevelWarning;
+#else
+  static const int zdcLogLevel = ZDCLogLevelWarning;
+#endif
+#pragma unused(zdcLogLevel)
+
+// Blob filenames are "<digest>.<generation>".
+//
+// The generation makes every blob file unique.
+// So if content is re-imported while a retired blob (with the same digest) is still being read,
+// the new blob doesn't collide with the file that's about to be deleted.
+//
+static NSString *const kBlobGenerationSeparator = @".";
+
+@interface ZDCDiskBlob () {
+@public
+
+	NSUInteger refCount;
+	BOOL retired;
+}
+
+- (instancetype)initWithFileURL:(NSURL *)fileURL digest:(NSString *)digest length:(uint64_t)length;
+
+@end
+
+@implementation ZDCDiskBlob
+
+@synthesize name = name;
+@synthesize digest = digest;
+@synthesize fileURL = fileURL;
+@synthesize length = length;
+@synthesize refCount = refCount;
+
+- (instancetype)initWithFileURL:(NSURL *)inFileURL digest:(NSString *)inDigest length:(uint64_t)inLength
+{
+	if ((self = [super init]))
+	{
+		fileURL = inFileURL;
+		name = [[inFileURL lastPathComponent] copy];
+		digest = [inDigest copy];
+		length = inLength;
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	if (retired)
+	{
+		// Nobody is reading from the blob anymore.
+		unlink([fileURL.path fileSystemRepresentation]);
+	}
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation ZDCDiskBlobStore
+{
+	NSMutableDictionary<NSString *, ZDCDiskBlob *> *blobsByName;   // every live blob
+	NSMutableDictionary<NSString *, ZDCDiskBlob *> *blobsByDigest; // the current blob for each digest
+	
+	uint64_t totalSize;
+	uint64_t nextGeneration;
+}
+
+@synthesize directoryURL = directoryURL;
+@synthesize totalSize = totalSize;
+
+@dynamic count;
+
+- (instancetype)initWithDirectoryURL:(NSURL *)inDirectoryURL
+{
+	if ((self = [super init]))
+	{
+		directoryURL = [inDirectoryURL copy];
+		
+		blobsByName = [[NSMutableDictionary alloc] init];
+		blobsByDigest = [[NSMutableDictionary alloc] init];
+		
+		nextGeneration = 1;
+	}
+	return self;
+}
+
+- (void)open
+{
+	ZDCLogAutoTrace();
+	
+	NSFileManager *fileManager = [NSFileManager defaultManager];
+	
+	NSError *error = nil;
+	[fileManager createDirectoryAtURL: directoryURL
+	      withIntermediateDirectories: YES
+	                       attributes: nil
+	                            error: &error];
+	
+	if (error) {
+		ZDCLogError(@"Error creating blob directory: %@", error);
+	}
+	
+	NSArray<NSURL *> *urls =
+	  [fileManager contentsOfDirectoryAtURL: directoryURL
+	             includingPropertiesForKeys: @[ NSURLFileSizeKey ]
+	                                options: 0
+	                                  error: nil];
+	
+	for (NSURL *url in urls)
+	{
+		NSString *filename = [url lastPathComponent];
+		
+		NSRange range = [filename rangeOfString:kBlobGenerationSeparator options:NSBackwardsSearch];
+		if (range.location == NSNotFound || range.location == 0)
+		{
+			// Not a blob (e.g. a temp file from a move that was interrupted)
+			[fileManager removeItemAtURL:url error:nil];
+			continue;
+		}
+		
+		NSString *digest = [filename substringToIndex:range.location];
+		uint64_t generation = strtoull([[filename substringFromIndex:NSMaxRange(range)] UTF8String], NULL, 10);
+		
+		NSNumber *fileSize = nil;
+		[url getResourceValue:&fileSize forKey:NSURLFileSizeKey error:nil];
+		
+		ZDCDiskBlob *blob = [[ZDCDiskBlob alloc] initWithFileURL:url
+		                                                  digest:digest
+		                                                  length:[fileSize unsignedLongLongValue]];
+		
+		blobsByName[blob.name] = blob;
+		totalSize += blob.length;
+		
+		// If there are multiple generations for the same digest (e.g. crash before a retired blob was deleted),
+		// the latest generation becomes the current blob. The others are removed if nobody references them.
+		
+		ZDCDiskBlob *current = blobsByDigest[digest];
+		if (current == nil || [self generationForBlob:current] < generation) {
+			blobsByDigest[digest] = blob;
+		}
+		
+		nextGeneration = MAX(nextGeneration, generation + 1);
+	}
+}
+
+- (uint64_t)generationForBlob:(ZDCDiskBlob *)blob
+{
+	NSString *suffix = [blob.name substringFromIndex:(blob.digest.length + kBlobGenerationSeparator.length)];
+	return strtoull([suffix UTF8String], NULL, 10);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Accessors
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSUInteger)count
+{
+	return blobsByName.count;
+}
+
+- (ZDCDiskBlob *)blobForDigest:(NSString *)digest
+{
+	return blobsByDigest[digest];
+}
+
+- (ZDCDiskBlob *)blobWithName:(NSString *)name
+{
+	return blobsByName[name];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Writing
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (ZDCDiskBlob *)storeFileAtURL:(NSURL *)srcURL digest:(NSString *)digest error:(NSError **)outError
+{
+	NSString *filename =
+	  [NSString stringWithFormat:@"%@%@%llu", digest, kBlobGenerationSeparator, nextGeneration];
+	
+	NSURL *dstURL = [directoryURL URLByAppendingPathComponent:filename isDirectory:NO];
+	
+	NSError *error = nil;
+	[[NSFileManager defaultManager] moveItemAtURL:srcURL toURL:dstURL error:&error];
+	
+	if (error)
+	{
+		if (outError) *outError = error;
+		return nil;
+	}
+	
+	nextGeneration++;
+	
+	NSNumber *fileSize = nil;
+	[dstURL getResourceValue:&fileSize forKey:NSURLFileSizeKey error:nil];
+	
+	ZDCDiskBlob *blob = [[ZDCDiskBlob alloc] initWithFileURL:dstURL
+	                                                  digest:digest
+	                                                  length:[fileSize unsignedLongLongValue]];
+	blob->refCount = 1;
+	
+	blobsByName[blob.name] = blob;
+	blobsByDigest[digest] = blob;
+	totalSize += blob.length;
+	
+	if (outError) *outError = nil;
+	return blob;
+}
+
+- (void)retainBlob:(ZDCDiskBlob *)blob
+{
+	NSAssert(!blob->retired, @"Attempting to retain a retired blob");
+	
+	if (blob->refCount < NSUIntegerMax) {
+		blob->refCount++;
+	}
+}
+
+- (void)releaseBlob:(ZDCDiskBlob *)blob
+{
+	if (blob->refCount > 0) {
+		blob->refCount--;
+	}
+	
+	if (blob->refCount == 0) {
+		[self retireBlob:blob];
+	}
+}
+
+- (void)retireBlob:(ZDCDiskBlob *)blob
+{
+	if (blob->retired) return;
+	
+	if (blobsByName[blob.name] == blob)
+	{
+		[blobsByName removeObjectForKey:blob.name];
+		totalSize -= MIN(totalSize, blob.length);
+	}
+	if (blobsByDigest[blob.digest] == blob)
+	{
+		[blobsByDigest removeObjectForKey:blob.digest];
+	}
+	
+	blob->retired = YES;
+}
+
+- (NSUInteger)removeUnreferencedBlobs
+{
+	NSMutableArray<ZDCDiskBlob *> *unreferenced = [NSMutableArray array];
+	
+	for (ZDCDiskBlob *blob in [blobsByName objectEnumerator])
+	{
+		if (blob->refCount == 0) {
+			[unreferenced addObject:blob];
+		}
+	}
+	
+	for (ZDCDiskBlob *blob in unreferenced)
+	{
+		[self retireBlob:blob];
+	}
+	
+	return unreferenced.count;
+}
+
+@end
@@ -0,0 +1,125 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import <Foundation/Foundation.h>
+
+@class ZDCDiskSlab;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * The location of a single item within a slab file.
+ *
+ * Entries are shared with the DiskManager (via ZDCFileInfo.slabEntry).
+ * If compaction relocates the item into a different slab, the entry is updated in place.
+ */
+@interface ZDCDiskSlabEntry : NSObject
+
+/** The key the item was stored under (i.e. the item's filename). */
+@property (nonatomic, copy, readonly) NSString *key;
+
+/** The slab the item currently lives in. */
+@property (nonatomic, strong, readonly) ZDCDiskSlab *slab;
+
+/** The offset of the item's bytes within the slab file. */
+@property (nonatomic, assign, readonly) uint64_t offset;
+
+/** The number of bytes in the item. */
+@property (nonatomic, assign, readonly) uint64_t length;
+
+/** When the item was stored. */
+@property (nonatomic, strong, readonly) NSDate *date;
+
+/** Convenience: {offset, length} */
+@property (nonatomic, readonly) NSRange range;
+
+@end
+
+/**
+ * A single append-only slab file.
+ *
+ * Once compaction has moved every live item out of a slab, the slab is retired.
+ * The file of a retired slab is deleted when the last reference to the slab goes away.
+ * Thus anybody holding onto a slab (e.g. a ZDCFileRetainToken) can continue reading from it.
+ */
+@interface ZDCDiskSlab : NSObject
+
+@property (nonatomic, strong, readonly) NSURL *fileURL;
+@property (nonatomic, assign, readonly) uint32_t number;
+
+@end
+
+/**
+ * Small files (e.g. thumbnails & avatars) are expensive to store one-file-per-item:
+ * every import is a file creation (plus xattrs), every eviction is an unlink,
+ * and a large cache means a large directory that takes a long time to scan.
+ *
+ * The slab store instead packs items into a handful of append-only slab files.
+ * Each record is self-describing (key, date, checksum), so the index is rebuilt at launch
+ * by walking the record headers. Updates append a new record, and removals append a tombstone.
+ * Once a slab is mostly dead space, compaction moves its live items into the active slab.
+ *
+ * Slabs are stored in a hidden subdirectory, so they're skipped by the DiskManager's directory scans.
+ *
+ * This class is NOT thread-safe.
+ * The DiskManager only accesses it from within its cacheQueue.
+ */
+@interface ZDCDiskSlabStore : NSObject
+
+- (instancetype)initWithDirectoryURL:(NSURL *)directoryURL;
+
+@property (nonatomic, strong, readonly) NSURL *directoryURL;
+
+/**
+ * Creates the directory (if needed), and rebuilds the index from the slab files.
+ * Torn records (e.g. from a crash mid-write) are truncated.
+ */
+- (void)open;
+
+/** The number of live items. */
+@property (nonatomic, readonly) NSUInteger count;
+
+/** The number of bytes of live items. */
+@property (nonatomic, readonly) uint64_t liveSize;
+
+/** The combined size of every slab file (including dead space). */
+@property (nonatomic, readonly) uint64_t totalSize;
+
+- (nullable ZDCDiskSlabEntry *)entryForKey:(NSString *)key;
+
+- (NSArray<ZDCDiskSlabEntry *> *)allEntries;
+
+/**
+ * Appends the data to the active slab.
+ * If an item already exists for the key, it's superseded (but remains readable by anybody holding its slab).
+ */
+- (nullable ZDCDiskSlabEntry *)storeData:(NSData *)data
+                                  forKey:(NSString *)key
+                                   error:(NSError *_Nullable *_Nullable)outError;
+
+/**
+ * Removes the item, if the entry is still the current entry for its key.
+ * (If the entry has already been superseded or removed, this method does nothing.)
+ */
+- (void)removeEntry:(ZDCDiskSlabEntry *)entry;
+
+/**
+ * Reads the item's bytes.
+ */
+- (nullable NSData *)readEntry:(ZDCDiskSlabEntry *)entry error:(NSError *_Nullable *_Nullable)outError;
+
+/**
+ * Compacts any slab that's more than half dead space.
+ * Returns the number of slabs that were retired.
+ */
+- (NSUInteger)compactIfNeeded;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,892 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import "ZDCDiskSlabStore.h"
+
+#import "ZDCLogging.h"
+
+// Categories
+#import "NSError+POSIX.h"
+#import "NSError+ZeroDark.h"
+
+// Libraries
+#import <fcntl.h>
+#import <libkern/OSByteOrder.h>
+#import <unistd.h>
+
+// Log Levels: off, error, warn, info, verbose
+// Log Flags : trace
+#if DEBUG && robbie_hanson
+  static const int zdcLogLevel = ZDCLogLevelInfo;
+#elif DEBUG
+  static const int zdcLogLevel = ZDCLogLevelWarning;
+#else
+  static const int zdcLogLevel = ZDCLogLevelWarning;
+#endif
+#pragma unused(zdcLogLevel)
+
+static NSString *const kSlabFilenamePrefix = @"slab-";
+
+static uint32_t const kSlabMagic   = 0x5343445A; // "ZDCS" (little endian)
+static uint32_t const kSlabVersion = 1;
+static uint32_t const kRecordMagic = 0x5243445A; // "ZDCR" (little endian)
+
+static uint8_t const kRecordOp_Put    = 1;
+static uint8_t const kRecordOp_Remove = 2;
+
+// Slab header  : magic(4) + version(4)
+// Record header: magic(4) + op(1) + keyLength(2) + dataLength(4) + date(8) + checksum(4)
+// Record       : header + key(utf8) + data
+//
+static uint64_t const kSlabHeaderSize   = 8;
+static uint64_t const kRecordHeaderSize = 23;
+
+static uint64_t const kMaxSlabSize       = (1024 * 1024 * 4); // 4 MiB
+static uint64_t const kMinCompactionSize = (1024 * 256);      // 256 KiB
+
+static uint32_t ZDCSlabChecksum(uint32_t hash, const uint8_t *bytes, size_t length)
+{
+	// FNV-1a (32-bit), same as the DiskManager journal
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static uint16_t ZDCSlabReadUInt16(const uint8_t *ptr)
+{
+	uint16_t value;
+	memcpy(&value, ptr, sizeof(value));
+	return OSSwapLittleToHostInt16(value);
+}
+
+static uint32_t ZDCSlabReadUInt32(const uint8_t *ptr)
+{
+	uint32_t value;
+	memcpy(&value, ptr, sizeof(value));
+	return OSSwapLittleToHostInt32(value);
+}
+
+static double ZDCSlabReadDouble(const uint8_t *ptr)
+{
+	uint64_t bits;
+	memcpy(&bits, ptr, sizeof(bits));
+	bits = OSSwapLittleToHostInt64(bits);
+	
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+static void ZDCSlabAppendUInt8(NSMutableData *data, uint8_t value)
+{
+	[data appendBytes:&value length:sizeof(value)];
+}
+
+static void ZDCSlabAppendUInt16(NSMutableData *data, uint16_t value)
+{
+	value = OSSwapHostToLittleInt16(value);
+	[data appendBytes:&value length:sizeof(value)];
+}
+
+static void ZDCSlabAppendUInt32(NSMutableData *data, uint32_t value)
+{
+	value = OSSwapHostToLittleInt32(value);
+	[data appendBytes:&value length:sizeof(value)];
+}
+
+static void ZDCSlabAppendDouble(NSMutableData *data, double value)
+{
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	bits = OSSwapHostToLittleInt64(bits);
+	[data appendBytes:&bits length:sizeof(bits)];
+}
+
+static BOOL ZDCSlabWrite(int fd, NSData *data)
+{
+	const uint8_t *ptr = (const uint8_t *)data.bytes;
+	size_t remaining = data.length;
+	
+	while (remaining > 0)
+	{
+		ssize_t written = write(fd, ptr, remaining);
+		if (written < 0)
+		{
+			if (errno == EINTR) continue;
+			return NO;
+		}
+		
+		ptr += written;
+		remaining -= written;
+	}
+	
+	return YES;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface ZDCDiskSlab () {
+@public
+
+	uint64_t fileSize; // size of the valid portion of the file
+	uint64_t liveSize; // size of the records that are still live (i.e. referenced by the index)
+	
+	// Keys removed via a tombstone within this slab.
+	// If the slab is compacted while older slabs still exist, the tombstones need to be carried forward.
+	NSMutableSet<NSString *> *tombstoneKeys;
+	
+	BOOL retired;
+	int fd; // for appending (active slab only)
+}
+
+- (instancetype)initWithFileURL:(NSURL *)fileURL number:(uint32_t)number;
+
+- (void)closeFile;
+
+@end
+
+@implementation ZDCDiskSlab
+
+@synthesize fileURL = fileURL;
+@synthesize number = number;
+
+- (instancetype)initWithFileURL:(NSURL *)inFileURL number:(uint32_t)inNumber
+{
+	if ((self = [super init]))
+	{
+		fileURL = inFileURL;
+		number = inNumber;
+		
+		tombstoneKeys = [[NSMutableSet alloc] init];
+		fd = -1;
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	[self closeFile];
+	
+	if (retired)
+	{
+		// Nobody is reading from the slab anymore.
+		unlink([fileURL.path fileSystemRepresentation]);
+	}
+}
+
+- (void)closeFile
+{
+	if (fd >= 0)
+	{
+		close(fd);
+		fd = -1;
+	}
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface ZDCDiskSlabEntry () {
+@public
+
+	uint64_t recordLength; // header + key + data
+}
+
+- (instancetype)initWithKey:(NSString *)key
+                       slab:(ZDCDiskSlab *)slab
+                     offset:(uint64_t)offset
+                     length:(uint64_t)length
+               recordLength:(uint64_t)recordLength
+                       date:(NSDate *)date;
+
+@property (nonatomic, strong, readwrite) ZDCDiskSlab *slab;
+@property (nonatomic, assign, readwrite) uint64_t offset;
+
+@end
+
+@implementation ZDCDiskSlabEntry
+
+@synthesize key = key;
+@synthesize slab = slab;
+@synthesize offset = offset;
+@synthesize length = length;
+@synthesize date = date;
+
+@dynamic range;
+
+- (instancetype)initWithKey:(NSString *)inKey
+                       slab:(ZDCDiskSlab *)inSlab
+                     offset:(uint64_t)inOffset
+                     length:(uint64_t)inLength
+               recordLength:(uint64_t)inRecordLength
+                       date:(NSDate *)inDate
+{
+	if ((self = [super init]))
+	{
+		key = [inKey copy];
+		slab = inSlab;
+		offset = inOffset;
+		length = inLength;
+		recordLength = inRecordLength;
+		date = inDate;
+	}
+	return self;
+}
+
+- (NSRange)range
+{
+	return NSMakeRange((NSUInteger)offset, (NSUInteger)length);
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation ZDCDiskSlabStore
+{
+	NSMutableArray<ZDCDiskSlab *> *slabs; // sorted by number (oldest first)
+	ZDCDiskSlab *activeSlab;
+	
+	NSMutableDictionary<NSString *, ZDCDiskSlabEntry *> *index;
+	uint64_t liveSize;
+}
+
+@synthesize directoryURL = directoryURL;
+@synthesize liveSize = liveSize;
+
+@dynamic count;
+@dynamic totalSize;
+
+- (instancetype)initWithDirectoryURL:(NSURL *)inDirectoryURL
+{
+	if ((self = [super init]))
+	{
+		directoryURL = [inDirectoryURL copy];
+		
+		slabs = [[NSMutableArray alloc] init];
+		index = [[NSMutableDictionary alloc] init];
+	}
+	return self;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Opening
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)open
+{
+	ZDCLogAutoTrace();
+	
+	NSFileManager *fileManager = [NSFileManager defaultManager];
+	
+	NSError *error = nil;
+	[fileManager createDirectoryAtURL: directoryURL
+	      withIntermediateDirectories: YES
+	                       attributes: nil
+	                            error: &error];
+	
+	if (error) {
+		ZDCLogError(@"Error creating slab directory: %@", error);
+	}
+	
+	NSArray<NSURL *> *urls =
+	  [fileManager contentsOfDirectoryAtURL: directoryURL
+	             includingPropertiesForKeys: nil
+	                                options: 0
+	                                  error: nil];
+	
+	NSMutableArray<ZDCDiskSlab *> *found = [NSMutableArray arrayWithCapacity:urls.count];
+	
+	for (NSURL *url in urls)
+	{
+		NSString *filename = [url lastPathComponent];
+		if (![filename hasPrefix:kSlabFilenamePrefix]) continue;
+		
+		long long number = [[filename substringFromIndex:kSlabFilenamePrefix.length] longLongValue];
+		if (number <= 0 || number > UINT32_MAX) continue;
+		
+		[found addObject:[[ZDCDiskSlab alloc] initWithFileURL:url number:(uint32_t)number]];
+	}
+	
+	[found sortUsingComparator:^NSComparisonResult(ZDCDiskSlab *slab1, ZDCDiskSlab *slab2) {
+	
+		if (slab1.number < slab2.number) return NSOrderedAscending;
+		if (slab1.number > slab2.number) return NSOrderedDescending;
+		return NSOrderedSame;
+	}];
+	
+	// Records are replayed in order (oldest slab first),
+	// so the last record for any given key wins.
+	
+	for (ZDCDiskSlab *slab in found)
+	{
+		if ([self loadSlab:slab])
+		{
+			[slabs addObject:slab];
+		}
+		else
+		{
+			ZDCLogWarn(@"Deleting unreadable slab: %@", [slab.fileURL lastPathComponent]);
+			[fileManager removeItemAtURL:slab.fileURL error:nil];
+		}
+	}
+	
+	// Continue appending to the newest slab (if it has room).
+	
+	ZDCDiskSlab *lastSlab = [slabs lastObject];
+	if (lastSlab && (lastSlab->fileSize < kMaxSlabSize)) {
+		activeSlab = lastSlab;
+	}
+	
+	ZDCLogInfo(@"Opened slab store (%@): %lu items, %llu live bytes, %llu total bytes",
+	           [directoryURL.URLByDeletingLastPathComponent lastPathComponent],
+	           (unsigned long)index.count, liveSize, self.totalSize);
+}
+
+/**
+ * Walks the record headers, and adds every record to the index.
+ * Returns NO if the file isn't a slab.
+ */
+- (BOOL)loadSlab:(ZDCDiskSlab *)slab
+{
+	NSData *data = [NSData dataWithContentsOfURL:slab.fileURL options:NSDataReadingMappedAlways error:nil];
+	
+	if (data.length < kSlabHeaderSize) return NO;
+	
+	const uint8_t *const base = (const uint8_t *)data.bytes;
+	const uint8_t *const end = base + data.length;
+	
+	if (ZDCSlabReadUInt32(base) != kSlabMagic) return NO;
+	if (ZDCSlabReadUInt32(base + 4) != kSlabVersion) return NO;
+	
+	const uint8_t *ptr = base + kSlabHeaderSize;
+	
+	while ((uint64_t)(end - ptr) >= kRecordHeaderSize)
+	{
+		uint32_t magic      = ZDCSlabReadUInt32(ptr);
+		uint8_t  op         = ptr[4];
+		uint16_t keyLength  = ZDCSlabReadUInt16(ptr + 5);
+		uint32_t dataLength = ZDCSlabReadUInt32(ptr + 7);
+		double   date       = ZDCSlabReadDouble(ptr + 11);
+		uint32_t checksum   = ZDCSlabReadUInt32(ptr + 19);
+		
+		if (magic != kRecordMagic) break;
+		if ((op != kRecordOp_Put) && (op != kRecordOp_Remove)) break;
+		
+		uint64_t recordLength = kRecordHeaderSize + keyLength + dataLength;
+		if ((uint64_t)(end - ptr) < recordLength) break;
+		
+		const uint8_t *keyPtr = ptr + kRecordHeaderSize;
+		const uint8_t *dataPtr = keyPtr + keyLength;
+		
+		uint32_t hash = ZDCSlabChecksum(2166136261u, keyPtr, keyLength);
+		hash = ZDCSlabChecksum(hash, dataPtr, dataLength);
+		
+		if (hash != checksum) break;
+		
+		NSString *key = [[NSString alloc] initWithBytes:keyPtr length:keyLength encoding:NSUTF8StringEncoding];
+		if (key == nil) break;
+		
+		if (op == kRecordOp_Put)
+		{
+			[self didPutKey: key
+			           slab: slab
+			   recordOffset: (uint64_t)(ptr - base)
+			   recordLength: recordLength
+			     dataLength: dataLength
+			           date: [NSDate dateWithTimeIntervalSinceReferenceDate:date]];
+		}
+		else
+		{
+			[self didRemoveKey:key slab:slab];
+		}
+		
+		ptr += recordLength;
+	}
+	
+	uint64_t validLength = (uint64_t)(ptr - base);
+	if (validLength < data.length)
+	{
+		// Torn write (e.g. the app was killed mid-append). Drop the partial record.
+		
+		ZDCLogWarn(@"Truncating slab (%@) from %lu to %llu bytes",
+		           [slab.fileURL lastPathComponent], (unsigned long)data.length, validLength);
+		
+		data = nil;
+		truncate([slab.fileURL.path fileSystemRepresentation], (off_t)validLength);
+	}
+	
+	slab->fileSize = validLength;
+	return YES;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Index
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSUInteger)count
+{
+	return index.count;
+}
+
+- (uint64_t)totalSize
+{
+	uint64_t total = 0;
+	for (ZDCDiskSlab *slab in slabs)
+	{
+		total += slab->fileSize;
+	}
+	return total;
+}
+
+- (ZDCDiskSlabEntry *)entryForKey:(NSString *)key
+{
+	if (key == nil) return nil;
+	return index[key];
+}
+
+- (NSArray<ZDCDiskSlabEntry *> *)allEntries
+{
+	return [index allValues];
+}
+
+/**
+ * Removes the current entry for the key (if any) from the index, and marks its record as dead space.
+ */
+- (void)supersedeKey:(NSString *)key
+{
+	ZDCDiskSlabEntry *previous = index[key];
+	if (previous == nil) return;
+	
+	ZDCDiskSlab *previousSlab = previous.slab;
+	previousSlab->liveSize -= MIN(previousSlab->liveSize, previous->recordLength);
+	
+	liveSize -= MIN(liveSize, previous.length);
+	[index removeObjectForKey:key];
+}
+
+- (ZDCDiskSlabEntry *)didPutKey:(NSString *)key
+                           slab:(ZDCDiskSlab *)slab
+                   recordOffset:(uint64_t)recordOffset
+                   recordLength:(uint64_t)recordLength
+                     dataLength:(uint64_t)dataLength
+                           date:(NSDate *)date
+{
+	[self supersedeKey:key];
+	
+	ZDCDiskSlabEntry *entry =
+	  [[ZDCDiskSlabEntry alloc] initWithKey: key
+	                                   slab: slab
+	                                 offset: (recordOffset + recordLength - dataLength)
+	                                 length: dataLength
+	                           recordLength: recordLength
+	                                   date: date];
+	
+	index[key] = entry;
+	
+	slab->liveSize += recordLength;
+	liveSize += dataLength;
+	
+	return entry;
+}
+
+- (void)didRemoveKey:(NSString *)key slab:(ZDCDiskSlab *)slab
+{
+	[self supersedeKey:key];
+	[slab->tombstoneKeys addObject:key];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Writing
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the slab to append the next record to, creating a new slab if the active one is full.
+ */
+- (nullable ZDCDiskSlab *)slabForAppendingLength:(uint64_t)recordLength error:(NSError **)outError
+{
+	if (activeSlab &&
+	    (activeSlab->fileSize > kSlabHeaderSize) &&
+	    (activeSlab->fileSize + recordLength > kMaxSlabSize))
+	{
+		[activeSlab closeFile];
+		activeSlab = nil;
+	}
+	
+	if (activeSlab == nil)
+	{
+		uint32_t number = [slabs lastObject].number + 1;
+		
+		NSString *filename = [NSString stringWithFormat:@"%@%06u", kSlabFilenamePrefix, number];
+		NSURL *url = [directoryURL URLByAppendingPathComponent:filename isDirectory:NO];
+		
+		int fd = open([url.path fileSystemRepresentation], (O_WRONLY | O_APPEND | O_CREAT | O_TRUNC), 0644);
+		if (fd < 0)
+		{
+			if (outError) *outError = [NSError errorWithPOSIXCode:errno];
+			return nil;
+		}
+		
+		NSMutableData *header = [NSMutableData dataWithCapacity:kSlabHeaderSize];
+		ZDCSlabAppendUInt32(header, kSlabMagic);
+		ZDCSlabAppendUInt32(header, kSlabVersion);
+		
+		if (!ZDCSlabWrite(fd, header))
+		{
+			if (outError) *outError = [NSError errorWithPOSIXCode:errno];
+			
+			close(fd);
+			unlink([url.path fileSystemRepresentation]);
+			return nil;
+		}
+		
+		ZDCDiskSlab *slab = [[ZDCDiskSlab alloc] initWithFileURL:url number:number];
+		slab->fileSize = kSlabHeaderSize;
+		slab->fd = fd;
+		
+		[slabs addObject:slab];
+		activeSlab = slab;
+	}
+	
+	if (activeSlab->fd < 0)
+	{
+		activeSlab->fd = open([activeSlab.fileURL.path fileSystemRepresentation], (O_WRONLY | O_APPEND));
+		if (activeSlab->fd < 0)
+		{
+			if (outError) *outError = [NSError errorWithPOSIXCode:errno];
+			return nil;
+		}
+	}
+	
+	return activeSlab;
+}
+
+- (BOOL)appendRecordWithOp:(uint8_t)op
+                       key:(NSString *)key
+                      data:(nullable NSData *)data
+                      date:(NSDate *)date
+                    toSlab:(ZDCDiskSlab **)outSlab
+              recordOffset:(uint64_t *)outRecordOffset
+                     error:(NSError **)outError
+{
+	NSData *keyData = [key dataUsingEncoding:NSUTF8StringEncoding];
+	
+	if ((keyData.length > UINT16_MAX) || (data.length > UINT32_MAX))
+	{
+		if (outError) *outError = [NSError errorWithClass:[self class] code:400 description:@"Item too large for slab"];
+		return NO;
+	}
+	
+	uint64_t recordLength = kRecordHeaderSize + keyData.length + data.length;
+	
+	ZDCDiskSlab *slab = [self slabForAppendingLength:recordLength error:outError];
+	if (slab == nil) {
+		return NO;
+	}
+	
+	uint32_t checksum = ZDCSlabChecksum(2166136261u, keyData.bytes, keyData.length);
+	checksum = ZDCSlabChecksum(checksum, data.bytes, data.length);
+	
+	NSMutableData *record = [NSMutableData dataWithCapacity:(NSUInteger)recordLength];
+	
+	ZDCSlabAppendUInt32(record, kRecordMagic);
+	ZDCSlabAppendUInt8(record, op);
+	ZDCSlabAppendUInt16(record, (uint16_t)keyData.length);
+	ZDCSlabAppendUInt32(record, (uint32_t)data.length);
+	ZDCSlabAppendDouble(record, [date timeIntervalSinceReferenceDate]);
+	ZDCSlabAppendUInt32(record, checksum);
+	[record appendData:keyData];
+	if (data) {
+		[record appendData:data];
+	}
+	
+	if (!ZDCSlabWrite(slab->fd, record))
+	{
+		if (outError) *outError = [NSError errorWithPOSIXCode:errno];
+		
+		// Don't leave a partial record behind
+		ftruncate(slab->fd, (off_t)slab->fileSize);
+		return NO;
+	}
+	
+	if (outSlab) *outSlab = slab;
+	if (outRecordOffset) *outRecordOffset = slab->fileSize;
+	
+	slab->fileSize += recordLength;
+	return YES;
+}
+
+- (ZDCDiskSlabEntry *)storeData:(NSData *)data forKey:(NSString *)key error:(NSError **)outError
+{
+	NSParameterAssert(data != nil);
+	NSParameterAssert(key != nil);
+	
+	NSDate *date = [NSDate date];
+	
+	ZDCDiskSlab *slab = nil;
+	uint64_t recordOffset = 0;
+	
+	BOOL appended =
+	  [self appendRecordWithOp: kRecordOp_Put
+	                       key: key
+	                      data: data
+	                      date: date
+	                    toSlab: &slab
+	              recordOffset: &recordOffset
+	                     error: outError];
+	
+	if (!appended) {
+		return nil;
+	}
+	
+	uint64_t recordLength = kRecordHeaderSize + [key lengthOfBytesUsingEncoding:NSUTF8StringEncoding] + data.length;
+	
+	return [self didPutKey: key
+	                  slab: slab
+	          recordOffset: recordOffset
+	          recordLength: recordLength
+	            dataLength: data.length
+	                  date: date];
+}
+
+- (void)removeEntry:(ZDCDiskSlabEntry *)entry
+{
+	NSString *key = entry.key;
+	if ((key == nil) || (index[key] != entry)) {
+		return;
+	}
+	
+	NSError *error = nil;
+	ZDCDiskSlab *slab = nil;
+	
+	BOOL appended =
+	  [self appendRecordWithOp: kRecordOp_Remove
+	                       key: key
+	                      data: nil
+	                      date: [NSDate date]
+	                    toSlab: &slab
+	              recordOffset: NULL
+	                     error: &error];
+	
+	if (appended)
+	{
+		[self didRemoveKey:key slab:slab];
+	}
+	else
+	{
+		// The item is still removed from the index.
+		// Worst case, it's resurrected at next launch, and the DiskManager treats it as an orphan.
+		
+		ZDCLogWarn(@"Error appending slab tombstone: %@", error);
+		[self supersedeKey:key];
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Reading
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSData *)readEntry:(ZDCDiskSlabEntry *)entry error:(NSError **)outError
+{
+	NSURL *fileURL = entry.slab.fileURL;
+	
+	int fd = open([fileURL.path fileSystemRepresentation], O_RDONLY);
+	if (fd < 0)
+	{
+		if (outError) *outError = [NSError errorWithPOSIXCode:errno];
+		return nil;
+	}
+	
+	NSMutableData *data = [NSMutableData dataWithLength:(NSUInteger)entry.length];
+	
+	uint8_t *ptr = (uint8_t *)data.mutableBytes;
+	size_t remaining = (size_t)entry.length;
+	off_t offset = (off_t)entry.offset;
+	
+	NSError *error = nil;
+	
+	while (remaining > 0)
+	{
+		ssize_t bytesRead = pread(fd, ptr, remaining, offset);
+		if (bytesRead < 0)
+		{
+			if (errno == EINTR) continue;
+			
+			error = [NSError errorWithPOSIXCode:errno];
+			break;
+		}
+		else if (bytesRead == 0)
+		{
+			error = [NSError errorWithClass:[self class] code:500 description:@"Unexpected end of slab"];
+			break;
+		}
+		
+		ptr += bytesRead;
+		remaining -= bytesRead;
+		offset += bytesRead;
+	}
+	
+	close(fd);
+	
+	if (outError) *outError = error;
+	return error ? nil : data;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Compaction
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSUInteger)compactIfNeeded
+{
+	NSUInteger retiredCount = 0;
+	
+	for (ZDCDiskSlab *slab in [slabs copy])
+	{
+		BOOL isSparse = (slab->fileSize >= kMinCompactionSize) && (slab->liveSize < (slab->fileSize / 2));
+		
+		if (slab == activeSlab)
+		{
+			if (!isSparse) continue;
+			
+			// Start a fresh slab, so we can move the live items out of this one.
+			[activeSlab closeFile];
+			activeSlab = nil;
+		}
+		else if (!isSparse && (slab->liveSize > 0))
+		{
+			continue;
+		}
+		
+		if ([self relocateSlab:slab]) {
+			retiredCount++;
+		}
+	}
+	
+	if (retiredCount > 0)
+	{
+		ZDCLogInfo(@"Compacted slab store (%@): retired %lu slabs, %llu live bytes, %llu total bytes",
+		           [directoryURL.URLByDeletingLastPathComponent lastPathComponent],
+		           (unsigned long)retiredCount, liveSize, self.totalSize);
+	}
+	
+	return retiredCount;
+}
+
+/**
+ * Moves every live item (and any tombstones that still matter) into the active slab,
+ * and then retires the given slab.
+ */
+- (BOOL)relocateSlab:(ZDCDiskSlab *)slab
+{
+	NSMutableArray<ZDCDiskSlabEntry *> *liveEntries = [NSMutableArray array];
+	for (ZDCDiskSlabEntry *entry in [index objectEnumerator])
+	{
+		if (entry.slab == slab) {
+			[liveEntries addObject:entry];
+		}
+	}
+	
+	for (ZDCDiskSlabEntry *entry in liveEntries)
+	{
+		NSError *error = nil;
+		ZDCDiskSlab *dstSlab = nil;
+		uint64_t recordOffset = 0;
+		
+		NSData *data = [self readEntry:entry error:&error];
+		if (data)
+		{
+			[self appendRecordWithOp: kRecordOp_Put
+			                     key: entry.key
+			                    data: data
+			                    date: entry.date
+			                  toSlab: &dstSlab
+			            recordOffset: &recordOffset
+			                   error: &error];
+		}
+		
+		if (dstSlab == nil)
+		{
+			// Whatever we've moved so far is safe (the new records supersede the old ones).
+			// We'll try again next time.
+			
+			ZDCLogWarn(@"Error relocating slab item: %@", error);
+			return NO;
+		}
+		
+		// The entry is shared with the DiskManager, so we update it in place.
+		
+		slab->liveSize -= MIN(slab->liveSize, entry->recordLength);
+		
+		entry.slab = dstSlab;
+		entry.offset = recordOffset + entry->recordLength - entry.length;
+		
+		dstSlab->liveSize += entry->recordLength;
+	}
+	
+	// A tombstone only matters if an older slab may still contain a record for the key.
+	
+	BOOL hasOlderSlab = NO;
+	for (ZDCDiskSlab *other in slabs)
+	{
+		if (other.number < slab.number)
+		{
+			hasOlderSlab = YES;
+			break;
+		}
+	}
+	
+	if (hasOlderSlab)
+	{
+		for (NSString *key in slab->tombstoneKeys)
+		{
+			if (index[key]) continue; // superseded by a later put
+			
+			NSError *error = nil;
+			ZDCDiskSlab *dstSlab = nil;
+			
+			BOOL appended =
+			  [self appendRecordWithOp: kRecordOp_Remove
+			                       key: key
+			                      data: nil
+			                      date: [NSDate date]
+			                    toSlab: &dstSlab
+			              recordOffset: NULL
+			                     error: &error];
+			
+			if (!appended)
+			{
+				ZDCLogWarn(@"Error relocating slab tombstone: %@", error);
+				return NO;
+			}
+			
+			[dstSlab->tombstoneKeys addObject:key];
+		}
+	}
+	
+	// Retire the slab.
+	// The file is deleted once the last reference (e.g. an outstanding retainToken) goes away.
+	
+	[slabs removeObjectIdenticalTo:slab];
+	[slab closeFile];
+	slab->retired = YES;
+	
+	return YES;
+}
+
+@end
@@ -0,0 +1,70 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * A compact, approximate record of how often each key has been accessed recently.
+ * This is the "TinyLFU" part of a W-TinyLFU cache.
+ *
+ * The sketch is a count-min sketch with 4-bit counters (16 per 64-bit word), and 4 counters per key.
+ * So it can track thousands of keys in a few KiB, without storing the keys themselves.
+ * The estimate for a key is never less than its true count (but may be more, due to hash collisions).
+ *
+ * Counters saturate at 15. And once the number of increments reaches 10x the capacity,
+ * every counter is halved. This "aging" allows the sketch to forget items that were popular a long time ago.
+ *
+ * This class is NOT thread-safe.
+ * The DiskManager only accesses it from within its cacheQueue.
+ */
+@interface ZDCFrequencySketch : NSObject
+
+/**
+ * @param capacity
+ *   The number of distinct keys you expect to track.
+ *   The table is sized to the next power of 2.
+ */
+- (instancetype)initWithCapacity:(NSUInteger)capacity;
+
+/** The number of distinct keys the sketch is sized for. */
+@property (nonatomic, readonly) NSUInteger capacity;
+
+/**
+ * Grows the table if the given capacity exceeds the current capacity.
+ * Since the counters can't be redistributed, growing the table discards all recorded frequencies.
+ */
+- (void)ensureCapacity:(NSUInteger)capacity;
+
+/** Records a single access of the key. */
+- (void)incrementKey:(NSString *)key;
+
+/** Returns the estimated number of recent accesses of the key (0 - 15). */
+- (NSUInteger)frequencyForKey:(NSString *)key;
+
+/**
+ * The TinyLFU admission test.
+ *
+ * Returns YES if the candidate (e.g. an item that's just been added to the cache)
+ * has been accessed more often than the victim (e.g. the item that would be evicted to make room for it).
+ *
+ * Ties go to the victim, which is what makes the cache scan-resistant:
+ * a burst of one-off items can't displace items that are used repeatedly.
+ * However, a warm candidate is occasionally admitted at random,
+ * so an attacker can't pin an item in the cache by hammering a key that collides with it.
+ */
+- (BOOL)shouldAdmitKey:(NSString *)candidateKey overKey:(NSString *)victimKey;
+
+/** Discards all recorded frequencies. */
+- (void)reset;
+
+@end
+
+NS_ASSUME_NONNULL_END
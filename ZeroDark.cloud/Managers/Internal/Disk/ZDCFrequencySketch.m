@@ -0,0 +1,192 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import "ZDCFrequencySketch.h"
+
+static NSUInteger const kMinCapacity = 64;
+static NSUInteger const kSampleFactor = 10; // aging is performed after (capacity * kSampleFactor) increments
+
+static uint64_t const kResetMask = 0x7777777777777777ULL; // clears the high bit of each nibble (after shifting)
+
+static uint64_t const kSeeds[4] = {
+	0xc3a5c85c97cb3127ULL,
+	0xb492b66fbe98f273ULL,
+	0x9ae16a3b2f90404fULL,
+	0xcbf29ce484222325ULL
+};
+
+/**
+ * FNV-1a (64-bit) over the UTF-8 bytes, followed by a finalizer to spread the bits.
+ * (We don't use -[NSString hash], as it only considers a subset of the characters.)
+ */
+static uint64_t ZDCFrequencySketchHash(NSString *key)
+{
+	const char *bytes = [key UTF8String];
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	
+	if (bytes)
+	{
+		for (const char *p = bytes; *p; p++)
+		{
+			hash ^= (uint8_t)*p;
+			hash *= 0x100000001b3ULL;
+		}
+	}
+	
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	
+	return hash;
+}
+
+@implementation ZDCFrequencySketch {
+
+	uint64_t *table;
+	NSUInteger tableMask;
+	
+	NSUInteger size;       // number of increments since the last aging
+	NSUInteger sampleSize; // size at which aging is performed
+}
+
+@synthesize capacity = capacity;
+
+- (instancetype)init
+{
+	return [self initWithCapacity:kMinCapacity];
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)inCapacity
+{
+	if ((self = [super init]))
+	{
+		[self allocateTableWithCapacity:inCapacity];
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	free(table);
+}
+
+- (void)allocateTableWithCapacity:(NSUInteger)inCapacity
+{
+	NSUInteger length = kMinCapacity;
+	while (length < inCapacity) {
+		length <<= 1;
+	}
+	
+	free(table);
+	table = calloc(length, sizeof(uint64_t));
+	tableMask = length - 1;
+	
+	capacity = length;
+	size = 0;
+	sampleSize = length * kSampleFactor;
+}
+
+- (void)ensureCapacity:(NSUInteger)inCapacity
+{
+	if (inCapacity <= capacity) return;
+	
+	[self allocateTableWithCapacity:inCapacity];
+}
+
+- (void)reset
+{
+	memset(table, 0, (tableMask + 1) * sizeof(uint64_t));
+	size = 0;
+}
+
+/**
+ * Each key maps to 4 counters, one in each of 4 (usually distinct) words.
+ * All 4 counters use the same group of 4 nibbles within their word (selected by the low bits of the hash),
+ * and the i'th counter uses the i'th nibble of that group.
+ */
+static inline NSUInteger ZDCFrequencySketchIndex(uint64_t hash, int i, NSUInteger mask)
+{
+	uint64_t h = (hash + kSeeds[i]) * kSeeds[i];
+	h += (h >> 32);
+	return (NSUInteger)(h & mask);
+}
+
+- (void)incrementKey:(NSString *)key
+{
+	uint64_t hash = ZDCFrequencySketchHash(key);
+	int start = (int)((hash & 3) << 2);
+	
+	BOOL incremented = NO;
+	for (int i = 0; i < 4; i++)
+	{
+		NSUInteger index = ZDCFrequencySketchIndex(hash, i, tableMask);
+		int offset = (start + i) << 2;
+		
+		uint64_t mask = (0xfULL << offset);
+		if ((table[index] & mask) != mask)
+		{
+			table[index] += (1ULL << offset);
+			incremented = YES;
+		}
+	}
+	
+	if (incremented && (++size >= sampleSize))
+	{
+		[self age];
+	}
+}
+
+- (NSUInteger)frequencyForKey:(NSString *)key
+{
+	uint64_t hash = ZDCFrequencySketchHash(key);
+	int start = (int)((hash & 3) << 2);
+	
+	NSUInteger frequency = 15;
+	for (int i = 0; i < 4; i++)
+	{
+		NSUInteger index = ZDCFrequencySketchIndex(hash, i, tableMask);
+		int offset = (start + i) << 2;
+		
+		NSUInteger count = (NSUInteger)((table[index] >> offset) & 0xfULL);
+		frequency = MIN(frequency, count);
+	}
+	
+	return frequency;
+}
+
+/**
+ * Halves every counter.
+ */
+- (void)age
+{
+	for (NSUInteger i = 0; i <= tableMask; i++)
+	{
+		table[i] = (table[i] >> 1) & kResetMask;
+	}
+	
+	size = (size >> 1);
+}
+
+- (BOOL)shouldAdmitKey:(NSString *)candidateKey overKey:(NSString *)victimKey
+{
+	NSUInteger candidateFrequency = [self frequencyForKey:candidateKey];
+	NSUInteger victimFrequency = [self frequencyForKey:victimKey];
+	
+	if (candidateFrequency > victimFrequency) {
+		return YES;
+	}
+	
+	if (candidateFrequency <= 5) {
+		return NO;
+	}
+	
+	return (arc4random_uniform(128) == 0);
+}
+
+@end
@@ -0,0 +1,54 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import <Foundation/Foundation.h>
+
+#import "ZDCCloudFileHeader.h"
+#import "ZDCSessionManager.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Invoked once the task completes, and every received byte has been processed.
+ *
+ * If the server responded with a 200, and there were no errors,
+ * then the cache file is complete, and the header is the (decrypted) header of the cloudFile.
+ *
+ * Errors (e.g. network, decryption or disk errors) are reported with a nil response.
+ * Otherwise the response is the server's response (e.g. 403), and the error is nil.
+ */
+typedef void (^ZDCCacheFileDownloadSinkCompletionBlock)(ZDCCloudFileHeader header,
+                                                        NSURLResponse *_Nullable response,
+                                                        NSError *_Nullable error);
+
+/**
+ * Converts a node's data, as it's being downloaded, from cloudFile format into cacheFile format.
+ *
+ * The response body is handed to a CloudFile2CacheFileWriter as it arrives,
+ * so there's no separate pass over the file (to read the header, or to convert it) after the download completes.
+ * The resulting cache file can be imported into the DiskManager as-is.
+ *
+ * The processing happens on a private serial queue, so it doesn't block the session's delegate queue.
+ */
+@interface ZDCCacheFileDownloadSink : NSObject <ZDCSessionDataSink>
+
+- (instancetype)initWithCacheFileURL:(NSURL *)cacheFileURL
+                       encryptionKey:(NSData *)encryptionKey
+                     completionQueue:(nullable dispatch_queue_t)completionQueue
+                     completionBlock:(ZDCCacheFileDownloadSinkCompletionBlock)completionBlock;
+
+/** Where the cache file is written. */
+@property (nonatomic, readonly) NSURL *cacheFileURL;
+
+/** Progress in bytes (of the response body). */
+@property (nonatomic, readonly) NSProgress *progress;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,185 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import "ZDCCacheFileDownloadSink.h"
+
+#import "CloudFile2CacheFileWriter.h"
+#import "ZDCLogging.h"
+
+// Categories
+#import "NSURLResponse+ZeroDark.h"
+
+// Log Levels: off, error, warn, info, verbose
+// Log Flags : trace
+#if DEBUG && robbie_hanson
+  static const int zdcLogLevel = ZDCLogLevelInfo;
+#elif DEBUG
+  static const int zdcLogLevel = ZDCLogLevelWarning;
+#else
+  static const int zdcLogLevel = ZDCLogLevelWarning;
+#endif
+#pragma unused(zdcLogLevel)
+
+
+@implementation ZDCCacheFileDownloadSink
+{
+	dispatch_queue_t queue;
+	
+	CloudFile2CacheFileWriter *writer;      // only access/modify within queue
+	NSError *writeError;                    // only access/modify within queue
+	
+	dispatch_queue_t completionQueue;
+	ZDCCacheFileDownloadSinkCompletionBlock completionBlock;
+	
+	BOOL ignoreBody;                        // only access/modify within session delegate queue
+	BOOL didReceiveFirstData;               // only access/modify within session delegate queue
+}
+
+@synthesize progress = progress;
+
+@dynamic cacheFileURL;
+
+- (instancetype)initWithCacheFileURL:(NSURL *)cacheFileURL
+                       encryptionKey:(NSData *)encryptionKey
+                     completionQueue:(dispatch_queue_t)inCompletionQueue
+                     completionBlock:(ZDCCacheFileDownloadSinkCompletionBlock)inCompletionBlock
+{
+	if ((self = [super init]))
+	{
+		queue = dispatch_queue_create("ZDCCacheFileDownloadSink", DISPATCH_QUEUE_SERIAL);
+		
+		writer = [[CloudFile2CacheFileWriter alloc] initWithCacheFileURL:cacheFileURL encryptionKey:encryptionKey];
+		
+		completionQueue = inCompletionQueue ?: dispatch_get_main_queue();
+		completionBlock = [inCompletionBlock copy];
+		
+		progress = [NSProgress progressWithTotalUnitCount:-1];
+		progress.kind = NSProgressKindFile;
+		[progress setUserInfoObject:NSProgressFileOperationKindDownloading forKey:NSProgressFileOperationKindKey];
+	}
+	return self;
+}
+
+- (NSURL *)cacheFileURL
+{
+	return writer.cacheFileURL;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark ZDCSessionDataSink
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)dataTask:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data
+{
+	if (!didReceiveFirstData)
+	{
+		didReceiveFirstData = YES;
+		
+		// The body of an error response (e.g. 403) is an XML document, not a cloudFile.
+		
+		NSURLResponse *response = dataTask.response;
+		ignoreBody = ([response httpStatusCode] != 200);
+		
+		if (!ignoreBody && (response.expectedContentLength > 0)) {
+			progress.totalUnitCount = response.expectedContentLength;
+		}
+	}
+	
+	if (ignoreBody) {
+		return;
+	}
+	
+	progress.completedUnitCount += data.length;
+	
+	__weak NSURLSessionDataTask *weakTask = dataTask;
+	dispatch_async(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		if (writeError) return;
+		
+		NSError *error = nil;
+		if (![writer writeCloudFileData:data error:&error])
+		{
+			ZDCLogWarn(@"Error converting cloudFile stream: %@", error);
+			
+			writeError = error;
+			[weakTask cancel];
+		}
+		
+	#pragma clang diagnostic pop
+	}});
+}
+
+- (void)task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error
+{
+	NSURLResponse *response = task.response;
+	BOOL isSuccess = ([response httpStatusCode] == 200) && (error == nil);
+	
+	dispatch_async(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		NSURLResponse *resultResponse = response;
+		NSError *resultError = error;
+		
+		ZDCCloudFileHeader header;
+		bzero(&header, sizeof(header));
+		
+		if (writeError)
+		{
+			[writer abort];
+			
+			resultResponse = nil;
+			resultError = writeError;
+		}
+		else if (isSuccess)
+		{
+			NSError *finishError = nil;
+			if ([writer finish:&finishError])
+			{
+				header = writer.cloudFileHeader;
+			}
+			else
+			{
+				// E.g. the connection was closed before the full body arrived.
+				
+				resultResponse = nil;
+				resultError = finishError;
+			}
+		}
+		else
+		{
+			[writer abort];
+			
+			if (error)
+			{
+				// The body was cut short (e.g. network error, or the task was cancelled).
+				// So the response is meaningless, and the download needs to be retried.
+				
+				resultResponse = nil;
+			}
+		}
+		
+		ZDCCacheFileDownloadSinkCompletionBlock block = completionBlock;
+		completionBlock = nil;
+		
+		if (block)
+		{
+			dispatch_async(completionQueue, ^{ @autoreleasepool {
+				
+				block(header, resultResponse, resultError);
+			}});
+		}
+		
+	#pragma clang diagnostic pop
+	}});
+}
+
+@end
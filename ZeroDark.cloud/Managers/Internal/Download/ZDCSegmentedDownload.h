@@ -0,0 +1,117 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import <Foundation/Foundation.h>
+
+@class AFURLSessionManager;
+@class ZDCSessionManager;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Returns a (signed) request for the given byte range.
+ *
+ * The eTag is nil for the first request.
+ * For every subsequent request it's the eTag of the first response,
+ * and should be sent as an If-Match header, so that every segment comes from the same version of the object.
+ */
+typedef NSURLRequest *_Nonnull (^ZDCSegmentedDownloadRequestBlock)(NSRange byteRange, NSString *_Nullable eTag);
+
+/**
+ * On success, the fileURL is the destinationURL, and the response is the response for the first segment.
+ * (So it has the eTag & lastModified values, but a 206 status code.)
+ *
+ * If the server responds with an unexpected status code, the response is that response, and fileURL is nil.
+ * Otherwise, the error explains the problem.
+ */
+typedef void (^ZDCSegmentedDownloadCompletionBlock)(NSURLResponse *_Nullable response,
+                                                    NSURL *_Nullable fileURL,
+                                                    NSError *_Nullable error);
+
+/** The segmented download failed, because the object was modified during the download. */
+extern NSInteger const ZDCSegmentedDownloadErrorCode_ObjectModified;
+
+/** The downloaded file doesn't match the object's eTag. */
+extern NSInteger const ZDCSegmentedDownloadErrorCode_VerificationFailed;
+
+/**
+ * Downloads a single (large) object by fetching several byte ranges concurrently.
+ *
+ * A single HTTP request is limited to a single TCP connection,
+ * which often can't saturate the link (e.g. high latency, or per-connection throttling by the server).
+ * Multiple concurrent connections avoid this bottleneck.
+ *
+ * The process works like so:
+ * - The first segment doubles as a probe. Its Content-Range header tells us the total size of the object.
+ * - The destination file is preallocated, and each segment is written at its offset as it arrives.
+ *   (The response body is streamed straight into the destination file, without an intermediate file per segment.)
+ * - The number of concurrent segments adapts to the measured throughput.
+ *   It starts at 2, and grows as long as each additional connection increases the aggregate throughput.
+ * - Once all segments have arrived, the file is verified against the object's eTag.
+ *
+ * If the server ignores the Range header (i.e. responds with 200), then the first segment is the whole object.
+ */
+@interface ZDCSegmentedDownload : NSObject
+
+/**
+ * @param session
+ *   A foreground session. (Each segment is a data task, which background sessions don't support.)
+ *
+ * @param sessionManager
+ *   Used to stream the response body of each data task into the destination file.
+ */
+- (instancetype)initWithSession:(AFURLSessionManager *)session
+                 sessionManager:(ZDCSessionManager *)sessionManager
+                   requestBlock:(ZDCSegmentedDownloadRequestBlock)requestBlock
+                 destinationURL:(NSURL *)destinationURL;
+
+/**
+ * The size of each segment (except the last).
+ * The default value is 8 MiB.
+ */
+@property (nonatomic, assign, readwrite) uint64_t segmentSize;
+
+/**
+ * The upper bound on the number of concurrent segments.
+ * The default value is 6.
+ */
+@property (nonatomic, assign, readwrite) NSUInteger maxConcurrentSegments;
+
+/**
+ * If known, the expected size of the object. (The total is determined from the first response.)
+ * This only affects the progress, until the first segment arrives.
+ */
+@property (nonatomic, assign, readwrite) uint64_t expectedLength;
+
+/**
+ * Progress in bytes.
+ * The totalUnitCount is updated once the total size of the object is known.
+ */
+@property (nonatomic, readonly) NSProgress *progress;
+
+/**
+ * Applied to every task (including tasks that are already running).
+ */
+- (void)setPriority:(float)priority;
+
+/**
+ * The properties (segmentSize, maxConcurrentSegments, expectedLength) must be configured before starting.
+ */
+- (void)startWithCompletionQueue:(nullable dispatch_queue_t)completionQueue
+                 completionBlock:(ZDCSegmentedDownloadCompletionBlock)completionBlock;
+
+/**
+ * Cancels every task, and deletes the (partial) destination file.
+ * The completionBlock is invoked with an NSURLErrorCancelled error.
+ */
+- (void)cancel;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,919 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import "ZDCSegmentedDownload.h"
+
+#import "ZDCFileChecksum.h"
+#import "ZDCLogging.h"
+#import "ZDCSessionManager.h"
+
+// Categories
+#import "NSData+AWSUtilities.h"
+#import "NSData+S4.h"
+#import "NSError+POSIX.h"
+#import "NSError+ZeroDark.h"
+#import "NSURLResponse+ZeroDark.h"
+
+// Libraries
+#import <AFNetworking/AFNetworking.h>
+#import <fcntl.h>
+#import <unistd.h>
+
+// Log Levels: off, error, warn, info, verbose
+// Log Flags : trace
+#if DEBUG && robbie_hanson
+  static const int zdcLogLevel = ZDCLogLevelInfo;
+#elif DEBUG
+  static const int zdcLogLevel = ZDCLogLevelWarning;
+#else
+  static const int zdcLogLevel = ZDCLogLevelWarning;
+#endif
+#pragma unused(zdcLogLevel)
+
+NSInteger const ZDCSegmentedDownloadErrorCode_ObjectModified     = 412;
+NSInteger const ZDCSegmentedDownloadErrorCode_VerificationFailed = 2003;
+
+static uint64_t const kDefaultSegmentSize           = (1024 * 1024 * 8); // 8 MiB
+static NSUInteger const kDefaultMaxConcurrentSegments = 6;
+static NSUInteger const kInitialConcurrentSegments    = 2;
+
+static NSUInteger const kMaxSegmentFailCount = 4; // retries per segment (before failing the whole download)
+
+// When the aggregate throughput changes by less than this (relative) amount,
+// adding or removing a connection isn't considered to have made a difference.
+static double const kThroughputThreshold = 0.10;
+
+// S3 multipart uploads: each part (excluding the last) must be >= 5 MiB, and there can be at most 10,000 parts.
+static uint64_t const kMultipartMinPartSize = (1024 * 1024 * 5);
+static uint64_t const kMultipartMaxParts    = 10000;
+
+@class ZDCDownloadSegment;
+
+@interface ZDCSegmentedDownload ()
+
+- (void)segment:(ZDCDownloadSegment *)segment
+       dataTask:(NSURLSessionDataTask *)dataTask
+ didReceiveData:(NSData *)data;
+
+- (void)segment:(ZDCDownloadSegment *)segment
+           task:(NSURLSessionTask *)task
+    didCompleteWithError:(nullable NSError *)error;
+
+@end
+
+/**
+ * A single byte range of the object.
+ *
+ * Also acts as the data sink for the segment's task,
+ * forwarding the response body to the ZDCSegmentedDownload (which writes it into the destination file).
+ */
+@interface ZDCDownloadSegment : NSObject <ZDCSessionDataSink>
+
+@property (nonatomic, weak, readwrite) ZDCSegmentedDownload *owner;
+
+@property (nonatomic, assign, readwrite) uint64_t offset;
+@property (nonatomic, assign, readwrite) uint64_t length;
+
+@property (nonatomic, assign, readwrite) BOOL isProbe;
+@property (nonatomic, assign, readwrite) NSUInteger failCount;
+
+// While in-flight:
+
+@property (nonatomic, strong, readwrite, nullable) NSURLSessionDataTask *task;
+@property (nonatomic, assign, readwrite) uint64_t bytesReceived; // bytes written to the destination file
+@property (nonatomic, assign, readwrite) uint64_t maxBytes;      // bytes we're allowed to write (from Content-Range)
+@property (nonatomic, assign, readwrite) BOOL didReceiveResponse;
+@property (nonatomic, assign, readwrite) BOOL ignoreBody;        // unexpected response, or more data than expected
+@property (nonatomic, strong, readwrite, nullable) NSError *writeError;
+
+@end
+
+@implementation ZDCDownloadSegment
+
+- (void)dataTask:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data
+{
+	[_owner segment:self dataTask:dataTask didReceiveData:data];
+}
+
+- (void)task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error
+{
+	[_owner segment:self task:task didCompleteWithError:error];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation ZDCSegmentedDownload
+{
+	AFURLSessionManager *session;
+	ZDCSessionManager *sessionManager;
+	ZDCSegmentedDownloadRequestBlock requestBlock;
+	NSURL *destinationURL;
+	
+	dispatch_queue_t queue; // all state below is only accessed/modified within this queue
+	
+	dispatch_queue_t completionQueue;
+	ZDCSegmentedDownloadCompletionBlock completionBlock;
+	
+	int fd;
+	BOOL isFinished;
+	float priority;
+	
+	NSURLResponse *firstResponse;
+	NSString *eTag;
+	
+	uint64_t totalLength;   // zero until the probe arrives
+	uint64_t nextOffset;    // start of the next segment that hasn't been requested yet
+	uint64_t completedBytes;
+	
+	NSMutableArray<ZDCDownloadSegment *> *activeSegments;
+	NSMutableArray<ZDCDownloadSegment *> *retrySegments;
+	
+	NSUInteger targetConcurrency;
+	
+	CFAbsoluteTime sampleStart;
+	uint64_t sampleBytes;
+	NSUInteger sampleSegments;
+	double lastThroughput;    // bytes per second, measured over the previous sample
+	BOOL lastAdjustmentWasIncrease;
+}
+
+@synthesize segmentSize = segmentSize;
+@synthesize maxConcurrentSegments = maxConcurrentSegments;
+@synthesize expectedLength = expectedLength;
+@synthesize progress = progress;
+
+- (instancetype)initWithSession:(AFURLSessionManager *)inSession
+                 sessionManager:(ZDCSessionManager *)inSessionManager
+                   requestBlock:(ZDCSegmentedDownloadRequestBlock)inRequestBlock
+                 destinationURL:(NSURL *)inDestinationURL
+{
+	if ((self = [super init]))
+	{
+		session = inSession;
+		sessionManager = inSessionManager;
+		requestBlock = [inRequestBlock copy];
+		destinationURL = [inDestinationURL copy];
+		
+		queue = dispatch_queue_create("ZDCSegmentedDownload", DISPATCH_QUEUE_SERIAL);
+		
+		fd = -1;
+		priority = NSURLSessionTaskPriorityDefault;
+		
+		activeSegments = [[NSMutableArray alloc] init];
+		retrySegments = [[NSMutableArray alloc] init];
+		
+		segmentSize = kDefaultSegmentSize;
+		maxConcurrentSegments = kDefaultMaxConcurrentSegments;
+		
+		progress = [NSProgress progressWithTotalUnitCount:-1];
+		progress.kind = NSProgressKindFile;
+		[progress setUserInfoObject:NSProgressFileOperationKindDownloading forKey:NSProgressFileOperationKindKey];
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	if (fd >= 0) {
+		close(fd);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Public API
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)setPriority:(float)inPriority
+{
+	dispatch_async(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	
+		priority = inPriority;
+		for (ZDCDownloadSegment *segment in activeSegments)
+		{
+			segment.task.priority = inPriority;
+		}
+	
+	#pragma clang diagnostic pop
+	}});
+}
+
+- (void)startWithCompletionQueue:(dispatch_queue_t)inCompletionQueue
+                 completionBlock:(ZDCSegmentedDownloadCompletionBlock)inCompletionBlock
+{
+	ZDCLogAutoTrace();
+	
+	if (expectedLength > 0) {
+		progress.totalUnitCount = (int64_t)expectedLength;
+	}
+	
+	dispatch_async(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	
+		completionQueue = inCompletionQueue ?: dispatch_get_main_queue();
+		completionBlock = [inCompletionBlock copy];
+		
+		if (segmentSize == 0) {
+			segmentSize = kDefaultSegmentSize;
+		}
+		if (maxConcurrentSegments == 0) {
+			maxConcurrentSegments = 1;
+		}
+		
+		fd = open([destinationURL.path fileSystemRepresentation], O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+		{
+			[self finishWithResponse:nil fileURL:nil error:[NSError errorWithPOSIXCode:errno]];
+			return;
+		}
+		
+		ZDCDownloadSegment *probe = [[ZDCDownloadSegment alloc] init];
+		probe.offset = 0;
+		probe.length = segmentSize;
+		probe.isProbe = YES;
+		
+		[self startSegment:probe];
+	
+	#pragma clang diagnostic pop
+	}});
+}
+
+- (void)cancel
+{
+	ZDCLogAutoTrace();
+	
+	dispatch_async(queue, ^{ @autoreleasepool {
+	
+		NSError *error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil];
+		[self finishWithResponse:nil fileURL:nil error:error];
+	}});
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Segments
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)startSegment:(ZDCDownloadSegment *)segment
+{
+	NSAssert(!isFinished, @"Starting segment after the download finished");
+	
+	NSRange byteRange = NSMakeRange((NSUInteger)segment.offset, (NSUInteger)segment.length);
+	NSURLRequest *request = requestBlock(byteRange, eTag);
+	
+	// Important: Use the NSURLSession directly.
+	// Otherwise AFNetworking buffers the entire response in memory.
+	
+	NSURLSessionDataTask *task = [session.session dataTaskWithRequest:request];
+	task.priority = priority;
+	
+	segment.owner = self;
+	segment.task = task;
+	segment.bytesReceived = 0;
+	segment.maxBytes = 0;
+	segment.didReceiveResponse = NO;
+	segment.ignoreBody = NO;
+	segment.writeError = nil;
+	[activeSegments addObject:segment];
+	
+	[sessionManager associateDataSink:segment withTask:task inSession:session.session];
+	[task resume];
+}
+
+/**
+ * Invoked (on the session's delegate queue) as the response body arrives.
+ */
+- (void)segment:(ZDCDownloadSegment *)segment
+       dataTask:(NSURLSessionDataTask *)dataTask
+ didReceiveData:(NSData *)data
+{
+	NSURLResponse *response = dataTask.response;
+	
+	dispatch_async(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		if (isFinished || (segment.task != dataTask)) return;
+		
+		if (!segment.didReceiveResponse)
+		{
+			segment.didReceiveResponse = YES;
+			segment.maxBytes = [self writableLengthForSegment:segment response:response];
+			segment.ignoreBody = (segment.maxBytes == 0);
+		}
+		
+		if (segment.ignoreBody || segment.writeError) return;
+		
+		if ((segment.bytesReceived + data.length) > segment.maxBytes)
+		{
+			// More data than the Content-Range promised.
+			// Don't write it, as it would overwrite the next segment.
+			
+			segment.ignoreBody = YES;
+			segment.bytesReceived = 0;
+			return;
+		}
+		
+		NSError *error = nil;
+		if (![self writeData:data toOffset:(segment.offset + segment.bytesReceived) error:&error])
+		{
+			ZDCLogWarn(@"Error writing segment(%llu): %@", segment.offset, error);
+			
+			segment.writeError = error;
+			[dataTask cancel];
+			return;
+		}
+		
+		segment.bytesReceived += data.length;
+		[self updateProgress];
+		
+	#pragma clang diagnostic pop
+	}});
+}
+
+/**
+ * Invoked (on the session's delegate queue) when the task completes.
+ */
+- (void)segment:(ZDCDownloadSegment *)segment
+           task:(NSURLSessionTask *)task
+    didCompleteWithError:(NSError *)error
+{
+	NSURLResponse *response = task.response;
+	
+	dispatch_async(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		if (isFinished || (segment.task != task)) return;
+		
+		[self segment:segment didCompleteWithResponse:response error:error];
+		
+	#pragma clang diagnostic pop
+	}});
+}
+
+/**
+ * Returns the number of bytes of the response body that may be written into the destination file.
+ * This is zero if the body isn't part of the object (e.g. an error response, or an unexpected range).
+ */
+- (uint64_t)writableLengthForSegment:(ZDCDownloadSegment *)segment response:(NSURLResponse *)response
+{
+	NSInteger statusCode = [response httpStatusCode];
+	
+	if (segment.isProbe && (statusCode == 200))
+	{
+		// The server ignored our Range header, and is sending us the entire object.
+		return UINT64_MAX;
+	}
+	
+	if (statusCode != 206) {
+		return 0;
+	}
+	
+	uint64_t rangeStart = 0;
+	uint64_t rangeLength = 0;
+	uint64_t rangeTotal = 0;
+	
+	if (![self parseContentRange:response start:&rangeStart length:&rangeLength total:&rangeTotal]) {
+		return 0;
+	}
+	
+	if ((rangeStart != segment.offset) || (rangeLength > segment.length)) {
+		return 0;
+	}
+	
+	return rangeLength;
+}
+
+- (void)segment:(ZDCDownloadSegment *)segment
+        didCompleteWithResponse:(NSURLResponse *)response
+                          error:(NSError *)error
+{
+	[activeSegments removeObjectIdenticalTo:segment];
+	segment.task = nil;
+	
+	uint64_t bytesReceived = segment.ignoreBody ? 0 : segment.bytesReceived;
+	segment.bytesReceived = 0;
+	
+	if (segment.writeError)
+	{
+		[self finishWithResponse:nil fileURL:nil error:segment.writeError];
+		return;
+	}
+	
+	BOOL isTruncated = (error != nil);
+	if (response && error)
+	{
+		error = nil; // we only care about non-server-response errors
+	}
+	
+	NSInteger statusCode = [response httpStatusCode];
+	
+	// Known status codes:
+	//
+	// - 200 : OK                  - server ignored the Range header
+	// - 206 : Partial Content     - due to Range header
+	// - 412 : Precondition Failed - due to If-Match header (object was modified)
+	// - 500 : Internal Error      - retry
+	// - 503 : Slow Down           - we're being throttled
+	
+	if (error || (statusCode == 500) || (statusCode == 503))
+	{
+		[self retrySegment:segment withResponse:response error:error];
+		return;
+	}
+	
+	if (statusCode == 412)
+	{
+		NSError *modifiedError =
+		  [NSError errorWithClass: [self class]
+		                     code: ZDCSegmentedDownloadErrorCode_ObjectModified
+		              description: @"The object was modified during the download"];
+		
+		[self finishWithResponse:nil fileURL:nil error:modifiedError];
+		return;
+	}
+	
+	if (segment.isProbe && (statusCode == 200))
+	{
+		// The server ignored our Range header, and sent us the entire object.
+		// Which has been written into the destination file (starting at offset zero).
+		
+		int64_t expectedSize = response.expectedContentLength;
+		
+		if (isTruncated || segment.ignoreBody || ((expectedSize >= 0) && (bytesReceived != (uint64_t)expectedSize)))
+		{
+			NSError *truncatedError =
+			  [NSError errorWithClass:[self class] code:2000 description:@"Incomplete response from server"];
+			
+			[self retrySegment:segment withResponse:nil error:truncatedError];
+			return;
+		}
+		
+		if (ftruncate(fd, (off_t)bytesReceived) != 0)
+		{
+			[self finishWithResponse:nil fileURL:nil error:[NSError errorWithPOSIXCode:errno]];
+			return;
+		}
+		
+		[self finishWithResponse:response fileURL:destinationURL error:nil];
+		return;
+	}
+	
+	if (statusCode != 206)
+	{
+		[self finishWithResponse:response fileURL:nil error:nil];
+		return;
+	}
+	
+	uint64_t rangeStart = 0;
+	uint64_t rangeLength = 0;
+	uint64_t rangeTotal = 0;
+	
+	BOOL isValid = [self parseContentRange:response start:&rangeStart length:&rangeLength total:&rangeTotal];
+	
+	if (isValid && !segment.isProbe)
+	{
+		// The If-Match header should prevent this, but better safe than sorry.
+		if (![[response eTag] isEqualToString:eTag] || (rangeTotal != totalLength))
+		{
+			NSError *modifiedError =
+			  [NSError errorWithClass: [self class]
+			                     code: ZDCSegmentedDownloadErrorCode_ObjectModified
+			              description: @"The object was modified during the download"];
+			
+			[self finishWithResponse:nil fileURL:nil error:modifiedError];
+			return;
+		}
+	}
+	
+	if (isValid)
+	{
+		uint64_t expectedSize = segment.isProbe ? MIN(segment.length, rangeTotal) : segment.length;
+		
+		isValid = (rangeStart == segment.offset)
+		       && (rangeLength == expectedSize)
+		       && (bytesReceived == expectedSize);
+	}
+	
+	if (!isValid)
+	{
+		// Truncated or unexpected response. Treat it like a network error.
+		// The retry overwrites whatever was written for this segment.
+		
+		NSError *rangeError =
+		  [NSError errorWithClass:[self class] code:2000 description:@"Unexpected Content-Range from server"];
+		
+		[self retrySegment:segment withResponse:nil error:rangeError];
+		return;
+	}
+	
+	if (segment.isProbe)
+	{
+		firstResponse = response;
+		eTag = [response eTag];
+		
+		totalLength = rangeTotal;
+		segment.length = rangeLength;
+		nextOffset = rangeLength;
+		
+		// Preallocate the file, so every segment can be written at its offset as soon as it arrives.
+		
+		if (ftruncate(fd, (off_t)totalLength) != 0)
+		{
+			[self finishWithResponse:nil fileURL:nil error:[NSError errorWithPOSIXCode:errno]];
+			return;
+		}
+		
+		progress.totalUnitCount = (int64_t)totalLength;
+		
+		targetConcurrency = MIN(kInitialConcurrentSegments, maxConcurrentSegments);
+		sampleStart = CFAbsoluteTimeGetCurrent();
+	}
+	
+	completedBytes += segment.length;
+	[self updateProgress];
+	
+	if (!segment.isProbe) {
+		[self recordThroughputForSegment:segment];
+	}
+	
+	if (completedBytes >= totalLength)
+	{
+		[self verify];
+	}
+	else
+	{
+		[self startSegments];
+	}
+}
+
+- (void)retrySegment:(ZDCDownloadSegment *)segment withResponse:(NSURLResponse *)response error:(NSError *)error
+{
+	segment.failCount++;
+	
+	if (segment.failCount > kMaxSegmentFailCount)
+	{
+		if (error == nil && response == nil) {
+			error = [NSError errorWithClass:[self class] code:503 description:@"Exceeded max retries"];
+		}
+		
+		[self finishWithResponse:(error ? nil : response) fileURL:nil error:error];
+		return;
+	}
+	
+	ZDCLogVerbose(@"Retrying segment(%llu): failCount(%lu): %@",
+	              segment.offset, (unsigned long)segment.failCount, error);
+	
+	// Throttling or flaky network: back off on this connection.
+	// The other connections will pick up the slack in the meantime.
+	
+	if (targetConcurrency > 1)
+	{
+		targetConcurrency--;
+		lastAdjustmentWasIncrease = NO;
+	}
+	
+	NSTimeInterval delay = 0.5 * (double)(1 << MIN(segment.failCount, (NSUInteger)6));
+	
+	__weak typeof(self) weakSelf = self;
+	dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), queue, ^{ @autoreleasepool {
+	
+		__strong typeof(self) strongSelf = weakSelf;
+		if (strongSelf == nil || strongSelf->isFinished) return;
+		
+		if (segment.isProbe)
+		{
+			[strongSelf startSegment:segment];
+		}
+		else
+		{
+			[strongSelf->retrySegments addObject:segment];
+			[strongSelf startSegments];
+		}
+	}});
+}
+
+/**
+ * Starts segments until we reach the target concurrency (or run out of segments).
+ * Failed segments take precedence, so the file is completed roughly in order.
+ */
+- (void)startSegments
+{
+	while (!isFinished && (activeSegments.count < targetConcurrency))
+	{
+		ZDCDownloadSegment *segment = nil;
+		
+		if (retrySegments.count > 0)
+		{
+			segment = retrySegments[0];
+			[retrySegments removeObjectAtIndex:0];
+		}
+		else if (nextOffset < totalLength)
+		{
+			segment = [[ZDCDownloadSegment alloc] init];
+			segment.offset = nextOffset;
+			segment.length = MIN(segmentSize, totalLength - nextOffset);
+			
+			nextOffset += segment.length;
+		}
+		else
+		{
+			break;
+		}
+		
+		[self startSegment:segment];
+	}
+}
+
+/**
+ * Hill climbing on the number of concurrent segments.
+ *
+ * We measure the aggregate throughput over a "round" (as many completed segments as there are connections).
+ * - If the throughput improved noticeably, another connection might help further, so add one.
+ * - If the throughput dropped noticeably after adding a connection, the extra connection hurt, so remove it.
+ * - Otherwise we're at (or near) the link capacity, and we hold steady.
+ */
+- (void)recordThroughputForSegment:(ZDCDownloadSegment *)segment
+{
+	sampleBytes += segment.length;
+	sampleSegments++;
+	
+	if (sampleSegments < targetConcurrency) {
+		return;
+	}
+	
+	CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+	CFAbsoluteTime elapsed = MAX(now - sampleStart, 0.001);
+	
+	double throughput = (double)sampleBytes / elapsed;
+	
+	if ((lastThroughput == 0) || (throughput > (lastThroughput * (1.0 + kThroughputThreshold))))
+	{
+		if (targetConcurrency < maxConcurrentSegments)
+		{
+			targetConcurrency++;
+			lastAdjustmentWasIncrease = YES;
+		}
+	}
+	else if (lastAdjustmentWasIncrease && (throughput < (lastThroughput * (1.0 - kThroughputThreshold))))
+	{
+		if (targetConcurrency > 1)
+		{
+			targetConcurrency--;
+		}
+		lastAdjustmentWasIncrease = NO;
+	}
+	
+	ZDCLogVerbose(@"Segmented download: throughput(%.0f KiB/s) -> concurrency(%lu)",
+	              (throughput / 1024.0), (unsigned long)targetConcurrency);
+	
+	lastThroughput = throughput;
+	
+	sampleStart = now;
+	sampleBytes = 0;
+	sampleSegments = 0;
+}
+
+- (void)updateProgress
+{
+	int64_t inFlight = 0;
+	for (ZDCDownloadSegment *segment in activeSegments)
+	{
+		inFlight += (int64_t)segment.bytesReceived;
+	}
+	
+	progress.completedUnitCount = (int64_t)completedBytes + inFlight;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Utilities
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Parses a header of the form: "Content-Range: bytes <first>-<last>/<total>"
+ */
+- (BOOL)parseContentRange:(NSURLResponse *)response
+                    start:(uint64_t *)outStart
+                   length:(uint64_t *)outLength
+                    total:(uint64_t *)outTotal
+{
+	if (![response isKindOfClass:[NSHTTPURLResponse class]]) {
+		return NO;
+	}
+	
+	NSString *contentRange = [(NSHTTPURLResponse *)response allHeaderFields][@"Content-Range"];
+	if (contentRange == nil) {
+		return NO;
+	}
+	
+	unsigned long long first = 0;
+	unsigned long long last = 0;
+	unsigned long long total = 0;
+	
+	if (sscanf([contentRange UTF8String], "bytes %llu-%llu/%llu", &first, &last, &total) != 3) {
+		return NO;
+	}
+	
+	if ((last < first) || (last >= total)) {
+		return NO;
+	}
+	
+	*outStart = first;
+	*outLength = (last - first + 1);
+	*outTotal = total;
+	return YES;
+}
+
+- (BOOL)writeData:(NSData *)data toOffset:(uint64_t)offset error:(NSError **)outError
+{
+	__block int errorCode = 0;
+	
+	[data enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
+		
+		size_t written = 0;
+		while (written < byteRange.length)
+		{
+			ssize_t result = pwrite(fd, (const uint8_t *)bytes + written,
+			                        byteRange.length - written,
+			                        (off_t)(offset + byteRange.location + written));
+			if (result < 0)
+			{
+				errorCode = errno;
+				*stop = YES;
+				break;
+			}
+			written += (size_t)result;
+		}
+	}];
+	
+	if (errorCode != 0)
+	{
+		if (outError) *outError = [NSError errorWithPOSIXCode:errorCode];
+		return NO;
+	}
+	
+	if (outError) *outError = nil;
+	return YES;
+}
+
+/**
+ * Mirrors the part size selection of the PushManager's multipart uploads.
+ */
+- (uint64_t)multipartChunkSizeForFileSize:(uint64_t)fileSize
+{
+	uint64_t chunkSize = kMultipartMinPartSize;
+	
+	while (((fileSize + chunkSize - 1) / chunkSize) > kMultipartMaxParts)
+	{
+		chunkSize += (1024 * 1024 * 1);
+	}
+	
+	return chunkSize;
+}
+
+/**
+ * S3 eTags come in 2 forms:
+ * - simple upload    : hex(MD5(file))
+ * - multipart upload : hex(MD5(MD5(part_0) + MD5(part_1) + ...)) + "-" + numberOfParts
+ *
+ * The part size isn't recorded anywhere. But our multipart uploads select it deterministically from the file size.
+ * If the number of parts doesn't match (e.g. the object was uploaded by a different client),
+ * or the eTag isn't an MD5 (e.g. server-side encryption with KMS), then the file can't be verified.
+ * In that case we rely on the If-Match header, which guarantees every segment came from the same object.
+ */
+- (void)verify
+{
+	close(fd);
+	fd = -1;
+	
+	NSArray<NSString *> *components = [eTag componentsSeparatedByString:@"-"];
+	NSString *expectedHash = [components.firstObject lowercaseString];
+	
+	uint64_t partsCount = 0;
+	uint64_t chunkSize = 0;
+	
+	BOOL canVerify = (expectedHash.length == 32) && (components.count <= 2);
+	if (canVerify && (components.count == 2))
+	{
+		partsCount = (uint64_t)[components[1] longLongValue];
+		chunkSize = [self multipartChunkSizeForFileSize:totalLength];
+		
+		canVerify = (partsCount > 0) && (((totalLength + chunkSize - 1) / chunkSize) == partsCount);
+	}
+	
+	if (!canVerify)
+	{
+		ZDCLogVerbose(@"Unable to verify segmented download against eTag: %@", eTag);
+		
+		[self finishWithResponse:firstResponse fileURL:destinationURL error:nil];
+		return;
+	}
+	
+	NSMutableData *partHashes = (partsCount > 0) ? [NSMutableData data] : nil;
+	__block NSData *fullHash = nil;
+	
+	__weak typeof(self) weakSelf = self;
+	
+	ZDCFileChecksumInstruction *instruction = [[ZDCFileChecksumInstruction alloc] init];
+	instruction.algorithm = kHASH_Algorithm_MD5;
+	instruction.chunkSize = (partsCount > 0) ? @(chunkSize) : nil;
+	instruction.callbackQueue = queue;
+	instruction.callbackBlock = ^(NSData *hash, uint64_t chunkIndex, BOOL done, NSError *error) {
+	
+		if (hash)
+		{
+			if (partHashes)
+				[partHashes appendData:hash];
+			else
+				fullHash = hash;
+		}
+		
+		if (!done) return;
+		
+		__strong typeof(self) strongSelf = weakSelf;
+		if (strongSelf == nil || strongSelf->isFinished) return;
+		
+		if (error)
+		{
+			[strongSelf finishWithResponse:nil fileURL:nil error:error];
+			return;
+		}
+		
+		if (partHashes) {
+			fullHash = [partHashes hashWithAlgorithm:kHASH_Algorithm_MD5 error:nil];
+		}
+		
+		if ([[fullHash lowercaseHexString] isEqualToString:expectedHash])
+		{
+			[strongSelf finishWithResponse:strongSelf->firstResponse fileURL:strongSelf->destinationURL error:nil];
+		}
+		else
+		{
+			NSError *verifyError =
+			  [NSError errorWithClass: [strongSelf class]
+			                     code: ZDCSegmentedDownloadErrorCode_VerificationFailed
+			              description: @"Downloaded file doesn't match eTag"];
+			
+			[strongSelf finishWithResponse:nil fileURL:nil error:verifyError];
+		}
+	};
+	
+	NSError *paramError = nil;
+	[ZDCFileChecksum checksumFileURL: destinationURL
+	                withInstructions: @[ instruction ]
+	                           error: &paramError];
+	
+	if (paramError)
+	{
+		ZDCLogError(@"ZDCFileChecksum paramError: %@", paramError);
+		[self finishWithResponse:nil fileURL:nil error:paramError];
+	}
+}
+
+- (void)finishWithResponse:(NSURLResponse *)response fileURL:(NSURL *)fileURL error:(NSError *)error
+{
+	if (isFinished) return;
+	isFinished = YES;
+	
+	for (ZDCDownloadSegment *segment in activeSegments)
+	{
+		[segment.task cancel];
+	}
+	[activeSegments removeAllObjects];
+	[retrySegments removeAllObjects];
+	
+	if (fd >= 0)
+	{
+		close(fd);
+		fd = -1;
+	}
+	
+	if (fileURL == nil) {
+		[[NSFileManager defaultManager] removeItemAtURL:destinationURL error:nil];
+	}
+	
+	ZDCSegmentedDownloadCompletionBlock block = completionBlock;
+	completionBlock = nil;
+	
+	if (block)
+	{
+		dispatch_async(completionQueue, ^{ @autoreleasepool {
+		
+			block(response, fileURL, error);
+		}});
+	}
+}
+
+@end
@@ -0,0 +1,127 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import <Foundation/Foundation.h>
+
+#import "OSPlatform.h"
+#import "ZDCImageManager.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Invoked after decoding (and processing) an image.
+ *
+ * @param image
+ *   The decoded image, or nil if the data couldn't be decoded.
+ *
+ * @param cost
+ *   The size of the decoded bitmap (in bytes).
+ *   This is the amount of memory the image occupies while it sits in a cache,
+ *   which is generally much larger than the size of the compressed image data.
+ */
+typedef void (^ZDCImageDecoderCompletionBlock)(OSImage *_Nullable image, NSUInteger cost, NSError *_Nullable error);
+
+/**
+ * Decodes image data on a bounded number of background threads.
+ *
+ * Images are decoded via ImageIO, and can be downsampled while decoding (which is far cheaper than
+ * decoding the full image and then scaling it). The bitmap is decoded immediately,
+ * so that drawing the image on the main thread doesn't trigger a lazy decode.
+ *
+ * At most `maxConcurrentDecodes` decodes run at a time. Additional requests wait in a FIFO queue.
+ * This keeps a burst of requests (e.g. a fast scroll through a grid of thumbnails)
+ * from spawning a thread per request, while still using multiple cores.
+ *
+ * Low priority requests (e.g. prefetching) wait in a separate FIFO queue,
+ * and are only started when there are no normal priority requests waiting.
+ */
+@interface ZDCImageDecoder : NSObject
+
+/**
+ * @param maxConcurrentDecodes
+ *   The upper bound on the number of images being decoded at any one time.
+ *   If zero, a default value is used (based on the number of active processors).
+ */
+- (instancetype)initWithMaxConcurrentDecodes:(NSUInteger)maxConcurrentDecodes;
+
+/** The upper bound on the number of images being decoded at any one time. */
+@property (atomic, assign, readwrite) NSUInteger maxConcurrentDecodes;
+
+/**
+ * Enqueues the data for decoding.
+ *
+ * @param data
+ *   The (compressed) image data. E.g. jpeg, png, heic, etc.
+ *
+ * @param maxPixelSize
+ *   If non-zero, the image is downsampled (while decoding) so that neither dimension exceeds this size.
+ *   Images smaller than this are not upscaled.
+ *
+ * @param processingBlock
+ *   Optional block to run on the decoded image. It's invoked on the same background thread as the decode.
+ *   Since decodes run concurrently, the block may be invoked concurrently.
+ *
+ * @param completionQueue
+ *   The dispatch queue on which to invoke the completionBlock.
+ *   If nil, the main thread is automatically used.
+ *
+ * @param completionBlock
+ *   Invoked with the result.
+ */
+- (void)decodeImageData:(NSData *)data
+           maxPixelSize:(CGFloat)maxPixelSize
+        processingBlock:(nullable ZDCImageProcessingBlock)processingBlock
+        completionQueue:(nullable dispatch_queue_t)completionQueue
+        completionBlock:(ZDCImageDecoderCompletionBlock)completionBlock;
+
+/**
+ * Enqueues the data for decoding, with the given priority.
+ *
+ * @param lowPriority
+ *   If YES, the request is only started when there are no normal priority requests waiting.
+ *
+ * @param isCancelledBlock
+ *   Optional block that's consulted just before the decode starts.
+ *   If it returns YES, the data isn't decoded, and the completionBlock is invoked with a nil image & an error.
+ *
+ * See `decodeImageData:maxPixelSize:processingBlock:completionQueue:completionBlock:` for the other parameters.
+ */
+- (void)decodeImageData:(NSData *)data
+           maxPixelSize:(CGFloat)maxPixelSize
+            lowPriority:(BOOL)lowPriority
+            isCancelled:(nullable BOOL (^)(void))isCancelledBlock
+        processingBlock:(nullable ZDCImageProcessingBlock)processingBlock
+        completionQueue:(nullable dispatch_queue_t)completionQueue
+        completionBlock:(ZDCImageDecoderCompletionBlock)completionBlock;
+
+/**
+ * Synchronously decodes the image data on the current thread.
+ * Returns nil if the data isn't a supported image format.
+ */
++ (nullable OSImage *)decodeImageData:(NSData *)data maxPixelSize:(CGFloat)maxPixelSize;
+
+/**
+ * Returns the size of the image's decoded bitmap, in bytes.
+ */
++ (NSUInteger)decodedByteCountForImage:(OSImage *)image;
+
+#pragma mark Statistics
+
+/** The number of images decoded so far (including failures). */
+@property (atomic, readonly) NSUInteger decodeCount;
+
+/** The total time spent decoding & processing images (summed across all threads). */
+@property (atomic, readonly) NSTimeInterval decodeDuration;
+
+/** The total number of decoded bytes produced. */
+@property (atomic, readonly) uint64_t decodedByteCount;
+
+@end
+
+NS_ASSUME_NONNULL_END
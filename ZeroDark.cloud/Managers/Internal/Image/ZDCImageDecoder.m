@@ -0,0 +1,381 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import "ZDCImageDecoder.h"
+
+#import "ZDCLogging.h"
+
+// Categories
+#import "NSError+ZeroDark.h"
+#import "OSImage+ZeroDark.h"
+
+// Libraries
+#import <ImageIO/ImageIO.h>
+
+// Log Levels: off, error, warn, info, verbose
+// Log Flags : trace
+#if DEBUG && robbie_hanson
+  static const int zdcLogLevel = ZDCLogLevelInfo;
+#elif DEBUG
+  static const int zdcLogLevel = ZDCLogLevelWarning;
+#else
+  static const int zdcLogLevel = ZDCLogLevelWarning;
+#endif
+#pragma unused(zdcLogLevel)
+
+static NSUInteger const kMinDefaultConcurrentDecodes = 2;
+static NSUInteger const kMaxDefaultConcurrentDecodes = 4;
+
+@interface ZDCImageDecoderRequest : NSObject
+
+@property (nonatomic, strong) NSData *data;
+@property (nonatomic, assign) CGFloat maxPixelSize;
+@property (nonatomic, copy, nullable) BOOL (^isCancelledBlock)(void);
+@property (nonatomic, copy, nullable) ZDCImageProcessingBlock processingBlock;
+@property (nonatomic, strong) dispatch_queue_t completionQueue;
+@property (nonatomic, copy) ZDCImageDecoderCompletionBlock completionBlock;
+
+@end
+
+@implementation ZDCImageDecoderRequest
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation ZDCImageDecoder {
+
+	dispatch_queue_t queue;       // serial: protects the variables below
+	dispatch_queue_t decodeQueue; // concurrent
+	
+	NSMutableArray<ZDCImageDecoderRequest *> *pendingRequests;
+	NSMutableArray<ZDCImageDecoderRequest *> *pendingLowPriorityRequests;
+	NSUInteger activeCount;
+	NSUInteger maxConcurrentDecodes;
+	
+	NSUInteger decodeCount;
+	NSTimeInterval decodeDuration;
+	uint64_t decodedByteCount;
+}
+
+@dynamic maxConcurrentDecodes;
+@dynamic decodeCount;
+@dynamic decodeDuration;
+@dynamic decodedByteCount;
+
+- (instancetype)init
+{
+	return [self initWithMaxConcurrentDecodes:0];
+}
+
+- (instancetype)initWithMaxConcurrentDecodes:(NSUInteger)inMaxConcurrentDecodes
+{
+	if ((self = [super init]))
+	{
+		queue = dispatch_queue_create("ZDCImageDecoder", DISPATCH_QUEUE_SERIAL);
+		decodeQueue = dispatch_queue_create("ZDCImageDecoder-decode", DISPATCH_QUEUE_CONCURRENT);
+		
+		pendingRequests = [[NSMutableArray alloc] init];
+		pendingLowPriorityRequests = [[NSMutableArray alloc] init];
+		
+		if (inMaxConcurrentDecodes == 0)
+		{
+			NSUInteger processorCount = [[NSProcessInfo processInfo] activeProcessorCount];
+			
+			inMaxConcurrentDecodes = MAX(kMinDefaultConcurrentDecodes,
+			                         MIN(kMaxDefaultConcurrentDecodes, processorCount));
+		}
+		maxConcurrentDecodes = inMaxConcurrentDecodes;
+	}
+	return self;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Properties
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSUInteger)maxConcurrentDecodes
+{
+	__block NSUInteger result = 0;
+	dispatch_sync(queue, ^{
+		result = self->maxConcurrentDecodes;
+	});
+	
+	return result;
+}
+
+- (void)setMaxConcurrentDecodes:(NSUInteger)value
+{
+	dispatch_async(queue, ^{ @autoreleasepool {
+	
+		self->maxConcurrentDecodes = MAX(1, value);
+		[self startPendingRequests];
+	}});
+}
+
+- (NSUInteger)decodeCount
+{
+	__block NSUInteger result = 0;
+	dispatch_sync(queue, ^{
+		result = self->decodeCount;
+	});
+	
+	return result;
+}
+
+- (NSTimeInterval)decodeDuration
+{
+	__block NSTimeInterval result = 0;
+	dispatch_sync(queue, ^{
+		result = self->decodeDuration;
+	});
+	
+	return result;
+}
+
+- (uint64_t)decodedByteCount
+{
+	__block uint64_t result = 0;
+	dispatch_sync(queue, ^{
+		result = self->decodedByteCount;
+	});
+	
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Decoding
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * See header file for description.
+ */
+- (void)decodeImageData:(NSData *)data
+           maxPixelSize:(CGFloat)maxPixelSize
+        processingBlock:(nullable ZDCImageProcessingBlock)processingBlock
+        completionQueue:(nullable dispatch_queue_t)completionQueue
+        completionBlock:(ZDCImageDecoderCompletionBlock)completionBlock
+{
+	[self decodeImageData: data
+	         maxPixelSize: maxPixelSize
+	          lowPriority: NO
+	          isCancelled: nil
+	      processingBlock: processingBlock
+	      completionQueue: completionQueue
+	      completionBlock: completionBlock];
+}
+
+/**
+ * See header file for description.
+ */
+- (void)decodeImageData:(NSData *)data
+           maxPixelSize:(CGFloat)maxPixelSize
+            lowPriority:(BOOL)lowPriority
+            isCancelled:(nullable BOOL (^)(void))isCancelledBlock
+        processingBlock:(nullable ZDCImageProcessingBlock)processingBlock
+        completionQueue:(nullable dispatch_queue_t)completionQueue
+        completionBlock:(ZDCImageDecoderCompletionBlock)completionBlock
+{
+	ZDCImageDecoderRequest *request = [[ZDCImageDecoderRequest alloc] init];
+	request.data = data;
+	request.maxPixelSize = maxPixelSize;
+	request.isCancelledBlock = isCancelledBlock;
+	request.processingBlock = processingBlock;
+	request.completionQueue = completionQueue ?: dispatch_get_main_queue();
+	request.completionBlock = completionBlock;
+	
+	dispatch_async(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	
+		if (lowPriority)
+			[pendingLowPriorityRequests addObject:request];
+		else
+			[pendingRequests addObject:request];
+		
+		[self startPendingRequests];
+	
+	#pragma clang diagnostic pop
+	}});
+}
+
+/**
+ * Must be invoked on the serial queue.
+ */
+- (void)startPendingRequests
+{
+	while (activeCount < maxConcurrentDecodes)
+	{
+		NSMutableArray<ZDCImageDecoderRequest *> *requests = nil;
+		
+		if (pendingRequests.count > 0)
+			requests = pendingRequests;
+		else if (pendingLowPriorityRequests.count > 0)
+			requests = pendingLowPriorityRequests;
+		else
+			break;
+		
+		ZDCImageDecoderRequest *request = requests[0];
+		[requests removeObjectAtIndex:0];
+		
+		activeCount++;
+		
+		dispatch_async(decodeQueue, ^{
+			[self executeRequest:request];
+		});
+	}
+}
+
+/**
+ * Invoked on the concurrent decodeQueue.
+ */
+- (void)executeRequest:(ZDCImageDecoderRequest *)request
+{
+	OSImage *image = nil;
+	NSUInteger cost = 0;
+	NSError *error = nil;
+	
+	CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+	
+	BOOL isCancelled = request.isCancelledBlock ? request.isCancelledBlock() : NO;
+	
+	if (isCancelled)
+	{
+		NSString *msg = @"Decode was cancelled";
+		error = [NSError errorWithClass:[self class] code:400 description:msg];
+	}
+	else { @autoreleasepool {
+	
+		image = [[self class] decodeImageData:request.data maxPixelSize:request.maxPixelSize];
+		
+		if (image == nil)
+		{
+			NSString *msg = @"Unable to create image from data";
+			error = [NSError errorWithClass:[self class] code:500 description:msg];
+		}
+		else if (request.processingBlock)
+		{
+			image = request.processingBlock(image);
+			
+			if (image == nil)
+			{
+				NSString *msg = @"Your imageProcessingBlock returned a nil result";
+				error = [NSError errorWithClass:[self class] code:500 description:msg];
+			}
+		}
+		
+		if (image) {
+			cost = [[self class] decodedByteCountForImage:image];
+		}
+	}}
+	
+	NSTimeInterval elapsed = CFAbsoluteTimeGetCurrent() - start;
+	
+	dispatch_async(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	
+		if (!isCancelled)
+		{
+			decodeCount++;
+			decodeDuration += elapsed;
+			decodedByteCount += cost;
+		}
+		
+		activeCount--;
+		[self startPendingRequests];
+	
+	#pragma clang diagnostic pop
+	}});
+	
+	ZDCImageDecoderCompletionBlock completionBlock = request.completionBlock;
+	
+	dispatch_async(request.completionQueue, ^{ @autoreleasepool {
+		completionBlock(image, cost, error);
+	}});
+}
+
+/**
+ * See header file for description.
+ */
++ (nullable OSImage *)decodeImageData:(NSData *)data maxPixelSize:(CGFloat)maxPixelSize
+{
+	if (data.length == 0) return nil;
+	
+	NSDictionary *sourceOptions = @{
+		// Don't decode the full-size image into a cache that we're never going to use
+		(__bridge NSString *)kCGImageSourceShouldCache: @(NO)
+	};
+	
+	CGImageSourceRef source =
+	  CGImageSourceCreateWithData((__bridge CFDataRef)data, (__bridge CFDictionaryRef)sourceOptions);
+	
+	if (source == NULL) return nil;
+	
+	NSMutableDictionary *thumbnailOptions = [NSMutableDictionary dictionaryWithCapacity:4];
+	
+	// Always decode from the full image (the embedded thumbnail may be tiny).
+	// Apply the EXIF orientation.
+	// And decode the bitmap now, on this background thread, rather than lazily at draw time.
+	//
+	thumbnailOptions[(__bridge NSString *)kCGImageSourceCreateThumbnailFromImageAlways] = @(YES);
+	thumbnailOptions[(__bridge NSString *)kCGImageSourceCreateThumbnailWithTransform] = @(YES);
+	thumbnailOptions[(__bridge NSString *)kCGImageSourceShouldCacheImmediately] = @(YES);
+	
+	if (maxPixelSize > 0) {
+		thumbnailOptions[(__bridge NSString *)kCGImageSourceThumbnailMaxPixelSize] = @(ceil(maxPixelSize));
+	}
+	
+	CGImageRef cgImage =
+	  CGImageSourceCreateThumbnailAtIndex(source, 0, (__bridge CFDictionaryRef)thumbnailOptions);
+	
+	CFRelease(source);
+	
+	if (cgImage == NULL) return nil;
+
+#if TARGET_OS_IPHONE
+	OSImage *image = [UIImage imageWithCGImage:cgImage scale:1.0 orientation:UIImageOrientationUp];
+#else
+	OSImage *image = [[NSImage alloc] initWithCGImage:cgImage size:NSZeroSize];
+#endif
+
+	CGImageRelease(cgImage);
+	return image;
+}
+
+/**
+ * See header file for description.
+ */
++ (NSUInteger)decodedByteCountForImage:(OSImage *)image
+{
+	CGImageRef cgImage = [image CGImage];
+	if (cgImage)
+	{
+		size_t bytes = CGImageGetBytesPerRow(cgImage) * CGImageGetHeight(cgImage);
+		if (bytes > 0) {
+			return (NSUInteger)bytes;
+		}
+	}
+	
+	// Fallback: assume 4 bytes per pixel
+
+#if TARGET_OS_IPHONE
+	CGFloat scale = image.scale;
+#else
+	CGFloat scale = 1.0;
+#endif
+
+	CGFloat width = image.size.width * scale;
+	CGFloat height = image.size.height * scale;
+	
+	return (NSUInteger)MAX(1, ceil(width) * ceil(height) * 4);
+}
+
+@end
@@ -0,0 +1,109 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import <Foundation/Foundation.h>
+
+#import "ZDCDownloadManager.h"
+#import "ZDCImageManager.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * A single item being prefetched (e.g. a node thumbnail or user avatar).
+ */
+@interface ZDCImagePrefetchTask : NSObject
+
+- (instancetype)initWithKey:(NSString *)key
+                 identifier:(NSString *)identifier
+                    options:(nullable ZDCFetchOptions *)options
+               processingID:(nullable NSString *)processingID
+            processingBlock:(nullable ZDCImageProcessingBlock)processingBlock;
+
+/** Uniquely identifies the result (i.e. the in-memory cache key). Duplicate keys are coalesced. */
+@property (nonatomic, copy, readonly) NSString *key;
+
+/** The nodeID or userID. */
+@property (nonatomic, copy, readonly) NSString *identifier;
+
+@property (nonatomic, copy, readonly, nullable) ZDCFetchOptions *options;
+@property (nonatomic, copy, readonly, nullable) NSString *processingID;
+@property (nonatomic, copy, readonly, nullable) ZDCImageProcessingBlock processingBlock;
+
+/**
+ * Set to YES when the item is removed from the prefetch list while it's in flight.
+ * Work that hasn't started yet (disk read, download, decode) should be skipped.
+ */
+@property (atomic, readonly) BOOL isCancelled;
+
+/**
+ * If the item requires a download, the ticket should be stored here.
+ * It's automatically cancelled if the task is cancelled (even if the task was cancelled before the ticket was set).
+ */
+@property (atomic, strong, readwrite, nullable) ZDCDownloadTicket *downloadTicket;
+
+/**
+ * Must be invoked when the work is complete (whether or not it succeeded).
+ * This frees the slot for the next item in the queue. Extra invocations are ignored.
+ */
+- (void)finish;
+
+@end
+
+/**
+ * Invoked to start the work for a task.
+ * The block must eventually invoke `-[ZDCImagePrefetchTask finish]`, unless the task gets cancelled.
+ */
+typedef void (^ZDCImagePrefetchStartBlock)(ZDCImagePrefetchTask *task);
+
+/**
+ * Manages an ordered list of items to prefetch.
+ *
+ * The list is replaced wholesale each time the visible range changes (e.g. while scrolling).
+ * Items are started in list order, with at most `maxInFlight` items in flight at any one time.
+ * When an in-flight item is no longer in the list, it's cancelled, and its slot is immediately
+ * given to the next item. Duplicate keys (within the list, or with an in-flight item) are coalesced.
+ */
+@interface ZDCImagePrefetchQueue : NSObject
+
+/**
+ * @param startQueue
+ *   The dispatch queue on which to invoke the startBlock.
+ *
+ * @param startBlock
+ *   Invoked to start the work for each task.
+ */
+- (instancetype)initWithStartQueue:(dispatch_queue_t)startQueue startBlock:(ZDCImagePrefetchStartBlock)startBlock;
+
+/**
+ * The upper bound on the number of items in flight at any one time.
+ * The default value is 4.
+ */
+@property (atomic, assign, readwrite) NSUInteger maxInFlight;
+
+/**
+ * Replaces the list of items to prefetch.
+ *
+ * The order of the array is the priority order (highest priority first).
+ * In-flight tasks that aren't in the new list are cancelled.
+ * Passing an empty array cancels everything.
+ */
+- (void)setTasks:(NSArray<ZDCImagePrefetchTask *> *)tasks;
+
+/** The number of items waiting to be started. */
+@property (atomic, readonly) NSUInteger pendingCount;
+
+/** The number of items currently in flight. */
+@property (atomic, readonly) NSUInteger inFlightCount;
+
+/** The total number of in-flight items that have been cancelled. */
+@property (atomic, readonly) NSUInteger cancelledCount;
+
+@end
+
+NS_ASSUME_NONNULL_END
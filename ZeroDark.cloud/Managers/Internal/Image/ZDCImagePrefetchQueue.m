@@ -0,0 +1,338 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import "ZDCImagePrefetchQueue.h"
+
+// Libraries
+#import <YapDatabase/YapDatabaseAtomic.h>
+
+static NSUInteger const kDefaultMaxInFlight = 4;
+
+@interface ZDCImagePrefetchQueue ()
+- (void)taskDidFinish:(ZDCImagePrefetchTask *)task;
+@end
+
+@interface ZDCImagePrefetchTask ()
+@property (nonatomic, weak, readwrite) ZDCImagePrefetchQueue *owner;
+- (void)cancel;
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation ZDCImagePrefetchTask {
+
+	YAPUnfairLock spinlock;
+	
+	BOOL isCancelled;
+	BOOL isFinished;
+	ZDCDownloadTicket *downloadTicket;
+}
+
+@synthesize key = _key;
+@synthesize identifier = _identifier;
+@synthesize options = _options;
+@synthesize processingID = _processingID;
+@synthesize processingBlock = _processingBlock;
+@synthesize owner = _owner;
+
+@dynamic isCancelled;
+@dynamic downloadTicket;
+
+- (instancetype)initWithKey:(NSString *)key
+                 identifier:(NSString *)identifier
+                    options:(nullable ZDCFetchOptions *)options
+               processingID:(nullable NSString *)processingID
+            processingBlock:(nullable ZDCImageProcessingBlock)processingBlock
+{
+	if ((self = [super init]))
+	{
+		spinlock = YAP_UNFAIR_LOCK_INIT;
+		
+		_key = [key copy];
+		_identifier = [identifier copy];
+		_options = [options copy];
+		_processingID = [processingID copy];
+		_processingBlock = [processingBlock copy];
+	}
+	return self;
+}
+
+- (BOOL)isCancelled
+{
+	BOOL result = NO;
+	
+	YAPUnfairLockLock(&spinlock);
+	{
+		result = isCancelled;
+	}
+	YAPUnfairLockUnlock(&spinlock);
+	
+	return result;
+}
+
+- (ZDCDownloadTicket *)downloadTicket
+{
+	ZDCDownloadTicket *result = nil;
+	
+	YAPUnfairLockLock(&spinlock);
+	{
+		result = downloadTicket;
+	}
+	YAPUnfairLockUnlock(&spinlock);
+	
+	return result;
+}
+
+- (void)setDownloadTicket:(ZDCDownloadTicket *)ticket
+{
+	BOOL cancelTicket = NO;
+	
+	YAPUnfairLockLock(&spinlock);
+	{
+		if (isCancelled) {
+			cancelTicket = YES;
+		}
+		else {
+			downloadTicket = ticket;
+		}
+	}
+	YAPUnfairLockUnlock(&spinlock);
+	
+	if (cancelTicket) {
+		[ticket cancel];
+	}
+}
+
+- (void)cancel
+{
+	ZDCDownloadTicket *ticket = nil;
+	
+	YAPUnfairLockLock(&spinlock);
+	{
+		isCancelled = YES;
+		
+		ticket = downloadTicket;
+		downloadTicket = nil;
+	}
+	YAPUnfairLockUnlock(&spinlock);
+	
+	// Other requests for the same resource (e.g. an on-screen fetch) hold their own ticket.
+	// So the download only stops if nobody else needs it.
+	[ticket cancel];
+}
+
+- (void)finish
+{
+	BOOL wasFinished = NO;
+	
+	YAPUnfairLockLock(&spinlock);
+	{
+		wasFinished = isFinished;
+		isFinished = YES;
+		
+		downloadTicket = nil;
+	}
+	YAPUnfairLockUnlock(&spinlock);
+	
+	if (!wasFinished) {
+		[self.owner taskDidFinish:self];
+	}
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation ZDCImagePrefetchQueue {
+
+	dispatch_queue_t queue; // serial: protects the variables below
+	
+	dispatch_queue_t startQueue;
+	ZDCImagePrefetchStartBlock startBlock;
+	
+	NSMutableArray<ZDCImagePrefetchTask *> *pendingTasks;
+	NSMutableDictionary<NSString*, ZDCImagePrefetchTask*> *inFlightTasks; // key => task
+	
+	NSUInteger maxInFlight;
+	NSUInteger cancelledCount;
+}
+
+@dynamic maxInFlight;
+@dynamic pendingCount;
+@dynamic inFlightCount;
+@dynamic cancelledCount;
+
+- (instancetype)initWithStartQueue:(dispatch_queue_t)inStartQueue startBlock:(ZDCImagePrefetchStartBlock)inStartBlock
+{
+	if ((self = [super init]))
+	{
+		queue = dispatch_queue_create("ZDCImagePrefetchQueue", DISPATCH_QUEUE_SERIAL);
+		
+		startQueue = inStartQueue;
+		startBlock = [inStartBlock copy];
+		
+		pendingTasks = [[NSMutableArray alloc] init];
+		inFlightTasks = [[NSMutableDictionary alloc] init];
+		
+		maxInFlight = kDefaultMaxInFlight;
+	}
+	return self;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Properties
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSUInteger)maxInFlight
+{
+	__block NSUInteger result = 0;
+	dispatch_sync(queue, ^{
+		result = self->maxInFlight;
+	});
+	
+	return result;
+}
+
+- (void)setMaxInFlight:(NSUInteger)value
+{
+	dispatch_async(queue, ^{ @autoreleasepool {
+	
+		self->maxInFlight = MAX(1, value);
+		[self startPendingTasks];
+	}});
+}
+
+- (NSUInteger)pendingCount
+{
+	__block NSUInteger result = 0;
+	dispatch_sync(queue, ^{
+		result = self->pendingTasks.count;
+	});
+	
+	return result;
+}
+
+- (NSUInteger)inFlightCount
+{
+	__block NSUInteger result = 0;
+	dispatch_sync(queue, ^{
+		result = self->inFlightTasks.count;
+	});
+	
+	return result;
+}
+
+- (NSUInteger)cancelledCount
+{
+	__block NSUInteger result = 0;
+	dispatch_sync(queue, ^{
+		result = self->cancelledCount;
+	});
+	
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Scheduling
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * See header file for description.
+ */
+- (void)setTasks:(NSArray<ZDCImagePrefetchTask *> *)tasks
+{
+	NSMutableArray<ZDCImagePrefetchTask *> *cancelled = [NSMutableArray array];
+	
+	dispatch_sync(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	
+		NSMutableSet<NSString*> *keys = [NSMutableSet setWithCapacity:tasks.count];
+		NSMutableArray<ZDCImagePrefetchTask *> *newPendingTasks = [NSMutableArray arrayWithCapacity:tasks.count];
+		
+		for (ZDCImagePrefetchTask *task in tasks)
+		{
+			if ([keys containsObject:task.key]) {
+				continue; // duplicate within the list
+			}
+			[keys addObject:task.key];
+			
+			if (inFlightTasks[task.key] == nil) {
+				[newPendingTasks addObject:task];
+			}
+		}
+		
+		for (NSString *key in [inFlightTasks allKeys])
+		{
+			if (![keys containsObject:key])
+			{
+				[cancelled addObject:inFlightTasks[key]];
+				[inFlightTasks removeObjectForKey:key];
+			}
+		}
+		
+		cancelledCount += cancelled.count;
+		
+		pendingTasks = newPendingTasks;
+		[self startPendingTasks];
+	
+	#pragma clang diagnostic pop
+	}});
+	
+	for (ZDCImagePrefetchTask *task in cancelled)
+	{
+		[task cancel];
+	}
+}
+
+/**
+ * Must be invoked on the serial queue.
+ */
+- (void)startPendingTasks
+{
+	while ((inFlightTasks.count < maxInFlight) && (pendingTasks.count > 0))
+	{
+		ZDCImagePrefetchTask *task = pendingTasks[0];
+		[pendingTasks removeObjectAtIndex:0];
+		
+		task.owner = self;
+		inFlightTasks[task.key] = task;
+		
+		ZDCImagePrefetchStartBlock block = startBlock;
+		dispatch_async(startQueue, ^{ @autoreleasepool {
+		
+			block(task);
+		}});
+	}
+}
+
+- (void)taskDidFinish:(ZDCImagePrefetchTask *)task
+{
+	dispatch_async(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	
+		// If the task was cancelled, its slot has already been released
+		// (and another task with the same key may have since been started).
+		
+		if (inFlightTasks[task.key] == task)
+		{
+			[inFlightTasks removeObjectForKey:task.key];
+			[self startPendingTasks];
+		}
+	
+	#pragma clang diagnostic pop
+	}});
+}
+
+@end
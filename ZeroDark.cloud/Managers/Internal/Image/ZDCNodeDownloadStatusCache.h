@@ -0,0 +1,66 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import <Foundation/Foundation.h>
+
+#import "ZDCCloudTransaction.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * An in-memory mirror of `[ZDCCloudTransaction nodeIsMarkedAsNeedsDownload:components:]`.
+ *
+ * The ImageManager consults this before every fetch, so that a cache hit doesn't require a database transaction.
+ * It's populated lazily (from the database read that happens on a cache miss),
+ * and kept up-to-date via ZDCNodeDownloadStatusChangedNotification.
+ *
+ * Only nodes that have been looked up are tracked.
+ * Changes for other nodes are ignored, but they bump the `generation`,
+ * which prevents a concurrent database read (that may have started before the change) from storing a stale value.
+ *
+ * This class is thread-safe.
+ */
+@interface ZDCNodeDownloadStatusCache : NSObject
+
+/**
+ * Returns YES if the status for the node is known, in which case outComponents is set to the marked components.
+ * Returns NO if the status must be read from the database.
+ */
+- (BOOL)getMarkedComponents:(ZDCNodeComponents *_Nullable)outComponents forNodeID:(NSString *)nodeID;
+
+/**
+ * Snapshot this value before reading the status from the database,
+ * and pass it to `setMarkedComponents:forNodeID:ifGenerationMatches:` afterwards.
+ */
+@property (nonatomic, readonly) uint64_t generation;
+
+/**
+ * Stores the value read from the database.
+ * The value is discarded if any untracked changes arrived since the generation was read.
+ */
+- (void)setMarkedComponents:(ZDCNodeComponents)components
+                  forNodeID:(NSString *)nodeID
+        ifGenerationMatches:(uint64_t)generation;
+
+/**
+ * Applies the changes from a ZDCNodeDownloadStatusChangedNotification.
+ */
+- (void)applyChanges:(NSDictionary<NSString*, NSNumber*> *)changes;
+
+/**
+ * Stops tracking the given nodes. (e.g. their thumbnails were evicted from the cache)
+ */
+- (void)removeNodeIDs:(id<NSFastEnumeration>)nodeIDs;
+
+/** The number of tracked nodes. */
+@property (nonatomic, readonly) NSUInteger count;
+
+@end
+
+NS_ASSUME_NONNULL_END
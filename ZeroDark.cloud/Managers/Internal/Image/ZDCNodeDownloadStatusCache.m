@@ -0,0 +1,132 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import "ZDCNodeDownloadStatusCache.h"
+
+// Libraries
+#import <YapDatabase/YapDatabaseAtomic.h>
+
+@implementation ZDCNodeDownloadStatusCache {
+
+	YAPUnfairLock spinlock;
+	
+	NSMutableDictionary<NSString*, NSNumber*> *markedComponents; // nodeID => @(ZDCNodeComponents)
+	uint64_t generation;
+}
+
+@dynamic generation;
+@dynamic count;
+
+- (instancetype)init
+{
+	if ((self = [super init]))
+	{
+		spinlock = YAP_UNFAIR_LOCK_INIT;
+		markedComponents = [[NSMutableDictionary alloc] init];
+	}
+	return self;
+}
+
+- (BOOL)getMarkedComponents:(ZDCNodeComponents *)outComponents forNodeID:(NSString *)nodeID
+{
+	NSNumber *value = nil;
+	
+	YAPUnfairLockLock(&spinlock);
+	{
+		value = markedComponents[nodeID];
+	}
+	YAPUnfairLockUnlock(&spinlock);
+	
+	if (outComponents) *outComponents = (ZDCNodeComponents)[value unsignedIntegerValue];
+	return (value != nil);
+}
+
+- (uint64_t)generation
+{
+	uint64_t result = 0;
+	
+	YAPUnfairLockLock(&spinlock);
+	{
+		result = generation;
+	}
+	YAPUnfairLockUnlock(&spinlock);
+	
+	return result;
+}
+
+- (void)setMarkedComponents:(ZDCNodeComponents)components
+                  forNodeID:(NSString *)nodeID
+        ifGenerationMatches:(uint64_t)expectedGeneration
+{
+	if (nodeID == nil) return;
+	
+	NSNumber *value = @(components & ZDCNodeComponents_All);
+	
+	YAPUnfairLockLock(&spinlock);
+	{
+		// If the node is already tracked, then the tracked value came from either:
+		// - a change notification (which is newer than our database read)
+		// - a concurrent database read (which is just as good)
+		//
+		if ((generation == expectedGeneration) && (markedComponents[nodeID] == nil)) {
+			markedComponents[nodeID] = value;
+		}
+	}
+	YAPUnfairLockUnlock(&spinlock);
+}
+
+- (void)applyChanges:(NSDictionary<NSString*, NSNumber*> *)changes
+{
+	YAPUnfairLockLock(&spinlock);
+	{
+		BOOL hasUntrackedChanges = NO;
+		
+		for (NSString *nodeID in changes)
+		{
+			if (markedComponents[nodeID]) {
+				markedComponents[nodeID] = changes[nodeID];
+			}
+			else {
+				hasUntrackedChanges = YES;
+			}
+		}
+		
+		if (hasUntrackedChanges) {
+			generation++;
+		}
+	}
+	YAPUnfairLockUnlock(&spinlock);
+}
+
+- (void)removeNodeIDs:(id<NSFastEnumeration>)nodeIDs
+{
+	YAPUnfairLockLock(&spinlock);
+	{
+		for (NSString *nodeID in nodeIDs)
+		{
+			[markedComponents removeObjectForKey:nodeID];
+		}
+	}
+	YAPUnfairLockUnlock(&spinlock);
+}
+
+- (NSUInteger)count
+{
+	NSUInteger result = 0;
+	
+	YAPUnfairLockLock(&spinlock);
+	{
+		result = markedComponents.count;
+	}
+	YAPUnfairLockUnlock(&spinlock);
+	
+	return result;
+}
+
+@end
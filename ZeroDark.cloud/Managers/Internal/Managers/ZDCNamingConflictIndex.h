@@ -0,0 +1,108 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import <Foundation/Foundation.h>
+#import <YapDatabase/YapDatabase.h>
+
+#import "ZDCNode.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * An in-memory index used by the ZDCNodeManager to speed up naming conflict resolution:
+ *
+ * - (parentID, name_base, name_ext) => highest N for which a sibling named "name_base N.name_ext" exists
+ *
+ * Along with the highest number, each entry remembers the sibling that holds it.
+ * So `resolveNamingConflict:transaction:` becomes a single lookup, instead of scanning the siblings each time.
+ *
+ * The index is transaction-aware:
+ *
+ * - Modifications are reported by ZDCCloudTransaction (via the transaction hooks).
+ *   If the holder is renamed/moved/deleted, or a sibling with a higher number appears, the entry is removed.
+ *
+ * - Entries computed within a read-write transaction are kept with the transaction.
+ *   They're adjusted as the transaction inserts/modifies nodes,
+ *   and published (via a completion block) only if they reflect committed state.
+ *   So a rolled back transaction never leaves anything behind.
+ *
+ * - A read-only transaction on an older snapshot ignores newer entries,
+ *   and doesn't store anything (as its results may be stale).
+ *
+ * There is one index per database. This class is thread-safe.
+ */
+@interface ZDCNamingConflictIndex : NSObject
+
+/**
+ * Returns the index for the transaction's database (creating it if needed).
+ */
++ (instancetype)indexForTransaction:(YapDatabaseReadTransaction *)transaction;
+
+/**
+ * Returns the index for the transaction's database, or nil if it hasn't been created.
+ * (If there's no index, there's nothing to invalidate.)
+ */
++ (nullable instancetype)existingIndexForTransaction:(YapDatabaseReadTransaction *)transaction;
+
+#pragma mark Lookup
+
+/**
+ * Returns the highest N in use by a sibling named "name_base N.name_ext" (zero if there are none), if known.
+ *
+ * @param parentID
+ *   The parent that actually holds the children (i.e. after following pointers).
+ */
+- (nullable NSNumber *)highestSuffixForBase:(NSString *)name_base
+                                  extension:(NSString *)name_ext
+                                   parentID:(NSString *)parentID
+                                transaction:(YapDatabaseReadTransaction *)transaction;
+
+#pragma mark Population
+
+/**
+ * Stores the highest N in use by a sibling named "name_base N.name_ext".
+ *
+ * The value must have been read from the database within the given transaction.
+ *
+ * @param holderID
+ *   The nodeID of the sibling using the highest number (nil if highest is zero).
+ */
+- (void)setHighestSuffix:(uint64_t)highest
+                holderID:(nullable NSString *)holderID
+                 forBase:(NSString *)name_base
+               extension:(NSString *)name_ext
+                parentID:(NSString *)parentID
+             transaction:(YapDatabaseReadTransaction *)transaction;
+
+#pragma mark Invalidation
+
+/**
+ * Invoked (from within a read-write transaction) after a node is inserted or modified.
+ */
+- (void)didUpdateNode:(ZDCNode *)node transaction:(YapDatabaseReadWriteTransaction *)transaction;
+
+/**
+ * Invoked (from within a read-write transaction) when a node is removed.
+ */
+- (void)didRemoveNodeID:(NSString *)nodeID transaction:(YapDatabaseReadWriteTransaction *)transaction;
+
+/**
+ * Invoked after the read-write transaction has been committed.
+ * Allows the entries computed within the transaction to be published.
+ */
+- (void)didCommitTransaction:(YapDatabaseReadWriteTransaction *)transaction;
+
+#pragma mark Debugging
+
+/** The number of published entries. */
+@property (atomic, readonly) NSUInteger entryCount;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,496 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import "ZDCNamingConflictIndex.h"
+
+// Libraries
+#import <YapDatabase/YapDatabaseAtomic.h>
+
+/**
+ * If the number of entries exceeds this limit, the index is simply flushed.
+ * (It will repopulate itself with whatever names are actually in conflict.)
+ */
+static NSUInteger const kMaxEntryCount = 1000;
+
+@interface ZDCNamingConflictEntry : NSObject
+
+@property (nonatomic, assign) uint64_t highest;
+@property (nonatomic, copy, nullable) NSString *holderID;
+
+/** The oldest snapshot for which the entry is valid. */
+@property (nonatomic, assign) uint64_t snapshot;
+
+@end
+
+@implementation ZDCNamingConflictEntry
+@end
+
+/**
+ * The entries computed within a single read-write transaction.
+ */
+@interface ZDCNamingConflictBatch : NSObject
+
+@property (nonatomic, strong, readonly) NSMutableDictionary<NSString*, ZDCNamingConflictEntry*> *entries;
+
+/** The transaction's snapshot (i.e. the snapshot it started from). */
+@property (nonatomic, assign) uint64_t snapshot;
+
+/** Whether the transaction has modified any nodes. */
+@property (nonatomic, assign) BOOL dirty;
+
+/** Whether the transaction has been committed. */
+@property (nonatomic, assign) BOOL committed;
+
+/** The index's generation when the batch was known to be complete. */
+@property (nonatomic, assign) uint64_t generation;
+
+@end
+
+@implementation ZDCNamingConflictBatch
+
+- (instancetype)init
+{
+	if ((self = [super init]))
+	{
+		_entries = [[NSMutableDictionary alloc] init];
+	}
+	return self;
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation ZDCNamingConflictIndex {
+
+	YAPUnfairLock spinlock;
+	
+	NSMutableDictionary<NSString*, ZDCNamingConflictEntry*> *entries; // key => entry
+	NSMutableDictionary<NSString*, NSString*> *holders;               // holderID => key
+	
+	NSMapTable<YapDatabaseReadWriteTransaction*, ZDCNamingConflictBatch*> *batches; // weak keys
+	
+	uint64_t generation;
+	uint64_t minValidSnapshot;
+}
+
+@dynamic entryCount;
+
+static YAPUnfairLock registryLock = YAP_UNFAIR_LOCK_INIT;
+static NSMapTable<YapDatabase*, ZDCNamingConflictIndex*> *registry = nil; // weak keys
+
++ (instancetype)indexForTransaction:(YapDatabaseReadTransaction *)transaction
+{
+	YapDatabase *database = transaction.connection.database;
+	ZDCNamingConflictIndex *index = nil;
+	
+	YAPUnfairLockLock(&registryLock);
+	{
+		if (registry == nil) {
+			registry = [NSMapTable weakToStrongObjectsMapTable];
+		}
+		
+		index = [registry objectForKey:database];
+		if (index == nil && database)
+		{
+			index = [[ZDCNamingConflictIndex alloc] init];
+			[registry setObject:index forKey:database];
+		}
+	}
+	YAPUnfairLockUnlock(&registryLock);
+	
+	return index;
+}
+
++ (nullable instancetype)existingIndexForTransaction:(YapDatabaseReadTransaction *)transaction
+{
+	YapDatabase *database = transaction.connection.database;
+	ZDCNamingConflictIndex *index = nil;
+	
+	YAPUnfairLockLock(&registryLock);
+	{
+		index = [registry objectForKey:database];
+	}
+	YAPUnfairLockUnlock(&registryLock);
+	
+	return index;
+}
+
+- (instancetype)init
+{
+	if ((self = [super init]))
+	{
+		spinlock = YAP_UNFAIR_LOCK_INIT;
+		
+		entries = [[NSMutableDictionary alloc] init];
+		holders = [[NSMutableDictionary alloc] init];
+		batches = [NSMapTable weakToStrongObjectsMapTable];
+	}
+	return self;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Utilities
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Names are compared case-insensitively (see `-[ZDCNodeManager findNodeWithName:parentID:transaction:]`).
+ */
+static NSString* IndexKey(NSString *parentID, NSString *name_base, NSString *name_ext)
+{
+	return [NSString stringWithFormat:@"%@|%@|%@",
+	          parentID ?: @"", [name_base lowercaseString] ?: @"", [name_ext lowercaseString] ?: @""];
+}
+
+/**
+ * If the node is named "name_base N.name_ext", returns the index key (and N) it counts towards.
+ * Uses the same rules as `-[ZDCNodeManager highestSuffixForBase:...]`, i.e. N must be all digits.
+ *
+ * Returns nil if the name doesn't end with a (space + number).
+ */
+static NSString* IndexKeyForNode(ZDCNode *node, uint64_t *outNumber)
+{
+	NSString *name_base = [node.name stringByDeletingPathExtension];
+	NSString *name_ext = [node.name pathExtension];
+	
+	NSRange spaceRange = [name_base rangeOfString:@" " options:NSBackwardsSearch];
+	if (spaceRange.location == NSNotFound || spaceRange.location == 0) return nil;
+	
+	NSString *suffix = [name_base substringFromIndex:(spaceRange.location + 1)];
+	if (suffix.length == 0) return nil;
+	
+	NSCharacterSet *nonDigits = [[NSCharacterSet decimalDigitCharacterSet] invertedSet];
+	if ([suffix rangeOfCharacterFromSet:nonDigits].location != NSNotFound) return nil;
+	
+	uint64_t number = strtoull([suffix UTF8String], NULL, 10);
+	if (number == 0) return nil;
+	
+	if (outNumber) *outNumber = number;
+	return IndexKey(node.parentID, [name_base substringToIndex:spaceRange.location], name_ext);
+}
+
+static BOOL IsReadWrite(YapDatabaseReadTransaction *transaction)
+{
+	return [transaction isKindOfClass:[YapDatabaseReadWriteTransaction class]];
+}
+
+/**
+ * Must be invoked within spinlock.
+ */
+- (void)didModifyNodes:(YapDatabaseReadWriteTransaction *)transaction
+{
+	generation++;
+	
+	// The changes made by this transaction become visible in the next snapshot.
+	// Readers on older snapshots must not populate the index.
+	
+	uint64_t snapshot = transaction.connection.snapshot + 1;
+	if (minValidSnapshot < snapshot) {
+		minValidSnapshot = snapshot;
+	}
+	
+	[batches objectForKey:transaction].dirty = YES;
+}
+
+/**
+ * Must be invoked within spinlock.
+ */
+- (void)removeEntryForKey:(NSString *)key
+{
+	ZDCNamingConflictEntry *entry = entries[key];
+	if (entry == nil) return;
+	
+	if (entry.holderID) {
+		holders[entry.holderID] = nil;
+	}
+	entries[key] = nil;
+}
+
+/**
+ * Must be invoked within spinlock.
+ */
+- (void)publishEntry:(ZDCNamingConflictEntry *)entry forKey:(NSString *)key
+{
+	[self removeEntryForKey:key];
+	
+	if (entry.holderID)
+	{
+		// A node only has one name, so it can only hold one entry.
+		NSString *prevKey = holders[entry.holderID];
+		if (prevKey) {
+			[self removeEntryForKey:prevKey];
+		}
+	}
+	
+	if (entries.count >= kMaxEntryCount)
+	{
+		[entries removeAllObjects];
+		[holders removeAllObjects];
+	}
+	
+	entries[key] = entry;
+	if (entry.holderID) {
+		holders[entry.holderID] = key;
+	}
+}
+
+/**
+ * Invoked via the transaction's completion block.
+ */
+- (void)publishBatch:(ZDCNamingConflictBatch *)batch
+{
+	YAPUnfairLockLock(&spinlock);
+	do {
+	
+		// If the transaction modified nodes, then the entries reflect those modifications.
+		// Which is only what's in the database if the transaction was committed (rather than rolled back).
+		//
+		// And if anything has been modified since, the entries may be stale.
+		
+		if (batch.dirty && !batch.committed) break;
+		if (batch.generation != generation) break;
+		
+		uint64_t snapshot = batch.dirty ? (batch.snapshot + 1) : batch.snapshot;
+		
+		[batch.entries enumerateKeysAndObjectsUsingBlock:
+		  ^(NSString *key, ZDCNamingConflictEntry *entry, BOOL *stop)
+		{
+			entry.snapshot = snapshot;
+			[self publishEntry:entry forKey:key];
+		}];
+		
+	} while (NO);
+	YAPUnfairLockUnlock(&spinlock);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Lookup
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (nullable NSNumber *)highestSuffixForBase:(NSString *)name_base
+                                  extension:(NSString *)name_ext
+                                   parentID:(NSString *)parentID
+                                transaction:(YapDatabaseReadTransaction *)transaction
+{
+	if (parentID == nil) return nil;
+	
+	NSString *key = IndexKey(parentID, name_base, name_ext);
+	uint64_t snapshot = transaction.connection.snapshot;
+	
+	NSNumber *result = nil;
+	
+	YAPUnfairLockLock(&spinlock);
+	{
+		ZDCNamingConflictEntry *entry = nil;
+		
+		if (IsReadWrite(transaction))
+		{
+			// Entries computed earlier within this transaction take precedence.
+			// Otherwise the published entry is valid, since our own changes have already removed any affected entries.
+			
+			entry = [batches objectForKey:(YapDatabaseReadWriteTransaction *)transaction].entries[key];
+			if (entry == nil) {
+				entry = entries[key];
+			}
+		}
+		else
+		{
+			entry = entries[key];
+			if (entry && (snapshot < entry.snapshot)) {
+				entry = nil;
+			}
+		}
+		
+		if (entry) {
+			result = @(entry.highest);
+		}
+	}
+	YAPUnfairLockUnlock(&spinlock);
+	
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Population
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)setHighestSuffix:(uint64_t)highest
+                holderID:(nullable NSString *)holderID
+                 forBase:(NSString *)name_base
+               extension:(NSString *)name_ext
+                parentID:(NSString *)parentID
+             transaction:(YapDatabaseReadTransaction *)transaction
+{
+	if (parentID == nil) return;
+	
+	NSString *key = IndexKey(parentID, name_base, name_ext);
+	uint64_t snapshot = transaction.connection.snapshot;
+	
+	ZDCNamingConflictEntry *entry = [[ZDCNamingConflictEntry alloc] init];
+	entry.highest = highest;
+	entry.holderID = (highest > 0) ? holderID : nil;
+	entry.snapshot = snapshot;
+	
+	ZDCNamingConflictBatch *newBatch = nil;
+	
+	YAPUnfairLockLock(&spinlock);
+	{
+		if (IsReadWrite(transaction))
+		{
+			YapDatabaseReadWriteTransaction *rwTransaction = (YapDatabaseReadWriteTransaction *)transaction;
+			
+			ZDCNamingConflictBatch *batch = [batches objectForKey:rwTransaction];
+			if (batch == nil)
+			{
+				batch = newBatch = [[ZDCNamingConflictBatch alloc] init];
+				batch.snapshot = snapshot;
+				batch.dirty = (minValidSnapshot > snapshot); // this transaction has already modified nodes
+				batch.generation = generation;
+				
+				[batches setObject:batch forKey:rwTransaction];
+			}
+			
+			batch.entries[key] = entry;
+		}
+		else if (snapshot >= minValidSnapshot)
+		{
+			[self publishEntry:entry forKey:key];
+		}
+	}
+	YAPUnfairLockUnlock(&spinlock);
+	
+	if (newBatch)
+	{
+		[(YapDatabaseReadWriteTransaction *)transaction addCompletionQueue:nil completionBlock:^{
+		
+			[self publishBatch:newBatch];
+		}];
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Invalidation
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)didUpdateNode:(ZDCNode *)node transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+	NSString *nodeID = node.uuid;
+	if (nodeID == nil) return;
+	
+	uint64_t number = 0;
+	NSString *key = IndexKeyForNode(node, &number);
+	
+	YAPUnfairLockLock(&spinlock);
+	{
+		[self didModifyNodes:transaction];
+		
+		// Published entries:
+		// - if this node was the holder, and its name/parent changed, the highest number may have gone down
+		// - if this node is now using a higher number, the entry is too low
+		
+		NSString *heldKey = holders[nodeID];
+		if (heldKey)
+		{
+			if (![heldKey isEqualToString:key] || entries[heldKey].highest != number) {
+				[self removeEntryForKey:heldKey];
+			}
+		}
+		
+		if (key && entries[key] && (entries[key].highest < number)) {
+			[self removeEntryForKey:key];
+		}
+		
+		// Entries computed within this transaction are adjusted instead.
+		// They're private to the transaction, so there's nothing to undo if it's rolled back.
+		
+		NSMutableDictionary<NSString*, ZDCNamingConflictEntry*> *pending =
+		  [batches objectForKey:transaction].entries;
+		
+		NSArray<NSString*> *staleKeys =
+		  [[pending keysOfEntriesPassingTest:^BOOL(NSString *pendingKey, ZDCNamingConflictEntry *entry, BOOL *stop) {
+		
+			return [entry.holderID isEqualToString:nodeID]
+			    && (![pendingKey isEqualToString:key] || entry.highest != number);
+		}] allObjects];
+		
+		[pending removeObjectsForKeys:staleKeys];
+		
+		ZDCNamingConflictEntry *entry = key ? pending[key] : nil;
+		if (entry && (entry.highest < number))
+		{
+			entry.highest = number;
+			entry.holderID = nodeID;
+		}
+	}
+	YAPUnfairLockUnlock(&spinlock);
+}
+
+- (void)didRemoveNodeID:(NSString *)nodeID transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+	if (nodeID == nil) return;
+	
+	YAPUnfairLockLock(&spinlock);
+	{
+		[self didModifyNodes:transaction];
+		
+		NSString *heldKey = holders[nodeID];
+		if (heldKey) {
+			[self removeEntryForKey:heldKey];
+		}
+		
+		NSMutableDictionary<NSString*, ZDCNamingConflictEntry*> *pending =
+		  [batches objectForKey:transaction].entries;
+		
+		NSArray<NSString*> *staleKeys =
+		  [[pending keysOfEntriesPassingTest:^BOOL(NSString *pendingKey, ZDCNamingConflictEntry *entry, BOOL *stop) {
+		
+			return [entry.holderID isEqualToString:nodeID];
+		}] allObjects];
+		
+		[pending removeObjectsForKeys:staleKeys];
+	}
+	YAPUnfairLockUnlock(&spinlock);
+}
+
+- (void)didCommitTransaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+	YAPUnfairLockLock(&spinlock);
+	{
+		ZDCNamingConflictBatch *batch = [batches objectForKey:transaction];
+		if (batch)
+		{
+			batch.committed = YES;
+			batch.generation = generation;
+			
+			[batches removeObjectForKey:transaction];
+		}
+	}
+	YAPUnfairLockUnlock(&spinlock);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Debugging
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSUInteger)entryCount
+{
+	NSUInteger result = 0;
+	
+	YAPUnfairLockLock(&spinlock);
+	{
+		result = entries.count;
+	}
+	YAPUnfairLockUnlock(&spinlock);
+	
+	return result;
+}
+
+@end
@@ -0,0 +1,74 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import <Foundation/Foundation.h>
+#import <YapDatabase/YapDatabase.h>
+#import <YapDatabase/YapDatabaseHooks.h>
+
+#import "ZDCNode.h"
+#import "ZDCNodeAggregates.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Maintains the ZDCNodeAggregates for every node (stored in kZDCCollection_NodeAggregates, keyed by nodeID).
+ *
+ * Each record stores the node's own values, plus the sums for its subtree.
+ * When a node changes, the difference is applied to each of its ancestors.
+ * So every update is O(depth), and every query is a single lookup.
+ *
+ * The record also stores the parentID that was used the last time the ancestors were updated.
+ * This is how we know which ancestors to subtract from when a node is moved or deleted,
+ * without having to look at the previous version of the node.
+ */
+@interface ZDCNodeAggregator : NSObject
+
+/**
+ * Returns a new YapDatabaseHooks instance, configured to invoke the methods below.
+ * Registered by the ZDCDatabaseManager (as Ext_Hooks_NodeAggregates).
+ */
++ (YapDatabaseHooks *)hooksExtension;
+
+/**
+ * Invoked after a node is inserted or modified.
+ */
++ (void)didModifyNode:(ZDCNode *)node transaction:(YapDatabaseReadWriteTransaction *)transaction;
+
+/**
+ * Invoked after a node is removed.
+ */
++ (void)didRemoveNodeID:(NSString *)nodeID transaction:(YapDatabaseReadWriteTransaction *)transaction;
+
+/**
+ * Invoked (by ZDCCloudTransaction) when a data upload is queued.
+ *
+ * The operation is only counted if the node already has aggregates.
+ * (Otherwise it'll be picked up by the next rebuild.)
+ */
++ (void)didAddUploadOperation:(NSUUID *)operationID
+                    forNodeID:(NSString *)nodeID
+                  transaction:(YapDatabaseReadWriteTransaction *)transaction;
+
+/**
+ * Invoked (by ZDCCloudTransaction) when a data upload completes or is skipped.
+ *
+ * Only operations that were counted (by didAddUploadOperation, or by a rebuild) are subtracted.
+ */
++ (void)didRemoveUploadOperation:(NSUUID *)operationID
+                     transaction:(YapDatabaseReadWriteTransaction *)transaction;
+
+/**
+ * Calculates all the aggregates from scratch, if this hasn't been done yet.
+ * (E.g. the database was created by an older version of the framework.)
+ */
++ (void)rebuildIfNeeded:(YapDatabaseReadWriteTransaction *)transaction;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,510 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import "ZDCNodeAggregator.h"
+
+#import "ZDCCloud.h"
+#import "ZDCCloudOperation.h"
+#import "ZDCConstants.h"
+#import "ZDCDatabaseManager.h"
+#import "ZDCLogging.h"
+
+// Libraries
+#import <YapDatabase/YapDatabaseView.h>
+
+// Log Levels: off, error, warn, info, verbose
+// Log Flags : trace
+#if DEBUG
+  static const int zdcLogLevel = ZDCLogLevelWarning;
+#else
+  static const int zdcLogLevel = ZDCLogLevelWarning;
+#endif
+#pragma unused(zdcLogLevel)
+
+/**
+ * Stored in kZDCCollection_NodeAggregates once the aggregates have been calculated from scratch.
+ * Increment kAggregatesVersion to force a rebuild (e.g. if the definition of a value changes).
+ *
+ * Note: Node uuid's never contain a '|' character, so this can't collide with a nodeID.
+ */
+static NSString *const kAggregatesVersionKey = @"|version";
+static NSInteger const kAggregatesVersion = 1;
+
+/**
+ * Every upload operation that's included in a pendingUploadCount has a marker in kZDCCollection_NodeAggregates.
+ * The key is kUploadOperationPrefix + operation.uuid, and the value is the nodeID.
+ *
+ * This way, when the operation completes, we only subtract it if it was actually counted.
+ * (An operation that was queued before its node was inserted isn't counted,
+ *  and must not lower the count of another upload for the same node.)
+ */
+static NSString *const kUploadOperationPrefix = @"|op|";
+
+static NSString *UploadOperationKey(NSUUID *operationID)
+{
+	return [kUploadOperationPrefix stringByAppendingString:[operationID UUIDString]];
+}
+
+/**
+ * Sanity check, to protect against infinite loops (in case of a cycle in the parentID chain).
+ */
+static NSUInteger const kMaxDepth = 4096;
+
+typedef struct {
+	int64_t count;
+	int64_t dataSize;
+	int64_t pendingUploads;
+} ZDCSubtreeDelta;
+
+static BOOL ZDCSubtreeDeltaIsZero(ZDCSubtreeDelta delta)
+{
+	return (delta.count == 0) && (delta.dataSize == 0) && (delta.pendingUploads == 0);
+}
+
+static ZDCSubtreeDelta ZDCSubtreeDeltaNegate(ZDCSubtreeDelta delta)
+{
+	return (ZDCSubtreeDelta){ -delta.count, -delta.dataSize, -delta.pendingUploads };
+}
+
+/**
+ * Returns the subtree of the given node (the node itself plus all its descendants).
+ */
+static ZDCSubtreeDelta ZDCSubtreeDeltaForAggregates(ZDCNodeAggregates *aggregates)
+{
+	return (ZDCSubtreeDelta){
+		(int64_t)(1 + aggregates.descendantCount),
+		(int64_t)aggregates.totalDataSize,
+		(int64_t)aggregates.totalPendingUploadCount
+	};
+}
+
+static uint64_t ApplyDelta(uint64_t value, int64_t delta)
+{
+	if (delta < 0 && (uint64_t)(-delta) > value) {
+		return 0; // shouldn't happen, but don't wrap around
+	}
+	return (uint64_t)((int64_t)value + delta);
+}
+
+static uint64_t OwnDataSize(ZDCNode *node)
+{
+	return node.cloudDataInfo ? node.cloudDataInfo.dataSize : 0;
+}
+
+static BOOL IsEqualOrBothNil(NSString *a, NSString *b)
+{
+	if (a == nil) return (b == nil);
+	return [a isEqualToString:b];
+}
+
+
+@implementation ZDCNodeAggregator
+
++ (YapDatabaseHooks *)hooksExtension
+{
+	YapDatabaseHooks *hooks = [[YapDatabaseHooks alloc] init];
+	
+	NSSet *whitelist = [NSSet setWithObject:kZDCCollection_Nodes];
+	hooks.allowedCollections = [[YapWhitelistBlacklist alloc] initWithWhitelist:whitelist];
+	
+	hooks.didModifyRow = ^(YapDatabaseReadWriteTransaction *transaction, NSString *collection, NSString *key,
+	                       YapProxyObject *proxyObject, YapProxyObject *proxyMetadata,
+	                       YapDatabaseHooksBitMask flags)
+	{
+		if ((flags & (YapDatabaseHooksInsertedRow | YapDatabaseHooksChangedObject)) == 0) {
+			return; // only the metadata changed
+		}
+		
+		id object = proxyObject.realObject;
+		if ([object isKindOfClass:[ZDCNode class]])
+		{
+			[ZDCNodeAggregator didModifyNode:(ZDCNode *)object transaction:transaction];
+		}
+	};
+	
+	hooks.didRemoveRow = ^(YapDatabaseReadWriteTransaction *transaction, NSString *collection, NSString *key) {
+		
+		[ZDCNodeAggregator didRemoveNodeID:key transaction:transaction];
+	};
+	
+	hooks.didRemoveAllRows = ^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		// No more nodes means no more aggregates. (And nothing to rebuild.)
+		
+		[transaction removeAllObjectsInCollection:kZDCCollection_NodeAggregates];
+		[transaction setObject: @(kAggregatesVersion)
+		                forKey: kAggregatesVersionKey
+		          inCollection: kZDCCollection_NodeAggregates];
+	};
+	
+	return hooks;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Utilities
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
++ (nullable ZDCNodeAggregates *)aggregatesForNodeID:(NSString *)nodeID
+                                        transaction:(YapDatabaseReadTransaction *)transaction
+{
+	if (nodeID == nil) return nil;
+	
+	id object = [transaction objectForKey:nodeID inCollection:kZDCCollection_NodeAggregates];
+	if ([object isKindOfClass:[ZDCNodeAggregates class]]) {
+		return (ZDCNodeAggregates *)object;
+	}
+	
+	return nil;
+}
+
+/**
+ * Applies the delta to the parent, grandparent, etc.
+ * Stops when we reach a node without aggregates (e.g. trunk's parent, graft, or a parent that hasn't been inserted yet).
+ */
++ (void)applyDelta:(ZDCSubtreeDelta)delta
+    toAncestorsFrom:(nullable NSString *)parentID
+        transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+	if (ZDCSubtreeDeltaIsZero(delta)) return;
+	
+	NSUInteger depth = 0;
+	while (parentID && (depth < kMaxDepth))
+	{
+		ZDCNodeAggregates *aggregates = [self aggregatesForNodeID:parentID transaction:transaction];
+		if (aggregates == nil) break;
+		
+		ZDCNodeAggregates *updated =
+		  [[ZDCNodeAggregates alloc] initWithParentID: aggregates.parentID
+		                                     dataSize: aggregates.dataSize
+		                           pendingUploadCount: aggregates.pendingUploadCount
+		                              descendantCount: ApplyDelta(aggregates.descendantCount, delta.count)
+		                           descendantDataSize: ApplyDelta(aggregates.descendantDataSize, delta.dataSize)
+		                 descendantPendingUploadCount: ApplyDelta(aggregates.descendantPendingUploadCount,
+		                                                          delta.pendingUploads)];
+		
+		[transaction setObject:updated forKey:parentID inCollection:kZDCCollection_NodeAggregates];
+		
+		parentID = aggregates.parentID;
+		depth++;
+	}
+	
+	if (depth >= kMaxDepth) {
+		ZDCLogError(@"%s: max depth exceeded - possible cycle in parentID chain", __FUNCTION__);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Hooks
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * See header file for description.
+ */
++ (void)didModifyNode:(ZDCNode *)node transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+	NSString *const nodeID = node.uuid;
+	if (nodeID == nil) return;
+	
+	ZDCNodeAggregates *oldAggregates = [self aggregatesForNodeID:nodeID transaction:transaction];
+	uint64_t const dataSize = OwnDataSize(node);
+	
+	if (oldAggregates == nil)
+	{
+		// Inserted node.
+		//
+		// Normally a new node doesn't have any descendants.
+		// But a child can be inserted before its parent (e.g. during a pull),
+		// in which case the child's subtree wasn't added to anything yet.
+		
+		__block ZDCSubtreeDelta descendants = (ZDCSubtreeDelta){ 0, 0, 0 };
+		
+		YapDatabaseViewTransaction *viewTransaction = [transaction ext:Ext_View_Treesystem_Name];
+		[viewTransaction enumerateKeysInGroup: nodeID
+		                           usingBlock:^(NSString *collection, NSString *key, NSUInteger index, BOOL *stop)
+		{
+			ZDCNodeAggregates *child = [self aggregatesForNodeID:key transaction:transaction];
+			if (child)
+			{
+				ZDCSubtreeDelta subtree = ZDCSubtreeDeltaForAggregates(child);
+				
+				descendants.count += subtree.count;
+				descendants.dataSize += subtree.dataSize;
+				descendants.pendingUploads += subtree.pendingUploads;
+			}
+		}];
+		
+		ZDCNodeAggregates *newAggregates =
+		  [[ZDCNodeAggregates alloc] initWithParentID: node.parentID
+		                                     dataSize: dataSize
+		                           pendingUploadCount: 0
+		                              descendantCount: (uint64_t)descendants.count
+		                           descendantDataSize: (uint64_t)descendants.dataSize
+		                 descendantPendingUploadCount: (uint64_t)descendants.pendingUploads];
+		
+		[transaction setObject:newAggregates forKey:nodeID inCollection:kZDCCollection_NodeAggregates];
+		
+		[self applyDelta: ZDCSubtreeDeltaForAggregates(newAggregates)
+		 toAncestorsFrom: node.parentID
+		     transaction: transaction];
+	}
+	else if (!IsEqualOrBothNil(oldAggregates.parentID, node.parentID))
+	{
+		// Moved node.
+		// Subtract the (old) subtree from the old ancestors, and add the (new) subtree to the new ancestors.
+		
+		ZDCNodeAggregates *newAggregates =
+		  [[ZDCNodeAggregates alloc] initWithParentID: node.parentID
+		                                     dataSize: dataSize
+		                           pendingUploadCount: oldAggregates.pendingUploadCount
+		                              descendantCount: oldAggregates.descendantCount
+		                           descendantDataSize: oldAggregates.descendantDataSize
+		                 descendantPendingUploadCount: oldAggregates.descendantPendingUploadCount];
+		
+		[transaction setObject:newAggregates forKey:nodeID inCollection:kZDCCollection_NodeAggregates];
+		
+		[self applyDelta: ZDCSubtreeDeltaNegate(ZDCSubtreeDeltaForAggregates(oldAggregates))
+		 toAncestorsFrom: oldAggregates.parentID
+		     transaction: transaction];
+		
+		[self applyDelta: ZDCSubtreeDeltaForAggregates(newAggregates)
+		 toAncestorsFrom: node.parentID
+		     transaction: transaction];
+	}
+	else if (oldAggregates.dataSize != dataSize)
+	{
+		// Modified node (new data uploaded/downloaded).
+		
+		ZDCNodeAggregates *newAggregates =
+		  [[ZDCNodeAggregates alloc] initWithParentID: oldAggregates.parentID
+		                                     dataSize: dataSize
+		                           pendingUploadCount: oldAggregates.pendingUploadCount
+		                              descendantCount: oldAggregates.descendantCount
+		                           descendantDataSize: oldAggregates.descendantDataSize
+		                 descendantPendingUploadCount: oldAggregates.descendantPendingUploadCount];
+		
+		[transaction setObject:newAggregates forKey:nodeID inCollection:kZDCCollection_NodeAggregates];
+		
+		ZDCSubtreeDelta delta = (ZDCSubtreeDelta){ 0, (int64_t)dataSize - (int64_t)oldAggregates.dataSize, 0 };
+		
+		[self applyDelta:delta toAncestorsFrom:oldAggregates.parentID transaction:transaction];
+	}
+}
+
+/**
+ * See header file for description.
+ */
++ (void)didRemoveNodeID:(NSString *)nodeID transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+	ZDCNodeAggregates *oldAggregates = [self aggregatesForNodeID:nodeID transaction:transaction];
+	if (oldAggregates == nil) return;
+	
+	[transaction removeObjectForKey:nodeID inCollection:kZDCCollection_NodeAggregates];
+	
+	// Note: If the node still has children, they're orphaned (they'll be deleted shortly).
+	// Their records point at this nodeID, which no longer has aggregates,
+	// so their removal won't be subtracted from our ancestors a second time.
+	
+	[self applyDelta: ZDCSubtreeDeltaNegate(ZDCSubtreeDeltaForAggregates(oldAggregates))
+	 toAncestorsFrom: oldAggregates.parentID
+	     transaction: transaction];
+}
+
+/**
+ * See header file for description.
+ */
++ (void)didAddUploadOperation:(NSUUID *)operationID
+                    forNodeID:(NSString *)nodeID
+                  transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+	if (operationID == nil || nodeID == nil) return;
+	
+	if ([self adjustPendingUploadCount:1 forNodeID:nodeID transaction:transaction])
+	{
+		[transaction setObject: nodeID
+		                forKey: UploadOperationKey(operationID)
+		          inCollection: kZDCCollection_NodeAggregates];
+	}
+}
+
+/**
+ * See header file for description.
+ */
++ (void)didRemoveUploadOperation:(NSUUID *)operationID
+                     transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+	if (operationID == nil) return;
+	
+	NSString *const key = UploadOperationKey(operationID);
+	
+	id nodeID = [transaction objectForKey:key inCollection:kZDCCollection_NodeAggregates];
+	if (![nodeID isKindOfClass:[NSString class]]) {
+		return; // operation was never counted
+	}
+	
+	[transaction removeObjectForKey:key inCollection:kZDCCollection_NodeAggregates];
+	
+	[self adjustPendingUploadCount:-1 forNodeID:(NSString *)nodeID transaction:transaction];
+}
+
+/**
+ * Applies the delta to the node's pendingUploadCount (and to its ancestors).
+ * Returns NO if the node doesn't have aggregates.
+ */
++ (BOOL)adjustPendingUploadCount:(int64_t)delta
+                       forNodeID:(NSString *)nodeID
+                     transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+	ZDCNodeAggregates *oldAggregates = [self aggregatesForNodeID:nodeID transaction:transaction];
+	if (oldAggregates == nil) return NO;
+	
+	uint64_t pendingUploadCount = ApplyDelta(oldAggregates.pendingUploadCount, delta);
+	if (pendingUploadCount == oldAggregates.pendingUploadCount) return YES;
+	
+	ZDCNodeAggregates *newAggregates =
+	  [[ZDCNodeAggregates alloc] initWithParentID: oldAggregates.parentID
+	                                     dataSize: oldAggregates.dataSize
+	                           pendingUploadCount: pendingUploadCount
+	                              descendantCount: oldAggregates.descendantCount
+	                           descendantDataSize: oldAggregates.descendantDataSize
+	                 descendantPendingUploadCount: oldAggregates.descendantPendingUploadCount];
+	
+	[transaction setObject:newAggregates forKey:nodeID inCollection:kZDCCollection_NodeAggregates];
+	
+	int64_t actualDelta = (int64_t)pendingUploadCount - (int64_t)oldAggregates.pendingUploadCount;
+	
+	[self applyDelta: (ZDCSubtreeDelta){ 0, 0, actualDelta }
+	 toAncestorsFrom: oldAggregates.parentID
+	     transaction: transaction];
+	
+	return YES;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Rebuild
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * See header file for description.
+ */
++ (void)rebuildIfNeeded:(YapDatabaseReadWriteTransaction *)transaction
+{
+	id version = [transaction objectForKey:kAggregatesVersionKey inCollection:kZDCCollection_NodeAggregates];
+	if ([version isKindOfClass:[NSNumber class]] && [(NSNumber *)version integerValue] == kAggregatesVersion) {
+		return;
+	}
+	
+	ZDCLogInfo(@"Rebuilding node aggregates...");
+	
+	[transaction removeAllObjectsInCollection:kZDCCollection_NodeAggregates];
+	
+	// Step 1 of 4:
+	// Read the parentID & dataSize of every node.
+	
+	NSMutableDictionary<NSString*, NSString*> *parentIDs = [NSMutableDictionary dictionary];
+	NSMutableDictionary<NSString*, NSNumber*> *dataSizes = [NSMutableDictionary dictionary];
+	
+	[transaction enumerateKeysAndObjectsInCollection: kZDCCollection_Nodes
+	                                      usingBlock:^(NSString *key, id object, BOOL *stop)
+	{
+		if ([object isKindOfClass:[ZDCNode class]])
+		{
+			__unsafe_unretained ZDCNode *node = (ZDCNode *)object;
+			
+			parentIDs[key] = node.parentID;
+			dataSizes[key] = @(OwnDataSize(node));
+		}
+	}];
+	
+	// Step 2 of 4:
+	// Count the queued data uploads (from every ZDCCloud instance).
+	
+	NSMutableDictionary<NSString*, NSNumber*> *pendingUploads = [NSMutableDictionary dictionary];
+	
+	NSDictionary *registeredExtensions = [transaction.connection.database registeredExtensions];
+	for (YapDatabaseExtension *ext in [registeredExtensions objectEnumerator])
+	{
+		if (![ext isKindOfClass:[ZDCCloud class]]) continue;
+		
+		ZDCCloudTransaction *cloudTransaction = [transaction ext:ext.registeredName];
+		[cloudTransaction enumerateOperationsUsingBlock:
+			^(YapDatabaseCloudCorePipeline *pipeline,
+			  YapDatabaseCloudCoreOperation *operation, NSUInteger graphIdx, BOOL *stop)
+		{
+			if ([operation isKindOfClass:[ZDCCloudOperation class]])
+			{
+				__unsafe_unretained ZDCCloudOperation *op = (ZDCCloudOperation *)operation;
+				
+				if (op.isPutNodeDataOperation && op.nodeID && dataSizes[op.nodeID])
+				{
+					pendingUploads[op.nodeID] = @([pendingUploads[op.nodeID] unsignedLongLongValue] + 1);
+					
+					[transaction setObject: op.nodeID
+					                forKey: UploadOperationKey(op.uuid)
+					          inCollection: kZDCCollection_NodeAggregates];
+				}
+			}
+		}];
+	}
+	
+	// Step 3 of 4:
+	// Add each node to the sums of its ancestors.
+	
+	NSMutableDictionary<NSString*, NSNumber*> *descendantCounts = [NSMutableDictionary dictionary];
+	NSMutableDictionary<NSString*, NSNumber*> *descendantDataSizes = [NSMutableDictionary dictionary];
+	NSMutableDictionary<NSString*, NSNumber*> *descendantPendingUploads = [NSMutableDictionary dictionary];
+	
+	[dataSizes enumerateKeysAndObjectsUsingBlock:^(NSString *nodeID, NSNumber *dataSize, BOOL *stop) {
+		
+		uint64_t pending = [pendingUploads[nodeID] unsignedLongLongValue];
+		
+		NSString *parentID = parentIDs[nodeID];
+		NSUInteger depth = 0;
+		
+		while (parentID && dataSizes[parentID] && (depth < kMaxDepth))
+		{
+			descendantCounts[parentID] =
+			  @([descendantCounts[parentID] unsignedLongLongValue] + 1);
+			
+			descendantDataSizes[parentID] =
+			  @([descendantDataSizes[parentID] unsignedLongLongValue] + [dataSize unsignedLongLongValue]);
+			
+			if (pending > 0) {
+				descendantPendingUploads[parentID] =
+				  @([descendantPendingUploads[parentID] unsignedLongLongValue] + pending);
+			}
+			
+			parentID = parentIDs[parentID];
+			depth++;
+		}
+	}];
+	
+	// Step 4 of 4:
+	// Write the records.
+	
+	[dataSizes enumerateKeysAndObjectsUsingBlock:^(NSString *nodeID, NSNumber *dataSize, BOOL *stop) {
+		
+		ZDCNodeAggregates *aggregates =
+		  [[ZDCNodeAggregates alloc] initWithParentID: parentIDs[nodeID]
+		                                     dataSize: [dataSize unsignedLongLongValue]
+		                           pendingUploadCount: [pendingUploads[nodeID] unsignedLongLongValue]
+		                              descendantCount: [descendantCounts[nodeID] unsignedLongLongValue]
+		                           descendantDataSize: [descendantDataSizes[nodeID] unsignedLongLongValue]
+		                 descendantPendingUploadCount: [descendantPendingUploads[nodeID] unsignedLongLongValue]];
+		
+		[transaction setObject:aggregates forKey:nodeID inCollection:kZDCCollection_NodeAggregates];
+	}];
+	
+	[transaction setObject: @(kAggregatesVersion)
+	                forKey: kAggregatesVersionKey
+	          inCollection: kZDCCollection_NodeAggregates];
+	
+	ZDCLogInfo(@"Rebuilt node aggregates: %lu nodes", (unsigned long)dataSizes.count);
+}
+
+@end
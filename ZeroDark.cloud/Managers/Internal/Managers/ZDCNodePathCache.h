@@ -0,0 +1,110 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import <Foundation/Foundation.h>
+#import <YapDatabase/YapDatabase.h>
+
+#import "ZDCNode.h"
+#import "ZDCTreesystemPath.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * An in-memory cache used by the ZDCNodeManager to speed up path resolution:
+ *
+ * - forward:  (parentID, name) => nodeID
+ *   Each entry is an edge in a trie of path components (rooted at the trunk nodes).
+ *   So `findNodeWithPath:` becomes a walk through dictionaries, instead of a view lookup per path component.
+ *
+ * - reverse:  nodeID => ZDCTreesystemPath
+ *   Memoized for nodes that are the parent of something we've calculated the path for.
+ *   So `pathForNode:` becomes a single lookup (the parent's path + node.name).
+ *
+ * The cache is transaction-aware:
+ *
+ * - Modifications are reported by ZDCCloudTransaction (via the transaction hooks),
+ *   and invalidate exactly the affected entries (a renamed/moved/deleted node, plus the memoized paths of its subtree).
+ *
+ * - Modifications also raise the minimum snapshot for which the cache may be used.
+ *   A read-only transaction on an older snapshot bypasses the cache,
+ *   and its results are never stored (as they may be stale).
+ *
+ * - A read-write transaction may use the cache (its own changes have already been invalidated),
+ *   but doesn't store anything, as its changes might still be rolled back.
+ *
+ * There is one cache per database. This class is thread-safe.
+ */
+@interface ZDCNodePathCache : NSObject
+
+/**
+ * Returns the cache for the transaction's database (creating it if needed).
+ */
++ (instancetype)cacheForTransaction:(YapDatabaseReadTransaction *)transaction;
+
+/**
+ * Returns the cache for the transaction's database, or nil if it hasn't been created.
+ * (If there's no cache, there's nothing to invalidate.)
+ */
++ (nullable instancetype)existingCacheForTransaction:(YapDatabaseReadTransaction *)transaction;
+
+#pragma mark Lookup
+
+/**
+ * Returns the nodeID of the child with the given name (case-insensitive), if known.
+ */
+- (nullable NSString *)nodeIDForName:(NSString *)name
+                            parentID:(NSString *)parentID
+                         transaction:(YapDatabaseReadTransaction *)transaction;
+
+/**
+ * Returns the memoized path for the node, if known.
+ */
+- (nullable ZDCTreesystemPath *)pathForNodeID:(NSString *)nodeID
+                                  transaction:(YapDatabaseReadTransaction *)transaction;
+
+#pragma mark Population
+
+/**
+ * Stores the edge: (node.parentID, node.name) => node.uuid
+ *
+ * The node must have been read from the database within the given transaction.
+ */
+- (void)addNode:(ZDCNode *)node transaction:(YapDatabaseReadTransaction *)transaction;
+
+/**
+ * Stores the edge for the node (as above), plus the memoized path.
+ *
+ * The node must have been read from the database within the given transaction.
+ */
+- (void)addNode:(ZDCNode *)node path:(ZDCTreesystemPath *)path transaction:(YapDatabaseReadTransaction *)transaction;
+
+#pragma mark Invalidation
+
+/**
+ * Invoked (from within a read-write transaction) after a node is inserted or modified.
+ * If the node's name, parent or pointee changed, the affected entries are removed.
+ */
+- (void)didUpdateNode:(ZDCNode *)node transaction:(YapDatabaseReadWriteTransaction *)transaction;
+
+/**
+ * Invoked (from within a read-write transaction) when a node is removed.
+ */
+- (void)didRemoveNodeID:(NSString *)nodeID transaction:(YapDatabaseReadWriteTransaction *)transaction;
+
+#pragma mark Debugging
+
+/** The number of (parentID, name) => nodeID entries. */
+@property (atomic, readonly) NSUInteger edgeCount;
+
+/** The number of memoized paths. */
+@property (atomic, readonly) NSUInteger pathCount;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,371 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import "ZDCNodePathCache.h"
+
+#import "ZDCTrunkNode.h"
+
+// Libraries
+#import <YapDatabase/YapDatabaseAtomic.h>
+
+/**
+ * If the number of edges exceeds this limit, the cache is simply flushed.
+ * (It will repopulate itself with whatever paths are actually in use.)
+ */
+static NSUInteger const kMaxEdgeCount = 20000;
+
+@implementation ZDCNodePathCache {
+
+	YAPUnfairLock spinlock;
+	
+	NSMutableDictionary<NSString*, NSMutableDictionary<NSString*, NSString*>*> *children; // parentID => (nameKey => nodeID)
+	NSMutableDictionary<NSString*, NSArray<NSString*>*> *locations;                        // nodeID => [parentID, nameKey]
+	NSMutableDictionary<NSString*, ZDCTreesystemPath*> *paths;                              // nodeID => path
+	NSUInteger edgeCount;
+	
+	uint64_t minValidSnapshot;
+}
+
+@dynamic edgeCount;
+@dynamic pathCount;
+
+static YAPUnfairLock registryLock = YAP_UNFAIR_LOCK_INIT;
+static NSMapTable<YapDatabase*, ZDCNodePathCache*> *registry = nil; // weak keys
+
++ (instancetype)cacheForTransaction:(YapDatabaseReadTransaction *)transaction
+{
+	YapDatabase *database = transaction.connection.database;
+	ZDCNodePathCache *cache = nil;
+	
+	YAPUnfairLockLock(&registryLock);
+	{
+		if (registry == nil) {
+			registry = [NSMapTable weakToStrongObjectsMapTable];
+		}
+		
+		cache = [registry objectForKey:database];
+		if (cache == nil && database)
+		{
+			cache = [[ZDCNodePathCache alloc] init];
+			[registry setObject:cache forKey:database];
+		}
+	}
+	YAPUnfairLockUnlock(&registryLock);
+	
+	return cache;
+}
+
++ (nullable instancetype)existingCacheForTransaction:(YapDatabaseReadTransaction *)transaction
+{
+	YapDatabase *database = transaction.connection.database;
+	ZDCNodePathCache *cache = nil;
+	
+	YAPUnfairLockLock(&registryLock);
+	{
+		cache = [registry objectForKey:database];
+	}
+	YAPUnfairLockUnlock(&registryLock);
+	
+	return cache;
+}
+
+- (instancetype)init
+{
+	if ((self = [super init]))
+	{
+		spinlock = YAP_UNFAIR_LOCK_INIT;
+		
+		children = [[NSMutableDictionary alloc] init];
+		locations = [[NSMutableDictionary alloc] init];
+		paths = [[NSMutableDictionary alloc] init];
+	}
+	return self;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Utilities
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Names are compared case-insensitively (see `-[ZDCNodeManager findNodeWithName:parentID:transaction:]`).
+ */
+static NSString* NameKey(NSString *name)
+{
+	return [name lowercaseString] ?: @"";
+}
+
+static BOOL IsReadWrite(YapDatabaseReadTransaction *transaction)
+{
+	return [transaction isKindOfClass:[YapDatabaseReadWriteTransaction class]];
+}
+
+/**
+ * Must be invoked within spinlock.
+ */
+- (BOOL)canReadWithTransaction:(YapDatabaseReadTransaction *)transaction
+{
+	if (IsReadWrite(transaction)) {
+		return YES;
+	}
+	
+	return (transaction.connection.snapshot >= minValidSnapshot);
+}
+
+/**
+ * Must be invoked within spinlock.
+ */
+- (BOOL)canWriteWithTransaction:(YapDatabaseReadTransaction *)transaction
+{
+	if (IsReadWrite(transaction)) {
+		return NO;
+	}
+	
+	return (transaction.connection.snapshot >= minValidSnapshot);
+}
+
+/**
+ * Must be invoked within spinlock.
+ */
+- (void)bumpMinValidSnapshot:(YapDatabaseReadWriteTransaction *)transaction
+{
+	// The changes made by this transaction become visible in the next snapshot.
+	// Readers on older snapshots must not use (or populate) the cache.
+	
+	uint64_t snapshot = transaction.connection.snapshot + 1;
+	if (minValidSnapshot < snapshot) {
+		minValidSnapshot = snapshot;
+	}
+}
+
+/**
+ * Must be invoked within spinlock.
+ */
+- (void)removeEdgeForNodeID:(NSString *)nodeID
+{
+	NSArray<NSString*> *location = locations[nodeID];
+	if (location == nil) return;
+	
+	NSString *parentID = location[0];
+	NSString *nameKey = location[1];
+	
+	NSMutableDictionary<NSString*, NSString*> *siblings = children[parentID];
+	if ([siblings[nameKey] isEqualToString:nodeID])
+	{
+		siblings[nameKey] = nil;
+		if (siblings.count == 0) {
+			children[parentID] = nil;
+		}
+	}
+	
+	locations[nodeID] = nil;
+	edgeCount--;
+}
+
+/**
+ * Removes the memoized path for the node, and all of its (known) descendants.
+ * Must be invoked within spinlock.
+ */
+- (void)removePathsForSubtree:(NSString *)rootNodeID
+{
+	NSMutableArray<NSString*> *stack = [NSMutableArray arrayWithObject:rootNodeID];
+	
+	while (stack.count > 0)
+	{
+		NSString *nodeID = [stack lastObject];
+		[stack removeLastObject];
+		
+		if (paths[nodeID] == nil) {
+			continue; // No memoized path means no memoized paths for any descendants
+		}
+		paths[nodeID] = nil;
+		
+		[stack addObjectsFromArray:[children[nodeID] allValues]];
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Lookup
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (nullable NSString *)nodeIDForName:(NSString *)name
+                            parentID:(NSString *)parentID
+                         transaction:(YapDatabaseReadTransaction *)transaction
+{
+	if (name == nil || parentID == nil) return nil;
+	
+	NSString *nodeID = nil;
+	
+	YAPUnfairLockLock(&spinlock);
+	{
+		if ([self canReadWithTransaction:transaction]) {
+			nodeID = children[parentID][NameKey(name)];
+		}
+	}
+	YAPUnfairLockUnlock(&spinlock);
+	
+	return nodeID;
+}
+
+- (nullable ZDCTreesystemPath *)pathForNodeID:(NSString *)nodeID
+                                  transaction:(YapDatabaseReadTransaction *)transaction
+{
+	if (nodeID == nil) return nil;
+	
+	ZDCTreesystemPath *path = nil;
+	
+	YAPUnfairLockLock(&spinlock);
+	{
+		if ([self canReadWithTransaction:transaction]) {
+			path = paths[nodeID];
+		}
+	}
+	YAPUnfairLockUnlock(&spinlock);
+	
+	return path;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Population
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)addNode:(ZDCNode *)node transaction:(YapDatabaseReadTransaction *)transaction
+{
+	[self addNode:node path:nil transaction:transaction];
+}
+
+- (void)addNode:(ZDCNode *)node path:(ZDCTreesystemPath *)path transaction:(YapDatabaseReadTransaction *)transaction
+{
+	NSString *nodeID = node.uuid;
+	if (nodeID == nil) return;
+	
+	BOOL isTrunk = [node isKindOfClass:[ZDCTrunkNode class]];
+	if (!isTrunk && (node.parentID == nil || node.name == nil)) return;
+	
+	YAPUnfairLockLock(&spinlock);
+	do {
+	
+		if (![self canWriteWithTransaction:transaction]) break;
+		
+		if (!isTrunk && (locations[nodeID] == nil))
+		{
+			if (edgeCount >= kMaxEdgeCount)
+			{
+				[children removeAllObjects];
+				[locations removeAllObjects];
+				[paths removeAllObjects];
+				edgeCount = 0;
+			}
+			
+			NSString *nameKey = NameKey(node.name);
+			
+			NSMutableDictionary<NSString*, NSString*> *siblings = children[node.parentID];
+			if (siblings == nil)
+			{
+				siblings = [[NSMutableDictionary alloc] init];
+				children[node.parentID] = siblings;
+			}
+			
+			siblings[nameKey] = nodeID;
+			locations[nodeID] = @[ node.parentID, nameKey ];
+			edgeCount++;
+		}
+		
+		// A memoized path is only valid as long as all its ancestors are tracked.
+		// Otherwise we wouldn't be able to find it when an ancestor is renamed/moved.
+		//
+		// The ZDCNodeManager adds paths from the top down, so this is just a sanity check.
+		
+		if (path && (isTrunk || paths[node.parentID]))
+		{
+			paths[nodeID] = path;
+		}
+		
+	} while (NO);
+	YAPUnfairLockUnlock(&spinlock);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Invalidation
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)didUpdateNode:(ZDCNode *)node transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+	NSString *nodeID = node.uuid;
+	if (nodeID == nil) return;
+	
+	YAPUnfairLockLock(&spinlock);
+	{
+		// We don't know what changed for nodes we're not tracking.
+		// So a reader on an older snapshot might be about to add a stale entry for this node.
+		
+		[self bumpMinValidSnapshot:transaction];
+		
+		NSArray<NSString*> *location = locations[nodeID];
+		if (location)
+		{
+			BOOL changed =
+			  ![location[0] isEqualToString:node.parentID] ||
+			  ![location[1] isEqualToString:NameKey(node.name)] ||
+			  node.isPointer;
+			
+			if (changed)
+			{
+				[self removeEdgeForNodeID:nodeID];
+				[self removePathsForSubtree:nodeID];
+			}
+		}
+	}
+	YAPUnfairLockUnlock(&spinlock);
+}
+
+- (void)didRemoveNodeID:(NSString *)nodeID transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+	if (nodeID == nil) return;
+	
+	YAPUnfairLockLock(&spinlock);
+	{
+		[self bumpMinValidSnapshot:transaction];
+		
+		[self removeEdgeForNodeID:nodeID];
+		[self removePathsForSubtree:nodeID];
+	}
+	YAPUnfairLockUnlock(&spinlock);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Debugging
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSUInteger)edgeCount
+{
+	NSUInteger result = 0;
+	
+	YAPUnfairLockLock(&spinlock);
+	{
+		result = edgeCount;
+	}
+	YAPUnfairLockUnlock(&spinlock);
+	
+	return result;
+}
+
+- (NSUInteger)pathCount
+{
+	NSUInteger result = 0;
+	
+	YAPUnfairLockLock(&spinlock);
+	{
+		result = paths.count;
+	}
+	YAPUnfairLockUnlock(&spinlock);
+	
+	return result;
+}
+
+@end
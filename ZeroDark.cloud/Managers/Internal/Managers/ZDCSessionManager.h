@@ -9,6 +9,20 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+/**
+ * Receives the response body of a data task as it arrives.
+ *
+ * The methods are invoked on the session's delegate queue (which is serial),
+ * so implementations should hand off expensive work to a different queue.
+ */
+@protocol ZDCSessionDataSink <NSObject>
+
+- (void)dataTask:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data;
+
+- (void)task:(NSURLSessionTask *)task didCompleteWithError:(nullable NSError *)error;
+
+@end
+
 /**
  * The SessionManager manages NSURLSession's for the framework.
  *
@@ -59,6 +73,20 @@ NS_ASSUME_NONNULL_BEGIN
                withTask:(NSURLSessionTask *)task
               inSession:(NSURLSession *)session;
 
+/**
+ * Use this method to stream the response body of a data task into the given sink.
+ *
+ * The task must be created directly from the underlying NSURLSession (i.e. `session.session`),
+ * and not via one of AFURLSessionManager's methods, as AFNetworking would otherwise
+ * accumulate the entire response body in memory.
+ *
+ * The sink is retained until the task completes.
+ * Only applies to foreground sessions, since background sessions don't support data tasks.
+ */
+- (void)associateDataSink:(id<ZDCSessionDataSink>)sink
+                 withTask:(NSURLSessionDataTask *)task
+                inSession:(NSURLSession *)session;
+
 /**
  * Forwarded through the system:
  * AppDelegate -> ZeroDarkCloud -> ZDCSessionManager
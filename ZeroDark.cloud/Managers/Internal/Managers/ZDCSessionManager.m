@@ -8,6 +8,7 @@
 #import "ZDCDownloadManagerPrivate.h"
 #import "ZDCLocalUser.h"
 #import "ZDCLogging.h"
+#import "ZDCProgressManagerPrivate.h"
 #import "ZDCPushManagerPrivate.h"
 #import "ZDCSessionInfo.h"
 #import "ZDCSessionUserInfo.h"
@@ -66,6 +67,8 @@ static NSString *const kSessionDescriptionPrefix_Foreground = @"fg";
 @property (nonatomic, strong, readwrite) NSURL *downloadedFileURL;
 @property (nonatomic, strong, readwrite) NSMutableData *downloadedData;
 
+@property (nonatomic, strong, readwrite) id<ZDCSessionDataSink> dataSink;
+
 @end
 
 @implementation ZDCSessionStorageItem
@@ -517,6 +520,24 @@ done:
 	
 	session.session.sessionDescription = sessionIdentifier;
 	
+	// Aggregate byte counters.
+	// These are cheap atomic adds, so it's fine to invoke them for every chunk that goes across the wire.
+	// Throughput is only calculated if somebody asks for it (ZDCProgressManager.transferStatisticsForLocalUserID:).
+	//
+	ZDCTransferCounters *counters = [zdc.progressManager transferCountersForLocalUserID:localUserID];
+	
+	[session setTaskDidSendBodyDataBlock:
+	  ^(NSURLSession *session, NSURLSessionTask *task, int64_t bytesSent, int64_t totalSent, int64_t totalExpected)
+	{
+		[counters addBytesSent:bytesSent];
+	}];
+	
+	[session setDownloadTaskDidWriteDataBlock:
+	  ^(NSURLSession *session, NSURLSessionDownloadTask *task, int64_t bytesWritten, int64_t totalWritten, int64_t totalExpected)
+	{
+		[counters addBytesReceived:bytesWritten];
+	}];
+	
 	[session setTaskNeedNewBodyStreamBlock:^NSInputStream *(NSURLSession *session, NSURLSessionTask *task){
 		
 		return [self streamForTask:task inSession:session];
@@ -528,6 +549,12 @@ done:
 		[self migrateDataTask:dataTask toDownloadTask:downloadTask inSession:session];
 	}];
 	
+	[session setDataTaskDidReceiveDataBlock:^(NSURLSession *session, NSURLSessionDataTask *dataTask, NSData *data){
+		
+		[counters addBytesReceived:(int64_t)data.length];
+		[self dataTask:dataTask inSession:session didReceiveData:data];
+	}];
+	
 	[session setDownloadTaskDidFinishDownloadingBlock:
 	  ^NSURL *(NSURLSession *session, NSURLSessionDownloadTask *downloadTask, NSURL *fileURL)
 	{
@@ -644,11 +671,30 @@ done:
 	return result;
 }
 
+- (void)dataTask:(NSURLSessionDataTask *)dataTask inSession:(NSURLSession *)session didReceiveData:(NSData *)data
+{
+	ZDCSessionStorageItem *storageItem = [self storageItemForTask:dataTask inSession:session];
+	
+	[storageItem.dataSink dataTask:dataTask didReceiveData:data];
+}
+
 - (void)taskDidComplete:(NSURLSessionTask *)task
               inSession:(NSURLSession *)session
               withError:(NSError *)error
             localUserID:(NSString *)localUserID
 {
+	{ // Data sinks are only used in foreground sessions, so there's nothing to restore.
+		
+		ZDCSessionStorageItem *storageItem = [self storageItemForTask:task inSession:session];
+		if (storageItem.dataSink)
+		{
+			[storageItem.dataSink task:task didCompleteWithError:error];
+			
+			[self removeStorageItem:storageItem forTask:task inSession:session];
+			return;
+		}
+	}
+	
 	__block ZDCSessionStorageItem *storageItem = nil;
 	
 	dispatch_sync(queue, ^{ @autoreleasepool {
@@ -1119,6 +1165,43 @@ done:
 		dispatch_sync(queue, block);
 }
 
+/**
+ * Use this method to stream the response body of a data task into the given sink.
+ *
+ * The task must be created directly from the underlying NSURLSession (not via AFURLSessionManager),
+ * as AFNetworking would otherwise accumulate the entire response body in memory.
+**/
+- (void)associateDataSink:(id<ZDCSessionDataSink>)sink
+                 withTask:(NSURLSessionDataTask *)task
+                inSession:(NSURLSession *)session
+{
+	if (task == nil) return;
+	if (session == nil) return;
+	
+	NSString *key = [self storageKeyForTask:task inSession:session];
+	
+	dispatch_block_t block = ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		ZDCSessionStorageItem *item = storage[key];
+		if (item == nil)
+		{
+			item = [[ZDCSessionStorageItem alloc] init];
+			storage[key] = item;
+		}
+		
+		item.dataSink = sink;
+		
+	#pragma clang diagnostic pop
+	}};
+	
+	if (dispatch_get_specific(IsOnQueueKey))
+		block();
+	else
+		dispatch_sync(queue, block);
+}
+
 - (NSInputStream *)streamForTask:(NSURLSessionTask *)task inSession:(NSURLSession *)session
 {
 	if (task == nil) return nil;
@@ -0,0 +1,68 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Running byte counters for network transfers.
+ *
+ * The networking code reports byte deltas as they go across the wire (from the NSURLSession delegate callbacks).
+ * Reporting is a single atomic add - no locks, no queues, no KVO.
+ * So it's cheap enough to do for every callback, even with thousands of concurrent transfers.
+ *
+ * Throughput is only calculated when somebody asks for it (via `sampleUploadThroughput:downloadThroughput:`).
+ */
+@interface ZDCTransferCounters : NSObject
+
+/**
+ * @param parent
+ *   If non-nil, all deltas are also reported to the parent.
+ *   This is used to maintain totals across all localUsers.
+ */
+- (instancetype)initWithParent:(nullable ZDCTransferCounters *)parent;
+
+/** Records bytes uploaded. Thread-safe. */
+- (void)addBytesSent:(int64_t)delta;
+
+/** Records bytes downloaded. Thread-safe. */
+- (void)addBytesReceived:(int64_t)delta;
+
+/** The total number of bytes uploaded. */
+@property (atomic, readonly) uint64_t bytesSent;
+
+/** The total number of bytes downloaded. */
+@property (atomic, readonly) uint64_t bytesReceived;
+
+/**
+ * Calculates the current throughput (in bytes per second), smoothed via an exponential moving average.
+ *
+ * The average is updated at most once per `minSampleInterval`.
+ * More frequent invocations return the previously calculated values.
+ */
+- (void)sampleUploadThroughput:(double *_Nullable)outUploadThroughput
+            downloadThroughput:(double *_Nullable)outDownloadThroughput;
+
+/**
+ * Same as `sampleUploadThroughput:downloadThroughput:`, but with an explicit timestamp (for testing).
+ */
+- (void)sampleAtTime:(CFAbsoluteTime)now
+    uploadThroughput:(double *_Nullable)outUploadThroughput
+  downloadThroughput:(double *_Nullable)outDownloadThroughput;
+
+/**
+ * The minimum interval between samples (in seconds).
+ * The default value is 0.25 seconds.
+ */
+@property (atomic, assign, readwrite) NSTimeInterval minSampleInterval;
+
+@end
+
+NS_ASSUME_NONNULL_END
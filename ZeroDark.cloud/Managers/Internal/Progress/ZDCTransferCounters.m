@@ -0,0 +1,177 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import "ZDCTransferCounters.h"
+
+// Libraries
+#import <stdatomic.h>
+#import <YapDatabase/YapDatabaseAtomic.h>
+
+// A higher SMOOTHING_FACTOR discounts older observations faster.
+//
+static double const kSmoothingFactor = 0.3;
+
+@implementation ZDCTransferCounters {
+
+	ZDCTransferCounters *parent;
+	
+	atomic_uint_least64_t bytesSent;
+	atomic_uint_least64_t bytesReceived;
+	
+	YAPUnfairLock spinlock; // protects the sampling state below
+	
+	NSTimeInterval minSampleInterval;
+	
+	BOOL hasSample;
+	CFAbsoluteTime lastSampleTime;
+	uint64_t lastBytesSent;
+	uint64_t lastBytesReceived;
+	double uploadThroughput;
+	double downloadThroughput;
+}
+
+@dynamic bytesSent;
+@dynamic bytesReceived;
+@dynamic minSampleInterval;
+
+- (instancetype)init
+{
+	return [self initWithParent:nil];
+}
+
+- (instancetype)initWithParent:(ZDCTransferCounters *)inParent
+{
+	if ((self = [super init]))
+	{
+		parent = inParent;
+		
+		atomic_init(&bytesSent, 0);
+		atomic_init(&bytesReceived, 0);
+		
+		spinlock = YAP_UNFAIR_LOCK_INIT;
+		minSampleInterval = 0.25;
+	}
+	return self;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Counters
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)addBytesSent:(int64_t)delta
+{
+	if (delta > 0) {
+		atomic_fetch_add_explicit(&bytesSent, (uint64_t)delta, memory_order_relaxed);
+		[parent addBytesSent:delta];
+	}
+}
+
+- (void)addBytesReceived:(int64_t)delta
+{
+	if (delta > 0) {
+		atomic_fetch_add_explicit(&bytesReceived, (uint64_t)delta, memory_order_relaxed);
+		[parent addBytesReceived:delta];
+	}
+}
+
+- (uint64_t)bytesSent
+{
+	return atomic_load_explicit(&bytesSent, memory_order_relaxed);
+}
+
+- (uint64_t)bytesReceived
+{
+	return atomic_load_explicit(&bytesReceived, memory_order_relaxed);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Sampling
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSTimeInterval)minSampleInterval
+{
+	NSTimeInterval result = 0;
+	
+	YAPUnfairLockLock(&spinlock);
+	{
+		result = minSampleInterval;
+	}
+	YAPUnfairLockUnlock(&spinlock);
+	
+	return result;
+}
+
+- (void)setMinSampleInterval:(NSTimeInterval)value
+{
+	YAPUnfairLockLock(&spinlock);
+	{
+		minSampleInterval = MAX(0, value);
+	}
+	YAPUnfairLockUnlock(&spinlock);
+}
+
+- (void)sampleUploadThroughput:(double *)outUploadThroughput downloadThroughput:(double *)outDownloadThroughput
+{
+	[self sampleAtTime: CFAbsoluteTimeGetCurrent()
+	  uploadThroughput: outUploadThroughput
+	downloadThroughput: outDownloadThroughput];
+}
+
+- (void)sampleAtTime:(CFAbsoluteTime)now
+    uploadThroughput:(double *)outUploadThroughput
+  downloadThroughput:(double *)outDownloadThroughput
+{
+	uint64_t current_bytesSent = self.bytesSent;
+	uint64_t current_bytesReceived = self.bytesReceived;
+	
+	double up = 0;
+	double down = 0;
+	
+	YAPUnfairLockLock(&spinlock);
+	{
+		if (!hasSample || (now < lastSampleTime)) // first sample || sanity check
+		{
+			hasSample = YES;
+			lastSampleTime = now;
+			lastBytesSent = current_bytesSent;
+			lastBytesReceived = current_bytesReceived;
+			uploadThroughput = 0;
+			downloadThroughput = 0;
+		}
+		else
+		{
+			NSTimeInterval elapsed = now - lastSampleTime;
+			if ((elapsed > 0) && (elapsed >= minSampleInterval))
+			{
+				double current_up = (double)(current_bytesSent - lastBytesSent) / elapsed;
+				double current_down = (double)(current_bytesReceived - lastBytesReceived) / elapsed;
+				
+				// Using exponential moving average
+				//
+				// averageSpeed = SMOOTHING_FACTOR * lastSpeed + (1-SMOOTHING_FACTOR) * averageSpeed;
+				
+				uploadThroughput = (kSmoothingFactor * current_up) + ((1.0 - kSmoothingFactor) * uploadThroughput);
+				downloadThroughput = (kSmoothingFactor * current_down) + ((1.0 - kSmoothingFactor) * downloadThroughput);
+				
+				lastSampleTime = now;
+				lastBytesSent = current_bytesSent;
+				lastBytesReceived = current_bytesReceived;
+			}
+		}
+		
+		up = uploadThroughput;
+		down = downloadThroughput;
+	}
+	YAPUnfairLockUnlock(&spinlock);
+	
+	if (outUploadThroughput) *outUploadThroughput = up;
+	if (outDownloadThroughput) *outDownloadThroughput = down;
+}
+
+@end
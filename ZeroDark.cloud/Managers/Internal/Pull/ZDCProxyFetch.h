@@ -0,0 +1,114 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import <Foundation/Foundation.h>
+
+#import "AWSRegions.h"
+#import "ZDCPullState.h"
+#import "ZeroDarkCloud.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * A single file returned by the fetch proxy.
+ */
+@interface ZDCProxyFetchItem : NSObject
+
+@property (nonatomic, copy, readonly) NSString *path;
+@property (nonatomic, copy, readonly) NSData *data;
+@property (nonatomic, copy, readonly, nullable) NSString *eTag;
+@property (nonatomic, copy, readonly, nullable) NSDate *lastModified;
+
+@end
+
+/**
+ * RCRD files are tiny. So when a pull needs to download thousands of them,
+ * the per-request overhead of an S3 GET (roundtrip, signing, TLS, etc) dominates.
+ *
+ * This class coalesces concurrent rcrd fetches (within the same pull & bucket) into batches,
+ * and fetches each batch via a single request to the ZeroDark.cloud fetch-proxy.
+ *
+ * The proxy is an optimization, not a requirement.
+ * If a batch fails, or a particular path is missing from the response,
+ * then the item is reported as nil, and the caller is expected to fall back to a direct S3 GET.
+ *
+ * A 403 or 404 from the gateway means the proxy isn't available.
+ * (e.g. an older deployment, where API Gateway responds with a 403 "Missing Authentication Token".)
+ * The region is remembered, and subsequent fetches skip straight to the fallback.
+ *
+ * Any other failure (no reply, 5xx, 429, a body we can't parse, etc) only fails the current batch.
+ * The next batch for the region is held back for a while (doubling with each consecutive failure),
+ * and then sent to the proxy as usual.
+ *
+ * Response format (JSON):
+ * {
+ *   "files": {
+ *     "<path, relative to app_prefix>": {
+ *       "data"        : "<base64>",
+ *       "eTag"        : "<string>",
+ *       "lastModified": "<ISO 8601>"
+ *     }
+ *   }
+ * }
+ */
+@interface ZDCProxyFetch : NSObject
+
+/**
+ * Invoked when the request for a batch completes.
+ *
+ * @param response
+ *   The reply from the gateway, or nil if the request never got a reply (e.g. network error).
+ */
+typedef void (^ZDCProxyFetchTransportCompletion)(NSURLResponse *_Nullable response,
+                                                  id _Nullable responseObject,
+                                                  NSError *_Nullable error);
+
+/**
+ * Sends the request for a single batch.
+ *
+ * @param paths
+ *   The paths to fetch, relative to the app_prefix (treeID).
+ */
+typedef void (^ZDCProxyFetchTransport)(NSArray<NSString *> *paths,
+                                       NSString *bucket,
+                                       AWSRegion region,
+                                       ZDCPullState *pullState,
+                                       ZDCProxyFetchTransportCompletion completion);
+
+/**
+ * Sends batches to the API gateway (via ZDCRestManager), using the localUser's credentials.
+ */
+- (instancetype)initWithOwner:(ZeroDarkCloud *)owner;
+
+/**
+ * Sends batches via the given transport.
+ * Used by the unit tests, which substitute a local stand-in for the API gateway.
+ */
+- (instancetype)initWithTransport:(ZDCProxyFetchTransport)transport;
+
+/**
+ * Queues the rcrd to be fetched as part of a batch.
+ *
+ * @param path
+ *   The full path of the rcrd within the bucket. (i.e. {treeID}/{dirPrefix}/{cloudName}.rcrd)
+ *
+ * @param completionBlock
+ *   Invoked with the fetched item,
+ *   or with nil if the caller should fall back to fetching the item directly.
+ */
+- (void)fetchRcrdWithPath:(NSString *)path
+                   bucket:(NSString *)bucket
+                   region:(AWSRegion)region
+                pullState:(ZDCPullState *)pullState
+          completionQueue:(dispatch_queue_t)completionQueue
+          completionBlock:(void (^)(ZDCProxyFetchItem *_Nullable item))completionBlock;
+
+@end
+
+NS_ASSUME_NONNULL_END
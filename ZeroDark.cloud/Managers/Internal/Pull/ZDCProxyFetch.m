@@ -0,0 +1,454 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import "ZDCProxyFetch.h"
+
+#import "AWSCredentialsManager.h"
+#import "AWSDate.h"
+#import "ZDCLogging.h"
+#import "ZDCRestManager.h"
+#import "ZDCSessionManager.h"
+#import "ZeroDarkCloudPrivate.h"
+
+// Categories
+#import "NSURLResponse+ZeroDark.h"
+
+// Log Levels: off, error, warn, info, verbose
+// Log Flags : trace
+#if DEBUG && robbie_hanson
+  static const int zdcLogLevel = ZDCLogLevelVerbose | ZDCLogFlagTrace;
+#elif DEBUG
+  static const int zdcLogLevel = ZDCLogLevelWarning;
+#else
+  static const int zdcLogLevel = ZDCLogLevelWarning;
+#endif
+#pragma unused(zdcLogLevel)
+
+/**
+ * The maximum number of paths we'll put into a single request.
+ * This matches the batch size used by the list-proxy.
+ */
+static NSUInteger const kMaxBatchSize = 100;
+
+/**
+ * How long we wait for other fetches to join a batch before sending it.
+ * Pull items are dequeued in quick succession, so a very short window is sufficient.
+ */
+static NSTimeInterval const kBatchDelay = 0.010; // in seconds
+
+/**
+ * After a failed batch, the next batch (for the same region) is held back.
+ * The delay doubles with each consecutive failure, up to the max.
+ */
+static NSTimeInterval const kMinBackoff = 0.5;  // in seconds
+static NSTimeInterval const kMaxBackoff = 30.0; // in seconds
+
+
+@interface ZDCProxyFetchItem ()
+
+- (instancetype)initWithPath:(NSString *)path
+                        data:(NSData *)data
+                        eTag:(nullable NSString *)eTag
+                lastModified:(nullable NSDate *)lastModified;
+
+@end
+
+@implementation ZDCProxyFetchItem
+
+@synthesize path = path;
+@synthesize data = data;
+@synthesize eTag = eTag;
+@synthesize lastModified = lastModified;
+
+- (instancetype)initWithPath:(NSString *)inPath
+                        data:(NSData *)inData
+                        eTag:(NSString *)inETag
+                lastModified:(NSDate *)inLastModified
+{
+	if ((self = [super init]))
+	{
+		path = [inPath copy];
+		data = [inData copy];
+		eTag = [inETag copy];
+		lastModified = [inLastModified copy];
+	}
+	return self;
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface ZDCProxyFetchRequest : NSObject
+
+@property (nonatomic, copy, readwrite) NSString *path;
+@property (nonatomic, strong, readwrite) dispatch_queue_t completionQueue;
+@property (nonatomic, copy, readwrite) void (^completionBlock)(ZDCProxyFetchItem *_Nullable);
+
+@end
+
+@implementation ZDCProxyFetchRequest
+@end
+
+@interface ZDCProxyFetchBatch : NSObject
+
+@property (nonatomic, copy, readwrite) NSString *bucket;
+@property (nonatomic, assign, readwrite) AWSRegion region;
+@property (nonatomic, strong, readwrite) ZDCPullState *pullState;
+
+@property (nonatomic, strong, readonly) NSMutableArray<ZDCProxyFetchRequest *> *requests;
+
+@end
+
+@implementation ZDCProxyFetchBatch
+
+@synthesize requests = requests;
+
+- (instancetype)init
+{
+	if ((self = [super init]))
+	{
+		requests = [[NSMutableArray alloc] init];
+	}
+	return self;
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation ZDCProxyFetch {
+
+	ZDCProxyFetchTransport transport;
+	
+	dispatch_queue_t queue;
+	
+	NSMutableDictionary<NSString*, ZDCProxyFetchBatch*> *pendingBatches;
+	NSMutableSet<NSNumber*> *unsupportedRegions;
+	
+	NSMutableDictionary<NSNumber*, NSNumber*> *failureCounts; // region => consecutive failed batches
+	NSMutableDictionary<NSNumber*, NSDate*> *backoffDates;    // region => don't send before this date
+}
+
+- (instancetype)initWithOwner:(ZeroDarkCloud *)owner
+{
+	return [self initWithTransport:[ZDCProxyFetch gatewayTransportWithOwner:owner]];
+}
+
+- (instancetype)initWithTransport:(ZDCProxyFetchTransport)inTransport
+{
+	NSParameterAssert(inTransport != nil);
+	
+	if ((self = [super init]))
+	{
+		transport = [inTransport copy];
+		
+		queue = dispatch_queue_create("ZDCProxyFetch", DISPATCH_QUEUE_SERIAL);
+		
+		pendingBatches = [[NSMutableDictionary alloc] init];
+		unsupportedRegions = [[NSMutableSet alloc] init];
+		
+		failureCounts = [[NSMutableDictionary alloc] init];
+		backoffDates = [[NSMutableDictionary alloc] init];
+	}
+	return self;
+}
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+
+- (void)fetchRcrdWithPath:(NSString *)path
+                   bucket:(NSString *)bucket
+                   region:(AWSRegion)region
+                pullState:(ZDCPullState *)pullState
+          completionQueue:(dispatch_queue_t)completionQueue
+          completionBlock:(void (^)(ZDCProxyFetchItem *_Nullable item))completionBlock
+{
+	NSParameterAssert(path != nil);
+	NSParameterAssert(bucket != nil);
+	NSParameterAssert(region != AWSRegion_Invalid);
+	NSParameterAssert(pullState != nil);
+	NSParameterAssert(completionBlock != nil);
+	
+	if (completionQueue == nil)
+		completionQueue = dispatch_get_main_queue();
+	
+	ZDCProxyFetchRequest *request = [[ZDCProxyFetchRequest alloc] init];
+	request.path = path;
+	request.completionQueue = completionQueue;
+	request.completionBlock = completionBlock;
+	
+	dispatch_async(queue, ^{ @autoreleasepool {
+	
+		if ([unsupportedRegions containsObject:@(region)])
+		{
+			dispatch_async(completionQueue, ^{ @autoreleasepool {
+				completionBlock(nil);
+			}});
+			return;
+		}
+		
+		NSString *batchKey =
+		  [NSString stringWithFormat:@"%@|%@|%ld", pullState.pullID, bucket, (long)region];
+		
+		NSTimeInterval backoff = [backoffDates[@(region)] timeIntervalSinceNow];
+		
+		ZDCProxyFetchBatch *batch = pendingBatches[batchKey];
+		if (batch == nil)
+		{
+			batch = [[ZDCProxyFetchBatch alloc] init];
+			batch.bucket = bucket;
+			batch.region = region;
+			batch.pullState = pullState;
+			
+			pendingBatches[batchKey] = batch;
+			
+			// Give other fetches a moment to join the batch.
+			// Or, if the previous batch failed, give the gateway a moment to recover.
+			
+			NSTimeInterval batchDelay = MAX(kBatchDelay, backoff);
+			
+			dispatch_time_t delay = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(batchDelay * NSEC_PER_SEC));
+			dispatch_after(delay, queue, ^{ @autoreleasepool {
+			
+				if (pendingBatches[batchKey] == batch) {
+					[self _sendBatch:batch forKey:batchKey];
+				}
+			}});
+		}
+		else if (batch.requests.count >= kMaxBatchSize)
+		{
+			// The batch is full, but we're backing off.
+			// Rather than holding up more items, let this one fall back to a direct fetch.
+			
+			dispatch_async(completionQueue, ^{ @autoreleasepool {
+				completionBlock(nil);
+			}});
+			return;
+		}
+		
+		[batch.requests addObject:request];
+		
+		if ((batch.requests.count >= kMaxBatchSize) && (backoff <= 0)) {
+			[self _sendBatch:batch forKey:batchKey];
+		}
+	}});
+}
+
+/**
+ * Must be invoked from within the queue.
+ */
+- (void)_sendBatch:(ZDCProxyFetchBatch *)batch forKey:(NSString *)batchKey
+{
+	[pendingBatches removeObjectForKey:batchKey];
+	
+	NSString *const treeID = batch.pullState.treeID;
+	AWSRegion const region = batch.region;
+	
+	// The server expects paths relative to the app_prefix (treeID).
+	
+	NSMutableArray<NSString *> *requestPaths = [NSMutableArray arrayWithCapacity:batch.requests.count];
+	for (ZDCProxyFetchRequest *request in batch.requests)
+	{
+		[requestPaths addObject:[self relativePath:request.path treeID:treeID]];
+	}
+	
+	transport(requestPaths, batch.bucket, region, batch.pullState,
+	^(NSURLResponse *urlResponse, id responseObject, NSError *error)
+	{
+		dispatch_async(queue, ^{ @autoreleasepool {
+			
+			NSDictionary *files = nil;
+			NSInteger statusCode = 0;
+			
+			if (urlResponse)
+			{
+				statusCode = urlResponse.httpStatusCode;
+				
+				id json = responseObject;
+				if ([json isKindOfClass:[NSData class]]) {
+					json = [NSJSONSerialization JSONObjectWithData:(NSData *)json options:0 error:nil];
+				}
+				
+				if ((statusCode == 200) && [json isKindOfClass:[NSDictionary class]])
+				{
+					files = ((NSDictionary *)json)[@"files"];
+				}
+			}
+			
+			if ([files isKindOfClass:[NSDictionary class]])
+			{
+				[failureCounts removeObjectForKey:@(region)];
+				[backoffDates removeObjectForKey:@(region)];
+			}
+			else if ((statusCode == 403) || (statusCode == 404))
+			{
+				// The gateway doesn't have the fetch-proxy.
+				// (Older API Gateway deployments reply with a 403 "Missing Authentication Token".)
+				// Don't bother trying again (for this region).
+				
+				ZDCLogWarn(@"Fetch-proxy unsupported (status %ld) - using direct fetch", (long)statusCode);
+				[unsupportedRegions addObject:@(region)];
+				
+				files = nil;
+			}
+			else
+			{
+				// No reply, or a reply we don't understand (e.g. 5xx, 429, 401).
+				// This is likely temporary, so we only fail this batch, and back off before sending the next one.
+				
+				NSUInteger failureCount = [failureCounts[@(region)] unsignedIntegerValue] + 1;
+				NSTimeInterval backoff = MIN(kMinBackoff * pow(2, MIN(failureCount - 1, 16)), kMaxBackoff);
+				
+				ZDCLogWarn(@"Fetch-proxy batch failed (status %ld) - backing off for %.1f seconds",
+				           (long)statusCode, backoff);
+				
+				failureCounts[@(region)] = @(failureCount);
+				backoffDates[@(region)] = [NSDate dateWithTimeIntervalSinceNow:backoff];
+				
+				files = nil;
+			}
+			
+			[self _finishBatch:batch withFiles:files];
+		}});
+	});
+}
+
+/**
+ * Must be invoked from within the queue.
+ */
+- (void)_finishBatch:(ZDCProxyFetchBatch *)batch withFiles:(NSDictionary *)files
+{
+	if (![files isKindOfClass:[NSDictionary class]]) {
+		files = nil;
+	}
+	
+	NSString *const treeID = batch.pullState.treeID;
+	
+	for (ZDCProxyFetchRequest *request in batch.requests)
+	{
+		ZDCProxyFetchItem *item = nil;
+		
+		NSDictionary *info = files[[self relativePath:request.path treeID:treeID]];
+		if ([info isKindOfClass:[NSDictionary class]])
+		{
+			NSString *base64 = info[@"data"];
+			NSString *eTag = info[@"eTag"];
+			NSString *lastModifiedStr = info[@"lastModified"];
+			
+			NSData *data = nil;
+			if ([base64 isKindOfClass:[NSString class]]) {
+				data = [[NSData alloc] initWithBase64EncodedString:base64 options:0];
+			}
+			
+			if (![eTag isKindOfClass:[NSString class]]) {
+				eTag = nil;
+			}
+			
+			NSDate *lastModified = nil;
+			if ([lastModifiedStr isKindOfClass:[NSString class]]) {
+				lastModified = [AWSDate parseTimestamp:lastModifiedStr];
+			}
+			
+			// We require the eTag, as the pull logic uses it to detect future changes.
+			if (data && eTag)
+			{
+				item = [[ZDCProxyFetchItem alloc] initWithPath: request.path
+				                                          data: data
+				                                          eTag: eTag
+				                                  lastModified: lastModified];
+			}
+		}
+		
+		void (^completionBlock)(ZDCProxyFetchItem*) = request.completionBlock;
+		dispatch_async(request.completionQueue, ^{ @autoreleasepool {
+			completionBlock(item);
+		}});
+	}
+}
+
+/**
+ * The default transport: a signed request to the API gateway.
+ */
++ (ZDCProxyFetchTransport)gatewayTransportWithOwner:(ZeroDarkCloud *)owner
+{
+	__weak ZeroDarkCloud *weakZdc = owner;
+	
+	return ^(NSArray<NSString *> *paths, NSString *bucket, AWSRegion region, ZDCPullState *pullState,
+	         ZDCProxyFetchTransportCompletion completion)
+	{
+		ZeroDarkCloud *zdc = weakZdc;
+		if (zdc == nil)
+		{
+			completion(nil, nil, nil);
+			return;
+		}
+		
+		NSString *const localUserID = pullState.localUserID;
+		
+		[zdc.awsCredentialsManager getAWSCredentialsForUser: localUserID
+		                                    completionQueue: dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0)
+		                                    completionBlock:^(ZDCLocalUserAuth *auth, NSError *error)
+		{
+			if (error)
+			{
+				completion(nil, nil, error);
+				return;
+			}
+			
+			ZDCSessionInfo *sessionInfo = [zdc.sessionManager sessionInfoForUserID:localUserID];
+		#if TARGET_OS_IPHONE
+			AFURLSessionManager *session = sessionInfo.foregroundSession;
+		#else
+			AFURLSessionManager *session = sessionInfo.session;
+		#endif
+			
+			NSMutableURLRequest *request =
+			  [zdc.restManager fetchProxyWithPaths: paths
+			                                treeID: pullState.treeID
+			                                pullID: pullState.pullID
+			                              inBucket: bucket
+			                                region: region
+			                        forLocalUserID: localUserID
+			                              withAuth: auth];
+			
+			__block NSURLSessionDataTask *task = nil;
+			task = [session dataTaskWithRequest: request
+			                     uploadProgress: nil
+			                   downloadProgress: nil
+			                  completionHandler:^(NSURLResponse *urlResponse, id responseObject, NSError *error)
+			{
+				[pullState removeTask:task];
+				
+				completion(urlResponse, responseObject, error);
+			}];
+			
+			[pullState addTask:task];
+			[task resume];
+		}];
+	};
+}
+
+- (NSString *)relativePath:(NSString *)path treeID:(NSString *)treeID
+{
+	if (treeID && [path hasPrefix:treeID])
+		path = [path substringFromIndex:treeID.length];
+	if ([path hasPrefix:@"/"])
+		path = [path substringFromIndex:1];
+	
+	return path;
+}
+
+#pragma clang diagnostic pop
+
+@end
@@ -29,6 +29,9 @@
 @property (atomic, strong, readonly) NSSet<NSString *>* unprocessedIdentityIDs;
 @property (atomic, strong, readonly) NSSet<NSString *>* unknownUserIDs;
 
+@property (atomic, strong, readonly) NSSet<NSString *>* inFlightChangeIDs;
+@property (atomic, assign, readonly) NSUInteger inFlightChangeCount;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark List Tracking
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -67,6 +70,21 @@
  **/
 - (void)removeTask:(NSURLSessionTask *)task;
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Change Tracking
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * During a quick pull, independent changes are processed concurrently.
+ * We keep track of the changes that are currently being processed,
+ * so they aren't handed out twice, and so dependent changes wait for them.
+ *
+ * Each entry is the set of changeIDs for a single (possibly merged) change.
+**/
+- (void)addInFlightChangeIDs:(NSOrderedSet<NSString *> *)changeIDs;
+
+- (void)removeInFlightChangeIDs:(NSOrderedSet<NSString *> *)changeIDs;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Node Tracking
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -85,6 +103,13 @@
 
 - (void)removeUnprocessedNodeID:(NSString *)nodeID;
 
+- (void)removeUnprocessedNodeIDs:(NSArray<NSString *> *)nodeIDs;
+
+/**
+ * Faster than checking `unprocessedNodeIDs`, as it doesn't require copying the set.
+**/
+- (BOOL)isUnprocessedNodeID:(NSString *)nodeID;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Avatar Tracking
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -117,4 +142,16 @@
 **/
 - (BOOL)isFirstAuthFailure;
 
+/**
+ * Returns YES if this is the first time we're falling back to a full pull.
+ * Concurrent quick pull changes may all decide to fallback, but only one full pull should be started.
+**/
+- (BOOL)isFirstFallbackToFullPull;
+
+/**
+ * Returns YES if this is the first time we're completing the pull.
+ * Concurrent quick pull changes may all fail, but the pull should only be stopped once.
+**/
+- (BOOL)isFirstFinalCompletion;
+
 @end
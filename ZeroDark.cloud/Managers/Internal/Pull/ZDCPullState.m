@@ -25,9 +25,12 @@
 	NSMutableSet<NSString*> *unprocessedNodeIDs;
 	NSMutableSet<NSString*> *unprocessedIdentityIDs;
 	NSMutableSet<NSString*> *unknownUserIDs;
+	NSMutableArray<NSOrderedSet<NSString*>*> *inFlightChanges;
 	
 	BOOL changeDetected;
 	BOOL authFailed;
+	BOOL fellBackToFullPull;
+	BOOL finalCompletionInvoked;
 }
 
 @synthesize localUserID = localUserID;
@@ -43,6 +46,8 @@
 @dynamic unprocessedNodeIDs;
 @dynamic unprocessedIdentityIDs;
 @dynamic unknownUserIDs;
+@dynamic inFlightChangeIDs;
+@dynamic inFlightChangeCount;
 
 - (instancetype)initWithLocalUserID:(NSString *)inLocalUserID treeID:(NSString *)inTreeID
 {
@@ -62,6 +67,7 @@
 		unprocessedNodeIDs     = [[NSMutableSet alloc] init];
 		unprocessedIdentityIDs = [[NSMutableSet alloc] init];
 		unknownUserIDs         = [[NSMutableSet alloc] init];
+		inFlightChanges        = [[NSMutableArray alloc] init];
 		
 		authFailed = NO;
 	}
@@ -339,6 +345,72 @@
 	}});
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Change Tracking
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSSet<NSString *> *)inFlightChangeIDs
+{
+	__block NSSet<NSString *>* result = nil;
+	
+	dispatch_sync(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		NSMutableSet<NSString *> *changeIDs = [NSMutableSet set];
+		for (NSOrderedSet<NSString *> *inFlightChange in inFlightChanges)
+		{
+			[changeIDs unionSet:[inFlightChange set]];
+		}
+		
+		result = [changeIDs copy];
+		
+	#pragma clang diagnostic pop
+	}});
+	
+	return result;
+}
+
+- (NSUInteger)inFlightChangeCount
+{
+	__block NSUInteger result = 0;
+	
+	dispatch_sync(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		result = inFlightChanges.count;
+		
+	#pragma clang diagnostic pop
+	}});
+	
+	return result;
+}
+
+- (void)addInFlightChangeIDs:(NSOrderedSet<NSString *> *)changeIDs
+{
+	dispatch_sync(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		[inFlightChanges addObject:changeIDs];
+		
+	#pragma clang diagnostic pop
+	}});
+}
+
+- (void)removeInFlightChangeIDs:(NSOrderedSet<NSString *> *)changeIDs
+{
+	dispatch_sync(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		[inFlightChanges removeObject:changeIDs];
+		
+	#pragma clang diagnostic pop
+	}});
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Node Tracking
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -383,6 +455,38 @@
 	}});
 }
 
+- (void)removeUnprocessedNodeIDs:(NSArray<NSString *> *)nodeIDs
+{
+	dispatch_sync(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		for (NSString *nodeID in nodeIDs)
+		{
+			[unprocessedNodeIDs removeObject:nodeID];
+		}
+		
+	#pragma clang diagnostic pop
+	}});
+}
+
+- (BOOL)isUnprocessedNodeID:(NSString *)nodeID
+{
+	if (nodeID == nil) return NO;
+	
+	__block BOOL result = NO;
+	dispatch_sync(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		result = [unprocessedNodeIDs containsObject:nodeID];
+		
+	#pragma clang diagnostic pop
+	}});
+	
+	return result;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Avatar Tracking
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -504,4 +608,45 @@
 	return result;
 }
 
+/**
+ * Returns YES if this is the first time we're falling back to a full pull.
+**/
+- (BOOL)isFirstFallbackToFullPull
+{
+	__block BOOL result = NO;
+	
+	dispatch_sync(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		if (fellBackToFullPull == NO)
+		{
+			result = fellBackToFullPull = YES;
+		}
+		
+	#pragma clang diagnostic pop
+	}});
+	
+	return result;
+}
+
+- (BOOL)isFirstFinalCompletion
+{
+	__block BOOL result = NO;
+	
+	dispatch_sync(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		if (finalCompletionInvoked == NO)
+		{
+			result = finalCompletionInvoked = YES;
+		}
+		
+	#pragma clang diagnostic pop
+	}});
+	
+	return result;
+}
+
 @end
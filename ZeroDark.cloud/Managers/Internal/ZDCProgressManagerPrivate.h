@@ -8,6 +8,7 @@
  **/
 
 #import "ZDCProgressManager.h"
+#import "ZDCTransferCounters.h"
 #import "ZeroDarkCloud.h"
 
 NS_ASSUME_NONNULL_BEGIN
@@ -31,6 +32,19 @@ NS_ASSUME_NONNULL_BEGIN
                 completionQueue:(nullable dispatch_queue_t)completionQueue
                 completionBlock:(nullable NodeDataDownloadCompletionBlock)completionBlock;
 
+/**
+ * The networking code reports byte deltas to these counters as data goes across the wire.
+ * The returned instance is also valid for future transfers, so it can be cached by the caller.
+ * Thread-safe.
+ */
+- (ZDCTransferCounters *)transferCountersForLocalUserID:(NSString *)localUserID;
+
+/**
+ * Throughput & estimated time remaining are only calculated for progress items that have been handed out.
+ * This method should be invoked when a registered progress is handed out by some other route (e.g. ZDCDownloadTicket).
+ */
+- (void)monitorThroughputForProgress:(NSProgress *)progress;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -22,6 +22,13 @@ NS_ASSUME_NONNULL_BEGIN
                 completionQueue:(nullable dispatch_queue_t)completionQueue
                 completionBlock:(void (^)(BOOL needsPull))completionBlock;
 
+/**
+ * Removes any stored progress of an interrupted full pull for the given user.
+ * Invoked when the localUser is deleted.
+ */
+- (void)removeFullPullCheckpointForLocalUserID:(NSString *)localUserID
+                                   transaction:(YapDatabaseReadWriteTransaction *)transaction;
+
 @end
 
 NS_ASSUME_NONNULL_END
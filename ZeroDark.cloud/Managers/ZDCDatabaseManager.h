@@ -88,7 +88,7 @@ extern NSString *const Ext_Relationship;
  * YapDatabase extension of type: YapDatabaseSecondaryIndex <br/>
  * Access via: `transaction.ext(Ext_Index_Nodes) as? YapDatabaseSecondaryIndexTransaction`
  *
- * Indexes ZDCNode's by properties 'cloudID' & 'dirPrefix' for quick lookup.
+ * Indexes ZDCNode's by properties 'cloudID', 'dirPrefix', 'pointeeID' & 'localUserID' for quick lookup.
  */
 extern NSString *const Ext_Index_Nodes;
 
@@ -147,6 +147,15 @@ extern NSString *const Ext_View_Treesystem_Name;
  */
 extern NSString *const Ext_View_Treesystem_CloudName;
 
+/**
+ * YapDatabase extension of type: YapDatabaseHooks
+ *
+ * Keeps the ZDCNodeAggregates (stored in kZDCCollection_NodeAggregates) up-to-date as nodes are modified.
+ *
+ * @note Use `-[ZDCNodeManager aggregatesForNodeID:transaction:]` to read the aggregates.
+ */
+extern NSString *const Ext_Hooks_NodeAggregates;
+
 /**
  * YapDatabase extension of type: YapDatabaseAutoView <br/>
  * Access via: `transaction.ext(Ext_View_Flat) as? YapDatabaseAutoViewTransaction`
@@ -187,6 +196,9 @@ extern NSString *const Index_Nodes_Column_DirPrefix;
 /** Secondary Index column name for: `Ext_Index_Nodes` */
 extern NSString *const Index_Nodes_Column_PointeeID;
 
+/** Secondary Index column name for: `Ext_Index_Nodes` (value is nil for trunk nodes) */
+extern NSString *const Index_Nodes_Column_LocalUserID;
+
 /** Secondary Index column name for: `Ext_Index_Users` */
 extern NSString *const Index_Users_Column_RandomUUID;
 
@@ -11,10 +11,12 @@
 
 #import "ZDCConstants.h"
 #import "ZDCCachedResponse.h"
+#import "ZDCCompactCoding.h"
 #import "ZDCCloudPrivate.h"
 #import "ZDCLocalUserPrivate.h"
 #import "ZDCLocalUserManagerPrivate.h"
 #import "ZDCLogging.h"
+#import "ZDCNodeAggregator.h"
 #import "ZDCNodePrivate.h"
 #import "ZDCTask.h"
 #import "ZDCUserPrivate.h"
@@ -46,6 +48,7 @@ NSString *const Ext_View_LocalUsers           = @"ZeroDark:localUsers";
 NSString *const Ext_View_Treesystem_Name      = @"ZeroDark:fsName";
 NSString *const Ext_View_Treesystem_CloudName = @"ZeroDark:fsCloudName";
 NSString *const Ext_View_Flat                 = @"ZeroDark:flat";
+NSString *const Ext_Hooks_NodeAggregates      = @"ZeroDark:nodeAggregates";
 NSString *const Ext_View_CloudNode_DirPrefix  = @"ZeroDark:fsCloudDirPrefix";
 NSString *const Ext_View_SplitKeys            = @"ZeroDark:splitKeys";
 NSString *const Ext_View_SplitKeys_Date  		 = @"ZeroDark:splitKeys.createDate";
@@ -57,6 +60,7 @@ NSString *const Ext_ActionManager             = @"ZeroDark:action";
 NSString *const Index_Nodes_Column_CloudID    = @"cloudID";
 NSString *const Index_Nodes_Column_DirPrefix  = @"dirPrefix";
 NSString *const Index_Nodes_Column_PointeeID  = @"pointeeID";
+NSString *const Index_Nodes_Column_LocalUserID = @"localUserID";
 
 NSString *const Index_Users_Column_RandomUUID = @"random_uuid";
 
@@ -219,12 +223,21 @@ NSString *const Index_Users_Column_RandomUUID = @"random_uuid";
  * The serializer block converts objects into encrypted data blobs.
  *
  * (All of the objects used by the ZeroDarkCloud framework support the NSCoding protocol.)
+ *
+ * The objects we store in large numbers (ZDCNode, ZDCUser, ...) also support ZDCCompactCoding,
+ * which is faster than NSKeyedArchiver, and produces smaller blobs (see test_CompactCoding's benchmark).
+ * Everything else falls back to NSKeyedArchiver.
  */
 - (YapDatabaseSerializer)databaseSerializer
 {
 	YapDatabaseSerializer serializer = ^(NSString *collection, NSString *key, id object){
 		
-		return [NSKeyedArchiver archivedDataWithRootObject:object];
+		NSData *data = [ZDCCompactSerialization dataWithObject:object];
+		if (data == nil) {
+			data = [NSKeyedArchiver archivedDataWithRootObject:object];
+		}
+		
+		return data;
 	};
 	
 	return serializer;
@@ -233,13 +246,20 @@ NSString *const Index_Users_Column_RandomUUID = @"random_uuid";
 /**
  * The deserializer block converts encrypted data blobs back into objects.
  *
- * (All of the objects used by the ZeroDarkCloud framework support the NSCoding protocol.)
+ * Both formats are supported, so existing databases don't require a migration step.
+ * An object that was archived by an older version is simply re-written in the compact format
+ * the next time it's modified.
  */
 - (YapDatabaseDeserializer)databaseDeserializer
 {
 	YapDatabaseDeserializer deserializer = ^(NSString *collection, NSString *key, NSData *data){
 		
-		id object = [NSKeyedUnarchiver unarchiveObjectWithData:data];
+		id object = nil;
+		if ([ZDCCompactSerialization isCompactData:data])
+			object = [ZDCCompactSerialization objectWithData:data];
+		else
+			object = [NSKeyedUnarchiver unarchiveObjectWithData:data];
+		
 		if ([object isKindOfClass:[ZDCObject class]])
 		{
 			[(ZDCObject *)object makeImmutable];
@@ -319,6 +339,7 @@ NSString *const Index_Users_Column_RandomUUID = @"random_uuid";
 		kZDCCollection_CachedResponse,
 		kZDCCollection_CloudNodes,
 		kZDCCollection_Nodes,
+		kZDCCollection_NodeAggregates,
 		kZDCCollection_Prefs,
 		kZDCCollection_PublicKeys,
 		kZDCCollection_PullState,
@@ -394,6 +415,7 @@ NSString *const Index_Users_Column_RandomUUID = @"random_uuid";
 	[self setupView_CloudDirPrefix];
 	[self setupView_SplitKeys];
 	[self setupView_SplitKeys_Date];
+	[self setupHooks_NodeAggregates];
 	[self setupCloudExtensions];
 	[self setupActionManager];
 
@@ -464,11 +486,13 @@ NSString *const Index_Users_Column_RandomUUID = @"random_uuid";
 	// - ZDCNode.cloudID
 	// - ZDCNode.dirPrefix
 	// - ZDCNode.pointeeID
+	// - ZDCNode.localUserID (excluding trunk nodes)
 	
 	YapDatabaseSecondaryIndexSetup *setup = [[YapDatabaseSecondaryIndexSetup alloc] init];
 	[setup addColumn:Index_Nodes_Column_CloudID   withType:YapDatabaseSecondaryIndexTypeText];
 	[setup addColumn:Index_Nodes_Column_DirPrefix withType:YapDatabaseSecondaryIndexTypeText];
 	[setup addColumn:Index_Nodes_Column_PointeeID withType:YapDatabaseSecondaryIndexTypeText];
+	[setup addColumn:Index_Nodes_Column_LocalUserID withType:YapDatabaseSecondaryIndexTypeText];
 	
 	YapDatabaseSecondaryIndexHandler *handler = [YapDatabaseSecondaryIndexHandler withObjectBlock:
 	    ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict,
@@ -480,9 +504,14 @@ NSString *const Index_Users_Column_RandomUUID = @"random_uuid";
 		dict[Index_Nodes_Column_CloudID] = node.cloudID;
 		dict[Index_Nodes_Column_DirPrefix] = node.dirPrefix;
 		dict[Index_Nodes_Column_PointeeID] = node.pointeeID;
+		
+		// Trunk nodes are excluded, so that "all nodes of user" queries don't have to filter them out.
+		if (![node isKindOfClass:[ZDCTrunkNode class]]) {
+			dict[Index_Nodes_Column_LocalUserID] = node.localUserID;
+		}
 	}];
 	
-	NSString *const versionTag = @"2019-07-17"; // <-- change me if you modify handler block
+	NSString *const versionTag = @"2026-10-19"; // <-- change me if you modify handler block
 	
 	NSSet *whitelist = [NSSet setWithObject:kZDCCollection_Nodes];
 	
@@ -1082,6 +1111,34 @@ NSString *const Index_Users_Column_RandomUUID = @"random_uuid";
 	}];
 }
 
+- (void)setupHooks_NodeAggregates
+{
+	ZDCLogAutoTrace();
+	
+	//
+	// HOOKS - NODE AGGREGATES
+	//
+	// Maintains per-node subtree sums (descendant count, data size, pending uploads).
+	// When a node is inserted/modified/moved/deleted, the difference is applied to each of its ancestors.
+	//
+	// Note:
+	// This extension reads from Ext_View_Treesystem_Name (to find children that were inserted before their parent).
+	// So it must be registered after that view.
+	
+	YapDatabaseHooks *ext = [ZDCNodeAggregator hooksExtension];
+	
+	NSString *const extName = Ext_Hooks_NodeAggregates;
+	[database asyncRegisterExtension:ext
+	                        withName:extName
+	                 completionQueue:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0)
+	                 completionBlock:^(BOOL ready)
+	{
+		if (!ready) {
+			ZDCLogError(@"Error registering \"%@\" !!!", extName);
+		}
+	}];
+}
+
 - (void)setupCloudExtensions
 {
 	ZDCLogAutoTrace();
@@ -1203,6 +1260,15 @@ NSString *const Index_Users_Column_RandomUUID = @"random_uuid";
 	// The actionManager was inititalized in a suspended state.
 	//
 	[actionManager resume];
+	
+	// The node aggregates are maintained incrementally.
+	// But they need to be calculated from scratch once (e.g. after upgrading from an older version).
+	//
+	YapDatabaseConnection *rwConnection = rwDatabaseConnection;
+	[rwConnection asyncReadWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		[ZDCNodeAggregator rebuildIfNeeded:transaction];
+	}];
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -32,6 +32,32 @@ extern NSString *const ZDCDiskManagerChangedNotification;
  */
 extern NSString *const kZDCDiskManagerChanges;
 
+/**
+ * The policy used to decide which items to delete, once a "storage pool" exceeds its max size.
+ */
+typedef NS_ENUM(NSInteger, ZDCDiskCachePolicy) {
+	/**
+	 * The least recently accessed item is deleted.
+	 *
+	 * This works well when recently accessed items are likely to be accessed again.
+	 * However, a burst of one-off items (e.g. scrolling through a large photo library)
+	 * can flush out the items the user accesses most often.
+	 */
+	ZDCDiskCachePolicy_LRU = 0,
+	
+	/**
+	 * Window TinyLFU.
+	 *
+	 * New items are placed in a small "window", which is managed by recency.
+	 * When an item falls out of the window, it's only admitted into the rest of the pool if it has been
+	 * accessed more often (recently) than the item that would need to be deleted to make room for it.
+	 * Access frequencies are tracked in a compact sketch (a few KiB), which periodically ages.
+	 *
+	 * This keeps frequently accessed items in the pool, even in the face of large scans.
+	 */
+	ZDCDiskCachePolicy_TinyLFU = 1,
+};
+
 /**
  * The DiskManager simplifies the process of persisting & caching files to disk.
  *
@@ -115,6 +141,33 @@ extern NSString *const kZDCDiskManagerChanges;
  */
 @property (atomic, readwrite, assign) uint64_t maxUserAvatarsCacheSize;
 
+/**
+ * Allows you to configure the policy used to trim the "storage pool" for cached (non-persistent) nodeData files.
+ *
+ * The default value is ZDCDiskCachePolicy_TinyLFU.
+ *
+ * @note Any value you configure is persisted to disk, and thus remains set between app launches.
+ */
+@property (atomic, readwrite, assign) ZDCDiskCachePolicy nodeDataCachePolicy;
+
+/**
+ * Allows you to configure the policy used to trim the "storage pool" for cached (non-persistent) nodeThumbnail files.
+ *
+ * The default value is ZDCDiskCachePolicy_LRU.
+ *
+ * @note Any value you configure is persisted to disk, and thus remains set between app launches.
+ */
+@property (atomic, readwrite, assign) ZDCDiskCachePolicy nodeThumbnailsCachePolicy;
+
+/**
+ * Allows you to configure the policy used to trim the "storage pool" for cached (non-persistent) userAvatar files.
+ *
+ * The default value is ZDCDiskCachePolicy_LRU.
+ *
+ * @note Any value you configure is persisted to disk, and thus remains set between app launches.
+ */
+@property (atomic, readwrite, assign) ZDCDiskCachePolicy userAvatarsCachePolicy;
+
 /**
  * Allows you to configure a default expiration interval for cached (non-persistent) nodeData files,
  * after which time the DiskManager will automatically delete the cached file from disk.
@@ -585,9 +638,13 @@ extern NSString *const kZDCDiskManagerChanges;
  * Returns the total size (summation) of all nodeData files on disk
  * (in directories being managed by the DiskManager).
  *
- * @note This method involves asking the OS filesystem for file sizes.
- *       It's normally quite fast, however this does involve disk IO.
- *       So you may prefer to invoke this method on a background thread.
+ * @note The DiskManager maintains running totals as files are imported, migrated & deleted.
+ *       So this method is fast: it doesn't involve any disk IO, and doesn't wait on the DiskManager's internal queue.
+ *       (Immediately after launch, the total may be incomplete until the initial directory scan finishes.)
+ *
+ * @note When `deduplicate` is enabled, identical content is stored on disk once, and shared by several nodes.
+ *       The total still includes the (logical) size once per referencing node,
+ *       so it may be larger than the number of bytes actually on disk.
  */
 - (uint64_t)storageSizeForAllNodeData;
 
@@ -595,9 +652,9 @@ extern NSString *const kZDCDiskManagerChanges;
  * Returns the total size (summation) of all persistent nodeData files on disk
  * (in directories being managed by the DiskManager).
  *
- * @note This method involves asking the OS filesystem for file sizes.
- *       It's normally quite fast, however this does involve disk IO.
- *       So you may prefer to invoke this method on a background thread.
+ * @note The DiskManager maintains running totals as files are imported, migrated & deleted.
+ *       So this method is fast: it doesn't involve any disk IO, and doesn't wait on the DiskManager's internal queue.
+ *       (Immediately after launch, the total may be incomplete until the initial directory scan finishes.)
  */
 - (uint64_t)storageSizeForPersistentNodeData;
 
@@ -605,14 +662,18 @@ extern NSString *const kZDCDiskManagerChanges;
  * Returns the total size (summation) of all cached (non-persistent) nodeData files on disk
  * (in directories being managed by the DiskManager).
  *
- * @note This method involves asking the OS filesystem for file sizes.
- *       It's normally quite fast, however this does involve disk IO.
- *       So you may prefer to invoke this method on a background thread.
+ * @note The DiskManager maintains running totals as files are imported, migrated & deleted.
+ *       So this method is fast: it doesn't involve any disk IO, and doesn't wait on the DiskManager's internal queue.
+ *       (Immediately after launch, the total may be incomplete until the initial directory scan finishes.)
  *
  * @note The current size may temporarily exceed the configured max size
  *       if a file is queued for deletion, but is currently being used
  *       by the app. (e.g. A ZDCCryptoFile.retainToken is keeping the file
  *       from being immediately deleted.)
+ *
+ * @note When `deduplicate` is enabled, identical content is stored on disk once, and shared by several nodes.
+ *       The total still includes the (logical) size once per referencing node,
+ *       so it may be larger than the number of bytes actually on disk.
  */
 - (uint64_t)storageSizeForCachedNodeData;
 
@@ -620,9 +681,13 @@ extern NSString *const kZDCDiskManagerChanges;
  * Returns the total size (summation) of all nodeThumbnail files on disk
  * (in directories being managed by the DiskManager).
  *
- * @note This method involves asking the OS filesystem for file sizes.
- *       It's normally quite fast, however this does involve disk IO.
- *       So you may prefer to invoke this method on a background thread.
+ * @note The DiskManager maintains running totals as files are imported, migrated & deleted.
+ *       So this method is fast: it doesn't involve any disk IO, and doesn't wait on the DiskManager's internal queue.
+ *       (Immediately after launch, the total may be incomplete until the initial directory scan finishes.)
+ *
+ * @note When `deduplicate` is enabled, identical content is stored on disk once, and shared by several nodes.
+ *       The total still includes the (logical) size once per referencing node,
+ *       so it may be larger than the number of bytes actually on disk.
  */
 - (uint64_t)storageSizeForAllNodeThumbnails;
 
@@ -630,9 +695,9 @@ extern NSString *const kZDCDiskManagerChanges;
  * Returns the total size (summation) of all persistent nodeThumbnail files on disk
  * (in directories being managed by the DiskManager).
  *
- * @note This method involves asking the OS filesystem for file sizes.
- *       It's normally quite fast, however this does involve disk IO.
- *       So you may prefer to invoke this method on a background thread.
+ * @note The DiskManager maintains running totals as files are imported, migrated & deleted.
+ *       So this method is fast: it doesn't involve any disk IO, and doesn't wait on the DiskManager's internal queue.
+ *       (Immediately after launch, the total may be incomplete until the initial directory scan finishes.)
  */
 - (uint64_t)storageSizeForPersistentNodeThumbnail;
 
@@ -640,14 +705,18 @@ extern NSString *const kZDCDiskManagerChanges;
  * Returns the total size (summation) of all cached (non-persistent) nodeThumbnail files on disk
  * (in directories being managed by the DiskManager).
  *
- * @note This method involves asking the OS filesystem for file sizes.
- *       It's normally quite fast, however this does involve disk IO.
- *       So you may prefer to invoke this method on a background thread.
+ * @note The DiskManager maintains running totals as files are imported, migrated & deleted.
+ *       So this method is fast: it doesn't involve any disk IO, and doesn't wait on the DiskManager's internal queue.
+ *       (Immediately after launch, the total may be incomplete until the initial directory scan finishes.)
  *
  * @note The current size may temporarily exceed the configured max size
  *       if a file is queued for deletion, but is currently being used
  *       by the app. (e.g. A ZDCCryptoFile.retainToken is keeping the file
  *       from being immediately deleted.)
+ *
+ * @note When `deduplicate` is enabled, identical content is stored on disk once, and shared by several nodes.
+ *       The total still includes the (logical) size once per referencing node,
+ *       so it may be larger than the number of bytes actually on disk.
  */
 - (uint64_t)storageSizeForCachedNodeThumbnails;
 
@@ -655,9 +724,9 @@ extern NSString *const kZDCDiskManagerChanges;
  * Returns the total size (summation) of all userAvatar files on disk
  * (in directories being managed by the DiskManager).
  *
- * @note This method involves asking the OS filesystem for file sizes.
- *       It's normally quite fast, however this does involve disk IO.
- *       So you may prefer to invoke this method on a background thread.
+ * @note The DiskManager maintains running totals as files are imported, migrated & deleted.
+ *       So this method is fast: it doesn't involve any disk IO, and doesn't wait on the DiskManager's internal queue.
+ *       (Immediately after launch, the total may be incomplete until the initial directory scan finishes.)
  */
 - (uint64_t)storageSizeForAllUserAvatars;
 
@@ -665,9 +734,9 @@ extern NSString *const kZDCDiskManagerChanges;
  * Returns the total size (summation) of all persistent userAvatar files on disk
  * (in directories being managed by the DiskManager).
  *
- * @note This method involves asking the OS filesystem for file sizes.
- *       It's normally quite fast, however this does involve disk IO.
- *       So you may prefer to invoke this method on a background thread.
+ * @note The DiskManager maintains running totals as files are imported, migrated & deleted.
+ *       So this method is fast: it doesn't involve any disk IO, and doesn't wait on the DiskManager's internal queue.
+ *       (Immediately after launch, the total may be incomplete until the initial directory scan finishes.)
  */
 - (uint64_t)storageSizeForPersistentUserAvatars;
 
@@ -675,9 +744,9 @@ extern NSString *const kZDCDiskManagerChanges;
  * Returns the total size (summation) of all cached (non-persistent) userAvatar files on disk
  * (in directories being managed by the DiskManager).
  *
- * @note This method involves asking the OS filesystem for file sizes.
- *       It's normally quite fast, however this does involve disk IO.
- *       So you may prefer to invoke this method on a background thread.
+ * @note The DiskManager maintains running totals as files are imported, migrated & deleted.
+ *       So this method is fast: it doesn't involve any disk IO, and doesn't wait on the DiskManager's internal queue.
+ *       (Immediately after launch, the total may be incomplete until the initial directory scan finishes.)
  *
  * @note The current size may temporarily exceed the configured max size
  *       if a file is queued for deletion, but is currently being used
@@ -829,6 +898,29 @@ extern NSString *const kZDCDiskManagerChanges;
  */
 @property (nonatomic, assign, readwrite) NSTimeInterval expiration;
 
+/**
+ * If set to true, the DiskManager stores a single encrypted copy of identical content.
+ *
+ * This is useful when the same cleartext is cached under several nodes.
+ * For example, a node that was copied, or a message that was sent to multiple recipients.
+ * Rather than encrypting & storing a separate copy for each node,
+ * the DiskManager computes a (keyed) digest of the cleartext, and each node references the shared copy.
+ * If the content is already cached, the import skips the encryption step entirely.
+ *
+ * The shared copy is deleted once every node referencing it has been deleted (or evicted from the cache).
+ * Each reference still counts its full size against the cache pool.
+ *
+ * This flag only applies to `importNodeData:` & `importNodeThumbnail:`,
+ * when importing cleartext (`cleartextData` or `cleartextFileURL`) in cache mode (storePersistently == false).
+ * It's ignored otherwise.
+ *
+ * @note The CryptoFile returned from the import (and from subsequent exports) may use a different
+ *       encryptionKey than the node. So always use `cryptoFile.encryptionKey` to read the file.
+ *
+ * The default value is NO/false.
+ */
+@property (nonatomic, assign, readwrite) BOOL deduplicate;
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
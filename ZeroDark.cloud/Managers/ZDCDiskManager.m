@@ -9,23 +9,34 @@
 
 #import "ZDCDiskManagerPrivate.h"
 
+#import "ZDCDiskBlobStore.h"
+#import "ZDCDiskSlabStore.h"
+#import "ZDCFrequencySketch.h"
 #import "ZDCLogging.h"
 #import "ZDCUserPrivate.h"
+#import "ZeroDarkCloudPrivate.h"
 
 // Categories
 #import "NSData+S4.h"
 #import "NSData+ZeroDark.h"
 #import "NSDate+ZeroDark.h"
+#import "NSError+S4.h"
 #import "NSError+ZeroDark.h"
 
 // Libraries
+#import <fcntl.h>
+#import <libkern/OSByteOrder.h>
+#import <stdatomic.h>
 #import <sys/xattr.h>
+#import <unistd.h>
 #import <YapDatabase/YapCollectionKey.h>
 #import <YapDatabase/YapDatabaseAtomic.h>
 #import <YapDatabase/YapSet.h>
 
 @class ZDCFileInfo;
+@class ZDCFileInfoLRU;
 @class ZDCFileRetainToken;
+@class ZDCStorageCounter;
 
 // Log Levels: off, error, warn, info, verbose
 // Log Flags : trace
@@ -57,21 +68,47 @@ static NSString *const kSubDirectoryName_UserAvatars    = @"userAvatars";
 
 static NSString *const kSubDirectoryName_CacheFile = @"cachefile";
 static NSString *const kSubDirectoryName_Cloudfile = @"cloudfile";
+static NSString *const kSubDirectoryName_Slabs     = @".slabs"; // hidden, so directory scans skip it
+static NSString *const kSubDirectoryName_Blobs     = @".blobs"; // hidden, so directory scans skip it
 
 static NSString *const kXattrName_maxCacheSize       = @"ZeroDark.cloud:maxCacheSize";
+static NSString *const kXattrName_cachePolicy        = @"ZeroDark.cloud:cachePolicy";
 static NSString *const kXattrName_migrateAfterUpload = @"ZeroDark.cloud:migrate";
 static NSString *const kXattrName_deleteAfterUpload  = @"ZeroDark.cloud:delete";
 static NSString *const kXattrName_expiration         = @"ZeroDark.cloud:expiration";
 static NSString *const kXattrName_eTag               = @"ZeroDark.cloud:eTag"; // xattr value is encrypted
+static NSString *const kXattrName_contentDigest      = @"ZeroDark.cloud:contentDigest";
 
 static NSUInteger const kDefaultConfiguration_maxNodeDataCacheSize       = (1024 * 1024 * 25); // 25 MiB
 static NSUInteger const kDefaultConfiguration_maxNodeThumbnailsCacheSize = (1024 * 1024 * 5);  //  5 MiB
 static NSUInteger const kDefaultConfiguration_maxUserAvatarsCacheSize    = (1024 * 1024 * 5);  //  5 MiB
 
+static ZDCDiskCachePolicy const kDefaultConfiguration_nodeDataCachePolicy       = ZDCDiskCachePolicy_TinyLFU;
+static ZDCDiskCachePolicy const kDefaultConfiguration_nodeThumbnailsCachePolicy = ZDCDiskCachePolicy_LRU;
+static ZDCDiskCachePolicy const kDefaultConfiguration_userAvatarsCachePolicy    = ZDCDiskCachePolicy_LRU;
+
 static NSTimeInterval const kDefaultConfiguration_nodeDataExpiration      = 0;
 static NSTimeInterval const kDefaultConfiguration_nodeThumbnailExpiration = 0;
 static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60 * 60 * 24 * 7);
 
+static NSTimeInterval const kStorageReconciliationInterval = (60 * 60 * 24);
+
+static NSString *const kJournalFilename = @"DiskManager.journal";
+static NSUInteger const kJournalCompactionThreshold = 10000; // minimum number of appended records
+
+static NSTimeInterval const kSlabCompactionDelay = 5.0; // in seconds
+
+static NSUInteger const kDedupeSecretSizeInBytes = (256 / 8);
+static NSUInteger const kContentDigestChunkSize  = (1024 * 64); // 64 KiB
+
+/**
+ * The portion of a TinyLFU cache pool reserved for the window (i.e. newly added items).
+ * Caches of small in-memory objects typically use 1%.
+ * But our items are few & large, so we use a bigger window to give new items a chance to be re-accessed.
+ */
+static double const kTinyLFUWindowFraction = 0.10;
+static NSUInteger const kFrequencySketchMinCapacity = 512;
+
 @interface ZDCDiskManager () <NSFileManagerDelegate>
 
 - (void)decrementRetainCountForInfo:(ZDCFileInfo *)info;
@@ -108,7 +145,33 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 #pragma mark -
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-@interface ZDCFileInfo : NSObject
+@interface ZDCFileInfo : NSObject {
+@public
+
+	// Intrusive linkage for ZDCFileInfoLRU.
+	// These are only modified by the list the info is registered with.
+	//
+	__unsafe_unretained ZDCFileInfo *lruPrev;
+	ZDCFileInfo *lruNext;
+	BOOL lruLinked;
+	
+	// The (mode, type, format) counter the info is tallied in.
+	// Set by the DiskManager when the info is added to one of its dicts.
+	//
+	ZDCStorageCounter *storageCounter;
+	
+	// Intrusive linkage for ZDCExpirationHeap.
+	// These are only modified by the heap the info is registered with.
+	//
+	NSUInteger heapIndex; // NSNotFound if not in a heap
+	NSTimeInterval heapDeadline;
+	
+	// Set by the journal reader.
+	// The DiskManager resolves the slabEntry & blob (if the item still exists) when restoring from the journal.
+	//
+	BOOL journaledAsPacked;
+	NSString *journaledBlobName;
+}
 
 - (instancetype)initWithMode:(ZDCStorageMode)mode
                         type:(ZDCFileType)type
@@ -131,13 +194,47 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 @property (nonatomic, assign, readwrite) BOOL migrateAfterUpload;
 @property (nonatomic, assign, readwrite) BOOL deleteAfterUpload;
 @property (nonatomic, assign, readwrite) NSTimeInterval expiration;
-@property (nonatomic, copy, readwrite) id eTag; // NSString | NSNull
+@property (nonatomic, copy, readwrite) id eTag; // NSString | NSNull (nil => not yet decrypted)
+@property (nonatomic, copy, readwrite) id encryptedETag; // NSData | NSNull (nil => xattr not yet read)
 
 @property (nonatomic, assign, readonly) NSUInteger fileRetainCount;
 @property (nonatomic, assign, readwrite) BOOL pendingDelete;
 
+/**
+ * Non-nil if the file is packed into a slab (rather than stored at fileURL).
+ * The fileURL is still set, as its lastPathComponent is the item's key.
+ */
+@property (nonatomic, strong, readwrite, nullable) ZDCDiskSlabEntry *slabEntry;
+
+/**
+ * Non-nil if the item is deduplicated (i.e. it references a shared blob, rather than being stored at fileURL).
+ * The fileURL is still set, as its lastPathComponent is the item's key.
+ */
+@property (nonatomic, strong, readwrite, nullable) ZDCDiskBlob *blob;
+
+/**
+ * Non-nil if the file was encrypted with a key derived from its content digest (rather than the node's key).
+ * This is the case for deduplicated items, as well as files copied out of a blob (e.g. made persistent).
+ */
+@property (nonatomic, copy, readwrite, nullable) NSString *contentDigest;
+
+/**
+ * NO if the item is packed into a slab, or references a blob.
+ * Such items don't have a file (or xattrs) at fileURL, so directory scans leave them alone.
+ */
+@property (nonatomic, readonly) BOOL isStoredInDirectory;
+
 @property (nonatomic, readonly) BOOL isStoredPersistently;
 
+/**
+ * The cache pool (if any) the info is registered with.
+ * Only items with ZDCStorageMode_Cache are registered.
+ */
+@property (nonatomic, weak, readonly) ZDCFileInfoLRU *lru;
+
+// Invoked by ZDCFileInfoLRU
+- (void)_setLRU:(nullable ZDCFileInfoLRU *)list;
+
 - (NSUInteger)decrementFileRetainCount;
 - (NSUInteger)incrementFileRetainCount;
 
@@ -151,12 +248,140 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
          identityID:(NSString *)identityID;
 
 /**
- * Similar to a copy, but does NOT include fileRetainCount or pendingDelete.
+ * Similar to a copy, but does NOT include fileRetainCount, pendingDelete, slabEntry or blob.
  */
 - (instancetype)duplicateWithMode:(ZDCStorageMode)mode fileURL:(NSURL *)fileURL;
 
 @end
 
+/**
+ * Running totals for the files within a single (mode, type, format) directory.
+ *
+ * Like ZDCFileInfo, instances are only modified from within ZDCDiskManager.cacheQueue.
+ * But the totalSize is atomic, so the storageSize methods can read it from any thread,
+ * without having to wait for the cacheQueue (which may be busy deleting files, or writing to the journal).
+ */
+@interface ZDCStorageCounter : NSObject {
+@public
+
+	atomic_uint_least64_t totalSize;
+	NSUInteger fileCount;
+}
+@end
+
+@implementation ZDCStorageCounter
+
+- (instancetype)init
+{
+	if ((self = [super init]))
+	{
+		atomic_init(&totalSize, 0);
+	}
+	return self;
+}
+
+@end
+
+/**
+ * An intrusive doubly-linked list of ZDCFileInfo items (within the cache pool of a single ZDCFileType).
+ * Items are ordered from least recently accessed (head) to most recently accessed (tail),
+ * and the list maintains a running total of their file sizes.
+ *
+ * This allows us to trim the cache pool without enumerating (or sorting) every item.
+ * Adding, touching, removing & evicting are all O(1).
+ *
+ * Items marked as pendingDelete remain registered with the list, but they're unlinked (and not counted),
+ * since they're already on their way out.
+ *
+ * Like ZDCFileInfo, instances are only accessed/modified from within ZDCDiskManager.cacheQueue.
+ */
+@interface ZDCFileInfoLRU : NSObject
+
+/** The sum of info.fileSize for every linked item. */
+@property (nonatomic, readonly) uint64_t totalSize;
+
+/** The number of linked items. */
+@property (nonatomic, readonly) NSUInteger count;
+
+/** The least recently accessed item (i.e. the next item to evict). */
+@property (nonatomic, readonly, nullable) ZDCFileInfo *leastRecent;
+
+/**
+ * Registers the item with the list, and links it as the most recently accessed item.
+ */
+- (void)addInfo:(ZDCFileInfo *)info;
+
+/**
+ * Registers the given items with the list, inserting each according to its lastAccessed date.
+ * The given items MUST be sorted by lastAccessed (ascending), and MUST NOT already be registered.
+ *
+ * This is O(n + k), and is used after scanning the filesystem.
+ */
+- (void)mergeInfos:(NSArray<ZDCFileInfo *> *)infos;
+
+/**
+ * Unregisters the item from the list. (Does nothing if the item isn't registered with this list.)
+ */
+- (void)removeInfo:(ZDCFileInfo *)info;
+
+/**
+ * Moves the item to the most recently accessed end of the list.
+ */
+- (void)touchInfo:(ZDCFileInfo *)info;
+
+// Invoked by ZDCFileInfo
+- (void)_linkInfo:(ZDCFileInfo *)info before:(nullable ZDCFileInfo *)successor;
+- (void)_unlinkInfo:(ZDCFileInfo *)info;
+- (void)_replaceFileSize:(uint64_t)oldFileSize withFileSize:(uint64_t)newFileSize;
+
+@end
+
+/**
+ * A binary min-heap of ZDCFileInfo items (within the cache pool of a single ZDCFileType),
+ * ordered by expiration date.
+ *
+ * This allows us to arm the expiration timer by peeking at the top of the heap,
+ * and to delete the k expired items in O(k log n), without enumerating every item.
+ *
+ * An item's expiration date is (info.lastModified + info.expiration),
+ * or (info.lastModified + defaultExpiration) if the item doesn't specify its own expiration.
+ * Items without an expiration (and items stored persistently) aren't in the heap.
+ *
+ * Like ZDCFileInfo, instances are only accessed/modified from within ZDCDiskManager.cacheQueue.
+ */
+@interface ZDCExpirationHeap : NSObject
+
+/**
+ * The configured default expiration for the ZDCFileType.
+ * After changing this, every item must be updated (via updateInfo:).
+ */
+@property (nonatomic, assign, readwrite) NSTimeInterval defaultExpiration;
+
+/** The number of items in the heap. */
+@property (nonatomic, readonly) NSUInteger count;
+
+/** The expiration date of the item at the top of the heap, or nil if the heap is empty. */
+@property (nonatomic, readonly, nullable) NSDate *nextExpirationDate;
+
+/**
+ * Inserts, repositions or removes the item, according to its current mode, lastModified & expiration.
+ * Must be invoked after any of these values are changed.
+ */
+- (void)updateInfo:(ZDCFileInfo *)info;
+
+/**
+ * Removes the item from the heap. (Does nothing if the item isn't in the heap.)
+ */
+- (void)removeInfo:(ZDCFileInfo *)info;
+
+/**
+ * Removes & returns the item at the top of the heap, if it expires at or before the given date.
+ * Otherwise returns nil.
+ */
+- (nullable ZDCFileInfo *)popInfoExpiredAsOf:(NSDate *)date;
+
+@end
+
 @implementation ZDCFileInfo
 
 @synthesize mode = mode;
@@ -176,10 +401,17 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 @synthesize deleteAfterUpload = deleteAfterUpload;
 @synthesize expiration = expiration;
 @synthesize eTag = eTag;
+@synthesize encryptedETag = encryptedETag;
 
 @synthesize fileRetainCount = fileRetainCount;
-@synthesize pendingDelete;
+@synthesize pendingDelete = pendingDelete;
+@synthesize slabEntry = slabEntry;
+@synthesize blob = blob;
+@synthesize contentDigest = contentDigest;
 
+@synthesize lru = lru;
+
+@dynamic isStoredInDirectory;
 @dynamic isStoredPersistently;
 
 - (instancetype)initWithMode:(ZDCStorageMode)inMode
@@ -193,10 +425,17 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 		type = inType;
 		format = inFrmt;
 		fileURL = inURL;
+		
+		heapIndex = NSNotFound;
 	}
 	return self;
 }
 
+- (BOOL)isStoredInDirectory
+{
+	return (slabEntry == nil) && (blob == nil);
+}
+
 - (BOOL)isStoredPersistently
 {
 	if (pendingDelete) return NO;
@@ -204,6 +443,41 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 	return (mode == ZDCStorageMode_Persistent);
 }
 
+- (void)setFileSize:(uint64_t)newFileSize
+{
+	if (lruLinked) {
+		[lru _replaceFileSize:fileSize withFileSize:newFileSize];
+	}
+	if (storageCounter) {
+		storageCounter->totalSize -= MIN(storageCounter->totalSize, fileSize);
+		storageCounter->totalSize += newFileSize;
+	}
+	fileSize = newFileSize;
+}
+
+- (void)setPendingDelete:(BOOL)flag
+{
+	if (pendingDelete == flag) return;
+	pendingDelete = flag;
+	
+	// An item that's pendingDelete no longer counts against the cache pool.
+	// And if it's rescued (e.g. moved back into the cache), we treat it as freshly accessed.
+	
+	ZDCFileInfoLRU *list = lru;
+	if (list)
+	{
+		if (pendingDelete)
+			[list _unlinkInfo:self];
+		else if (!lruLinked)
+			[list _linkInfo:self before:nil];
+	}
+}
+
+- (void)_setLRU:(ZDCFileInfoLRU *)list
+{
+	lru = list;
+}
+
 - (NSUInteger)decrementFileRetainCount
 {
 	// We don't need locks here because ZDCFileInfo instances are
@@ -280,6 +554,8 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 	dup->deleteAfterUpload = self->deleteAfterUpload;
 	dup->expiration = self->expiration;
 	dup->eTag = self->eTag;
+	dup->encryptedETag = self->encryptedETag;
+	dup->contentDigest = self->contentDigest;
 	
 	return dup;
 }
@@ -290,1354 +566,3484 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 #pragma mark -
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-@interface ZDCFileRetainToken : NSObject
+@implementation ZDCFileInfoLRU
+{
+	ZDCFileInfo *head; // least recently accessed
+	__unsafe_unretained ZDCFileInfo *tail; // most recently accessed
+}
 
-- (instancetype)initWithInfo:(ZDCFileInfo *)info owner:(ZDCDiskManager *)owner;
+@synthesize totalSize = totalSize;
+@synthesize count = count;
 
-@end
+- (void)dealloc
+{
+	// Break the chain iteratively.
+	// Otherwise releasing the head would recursively release every item in the list.
+	
+	ZDCFileInfo *info = head;
+	head = nil;
+	
+	while (info)
+	{
+		ZDCFileInfo *next = info->lruNext;
+		info->lruNext = nil;
+		info = next;
+	}
+}
 
-@implementation ZDCFileRetainToken
+- (ZDCFileInfo *)leastRecent
 {
-	__strong ZDCFileInfo *info;
-	__weak ZDCDiskManager *owner;
+	return head;
 }
 
-- (instancetype)initWithInfo:(ZDCFileInfo *)inInfo owner:(ZDCDiskManager *)inOwner
+- (void)addInfo:(ZDCFileInfo *)info
 {
-	if ((self = [super init]))
-	{
-		info = inInfo;
-		owner = inOwner;
+	if (info.lru == self) {
+		[self touchInfo:info];
+		return;
+	}
+	
+	[info.lru removeInfo:info];
+	[info _setLRU:self];
+	
+	if (!info.pendingDelete) {
+		[self _linkInfo:info before:nil];
 	}
-	return self;
 }
 
-- (void)dealloc
+- (void)mergeInfos:(NSArray<ZDCFileInfo *> *)infos
 {
-	[owner decrementRetainCountForInfo:info];
+	ZDCFileInfo *cursor = head;
+	
+	for (ZDCFileInfo *info in infos)
+	{
+		NSAssert(info.lru == nil, @"Info is already registered with a list");
+		
+		[info _setLRU:self];
+		if (info.pendingDelete) continue;
+		
+		while (cursor && ([cursor.lastAccessed compare:info.lastAccessed] != NSOrderedDescending))
+		{
+			cursor = cursor->lruNext;
+		}
+		
+		[self _linkInfo:info before:cursor];
+	}
 }
 
-@end
+- (void)removeInfo:(ZDCFileInfo *)info
+{
+	if (info.lru != self) return;
+	
+	[self _unlinkInfo:info];
+	[info _setLRU:nil];
+}
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark -
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+- (void)touchInfo:(ZDCFileInfo *)info
+{
+	if (info.lru != self) return;
+	if (!info->lruLinked || (info == tail)) return;
+	
+	[self _unlinkInfo:info];
+	[self _linkInfo:info before:nil];
+}
 
-@implementation ZDCDiskManager
+- (void)_linkInfo:(ZDCFileInfo *)info before:(ZDCFileInfo *)successor
 {
-	__weak ZeroDarkCloud *zdc;
+	if (info->lruLinked) return;
 	
-	dispatch_queue_t cacheQueue;
-	void *IsOnCacheQueueKey;
+	if (successor)
+	{
+		ZDCFileInfo *predecessor = successor->lruPrev;
+		
+		info->lruPrev = predecessor;
+		info->lruNext = successor;
+		successor->lruPrev = info;
+		
+		if (predecessor)
+			predecessor->lruNext = info;
+		else
+			head = info;
+	}
+	else
+	{
+		info->lruPrev = tail;
+		info->lruNext = nil;
+		
+		if (tail)
+			tail->lruNext = info;
+		else
+			head = info;
+		
+		tail = info;
+	}
 	
-	dispatch_queue_t refreshQueue;
-	void *IsOnRefreshQueueKey;
+	info->lruLinked = YES;
+	totalSize += info.fileSize;
+	count++;
+}
+
+- (void)_unlinkInfo:(ZDCFileInfo *)info
+{
+	if (!info->lruLinked) return;
 	
-	NSFileManager *fileManager;
+	// Careful: the predecessor (or head) may hold the only strong reference to the info.
+	ZDCFileInfo *retainedInfo = info;
 	
-	NSURL *persistentContainerURL;
-	NSURL *cacheContainerURL;
+	ZDCFileInfo *predecessor = retainedInfo->lruPrev;
+	ZDCFileInfo *successor = retainedInfo->lruNext;
 	
-	NSMutableArray<ZDCFilesystemMonitor*> *monitors;
+	if (predecessor)
+		predecessor->lruNext = successor;
+	else
+		head = successor;
 	
-	// The following variables can only be read/modified within cacheQueue:
+	if (successor)
+		successor->lruPrev = predecessor;
+	else
+		tail = predecessor;
 	
-	NSMutableDictionary<NSString *, NSMutableArray<ZDCFileInfo *> *> *dict_nodeData;       // key: nodeID
-	NSMutableDictionary<NSString *, NSMutableArray<ZDCFileInfo *> *> *dict_nodeThumbnails; // key: nodeID
-	NSMutableDictionary<NSString *, NSMutableArray<ZDCFileInfo *> *> *dict_userAvatars;    // key: userID
+	retainedInfo->lruPrev = nil;
+	retainedInfo->lruNext = nil;
+	retainedInfo->lruLinked = NO;
 	
-	NSMutableSet<NSString*> *changes_nodeData;       // nodeID's
-	NSMutableSet<NSString*> *changes_nodeThumbnails; // nodeID's
-	NSMutableSet<NSString*> *changes_userAvatars;    // userID's
+	totalSize -= MIN(totalSize, retainedInfo.fileSize);
+	count--;
+}
+
+- (void)_replaceFileSize:(uint64_t)oldFileSize withFileSize:(uint64_t)newFileSize
+{
+	totalSize -= MIN(totalSize, oldFileSize);
+	totalSize += newFileSize;
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation ZDCExpirationHeap {
+
+	NSMutableArray<ZDCFileInfo *> *heap;
+}
+
+@synthesize defaultExpiration = defaultExpiration;
+
+- (instancetype)init
+{
+	if ((self = [super init]))
+	{
+		heap = [[NSMutableArray alloc] init];
+	}
+	return self;
+}
+
+- (NSUInteger)count
+{
+	return heap.count;
+}
+
+- (NSDate *)nextExpirationDate
+{
+	if (heap.count == 0) return nil;
 	
-	NSSet<NSString*> *uploadQueue_nodeIDs;
+	return [NSDate dateWithTimeIntervalSinceReferenceDate:heap[0]->heapDeadline];
+}
+
+- (BOOL)getDeadline:(NSTimeInterval *)outDeadline forInfo:(ZDCFileInfo *)info
+{
+	if (info.mode != ZDCStorageMode_Cache) return NO;
 	
-	BOOL notificationPending;
+	NSTimeInterval interval = info.expiration;
+	if (interval <= 0) {
+		interval = defaultExpiration;
+	}
+	if (interval <= 0) return NO;
 	
-	dispatch_source_t expirationTimer;
-	BOOL expirationTimerSuspended;
-	NSDate *nextExpirationDate;
-	NSDate *nextExpirationDate_nodeData;
-	NSDate *nextExpirationDate_nodeThumbnails;
-	NSDate *nextExpirationDate_userAvatars;
+	// An item without a lastModified date is treated as already expired.
+	NSDate *lastModified = info.lastModified;
+	*outDeadline = lastModified ? ([lastModified timeIntervalSinceReferenceDate] + interval) : -DBL_MAX;
 	
-	YAPUnfairLock spinlock;
-	NSMutableSet<NSURL*> *pendingRefresh;
+	return YES;
 }
 
-@dynamic maxNodeDataCacheSize;
-@dynamic maxNodeThumbnailsCacheSize;
-@dynamic maxUserAvatarsCacheSize;
-
-@dynamic defaultNodeDataCacheExpiration;
-@dynamic defaultNodeThumbnailCacheExpiration;
-@dynamic defaultUserAvatarCacheExpiration;
-
-- (instancetype)init
+- (BOOL)containsInfo:(ZDCFileInfo *)info
 {
-	return nil; // To access this class use: ZeroDarkCloud.diskManager
+	NSUInteger const index = info->heapIndex;
+	return (index < heap.count) && (heap[index] == info);
 }
 
-- (instancetype)initWithOwner:(ZeroDarkCloud *)inOwner
+- (void)updateInfo:(ZDCFileInfo *)info
 {
-	if ((self = [super init]))
+	NSTimeInterval deadline = 0;
+	if (![self getDeadline:&deadline forInfo:info])
 	{
-		zdc = inOwner;
+		[self removeInfo:info];
+		return;
+	}
+	
+	if ([self containsInfo:info])
+	{
+		NSTimeInterval const oldDeadline = info->heapDeadline;
+		if (deadline == oldDeadline) return;
 		
-		cacheQueue   = dispatch_queue_create("DiskManager_cache", DISPATCH_QUEUE_SERIAL);
-		refreshQueue = dispatch_queue_create("DiskManager_refresh", DISPATCH_QUEUE_SERIAL);
-		
-		IsOnCacheQueueKey = &IsOnCacheQueueKey;
-		dispatch_queue_set_specific(cacheQueue, IsOnCacheQueueKey, IsOnCacheQueueKey, NULL);
-		
-		IsOnRefreshQueueKey = &IsOnRefreshQueueKey;
-		dispatch_queue_set_specific(refreshQueue, IsOnRefreshQueueKey, IsOnRefreshQueueKey, NULL);
-		
-		fileManager = [[NSFileManager alloc] init];
-		fileManager.delegate = self;
-		
-		NSString *databaseName = [zdc.databasePath lastPathComponent];
-		persistentContainerURL = [ZDCDirectoryManager zdcPersistentDataDirectoryForDatabaseName:databaseName];
-		cacheContainerURL      = [ZDCDirectoryManager zdcCacheDataDirectoryForDatabaseName:databaseName];
-		
-		dict_nodeData       = [[NSMutableDictionary alloc] init];
-		dict_nodeThumbnails = [[NSMutableDictionary alloc] init];
-		dict_userAvatars    = [[NSMutableDictionary alloc] init];
-		
-		changes_nodeData       = [[NSMutableSet alloc] init];
-		changes_nodeThumbnails = [[NSMutableSet alloc] init];
-		changes_userAvatars    = [[NSMutableSet alloc] init];
-		
-		notificationPending = NO;
-		
-		spinlock = YAP_UNFAIR_LOCK_INIT;
-		pendingRefresh = [[NSMutableSet alloc] init];
-		
-	#if TARGET_OS_IPHONE && !TARGET_EXTENSION
-		[[NSNotificationCenter defaultCenter] addObserver: self
-		                                         selector: @selector(applicationWillEnterForeground:)
-		                                             name: UIApplicationWillEnterForegroundNotification
-		                                           object: [UIApplication sharedApplication]];
-	#endif
-		
-		[[NSNotificationCenter defaultCenter] addObserver: self
-		                                         selector: @selector(databaseModified:)
-		                                             name: YapDatabaseModifiedNotification
-		                                           object: zdc.databaseManager.database];
-		
-		[[NSNotificationCenter defaultCenter] addObserver: self
-		                                         selector: @selector(pipelineQueueChanged:)
-		                                             name: YDBCloudCorePipelineQueueChangedNotification
-		                                           object: nil];
+		info->heapDeadline = deadline;
 		
-		// Prepare directories,
-		// and populate cache with whatever we find on the file system.
+		if (deadline < oldDeadline)
+			[self siftUp:info->heapIndex];
+		else
+			[self siftDown:info->heapIndex];
+	}
+	else
+	{
+		info->heapDeadline = deadline;
+		info->heapIndex = heap.count;
+		[heap addObject:info];
 		
-		dispatch_async(cacheQueue, ^{ @autoreleasepool {
-			
-			NSArray<NSArray*> *list = @[
-				@[ @(ZDCStorageMode_Persistent), @(ZDCFileType_NodeData),      @(ZDCCryptoFileFormat_CacheFile) ],
-				@[ @(ZDCStorageMode_Persistent), @(ZDCFileType_NodeData),      @(ZDCCryptoFileFormat_CloudFile) ],
-				@[ @(ZDCStorageMode_Cache),      @(ZDCFileType_NodeData),      @(ZDCCryptoFileFormat_CacheFile) ],
-				@[ @(ZDCStorageMode_Cache),      @(ZDCFileType_NodeData),      @(ZDCCryptoFileFormat_CloudFile) ],
-				@[ @(ZDCStorageMode_Persistent), @(ZDCFileType_NodeThumbnail), @(ZDCCryptoFileFormat_CacheFile) ],
-				@[ @(ZDCStorageMode_Cache),      @(ZDCFileType_NodeThumbnail), @(ZDCCryptoFileFormat_CacheFile) ],
-				@[ @(ZDCStorageMode_Persistent), @(ZDCFileType_UserAvatar),    @(ZDCCryptoFileFormat_CacheFile) ],
-				@[ @(ZDCStorageMode_Cache),      @(ZDCFileType_UserAvatar),    @(ZDCCryptoFileFormat_CacheFile) ],
-			];
-			
-			[self createDirectories:list];
-			[self setupFilesystemMonitors:list];
-			
-			[self scanCacheDirectories];
-			[self scanOfflineDirectories];
-			
-			[self launchCleanup];
-		}});
+		[self siftUp:info->heapIndex];
 	}
-	return self;
 }
 
-- (void)dealloc
+- (void)removeInfo:(ZDCFileInfo *)info
 {
-	[monitors removeAllObjects];
+	if (![self containsInfo:info]) return;
 	
-	// Deallocating a suspended timer will cause a crash
-	if (expirationTimer && expirationTimerSuspended)
+	NSUInteger const index = info->heapIndex;
+	NSUInteger const lastIndex = heap.count - 1;
+	
+	if (index != lastIndex)
 	{
-		expirationTimerSuspended = NO;
-		dispatch_resume(expirationTimer);
+		ZDCFileInfo *last = heap[lastIndex];
+		heap[index] = last;
+		last->heapIndex = index;
+		[heap removeLastObject];
+		
+		// The moved item may belong either above or below its new position.
+		[self siftDown:index];
+		[self siftUp:last->heapIndex];
+	}
+	else
+	{
+		[heap removeLastObject];
 	}
 	
-	[[NSNotificationCenter defaultCenter] removeObserver:self];
+	info->heapIndex = NSNotFound;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark URL Utilities
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-- (NSURL *)URLForMode:(ZDCStorageMode)mode type:(ZDCFileType)type format:(ZDCCryptoFileFormat)format
+- (ZDCFileInfo *)popInfoExpiredAsOf:(NSDate *)date
 {
-	if (format == ZDCCryptoFileFormat_Unknown) {
+	if (heap.count == 0) return nil;
+	
+	ZDCFileInfo *top = heap[0];
+	if (top->heapDeadline > [date timeIntervalSinceReferenceDate]) {
 		return nil;
 	}
 	
-	switch (type)
+	[self removeInfo:top];
+	return top;
+}
+
+- (void)siftUp:(NSUInteger)index
+{
+	while (index > 0)
 	{
-		case ZDCFileType_NodeData:
-		{
-			NSURL *parent = (mode == ZDCStorageMode_Persistent) ? persistentContainerURL : cacheContainerURL;
-			NSURL *anchor = [parent URLByAppendingPathComponent:kSubDirectoryName_NodeData isDirectory:YES];
-			
-			NSString *subDirName = nil;
-			switch (format)
-			{
-				case ZDCCryptoFileFormat_CacheFile : subDirName = kSubDirectoryName_CacheFile; break;
-				case ZDCCryptoFileFormat_CloudFile : subDirName = kSubDirectoryName_Cloudfile; break;
-				default : break;
-			}
-			
-			return [anchor URLByAppendingPathComponent:subDirName isDirectory:YES];
-		}
-		case ZDCFileType_NodeThumbnail:
-		{
-			NSURL *parent = (mode == ZDCStorageMode_Persistent) ? persistentContainerURL : cacheContainerURL;
-			NSURL *anchor = [parent URLByAppendingPathComponent:kSubDirectoryName_NodeThumbnails isDirectory:YES];
-			
-			switch (format)
-			{
-				case ZDCCryptoFileFormat_CacheFile : return anchor;
-				default                            : return nil;
-			}
-		}
-		case ZDCFileType_UserAvatar:
-		{
-			NSURL *parent = (mode == ZDCStorageMode_Persistent) ? persistentContainerURL : cacheContainerURL;
-			NSURL *anchor = [parent URLByAppendingPathComponent:kSubDirectoryName_UserAvatars isDirectory:YES];
-			
-			switch (format)
-			{
-				case ZDCCryptoFileFormat_CacheFile : return anchor;
-				default                            : return nil;
-			}
+		NSUInteger const parentIndex = (index - 1) / 2;
+		if (heap[parentIndex]->heapDeadline <= heap[index]->heapDeadline) {
+			break;
 		}
+		
+		[self swapIndex:index withIndex:parentIndex];
+		index = parentIndex;
 	}
-	
-	return nil;
 }
 
-- (BOOL)getMode:(ZDCStorageMode *)modePtr
-           type:(ZDCFileType *)typePtr
-         format:(ZDCCryptoFileFormat *)formatPtr
-     forFileURL:(NSURL *)fileURL
+- (void)siftDown:(NSUInteger)index
 {
-	NSURL *parentURL = [fileURL URLByDeletingLastPathComponent];
-	NSString *parentName = [parentURL lastPathComponent];
-	
-	ZDCStorageMode mode = ZDCStorageMode_Cache;
-	ZDCFileType type = ZDCFileType_NodeData;
-	ZDCCryptoFileFormat format = ZDCCryptoFileFormat_Unknown;
-	
-	if (!parentURL || !parentName)
+	NSUInteger const count = heap.count;
+	while (YES)
 	{
-		if (modePtr) *modePtr = mode;
-		if (typePtr) *typePtr = type;
-		if (formatPtr) *formatPtr = format;
-		return NO;
-	}
-	
-	NSURL *containerURL = nil;
-	
-	if ([parentName caseInsensitiveCompare:kSubDirectoryName_CacheFile] == NSOrderedSame)
-	{
-		NSURL *grandParentURL = [parentURL URLByDeletingLastPathComponent];
-		NSString *grandParentName = [grandParentURL lastPathComponent];
+		NSUInteger const leftIndex = (2 * index) + 1;
+		NSUInteger const rightIndex = leftIndex + 1;
+		NSUInteger minIndex = index;
 		
-		if (grandParentName && [grandParentName caseInsensitiveCompare:kSubDirectoryName_NodeData] == NSOrderedSame)
-		{
-			// Path is: /<?>/nodeData/cachefile/<filename>
-			
-			format = ZDCCryptoFileFormat_CacheFile;
-			type = ZDCFileType_NodeData;
-			
-			// We still need to know if <?> is either:
-			// - cacheContainerURL
-			// - persistentContainerURL
-			
-			containerURL = [grandParentURL URLByDeletingLastPathComponent];
+		if ((leftIndex < count) && (heap[leftIndex]->heapDeadline < heap[minIndex]->heapDeadline)) {
+			minIndex = leftIndex;
+		}
+		if ((rightIndex < count) && (heap[rightIndex]->heapDeadline < heap[minIndex]->heapDeadline)) {
+			minIndex = rightIndex;
 		}
-	}
-	else if ([parentName caseInsensitiveCompare:kSubDirectoryName_Cloudfile] == NSOrderedSame)
-	{
-		NSURL *grandParentURL = [parentURL URLByDeletingLastPathComponent];
-		NSString *grandParentName = [grandParentURL lastPathComponent];
 		
-		if (grandParentName && [grandParentName caseInsensitiveCompare:kSubDirectoryName_NodeData] == NSOrderedSame)
-		{
-			// Path is: /<?>/nodeData/cloudfile/<filename>
-			
-			format = ZDCCryptoFileFormat_CloudFile;
-			type = ZDCFileType_NodeData;
-			
-			// We still need to know if <?> is either:
-			// - cacheContainerURL
-			// - persistentContainerURL
-			
-			containerURL = [grandParentURL URLByDeletingLastPathComponent];
+		if (minIndex == index) {
+			break;
 		}
+		
+		[self swapIndex:index withIndex:minIndex];
+		index = minIndex;
 	}
-	else if ([parentName caseInsensitiveCompare:kSubDirectoryName_NodeThumbnails] == NSOrderedSame)
+}
+
+- (void)swapIndex:(NSUInteger)indexA withIndex:(NSUInteger)indexB
+{
+	ZDCFileInfo *infoA = heap[indexA];
+	ZDCFileInfo *infoB = heap[indexB];
+	
+	heap[indexA] = infoB;
+	heap[indexB] = infoA;
+	
+	infoA->heapIndex = indexB;
+	infoB->heapIndex = indexA;
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t const kJournalMagic   = 0x4A43445A; // "ZDCJ" (little endian)
+static uint32_t const kJournalVersion = 2;
+
+static uint8_t const kJournalOp_Put    = 1;
+static uint8_t const kJournalOp_Remove = 2;
+
+static uint8_t const kJournalFlag_MigrateAfterUpload = (1 << 0);
+static uint8_t const kJournalFlag_DeleteAfterUpload  = (1 << 1);
+static uint8_t const kJournalFlag_Packed             = (1 << 2);
+static uint8_t const kJournalFlag_ContentDigest      = (1 << 3); // followed by: string(contentDigest)
+static uint8_t const kJournalFlag_Blob               = (1 << 4); // followed by: string(blobName)
+
+static uint16_t const kJournalNilString = 0xFFFF;
+static uint16_t const kJournalNilData   = 0xFFFF;
+
+static uint32_t ZDCJournalChecksum(const uint8_t *bytes, size_t length)
+{
+	// FNV-1a (32-bit)
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < length; i++)
 	{
-		// Path is? /<?>/nodeThumbnails/<filename>
-		
-		format = ZDCCryptoFileFormat_CacheFile;
-		type = ZDCFileType_NodeThumbnail;
-		
-		// We still need to know if <?> is either:
-		// - cacheContainerURL
-		// - persistentContainerURL
-		
-		containerURL = [parentURL URLByDeletingLastPathComponent];
+		hash ^= bytes[i];
+		hash *= 16777619u;
 	}
-	else if ([parentName caseInsensitiveCompare:kSubDirectoryName_UserAvatars] == NSOrderedSame)
+	return hash;
+}
+
+static void ZDCJournalAppendUInt8(NSMutableData *data, uint8_t value)
+{
+	[data appendBytes:&value length:sizeof(value)];
+}
+
+static void ZDCJournalAppendUInt16(NSMutableData *data, uint16_t value)
+{
+	value = OSSwapHostToLittleInt16(value);
+	[data appendBytes:&value length:sizeof(value)];
+}
+
+static void ZDCJournalAppendUInt32(NSMutableData *data, uint32_t value)
+{
+	value = OSSwapHostToLittleInt32(value);
+	[data appendBytes:&value length:sizeof(value)];
+}
+
+static void ZDCJournalAppendUInt64(NSMutableData *data, uint64_t value)
+{
+	value = OSSwapHostToLittleInt64(value);
+	[data appendBytes:&value length:sizeof(value)];
+}
+
+static void ZDCJournalAppendDouble(NSMutableData *data, double value)
+{
+	uint64_t bits = 0;
+	memcpy(&bits, &value, sizeof(bits));
+	ZDCJournalAppendUInt64(data, bits);
+}
+
+static void ZDCJournalAppendString(NSMutableData *data, NSString *string)
+{
+	if (string == nil)
 	{
-		// Path is? /<?>/avatars/<filename>
-		
-		format = ZDCCryptoFileFormat_CacheFile;
-		type = ZDCFileType_UserAvatar;
-		
-		// We still need to know if <?> is either:
-		// - cacheContainerURL
-		// - persistentContainerURL
-		
-		containerURL = [parentURL URLByDeletingLastPathComponent];
+		ZDCJournalAppendUInt16(data, kJournalNilString);
+		return;
 	}
 	
-	BOOL result = NO;
+	NSData *utf8 = [string dataUsingEncoding:NSUTF8StringEncoding];
+	uint16_t length = (uint16_t)MIN(utf8.length, (NSUInteger)(kJournalNilString - 1));
 	
-	if (containerURL)
+	ZDCJournalAppendUInt16(data, length);
+	[data appendBytes:utf8.bytes length:length];
+}
+
+static void ZDCJournalAppendData(NSMutableData *data, NSData *value)
+{
+	if (value == nil)
 	{
-		if ([containerURL isEqual:cacheContainerURL])
-		{
-			mode = ZDCStorageMode_Cache;
-			result = YES;
-		}
-		else if ([containerURL isEqual:persistentContainerURL])
-		{
-			mode = ZDCStorageMode_Persistent;
-			result = YES;
-		}
-		else
-		{
-			// NSURL might be misbehaving.
-			// When this happens we resort to comparing iNodes.
-			
-			id iNode = nil;
-			[containerURL getResourceValue:&iNode forKey:NSURLFileResourceIdentifierKey error:nil];
-			
-			id c_iNode = nil;
-			[cacheContainerURL removeCachedResourceValueForKey:NSURLFileResourceIdentifierKey];
-			[cacheContainerURL getResourceValue:&c_iNode forKey:NSURLFileResourceIdentifierKey error:nil];
-			
-			if ([iNode isEqual:c_iNode])
-			{
-				mode = ZDCStorageMode_Cache;
-				result = YES;
-			}
-			else
-			{
-				id p_iNode = nil;
-				[persistentContainerURL removeCachedResourceValueForKey:NSURLFileResourceIdentifierKey];
-				[persistentContainerURL getResourceValue:&p_iNode forKey:NSURLFileResourceIdentifierKey error:nil];
-				
-				if ([iNode isEqual:p_iNode])
-				{
-					mode = ZDCStorageMode_Persistent;
-					result = YES;
-				}
-			}
-		}
+		ZDCJournalAppendUInt16(data, kJournalNilData);
+		return;
 	}
 	
-	if (modePtr) *modePtr = mode;
-	if (typePtr) *typePtr = type;
-	if (formatPtr) *formatPtr = format;
-	return result;
+	uint16_t length = (uint16_t)MIN(value.length, (NSUInteger)(kJournalNilData - 1));
+	
+	ZDCJournalAppendUInt16(data, length);
+	[data appendBytes:value.bytes length:length];
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Notifications - Incoming
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+typedef struct {
+	const uint8_t *ptr;
+	const uint8_t *end;
+} ZDCJournalReader;
 
-#if TARGET_OS_IPHONE && !TARGET_EXTENSION
-- (void)applicationWillEnterForeground:(NSNotification *)notification
+static BOOL ZDCJournalReadBytes(ZDCJournalReader *reader, void *outBytes, size_t length)
 {
-	[self scanCacheDirectories];
+	if ((size_t)(reader->end - reader->ptr) < length) return NO;
+	
+	memcpy(outBytes, reader->ptr, length);
+	reader->ptr += length;
+	return YES;
 }
-#endif
 
-- (void)databaseModified:(NSNotification *)notification
+static BOOL ZDCJournalReadUInt8(ZDCJournalReader *reader, uint8_t *outValue)
 {
-	YapSet *deletedItems = notification.userInfo[YapDatabaseRemovedKeysKey];
-	YapSet *modifiedItems = notification.userInfo[YapDatabaseObjectChangesKey];
+	return ZDCJournalReadBytes(reader, outValue, sizeof(uint8_t));
+}
+
+static BOOL ZDCJournalReadUInt16(ZDCJournalReader *reader, uint16_t *outValue)
+{
+	uint16_t value = 0;
+	if (!ZDCJournalReadBytes(reader, &value, sizeof(value))) return NO;
 	
-	if (deletedItems.count > 0)
-	{
-		__block NSMutableArray<NSString*> *deletedNodeIDs = nil;
-		__block NSMutableArray<NSString*> *deletedUserIDs = nil;
+	*outValue = OSSwapLittleToHostInt16(value);
+	return YES;
+}
+
+static BOOL ZDCJournalReadUInt32(ZDCJournalReader *reader, uint32_t *outValue)
+{
+	uint32_t value = 0;
+	if (!ZDCJournalReadBytes(reader, &value, sizeof(value))) return NO;
 	
-		for (YapCollectionKey *ck in deletedItems)
-		{
-			__unsafe_unretained NSString *collection = ck.collection;
+	*outValue = OSSwapLittleToHostInt32(value);
+	return YES;
+}
+
+static BOOL ZDCJournalReadUInt64(ZDCJournalReader *reader, uint64_t *outValue)
+{
+	uint64_t value = 0;
+	if (!ZDCJournalReadBytes(reader, &value, sizeof(value))) return NO;
 	
-			if ([collection isEqualToString:kZDCCollection_Nodes])
-			{
-				if (deletedNodeIDs == nil) {
-					deletedNodeIDs = [NSMutableArray array];
-				}
-				[deletedNodeIDs addObject:ck.key];
-			}
-			else if ([collection isEqualToString:kZDCCollection_Users])
-			{
-				if (deletedUserIDs == nil) {
-					deletedUserIDs = [NSMutableArray array];
-				}
-				[deletedUserIDs addObject:ck.key];
-			}
-		}
+	*outValue = OSSwapLittleToHostInt64(value);
+	return YES;
+}
+
+static BOOL ZDCJournalReadDouble(ZDCJournalReader *reader, double *outValue)
+{
+	uint64_t bits = 0;
+	if (!ZDCJournalReadUInt64(reader, &bits)) return NO;
 	
-		if (deletedNodeIDs.count > 0)
-		{
-			[self deleteNodeDataForNodeIDs:deletedNodeIDs];
-		}
-		if (deletedUserIDs.count > 0)
-		{
-			[self deleteUserAvatarsForUserIDs:deletedUserIDs];
-		}
-	}
+	memcpy(outValue, &bits, sizeof(bits));
+	return YES;
+}
+
+static BOOL ZDCJournalReadString(ZDCJournalReader *reader, NSString **outString)
+{
+	uint16_t length = 0;
+	if (!ZDCJournalReadUInt16(reader, &length)) return NO;
 	
-	if (modifiedItems.count > 0)
+	if (length == kJournalNilString)
 	{
-		__block NSMutableArray<NSString*> *modifiedUserIDs = nil;
-		
-		for (YapCollectionKey *ck in deletedItems)
-		{
-			__unsafe_unretained NSString *collection = ck.collection;
-			
-			if ([collection isEqualToString:kZDCCollection_Users])
-			{
-				if (modifiedUserIDs == nil) {
-					modifiedUserIDs = [NSMutableArray array];
-				}
-				[modifiedUserIDs addObject:ck.key];
-			}
-		}
-		
-		if (modifiedUserIDs.count > 0)
-		{
-			NSMutableDictionary<NSString*, NSSet<NSString*> *> *auth0IDs =
-			  [NSMutableDictionary dictionaryWithCapacity:modifiedUserIDs.count];
-			
-			__weak typeof(self) weakSelf = self;
-			[zdc.databaseManager.roDatabaseConnection asyncReadWithBlock:^(YapDatabaseReadTransaction *transaction) {
-				
-				for (NSString *userID in modifiedUserIDs)
-				{
-					ZDCUser *user = [transaction objectForKey:userID inCollection:kZDCCollection_Users];
-					if (user)
-					{
-						NSMutableArray *identityIDs = [NSMutableArray arrayWithCapacity:user.identities.count];
-						for (ZDCUserIdentity *ident in user.identities)
-						{
-							[identityIDs addObject:ident.identityID];
-						}
-						
-						auth0IDs[userID] = [NSSet setWithArray:identityIDs];
-					}
-				}
-				
-			} completionQueue:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0) completionBlock:^{
-				
-				__strong typeof(self) strongSelf = weakSelf;
-				if (strongSelf == nil) return;
-				
-				for (NSString *userID in auth0IDs)
-				{
-					[strongSelf deleteUserAvatars:userID excluding:auth0IDs[userID]];
-				}
-			}];
-		}
+		*outString = nil;
+		return YES;
 	}
+	
+	if ((size_t)(reader->end - reader->ptr) < length) return NO;
+	
+	NSString *string = [[NSString alloc] initWithBytes:reader->ptr length:length encoding:NSUTF8StringEncoding];
+	if (string == nil) return NO;
+	
+	reader->ptr += length;
+	*outString = string;
+	return YES;
 }
 
-- (void)pipelineQueueChanged:(NSNotification *)notification
+static BOOL ZDCJournalReadData(ZDCJournalReader *reader, NSData **outData)
 {
-	YapDatabaseCloudCorePipeline *pipeline = (YapDatabaseCloudCorePipeline *)notification.object;
-	YapDatabaseCloudCore *cloudCore = pipeline.owner;
+	uint16_t length = 0;
+	if (!ZDCJournalReadUInt16(reader, &length)) return NO;
 	
-	if (![cloudCore isKindOfClass:[ZDCCloud class]]) {
-		return;
+	if (length == kJournalNilData)
+	{
+		*outData = nil;
+		return YES;
 	}
 	
-	NSMutableSet<NSString*> *nodeIDs = [NSMutableSet set];
+	if ((size_t)(reader->end - reader->ptr) < length) return NO;
 	
-	[pipeline enumerateOperationsUsingBlock:
-	^(YapDatabaseCloudCoreOperation *operation, NSUInteger graphIdx, BOOL *stop)
+	*outData = [NSData dataWithBytes:reader->ptr length:length];
+	reader->ptr += length;
+	return YES;
+}
+
+/**
+ * A persistent copy of the DiskManager's in-memory index (i.e. the ZDCFileInfo entries within the dicts).
+ *
+ * Without it, we'd have to enumerate every managed directory (fetching sizes & dates & xattrs for every file)
+ * on every launch, before the cache is ready.
+ * With it, we can restore the index in a single sequential read.
+ *
+ * The file is an append-only log:
+ *
+ * - header : magic(u32) + version(u32)
+ * - record : length(u32) + checksum(u32) + payload
+ *
+ * Each payload is either a "put" (the full state of an info) or a "remove" (just the key).
+ * When replayed in order, the last record for each key wins.
+ * The log is periodically compacted by rewriting it as a single "put" per (live) info.
+ *
+ * Appends aren't fsync'd. If the tail of the file is torn (e.g. power loss),
+ * the checksum catches it, and the DiskManager falls back to a full scan.
+ *
+ * Encoding happens on the caller's queue (ZDCDiskManager.cacheQueue, where the infos live),
+ * and the actual disk IO happens on the journal's own serial queue.
+ */
+@interface ZDCDiskJournal : NSObject
+
+- (instancetype)initWithFileURL:(NSURL *)fileURL;
+
+@property (nonatomic, readonly) NSURL *fileURL;
+
+/**
+ * The number of records appended since the last compaction.
+ * Must be accessed from within ZDCDiskManager.cacheQueue.
+ */
+@property (nonatomic, readonly) NSUInteger appendedRecordCount;
+
+/**
+ * Returns a unique key for the given tuple.
+ * This is the key used by the journal to identify an entry.
+ */
++ (NSString *)keyForMode:(ZDCStorageMode)mode
+                    type:(ZDCFileType)type
+                  format:(ZDCCryptoFileFormat)format
+                filename:(NSString *)filename;
+
++ (NSString *)keyForInfo:(ZDCFileInfo *)info;
+
+/**
+ * Reads & replays the journal.
+ *
+ * Returns nil if the journal doesn't exist, or is corrupt (which implies an unclean shutdown).
+ * Otherwise returns the restored infos, and the date the journal was last written to.
+ *
+ * @param directoryBlock
+ *   Returns the directory for the given tuple (used to reconstruct each info.fileURL).
+ */
+- (nullable NSArray<ZDCFileInfo *> *)readInfosWithDirectoryBlock:
+    (NSURL *_Nullable (^)(ZDCStorageMode mode, ZDCFileType type, ZDCCryptoFileFormat format))directoryBlock
+                                                  lastWriteDate:(NSDate *_Nullable *_Nonnull)outLastWriteDate;
+
+/**
+ * Appends a record for each of the given items.
+ *
+ * @param infos
+ *   Infos that were added or modified. (A "put" record is appended for each.)
+ *
+ * @param removedKeys
+ *   Keys of infos that were removed. (A "remove" record is appended for each.)
+ */
+- (void)appendInfos:(NSArray<ZDCFileInfo *> *)infos removedKeys:(NSArray<NSString *> *)removedKeys;
+
+/**
+ * Atomically replaces the journal with a single "put" record for each of the given infos.
+ */
+- (void)compactWithInfos:(NSArray<ZDCFileInfo *> *)infos;
+
+/**
+ * Deletes the journal file.
+ */
+- (void)reset;
+
+@end
+
+@implementation ZDCDiskJournal
+{
+	dispatch_queue_t queue;
+	int fd; // only accessed within queue
+}
+
+@synthesize fileURL = fileURL;
+@synthesize appendedRecordCount = appendedRecordCount;
+
+- (instancetype)initWithFileURL:(NSURL *)inFileURL
+{
+	if ((self = [super init]))
 	{
-		__unsafe_unretained ZDCCloudOperation *op = (ZDCCloudOperation *)operation;
-		
-		if (op.nodeID &&
-		   (op.type == ZDCCloudOperationType_Put) &&
-		   (op.putType == ZDCCloudOperationPutType_Node_Data))
-		{
-			[nodeIDs addObject:op.nodeID];
-		}
-	}];
-	
-	__weak typeof(self) weakSelf = self;
-	dispatch_async(cacheQueue, ^{ @autoreleasepool {
-		
-		[weakSelf migrateOrDeleteAfterUpload:nodeIDs];
-	}});
+		fileURL = inFileURL;
+		queue = dispatch_queue_create("ZDCDiskJournal", DISPATCH_QUEUE_SERIAL);
+		fd = -1;
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	if (fd >= 0) {
+		close(fd);
+	}
+}
+
++ (NSString *)keyForMode:(ZDCStorageMode)mode
+                    type:(ZDCFileType)type
+                  format:(ZDCCryptoFileFormat)format
+                filename:(NSString *)filename
+{
+	return [NSString stringWithFormat:@"%d|%d|%d|%@", (int)mode, (int)type, (int)format, filename];
+}
+
++ (NSString *)keyForInfo:(ZDCFileInfo *)info
+{
+	return [self keyForMode: info.mode
+	                   type: info.type
+	                 format: info.format
+	               filename: info.fileURL.lastPathComponent];
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Notifications - Outgoing
+#pragma mark Encoding
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-- (void)postDiskManagerChangedNotification
+- (void)appendRecordWithPayload:(NSData *)payload toData:(NSMutableData *)data
 {
-	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
+	ZDCJournalAppendUInt32(data, (uint32_t)payload.length);
+	ZDCJournalAppendUInt32(data, ZDCJournalChecksum(payload.bytes, payload.length));
+	[data appendData:payload];
+}
+
+- (void)appendPutRecordForInfo:(ZDCFileInfo *)info toData:(NSMutableData *)data
+{
+	NSMutableData *payload = [NSMutableData dataWithCapacity:128];
+	
+	ZDCJournalAppendUInt8(payload, kJournalOp_Put);
+	ZDCJournalAppendUInt8(payload, (uint8_t)info.mode);
+	ZDCJournalAppendUInt8(payload, (uint8_t)info.type);
+	ZDCJournalAppendUInt8(payload, (uint8_t)info.format);
+	ZDCJournalAppendString(payload, info.fileURL.lastPathComponent);
+	
+	ZDCJournalAppendString(payload, info.nodeID);
+	ZDCJournalAppendString(payload, info.userID);
+	ZDCJournalAppendString(payload, info.identityID);
+	
+	ZDCJournalAppendUInt64(payload, info.fileSize);
+	ZDCJournalAppendDouble(payload, [info.lastModified timeIntervalSinceReferenceDate]);
+	ZDCJournalAppendDouble(payload, [info.lastAccessed timeIntervalSinceReferenceDate]);
+	ZDCJournalAppendDouble(payload, info.expiration);
+	
+	uint8_t flags = 0;
+	if (info.migrateAfterUpload) flags |= kJournalFlag_MigrateAfterUpload;
+	if (info.deleteAfterUpload)  flags |= kJournalFlag_DeleteAfterUpload;
+	if (info.slabEntry)          flags |= kJournalFlag_Packed;
+	if (info.contentDigest)      flags |= kJournalFlag_ContentDigest;
+	if (info.blob)               flags |= kJournalFlag_Blob;
+	
+	ZDCJournalAppendUInt8(payload, flags);
+	
+	// The eTag is stored exactly as it is in the xattr (i.e. encrypted).
+	// An empty value means the file doesn't have an eTag. (nil means we haven't read the xattr.)
+	id encryptedETag = info.encryptedETag;
+	if ([encryptedETag isKindOfClass:[NSData class]])
+		ZDCJournalAppendData(payload, (NSData *)encryptedETag);
+	else if (encryptedETag)
+		ZDCJournalAppendData(payload, [NSData data]);
+	else
+		ZDCJournalAppendData(payload, nil);
 	
-	if (notificationPending) {
-		return; // already dispatched, still pending execution
+	// Optional fields (appended after the fixed fields, so older records remain readable)
+	
+	if (info.contentDigest) {
+		ZDCJournalAppendString(payload, info.contentDigest);
+	}
+	if (info.blob) {
+		ZDCJournalAppendString(payload, info.blob.name);
 	}
-	notificationPending = YES;
 	
-	dispatch_async(dispatch_get_main_queue(), ^{
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
-		
-		__block ZDCDiskManagerChanges *changes = nil;
-		
-		dispatch_sync(cacheQueue, ^{ @autoreleasepool {
-
-			if (changes_nodeData.count       > 0 ||
-			    changes_nodeThumbnails.count > 0 ||
-			    changes_userAvatars.count    > 0)
-			{
-				changes = [[ZDCDiskManagerChanges alloc] init];
-				
-				changes.changedNodeIDs = [changes_nodeData setByAddingObjectsFromSet:changes_nodeThumbnails];
-				changes.changedNodeData = [changes_nodeData copy];
-				changes.changedNodeThumbnails = [changes_nodeThumbnails copy];
-				changes.changedUsersIDs = [changes_userAvatars copy];
-				
-				[changes_nodeData removeAllObjects];
-				[changes_nodeThumbnails removeAllObjects];
-				[changes_userAvatars removeAllObjects];
-			}
-			
-			notificationPending = NO;
-		}});
-		
-		if (changes)
-		{
-			NSDictionary *userInfo = @{ kZDCDiskManagerChanges : changes };
-			
-			[[NSNotificationCenter defaultCenter] postNotificationName: ZDCDiskManagerChangedNotification
-			                                                    object: self
-			                                                  userInfo: userInfo];
-		}
-		
-	#pragma clang diagnostic pop
-	});
+	[self appendRecordWithPayload:payload toData:data];
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark NSFileManagerDelegate
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-- (BOOL)fileManager:(NSFileManager *)fileManager shouldProceedAfterError:(NSError *)error
-                                                         movingItemAtURL:(NSURL *)srcURL
-                                                                   toURL:(NSURL *)dstURL
+- (void)appendRemoveRecordForKey:(NSString *)key toData:(NSMutableData *)data
 {
-	// Error code for: The operation couldn’t be completed. File exists
-	if ([error code] == NSFileWriteFileExistsError)
-		return YES;
-	else
-		return NO;
+	NSArray<NSString *> *components = [key componentsSeparatedByString:@"|"];
+	if (components.count != 4) return;
+	
+	NSMutableData *payload = [NSMutableData dataWithCapacity:64];
+	
+	ZDCJournalAppendUInt8(payload, kJournalOp_Remove);
+	ZDCJournalAppendUInt8(payload, (uint8_t)[components[0] intValue]);
+	ZDCJournalAppendUInt8(payload, (uint8_t)[components[1] intValue]);
+	ZDCJournalAppendUInt8(payload, (uint8_t)[components[2] intValue]);
+	ZDCJournalAppendString(payload, components[3]);
+	
+	[self appendRecordWithPayload:payload toData:data];
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Utilities
+#pragma mark Reading
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-- (void)createDirectories:(NSArray<NSArray *> *)list
+- (NSArray<ZDCFileInfo *> *)readInfosWithDirectoryBlock:
+    (NSURL* (^)(ZDCStorageMode mode, ZDCFileType type, ZDCCryptoFileFormat format))directoryBlock
+                                         lastWriteDate:(NSDate **)outLastWriteDate
 {
-	for (NSArray *tuple in list)
-	{
-		ZDCStorageMode mode        = [tuple[0] integerValue];
-		ZDCFileType type           = [tuple[1] integerValue];
-		ZDCCryptoFileFormat format = [tuple[2] integerValue];
-		
-		NSURL *url = [self URLForMode:mode type:type format:format];
-		NSAssert(url != nil, @"Bad <mode, type, format> tuple");
+	__block NSData *data = nil;
+	__block NSDate *lastWriteDate = nil;
 	
-		NSError *error = nil;
-		[[NSFileManager defaultManager] createDirectoryAtURL: url
-		                         withIntermediateDirectories: YES
-		                                          attributes: nil
-		                                               error: &error];
+	NSURL *const url = fileURL;
+	dispatch_sync(queue, ^{
 	
-		if (error) {
-			ZDCLogError(@"Error creating directory: %@", error);
-		}
+		NSDate *modificationDate = nil;
+		[url getResourceValue:&modificationDate forKey:NSURLContentModificationDateKey error:nil];
+		
+		lastWriteDate = modificationDate;
+		data = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedIfSafe error:nil];
+	});
+	
+	*outLastWriteDate = lastWriteDate;
+	if (data == nil || lastWriteDate == nil) {
+		return nil;
 	}
-}
-
-- (void)setupFilesystemMonitors:(NSArray<NSArray *> *)list
-{
-	monitors = [NSMutableArray arrayWithCapacity:list.count];
 	
-	__weak typeof(self) weakSelf = self;
-	for (NSArray *tuple in list)
+	ZDCJournalReader reader;
+	reader.ptr = (const uint8_t *)data.bytes;
+	reader.end = reader.ptr + data.length;
+	
+	uint32_t magic = 0;
+	uint32_t version = 0;
+	
+	if (!ZDCJournalReadUInt32(&reader, &magic) || (magic != kJournalMagic)) return nil;
+	if (!ZDCJournalReadUInt32(&reader, &version) || (version != kJournalVersion)) return nil;
+	
+	NSMutableDictionary<NSString *, ZDCFileInfo *> *infos = [NSMutableDictionary dictionary];
+	NSMutableDictionary<NSNumber *, NSURL *> *directories = [NSMutableDictionary dictionary];
+	
+	while (reader.ptr < reader.end)
 	{
-		ZDCStorageMode mode        = [tuple[0] integerValue];
-		ZDCFileType type           = [tuple[1] integerValue];
-		ZDCCryptoFileFormat format = [tuple[2] integerValue];
+		uint32_t length = 0;
+		uint32_t checksum = 0;
 		
-		NSURL *url = [self URLForMode:mode type:type format:format];
+		if (!ZDCJournalReadUInt32(&reader, &length)) return nil;
+		if (!ZDCJournalReadUInt32(&reader, &checksum)) return nil;
 		
-		ZDCFilesystemMonitor *monitor = [[ZDCFilesystemMonitor alloc] initWithDirectoryURL:url];
+		if ((size_t)(reader.end - reader.ptr) < length) return nil;
+		if (ZDCJournalChecksum(reader.ptr, length) != checksum) return nil;
 		
-		[monitor monitorWithMask: [ZDCFilesystemMonitor vnode_flags_all]
-		                   queue: dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0)
-		                   block:^(dispatch_source_vnode_flags_t mask)
+		ZDCJournalReader payload;
+		payload.ptr = reader.ptr;
+		payload.end = reader.ptr + length;
+		
+		reader.ptr += length;
+		
+		uint8_t op = 0, mode = 0, type = 0, format = 0;
+		NSString *filename = nil;
+		
+		if (!ZDCJournalReadUInt8(&payload, &op))     return nil;
+		if (!ZDCJournalReadUInt8(&payload, &mode))   return nil;
+		if (!ZDCJournalReadUInt8(&payload, &type))   return nil;
+		if (!ZDCJournalReadUInt8(&payload, &format)) return nil;
+		if (!ZDCJournalReadString(&payload, &filename) || filename == nil) return nil;
+		
+		NSString *key = [ZDCDiskJournal keyForMode:mode type:type format:format filename:filename];
+		
+		if (op == kJournalOp_Remove)
 		{
-			[weakSelf scanDirectoryWithMode:mode type:type format:format];
-		}];
+			[infos removeObjectForKey:key];
+			continue;
+		}
+		else if (op != kJournalOp_Put)
+		{
+			return nil;
+		}
 		
-		[monitors addObject:monitor];
+		NSString *nodeID = nil, *userID = nil, *identityID = nil;
+		uint64_t fileSize = 0;
+		double lastModified = 0, lastAccessed = 0, expiration = 0;
+		uint8_t flags = 0;
+		NSData *encryptedETag = nil;
+		
+		if (!ZDCJournalReadString(&payload, &nodeID))       return nil;
+		if (!ZDCJournalReadString(&payload, &userID))       return nil;
+		if (!ZDCJournalReadString(&payload, &identityID))   return nil;
+		if (!ZDCJournalReadUInt64(&payload, &fileSize))     return nil;
+		if (!ZDCJournalReadDouble(&payload, &lastModified)) return nil;
+		if (!ZDCJournalReadDouble(&payload, &lastAccessed)) return nil;
+		if (!ZDCJournalReadDouble(&payload, &expiration))   return nil;
+		if (!ZDCJournalReadUInt8(&payload, &flags))         return nil;
+		if (!ZDCJournalReadData(&payload, &encryptedETag))  return nil;
+		
+		NSString *contentDigest = nil, *blobName = nil;
+		
+		if (flags & kJournalFlag_ContentDigest) {
+			if (!ZDCJournalReadString(&payload, &contentDigest)) return nil;
+		}
+		if (flags & kJournalFlag_Blob) {
+			if (!ZDCJournalReadString(&payload, &blobName) || blobName == nil) return nil;
+		}
+		
+		NSNumber *directoryKey = @((mode << 16) | (type << 8) | format);
+		NSURL *directoryURL = directories[directoryKey];
+		if (directoryURL == nil)
+		{
+			directoryURL = directoryBlock(mode, type, format);
+			if (directoryURL == nil) return nil;
+			
+			directories[directoryKey] = directoryURL;
+		}
+		
+		NSURL *infoURL = [directoryURL URLByAppendingPathComponent:filename isDirectory:NO];
+		ZDCFileInfo *info = [[ZDCFileInfo alloc] initWithMode:mode type:type format:format fileURL:infoURL];
+		
+		info.nodeID = nodeID;
+		info.userID = userID;
+		info.identityID = identityID;
+		
+		info.fileSize = fileSize;
+		info.lastModified = [NSDate dateWithTimeIntervalSinceReferenceDate:lastModified];
+		info.lastAccessed = [NSDate dateWithTimeIntervalSinceReferenceDate:lastAccessed];
+		info.expiration = expiration;
+		
+		info.migrateAfterUpload = (flags & kJournalFlag_MigrateAfterUpload) != 0;
+		info.deleteAfterUpload  = (flags & kJournalFlag_DeleteAfterUpload)  != 0;
+		info->journaledAsPacked = (flags & kJournalFlag_Packed)             != 0;
+		
+		if (encryptedETag) {
+			info.encryptedETag = (encryptedETag.length > 0) ? encryptedETag : [NSNull null];
+		}
+		
+		info.contentDigest = contentDigest;
+		info->journaledBlobName = blobName;
+		
+		infos[key] = info;
 	}
+	
+	return [infos allValues];
 }
 
-- (void)scanCacheDirectories
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Writing
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)appendInfos:(NSArray<ZDCFileInfo *> *)infos removedKeys:(NSArray<NSString *> *)removedKeys
 {
-	// cache + nodeData      + cacheFile
-	// cache + nodeData      + cloudFile
-	// cache + nodeThumbnail + cacheFile
-	// cache + userAvatar    + cacheFile
+	if ((infos.count == 0) && (removedKeys.count == 0)) return;
 	
-	[self scanDirectoryWithMode: ZDCStorageMode_Cache
-	                       type: ZDCFileType_NodeData
-	                     format: ZDCCryptoFileFormat_CacheFile];
+	NSMutableData *data = [NSMutableData dataWithCapacity:(128 * (infos.count + removedKeys.count))];
 	
-	[self scanDirectoryWithMode: ZDCStorageMode_Cache
-	                       type: ZDCFileType_NodeData
-	                     format: ZDCCryptoFileFormat_CloudFile];
+	for (NSString *key in removedKeys)
+	{
+		[self appendRemoveRecordForKey:key toData:data];
+	}
+	for (ZDCFileInfo *info in infos)
+	{
+		[self appendPutRecordForInfo:info toData:data];
+	}
 	
-	[self scanDirectoryWithMode: ZDCStorageMode_Cache
-	                       type: ZDCFileType_NodeThumbnail
-	                     format: ZDCCryptoFileFormat_CacheFile];
+	appendedRecordCount += (infos.count + removedKeys.count);
 	
-	[self scanDirectoryWithMode: ZDCStorageMode_Cache
-	                       type: ZDCFileType_UserAvatar
-	                     format: ZDCCryptoFileFormat_CacheFile];
+	dispatch_async(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	
+		if (fd < 0)
+		{
+			fd = open([fileURL.path fileSystemRepresentation], (O_WRONLY | O_APPEND | O_CREAT), 0644);
+			if (fd < 0)
+			{
+				ZDCLogWarn(@"Error opening journal: %d", errno);
+				return;
+			}
+			
+			off_t offset = lseek(fd, 0, SEEK_END);
+			if (offset == 0)
+			{
+				NSMutableData *header = [NSMutableData dataWithCapacity:8];
+				ZDCJournalAppendUInt32(header, kJournalMagic);
+				ZDCJournalAppendUInt32(header, kJournalVersion);
+				
+				[self writeData:header];
+			}
+		}
+		
+		[self writeData:data];
+	
+	#pragma clang diagnostic pop
+	}});
 }
 
-- (void)scanOfflineDirectories
+- (void)compactWithInfos:(NSArray<ZDCFileInfo *> *)infos
 {
-	// persistent + nodeData      + cacheFile
-	// persistent + nodeData      + cloudFile
-	// persistent + nodeThumbnail + cacheFile
-	// persistent + userAvatar    + cacheFile
+	NSMutableData *data = [NSMutableData dataWithCapacity:(8 + (128 * infos.count))];
 	
-	[self scanDirectoryWithMode: ZDCStorageMode_Persistent
-	                       type: ZDCFileType_NodeData
-	                     format: ZDCCryptoFileFormat_CacheFile];
+	ZDCJournalAppendUInt32(data, kJournalMagic);
+	ZDCJournalAppendUInt32(data, kJournalVersion);
 	
-	[self scanDirectoryWithMode: ZDCStorageMode_Persistent
-	                       type: ZDCFileType_NodeData
-	                     format: ZDCCryptoFileFormat_CloudFile];
+	for (ZDCFileInfo *info in infos)
+	{
+		[self appendPutRecordForInfo:info toData:data];
+	}
 	
-	[self scanDirectoryWithMode: ZDCStorageMode_Persistent
-	                       type: ZDCFileType_NodeThumbnail
-	                     format: ZDCCryptoFileFormat_CacheFile];
+	appendedRecordCount = 0;
 	
-	[self scanDirectoryWithMode: ZDCStorageMode_Persistent
-	                       type: ZDCFileType_UserAvatar
-	                     format: ZDCCryptoFileFormat_CacheFile];
+	dispatch_async(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	
+		if (fd >= 0)
+		{
+			close(fd);
+			fd = -1;
+		}
+		
+		NSError *error = nil;
+		[data writeToURL:fileURL options:NSDataWritingAtomic error:&error];
+		
+		if (error) {
+			ZDCLogWarn(@"Error compacting journal: %@", error);
+		}
+	
+	#pragma clang diagnostic pop
+	}});
 }
 
-/**
- * Scans the corresponding directory, and ensures a ZDCFileInfo is created for each corresponding cached file.
- * Also deletes files from disk that no longer correspond to an item in the database.
- * And deletes ZDCFileInfo entries that no longer have a corresponding item on the file system.
-**/
-- (void)scanDirectoryWithMode:(ZDCStorageMode)mode type:(ZDCFileType)type format:(ZDCCryptoFileFormat)format
+- (void)reset
 {
-	ZDCLogAutoTrace();
+	appendedRecordCount = 0;
 	
-	NSURL *directoryURL = [self URLForMode:mode type:type format:format];
+	dispatch_async(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 	
-	// This method can get called alot thanks to the disk monitors we have setup.
-	// So we limit the number of passes per directory to one-at-a-time.
-	//
-	BOOL hasPendingRefresh = NO;
-	YAPUnfairLockLock(&spinlock);
-	{
-		if ([pendingRefresh containsObject:directoryURL]) {
-			hasPendingRefresh = YES;
-		} else {
-			[pendingRefresh addObject:directoryURL];
+		if (fd >= 0)
+		{
+			close(fd);
+			fd = -1;
 		}
-	}
-	YAPUnfairLockUnlock(&spinlock);
+		
+		[[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil];
 	
-	if (hasPendingRefresh) {
-		return;
-	}
+	#pragma clang diagnostic pop
+	}});
+}
+
+/**
+ * Must be invoked from within the queue.
+ */
+- (void)writeData:(NSData *)data
+{
+	const uint8_t *ptr = (const uint8_t *)data.bytes;
+	size_t remaining = data.length;
 	
-	__weak typeof(self) weakSelf = self;
-	dispatch_async(refreshQueue, ^{ @autoreleasepool {
-		
-		__strong typeof(self) strongSelf = weakSelf;
-		if (strongSelf == nil) return;
-		
-		YAPUnfairLockLock(&strongSelf->spinlock);
+	while (remaining > 0)
+	{
+		ssize_t written = write(fd, ptr, remaining);
+		if (written < 0)
 		{
-			[strongSelf->pendingRefresh removeObject:directoryURL];
+			if (errno == EINTR) continue;
+			
+			ZDCLogWarn(@"Error writing journal: %d", errno);
+			return;
 		}
-		YAPUnfairLockUnlock(&strongSelf->spinlock);
 		
-		NSDirectoryEnumerationOptions options =
-		  NSDirectoryEnumerationSkipsSubdirectoryDescendants |
- 		  NSDirectoryEnumerationSkipsPackageDescendants      |
-		  NSDirectoryEnumerationSkipsHiddenFiles;
-		
-		NSArray<NSString *> *keys = @[
-			NSURLFileSizeKey,
-			NSURLContentAccessDateKey,
-			NSURLContentModificationDateKey
-		];
-		
-		NSDirectoryEnumerator<NSURL *> *enumerator =
-		  [[NSFileManager defaultManager] enumeratorAtURL: directoryURL
-		                       includingPropertiesForKeys: keys
-		                                          options: options
-		                                     errorHandler: NULL];
+		ptr += written;
+		remaining -= written;
+	}
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface ZDCFileRetainToken : NSObject
+
+- (instancetype)initWithInfo:(ZDCFileInfo *)info owner:(ZDCDiskManager *)owner;
+
+@end
+
+@implementation ZDCFileRetainToken
+{
+	__strong ZDCFileInfo *info;
+	__strong ZDCDiskSlab *slab; // keeps a retired slab's file around while the cryptoFile may still read from it
+	__strong ZDCDiskBlob *blob; // keeps a retired blob's file around while the cryptoFile may still read from it
+	__weak ZDCDiskManager *owner;
+}
+
+- (instancetype)initWithInfo:(ZDCFileInfo *)inInfo owner:(ZDCDiskManager *)inOwner
+{
+	if ((self = [super init]))
+	{
+		info = inInfo;
+		slab = inInfo.slabEntry.slab;
+		blob = inInfo.blob;
+		owner = inOwner;
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	[owner decrementRetainCountForInfo:info];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation ZDCDiskManager
+{
+	__weak ZeroDarkCloud *zdc;
+	
+	dispatch_queue_t cacheQueue;
+	void *IsOnCacheQueueKey;
+	
+	dispatch_queue_t refreshQueue;
+	void *IsOnRefreshQueueKey;
+	
+	NSFileManager *fileManager;
+	
+	NSURL *persistentContainerURL;
+	NSURL *cacheContainerURL;
+	
+	NSMutableArray<ZDCFilesystemMonitor*> *monitors;
+	
+	// The following variables can only be read/modified within cacheQueue:
+	
+	NSMutableDictionary<NSString *, NSMutableArray<ZDCFileInfo *> *> *dict_nodeData;       // key: nodeID
+	NSMutableDictionary<NSString *, NSMutableArray<ZDCFileInfo *> *> *dict_nodeThumbnails; // key: nodeID
+	NSMutableDictionary<NSString *, NSMutableArray<ZDCFileInfo *> *> *dict_userAvatars;    // key: userID
+	
+	ZDCFileInfoLRU *lru_nodeData;       // cache pool (ZDCStorageMode_Cache) for dict_nodeData
+	ZDCFileInfoLRU *lru_nodeThumbnails; // cache pool (ZDCStorageMode_Cache) for dict_nodeThumbnails
+	ZDCFileInfoLRU *lru_userAvatars;    // cache pool (ZDCStorageMode_Cache) for dict_userAvatars
+	
+	ZDCFileInfoLRU *window_nodeData;       // recently added items (ZDCDiskCachePolicy_TinyLFU only)
+	ZDCFileInfoLRU *window_nodeThumbnails; // recently added items (ZDCDiskCachePolicy_TinyLFU only)
+	ZDCFileInfoLRU *window_userAvatars;    // recently added items (ZDCDiskCachePolicy_TinyLFU only)
+	
+	ZDCFrequencySketch *frequencies_nodeData;       // access frequencies for dict_nodeData
+	ZDCFrequencySketch *frequencies_nodeThumbnails; // access frequencies for dict_nodeThumbnails
+	ZDCFrequencySketch *frequencies_userAvatars;    // access frequencies for dict_userAvatars
+	
+	ZDCDiskCachePolicy cachePolicy_nodeData;
+	ZDCDiskCachePolicy cachePolicy_nodeThumbnails;
+	ZDCDiskCachePolicy cachePolicy_userAvatars;
+	
+	ZDCExpirationHeap *expirations_nodeData;       // expiring items in dict_nodeData
+	ZDCExpirationHeap *expirations_nodeThumbnails; // expiring items in dict_nodeThumbnails
+	ZDCExpirationHeap *expirations_userAvatars;    // expiring items in dict_userAvatars
+	
+	ZDCStorageCounter *storageCounters[2][3][3]; // [mode][type][format]
+	NSDate *lastStorageReconciliation;
+	
+	ZDCDiskJournal *journal;
+	NSMutableDictionary<NSString*, id> *pendingJournal; // key => ZDCFileInfo (put) || NSNull (remove)
+	BOOL journalFlushPending;
+	BOOL journalStale; // lastAccessed dates have changed since last compaction
+	
+	ZDCDiskSlabStore *slabs_nodeThumbnails; // packed items in the (Cache, NodeThumbnail, CacheFile) directory
+	ZDCDiskSlabStore *slabs_userAvatars;    // packed items in the (Cache, UserAvatar, CacheFile) directory
+	BOOL slabCompactionPending;
+	
+	ZDCDiskBlobStore *blobs_nodeData;       // deduplicated items in the (Cache, NodeData, CacheFile) directory
+	ZDCDiskBlobStore *blobs_nodeThumbnails; // deduplicated items in the (Cache, NodeThumbnail, CacheFile) directory
+	NSData *dedupeSecret;
+	
+	NSMutableSet<NSString*> *changes_nodeData;       // nodeID's
+	NSMutableSet<NSString*> *changes_nodeThumbnails; // nodeID's
+	NSMutableSet<NSString*> *changes_userAvatars;    // userID's
+	
+	NSSet<NSString*> *uploadQueue_nodeIDs;
+	
+	BOOL notificationPending;
+	
+	dispatch_source_t expirationTimer;
+	BOOL expirationTimerSuspended;
+	NSDate *nextExpirationDate;
+	NSDate *nextExpirationDate_nodeData;
+	NSDate *nextExpirationDate_nodeThumbnails;
+	NSDate *nextExpirationDate_userAvatars;
+	
+	YAPUnfairLock spinlock;
+	NSMutableSet<NSURL*> *pendingRefresh;
+}
+
+@dynamic maxNodeDataCacheSize;
+@dynamic maxNodeThumbnailsCacheSize;
+@dynamic maxUserAvatarsCacheSize;
+
+@dynamic defaultNodeDataCacheExpiration;
+@dynamic defaultNodeThumbnailCacheExpiration;
+@dynamic defaultUserAvatarCacheExpiration;
+
+- (instancetype)init
+{
+	return nil; // To access this class use: ZeroDarkCloud.diskManager
+}
+
+- (instancetype)initWithOwner:(ZeroDarkCloud *)inOwner
+{
+	if ((self = [super init]))
+	{
+		zdc = inOwner;
+		
+		cacheQueue   = dispatch_queue_create("DiskManager_cache", DISPATCH_QUEUE_SERIAL);
+		refreshQueue = dispatch_queue_create("DiskManager_refresh", DISPATCH_QUEUE_SERIAL);
+		
+		IsOnCacheQueueKey = &IsOnCacheQueueKey;
+		dispatch_queue_set_specific(cacheQueue, IsOnCacheQueueKey, IsOnCacheQueueKey, NULL);
+		
+		IsOnRefreshQueueKey = &IsOnRefreshQueueKey;
+		dispatch_queue_set_specific(refreshQueue, IsOnRefreshQueueKey, IsOnRefreshQueueKey, NULL);
+		
+		fileManager = [[NSFileManager alloc] init];
+		fileManager.delegate = self;
+		
+		NSString *databaseName = [zdc.databasePath lastPathComponent];
+		persistentContainerURL = [ZDCDirectoryManager zdcPersistentDataDirectoryForDatabaseName:databaseName];
+		cacheContainerURL      = [ZDCDirectoryManager zdcCacheDataDirectoryForDatabaseName:databaseName];
+		
+		dict_nodeData       = [[NSMutableDictionary alloc] init];
+		dict_nodeThumbnails = [[NSMutableDictionary alloc] init];
+		dict_userAvatars    = [[NSMutableDictionary alloc] init];
+		
+		lru_nodeData       = [[ZDCFileInfoLRU alloc] init];
+		lru_nodeThumbnails = [[ZDCFileInfoLRU alloc] init];
+		lru_userAvatars    = [[ZDCFileInfoLRU alloc] init];
+		
+		window_nodeData       = [[ZDCFileInfoLRU alloc] init];
+		window_nodeThumbnails = [[ZDCFileInfoLRU alloc] init];
+		window_userAvatars    = [[ZDCFileInfoLRU alloc] init];
+		
+		frequencies_nodeData       = [[ZDCFrequencySketch alloc] initWithCapacity:kFrequencySketchMinCapacity];
+		frequencies_nodeThumbnails = [[ZDCFrequencySketch alloc] initWithCapacity:kFrequencySketchMinCapacity];
+		frequencies_userAvatars    = [[ZDCFrequencySketch alloc] initWithCapacity:kFrequencySketchMinCapacity];
+		
+		expirations_nodeData       = [[ZDCExpirationHeap alloc] init];
+		expirations_nodeThumbnails = [[ZDCExpirationHeap alloc] init];
+		expirations_userAvatars    = [[ZDCExpirationHeap alloc] init];
+		
+		for (NSUInteger m = 0; m < 2; m++) {
+			for (NSUInteger t = 0; t < 3; t++) {
+				for (NSUInteger f = 0; f < 3; f++) {
+					storageCounters[m][t][f] = [[ZDCStorageCounter alloc] init];
+				}
+			}
+		}
+		
+		changes_nodeData       = [[NSMutableSet alloc] init];
+		changes_nodeThumbnails = [[NSMutableSet alloc] init];
+		changes_userAvatars    = [[NSMutableSet alloc] init];
+		
+		NSURL *journalURL = [persistentContainerURL URLByAppendingPathComponent:kJournalFilename isDirectory:NO];
+		journal = [[ZDCDiskJournal alloc] initWithFileURL:journalURL];
+		pendingJournal = [[NSMutableDictionary alloc] init];
+		
+		NSURL *thumbnailsURL =
+		  [self URLForMode:ZDCStorageMode_Cache type:ZDCFileType_NodeThumbnail format:ZDCCryptoFileFormat_CacheFile];
+		NSURL *avatarsURL =
+		  [self URLForMode:ZDCStorageMode_Cache type:ZDCFileType_UserAvatar format:ZDCCryptoFileFormat_CacheFile];
+		
+		slabs_nodeThumbnails = [[ZDCDiskSlabStore alloc] initWithDirectoryURL:
+		  [thumbnailsURL URLByAppendingPathComponent:kSubDirectoryName_Slabs isDirectory:YES]];
+		slabs_userAvatars = [[ZDCDiskSlabStore alloc] initWithDirectoryURL:
+		  [avatarsURL URLByAppendingPathComponent:kSubDirectoryName_Slabs isDirectory:YES]];
+		
+		NSURL *nodeDataURL =
+		  [self URLForMode:ZDCStorageMode_Cache type:ZDCFileType_NodeData format:ZDCCryptoFileFormat_CacheFile];
+		
+		blobs_nodeData = [[ZDCDiskBlobStore alloc] initWithDirectoryURL:
+		  [nodeDataURL URLByAppendingPathComponent:kSubDirectoryName_Blobs isDirectory:YES]];
+		blobs_nodeThumbnails = [[ZDCDiskBlobStore alloc] initWithDirectoryURL:
+		  [thumbnailsURL URLByAppendingPathComponent:kSubDirectoryName_Blobs isDirectory:YES]];
+		
+		notificationPending = NO;
+		
+		spinlock = YAP_UNFAIR_LOCK_INIT;
+		pendingRefresh = [[NSMutableSet alloc] init];
+		
+	#if TARGET_OS_IPHONE && !TARGET_EXTENSION
+		[[NSNotificationCenter defaultCenter] addObserver: self
+		                                         selector: @selector(applicationWillEnterForeground:)
+		                                             name: UIApplicationWillEnterForegroundNotification
+		                                           object: [UIApplication sharedApplication]];
+		
+		[[NSNotificationCenter defaultCenter] addObserver: self
+		                                         selector: @selector(applicationDidEnterBackground:)
+		                                             name: UIApplicationDidEnterBackgroundNotification
+		                                           object: [UIApplication sharedApplication]];
+	#endif
+		
+		[[NSNotificationCenter defaultCenter] addObserver: self
+		                                         selector: @selector(databaseModified:)
+		                                             name: YapDatabaseModifiedNotification
+		                                           object: zdc.databaseManager.database];
+		
+		[[NSNotificationCenter defaultCenter] addObserver: self
+		                                         selector: @selector(pipelineQueueChanged:)
+		                                             name: YDBCloudCorePipelineQueueChangedNotification
+		                                           object: nil];
+		
+		// Prepare directories,
+		// and populate cache with whatever we find on the file system.
+		
+		dispatch_async(cacheQueue, ^{ @autoreleasepool {
+			
+			NSArray<NSArray*> *list = @[
+				@[ @(ZDCStorageMode_Persistent), @(ZDCFileType_NodeData),      @(ZDCCryptoFileFormat_CacheFile) ],
+				@[ @(ZDCStorageMode_Persistent), @(ZDCFileType_NodeData),      @(ZDCCryptoFileFormat_CloudFile) ],
+				@[ @(ZDCStorageMode_Cache),      @(ZDCFileType_NodeData),      @(ZDCCryptoFileFormat_CacheFile) ],
+				@[ @(ZDCStorageMode_Cache),      @(ZDCFileType_NodeData),      @(ZDCCryptoFileFormat_CloudFile) ],
+				@[ @(ZDCStorageMode_Persistent), @(ZDCFileType_NodeThumbnail), @(ZDCCryptoFileFormat_CacheFile) ],
+				@[ @(ZDCStorageMode_Cache),      @(ZDCFileType_NodeThumbnail), @(ZDCCryptoFileFormat_CacheFile) ],
+				@[ @(ZDCStorageMode_Persistent), @(ZDCFileType_UserAvatar),    @(ZDCCryptoFileFormat_CacheFile) ],
+				@[ @(ZDCStorageMode_Cache),      @(ZDCFileType_UserAvatar),    @(ZDCCryptoFileFormat_CacheFile) ],
+			];
+			
+			[self createDirectories:list];
+			[self setupFilesystemMonitors:list];
+			[self openSlabStores];
+			[self openBlobStores];
+			
+			[self loadDefaultExpirations];
+			[self loadCachePolicies];
+			
+			// Restore as much as we can from the journal,
+			// and only scan the directories the journal can't vouch for.
+			
+			NSArray<NSArray*> *scanList = [self restoreFromJournal:list];
+			[self restorePackedInfos];
+			[self removeUnreferencedBlobs];
+			[self scanDirectories:scanList];
+			
+			[self launchCleanup];
+		}});
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	[monitors removeAllObjects];
+	
+	// Deallocating a suspended timer will cause a crash
+	if (expirationTimer && expirationTimerSuspended)
+	{
+		expirationTimerSuspended = NO;
+		dispatch_resume(expirationTimer);
+	}
+	
+	[[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark URL Utilities
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSURL *)URLForMode:(ZDCStorageMode)mode type:(ZDCFileType)type format:(ZDCCryptoFileFormat)format
+{
+	if (format == ZDCCryptoFileFormat_Unknown) {
+		return nil;
+	}
+	
+	switch (type)
+	{
+		case ZDCFileType_NodeData:
+		{
+			NSURL *parent = (mode == ZDCStorageMode_Persistent) ? persistentContainerURL : cacheContainerURL;
+			NSURL *anchor = [parent URLByAppendingPathComponent:kSubDirectoryName_NodeData isDirectory:YES];
+			
+			NSString *subDirName = nil;
+			switch (format)
+			{
+				case ZDCCryptoFileFormat_CacheFile : subDirName = kSubDirectoryName_CacheFile; break;
+				case ZDCCryptoFileFormat_CloudFile : subDirName = kSubDirectoryName_Cloudfile; break;
+				default : break;
+			}
+			
+			return [anchor URLByAppendingPathComponent:subDirName isDirectory:YES];
+		}
+		case ZDCFileType_NodeThumbnail:
+		{
+			NSURL *parent = (mode == ZDCStorageMode_Persistent) ? persistentContainerURL : cacheContainerURL;
+			NSURL *anchor = [parent URLByAppendingPathComponent:kSubDirectoryName_NodeThumbnails isDirectory:YES];
+			
+			switch (format)
+			{
+				case ZDCCryptoFileFormat_CacheFile : return anchor;
+				default                            : return nil;
+			}
+		}
+		case ZDCFileType_UserAvatar:
+		{
+			NSURL *parent = (mode == ZDCStorageMode_Persistent) ? persistentContainerURL : cacheContainerURL;
+			NSURL *anchor = [parent URLByAppendingPathComponent:kSubDirectoryName_UserAvatars isDirectory:YES];
+			
+			switch (format)
+			{
+				case ZDCCryptoFileFormat_CacheFile : return anchor;
+				default                            : return nil;
+			}
+		}
+	}
+	
+	return nil;
+}
+
+- (BOOL)getMode:(ZDCStorageMode *)modePtr
+           type:(ZDCFileType *)typePtr
+         format:(ZDCCryptoFileFormat *)formatPtr
+     forFileURL:(NSURL *)fileURL
+{
+	NSURL *parentURL = [fileURL URLByDeletingLastPathComponent];
+	NSString *parentName = [parentURL lastPathComponent];
+	
+	if (parentName && ([parentName isEqualToString:kSubDirectoryName_Slabs] ||
+	                   [parentName isEqualToString:kSubDirectoryName_Blobs]))
+	{
+		// Path is: /<?>/<type>/.slabs/<slab>
+		//      or: /<?>/<type>/.blobs/<blob>
+		//
+		// A slab contains packed items for the <type> directory (and a blob contains deduplicated items).
+		// So we treat it as if it were a file within that directory.
+		
+		parentURL = [parentURL URLByDeletingLastPathComponent];
+		parentName = [parentURL lastPathComponent];
+	}
+	
+	ZDCStorageMode mode = ZDCStorageMode_Cache;
+	ZDCFileType type = ZDCFileType_NodeData;
+	ZDCCryptoFileFormat format = ZDCCryptoFileFormat_Unknown;
+	
+	if (!parentURL || !parentName)
+	{
+		if (modePtr) *modePtr = mode;
+		if (typePtr) *typePtr = type;
+		if (formatPtr) *formatPtr = format;
+		return NO;
+	}
+	
+	NSURL *containerURL = nil;
+	
+	if ([parentName caseInsensitiveCompare:kSubDirectoryName_CacheFile] == NSOrderedSame)
+	{
+		NSURL *grandParentURL = [parentURL URLByDeletingLastPathComponent];
+		NSString *grandParentName = [grandParentURL lastPathComponent];
+		
+		if (grandParentName && [grandParentName caseInsensitiveCompare:kSubDirectoryName_NodeData] == NSOrderedSame)
+		{
+			// Path is: /<?>/nodeData/cachefile/<filename>
+			
+			format = ZDCCryptoFileFormat_CacheFile;
+			type = ZDCFileType_NodeData;
+			
+			// We still need to know if <?> is either:
+			// - cacheContainerURL
+			// - persistentContainerURL
+			
+			containerURL = [grandParentURL URLByDeletingLastPathComponent];
+		}
+	}
+	else if ([parentName caseInsensitiveCompare:kSubDirectoryName_Cloudfile] == NSOrderedSame)
+	{
+		NSURL *grandParentURL = [parentURL URLByDeletingLastPathComponent];
+		NSString *grandParentName = [grandParentURL lastPathComponent];
+		
+		if (grandParentName && [grandParentName caseInsensitiveCompare:kSubDirectoryName_NodeData] == NSOrderedSame)
+		{
+			// Path is: /<?>/nodeData/cloudfile/<filename>
+			
+			format = ZDCCryptoFileFormat_CloudFile;
+			type = ZDCFileType_NodeData;
+			
+			// We still need to know if <?> is either:
+			// - cacheContainerURL
+			// - persistentContainerURL
+			
+			containerURL = [grandParentURL URLByDeletingLastPathComponent];
+		}
+	}
+	else if ([parentName caseInsensitiveCompare:kSubDirectoryName_NodeThumbnails] == NSOrderedSame)
+	{
+		// Path is? /<?>/nodeThumbnails/<filename>
+		
+		format = ZDCCryptoFileFormat_CacheFile;
+		type = ZDCFileType_NodeThumbnail;
+		
+		// We still need to know if <?> is either:
+		// - cacheContainerURL
+		// - persistentContainerURL
+		
+		containerURL = [parentURL URLByDeletingLastPathComponent];
+	}
+	else if ([parentName caseInsensitiveCompare:kSubDirectoryName_UserAvatars] == NSOrderedSame)
+	{
+		// Path is? /<?>/avatars/<filename>
+		
+		format = ZDCCryptoFileFormat_CacheFile;
+		type = ZDCFileType_UserAvatar;
+		
+		// We still need to know if <?> is either:
+		// - cacheContainerURL
+		// - persistentContainerURL
+		
+		containerURL = [parentURL URLByDeletingLastPathComponent];
+	}
+	
+	BOOL result = NO;
+	
+	if (containerURL)
+	{
+		if ([containerURL isEqual:cacheContainerURL])
+		{
+			mode = ZDCStorageMode_Cache;
+			result = YES;
+		}
+		else if ([containerURL isEqual:persistentContainerURL])
+		{
+			mode = ZDCStorageMode_Persistent;
+			result = YES;
+		}
+		else
+		{
+			// NSURL might be misbehaving.
+			// When this happens we resort to comparing iNodes.
+			
+			id iNode = nil;
+			[containerURL getResourceValue:&iNode forKey:NSURLFileResourceIdentifierKey error:nil];
+			
+			id c_iNode = nil;
+			[cacheContainerURL removeCachedResourceValueForKey:NSURLFileResourceIdentifierKey];
+			[cacheContainerURL getResourceValue:&c_iNode forKey:NSURLFileResourceIdentifierKey error:nil];
+			
+			if ([iNode isEqual:c_iNode])
+			{
+				mode = ZDCStorageMode_Cache;
+				result = YES;
+			}
+			else
+			{
+				id p_iNode = nil;
+				[persistentContainerURL removeCachedResourceValueForKey:NSURLFileResourceIdentifierKey];
+				[persistentContainerURL getResourceValue:&p_iNode forKey:NSURLFileResourceIdentifierKey error:nil];
+				
+				if ([iNode isEqual:p_iNode])
+				{
+					mode = ZDCStorageMode_Persistent;
+					result = YES;
+				}
+			}
+		}
+	}
+	
+	if (modePtr) *modePtr = mode;
+	if (typePtr) *typePtr = type;
+	if (formatPtr) *formatPtr = format;
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Notifications - Incoming
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if TARGET_OS_IPHONE && !TARGET_EXTENSION
+- (void)applicationWillEnterForeground:(NSNotification *)notification
+{
+	[self scanCacheDirectories];
+}
+
+- (void)applicationDidEnterBackground:(NSNotification *)notification
+{
+	dispatch_async(cacheQueue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	
+		// Persist the latest lastAccessed dates (which aren't journaled individually).
+		// This is our last chance to do so, as we may be killed while suspended.
+		
+		if (journalStale || (journal.appendedRecordCount > 0)) {
+			[self compactJournal];
+		}
+	
+	#pragma clang diagnostic pop
+	}});
+}
+#endif
+
+- (void)databaseModified:(NSNotification *)notification
+{
+	YapSet *deletedItems = notification.userInfo[YapDatabaseRemovedKeysKey];
+	YapSet *modifiedItems = notification.userInfo[YapDatabaseObjectChangesKey];
+	
+	if (deletedItems.count > 0)
+	{
+		__block NSMutableArray<NSString*> *deletedNodeIDs = nil;
+		__block NSMutableArray<NSString*> *deletedUserIDs = nil;
+	
+		for (YapCollectionKey *ck in deletedItems)
+		{
+			__unsafe_unretained NSString *collection = ck.collection;
+	
+			if ([collection isEqualToString:kZDCCollection_Nodes])
+			{
+				if (deletedNodeIDs == nil) {
+					deletedNodeIDs = [NSMutableArray array];
+				}
+				[deletedNodeIDs addObject:ck.key];
+			}
+			else if ([collection isEqualToString:kZDCCollection_Users])
+			{
+				if (deletedUserIDs == nil) {
+					deletedUserIDs = [NSMutableArray array];
+				}
+				[deletedUserIDs addObject:ck.key];
+			}
+		}
+	
+		if (deletedNodeIDs.count > 0)
+		{
+			[self deleteNodeDataForNodeIDs:deletedNodeIDs];
+		}
+		if (deletedUserIDs.count > 0)
+		{
+			[self deleteUserAvatarsForUserIDs:deletedUserIDs];
+		}
+	}
+	
+	if (modifiedItems.count > 0)
+	{
+		__block NSMutableArray<NSString*> *modifiedUserIDs = nil;
+		
+		for (YapCollectionKey *ck in deletedItems)
+		{
+			__unsafe_unretained NSString *collection = ck.collection;
+			
+			if ([collection isEqualToString:kZDCCollection_Users])
+			{
+				if (modifiedUserIDs == nil) {
+					modifiedUserIDs = [NSMutableArray array];
+				}
+				[modifiedUserIDs addObject:ck.key];
+			}
+		}
+		
+		if (modifiedUserIDs.count > 0)
+		{
+			NSMutableDictionary<NSString*, NSSet<NSString*> *> *auth0IDs =
+			  [NSMutableDictionary dictionaryWithCapacity:modifiedUserIDs.count];
+			
+			__weak typeof(self) weakSelf = self;
+			[zdc.databaseManager.roDatabaseConnection asyncReadWithBlock:^(YapDatabaseReadTransaction *transaction) {
+				
+				for (NSString *userID in modifiedUserIDs)
+				{
+					ZDCUser *user = [transaction objectForKey:userID inCollection:kZDCCollection_Users];
+					if (user)
+					{
+						NSMutableArray *identityIDs = [NSMutableArray arrayWithCapacity:user.identities.count];
+						for (ZDCUserIdentity *ident in user.identities)
+						{
+							[identityIDs addObject:ident.identityID];
+						}
+						
+						auth0IDs[userID] = [NSSet setWithArray:identityIDs];
+					}
+				}
+				
+			} completionQueue:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0) completionBlock:^{
+				
+				__strong typeof(self) strongSelf = weakSelf;
+				if (strongSelf == nil) return;
+				
+				for (NSString *userID in auth0IDs)
+				{
+					[strongSelf deleteUserAvatars:userID excluding:auth0IDs[userID]];
+				}
+			}];
+		}
+	}
+}
+
+- (void)pipelineQueueChanged:(NSNotification *)notification
+{
+	YapDatabaseCloudCorePipeline *pipeline = (YapDatabaseCloudCorePipeline *)notification.object;
+	YapDatabaseCloudCore *cloudCore = pipeline.owner;
+	
+	if (![cloudCore isKindOfClass:[ZDCCloud class]]) {
+		return;
+	}
+	
+	NSMutableSet<NSString*> *nodeIDs = [NSMutableSet set];
+	
+	[pipeline enumerateOperationsUsingBlock:
+	^(YapDatabaseCloudCoreOperation *operation, NSUInteger graphIdx, BOOL *stop)
+	{
+		__unsafe_unretained ZDCCloudOperation *op = (ZDCCloudOperation *)operation;
+		
+		if (op.nodeID &&
+		   (op.type == ZDCCloudOperationType_Put) &&
+		   (op.putType == ZDCCloudOperationPutType_Node_Data))
+		{
+			[nodeIDs addObject:op.nodeID];
+		}
+	}];
+	
+	__weak typeof(self) weakSelf = self;
+	dispatch_async(cacheQueue, ^{ @autoreleasepool {
+		
+		[weakSelf migrateOrDeleteAfterUpload:nodeIDs];
+	}});
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Notifications - Outgoing
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)postDiskManagerChangedNotification
+{
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
+	
+	if (notificationPending) {
+		return; // already dispatched, still pending execution
+	}
+	notificationPending = YES;
+	
+	dispatch_async(dispatch_get_main_queue(), ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		__block ZDCDiskManagerChanges *changes = nil;
+		
+		dispatch_sync(cacheQueue, ^{ @autoreleasepool {
+
+			if (changes_nodeData.count       > 0 ||
+			    changes_nodeThumbnails.count > 0 ||
+			    changes_userAvatars.count    > 0)
+			{
+				changes = [[ZDCDiskManagerChanges alloc] init];
+				
+				changes.changedNodeIDs = [changes_nodeData setByAddingObjectsFromSet:changes_nodeThumbnails];
+				changes.changedNodeData = [changes_nodeData copy];
+				changes.changedNodeThumbnails = [changes_nodeThumbnails copy];
+				changes.changedUsersIDs = [changes_userAvatars copy];
+				
+				[changes_nodeData removeAllObjects];
+				[changes_nodeThumbnails removeAllObjects];
+				[changes_userAvatars removeAllObjects];
+			}
+			
+			notificationPending = NO;
+		}});
+		
+		if (changes)
+		{
+			NSDictionary *userInfo = @{ kZDCDiskManagerChanges : changes };
+			
+			[[NSNotificationCenter defaultCenter] postNotificationName: ZDCDiskManagerChangedNotification
+			                                                    object: self
+			                                                  userInfo: userInfo];
+		}
+		
+	#pragma clang diagnostic pop
+	});
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark NSFileManagerDelegate
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (BOOL)fileManager:(NSFileManager *)fileManager shouldProceedAfterError:(NSError *)error
+                                                         movingItemAtURL:(NSURL *)srcURL
+                                                                   toURL:(NSURL *)dstURL
+{
+	// Error code for: The operation couldn’t be completed. File exists
+	if ([error code] == NSFileWriteFileExistsError)
+		return YES;
+	else
+		return NO;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Utilities
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)createDirectories:(NSArray<NSArray *> *)list
+{
+	for (NSArray *tuple in list)
+	{
+		ZDCStorageMode mode        = [tuple[0] integerValue];
+		ZDCFileType type           = [tuple[1] integerValue];
+		ZDCCryptoFileFormat format = [tuple[2] integerValue];
+		
+		NSURL *url = [self URLForMode:mode type:type format:format];
+		NSAssert(url != nil, @"Bad <mode, type, format> tuple");
+	
+		NSError *error = nil;
+		[[NSFileManager defaultManager] createDirectoryAtURL: url
+		                         withIntermediateDirectories: YES
+		                                          attributes: nil
+		                                               error: &error];
+	
+		if (error) {
+			ZDCLogError(@"Error creating directory: %@", error);
+		}
+	}
+}
+
+- (void)setupFilesystemMonitors:(NSArray<NSArray *> *)list
+{
+	monitors = [NSMutableArray arrayWithCapacity:list.count];
+	
+	__weak typeof(self) weakSelf = self;
+	for (NSArray *tuple in list)
+	{
+		ZDCStorageMode mode        = [tuple[0] integerValue];
+		ZDCFileType type           = [tuple[1] integerValue];
+		ZDCCryptoFileFormat format = [tuple[2] integerValue];
+		
+		NSURL *url = [self URLForMode:mode type:type format:format];
+		
+		ZDCFilesystemMonitor *monitor = [[ZDCFilesystemMonitor alloc] initWithDirectoryURL:url];
+		
+		[monitor monitorWithMask: [ZDCFilesystemMonitor vnode_flags_all]
+		                   queue: dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0)
+		                   block:^(dispatch_source_vnode_flags_t mask)
+		{
+			[weakSelf scanDirectoryWithMode:mode type:type format:format];
+		}];
+		
+		[monitors addObject:monitor];
+	}
+}
+
+- (void)scanDirectories:(NSArray<NSArray *> *)list
+{
+	for (NSArray *tuple in list)
+	{
+		ZDCStorageMode mode        = [tuple[0] integerValue];
+		ZDCFileType type           = [tuple[1] integerValue];
+		ZDCCryptoFileFormat format = [tuple[2] integerValue];
+		
+		[self scanDirectoryWithMode:mode type:type format:format];
+	}
+}
+
+- (void)scanCacheDirectories
+{
+	// cache + nodeData      + cacheFile
+	// cache + nodeData      + cloudFile
+	// cache + nodeThumbnail + cacheFile
+	// cache + userAvatar    + cacheFile
+	
+	[self scanDirectoryWithMode: ZDCStorageMode_Cache
+	                       type: ZDCFileType_NodeData
+	                     format: ZDCCryptoFileFormat_CacheFile];
+	
+	[self scanDirectoryWithMode: ZDCStorageMode_Cache
+	                       type: ZDCFileType_NodeData
+	                     format: ZDCCryptoFileFormat_CloudFile];
+	
+	[self scanDirectoryWithMode: ZDCStorageMode_Cache
+	                       type: ZDCFileType_NodeThumbnail
+	                     format: ZDCCryptoFileFormat_CacheFile];
+	
+	[self scanDirectoryWithMode: ZDCStorageMode_Cache
+	                       type: ZDCFileType_UserAvatar
+	                     format: ZDCCryptoFileFormat_CacheFile];
+}
+
+- (void)scanOfflineDirectories
+{
+	// persistent + nodeData      + cacheFile
+	// persistent + nodeData      + cloudFile
+	// persistent + nodeThumbnail + cacheFile
+	// persistent + userAvatar    + cacheFile
+	
+	[self scanDirectoryWithMode: ZDCStorageMode_Persistent
+	                       type: ZDCFileType_NodeData
+	                     format: ZDCCryptoFileFormat_CacheFile];
+	
+	[self scanDirectoryWithMode: ZDCStorageMode_Persistent
+	                       type: ZDCFileType_NodeData
+	                     format: ZDCCryptoFileFormat_CloudFile];
+	
+	[self scanDirectoryWithMode: ZDCStorageMode_Persistent
+	                       type: ZDCFileType_NodeThumbnail
+	                     format: ZDCCryptoFileFormat_CacheFile];
+	
+	[self scanDirectoryWithMode: ZDCStorageMode_Persistent
+	                       type: ZDCFileType_UserAvatar
+	                     format: ZDCCryptoFileFormat_CacheFile];
+}
+
+/**
+ * Scans the corresponding directory, and ensures a ZDCFileInfo is created for each corresponding cached file.
+ * Also deletes files from disk that no longer correspond to an item in the database.
+ * And deletes ZDCFileInfo entries that no longer have a corresponding item on the file system.
+**/
+- (void)scanDirectoryWithMode:(ZDCStorageMode)mode type:(ZDCFileType)type format:(ZDCCryptoFileFormat)format
+{
+	ZDCLogAutoTrace();
+	
+	NSURL *directoryURL = [self URLForMode:mode type:type format:format];
+	
+	// This method can get called alot thanks to the disk monitors we have setup.
+	// So we limit the number of passes per directory to one-at-a-time.
+	//
+	BOOL hasPendingRefresh = NO;
+	YAPUnfairLockLock(&spinlock);
+	{
+		if ([pendingRefresh containsObject:directoryURL]) {
+			hasPendingRefresh = YES;
+		} else {
+			[pendingRefresh addObject:directoryURL];
+		}
+	}
+	YAPUnfairLockUnlock(&spinlock);
+	
+	if (hasPendingRefresh) {
+		return;
+	}
+	
+	__weak typeof(self) weakSelf = self;
+	dispatch_async(refreshQueue, ^{ @autoreleasepool {
+		
+		__strong typeof(self) strongSelf = weakSelf;
+		if (strongSelf == nil) return;
+		
+		YAPUnfairLockLock(&strongSelf->spinlock);
+		{
+			[strongSelf->pendingRefresh removeObject:directoryURL];
+		}
+		YAPUnfairLockUnlock(&strongSelf->spinlock);
+		
+		NSDirectoryEnumerationOptions options =
+		  NSDirectoryEnumerationSkipsSubdirectoryDescendants |
+ 		  NSDirectoryEnumerationSkipsPackageDescendants      |
+		  NSDirectoryEnumerationSkipsHiddenFiles;
+		
+		NSArray<NSString *> *keys = @[
+			NSURLFileSizeKey,
+			NSURLContentAccessDateKey,
+			NSURLContentModificationDateKey
+		];
+		
+		NSDirectoryEnumerator<NSURL *> *enumerator =
+		  [[NSFileManager defaultManager] enumeratorAtURL: directoryURL
+		                       includingPropertiesForKeys: keys
+		                                          options: options
+		                                     errorHandler: NULL];
+		
+		NSMutableArray<ZDCFileInfo *> *infos = [NSMutableArray array];
+		NSDate *now = [NSDate date];
+		
+		for (NSURL *url in enumerator)
+		{
+			ZDCFileInfo *info = [[ZDCFileInfo alloc] initWithMode:mode type:type format:format fileURL:url];
+			
+			NSNumber *fileSize = nil;
+			[url getResourceValue:&fileSize forKey:NSURLFileSizeKey error:nil];
+			
+			info.fileSize = [fileSize unsignedLongLongValue];
+			
+			NSDate *lastModified = nil;
+			[url getResourceValue:&lastModified forKey:NSURLContentModificationDateKey error:nil];
+			
+			NSDate *lastAccessed = nil;
+			[url getResourceValue:&lastAccessed forKey:NSURLContentAccessDateKey error:nil];
+			
+			info.lastModified = lastModified ?: now;
+			
+			// I read on the Twitters that 'NSURLContentAccessDateKey' may be broken on iOS.
+			// So I'm guarding against that possibility to be safe.
+			//
+			info.lastAccessed = ZDCLaterDate(lastAccessed, lastModified) ?: now;
+			
+			info.migrateAfterUpload = [self shouldMigrateAfterUploadForURL:url];
+			info.deleteAfterUpload = [self shouldDeleteAfterUploadForURL:url];
+			
+			NSTimeInterval expiration = 0;
+			if ([strongSelf getExpiration:&expiration forURL:url]) {
+				info.expiration = expiration;
+			}
+			
+			// We load the (encrypted) eTag here, while we're already reading the file's xattrs.
+			// It's decrypted on demand, the first time somebody asks for it.
+			id encryptedETag = nil;
+			if ([strongSelf getEncryptedETag:&encryptedETag forURL:url]) {
+				info.encryptedETag = encryptedETag;
+			}
+			
+			info.contentDigest = [strongSelf contentDigestForURL:url];
+			
+			[infos addObject:info];
+		}
+		
+		if (type == ZDCFileType_NodeData || type == ZDCFileType_NodeThumbnail)
+		{
+			[strongSelf _updateNodeDictWithInfos: infos
+			                                mode: mode
+			                                type: type
+			                              format: format];
+		}
+		else if (type == ZDCFileType_UserAvatar)
+		{
+			[strongSelf _updateUserDictWithInfos: infos
+			                                mode: mode
+			                                type: type
+			                              format: format];
+		}
+		else
+		{
+			NSAssert(NO, @"Unrecognized type!");
+		}
+	}});
+}
+
+/**
+ * Updates the underlying 'cache' with the given ZDCFileInfo entries
+ * which were created from inspecting the file system.
+ */
+- (void)_updateNodeDictWithInfos:(NSArray<ZDCFileInfo *> *)onDiskInfos
+                            mode:(ZDCStorageMode)mode
+                            type:(ZDCFileType)type
+                          format:(ZDCCryptoFileFormat)format
+{
+	ZDCLogAutoTrace();
+	
+	dispatch_async(cacheQueue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self" // Singleton
+		
+		NSMutableDictionary<NSString *, NSMutableArray<ZDCFileInfo *> *> *dict;
+		if (type == ZDCFileType_NodeData) {
+			dict = dict_nodeData;
+		}
+		else {
+			dict = dict_nodeThumbnails;
+		}
+		
+		NSMutableSet<NSString*> *unprocessedNodeIDs = [NSMutableSet setWithArray:[dict allKeys]];
+		NSMutableSet<NSString*> *changedNodeIDs = [NSMutableSet set];
+		
+		NSMutableArray<ZDCFileInfo*> *cachePoolInfos = [NSMutableArray array];
+		
+		// The 'infos' array represents every item that actually exists on the file system.
+		// However, this is NOT every single file,
+		// it's ONLY the files matching the given <directory, format> tuple.
+		//
+		// We need to do 2 things:
+		// - Ensure there is a ZDCFileInfo entry for every given item.
+		// - Delete every ZDCFileInfo entry that isn't represented in
+		//   the given list (WITH THE SAME DIRECTORY & FORMAT).
+		
+		for (ZDCFileInfo *onDiskInfo in onDiskInfos)
+		{
+			NSString *nodeID = [onDiskInfo.fileURL lastPathComponent];
+			if (nodeID == nil) {
+				continue;
+			}
+			
+			onDiskInfo.nodeID = nodeID;
+			[unprocessedNodeIDs removeObject:nodeID];
+			
+			NSMutableArray<ZDCFileInfo *> *cachedInfos = dict[nodeID];
+			if (cachedInfos == nil)
+			{
+				cachedInfos = [[NSMutableArray alloc] initWithCapacity:1];
+				dict[nodeID] = cachedInfos;
+			}
+			
+			ZDCFileInfo *matchingInfo = nil;
+			for (ZDCFileInfo *existingInfo in cachedInfos)
+			{
+				if ([existingInfo matchesMode:mode type:type format:format])
+				{
+					matchingInfo = existingInfo;
+				}
+			}
+			
+			if (matchingInfo && !matchingInfo.isStoredInDirectory)
+			{
+				// The item is packed into a slab (or references a blob), so the loose file is stale.
+				// (e.g. the app was killed during an import, after storing the new version.)
+				
+				[fileManager removeItemAtURL:onDiskInfo.fileURL error:nil];
+				continue;
+			}
+			
+			// If matchingInfo exists, then leave it be.
+			// We need to preserve the following:
+			// - info.fileRetainCount
+			//
+			if (matchingInfo)
+			{
+				if ((matchingInfo.fileSize != onDiskInfo.fileSize) ||
+				    [onDiskInfo.lastModified isAfter:matchingInfo.lastModified])
+				{
+					// The file was modified outside of an import, so the eTag may have changed too.
+					if (onDiskInfo.encryptedETag && ![onDiskInfo.encryptedETag isEqual:matchingInfo.encryptedETag])
+					{
+						matchingInfo.encryptedETag = onDiskInfo.encryptedETag;
+						matchingInfo.eTag = nil; // decrypted on demand
+					}
+					
+					matchingInfo.contentDigest = onDiskInfo.contentDigest;
+					
+					[self journalInfo:matchingInfo];
+				}
+				
+				matchingInfo.fileSize = onDiskInfo.fileSize;
+				
+				// Merge dates to give us a more accurate picture.
+				//
+				NSDate *lastAccessed = ZDCLaterDate(matchingInfo.lastAccessed, onDiskInfo.lastAccessed);
+				if (![lastAccessed isEqualToDate:matchingInfo.lastAccessed] && matchingInfo.lru)
+				{
+					// Re-insert into the cache pool at the proper position
+					[matchingInfo.lru removeInfo:matchingInfo];
+					[cachePoolInfos addObject:matchingInfo];
+				}
+				
+				matchingInfo.lastAccessed = lastAccessed;
+				matchingInfo.lastModified = ZDCLaterDate(matchingInfo.lastModified, onDiskInfo.lastModified);
+				
+				[self updateExpirationForInfo:matchingInfo];
+			}
+			else // if (matchingInfo == nil)
+			{
+				[cachedInfos addObject:onDiskInfo];
+				[changedNodeIDs addObject:nodeID];
+				[self didAddInfo:onDiskInfo];
+				
+				if (mode == ZDCStorageMode_Cache) {
+					[cachePoolInfos addObject:onDiskInfo];
+				}
+			}
+		}
 		
-		NSMutableArray<ZDCFileInfo *> *infos = [NSMutableArray array];
-		NSDate *now = [NSDate date];
+		// Delete any ZDCFileInfo entry that wasn't represented by the given list (with same directory & format).
+		// These are files that were previously on disk, but have since been deleted.
+		// This could be due to several different things:
+		//
+		// - The OS doing some file system maintenance, usually to make room when disk space gets low.
+		// - The developer manually deleting the file(s).
+		// - On macOS this may also just be the user deleting items in the filesystem.
+		//
+		// Packed & deduplicated items don't live in the directory, so they're never removed here.
+		
+		for (NSString *unprocessedNodeID in unprocessedNodeIDs)
+		{
+			NSMutableArray<ZDCFileInfo *> *cachedInfos = dict[unprocessedNodeID];
+			
+			NSUInteger matchingIndex = NSNotFound;
+			NSUInteger i = 0;
+			
+			for (ZDCFileInfo *cachedInfo in cachedInfos)
+			{
+				if ([cachedInfo matchesMode:mode type:type format:format] && cachedInfo.isStoredInDirectory)
+				{
+					matchingIndex = i;
+					break;
+				}
+				
+				i++;
+			}
+			
+			if (matchingIndex != NSNotFound)
+			{
+				ZDCFileInfo *matchingInfo = cachedInfos[matchingIndex];
+				[self didRemoveInfo:matchingInfo];
+				
+				[cachedInfos removeObjectAtIndex:matchingIndex];
+				[changedNodeIDs addObject:unprocessedNodeID];
+				
+				if (cachedInfos.count == 0) {
+					[dict removeObjectForKey:unprocessedNodeID];
+				}
+			}
+		}
+		
+		if (cachePoolInfos.count > 0)
+		{
+			[self sortInfosByLastAccessed:cachePoolInfos];
+			[[self cachePoolForType:type] mergeInfos:cachePoolInfos];
+		}
+		
+		if (changedNodeIDs.count > 0)
+		{
+			if (dict == dict_nodeData) {
+				[changes_nodeData unionSet:changedNodeIDs];
+			}
+			else {
+				[changes_nodeThumbnails unionSet:changedNodeIDs];
+			}
+			
+			[self postDiskManagerChangedNotification];
+		}
+		
+	#pragma clang diagnostic pop
+	}});
+}
+
+/**
+ * Updates the underlying 'cache' with the given ZDCFileInfo entries
+ * which were created from inspecting the file system.
+ */
+- (void)_updateUserDictWithInfos:(NSArray<ZDCFileInfo *> *)onDiskInfos
+                            mode:(ZDCStorageMode)mode
+                            type:(ZDCFileType)type
+                          format:(ZDCCryptoFileFormat)format
+{
+	ZDCLogAutoTrace();
+	
+	// Dispatch queue considerations:
+	//
+	// We are currently executing within the refreshQueue.
+	// To update `dict_userAvatars`, we need to be executing within the cacheQueue.
+	//
+	// But before we can update the dict, we have a bunch of work to do.
+	// The question is:
+	// - Which queue do we perform the work on ?
+	// - Or should we perform the work in some other queue ?
+	//
+	// We need to perform this work synchronously within the refreshQueue.
+	// This is for 2 reasons:
+	//
+	// 1. We don't want to slow down the cacheQueue,
+	//    which is meant to be used here as a light-weight lock/serialization-primitive.
+	//
+	// 2. The garbageCollection method makes some assumptions about when its safe to perform its task.
+	//    And it doesn't expect any async tasks between the refreshQueue, and updating the dicts.
+	//
+	
+	
+	// The filenames are of the form: <user.random_uuid>.<hashed_auth0ID>
+	
+	NSMutableDictionary<NSString*, NSMutableSet<NSString*> *> *lookup = [NSMutableDictionary dictionary];
+	
+	for (ZDCFileInfo *info in onDiskInfos)
+	{
+		NSString *filename = [info.fileURL lastPathComponent];
+		NSArray<NSString*> *components = [filename componentsSeparatedByString:@"."];
+		
+		if (components.count == 2)
+		{
+			NSString *random_uuid = components[0];
+			NSString *hashed_auth0ID = components[1];
+			
+			NSMutableSet *hashes = lookup[random_uuid];
+			if (hashes == nil)
+			{
+				hashes = [NSMutableSet set];
+				lookup[random_uuid] = hashes;
+			}
+			
+			[hashes addObject:hashed_auth0ID];
+		}
+	}
+	
+	// Now we need to create some mappings like so:
+	//
+	// - map_userID  : key(user.random_uuid) => value(user.uuid)
+	// - map_auth0ID : key(hashed_auth0ID)   => value(auth0ID)
+	
+	NSMutableDictionary<NSString*, NSString*> *map_userID = [NSMutableDictionary dictionary];
+	NSMutableDictionary<NSString*, NSString*> *map_auth0ID = [NSMutableDictionary dictionary];
+	
+	[zdc.databaseManager.roDatabaseConnection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		for (NSString *random_uuid in lookup)
+		{
+			ZDCUser *user = [self findUserWithRandom:random_uuid transaction:transaction];
+			if (user)
+			{
+				map_userID[random_uuid] = user.uuid;
+				
+				NSMutableSet *hashes = lookup[random_uuid];
+				[self findAuth0IDsMatchingHashes:hashes forUser:user withMap:map_auth0ID];
+			}
+		}
+	}];
+	
+	// Now we're going to put everything together for quick processing
+	
+	NSMutableDictionary<NSString*, NSMutableDictionary<NSString*, ZDCFileInfo*> *> *onDiskInfosDict =
+	  [NSMutableDictionary dictionaryWithCapacity:onDiskInfos.count];
+	
+	for (ZDCFileInfo *info in onDiskInfos)
+	{
+		NSString *filename = [info.fileURL lastPathComponent];
+		NSArray<NSString*> *components = [filename componentsSeparatedByString:@"."];
+		
+		if (components.count == 2)
+		{
+			NSString *random_uuid = components[0];
+			NSString *hashed_auth0ID = components[1];
+			
+			NSString *userID  = map_userID[random_uuid];
+			NSString *auth0ID = map_auth0ID[hashed_auth0ID];
+			
+			if (userID && auth0ID)
+			{
+				NSMutableDictionary<NSString*, ZDCFileInfo*> *usersDict = onDiskInfosDict[userID];
+				if (usersDict == nil)
+				{
+					usersDict = [[NSMutableDictionary alloc] init];
+					onDiskInfosDict[userID] = usersDict;
+				}
+				
+				info.userID = userID;
+				info.identityID = auth0ID;
+				
+				usersDict[auth0ID] = info;
+			}
+		}
+	}
+	
+	dispatch_async(cacheQueue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		NSMutableDictionary<NSString *, NSMutableArray<ZDCFileInfo *> *> *dict = dict_userAvatars;
+		
+		NSMutableSet<NSString*> *unprocessedUserIDs = [NSMutableSet setWithArray:[dict allKeys]];
+		NSMutableSet<NSString*> *changedUserIDs = [NSMutableSet set];
+		
+		NSMutableArray<ZDCFileInfo*> *cachePoolInfos = [NSMutableArray array];
+		
+		for (NSString *userID in onDiskInfosDict)
+		{
+			[unprocessedUserIDs removeObject:userID];
+			
+			NSMutableArray<ZDCFileInfo *> *cachedInfos = dict[userID];
+			if (cachedInfos == nil)
+			{
+				cachedInfos = [[NSMutableArray alloc] initWithCapacity:1];
+				dict[userID] = cachedInfos;
+			}
+			
+			NSMutableSet<NSString*> *unprocessedIdentityIDs = [NSMutableSet set];
+			for (ZDCFileInfo *cachedInfo in cachedInfos)
+			{
+				if ([cachedInfo matchesMode:mode type:type format:format] && cachedInfo.identityID && !cachedInfo.slabEntry)
+				{
+					[unprocessedIdentityIDs addObject:cachedInfo.identityID];
+				}
+			}
+			
+			for (NSString *identityID in onDiskInfosDict[userID])
+			{
+				[unprocessedIdentityIDs removeObject:identityID];
+				
+				ZDCFileInfo *matchingInfo = nil;
+				for (ZDCFileInfo *cachedInfo in cachedInfos)
+				{
+					if ([cachedInfo matchesMode:mode type:type format:format identityID:identityID])
+					{
+						matchingInfo = cachedInfo;
+					}
+				}
+				
+				ZDCFileInfo *onDiskInfo = onDiskInfosDict[userID][identityID];
+				
+				if (matchingInfo.slabEntry)
+				{
+					// The item is packed into a slab, so the loose file is stale.
+					
+					[fileManager removeItemAtURL:onDiskInfo.fileURL error:nil];
+					continue;
+				}
+				
+				// If matchingInfo exists, then leave it be.
+				// We need to preserve the following:
+				// - info.fileRetainCount
+				//
+				if (matchingInfo)
+				{
+					if ((matchingInfo.fileSize != onDiskInfo.fileSize) ||
+					    [onDiskInfo.lastModified isAfter:matchingInfo.lastModified])
+					{
+						// The file was modified outside of an import, so the eTag may have changed too.
+						if (onDiskInfo.encryptedETag && ![onDiskInfo.encryptedETag isEqual:matchingInfo.encryptedETag])
+						{
+							matchingInfo.encryptedETag = onDiskInfo.encryptedETag;
+							matchingInfo.eTag = nil; // decrypted on demand
+						}
+						
+						[self journalInfo:matchingInfo];
+					}
+					
+					matchingInfo.fileSize = onDiskInfo.fileSize;
+					
+					// Merge dates to give us a more accurate picture.
+					//
+					NSDate *lastAccessed = ZDCLaterDate(matchingInfo.lastAccessed, onDiskInfo.lastAccessed);
+					if (![lastAccessed isEqualToDate:matchingInfo.lastAccessed] && matchingInfo.lru)
+					{
+						// Re-insert into the cache pool at the proper position
+						[matchingInfo.lru removeInfo:matchingInfo];
+						[cachePoolInfos addObject:matchingInfo];
+					}
+					
+					matchingInfo.lastAccessed = lastAccessed;
+					matchingInfo.lastModified = ZDCLaterDate(matchingInfo.lastModified, onDiskInfo.lastModified);
+					
+					[self updateExpirationForInfo:matchingInfo];
+				}
+				else // if (matchingInfo == nil)
+				{
+					[cachedInfos addObject:onDiskInfo];
+					[changedUserIDs addObject:userID];
+					[self didAddInfo:onDiskInfo];
+					
+					if (mode == ZDCStorageMode_Cache) {
+						[cachePoolInfos addObject:onDiskInfo];
+					}
+				}
+			}
+			
+			for (NSString *unprocessedIdentityID in unprocessedIdentityIDs)
+			{
+				NSUInteger matchingIndex = NSNotFound;
+				NSUInteger i = 0;
+				
+				for (ZDCFileInfo *cachedInfo in cachedInfos)
+				{
+					if ([cachedInfo matchesMode:mode type:type format:format identityID:unprocessedIdentityID])
+					{
+						matchingIndex = i;
+						break;
+					}
+					
+					i++;
+				}
+				
+				if (matchingIndex != NSNotFound)
+				{
+					ZDCFileInfo *matchingInfo = cachedInfos[matchingIndex];
+					[self didRemoveInfo:matchingInfo];
+					
+					[cachedInfos removeObjectAtIndex:matchingIndex];
+					[changedUserIDs addObject:userID];
+					
+					if (cachedInfos.count == 0) {
+						[dict removeObjectForKey:userID];
+					}
+				}
+			}
+		}
 		
-		for (NSURL *url in enumerator)
+		for (NSString *unprocessedUserID in unprocessedUserIDs)
 		{
-			ZDCFileInfo *info = [[ZDCFileInfo alloc] initWithMode:mode type:type format:format fileURL:url];
-			
-			NSNumber *fileSize = nil;
-			[url getResourceValue:&fileSize forKey:NSURLFileSizeKey error:nil];
-			
-			info.fileSize = [fileSize unsignedLongLongValue];
-			
-			NSDate *lastModified = nil;
-			[url getResourceValue:&lastModified forKey:NSURLContentModificationDateKey error:nil];
-			
-			NSDate *lastAccessed = nil;
-			[url getResourceValue:&lastAccessed forKey:NSURLContentAccessDateKey error:nil];
+			NSMutableArray<ZDCFileInfo*> *cachedInfos = dict[unprocessedUserID];
 			
-			info.lastModified = lastModified ?: now;
+			NSUInteger i = 0;
+			while (i < cachedInfos.count)
+			{
+				ZDCFileInfo *cachedInfo = cachedInfos[i];
+				
+				if ([cachedInfo matchesMode:mode type:type format:format /* auth0ID:ANY */ ] && !cachedInfo.slabEntry)
+				{
+					[self didRemoveInfo:cachedInfo];
+					[cachedInfos removeObjectAtIndex:i];
+					[changedUserIDs addObject:unprocessedUserID];
+				}
+				else
+				{
+					i++;
+				}
+			}
 			
-			// I read on the Twitters that 'NSURLContentAccessDateKey' may be broken on iOS.
-			// So I'm guarding against that possibility to be safe.
-			//
-			info.lastAccessed = ZDCLaterDate(lastAccessed, lastModified) ?: now;
+			if (cachedInfos.count == 0) {
+				[dict removeObjectForKey:unprocessedUserID];
+			}
+		}
+		
+		if (cachePoolInfos.count > 0)
+		{
+			[self sortInfosByLastAccessed:cachePoolInfos];
+			[lru_userAvatars mergeInfos:cachePoolInfos];
+		}
+		
+		if (changedUserIDs.count > 0)
+		{
+			[changes_userAvatars unionSet:changedUserIDs];
+			[self postDiskManagerChangedNotification];
+		}
+		
+	#pragma clang diagnostic pop
+	}});
+}
+
+/**
+ * Invoked by retainTokens (during dealloc) in order to decrement the retainCount for the file.
+**/
+- (void)decrementRetainCountForInfo:(ZDCFileInfo *)infoToDecrement
+{
+	dispatch_block_t block = ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	
+		NSMutableDictionary<NSString *, NSMutableArray<ZDCFileInfo *> *> *dict;
+		NSString *key = nil;
+		
+		ZDCFileType type = infoToDecrement.type;
+		
+		if (type == ZDCFileType_NodeData)
+		{
+			dict = dict_nodeData;
+			key = infoToDecrement.fileURL.lastPathComponent; // nodeID
+		}
+		else if (type == ZDCFileType_NodeThumbnail)
+		{
+			dict = dict_nodeThumbnails;
+			key = infoToDecrement.fileURL.lastPathComponent; // nodeID
+		}
+		else
+		{
+			dict = dict_userAvatars;
+			key = infoToDecrement.userID;
+		}
+		
+		BOOL shouldPostNotification = NO;
+		
+		NSMutableArray <ZDCFileInfo *> *infos = dict[key];
+		if (infos)
+		{
+			ZDCStorageMode mode = infoToDecrement.mode;
+			ZDCFileType type = infoToDecrement.type;
+			ZDCCryptoFileFormat format = infoToDecrement.format;
+			NSString *identityID = infoToDecrement.identityID;
 			
-			info.migrateAfterUpload = [self shouldMigrateAfterUploadForURL:url];
-			info.deleteAfterUpload = [self shouldDeleteAfterUploadForURL:url];
+			NSUInteger matchingIndex = NSNotFound;
+			NSUInteger i = 0;
 			
-			NSTimeInterval expiration = 0;
-			if ([strongSelf getExpiration:&expiration forURL:url]) {
-				info.expiration = expiration;
+			for (ZDCFileInfo *info in infos)
+			{
+				if ([info matchesMode:mode type:type format:format identityID:identityID])
+				{
+					matchingIndex = i;
+					break;
+				}
+				
+				i++;
 			}
 			
-			[infos addObject:info];
+			if (matchingIndex != NSNotFound)
+			{
+				ZDCFileInfo *matchingInfo = infos[matchingIndex];
+				
+				if ([matchingInfo decrementFileRetainCount] == 0 && matchingInfo.pendingDelete)
+				{
+					NSError *error = nil;
+					[self removeFileForInfo:matchingInfo error:&error];
+					
+					if (error) {
+						ZDCLogWarn(@"Error deleting fileURL(%@): %@", [matchingInfo.fileURL path], error);
+					}
+					
+					[self didRemoveInfo:matchingInfo];
+					[infos removeObjectAtIndex:matchingIndex];
+					shouldPostNotification = YES;
+					
+					if (infos.count == 0) {
+						[dict removeObjectForKey:key];
+					}
+				}
+			}
 		}
 		
-		if (type == ZDCFileType_NodeData || type == ZDCFileType_NodeThumbnail)
+		if (shouldPostNotification)
 		{
-			[strongSelf _updateNodeDictWithInfos: infos
-			                                mode: mode
-			                                type: type
-			                              format: format];
+			if (dict == dict_nodeData) {
+				[changes_nodeData addObject:key];
+			}
+			else if (dict == dict_nodeThumbnails) {
+				[changes_nodeThumbnails addObject:key];
+			}
+			else {
+				[changes_userAvatars addObject:key];
+			}
+			
+			[self postDiskManagerChangedNotification];
 		}
-		else if (type == ZDCFileType_UserAvatar)
+		
+	#pragma clang diagnostic pop
+	}};
+	
+	if (dispatch_get_specific(IsOnCacheQueueKey))
+		block();
+	else
+		dispatch_async(cacheQueue, block);
+}
+
+- (nullable ZDCUser *)findUserWithRandom:(NSString *)random
+                             transaction:(YapDatabaseReadTransaction *)transaction
+{
+	YapDatabaseSecondaryIndexTransaction *secondaryIndexTransaction = [transaction ext:Ext_Index_Users];
+	
+	__block ZDCUser *match = nil;
+	
+	if (secondaryIndexTransaction)
+	{
+		// Use secondary index for best performance (uses sqlite indexes)
+		//
+		// WHERE random = ?
+		
+		NSString *queryString = [NSString stringWithFormat:@"WHERE %@ = ?", Index_Users_Column_RandomUUID];
+		YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:queryString, random];
+		
+		[secondaryIndexTransaction enumerateKeysAndObjectsMatchingQuery:query usingBlock:
+			^(NSString *collection, NSString *key, ZDCUser *user, BOOL *stop)
 		{
-			[strongSelf _updateUserDictWithInfos: infos
-			                                mode: mode
-			                                type: type
-			                              format: format];
-		}
-		else
+			match = user;
+			*stop = YES;
+		}];
+	}
+	else
+	{
+		// Backup Plan (defensive programming)
+		
+		[transaction enumerateKeysAndObjectsInCollection:kZDCCollection_Users usingBlock:
+			^(NSString *key, ZDCUser *user, BOOL *stop)
 		{
-			NSAssert(NO, @"Unrecognized type!");
+			if ([random isEqualToString:user.random_uuid])
+			{
+				match = user;
+				*stop = YES;
+			}
+		}];
+	}
+	
+	return match;
+}
+
+- (void)findAuth0IDsMatchingHashes:(NSMutableSet<NSString*> *)hashes
+                           forUser:(ZDCUser *)user
+                           withMap:(NSMutableDictionary<NSString*, NSString*> *)map_auth0ID
+{
+	for (ZDCUserIdentity *identity in user.identities)
+	{
+		NSString *identityID = identity.identityID;
+		NSString *hash = [self hashIdentityID:identityID forUser:user];
+		if ([hashes containsObject:hash])
+		{
+			map_auth0ID[hash] = identityID;
+			
+			[hashes removeObject:hash];
+			if (hashes.count == 0) return;
 		}
-	}});
+	}
+}
+
+- (NSString *)hashIdentityID:(NSString *)identityID forUser:(ZDCUser *)user
+{
+	// Purpose:
+	//
+	// We want to store the user avatar on disk.
+	// But we don't want to leak any information concerning who the user may be communicating with.
+	
+	NSData *encryptionKey = user.random_encryptionKey;
+	NSData *identityIDBytes = [identityID dataUsingEncoding:NSUTF8StringEncoding];
+	
+	NSMutableData *hashMe = [NSMutableData dataWithCapacity:(encryptionKey.length + identityIDBytes.length)];
+	[hashMe appendData:encryptionKey];
+	[hashMe appendData:identityIDBytes];
+	
+	NSData *hashedData = [hashMe hashWithAlgorithm:kHASH_Algorithm_SHA256 error:nil];
+	
+	return [hashedData zBase32String];
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Journal
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 /**
- * Updates the underlying 'cache' with the given ZDCFileInfo entries
- * which were created from inspecting the file system.
+ * Populates the dicts from the journal (where possible).
+ * Returns the list of directories that still need to be scanned.
+ *
+ * If the journal is missing or corrupt (e.g. first launch, or unclean shutdown),
+ * then every directory needs to be scanned.
+ *
+ * Otherwise, we only need to scan directories that were modified after the journal was last written.
+ * Since every change we make to a directory is followed by a journal write,
+ * this only happens if something else modified the directory.
+ * For example, the OS purging the caches directory while the app wasn't running,
+ * or the app being killed between writing a file and journaling it.
  */
-- (void)_updateNodeDictWithInfos:(NSArray<ZDCFileInfo *> *)onDiskInfos
-                            mode:(ZDCStorageMode)mode
-                            type:(ZDCFileType)type
-                          format:(ZDCCryptoFileFormat)format
+- (NSArray<NSArray *> *)restoreFromJournal:(NSArray<NSArray *> *)list
 {
 	ZDCLogAutoTrace();
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
 	
-	dispatch_async(cacheQueue, ^{ @autoreleasepool {
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self" // Singleton
+	__weak typeof(self) weakSelf = self;
+	
+	NSDate *lastWriteDate = nil;
+	NSArray<ZDCFileInfo *> *restoredInfos =
+	  [journal readInfosWithDirectoryBlock:^NSURL *(ZDCStorageMode mode, ZDCFileType type, ZDCCryptoFileFormat format) {
+	
+		return [weakSelf URLForMode:mode type:type format:format];
 		
-		NSMutableDictionary<NSString *, NSMutableArray<ZDCFileInfo *> *> *dict;
-		if (type == ZDCFileType_NodeData) {
-			dict = dict_nodeData;
-		}
-		else {
-			dict = dict_nodeThumbnails;
-		}
+	} lastWriteDate:&lastWriteDate];
+	
+	if (restoredInfos == nil)
+	{
+		ZDCLogInfo(@"Journal missing or corrupt - performing full scan");
 		
-		NSMutableSet<NSString*> *unprocessedNodeIDs = [NSMutableSet setWithArray:[dict allKeys]];
-		NSMutableSet<NSString*> *changedNodeIDs = [NSMutableSet set];
+		[journal reset];
+		return list;
+	}
+	
+	NSMutableArray<NSArray *> *scanList = [NSMutableArray array];
+	NSMutableSet<NSString *> *scanDirectories = [NSMutableSet set];
+	
+	for (NSArray *tuple in list)
+	{
+		ZDCStorageMode mode        = [tuple[0] integerValue];
+		ZDCFileType type           = [tuple[1] integerValue];
+		ZDCCryptoFileFormat format = [tuple[2] integerValue];
 		
-		// The 'infos' array represents every item that actually exists on the file system.
-		// However, this is NOT every single file,
-		// it's ONLY the files matching the given <directory, format> tuple.
-		//
-		// We need to do 2 things:
-		// - Ensure there is a ZDCFileInfo entry for every given item.
-		// - Delete every ZDCFileInfo entry that isn't represented in
-		//   the given list (WITH THE SAME DIRECTORY & FORMAT).
+		NSURL *directoryURL = [self URLForMode:mode type:type format:format];
 		
-		for (ZDCFileInfo *onDiskInfo in onDiskInfos)
+		NSDate *directoryModified = nil;
+		[directoryURL getResourceValue:&directoryModified forKey:NSURLContentModificationDateKey error:nil];
+		
+		if ((directoryModified == nil) || [directoryModified isAfter:lastWriteDate])
 		{
-			NSString *nodeID = [onDiskInfo.fileURL lastPathComponent];
-			if (nodeID == nil) {
-				continue;
-			}
+			[scanList addObject:tuple];
+			[scanDirectories addObject:[NSString stringWithFormat:@"%d|%d|%d", (int)mode, (int)type, (int)format]];
+		}
+	}
+	
+	NSMutableArray<ZDCFileInfo *> *cachePool_nodeData       = [NSMutableArray array];
+	NSMutableArray<ZDCFileInfo *> *cachePool_nodeThumbnails = [NSMutableArray array];
+	NSMutableArray<ZDCFileInfo *> *cachePool_userAvatars    = [NSMutableArray array];
+	
+	for (ZDCFileInfo *info in restoredInfos)
+	{
+		if (info->journaledAsPacked)
+		{
+			// Packed items live in the slab store (not the directory),
+			// so they're unaffected by directory scans.
 			
-			onDiskInfo.nodeID = nodeID;
-			[unprocessedNodeIDs removeObject:nodeID];
+			ZDCDiskSlabStore *slabStore = [self slabStoreForMode:info.mode type:info.type format:info.format];
+			ZDCDiskSlabEntry *slabEntry = [slabStore entryForKey:info.fileURL.lastPathComponent];
 			
-			NSMutableArray<ZDCFileInfo *> *cachedInfos = dict[nodeID];
-			if (cachedInfos == nil)
+			if (slabEntry == nil)
 			{
-				cachedInfos = [[NSMutableArray alloc] initWithCapacity:1];
-				dict[nodeID] = cachedInfos;
+				pendingJournal[[ZDCDiskJournal keyForInfo:info]] = [NSNull null];
+				continue;
 			}
 			
-			ZDCFileInfo *matchingInfo = nil;
-			for (ZDCFileInfo *existingInfo in cachedInfos)
+			info.slabEntry = slabEntry;
+			info.fileSize = slabEntry.length;
+		}
+		else if (info->journaledBlobName)
+		{
+			// Deduplicated items live in the blob store (not the directory),
+			// so they're unaffected by directory scans.
+			
+			ZDCDiskBlobStore *blobStore = [self blobStoreForMode:info.mode type:info.type format:info.format];
+			ZDCDiskBlob *blob = [blobStore blobWithName:info->journaledBlobName];
+			
+			if (blob == nil)
 			{
-				if ([existingInfo matchesMode:mode type:type format:format])
-				{
-					matchingInfo = existingInfo;
-				}
+				pendingJournal[[ZDCDiskJournal keyForInfo:info]] = [NSNull null];
+				continue;
 			}
 			
-			// If matchingInfo exists, then leave it be.
-			// We need to preserve the following:
-			// - info.fileRetainCount
-			//
-			if (matchingInfo)
+			[blobStore retainBlob:blob];
+			info.blob = blob;
+			info.contentDigest = blob.digest;
+			info.fileSize = blob.length;
+		}
+		else if (scanDirectories.count > 0)
+		{
+			NSString *directory =
+			  [NSString stringWithFormat:@"%d|%d|%d", (int)info.mode, (int)info.type, (int)info.format];
+			
+			if ([scanDirectories containsObject:directory])
 			{
-				matchingInfo.fileSize = onDiskInfo.fileSize;
+				// The scan will re-create the entry (if the file still exists).
+				// Drop the stale entry from the journal.
 				
-				// Merge dates to give us a more accurate picture.
-				//
-				matchingInfo.lastAccessed = ZDCLaterDate(matchingInfo.lastAccessed, onDiskInfo.lastAccessed);
-				matchingInfo.lastModified = ZDCLaterDate(matchingInfo.lastModified, onDiskInfo.lastModified);
-			}
-			else // if (matchingInfo == nil)
-			{
-				[cachedInfos addObject:onDiskInfo];
-				[changedNodeIDs addObject:nodeID];
+				pendingJournal[[ZDCDiskJournal keyForInfo:info]] = [NSNull null];
+				continue;
 			}
 		}
 		
-		// Delete any ZDCFileInfo entry that wasn't represented by the given list (with same directory & format).
-		// These are files that were previously on disk, but have since been deleted.
-		// This could be due to several different things:
-		//
-		// - The OS doing some file system maintenance, usually to make room when disk space gets low.
-		// - The developer manually deleting the file(s).
-		// - On macOS this may also just be the user deleting items in the filesystem.
+		NSMutableDictionary<NSString *, NSMutableArray<ZDCFileInfo *> *> *dict = nil;
+		NSMutableArray<ZDCFileInfo *> *cachePool = nil;
+		NSString *key = nil;
 		
-		for (NSString *unprocessedNodeID in unprocessedNodeIDs)
+		switch (info.type)
 		{
-			NSMutableArray<ZDCFileInfo *> *cachedInfos = dict[unprocessedNodeID];
-			
-			NSUInteger matchingIndex = NSNotFound;
-			NSUInteger i = 0;
-			
-			for (ZDCFileInfo *cachedInfo in cachedInfos)
+			case ZDCFileType_NodeData:
 			{
-				if ([cachedInfo matchesMode:mode type:type format:format])
-				{
-					matchingIndex = i;
-					break;
-				}
-				
-				i++;
+				dict = dict_nodeData;
+				cachePool = cachePool_nodeData;
+				key = info.nodeID;
+				break;
 			}
-			
-			if (matchingIndex != NSNotFound)
+			case ZDCFileType_NodeThumbnail:
 			{
-				[cachedInfos removeObjectAtIndex:matchingIndex];
-				[changedNodeIDs addObject:unprocessedNodeID];
-				
-				if (cachedInfos.count == 0) {
-					[dict removeObjectForKey:unprocessedNodeID];
-				}
+				dict = dict_nodeThumbnails;
+				cachePool = cachePool_nodeThumbnails;
+				key = info.nodeID;
+				break;
+			}
+			case ZDCFileType_UserAvatar:
+			{
+				dict = dict_userAvatars;
+				cachePool = cachePool_userAvatars;
+				key = info.userID;
+				break;
 			}
 		}
 		
-		if (changedNodeIDs.count > 0)
+		if (key == nil) continue;
+		
+		NSMutableArray<ZDCFileInfo *> *infos = dict[key];
+		if (infos == nil)
 		{
-			if (dict == dict_nodeData) {
-				[changes_nodeData unionSet:changedNodeIDs];
-			}
-			else {
-				[changes_nodeThumbnails unionSet:changedNodeIDs];
-			}
-			
-			[self postDiskManagerChangedNotification];
+			infos = [[NSMutableArray alloc] initWithCapacity:1];
+			dict[key] = infos;
 		}
 		
-	#pragma clang diagnostic pop
+		[infos addObject:info];
+		[self addInfoToStorageCounter:info];
+		[self updateExpirationForInfo:info];
+		
+		if (info.mode == ZDCStorageMode_Cache) {
+			[cachePool addObject:info];
+		}
+	}
+	
+	[self sortInfosByLastAccessed:cachePool_nodeData];
+	[self sortInfosByLastAccessed:cachePool_nodeThumbnails];
+	[self sortInfosByLastAccessed:cachePool_userAvatars];
+	
+	[lru_nodeData       mergeInfos:cachePool_nodeData];
+	[lru_nodeThumbnails mergeInfos:cachePool_nodeThumbnails];
+	[lru_userAvatars    mergeInfos:cachePool_userAvatars];
+	
+	ZDCLogInfo(@"Restored %lu items from journal (%lu directories need scanning)",
+	           (unsigned long)restoredInfos.count, (unsigned long)scanList.count);
+	
+	if (pendingJournal.count > 0) {
+		[self scheduleJournalFlush];
+	}
+	
+	return scanList;
+}
+
+/**
+ * Schedules the info to be written to the journal.
+ * Invoke this after adding or modifying an info within one of the dicts.
+ */
+- (void)journalInfo:(ZDCFileInfo *)info
+{
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
+	
+	if (info.fileURL.lastPathComponent == nil) return;
+	
+	pendingJournal[[ZDCDiskJournal keyForInfo:info]] = info;
+	[self scheduleJournalFlush];
+}
+
+- (void)scheduleJournalFlush
+{
+	if (journalFlushPending) return;
+	journalFlushPending = YES;
+	
+	// We coalesce all the changes made within the current block (e.g. an import or a scan).
+	// This also ensures we journal the final state of each info,
+	// as properties are often set after the info is added to the dict.
+	
+	__weak typeof(self) weakSelf = self;
+	dispatch_async(cacheQueue, ^{ @autoreleasepool {
+	
+		[weakSelf flushJournal];
 	}});
 }
 
+- (void)flushJournal
+{
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
+	
+	journalFlushPending = NO;
+	if (pendingJournal.count == 0) return;
+	
+	NSMutableArray<ZDCFileInfo *> *infos = [NSMutableArray arrayWithCapacity:pendingJournal.count];
+	NSMutableArray<NSString *> *removedKeys = [NSMutableArray array];
+	
+	[pendingJournal enumerateKeysAndObjectsUsingBlock:^(NSString *key, id value, BOOL *stop) {
+	
+		if ([value isKindOfClass:[ZDCFileInfo class]])
+			[infos addObject:(ZDCFileInfo *)value];
+		else
+			[removedKeys addObject:key];
+	}];
+	
+	[pendingJournal removeAllObjects];
+	[journal appendInfos:infos removedKeys:removedKeys];
+	
+	// Compact once the journal has (at least) doubled in size.
+	
+	NSUInteger liveCount = 0;
+	for (NSUInteger m = 0; m < 2; m++) {
+		for (NSUInteger t = 0; t < 3; t++) {
+			for (NSUInteger f = 0; f < 3; f++) {
+				liveCount += storageCounters[m][t][f]->fileCount;
+			}
+		}
+	}
+	
+	if (journal.appendedRecordCount > MAX(kJournalCompactionThreshold, liveCount)) {
+		[self compactJournal];
+	}
+}
+
 /**
- * Updates the underlying 'cache' with the given ZDCFileInfo entries
- * which were created from inspecting the file system.
+ * Rewrites the journal, using a single record for every info within the dicts.
  */
-- (void)_updateUserDictWithInfos:(NSArray<ZDCFileInfo *> *)onDiskInfos
-                            mode:(ZDCStorageMode)mode
-                            type:(ZDCFileType)type
-                          format:(ZDCCryptoFileFormat)format
+- (void)compactJournal
 {
 	ZDCLogAutoTrace();
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
 	
-	// Dispatch queue considerations:
-	//
-	// We are currently executing within the refreshQueue.
-	// To update `dict_userAvatars`, we need to be executing within the cacheQueue.
-	//
-	// But before we can update the dict, we have a bunch of work to do.
-	// The question is:
-	// - Which queue do we perform the work on ?
-	// - Or should we perform the work in some other queue ?
-	//
-	// We need to perform this work synchronously within the refreshQueue.
-	// This is for 2 reasons:
-	//
-	// 1. We don't want to slow down the cacheQueue,
-	//    which is meant to be used here as a light-weight lock/serialization-primitive.
-	//
-	// 2. The garbageCollection method makes some assumptions about when its safe to perform its task.
-	//    And it doesn't expect any async tasks between the refreshQueue, and updating the dicts.
-	//
+	// Any pending changes are about to be included in the snapshot.
+	[pendingJournal removeAllObjects];
+	
+	NSMutableArray<ZDCFileInfo *> *allInfos = [NSMutableArray array];
+	
+	for (NSDictionary<NSString*, NSMutableArray<ZDCFileInfo*> *> *dict in @[dict_nodeData, dict_nodeThumbnails, dict_userAvatars])
+	{
+		for (NSArray<ZDCFileInfo *> *infos in [dict objectEnumerator])
+		{
+			[allInfos addObjectsFromArray:infos];
+		}
+	}
+	
+	[journal compactWithInfos:allInfos];
+	journalStale = NO;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Slabs
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the slab store for the given directory, or nil if items in the directory aren't packed.
+ *
+ * Only cached thumbnails & avatars are packed.
+ * Persistent items are stored as regular files, as they're expected to be few (and long lived).
+ * And node data is too large for packing to be beneficial.
+ *
+ * Note: The stores are created in init (and never change), so this method can be invoked from any queue.
+ */
+- (nullable ZDCDiskSlabStore *)slabStoreForMode:(ZDCStorageMode)mode
+                                           type:(ZDCFileType)type
+                                         format:(ZDCCryptoFileFormat)format
+{
+	if (mode != ZDCStorageMode_Cache) return nil;
+	if (format != ZDCCryptoFileFormat_CacheFile) return nil;
+	
+	switch (type)
+	{
+		case ZDCFileType_NodeThumbnail : return slabs_nodeThumbnails;
+		case ZDCFileType_UserAvatar    : return slabs_userAvatars;
+		default                        : return nil;
+	}
+}
+
+- (void)openSlabStores
+{
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
 	
+	[slabs_nodeThumbnails open];
+	[slabs_userAvatars open];
+}
+
+/**
+ * Invoked at launch, after the journal has been restored.
+ *
+ * The journal & the slabs are written independently, so they can disagree after a crash.
+ * Entries the journal doesn't know about are either adopted (thumbnails, where the key is the nodeID),
+ * or discarded (avatars, where the info requires the userID & identityID from the journal).
+ */
+- (void)restorePackedInfos
+{
+	ZDCLogAutoTrace();
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
 	
-	// The filenames are of the form: <user.random_uuid>.<hashed_auth0ID>
+	NSMutableSet<NSString *> *linkedKeys = [NSMutableSet set];
+	BOOL removedEntries = NO;
 	
-	NSMutableDictionary<NSString*, NSMutableSet<NSString*> *> *lookup = [NSMutableDictionary dictionary];
+	// User avatars
 	
-	for (ZDCFileInfo *info in onDiskInfos)
+	for (NSArray<ZDCFileInfo *> *infos in [dict_userAvatars objectEnumerator])
 	{
-		NSString *filename = [info.fileURL lastPathComponent];
-		NSArray<NSString*> *components = [filename componentsSeparatedByString:@"."];
-		
-		if (components.count == 2)
+		for (ZDCFileInfo *info in infos)
 		{
-			NSString *random_uuid = components[0];
-			NSString *hashed_auth0ID = components[1];
-			
-			NSMutableSet *hashes = lookup[random_uuid];
-			if (hashes == nil)
-			{
-				hashes = [NSMutableSet set];
-				lookup[random_uuid] = hashes;
+			if (info.slabEntry) {
+				[linkedKeys addObject:info.slabEntry.key];
 			}
-			
-			[hashes addObject:hashed_auth0ID];
 		}
 	}
 	
-	// Now we need to create some mappings like so:
-	//
-	// - map_userID  : key(user.random_uuid) => value(user.uuid)
-	// - map_auth0ID : key(hashed_auth0ID)   => value(auth0ID)
+	for (ZDCDiskSlabEntry *entry in [slabs_userAvatars allEntries])
+	{
+		if (![linkedKeys containsObject:entry.key])
+		{
+			[slabs_userAvatars removeEntry:entry];
+			removedEntries = YES;
+		}
+	}
 	
-	NSMutableDictionary<NSString*, NSString*> *map_userID = [NSMutableDictionary dictionary];
-	NSMutableDictionary<NSString*, NSString*> *map_auth0ID = [NSMutableDictionary dictionary];
+	// Node thumbnails
 	
-	[zdc.databaseManager.roDatabaseConnection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
-		
-		for (NSString *random_uuid in lookup)
+	[linkedKeys removeAllObjects];
+	for (NSArray<ZDCFileInfo *> *infos in [dict_nodeThumbnails objectEnumerator])
+	{
+		for (ZDCFileInfo *info in infos)
 		{
-			ZDCUser *user = [self findUserWithRandom:random_uuid transaction:transaction];
-			if (user)
-			{
-				map_userID[random_uuid] = user.uuid;
-				
-				NSMutableSet *hashes = lookup[random_uuid];
-				[self findAuth0IDsMatchingHashes:hashes forUser:user withMap:map_auth0ID];
+			if (info.slabEntry) {
+				[linkedKeys addObject:info.slabEntry.key];
 			}
 		}
-	}];
+	}
 	
-	// Now we're going to put everything together for quick processing
+	ZDCStorageMode const mode = ZDCStorageMode_Cache;
+	ZDCFileType const type = ZDCFileType_NodeThumbnail;
+	ZDCCryptoFileFormat const format = ZDCCryptoFileFormat_CacheFile;
 	
-	NSMutableDictionary<NSString*, NSMutableDictionary<NSString*, ZDCFileInfo*> *> *onDiskInfosDict =
-	  [NSMutableDictionary dictionaryWithCapacity:onDiskInfos.count];
+	NSURL *dirURL = [self URLForMode:mode type:type format:format];
+	NSMutableArray<ZDCFileInfo *> *cachePool = [NSMutableArray array];
 	
-	for (ZDCFileInfo *info in onDiskInfos)
+	for (ZDCDiskSlabEntry *entry in [slabs_nodeThumbnails allEntries])
 	{
-		NSString *filename = [info.fileURL lastPathComponent];
-		NSArray<NSString*> *components = [filename componentsSeparatedByString:@"."];
+		if ([linkedKeys containsObject:entry.key]) continue;
 		
-		if (components.count == 2)
+		NSString *nodeID = entry.key;
+		NSMutableArray<ZDCFileInfo *> *infos = dict_nodeThumbnails[nodeID];
+		
+		BOOL hasMatchingInfo = NO;
+		for (ZDCFileInfo *info in infos)
 		{
-			NSString *random_uuid = components[0];
-			NSString *hashed_auth0ID = components[1];
-			
-			NSString *userID  = map_userID[random_uuid];
-			NSString *auth0ID = map_auth0ID[hashed_auth0ID];
-			
-			if (userID && auth0ID)
-			{
-				NSMutableDictionary<NSString*, ZDCFileInfo*> *usersDict = onDiskInfosDict[userID];
-				if (usersDict == nil)
-				{
-					usersDict = [[NSMutableDictionary alloc] init];
-					onDiskInfosDict[userID] = usersDict;
-				}
-				
-				info.userID = userID;
-				info.identityID = auth0ID;
-				
-				usersDict[auth0ID] = info;
+			if ([info matchesMode:mode type:type format:format]) {
+				hasMatchingInfo = YES;
+				break;
 			}
 		}
-	}
-	
-	dispatch_async(cacheQueue, ^{ @autoreleasepool {
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		NSMutableDictionary<NSString *, NSMutableArray<ZDCFileInfo *> *> *dict = dict_userAvatars;
+		if (hasMatchingInfo)
+		{
+			// A loose file was (re)imported, and supersedes the packed copy.
+			[slabs_nodeThumbnails removeEntry:entry];
+			removedEntries = YES;
+			continue;
+		}
 		
-		NSMutableSet<NSString*> *unprocessedUserIDs = [NSMutableSet setWithArray:[dict allKeys]];
-		NSMutableSet<NSString*> *changedUserIDs = [NSMutableSet set];
+		NSURL *fileURL = [dirURL URLByAppendingPathComponent:nodeID isDirectory:NO];
+		ZDCFileInfo *info = [[ZDCFileInfo alloc] initWithMode:mode type:type format:format fileURL:fileURL];
 		
-		for (NSString *userID in onDiskInfosDict)
+		info.nodeID = nodeID;
+		info.fileSize = entry.length;
+		info.lastModified = entry.date;
+		info.lastAccessed = entry.date;
+		info.slabEntry = entry;
+		
+		if (infos == nil)
 		{
-			[unprocessedUserIDs removeObject:userID];
-			
-			NSMutableArray<ZDCFileInfo *> *cachedInfos = dict[userID];
-			if (cachedInfos == nil)
-			{
-				cachedInfos = [[NSMutableArray alloc] initWithCapacity:1];
-				dict[userID] = cachedInfos;
-			}
-			
-			NSMutableSet<NSString*> *unprocessedIdentityIDs = [NSMutableSet set];
-			for (ZDCFileInfo *cachedInfo in cachedInfos)
-			{
-				if ([cachedInfo matchesMode:mode type:type format:format] && cachedInfo.identityID)
-				{
-					[unprocessedIdentityIDs addObject:cachedInfo.identityID];
-				}
-			}
-			
-			for (NSString *identityID in onDiskInfosDict[userID])
-			{
-				[unprocessedIdentityIDs removeObject:identityID];
-				
-				ZDCFileInfo *matchingInfo = nil;
-				for (ZDCFileInfo *cachedInfo in cachedInfos)
-				{
-					if ([cachedInfo matchesMode:mode type:type format:format identityID:identityID])
-					{
-						matchingInfo = cachedInfo;
-					}
-				}
-				
-				ZDCFileInfo *onDiskInfo = onDiskInfosDict[userID][identityID];
-				
-				// If matchingInfo exists, then leave it be.
-				// We need to preserve the following:
-				// - info.fileRetainCount
-				//
-				if (matchingInfo)
-				{
-					matchingInfo.fileSize = onDiskInfo.fileSize;
-					
-					// Merge dates to give us a more accurate picture.
-					//
-					matchingInfo.lastAccessed = ZDCLaterDate(matchingInfo.lastAccessed, onDiskInfo.lastAccessed);
-					matchingInfo.lastModified = ZDCLaterDate(matchingInfo.lastModified, onDiskInfo.lastModified);
-				}
-				else // if (matchingInfo == nil)
-				{
-					[cachedInfos addObject:onDiskInfo];
-					[changedUserIDs addObject:userID];
-				}
-			}
-			
-			for (NSString *unprocessedIdentityID in unprocessedIdentityIDs)
-			{
-				NSUInteger matchingIndex = NSNotFound;
-				NSUInteger i = 0;
-				
-				for (ZDCFileInfo *cachedInfo in cachedInfos)
-				{
-					if ([cachedInfo matchesMode:mode type:type format:format identityID:unprocessedIdentityID])
-					{
-						matchingIndex = i;
-						break;
-					}
-					
-					i++;
-				}
-				
-				if (matchingIndex != NSNotFound)
-				{
-					[cachedInfos removeObjectAtIndex:matchingIndex];
-					[changedUserIDs addObject:userID];
-					
-					if (cachedInfos.count == 0) {
-						[dict removeObjectForKey:userID];
-					}
-				}
-			}
+			infos = [[NSMutableArray alloc] initWithCapacity:1];
+			dict_nodeThumbnails[nodeID] = infos;
 		}
 		
-		for (NSString *unprocessedUserID in unprocessedUserIDs)
+		[infos addObject:info];
+		[self didAddInfo:info];
+		[cachePool addObject:info];
+	}
+	
+	if (cachePool.count > 0)
+	{
+		ZDCLogInfo(@"Adopted %lu packed thumbnails missing from journal", (unsigned long)cachePool.count);
+		
+		[self sortInfosByLastAccessed:cachePool];
+		[lru_nodeThumbnails mergeInfos:cachePool];
+	}
+	
+	if (removedEntries) {
+		[self scheduleSlabCompaction];
+	}
+}
+
+/**
+ * Deletes the item from disk, whether it's a regular file, packed into a slab, or a reference to a blob.
+ * (The blob itself is only deleted once its last reference is gone.)
+ */
+- (BOOL)removeFileForInfo:(ZDCFileInfo *)info error:(NSError *_Nullable *_Nullable)outError
+{
+	ZDCDiskBlob *blob = info.blob;
+	if (blob)
+	{
+		ZDCDiskBlobStore *blobStore = [self blobStoreForMode:info.mode type:info.type format:info.format];
+		
+		[blobStore releaseBlob:blob];
+		info.blob = nil;
+		
+		if (outError) *outError = nil;
+		return YES;
+	}
+	
+	ZDCDiskSlabEntry *slabEntry = info.slabEntry;
+	if (slabEntry == nil)
+	{
+		return [[NSFileManager defaultManager] removeItemAtURL:info.fileURL error:outError];
+	}
+	
+	ZDCDiskSlabStore *slabStore = [self slabStoreForMode:info.mode type:info.type format:info.format];
+	
+	[slabStore removeEntry:slabEntry];
+	[self scheduleSlabCompaction];
+	
+	if (outError) *outError = nil;
+	return YES;
+}
+
+/**
+ * Writes a packed (or deduplicated) item to a regular file, including the xattrs that would normally accompany it.
+ */
+- (BOOL)unpackFileForInfo:(ZDCFileInfo *)info toURL:(NSURL *)dstURL error:(NSError *_Nullable *_Nullable)outError
+{
+	NSError *error = nil;
+	
+	if (info.blob)
+	{
+		// The copy remains encrypted with the blob's key.
+		// The contentDigest xattr (written below) allows us to derive the key again.
+		
+		if (![[NSFileManager defaultManager] copyItemAtURL:info.blob.fileURL toURL:dstURL error:&error])
 		{
-			NSMutableArray<ZDCFileInfo*> *cachedInfos = dict[unprocessedUserID];
-			
-			NSUInteger i = 0;
-			while (i < cachedInfos.count)
-			{
-				ZDCFileInfo *cachedInfo = cachedInfos[i];
-				
-				if ([cachedInfo matchesMode:mode type:type format:format /* auth0ID:ANY */ ])
-				{
-					[cachedInfos removeObjectAtIndex:i];
-					[changedUserIDs addObject:unprocessedUserID];
-				}
-				else
-				{
-					i++;
-				}
-			}
-			
-			if (cachedInfos.count == 0) {
-				[dict removeObjectForKey:unprocessedUserID];
-			}
+			if (outError) *outError = error;
+			return NO;
 		}
+	}
+	else
+	{
+		ZDCDiskSlabStore *slabStore = [self slabStoreForMode:info.mode type:info.type format:info.format];
+		NSData *data = [slabStore readEntry:info.slabEntry error:&error];
 		
-		if (changedUserIDs.count > 0)
+		if (data == nil || ![data writeToURL:dstURL options:NSDataWritingAtomic error:&error])
 		{
-			[changes_userAvatars unionSet:changedUserIDs];
-			[self postDiskManagerChangedNotification];
+			if (outError) *outError = error;
+			return NO;
 		}
+	}
+	
+	if (info.migrateAfterUpload) {
+		[self setShouldMigrateAfterUpload:YES forURL:dstURL];
+	}
+	if (info.deleteAfterUpload) {
+		[self setShouldDeleteAfterUpload:YES forURL:dstURL];
+	}
+	if (info.expiration > 0) {
+		[self setExpiration:info.expiration forURL:dstURL];
+	}
+	
+	NSData *encryptedETag = [info.encryptedETag isKindOfClass:[NSData class]] ? info.encryptedETag : nil;
+	if (encryptedETag)
+	{
+		const char *path = [[dstURL path] UTF8String];
+		const char *name = [kXattrName_eTag UTF8String];
 		
-	#pragma clang diagnostic pop
+		int result = setxattr(path, name, [encryptedETag bytes], encryptedETag.length, 0, 0);
+		
+		if (result < 0) {
+			ZDCLogError(@"setxattr(%@): error = %s", [dstURL path], strerror(errno));
+		}
+	}
+	
+	if (info.contentDigest) {
+		[self setContentDigest:info.contentDigest forURL:dstURL];
+	}
+	
+	if (outError) *outError = nil;
+	return YES;
+}
+
+- (BOOL)moveFileForInfo:(ZDCFileInfo *)info toURL:(NSURL *)dstURL error:(NSError *_Nullable *_Nullable)outError
+{
+	if (info.isStoredInDirectory)
+	{
+		return [[NSFileManager defaultManager] moveItemAtURL:info.fileURL toURL:dstURL error:outError];
+	}
+	
+	if (![self unpackFileForInfo:info toURL:dstURL error:outError]) {
+		return NO;
+	}
+	
+	return [self removeFileForInfo:info error:outError];
+}
+
+- (BOOL)copyFileForInfo:(ZDCFileInfo *)info toURL:(NSURL *)dstURL error:(NSError *_Nullable *_Nullable)outError
+{
+	if (info.isStoredInDirectory)
+	{
+		return [[NSFileManager defaultManager] copyItemAtURL:info.fileURL toURL:dstURL error:outError];
+	}
+	
+	return [self unpackFileForInfo:info toURL:dstURL error:outError];
+}
+
+/**
+ * Removals only append a tombstone, so we periodically compact the slabs to reclaim the dead space.
+ * Multiple removals (e.g. while trimming a cache pool) are coalesced into a single compaction pass.
+ */
+- (void)scheduleSlabCompaction
+{
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
+	
+	if (slabCompactionPending) return;
+	slabCompactionPending = YES;
+	
+	__weak typeof(self) weakSelf = self;
+	
+	dispatch_time_t delay = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kSlabCompactionDelay * NSEC_PER_SEC));
+	dispatch_after(delay, cacheQueue, ^{ @autoreleasepool {
+	
+		[weakSelf compactSlabs];
 	}});
 }
 
+- (void)compactSlabs
+{
+	ZDCLogAutoTrace();
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
+	
+	slabCompactionPending = NO;
+	
+	NSUInteger retired = 0;
+	retired += [slabs_nodeThumbnails compactIfNeeded];
+	retired += [slabs_userAvatars compactIfNeeded];
+	
+	if (retired > 0) {
+		ZDCLogVerbose(@"Slab compaction retired %lu slabs", (unsigned long)retired);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Blobs
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 /**
- * Invoked by retainTokens (during dealloc) in order to decrement the retainCount for the file.
-**/
-- (void)decrementRetainCountForInfo:(ZDCFileInfo *)infoToDecrement
+ * Returns the blob store for the given directory, or nil if items in the directory can't be deduplicated.
+ *
+ * Only cached node data & thumbnails are deduplicated.
+ * (Avatars are keyed by user, and the same avatar is rarely cached under multiple users.)
+ *
+ * Note: The stores are created in init (and never change), so this method can be invoked from any queue.
+ */
+- (nullable ZDCDiskBlobStore *)blobStoreForMode:(ZDCStorageMode)mode
+                                           type:(ZDCFileType)type
+                                         format:(ZDCCryptoFileFormat)format
 {
+	if (mode != ZDCStorageMode_Cache) return nil;
+	if (format != ZDCCryptoFileFormat_CacheFile) return nil;
+	
+	switch (type)
+	{
+		case ZDCFileType_NodeData      : return blobs_nodeData;
+		case ZDCFileType_NodeThumbnail : return blobs_nodeThumbnails;
+		default                        : return nil;
+	}
+}
+
+- (void)openBlobStores
+{
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
+	
+	[blobs_nodeData open];
+	[blobs_nodeThumbnails open];
+}
+
+/**
+ * Invoked at launch, after the journal has been restored.
+ *
+ * The blob store doesn't persist reference counts. So any blob that isn't referenced by a restored item
+ * (e.g. the journal was reset, or the app was killed between storing the blob & journaling the item) is garbage.
+ */
+- (void)removeUnreferencedBlobs
+{
+	ZDCLogAutoTrace();
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
+	
+	NSUInteger removed = 0;
+	removed += [blobs_nodeData removeUnreferencedBlobs];
+	removed += [blobs_nodeThumbnails removeUnreferencedBlobs];
+	
+	if (removed > 0) {
+		ZDCLogInfo(@"Removed %lu unreferenced blobs", (unsigned long)removed);
+	}
+}
+
+/**
+ * Returns the secret used to key content digests (and to derive the corresponding blob keys).
+ *
+ * Purpose:
+ * The digest is part of the blob's filename. If it were a plain hash of the content,
+ * then anybody with access to the filesystem could check whether a particular (known) file is cached.
+ *
+ * The secret is generated on first use, and stored in the (encrypted) database.
+ */
+- (NSData *)dedupeSecret
+{
+	__block NSData *secret = nil;
+	
 	dispatch_block_t block = ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 	
-		NSMutableDictionary<NSString *, NSMutableArray<ZDCFileInfo *> *> *dict;
-		NSString *key = nil;
-		
-		ZDCFileType type = infoToDecrement.type;
-		
-		if (type == ZDCFileType_NodeData)
-		{
-			dict = dict_nodeData;
-			key = infoToDecrement.fileURL.lastPathComponent; // nodeID
-		}
-		else if (type == ZDCFileType_NodeThumbnail)
-		{
-			dict = dict_nodeThumbnails;
-			key = infoToDecrement.fileURL.lastPathComponent; // nodeID
-		}
-		else
-		{
-			dict = dict_userAvatars;
-			key = infoToDecrement.userID;
-		}
-		
-		BOOL shouldPostNotification = NO;
-		
-		NSMutableArray <ZDCFileInfo *> *infos = dict[key];
-		if (infos)
+		if (dedupeSecret == nil)
 		{
-			ZDCStorageMode mode = infoToDecrement.mode;
-			ZDCFileType type = infoToDecrement.type;
-			ZDCCryptoFileFormat format = infoToDecrement.format;
-			NSString *identityID = infoToDecrement.identityID;
-			
-			NSUInteger matchingIndex = NSNotFound;
-			NSUInteger i = 0;
-			
-			for (ZDCFileInfo *info in infos)
-			{
-				if ([info matchesMode:mode type:type format:format identityID:identityID])
-				{
-					matchingIndex = i;
-					break;
-				}
-				
-				i++;
-			}
+			ZDCInternalPreferences *internalPreferences = zdc.internalPreferences;
 			
-			if (matchingIndex != NSNotFound)
+			dedupeSecret = internalPreferences.diskManager_dedupeSecret;
+			if (dedupeSecret == nil)
 			{
-				ZDCFileInfo *matchingInfo = infos[matchingIndex];
-				
-				if ([matchingInfo decrementFileRetainCount] == 0 && matchingInfo.pendingDelete)
-				{
-					NSError *error = nil;
-					[[NSFileManager defaultManager] removeItemAtURL:matchingInfo.fileURL error:&error];
-					
-					if (error) {
-						ZDCLogWarn(@"Error deleting fileURL(%@): %@", [matchingInfo.fileURL path], error);
-					}
-					
-					[infos removeObjectAtIndex:matchingIndex];
-					shouldPostNotification = YES;
-					
-					if (infos.count == 0) {
-						[dict removeObjectForKey:key];
-					}
-				}
-			}
-		}
-		
-		if (shouldPostNotification)
-		{
-			if (dict == dict_nodeData) {
-				[changes_nodeData addObject:key];
+				dedupeSecret = [NSData s4RandomBytes:kDedupeSecretSizeInBytes];
+				internalPreferences.diskManager_dedupeSecret = dedupeSecret;
 			}
-			else if (dict == dict_nodeThumbnails) {
-				[changes_nodeThumbnails addObject:key];
-			}
-			else {
-				[changes_userAvatars addObject:key];
-			}
-			
-			[self postDiskManagerChangedNotification];
 		}
 		
+		secret = dedupeSecret;
+	
 	#pragma clang diagnostic pop
 	}};
 	
 	if (dispatch_get_specific(IsOnCacheQueueKey))
 		block();
 	else
-		dispatch_async(cacheQueue, block);
+		dispatch_sync(cacheQueue, block);
+	
+	return secret;
 }
 
-- (nullable ZDCUser *)findUserWithRandom:(NSString *)random
-                             transaction:(YapDatabaseReadTransaction *)transaction
+/**
+ * Returns the content digest: SHA-256(secret + cleartext), encoded using zBase32.
+ * If given a file, it's read in chunks (rather than all at once).
+ */
+- (nullable NSString *)contentDigestForCleartextData:(nullable NSData *)cleartextData
+                                    cleartextFileURL:(nullable NSURL *)cleartextFileURL
+                                               error:(NSError *_Nullable *_Nullable)outError
 {
-	YapDatabaseSecondaryIndexTransaction *secondaryIndexTransaction = [transaction ext:Ext_Index_Users];
+	NSData *secret = [self dedupeSecret];
 	
-	__block ZDCUser *match = nil;
+	NSError *error = nil;
+	S4Err err = kS4Err_NoErr;
+	HASH_ContextRef hashCtx = kInvalidHASH_ContextRef;
+	uint8_t hashBuf[256 / 8];
 	
-	if (secondaryIndexTransaction)
+	err = HASH_Init(kHASH_Algorithm_SHA256, &hashCtx);
+	if (IsntS4Err(err)) {
+		err = HASH_Update(hashCtx, secret.bytes, secret.length);
+	}
+	
+	if (IsntS4Err(err) && cleartextData)
 	{
-		// Use secondary index for best performance (uses sqlite indexes)
-		//
-		// WHERE random = ?
+		err = HASH_Update(hashCtx, cleartextData.bytes, cleartextData.length);
+	}
+	else if (IsntS4Err(err))
+	{
+		NSInputStream *stream = [NSInputStream inputStreamWithURL:cleartextFileURL];
+		[stream open];
 		
-		NSString *queryString = [NSString stringWithFormat:@"WHERE %@ = ?", Index_Users_Column_RandomUUID];
-		YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:queryString, random];
+		NSMutableData *buffer = [NSMutableData dataWithLength:kContentDigestChunkSize];
+		NSInteger bytesRead = 0;
 		
-		[secondaryIndexTransaction enumerateKeysAndObjectsMatchingQuery:query usingBlock:
-			^(NSString *collection, NSString *key, ZDCUser *user, BOOL *stop)
+		while (IsntS4Err(err) && (bytesRead = [stream read:buffer.mutableBytes maxLength:buffer.length]) > 0)
 		{
-			match = user;
-			*stop = YES;
-		}];
-	}
-	else
-	{
-		// Backup Plan (defensive programming)
+			err = HASH_Update(hashCtx, buffer.bytes, (size_t)bytesRead);
+		}
 		
-		[transaction enumerateKeysAndObjectsInCollection:kZDCCollection_Users usingBlock:
-			^(NSString *key, ZDCUser *user, BOOL *stop)
+		if (bytesRead < 0 || stream == nil)
 		{
-			if ([random isEqualToString:user.random_uuid])
-			{
-				match = user;
-				*stop = YES;
-			}
-		}];
+			error = stream.streamError ?:
+			  [NSError errorWithClass:[self class] code:400 description:@"Unable to read cleartextFileURL"];
+		}
+		
+		[stream close];
 	}
 	
-	return match;
+	if (IsntS4Err(err) && (error == nil)) {
+		err = HASH_Final(hashCtx, hashBuf);
+	}
+	
+	if (hashCtx) {
+		HASH_Free(hashCtx);
+	}
+	
+	if (IsS4Err(err)) {
+		error = [NSError errorWithS4Error:err];
+	}
+	
+	if (error)
+	{
+		if (outError) *outError = error;
+		return nil;
+	}
+	
+	if (outError) *outError = nil;
+	return [[NSData dataWithBytes:hashBuf length:sizeof(hashBuf)] zBase32String];
 }
 
-- (void)findAuth0IDsMatchingHashes:(NSMutableSet<NSString*> *)hashes
-                           forUser:(ZDCUser *)user
-                           withMap:(NSMutableDictionary<NSString*, NSString*> *)map_auth0ID
+/**
+ * Returns the key used to encrypt the blob for the given content digest: SHA-512(secret + digest).
+ *
+ * Deriving the key (rather than generating a random one) is what allows a node to reference an existing blob.
+ * The alternative would be to wrap a random key with each node's key,
+ * but then the key would only be recoverable by somebody that already references the blob.
+ */
+- (NSData *)encryptionKeyForContentDigest:(NSString *)digest
 {
-	for (ZDCUserIdentity *identity in user.identities)
+	NSData *secret = [self dedupeSecret];
+	NSData *digestBytes = [digest dataUsingEncoding:NSUTF8StringEncoding];
+	
+	NSMutableData *hashMe = [NSMutableData dataWithCapacity:(secret.length + digestBytes.length)];
+	[hashMe appendData:secret];
+	[hashMe appendData:digestBytes];
+	
+	return [hashMe hashWithAlgorithm:kHASH_Algorithm_SHA512 error:nil]; // 512 bits, same as a node's key
+}
+
+/**
+ * Returns the key the item's file is encrypted with.
+ * This is the node's key, unless the file was encrypted with a key derived from its content (i.e. deduplicated).
+ */
+- (NSData *)encryptionKeyForInfo:(ZDCFileInfo *)info withNodeKey:(NSData *)nodeKey
+{
+	NSString *digest = info.contentDigest;
+	if (digest == nil) {
+		return nodeKey;
+	}
+	
+	return [self encryptionKeyForContentDigest:digest];
+}
+
+/**
+ * Returns a blob for the given cleartext, with a reference that belongs to the caller.
+ *
+ * If a blob with the same content already exists, it's reused, and the cleartext isn't encrypted at all.
+ * Otherwise the cleartext is encrypted (with a key derived from its content digest) into a new blob.
+ */
+- (nullable ZDCDiskBlob *)importBlobWithCleartextData:(nullable NSData *)cleartextData
+                                     cleartextFileURL:(nullable NSURL *)cleartextFileURL
+                                            blobStore:(ZDCDiskBlobStore *)blobStore
+                                                error:(NSError *_Nullable *_Nullable)outError
+{
+	__block NSError *error = nil;
+	
+	NSString *digest = [self contentDigestForCleartextData: cleartextData
+	                                      cleartextFileURL: cleartextFileURL
+	                                                 error: &error];
+	if (digest == nil)
 	{
-		NSString *identityID = identity.identityID;
-		NSString *hash = [self hashIdentityID:identityID forUser:user];
-		if ([hashes containsObject:hash])
+		ZDCLogWarn(@"Error hashing import cleartext: %@", error);
+		
+		if (outError) *outError = error;
+		return nil;
+	}
+	
+	__block ZDCDiskBlob *blob = nil;
+	
+	dispatch_block_t lookupBlock = ^{ @autoreleasepool {
+		
+		blob = [blobStore blobForDigest:digest];
+		if (blob) {
+			[blobStore retainBlob:blob];
+		}
+	}};
+	
+	if (dispatch_get_specific(IsOnCacheQueueKey))
+		lookupBlock();
+	else
+		dispatch_sync(cacheQueue, lookupBlock);
+	
+	if (blob)
+	{
+		if (outError) *outError = nil;
+		return blob;
+	}
+	
+	NSData *encryptionKey = [self encryptionKeyForContentDigest:digest];
+	NSURL *srcURL = [ZDCDirectoryManager generateTempURL];
+	
+	if (cleartextData)
+	{
+		[ZDCFileConversion encryptCleartextData: cleartextData
+		                     toCacheFileWithKey: encryptionKey
+		                              outputURL: srcURL
+		                                  error: &error];
+	}
+	else
+	{
+		[ZDCFileConversion encryptCleartextFile: cleartextFileURL
+		                     toCacheFileWithKey: encryptionKey
+		                              outputURL: srcURL
+		                                  error: &error];
+	}
+	
+	if (error)
+	{
+		ZDCLogWarn(@"Error encrypting import cleartext: %@", error);
+		
+		[fileManager removeItemAtURL:srcURL error:nil];
+		
+		if (outError) *outError = error;
+		return nil;
+	}
+	
+	__block BOOL stored = NO;
+	
+	dispatch_block_t storeBlock = ^{ @autoreleasepool {
+		
+		// Another import (of the same content) may have beaten us here.
+		
+		blob = [blobStore blobForDigest:digest];
+		if (blob)
+		{
+			[blobStore retainBlob:blob];
+		}
+		else
 		{
-			map_auth0ID[hash] = identityID;
-			
-			[hashes removeObject:hash];
-			if (hashes.count == 0) return;
+			blob = [blobStore storeFileAtURL:srcURL digest:digest error:&error];
+			stored = (blob != nil);
 		}
-	}
-}
-
-- (NSString *)hashIdentityID:(NSString *)identityID forUser:(ZDCUser *)user
-{
-	// Purpose:
-	//
-	// We want to store the user avatar on disk.
-	// But we don't want to leak any information concerning who the user may be communicating with.
+	}};
 	
-	NSData *encryptionKey = user.random_encryptionKey;
-	NSData *identityIDBytes = [identityID dataUsingEncoding:NSUTF8StringEncoding];
+	if (dispatch_get_specific(IsOnCacheQueueKey))
+		storeBlock();
+	else
+		dispatch_sync(cacheQueue, storeBlock);
 	
-	NSMutableData *hashMe = [NSMutableData dataWithCapacity:(encryptionKey.length + identityIDBytes.length)];
-	[hashMe appendData:encryptionKey];
-	[hashMe appendData:identityIDBytes];
+	if (!stored) {
+		[fileManager removeItemAtURL:srcURL error:nil];
+	}
 	
-	NSData *hashedData = [hashMe hashWithAlgorithm:kHASH_Algorithm_SHA256 error:nil];
+	if (blob == nil) {
+		ZDCLogWarn(@"Error storing blob(%@): %@", digest, error);
+	}
 	
-	return [hashedData zBase32String];
+	if (outError) *outError = blob ? nil : error;
+	return blob;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1670,6 +4076,10 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 					
 					// And finally we can delete expired files
 					[weakSelf timerFire];
+					[weakSelf scheduleSlabCompaction];
+					
+					// The launch scans double as the first reconciliation of the storage counters.
+					[weakSelf scheduleStorageReconciliation];
 				}});
 			}}];
 		}});
@@ -1789,6 +4199,314 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 	}];
 }
 
+- (ZDCStorageCounter *)storageCounterForMode:(ZDCStorageMode)mode
+                                        type:(ZDCFileType)type
+                                      format:(ZDCCryptoFileFormat)format
+{
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
+	
+	if ((NSUInteger)mode >= 2 || (NSUInteger)type >= 3 || (NSUInteger)format >= 3) {
+		return nil;
+	}
+	
+	return storageCounters[mode][type][format];
+}
+
+/**
+ * Must be invoked after adding an info to one of the dicts.
+ */
+- (void)didAddInfo:(ZDCFileInfo *)info
+{
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
+	
+	[self addInfoToStorageCounter:info];
+	[self updateExpirationForInfo:info];
+	[self journalInfo:info];
+}
+
+- (void)addInfoToStorageCounter:(ZDCFileInfo *)info
+{
+	if (info->storageCounter) return;
+	
+	ZDCStorageCounter *counter = [self storageCounterForMode:info.mode type:info.type format:info.format];
+	if (counter)
+	{
+		counter->totalSize += info.fileSize;
+		counter->fileCount++;
+		
+		info->storageCounter = counter;
+	}
+}
+
+/**
+ * Must be invoked when removing an info from one of the dicts.
+ */
+- (void)didRemoveInfo:(ZDCFileInfo *)info
+{
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
+	
+	ZDCStorageCounter *counter = info->storageCounter;
+	if (counter)
+	{
+		counter->totalSize -= MIN(counter->totalSize, info.fileSize);
+		if (counter->fileCount > 0) {
+			counter->fileCount--;
+		}
+		
+		info->storageCounter = nil;
+	}
+	
+	[info.lru removeInfo:info];
+	[[self expirationHeapForType:info.type] removeInfo:info];
+	
+	NSString *filename = info.fileURL.lastPathComponent;
+	if (filename)
+	{
+		NSString *key = [ZDCDiskJournal keyForMode:info.mode type:info.type format:info.format filename:filename];
+		pendingJournal[key] = [NSNull null];
+		
+		[self scheduleJournalFlush];
+	}
+}
+
+/**
+ * Must be invoked when the info is accessed (i.e. exported).
+ */
+- (void)didAccessInfo:(ZDCFileInfo *)info
+{
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
+	
+	info.lastAccessed = [NSDate date];
+	[info.lru touchInfo:info];
+	
+	if (info.mode == ZDCStorageMode_Cache) {
+		[[self frequencySketchForType:info.type] incrementKey:[self frequencyKeyForInfo:info]];
+	}
+	
+	// We don't journal every access (that would mean a disk write for every read).
+	// Instead the dates are persisted during compaction.
+	journalStale = YES;
+}
+
+- (ZDCFileInfoLRU *)cachePoolForType:(ZDCFileType)type
+{
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
+	
+	switch (type)
+	{
+		case ZDCFileType_NodeData      : return lru_nodeData;
+		case ZDCFileType_NodeThumbnail : return lru_nodeThumbnails;
+		case ZDCFileType_UserAvatar    : return lru_userAvatars;
+		default                        : return nil;
+	}
+}
+
+/**
+ * Registers the info with the corresponding cache pool (as the most recently accessed item).
+ * Does nothing if the info isn't stored in the cache (i.e. it's stored persistently).
+ */
+- (void)addInfoToCachePool:(ZDCFileInfo *)info
+{
+	if (info.mode != ZDCStorageMode_Cache) return;
+	
+	ZDCFileType type = info.type;
+	
+	[[self frequencySketchForType:type] incrementKey:[self frequencyKeyForInfo:info]];
+	
+	if ([self cachePolicyForType:type] == ZDCDiskCachePolicy_TinyLFU)
+	{
+		// New items start out in the window.
+		// They're only admitted into the main region (when trimming) if they're accessed frequently enough.
+		
+		[[self cachePoolWindowForType:type] addInfo:info];
+	}
+	else
+	{
+		[[self cachePoolForType:type] addInfo:info];
+	}
+}
+
+/**
+ * Returns the window for the type.
+ * Only used when the type's cache policy is ZDCDiskCachePolicy_TinyLFU (otherwise the window is empty).
+ */
+- (ZDCFileInfoLRU *)cachePoolWindowForType:(ZDCFileType)type
+{
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
+	
+	switch (type)
+	{
+		case ZDCFileType_NodeData      : return window_nodeData;
+		case ZDCFileType_NodeThumbnail : return window_nodeThumbnails;
+		case ZDCFileType_UserAvatar    : return window_userAvatars;
+		default                        : return nil;
+	}
+}
+
+- (ZDCFrequencySketch *)frequencySketchForType:(ZDCFileType)type
+{
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
+	
+	switch (type)
+	{
+		case ZDCFileType_NodeData      : return frequencies_nodeData;
+		case ZDCFileType_NodeThumbnail : return frequencies_nodeThumbnails;
+		case ZDCFileType_UserAvatar    : return frequencies_userAvatars;
+		default                        : return nil;
+	}
+}
+
+/**
+ * The filename is unique within the directory (i.e. nodeID, or userID + identityID).
+ * And the cloudfile & cachefile formats of the same item share the key, which is what we want.
+ */
+- (NSString *)frequencyKeyForInfo:(ZDCFileInfo *)info
+{
+	return info.fileURL.lastPathComponent ?: @"";
+}
+
+- (ZDCDiskCachePolicy)cachePolicyForType:(ZDCFileType)type
+{
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
+	
+	switch (type)
+	{
+		case ZDCFileType_NodeData      : return cachePolicy_nodeData;
+		case ZDCFileType_NodeThumbnail : return cachePolicy_nodeThumbnails;
+		case ZDCFileType_UserAvatar    : return cachePolicy_userAvatars;
+		default                        : return ZDCDiskCachePolicy_LRU;
+	}
+}
+
+/**
+ * The cache policies are stored as xattrs on the cache directories.
+ * So we load them once (at launch), rather than every time an item is added to a cache pool.
+ */
+- (void)loadCachePolicies
+{
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
+	
+	cachePolicy_nodeData       = self.nodeDataCachePolicy;
+	cachePolicy_nodeThumbnails = self.nodeThumbnailsCachePolicy;
+	cachePolicy_userAvatars    = self.userAvatarsCachePolicy;
+}
+
+/**
+ * Must be invoked after the configured cache policy for the type is changed.
+ */
+- (void)setCachePolicy:(ZDCDiskCachePolicy)policy forCachePoolOfType:(ZDCFileType)type
+{
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
+	
+	switch (type)
+	{
+		case ZDCFileType_NodeData      : cachePolicy_nodeData       = policy; break;
+		case ZDCFileType_NodeThumbnail : cachePolicy_nodeThumbnails = policy; break;
+		case ZDCFileType_UserAvatar    : cachePolicy_userAvatars    = policy; break;
+	}
+	
+	if (policy != ZDCDiskCachePolicy_TinyLFU)
+	{
+		// Everything in the window is more recent than everything in the main region.
+		// So we can move them over (oldest first) without disturbing the recency order.
+		
+		ZDCFileInfoLRU *window = [self cachePoolWindowForType:type];
+		ZDCFileInfoLRU *lru = [self cachePoolForType:type];
+		
+		ZDCFileInfo *info = nil;
+		while ((info = window.leastRecent))
+		{
+			[lru addInfo:info];
+		}
+	}
+	
+	[self maybeTrimCachePool:type];
+}
+
+- (ZDCExpirationHeap *)expirationHeapForType:(ZDCFileType)type
+{
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
+	
+	switch (type)
+	{
+		case ZDCFileType_NodeData      : return expirations_nodeData;
+		case ZDCFileType_NodeThumbnail : return expirations_nodeThumbnails;
+		case ZDCFileType_UserAvatar    : return expirations_userAvatars;
+		default                        : return nil;
+	}
+}
+
+/**
+ * The default expirations are stored as xattrs on the cache directories.
+ * So we load them once (at launch), rather than every time an item is added to a heap.
+ */
+- (void)loadDefaultExpirations
+{
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
+	
+	expirations_nodeData.defaultExpiration       = self.defaultNodeDataCacheExpiration;
+	expirations_nodeThumbnails.defaultExpiration = self.defaultNodeThumbnailCacheExpiration;
+	expirations_userAvatars.defaultExpiration    = self.defaultUserAvatarCacheExpiration;
+}
+
+/**
+ * Must be invoked after changing the info's lastModified or expiration values.
+ * (Adding the info to one of the dicts is handled by didAddInfo.)
+ *
+ * Also required when an item is rescued from pendingDelete,
+ * since an expired item is popped from the heap even if it couldn't be deleted yet.
+ */
+- (void)updateExpirationForInfo:(ZDCFileInfo *)info
+{
+	[[self expirationHeapForType:info.type] updateInfo:info];
+}
+
+/**
+ * Must be invoked after the configured default expiration for the type is changed.
+ * Every item that relies on the default needs to be repositioned within the heap.
+ */
+- (void)setDefaultExpiration:(NSTimeInterval)interval forExpirationHeapOfType:(ZDCFileType)type
+{
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
+	
+	ZDCExpirationHeap *heap = [self expirationHeapForType:type];
+	if (heap == nil || heap.defaultExpiration == interval) {
+		return;
+	}
+	
+	heap.defaultExpiration = interval;
+	
+	NSDictionary<NSString *, NSMutableArray<ZDCFileInfo *> *> *dict = nil;
+	switch (type)
+	{
+		case ZDCFileType_NodeData      : dict = dict_nodeData;       break;
+		case ZDCFileType_NodeThumbnail : dict = dict_nodeThumbnails; break;
+		case ZDCFileType_UserAvatar    : dict = dict_userAvatars;    break;
+	}
+	
+	for (NSArray<ZDCFileInfo *> *infos in [dict objectEnumerator])
+	{
+		for (ZDCFileInfo *info in infos)
+		{
+			[heap updateInfo:info];
+		}
+	}
+	
+	[self maybeUpdateExpirationTimer:type];
+}
+
+- (void)sortInfosByLastAccessed:(NSMutableArray<ZDCFileInfo *> *)infos
+{
+	// From the docs (NSArray):
+	//
+	// > [sorts the array] in ascending order
+	//
+	[infos sortUsingComparator:^NSComparisonResult(ZDCFileInfo *infoA, ZDCFileInfo *infoB) {
+	
+		return [infoA.lastAccessed compare:infoB.lastAccessed];
+	}];
+}
+
 - (void)maybeTrimCachePool:(ZDCFileType)type
 {
 	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
@@ -1827,69 +4545,127 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 		}
 	}
 	
-	NSMutableArray<ZDCFileInfo*> *targetInfos = [NSMutableArray array];
-	uint64_t totalSize = 0;
+	// The cache pool maintains a running total of its size,
+	// and keeps its items ordered from least recently accessed to most recently accessed.
+	// So we simply evict from the head until we're back under the limit.
+	//
+	// With the TinyLFU policy, the pool is split into a window (new items) and the main region.
+	// Items that fall out of the window become candidates for the main region,
+	// and each candidate must out-rank (by access frequency) every victim it would displace.
+	// A candidate that loses is evicted instead.
+	//
+	// Note: Items that are pendingDelete have already been unlinked from the cache pool.
+	
+	ZDCFileInfoLRU *lru = [self cachePoolForType:type];
+	ZDCFileInfoLRU *window = [self cachePoolWindowForType:type];
 	
-	for (NSArray<ZDCFileInfo *> *infos in [dict objectEnumerator])
+	NSMutableArray<ZDCFileInfo *> *candidates = nil;
+	
+	if ([self cachePolicyForType:type] == ZDCDiskCachePolicy_TinyLFU)
 	{
-		for (ZDCFileInfo *info in infos)
+		uint64_t windowTargetSize = (uint64_t)(targetSize * kTinyLFUWindowFraction);
+		
+		// The most recently added item always stays in the window,
+		// even if it's bigger than the window by itself.
+		
+		ZDCFileInfo *info = nil;
+		while ((window.totalSize > windowTargetSize) && (window.count > 1) && (info = window.leastRecent))
 		{
-			if ((info.mode == ZDCStorageMode_Cache) && (info.type == type) && !info.pendingDelete)
-			{
-				[targetInfos addObject:info];
-				totalSize += info.fileSize;
+			if (candidates == nil) {
+				candidates = [NSMutableArray array];
 			}
+			
+			[lru addInfo:info]; // moves to the most recently accessed end of the main region
+			[candidates addObject:info];
 		}
 	}
 	
-	if (totalSize <= targetSize) {
+	if ((lru.totalSize + window.totalSize) <= targetSize) {
 		return;
 	}
 	
-	// From the docs (NSArray):
-	//
-	// > [sorts the array] in ascending order
-	//
-	[targetInfos sortUsingComparator:^NSComparisonResult(ZDCFileInfo *infoA, ZDCFileInfo *infoB) {
+	ZDCFrequencySketch *sketch = [self frequencySketchForType:type];
+	[sketch ensureCapacity:(lru.count + window.count)];
+	
+	NSUInteger candidateIndex = 0;
+	
+	while ((lru.totalSize + window.totalSize) > targetSize)
+	{
+		ZDCFileInfo *victim = lru.leastRecent ?: window.leastRecent;
+		if (victim == nil) break;
 		
-		// From the docs (NSDate):
-		//
-		// > NSOrderedDescending : The receiver is later in time than anotherDate
-		// > NSOrderedAscending  : The receiver is earlier in time than anotherDate
+		// Skip candidates that have already been evicted.
 		
-		return [infoA.lastAccessed compare:infoB.lastAccessed];
-	}];
-	
-	// So at this point, the earliest date should be at index 0, and the latest date at the end of the array.
+		ZDCFileInfo *candidate = nil;
+		while (candidateIndex < candidates.count)
+		{
+			ZDCFileInfo *info = candidates[candidateIndex];
+			if (info.lru == lru && info->lruLinked)
+			{
+				candidate = info;
+				break;
+			}
+			
+			candidateIndex++;
+		}
+		
+		if (candidate == nil || candidate == victim)
+		{
+			// Either we're using the LRU policy,
+			// or the main region only contains candidates (so they're evicted in LRU order).
+			
+			[self evictInfo:victim fromDict:dict changes:changes];
+		}
+		else if ([sketch shouldAdmitKey:[self frequencyKeyForInfo:candidate]
+		                        overKey:[self frequencyKeyForInfo:victim]])
+		{
+			[self evictInfo:victim fromDict:dict changes:changes];
+		}
+		else
+		{
+			[self evictInfo:candidate fromDict:dict changes:changes];
+			candidateIndex++;
+		}
+	}
 	
-	while ((totalSize > targetSize) && (targetInfos.count > 0))
+	[self postDiskManagerChangedNotification];
+}
+
+/**
+ * Deletes the item (or marks it as pendingDelete if it's in use).
+ * Either way, the item is unlinked from its cache pool.
+ */
+- (void)evictInfo:(ZDCFileInfo *)info
+         fromDict:(NSMutableDictionary<NSString *, NSMutableArray<ZDCFileInfo *> *> *)dict
+          changes:(NSMutableSet<NSString*> *)changes
+{
+	if (info.fileRetainCount == 0)
 	{
-		ZDCFileInfo *info = [targetInfos lastObject];
-		[targetInfos removeLastObject];
+		NSError *error = nil;
+		[self removeFileForInfo:info error:&error];
+		
+		if (error) {
+			ZDCLogWarn(@"Error deleting fileURL(%@): %@", [info.fileURL path], error);
+		}
+		
+		[self didRemoveInfo:info];
 		
-		if (info.fileRetainCount == 0)
+		NSString *key = info.nodeID ?: info.userID;
+		if (key)
 		{
-			NSError *error = nil;
-			[[NSFileManager defaultManager] removeItemAtURL:info.fileURL error:&error];
-			
-			if (error) {
-				ZDCLogWarn(@"Error deleting fileURL(%@): %@", [info.fileURL path], error);
+			NSMutableArray<ZDCFileInfo *> *infos = dict[key];
+			[infos removeObjectIdenticalTo:info];
+			if (infos.count == 0) {
+				[dict removeObjectForKey:key];
 			}
 			
-			NSString *key = info.nodeID ?: info.userID;
-			
-			[dict[key] removeObjectIdenticalTo:info];
 			[changes addObject:key];
 		}
-		else
-		{
-			info.pendingDelete = YES;
-		}
-		
-		totalSize -= info.fileSize;
 	}
-	
-	[self postDiskManagerChangedNotification];
+	else
+	{
+		info.pendingDelete = YES; // unlinks from cache pool
+	}
 }
 
 - (void)deleteExpiredItemsFromCachePool:(ZDCFileType)type
@@ -1898,7 +4674,6 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 	
 	NSMutableDictionary<NSString *, NSMutableArray<ZDCFileInfo *> *> *dict = nil;
 	NSMutableSet<NSString*> *changes = nil;
-	NSTimeInterval defaultExpiration = 0;
 	
 	switch (type)
 	{
@@ -1906,21 +4681,18 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 		{
 			dict = dict_nodeData;
 			changes = changes_nodeData;
-			defaultExpiration = self.defaultNodeDataCacheExpiration;
 			break;
 		}
 		case ZDCFileType_NodeThumbnail:
 		{
 			dict = dict_nodeThumbnails;
 			changes = changes_nodeThumbnails;
-			defaultExpiration = self.defaultNodeThumbnailCacheExpiration;
 			break;
 		}
 		case ZDCFileType_UserAvatar:
 		{
 			dict = dict_userAvatars;
 			changes = changes_userAvatars;
-			defaultExpiration = self.defaultUserAvatarCacheExpiration;
 			break;
 		}
 		default:
@@ -1930,56 +4702,43 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 		}
 	}
 	
+	// The heap keeps the items ordered by expiration date.
+	// So we simply pop from the top until we reach an item that hasn't expired yet.
+	
+	ZDCExpirationHeap *heap = [self expirationHeapForType:type];
 	NSDate *now = [NSDate date];
 	
-	for (NSMutableArray<ZDCFileInfo *> *infos in [dict objectEnumerator])
+	ZDCFileInfo *info = nil;
+	while ((info = [heap popInfoExpiredAsOf:now]))
 	{
-		NSUInteger i = 0;
-		while (i < infos.count)
+		if (info.fileRetainCount == 0)
 		{
-			ZDCFileInfo *info = infos[i];
+			NSError *error = nil;
+			[self removeFileForInfo:info error:&error];
 			
-			BOOL shouldDelete = NO;
-			if (info.mode == ZDCStorageMode_Cache)
-			{
-				NSTimeInterval expirationInterval = info.expiration;
-				if (expirationInterval == 0) {
-					expirationInterval = defaultExpiration;
-				}
-				
-				if (expirationInterval > 0)
-				{
-					NSDate *expirationDate = [info.lastModified dateByAddingTimeInterval:expirationInterval];
-					shouldDelete = (expirationDate == nil) || [expirationDate isBeforeOrEqual:now];
-				}
+			if (error) {
+				ZDCLogWarn(@"Error deleting fileURL(%@): %@", [info.fileURL path], error);
 			}
 			
-			if (shouldDelete)
+			[self didRemoveInfo:info];
+			
+			NSString *key = info.nodeID ?: info.userID;
+			if (key)
 			{
-				if (info.fileRetainCount == 0)
-				{
-					NSError *error = nil;
-					[[NSFileManager defaultManager] removeItemAtURL:info.fileURL error:&error];
-					
-					if (error) {
-						ZDCLogWarn(@"Error deleting fileURL(%@): %@", [info.fileURL path], error);
-					}
-					
-					NSString *key = info.nodeID ?: info.userID;
-					[changes addObject:key];
-					
-					[infos removeObjectAtIndex:i];
-				}
-				else
-				{
-					info.pendingDelete = YES;
-					i++;
+				NSMutableArray<ZDCFileInfo *> *infos = dict[key];
+				[infos removeObjectIdenticalTo:info];
+				if (infos.count == 0) {
+					[dict removeObjectForKey:key];
 				}
+				
+				[changes addObject:key];
 			}
-			else
-			{
-				i++;
-			}
+		}
+		else
+		{
+			// The item will be deleted when its last retainToken is released.
+			// Note: It's been removed from the heap, so the timer won't keep firing for it.
+			info.pendingDelete = YES;
 		}
 	}
 	
@@ -1992,65 +4751,7 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 {
 	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
 	
-	NSMutableDictionary<NSString *, NSMutableArray<ZDCFileInfo *> *> *dict = nil;
-	NSTimeInterval defaultExpiration = 0;
-	
-	switch (type)
-	{
-		case ZDCFileType_NodeData:
-		{
-			dict = dict_nodeData;
-			defaultExpiration = self.defaultNodeDataCacheExpiration;
-			break;
-		}
-		case ZDCFileType_NodeThumbnail:
-		{
-			dict = dict_nodeThumbnails;
-			defaultExpiration = self.defaultNodeThumbnailCacheExpiration;
-			break;
-		}
-		case ZDCFileType_UserAvatar:
-		{
-			dict = dict_userAvatars;
-			defaultExpiration = self.defaultUserAvatarCacheExpiration;
-			break;
-		}
-		default:
-		{
-			NSAssert(NO, @"Invalid ZDCFileType: %ld", (long)type);
-			break;
-		}
-	}
-	
-	NSDate *next = nil;
-	
-	for (NSArray<ZDCFileInfo *> *infos in [dict objectEnumerator])
-	{
-		for (ZDCFileInfo *info in infos)
-		{
-			if (info.mode == ZDCStorageMode_Cache)
-			{
-				NSTimeInterval expirationInterval = info.expiration;
-				if (expirationInterval <= 0) {
-					expirationInterval = defaultExpiration;
-				}
-				
-				if (expirationInterval > 0)
-				{
-					NSDate *expirationDate = [info.lastModified dateByAddingTimeInterval:expirationInterval];
-					if (expirationDate)
-					{
-						if ((next == nil) || [next isAfter:expirationDate])
-						{
-							next = expirationDate;
-						}
-					}
-				}
-			}
-		}
-	}
-	
-	return next;
+	return [self expirationHeapForType:type].nextExpirationDate;
 }
 
 - (void)updateExpirationTimer
@@ -2310,6 +5011,78 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 	}});
 }
 
+- (ZDCDiskCachePolicy)nodeDataCachePolicy
+{
+	NSURL *url = [self URLForMode: ZDCStorageMode_Cache
+	                         type: ZDCFileType_NodeData
+	                       format: ZDCCryptoFileFormat_CacheFile];
+	
+	return [self cachePolicyForURL:url withDefaultValue:kDefaultConfiguration_nodeDataCachePolicy];
+}
+
+- (void)setNodeDataCachePolicy:(ZDCDiskCachePolicy)policy
+{
+	ZDCFileType type = ZDCFileType_NodeData;
+	NSURL *url = [self URLForMode: ZDCStorageMode_Cache
+	                         type: type
+	                       format: ZDCCryptoFileFormat_CacheFile];
+	
+	[self setCachePolicy:policy forURL:url];
+	
+	dispatch_async(cacheQueue, ^{ @autoreleasepool {
+	
+		[self setCachePolicy:policy forCachePoolOfType:type];
+	}});
+}
+
+- (ZDCDiskCachePolicy)nodeThumbnailsCachePolicy
+{
+	NSURL *url = [self URLForMode: ZDCStorageMode_Cache
+	                         type: ZDCFileType_NodeThumbnail
+	                       format: ZDCCryptoFileFormat_CacheFile];
+	
+	return [self cachePolicyForURL:url withDefaultValue:kDefaultConfiguration_nodeThumbnailsCachePolicy];
+}
+
+- (void)setNodeThumbnailsCachePolicy:(ZDCDiskCachePolicy)policy
+{
+	ZDCFileType type = ZDCFileType_NodeThumbnail;
+	NSURL *url = [self URLForMode: ZDCStorageMode_Cache
+	                         type: type
+	                       format: ZDCCryptoFileFormat_CacheFile];
+	
+	[self setCachePolicy:policy forURL:url];
+	
+	dispatch_async(cacheQueue, ^{ @autoreleasepool {
+	
+		[self setCachePolicy:policy forCachePoolOfType:type];
+	}});
+}
+
+- (ZDCDiskCachePolicy)userAvatarsCachePolicy
+{
+	NSURL *url = [self URLForMode: ZDCStorageMode_Cache
+	                         type: ZDCFileType_UserAvatar
+	                       format: ZDCCryptoFileFormat_CacheFile];
+	
+	return [self cachePolicyForURL:url withDefaultValue:kDefaultConfiguration_userAvatarsCachePolicy];
+}
+
+- (void)setUserAvatarsCachePolicy:(ZDCDiskCachePolicy)policy
+{
+	ZDCFileType type = ZDCFileType_UserAvatar;
+	NSURL *url = [self URLForMode: ZDCStorageMode_Cache
+	                         type: type
+	                       format: ZDCCryptoFileFormat_CacheFile];
+	
+	[self setCachePolicy:policy forURL:url];
+	
+	dispatch_async(cacheQueue, ^{ @autoreleasepool {
+	
+		[self setCachePolicy:policy forCachePoolOfType:type];
+	}});
+}
+
 - (NSTimeInterval)defaultNodeDataCacheExpiration
 {
 	NSURL *url = [self URLForMode: ZDCStorageMode_Cache
@@ -2326,11 +5099,17 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 
 - (void)setDefaultNodeDataCacheExpiration:(NSTimeInterval)interval
 {
+	ZDCFileType type = ZDCFileType_NodeData;
 	NSURL *url = [self URLForMode: ZDCStorageMode_Cache
-	                         type: ZDCFileType_NodeData
+	                         type: type
 	                       format: ZDCCryptoFileFormat_CacheFile];
 	
 	[self setExpiration:interval forURL:url];
+	
+	dispatch_async(cacheQueue, ^{ @autoreleasepool {
+	
+		[self setDefaultExpiration:interval forExpirationHeapOfType:type];
+	}});
 }
 
 - (NSTimeInterval)defaultNodeThumbnailCacheExpiration
@@ -2349,11 +5128,17 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 
 - (void)setDefaultNodeThumbnailCacheExpiration:(NSTimeInterval)interval
 {
+	ZDCFileType type = ZDCFileType_NodeThumbnail;
 	NSURL *url = [self URLForMode: ZDCStorageMode_Cache
-	                         type: ZDCFileType_NodeThumbnail
+	                         type: type
 	                       format: ZDCCryptoFileFormat_CacheFile];
 	
 	[self setExpiration:interval forURL:url];
+	
+	dispatch_async(cacheQueue, ^{ @autoreleasepool {
+	
+		[self setDefaultExpiration:interval forExpirationHeapOfType:type];
+	}});
 }
 
 - (NSTimeInterval)defaultUserAvatarCacheExpiration
@@ -2372,11 +5157,17 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 
 - (void)setDefaultUserAvatarCacheExpiration:(NSTimeInterval)interval
 {
+	ZDCFileType type = ZDCFileType_UserAvatar;
 	NSURL *url = [self URLForMode: ZDCStorageMode_Cache
-	                         type: ZDCFileType_UserAvatar
+	                         type: type
 	                       format: ZDCCryptoFileFormat_CacheFile];
 	
 	[self setExpiration:interval forURL:url];
+	
+	dispatch_async(cacheQueue, ^{ @autoreleasepool {
+	
+		[self setDefaultExpiration:interval forExpirationHeapOfType:type];
+	}});
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -2419,6 +5210,48 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 	}
 }
 
+- (ZDCDiskCachePolicy)cachePolicyForURL:(NSURL *)url withDefaultValue:(ZDCDiskCachePolicy)defaultValue
+{
+	const char *path = [[url path] UTF8String];
+	const char *name = [kXattrName_cachePolicy UTF8String];
+	
+	int32_t value = 0;
+	
+	ssize_t result = getxattr(path, name, &value, sizeof(value), 0, 0);
+	
+	if (result < 0)
+	{
+		if (errno != ENOATTR) {
+			ZDCLogError(@"getxattr(%@): error = %s", [url path], strerror(errno));
+		}
+	}
+	
+	if (result != sizeof(value)) {
+		return defaultValue;
+	}
+	
+	switch (value)
+	{
+		case ZDCDiskCachePolicy_LRU     : return ZDCDiskCachePolicy_LRU;
+		case ZDCDiskCachePolicy_TinyLFU : return ZDCDiskCachePolicy_TinyLFU;
+		default                         : return defaultValue;
+	}
+}
+
+- (void)setCachePolicy:(ZDCDiskCachePolicy)policy forURL:(NSURL *)url
+{
+	const char *path = [[url path] UTF8String];
+	const char *name = [kXattrName_cachePolicy UTF8String];
+	
+	int32_t value = (int32_t)policy;
+	
+	int result = setxattr(path, name, &value, sizeof(value), 0, 0);
+	
+	if (result < 0) {
+		ZDCLogError(@"setxattr(%@): error = %s", [url path], strerror(errno));
+	}
+}
+
 - (BOOL)shouldMigrateAfterUploadForURL:(NSURL *)url
 {
 	const char *path = [[url path] UTF8String];
@@ -2547,7 +5380,13 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 	}
 }
 
-- (BOOL)getETag:(NSString **)outETag forURL:(NSURL *)url withEncryptionKey:(NSData *)encryptionKey
+/**
+ * Reads the eTag xattr, without decrypting it.
+ *
+ * On success, outEncryptedETag is set to either the encrypted value (NSData),
+ * or NSNull if the file doesn't have an eTag.
+ */
+- (BOOL)getEncryptedETag:(id *)outEncryptedETag forURL:(NSURL *)url
 {
 	const char *path = [[url path] UTF8String];
 	const char *name = [kXattrName_eTag UTF8String];
@@ -2557,12 +5396,13 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 	
 	ssize_t result = getxattr(path, name, &buffer, bufferSize, 0, 0);
 	
-	NSString *eTag = nil;
+	id encryptedETag = nil;
 	BOOL success = NO;
 	
 	if (result < 0)
 	{
 		if (errno == ENOATTR) {
+			encryptedETag = [NSNull null];
 			success = YES;
 		}
 		else {
@@ -2571,61 +5411,158 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 	}
 	else if (result == 0)
 	{
+		encryptedETag = [NSNull null];
 		success = YES;
 	}
 	else // if (result > 0)
 	{
-		NSData *encrypted = [NSData dataWithBytesNoCopy:buffer length:result freeWhenDone:NO];
-		
-		NSError *error = nil;
-		NSData *decrypted = [encrypted decryptedDataWithSymmetricKey:encryptionKey error:&error];
-		
-		if (error) {
-			ZDCLogError(@"decryption error: %@", error);
-		}
-		else {
-			eTag = [[NSString alloc] initWithData:decrypted encoding:NSUTF8StringEncoding];
-			success = (eTag != nil);
-		}
+		encryptedETag = [NSData dataWithBytes:buffer length:result];
+		success = YES;
 	}
 	
-	if (outETag) *outETag = nil;
+	if (outEncryptedETag) *outEncryptedETag = encryptedETag;
 	return success;
 }
 
-- (void)setETag:(NSString *)eTag forURL:(NSURL *)url withEncryptionKey:(NSData *)encryptionKey
+/**
+ * Files that were copied out of a blob (e.g. made persistent) remain encrypted with the blob's key.
+ * The xattr records the content digest, from which the key can be derived.
+ */
+- (nullable NSString *)contentDigestForURL:(NSURL *)url
+{
+	const char *path = [[url path] UTF8String];
+	const char *name = [kXattrName_contentDigest UTF8String];
+	
+	const size_t bufferSize = 128;
+	uint8_t buffer[bufferSize];
+	
+	ssize_t result = getxattr(path, name, &buffer, bufferSize, 0, 0);
+	
+	if (result < 0)
+	{
+		if (errno != ENOATTR) {
+			ZDCLogError(@"getxattr(%@): error = %s", [url path], strerror(errno));
+		}
+		return nil;
+	}
+	
+	if (result == 0) {
+		return nil;
+	}
+	
+	return [[NSString alloc] initWithBytes:buffer length:result encoding:NSUTF8StringEncoding];
+}
+
+- (void)setContentDigest:(NSString *)digest forURL:(NSURL *)url
+{
+	const char *path = [[url path] UTF8String];
+	const char *name = [kXattrName_contentDigest UTF8String];
+	
+	NSData *value = [digest dataUsingEncoding:NSUTF8StringEncoding];
+	
+	int result = setxattr(path, name, [value bytes], value.length, 0, 0);
+	
+	if (result < 0) {
+		ZDCLogError(@"setxattr(%@): error = %s", [url path], strerror(errno));
+	}
+}
+
+/**
+ * Returns the eTag for the given info.
+ *
+ * The encrypted eTag is loaded into the index alongside the rest of the info
+ * (when the directory is scanned, or the index is restored from the journal).
+ * So this doesn't touch the filesystem, and only decrypts the first time it's invoked for the info.
+ */
+- (nullable NSString *)eTagForInfo:(ZDCFileInfo *)info withEncryptionKey:(NSData *)encryptionKey
 {
-	const char *path = [[url path] UTF8String];
-	const char *name = [kXattrName_eTag UTF8String];
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
 	
-	if (eTag)
+	if (info.eTag == nil)
 	{
-		NSData *decrypted = [eTag dataUsingEncoding:NSUTF8StringEncoding];
-		
-		NSError *error = nil;
-		NSData *encrypted = [decrypted encryptedDataWithSymmetricKey:encryptionKey error:&error];
-		
-		if (error)
+		if (info.encryptedETag == nil && !info.isStoredInDirectory)
 		{
-			ZDCLogError(@"encryption error: %@", error);
+			// Packed (and deduplicated) items don't have xattrs.
+			// So if the journal didn't have the eTag, the item doesn't have one.
+			
+			info.encryptedETag = [NSNull null];
 		}
-		else if (encrypted)
+		else if (info.encryptedETag == nil)
 		{
-			const void *buffer = [encrypted bytes];
+			// Edge case: we failed to read the xattr when the info was loaded.
 			
-			int result = setxattr(path, name, buffer, encrypted.length, 0, 0);
+			id encryptedETag = nil;
+			if ([self getEncryptedETag:&encryptedETag forURL:info.fileURL])
+			{
+				info.encryptedETag = encryptedETag;
+				[self journalInfo:info];
+			}
+		}
+		
+		id encryptedETag = info.encryptedETag;
+		if ([encryptedETag isKindOfClass:[NSData class]])
+		{
+			NSError *error = nil;
+			NSData *decrypted = [(NSData *)encryptedETag decryptedDataWithSymmetricKey:encryptionKey error:&error];
 			
-			if (result < 0) {
-				ZDCLogError(@"setxattr(%@): error = %s", [url path], strerror(errno));
+			if (error) {
+				ZDCLogError(@"decryption error: %@", error);
 			}
+			else {
+				info.eTag = [[NSString alloc] initWithData:decrypted encoding:NSUTF8StringEncoding];
+			}
+		}
+		else if (encryptedETag)
+		{
+			info.eTag = [NSNull null];
 		}
 	}
-	else
+	
+	id eTag = info.eTag;
+	return [eTag isKindOfClass:[NSString class]] ? (NSString *)eTag : nil;
+}
+
+/**
+ * Updates the info's eTag, and writes the corresponding (encrypted) xattr (unless the file is packed).
+ * Passing a nil eTag marks the info as not having an eTag. (The file is expected to be freshly imported.)
+ */
+- (void)setETag:(nullable NSString *)eTag forInfo:(ZDCFileInfo *)info withEncryptionKey:(NSData *)encryptionKey
+{
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
+	
+	info.eTag = eTag ?: [NSNull null];
+	info.encryptedETag = [NSNull null];
+	
+	if (eTag == nil) {
+		return;
+	}
+	
+	NSData *decrypted = [eTag dataUsingEncoding:NSUTF8StringEncoding];
+	
+	NSError *error = nil;
+	NSData *encrypted = [decrypted encryptedDataWithSymmetricKey:encryptionKey error:&error];
+	
+	if (error)
 	{
-		int result = removexattr(path, name, 0);
+		ZDCLogError(@"encryption error: %@", error);
+	}
+	else if (encrypted && !info.isStoredInDirectory)
+	{
+		// Packed (and deduplicated) items don't have xattrs. The journal is the only record of the eTag.
+		info.encryptedETag = encrypted;
+	}
+	else if (encrypted)
+	{
+		const char *path = [[info.fileURL path] UTF8String];
+		const char *name = [kXattrName_eTag UTF8String];
+		
+		int result = setxattr(path, name, [encrypted bytes], encrypted.length, 0, 0);
 		
 		if (result < 0) {
-			ZDCLogError(@"removexattr(%@): error = %s", [url path], strerror(errno));
+			ZDCLogError(@"setxattr(%@): error = %s", [info.fileURL path], strerror(errno));
+		}
+		else {
+			info.encryptedETag = encrypted;
 		}
 	}
 }
@@ -2674,6 +5611,7 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 	}
 	
 	NSURL *srcURL = nil;
+	ZDCDiskBlob *blob = nil;
 	
 	void (^WarnIfMainThread)(void) = ^{
 		if ([NSThread isMainThread]) {
@@ -2681,7 +5619,19 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 		}
 	};
 	
-	if (import.cleartextData)
+	if (import.deduplicate && !import.storePersistently && !import.cryptoFile)
+	{
+		WarnIfMainThread();
+		
+		ZDCDiskBlobStore *blobStore =
+		  [self blobStoreForMode:ZDCStorageMode_Cache type:ZDCFileType_NodeData format:ZDCCryptoFileFormat_CacheFile];
+		
+		blob = [self importBlobWithCleartextData: import.cleartextData
+		                        cleartextFileURL: import.cleartextFileURL
+		                               blobStore: blobStore
+		                                   error: &error];
+	}
+	else if (import.cleartextData)
 	{
 		WarnIfMainThread();
 		
@@ -2742,20 +5692,28 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 	NSURL *dir = [self URLForMode:mode type:type format:format];
 	NSURL *dstURL = [dir URLByAppendingPathComponent:node.uuid isDirectory:NO];
 	
-	[fileManager moveItemAtURL:srcURL toURL:dstURL error:&error];
-	
-	if (error)
+	NSNumber *fileSize = nil;
+	if (blob)
+	{
+		// Deduplicated items don't have a file of their own. They reference the blob's file.
+		fileSize = @(blob.length);
+	}
+	else
 	{
-		ZDCLogWarn(@"Error moving file: src(%@) -> dst(%@): %@",
-		            [srcURL path], [dstURL path], error);
+		[fileManager moveItemAtURL:srcURL toURL:dstURL error:&error];
 		
-		if (outError) *outError = error;
-		return nil;
+		if (error)
+		{
+			ZDCLogWarn(@"Error moving file: src(%@) -> dst(%@): %@",
+			            [srcURL path], [dstURL path], error);
+			
+			if (outError) *outError = error;
+			return nil;
+		}
+		
+		[dstURL getResourceValue:&fileSize forKey:NSURLFileSizeKey error:nil];
 	}
 	
-	NSNumber *fileSize = nil;
-	[dstURL getResourceValue:&fileSize forKey:NSURLFileSizeKey error:nil];
-	
 	__block ZDCFileRetainToken *retainToken = nil;
 	
 	dispatch_block_t block = ^{ @autoreleasepool {
@@ -2792,12 +5750,13 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 				if (info.fileRetainCount == 0)
 				{
 					NSError *error = nil;
-					[[NSFileManager defaultManager] removeItemAtURL:info.fileURL error:&error];
+					[self removeFileForInfo:info error:&error];
 					
 					if (error) {
 						ZDCLogWarn(@"Error deleting fileURL(%@): %@", [info.fileURL path], error);
 					}
 					
+					[self didRemoveInfo:info];
 					[infos removeObjectAtIndex:i];
 				}
 				else
@@ -2819,32 +5778,52 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 			matchingInfo.nodeID = node.uuid;
 			
 			[infos addObject:matchingInfo];
+			[self didAddInfo:matchingInfo];
+		}
+		
+		if (matchingInfo.blob)
+		{
+			// Release the reference to the previous content.
+			// (The new file, if any, has already replaced whatever was at dstURL.)
+			[self removeFileForInfo:matchingInfo error:nil];
+		}
+		else if (blob)
+		{
+			// The previous content was a regular file.
+			[fileManager removeItemAtURL:dstURL error:nil];
 		}
 		
+		matchingInfo.blob = blob;
+		matchingInfo.contentDigest = blob.digest;
 		matchingInfo.fileSize = [fileSize unsignedLongLongValue];
 		
 		NSDate *now = [NSDate date];
 		matchingInfo.lastAccessed = now;
 		matchingInfo.lastModified = now;
 		
+		[self addInfoToCachePool:matchingInfo]; // or touch, if already in the pool
+		[self journalInfo:matchingInfo];
+		
 		matchingInfo.migrateAfterUpload = import.migrateToCacheAfterUpload;
 		matchingInfo.deleteAfterUpload = import.deleteAfterUpload;
 		matchingInfo.expiration = import.expiration;
-		matchingInfo.eTag = import.eTag ?: [NSNull null];
 		
-		if (import.storePersistently && import.migrateToCacheAfterUpload) {
-			[self setShouldMigrateAfterUpload:YES forURL:dstURL];
-		}
-		if (import.deleteAfterUpload) {
-			[self setShouldDeleteAfterUpload:YES forURL:dstURL];
-		}
-		if (import.expiration != 0) {
-			// Write xattr even if not persistent (in case file is migrated)
-			[self setExpiration:import.expiration forURL:dstURL];
-		}
-		if (import.eTag) {
-			[self setETag:import.eTag forURL:dstURL withEncryptionKey:node.encryptionKey];
+		[self updateExpirationForInfo:matchingInfo];
+		
+		if (matchingInfo.isStoredInDirectory) // deduplicated items don't have xattrs
+		{
+			if (import.storePersistently && import.migrateToCacheAfterUpload) {
+				[self setShouldMigrateAfterUpload:YES forURL:dstURL];
+			}
+			if (import.deleteAfterUpload) {
+				[self setShouldDeleteAfterUpload:YES forURL:dstURL];
+			}
+			if (import.expiration != 0) {
+				// Write xattr even if not persistent (in case file is migrated)
+				[self setExpiration:import.expiration forURL:dstURL];
+			}
 		}
+		[self setETag:import.eTag forInfo:matchingInfo withEncryptionKey:node.encryptionKey];
 		
 		[matchingInfo incrementFileRetainCount];
 		retainToken = [[ZDCFileRetainToken alloc] initWithInfo:matchingInfo owner:self];
@@ -2865,10 +5844,13 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 	else
 		dispatch_sync(cacheQueue, block);
 	
+	NSURL *resultURL = blob ? blob.fileURL : dstURL;
+	NSData *resultKey = blob ? [self encryptionKeyForContentDigest:blob.digest] : node.encryptionKey;
+	
 	ZDCCryptoFile *result =
-		result = [[ZDCCryptoFile alloc] initWithFileURL: dstURL
+		result = [[ZDCCryptoFile alloc] initWithFileURL: resultURL
 		                                     fileFormat: format
-													 encryptionKey: node.encryptionKey
+													 encryptionKey: resultKey
 		                                    retainToken: retainToken];
 	return result;
 }
@@ -2929,6 +5911,7 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 	
 	__block NSURL *fileURL = nil;
 	__block ZDCCryptoFileFormat format = ZDCCryptoFileFormat_Unknown;
+	__block NSData *encryptionKey = nil;
 	
 	__block ZDCFileRetainToken *retainToken = nil;
 	
@@ -2981,28 +5964,18 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 			
 			if (pInfo)
 			{
-				fileURL = pInfo.fileURL;
+				fileURL = pInfo.blob ? pInfo.blob.fileURL : pInfo.fileURL;
 				format = pInfo.format;
+				encryptionKey = [self encryptionKeyForInfo:pInfo withNodeKey:node.encryptionKey];
 				
 				[pInfo incrementFileRetainCount];
 				retainToken = [[ZDCFileRetainToken alloc] initWithInfo:pInfo owner:self];
 				
-				pInfo.lastAccessed = [NSDate date];
+				[self didAccessInfo:pInfo];
 				
 				isPersistent = pInfo.isStoredPersistently;
 				
-				if (pInfo.eTag == nil) // we read eTag xattr only on demand
-				{
-					NSString *eTag = nil;
-					if ([self getETag:&eTag forURL:pInfo.fileURL withEncryptionKey:node.encryptionKey])
-					{
-						pInfo.eTag = eTag ?: [NSNull null];
-					}
-				}
-				
-				if ([pInfo.eTag isKindOfClass:[NSString class]]) {
-					eTag = (NSString *)pInfo.eTag;
-				}
+				eTag = [self eTagForInfo:pInfo withEncryptionKey:node.encryptionKey];
 				expiration = pInfo.expiration;
 			}
 		}
@@ -3016,11 +5989,11 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 		dispatch_sync(cacheQueue, block);
 	
 	ZDCCryptoFile *cryptoFile = nil;
-	if (fileURL && node.encryptionKey)
+	if (fileURL && encryptionKey)
 	{
 		cryptoFile = [[ZDCCryptoFile alloc] initWithFileURL: fileURL
 		                                         fileFormat: format
-		                                      encryptionKey: node.encryptionKey
+		                                      encryptionKey: encryptionKey
 		                                        retainToken: retainToken];
 	}
 	
@@ -3073,12 +6046,13 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 					if (info.fileRetainCount == 0)
 					{
 						NSError *error = nil;
-						[[NSFileManager defaultManager] removeItemAtURL:info.fileURL error:&error];
+						[self removeFileForInfo:info error:&error];
 			
 						if (error) {
 							ZDCLogWarn(@"Error deleting fileURL(%@): %@", [info.fileURL path], error);
 						}
 						
+						[self didRemoveInfo:info];
 						[infos removeObjectAtIndex:i];
 						[changes addObject:[nodeID copy]]; // mutable string protection
 						shouldPostNotification = YES;
@@ -3156,13 +6130,14 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 				if (srcInfo.fileRetainCount == 0)
 				{
 					NSError *error = nil;
-					[[NSFileManager defaultManager] removeItemAtURL:srcInfo.fileURL error:&error];
+					[self removeFileForInfo:srcInfo error:&error];
 			
 					if (error) {
 						ZDCLogWarn(@"Error deleting fileURL(%@): %@", [srcInfo.fileURL path], error);
 					}
 					else
 					{
+						[self didRemoveInfo:srcInfo];
 						[infos removeObjectIdenticalTo:srcInfo];
 					}
 				}
@@ -3176,6 +6151,7 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 				// So undo a potential pendingDelete on the matchingDstInfo if needed.
 				//
 				matchingDstInfo.pendingDelete = NO;
+				[self updateExpirationForInfo:matchingDstInfo];
 			}
 			else // if (!matchingDstInfo)
 			{
@@ -3193,7 +6169,7 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 					// We can safely move the file into it's new place.
 					
 					NSError *error = nil;
-					[fileManager moveItemAtURL:srcInfo.fileURL toURL:dstFileURL error:&error];
+					[self moveFileForInfo:srcInfo toURL:dstFileURL error:&error];
 					
 					if (error)
 					{
@@ -3202,8 +6178,11 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 					}
 					else
 					{
+						[self didRemoveInfo:srcInfo];
 						[infos removeObjectIdenticalTo:srcInfo];
 						[infos addObject:dstInfo];
+						[self didAddInfo:dstInfo];
+						[self addInfoToCachePool:dstInfo];
 					}
 				}
 				else
@@ -3212,7 +6191,7 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 					// So we need to perform a copy instead.
 					
 					NSError *error = nil;
-					[fileManager copyItemAtURL:srcInfo.fileURL toURL:dstFileURL error:&error];
+					[self copyFileForInfo:srcInfo toURL:dstFileURL error:&error];
 					
 					if (error)
 					{
@@ -3223,6 +6202,8 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 					{
 						srcInfo.pendingDelete = YES;
 						[infos addObject:dstInfo];
+						[self didAddInfo:dstInfo];
+						[self addInfoToCachePool:dstInfo];
 					}
 				}
 				
@@ -3300,8 +6281,23 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 	};
 	
 	NSURL *srcURL = nil;
+	ZDCDiskBlob *blob = nil;
 	
-	if (import.cleartextData)
+	if (import.deduplicate && !import.storePersistently && (import.cleartextData || import.cleartextFileURL))
+	{
+		WarnIfMainThread();
+		
+		ZDCDiskBlobStore *blobStore =
+		  [self blobStoreForMode: ZDCStorageMode_Cache
+		                    type: ZDCFileType_NodeThumbnail
+		                  format: ZDCCryptoFileFormat_CacheFile];
+		
+		blob = [self importBlobWithCleartextData: import.cleartextData
+		                        cleartextFileURL: import.cleartextFileURL
+		                               blobStore: blobStore
+		                                   error: &error];
+	}
+	else if (import.cleartextData)
 	{
 		WarnIfMainThread();
 		
@@ -3367,13 +6363,36 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 	NSURL *dir = [self URLForMode:mode type:type format:format];
 	NSURL *dstURL = [dir URLByAppendingPathComponent:node.uuid isDirectory:NO];
 	
-	[fileManager moveItemAtURL:srcURL toURL:dstURL error:&error];
+	// Small cached items are packed into a slab, instead of being moved into the directory.
+	// Deduplicated items are neither, as they reference the blob's file.
 	
-	if (error)
+	ZDCDiskSlabStore *slabStore = blob ? nil : [self slabStoreForMode:mode type:type format:format];
+	NSData *packedData = nil;
+	
+	if (blob)
+	{
+		// Nothing to move
+	}
+	else if (slabStore)
+	{
+		packedData = [NSData dataWithContentsOfURL:srcURL options:0 error:&error];
+		
+		if (error) {
+			ZDCLogWarn(@"Error reading file(%@): %@", [srcURL path], error);
+		}
+	}
+	else
 	{
-		ZDCLogWarn(@"Error moving file: src(%@) -> dst(%@): %@",
-		            [srcURL path], [dstURL path], error);
+		[fileManager moveItemAtURL:srcURL toURL:dstURL error:&error];
 		
+		if (error) {
+			ZDCLogWarn(@"Error moving file: src(%@) -> dst(%@): %@",
+			            [srcURL path], [dstURL path], error);
+		}
+	}
+	
+	if (error)
+	{
 		if (outError) *outError = error;
 		return nil;
 	}
@@ -3381,15 +6400,34 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 	NSNumber *fileSize = nil;
 	if (import.isNilPlaceholder) {
 		fileSize = @(0);
+	} else if (blob) {
+		fileSize = @(blob.length);
+	} else if (packedData) {
+		fileSize = @(packedData.length);
 	} else {
 		[dstURL getResourceValue:&fileSize forKey:NSURLFileSizeKey error:nil];
 	}
 	
 	__block ZDCFileRetainToken *retainToken = nil;
+	__block NSError *packError = nil;
+	
+	__block NSURL *resultURL = blob ? blob.fileURL : dstURL;
+	__block NSRange resultRange = NSMakeRange(NSNotFound, 0);
 	
 	dispatch_block_t block = ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	
+		ZDCDiskSlabEntry *slabEntry = nil;
+		if (packedData)
+		{
+			slabEntry = [slabStore storeData:packedData forKey:node.uuid error:&packError];
+			if (slabEntry == nil)
+			{
+				ZDCLogWarn(@"Error packing file(%@): %@", node.uuid, packError);
+				return; // from block
+			}
+		}
 		
 		NSMutableDictionary<NSString *, NSMutableArray<ZDCFileInfo *> *> *dict = dict_nodeThumbnails;
 		NSMutableSet<NSString*> *changes = changes_nodeThumbnails;
@@ -3421,12 +6459,13 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 				if (info.fileRetainCount == 0)
 				{
 					NSError *error = nil;
-					[[NSFileManager defaultManager] removeItemAtURL:info.fileURL error:&error];
+					[self removeFileForInfo:info error:&error];
 					
 					if (error) {
 						ZDCLogWarn(@"Error deleting fileURL(%@): %@", [info.fileURL path], error);
 					}
 					
+					[self didRemoveInfo:info];
 					[infos removeObjectAtIndex:i];
 				}
 				else
@@ -3448,32 +6487,64 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 			matchingInfo.nodeID = node.uuid;
 			
 			[infos addObject:matchingInfo];
+			[self didAddInfo:matchingInfo];
+		}
+		else if (matchingInfo.blob)
+		{
+			// Release the reference to the previous content.
+			[self removeFileForInfo:matchingInfo error:nil];
+		}
+		else if (blob && matchingInfo.slabEntry)
+		{
+			// The previous version was packed into a slab.
+			[self removeFileForInfo:matchingInfo error:nil];
+			matchingInfo.slabEntry = nil;
+		}
+		else if ((slabEntry || blob) && !matchingInfo.slabEntry)
+		{
+			// The previous version was a loose file (e.g. migrated out of persistent storage).
+			[fileManager removeItemAtURL:dstURL error:nil];
+		}
+		
+		if (slabEntry)
+		{
+			matchingInfo.slabEntry = slabEntry;
+			
+			resultURL = slabEntry.slab.fileURL;
+			resultRange = slabEntry.range;
 		}
 		
+		matchingInfo.blob = blob;
+		matchingInfo.contentDigest = blob.digest;
 		matchingInfo.fileSize = [fileSize unsignedLongLongValue];
 		
 		NSDate *now = [NSDate date];
 		matchingInfo.lastAccessed = now;
 		matchingInfo.lastModified = now;
 		
+		[self addInfoToCachePool:matchingInfo]; // or touch, if already in the pool
+		[self journalInfo:matchingInfo];
+		
 		matchingInfo.migrateAfterUpload = import.migrateToCacheAfterUpload;
 		matchingInfo.deleteAfterUpload = import.deleteAfterUpload;
 		matchingInfo.expiration = import.expiration;
-		matchingInfo.eTag = import.eTag ?: [NSNull null];
 		
-		if (import.storePersistently && import.migrateToCacheAfterUpload) {
-			[self setShouldMigrateAfterUpload:YES forURL:dstURL];
-		}
-		if (import.deleteAfterUpload) {
-			[self setShouldDeleteAfterUpload:YES forURL:dstURL];
-		}
-		if (import.expiration != 0) {
-			// Write xattr even if not persistent (in case file is migrated)
-			[self setExpiration:import.expiration forURL:dstURL];
-		}
-		if (import.eTag) {
-			[self setETag:import.eTag forURL:dstURL withEncryptionKey:node.encryptionKey];
+		[self updateExpirationForInfo:matchingInfo];
+		
+		if (matchingInfo.isStoredInDirectory) // packed items don't have xattrs (the journal records these instead)
+		{
+			if (import.storePersistently && import.migrateToCacheAfterUpload) {
+				[self setShouldMigrateAfterUpload:YES forURL:dstURL];
+			}
+			if (import.deleteAfterUpload) {
+				[self setShouldDeleteAfterUpload:YES forURL:dstURL];
+			}
+			if (import.expiration != 0) {
+				// Write xattr even if not persistent (in case file is migrated)
+				[self setExpiration:import.expiration forURL:dstURL];
+			}
 		}
+		[self setETag:import.eTag forInfo:matchingInfo withEncryptionKey:node.encryptionKey];
 		
 		[matchingInfo incrementFileRetainCount];
 		retainToken = [[ZDCFileRetainToken alloc] initWithInfo:matchingInfo owner:self];
@@ -3494,10 +6565,23 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 	else
 		dispatch_sync(cacheQueue, block);
 	
+	if (packError)
+	{
+		if (outError) *outError = packError;
+		return nil;
+	}
+	
+	if (packedData) {
+		[fileManager removeItemAtURL:srcURL error:nil];
+	}
+	
+	NSData *resultKey = blob ? [self encryptionKeyForContentDigest:blob.digest] : node.encryptionKey;
+	
 	ZDCCryptoFile *result =
-	  [[ZDCCryptoFile alloc] initWithFileURL: dstURL
+	  [[ZDCCryptoFile alloc] initWithFileURL: resultURL
+	                               fileRange: resultRange
 	                              fileFormat: format
-	                           encryptionKey: node.encryptionKey
+	                           encryptionKey: resultKey
 	                             retainToken: retainToken];
 	return result;
 }
@@ -3546,7 +6630,9 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 	if (node == nil) return nil;
 	
 	__block NSURL *fileURL = nil;
+	__block NSRange fileRange = NSMakeRange(NSNotFound, 0);
 	__block ZDCCryptoFileFormat format = ZDCCryptoFileFormat_Unknown;
+	__block NSData *encryptionKey = nil;
 	
 	__block BOOL isNilPlaceholder = NO;
 	__block ZDCFileRetainToken *retainToken = nil;
@@ -3577,6 +6663,18 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 			fileURL = info.fileURL;
 			format = info.format;
 			
+			if (info.slabEntry)
+			{
+				fileURL = info.slabEntry.slab.fileURL;
+				fileRange = info.slabEntry.range;
+			}
+			else if (info.blob)
+			{
+				fileURL = info.blob.fileURL;
+			}
+			
+			encryptionKey = [self encryptionKeyForInfo:info withNodeKey:node.encryptionKey];
+			
 			if (info.fileSize == 0)
 			{
 				isNilPlaceholder = YES;
@@ -3587,22 +6685,11 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 				retainToken = [[ZDCFileRetainToken alloc] initWithInfo:info owner:self];
 			}
 			
-			info.lastAccessed = [NSDate date];
+			[self didAccessInfo:info];
 			
 			isPersistent = info.isStoredPersistently;
 			
-			if (info.eTag == nil) // we read eTag xattr only on demand
-			{
-				NSString *eTag = nil;
-				if ([self getETag:&eTag forURL:info.fileURL withEncryptionKey:node.encryptionKey])
-				{
-					info.eTag = eTag ?: [NSNull null];
-				}
-			}
-			
-			if ([info.eTag isKindOfClass:[NSString class]]) {
-				eTag = (NSString *)info.eTag;
-			}
+			eTag = [self eTagForInfo:info withEncryptionKey:node.encryptionKey];
 			expiration = info.expiration;
 		}
 		
@@ -3615,11 +6702,12 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 		dispatch_sync(cacheQueue, block);
 	
 	ZDCCryptoFile *cryptoFile = nil;
-	if (fileURL && node.encryptionKey && !isNilPlaceholder)
+	if (fileURL && encryptionKey && !isNilPlaceholder)
 	{
 		cryptoFile = [[ZDCCryptoFile alloc] initWithFileURL: fileURL
+		                                          fileRange: fileRange
 		                                         fileFormat: format
-		                                      encryptionKey: node.encryptionKey
+		                                      encryptionKey: encryptionKey
 		                                        retainToken: retainToken];
 	}
 	
@@ -3672,12 +6760,13 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 					if (info.fileRetainCount == 0)
 					{
 						NSError *error = nil;
-						[[NSFileManager defaultManager] removeItemAtURL:info.fileURL error:&error];
+						[self removeFileForInfo:info error:&error];
 			
 						if (error) {
 								ZDCLogWarn(@"Error deleting fileURL(%@): %@", [info.fileURL path], error);
 						}
 			
+						[self didRemoveInfo:info];
 						[infos removeObjectAtIndex:i];
 						[changes addObject:[nodeID copy]]; // mutable string protection
 						shouldPostNotification = YES;
@@ -3755,13 +6844,14 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 				if (srcInfo.fileRetainCount == 0)
 				{
 					NSError *error = nil;
-					[[NSFileManager defaultManager] removeItemAtURL:srcInfo.fileURL error:&error];
+					[self removeFileForInfo:srcInfo error:&error];
 			
 					if (error) {
 						ZDCLogWarn(@"Error deleting fileURL(%@): %@", [srcInfo.fileURL path], error);
 					}
 					else
 					{
+						[self didRemoveInfo:srcInfo];
 						[infos removeObjectIdenticalTo:srcInfo];
 					}
 				}
@@ -3775,6 +6865,7 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 				// So undo a potential pendingDelete on the matchingDstInfo if needed.
 				//
 				matchingDstInfo.pendingDelete = NO;
+				[self updateExpirationForInfo:matchingDstInfo];
 			}
 			else // if (!matchingDstInfo)
 			{
@@ -3792,7 +6883,7 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 					// We can safely move the file into it's new place.
 					
 					NSError *error = nil;
-					[fileManager moveItemAtURL:srcInfo.fileURL toURL:dstFileURL error:&error];
+					[self moveFileForInfo:srcInfo toURL:dstFileURL error:&error];
 					
 					if (error)
 					{
@@ -3801,8 +6892,11 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 					}
 					else
 					{
+						[self didRemoveInfo:srcInfo];
 						[infos removeObjectIdenticalTo:srcInfo];
 						[infos addObject:dstInfo];
+						[self didAddInfo:dstInfo];
+						[self addInfoToCachePool:dstInfo];
 					}
 				}
 				else
@@ -3811,7 +6905,7 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 					// So we need to perform a copy instead.
 					
 					NSError *error = nil;
-					[fileManager copyItemAtURL:srcInfo.fileURL toURL:dstFileURL error:&error];
+					[self copyFileForInfo:srcInfo toURL:dstFileURL error:&error];
 					
 					if (error)
 					{
@@ -3822,6 +6916,8 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 					{
 						srcInfo.pendingDelete = YES;
 						[infos addObject:dstInfo];
+						[self didAddInfo:dstInfo];
+						[self addInfoToCachePool:dstInfo];
 					}
 				}
 				
@@ -3973,13 +7069,31 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 	NSURL *dir = [self URLForMode:mode type:type format:format];
 	NSURL *dstURL = [dir URLByAppendingPathComponent:filename isDirectory:NO];
 	
-	[fileManager moveItemAtURL:srcURL toURL:dstURL error:&error];
+	// Small cached items are packed into a slab, instead of being moved into the directory.
 	
-	if (error)
+	ZDCDiskSlabStore *slabStore = [self slabStoreForMode:mode type:type format:format];
+	NSData *packedData = nil;
+	
+	if (slabStore)
+	{
+		packedData = [NSData dataWithContentsOfURL:srcURL options:0 error:&error];
+		
+		if (error) {
+			ZDCLogWarn(@"Error reading file(%@): %@", [srcURL path], error);
+		}
+	}
+	else
 	{
-		ZDCLogWarn(@"Error moving file: src(%@) -> dst(%@): %@",
-		            [srcURL path], [dstURL path], error);
+		[fileManager moveItemAtURL:srcURL toURL:dstURL error:&error];
 		
+		if (error) {
+			ZDCLogWarn(@"Error moving file: src(%@) -> dst(%@): %@",
+			            [srcURL path], [dstURL path], error);
+		}
+	}
+	
+	if (error)
+	{
 		if (outError) *outError = error;
 		return nil;
 	}
@@ -3987,15 +7101,32 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 	NSNumber *fileSize = nil;
 	if (import.isNilPlaceholder) {
 		fileSize = @(0);
+	} else if (packedData) {
+		fileSize = @(packedData.length);
 	} else {
 		[dstURL getResourceValue:&fileSize forKey:NSURLFileSizeKey error:nil];
 	}
 	
 	__block ZDCFileRetainToken *retainToken = nil;
+	__block NSError *packError = nil;
+	
+	__block NSURL *resultURL = dstURL;
+	__block NSRange resultRange = NSMakeRange(NSNotFound, 0);
 	
 	dispatch_block_t block = ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+	
+		ZDCDiskSlabEntry *slabEntry = nil;
+		if (packedData)
+		{
+			slabEntry = [slabStore storeData:packedData forKey:filename error:&packError];
+			if (slabEntry == nil)
+			{
+				ZDCLogWarn(@"Error packing file(%@): %@", filename, packError);
+				return; // from block
+			}
+		}
 		
 		NSMutableDictionary<NSString *, NSMutableArray<ZDCFileInfo *> *> *dict = dict_userAvatars;
 		NSMutableSet<NSString*> *changes = changes_userAvatars;
@@ -4041,12 +7172,13 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 					if (info.fileRetainCount == 0)
 					{
 						NSError *error = nil;
-						[[NSFileManager defaultManager] removeItemAtURL:info.fileURL error:&error];
+						[self removeFileForInfo:info error:&error];
 			
 						if (error) {
 							ZDCLogWarn(@"Error deleting fileURL(%@): %@", [info.fileURL path], error);
 						}
 			
+						[self didRemoveInfo:info];
 						[infos removeObjectAtIndex:i];
 					}
 					else
@@ -4070,6 +7202,20 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 			matchingInfo.identityID = identityID;
 			
 			[infos addObject:matchingInfo];
+			[self didAddInfo:matchingInfo];
+		}
+		else if (slabEntry && !matchingInfo.slabEntry)
+		{
+			// The previous version was a loose file (e.g. migrated out of persistent storage).
+			[fileManager removeItemAtURL:dstURL error:nil];
+		}
+		
+		if (slabEntry)
+		{
+			matchingInfo.slabEntry = slabEntry;
+			
+			resultURL = slabEntry.slab.fileURL;
+			resultRange = slabEntry.range;
 		}
 		
 		matchingInfo.fileSize = [fileSize unsignedLongLongValue];
@@ -4078,24 +7224,29 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 		matchingInfo.lastAccessed = now;
 		matchingInfo.lastModified = now;
 		
+		[self addInfoToCachePool:matchingInfo]; // or touch, if already in the pool
+		[self journalInfo:matchingInfo];
+		
 		matchingInfo.migrateAfterUpload = import.migrateToCacheAfterUpload;
 		matchingInfo.deleteAfterUpload = import.deleteAfterUpload;
 		matchingInfo.expiration = import.expiration;
-		matchingInfo.eTag = import.eTag ?: [NSNull null];
 		
-		if (import.storePersistently && import.migrateToCacheAfterUpload) {
-			[self setShouldMigrateAfterUpload:YES forURL:dstURL];
-		}
-		if (import.deleteAfterUpload) {
-			[self setShouldDeleteAfterUpload:YES forURL:dstURL];
-		}
-		if (import.expiration != 0) {
-			// Write xattr even if not persistent (in case file is migrated)
-			[self setExpiration:import.expiration forURL:dstURL];
-		}
-		if (import.eTag) {
-			[self setETag:import.eTag forURL:dstURL withEncryptionKey:user.random_encryptionKey];
+		[self updateExpirationForInfo:matchingInfo];
+		
+		if (slabEntry == nil) // packed items don't have xattrs (the journal records these instead)
+		{
+			if (import.storePersistently && import.migrateToCacheAfterUpload) {
+				[self setShouldMigrateAfterUpload:YES forURL:dstURL];
+			}
+			if (import.deleteAfterUpload) {
+				[self setShouldDeleteAfterUpload:YES forURL:dstURL];
+			}
+			if (import.expiration != 0) {
+				// Write xattr even if not persistent (in case file is migrated)
+				[self setExpiration:import.expiration forURL:dstURL];
+			}
 		}
+		[self setETag:import.eTag forInfo:matchingInfo withEncryptionKey:user.random_encryptionKey];
 		
 		[matchingInfo incrementFileRetainCount];
 		retainToken = [[ZDCFileRetainToken alloc] initWithInfo:matchingInfo owner:self];
@@ -4116,8 +7267,19 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 	else
 		dispatch_sync(cacheQueue, block);
 	
+	if (packError)
+	{
+		if (outError) *outError = packError;
+		return nil;
+	}
+	
+	if (packedData) {
+		[fileManager removeItemAtURL:srcURL error:nil];
+	}
+	
 	ZDCCryptoFile *result =
-	  [[ZDCCryptoFile alloc] initWithFileURL: dstURL
+	  [[ZDCCryptoFile alloc] initWithFileURL: resultURL
+	                               fileRange: resultRange
 	                              fileFormat: format
 	                           encryptionKey: user.random_encryptionKey
 	                             retainToken: retainToken];
@@ -4238,6 +7400,7 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 	NSParameterAssert([user isKindOfClass:[ZDCUser class]]);
 	
 	__block NSURL *fileURL = nil;
+	__block NSRange fileRange = NSMakeRange(NSNotFound, 0);
 	__block ZDCCryptoFileFormat format = ZDCCryptoFileFormat_Unknown;
 	
 	__block BOOL isNilPlaceholder = NO;
@@ -4284,6 +7447,12 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 				fileURL = matchingInfo.fileURL;
 				format = matchingInfo.format;
 				
+				if (matchingInfo.slabEntry)
+				{
+					fileURL = matchingInfo.slabEntry.slab.fileURL;
+					fileRange = matchingInfo.slabEntry.range;
+				}
+				
 				if (matchingInfo.fileSize == 0)
 				{
 					isNilPlaceholder = YES;
@@ -4294,22 +7463,11 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 					retainToken = [[ZDCFileRetainToken alloc] initWithInfo:matchingInfo owner:self];
 				}
 				
-				matchingInfo.lastAccessed = [NSDate date];
+				[self didAccessInfo:matchingInfo];
 				
 				isPersistent = matchingInfo.isStoredPersistently;
 				
-				if (matchingInfo.eTag == nil) // we read eTag xattr only on demand
-				{
-					NSString *eTag = nil;
-					if ([self getETag:&eTag forURL:matchingInfo.fileURL withEncryptionKey:user.random_encryptionKey])
-					{
-						matchingInfo.eTag = eTag ?: [NSNull null];
-					}
-				}
-				
-				if ([matchingInfo.eTag isKindOfClass:[NSString class]]) {
-					eTag = (NSString *)matchingInfo.eTag;
-				}
+				eTag = [self eTagForInfo:matchingInfo withEncryptionKey:user.random_encryptionKey];
 				expiration = matchingInfo.expiration;
 			}
 		}
@@ -4326,6 +7484,7 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 	if (fileURL && user.random_encryptionKey && !isNilPlaceholder)
 	{
 		cryptoFile = [[ZDCCryptoFile alloc] initWithFileURL: fileURL
+		                                          fileRange: fileRange
 		                                         fileFormat: format
 		                                      encryptionKey: user.random_encryptionKey
 		                                        retainToken: retainToken];
@@ -4384,12 +7543,13 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 					if (info.fileRetainCount == 0)
 					{
 						NSError *error = nil;
-						[[NSFileManager defaultManager] removeItemAtURL:info.fileURL error:&error];
+						[self removeFileForInfo:info error:&error];
 			
 						if (error) {
 								ZDCLogWarn(@"Error deleting fileURL(%@): %@", [info.fileURL path], error);
 						}
 			
+						[self didRemoveInfo:info];
 						[infos removeObjectAtIndex:i];
 						[changes addObject:[userID copy]]; // mutable string protection
 						shouldPostNotification = YES;
@@ -4466,12 +7626,13 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 					if (info.fileRetainCount == 0)
 					{
 						NSError *error = nil;
-						[[NSFileManager defaultManager] removeItemAtURL:info.fileURL error:&error];
+						[self removeFileForInfo:info error:&error];
 						
 						if (error) {
 							ZDCLogWarn(@"Error deleting fileURL(%@): %@", [info.fileURL path], error);
 						}
 						
+						[self didRemoveInfo:info];
 						[infos removeObjectAtIndex:i];
 						[changes addObject:[userID copy]]; // mutable string protection
 						shouldPostNotification = YES;
@@ -4530,12 +7691,13 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 				if (info.fileRetainCount == 0)
 				{
 					NSError *error = nil;
-					[[NSFileManager defaultManager] removeItemAtURL:info.fileURL error:&error];
+					[self removeFileForInfo:info error:&error];
 					
 					if (error) {
 						ZDCLogWarn(@"Error deleting fileURL(%@): %@", [info.fileURL path], error);
 					}
 					
+					[self didRemoveInfo:info];
 					[infos removeObjectAtIndex:i];
 					[changes addObject:[userID copy]]; // mutable string protection
 					shouldPostNotification = YES;
@@ -4612,13 +7774,14 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 				if (srcInfo.fileRetainCount == 0)
 				{
 					NSError *error = nil;
-					[[NSFileManager defaultManager] removeItemAtURL:srcInfo.fileURL error:&error];
+					[self removeFileForInfo:srcInfo error:&error];
 			
 					if (error) {
 						ZDCLogWarn(@"Error deleting fileURL(%@): %@", [srcInfo.fileURL path], error);
 					}
 					else
 					{
+						[self didRemoveInfo:srcInfo];
 						[infos removeObjectIdenticalTo:srcInfo];
 					}
 				}
@@ -4632,6 +7795,7 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 				// So undo a potential pendingDelete on the matchingDstInfo if needed.
 				//
 				matchingDstInfo.pendingDelete = NO;
+				[self updateExpirationForInfo:matchingDstInfo];
 			}
 			else // if (!matchingDstInfo)
 			{
@@ -4651,7 +7815,7 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 					// We can safely move the file into it's new place.
 					
 					NSError *error = nil;
-					[fileManager moveItemAtURL:srcInfo.fileURL toURL:dstFileURL error:&error];
+					[self moveFileForInfo:srcInfo toURL:dstFileURL error:&error];
 					
 					if (error)
 					{
@@ -4660,8 +7824,11 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 					}
 					else
 					{
+						[self didRemoveInfo:srcInfo];
 						[infos removeObjectIdenticalTo:srcInfo];
 						[infos addObject:dstInfo];
+						[self didAddInfo:dstInfo];
+						[self addInfoToCachePool:dstInfo];
 					}
 				}
 				else
@@ -4670,7 +7837,7 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 					// So we need to perform a copy instead.
 					
 					NSError *error = nil;
-					[fileManager copyItemAtURL:srcInfo.fileURL toURL:dstFileURL error:&error];
+					[self copyFileForInfo:srcInfo toURL:dstFileURL error:&error];
 					
 					if (error)
 					{
@@ -4681,6 +7848,8 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 					{
 						srcInfo.pendingDelete = YES;
 						[infos addObject:dstInfo];
+						[self didAddInfo:dstInfo];
+						[self addInfoToCachePool:dstInfo];
 					}
 				}
 			}
@@ -4819,34 +7988,114 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
                           type:(ZDCFileType)type
                         format:(ZDCCryptoFileFormat)format
 {
-	uint64_t total = 0;
+	// The counters are created during init, and never replaced.
+	// And their totalSize is atomic.
+	// So we can read it directly, rather than going through the cacheQueue.
 	
-	NSURL *directoryURL = [self URLForMode:mode type:type format:format];
+	if ((NSUInteger)mode >= 2 || (NSUInteger)type >= 3 || (NSUInteger)format >= 3) {
+		return 0;
+	}
 	
-	NSDirectoryEnumerationOptions options =
-	  NSDirectoryEnumerationSkipsSubdirectoryDescendants |
-	  NSDirectoryEnumerationSkipsPackageDescendants      |
-	  NSDirectoryEnumerationSkipsHiddenFiles;
+	ZDCStorageCounter *counter = storageCounters[mode][type][format];
+	return atomic_load_explicit(&counter->totalSize, memory_order_relaxed);
+}
+
+- (void)scheduleStorageReconciliation
+{
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
+	
+	if (lastStorageReconciliation == nil) {
+		lastStorageReconciliation = [NSDate date];
+	}
+	
+	__weak typeof(self) weakSelf = self;
+	
+	dispatch_time_t when = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kStorageReconciliationInterval * NSEC_PER_SEC));
+	dispatch_after(when, cacheQueue, ^{ @autoreleasepool {
+	
+		[weakSelf maybeReconcileStorageCounters];
+		[weakSelf scheduleStorageReconciliation];
+	}});
+}
 
-	NSArray<NSString *> *keys = @[
-		NSURLFileSizeKey
-	];
+/**
+ * The storage counters are maintained incrementally, as files are imported, migrated & deleted.
+ * And the directory scans (at launch, when returning to the foreground, and when the filesystem monitors fire)
+ * keep the dicts in sync with what's actually on disk.
+ *
+ * This method is a safety net against any drift between the two.
+ * It rebuilds the counters from the dicts, and rescans every directory.
+ * It only runs occasionally (see scheduleStorageReconciliation).
+ */
+- (void)maybeReconcileStorageCounters
+{
+	NSAssert(dispatch_get_specific(IsOnCacheQueueKey), @"MUST be invoked within the cacheQueue");
 	
-	NSDirectoryEnumerator<NSURL *> *enumerator =
-	  [[NSFileManager defaultManager] enumeratorAtURL: directoryURL
-	                       includingPropertiesForKeys: keys
-	                                          options: options
-	                                     errorHandler: NULL];
+	NSDate *now = [NSDate date];
 	
-	for (NSURL *url in enumerator)
+	if (lastStorageReconciliation &&
+	    [now timeIntervalSinceDate:lastStorageReconciliation] < kStorageReconciliationInterval)
 	{
-		NSNumber *fileSize = nil;
-		[url getResourceValue:&fileSize forKey:NSURLFileSizeKey error:nil];
-		
-		total += [fileSize unsignedLongLongValue];
+		return;
 	}
+	lastStorageReconciliation = now;
 	
-	return total;
+	ZDCLogVerbose(@"Reconciling storage counters...");
+	
+	ZDCStorageCounter *freshCounters[2][3][3];
+	for (NSUInteger m = 0; m < 2; m++) {
+		for (NSUInteger t = 0; t < 3; t++) {
+			for (NSUInteger f = 0; f < 3; f++) {
+				freshCounters[m][t][f] = [[ZDCStorageCounter alloc] init];
+			}
+		}
+	}
+	
+	for (NSDictionary<NSString*, NSMutableArray<ZDCFileInfo*> *> *dict in @[dict_nodeData, dict_nodeThumbnails, dict_userAvatars])
+	{
+		for (NSArray<ZDCFileInfo *> *infos in [dict objectEnumerator])
+		{
+			for (ZDCFileInfo *info in infos)
+			{
+				if ((NSUInteger)info.mode >= 2 || (NSUInteger)info.type >= 3 || (NSUInteger)info.format >= 3) {
+					continue;
+				}
+				
+				ZDCStorageCounter *counter = freshCounters[info.mode][info.type][info.format];
+				counter->totalSize += info.fileSize;
+				counter->fileCount++;
+				
+				info->storageCounter = storageCounters[info.mode][info.type][info.format];
+			}
+		}
+	}
+	
+	for (NSUInteger m = 0; m < 2; m++) {
+		for (NSUInteger t = 0; t < 3; t++) {
+			for (NSUInteger f = 0; f < 3; f++) {
+			
+				ZDCStorageCounter *counter = storageCounters[m][t][f];
+				ZDCStorageCounter *fresh = freshCounters[m][t][f];
+				
+				if ((counter->totalSize != fresh->totalSize) || (counter->fileCount != fresh->fileCount))
+				{
+					ZDCLogWarn(@"Storage counter drift: mode(%lu) type(%lu) format(%lu):"
+					           @" size(%llu -> %llu) count(%lu -> %lu)",
+					           (unsigned long)m, (unsigned long)t, (unsigned long)f,
+					           (unsigned long long)counter->totalSize, (unsigned long long)fresh->totalSize,
+					           (unsigned long)counter->fileCount, (unsigned long)fresh->fileCount);
+					
+					counter->totalSize = fresh->totalSize;
+					counter->fileCount = fresh->fileCount;
+				}
+			}
+		}
+	}
+	
+	// Any changes found on disk will flow back into the dicts (and thus the counters).
+	
+	[self scanCacheDirectories];
+	[self scanOfflineDirectories];
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -4888,6 +8137,7 @@ static NSTimeInterval const kDefaultConfiguration_userAvatarExpiration    = (60
 @synthesize deleteAfterUpload;
 @synthesize eTag;
 @synthesize expiration;
+@synthesize deduplicate;
 
 - (instancetype)init
 {
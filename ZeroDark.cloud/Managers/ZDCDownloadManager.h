@@ -308,6 +308,22 @@ typedef void (^UserAvatarDownloadCompletionBlock)(NSData *_Nullable avatar, NSEr
 @property (nonatomic, assign, readwrite) BOOL canDownloadWhileInBackground;
 #endif
 
+/**
+ * Applies to node data downloads.
+ *
+ * Large files are downloaded by fetching several byte ranges in parallel,
+ * which is often considerably faster than a single connection (especially on high latency links).
+ * The DownloadManager adjusts the number of concurrent ranges based on the measured throughput,
+ * and this value is the upper bound.
+ *
+ * Set to 1 (or 0) to always download the file using a single request.
+ *
+ * Parallel downloads aren't used for background downloads (i.e. canDownloadWhileInBackground).
+ *
+ * The default value is 6.
+ */
+@property (nonatomic, assign, readwrite) NSUInteger maxConcurrentSegments;
+
 /**
  * Applies to user avatar downloads.
  *
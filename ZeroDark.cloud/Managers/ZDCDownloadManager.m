@@ -12,6 +12,7 @@
 #import "Auth0Utilities.h"
 #import "S3Request.h"
 #import "ZDCAsyncCompletionDispatch.h"
+#import "ZDCCacheFileDownloadSink.h"
 #import "ZDCConstantsPrivate.h"
 #import "ZDCDownloadContext.h"
 #import "ZDCLogging.h"
@@ -19,6 +20,7 @@
 #import "ZDCNodePrivate.h"
 #import "ZDCProgressManagerPrivate.h"
 #import "ZDCNetworkTools.h"
+#import "ZDCSegmentedDownload.h"
 #import "ZDCUserSearchManager.h"
 #import "ZeroDarkCloudPrivate.h"
 
@@ -42,6 +44,11 @@
 
 static NSUInteger const kMaxFailCount = 8;
 
+// Node data downloads at least this large are fetched using parallel byte ranges (if enabled in the options).
+static uint64_t const kSegmentedDownloadThreshold = (1024 * 1024 * 32); // 32 MiB
+
+static NSUInteger const kDefaultMaxConcurrentSegments = 6;
+
 
 /**
  * ZDCDownloadTicket is the class we pass back to the user.
@@ -108,6 +115,8 @@ static NSUInteger const kMaxFailCount = 8;
 @property (nonatomic, weak, readwrite) NSURLSessionTask *task;
 @property (nonatomic, assign, readwrite) BOOL isBackground;
 
+@property (nonatomic, strong, readwrite) ZDCSegmentedDownload *segmentedDownload;
+
 @end
 
 @implementation ZDCDownloadRef
@@ -116,6 +125,7 @@ static NSUInteger const kMaxFailCount = 8;
 @synthesize dependency;
 @synthesize task;
 @synthesize isBackground;
+@synthesize segmentedDownload;
 
 - (instancetype)init
 {
@@ -1999,6 +2009,25 @@ static NSUInteger const kMaxFailCount = 8;
 	
 	ZDCCloudLocator *cloudLocator = context.ephemeralInfo.cloudLocator;
 	
+	if (!canBackground && (context.options.maxConcurrentSegments > 1))
+	{
+		ZDCCloudDataInfo *cloudDataInfo = node.cloudDataInfo;
+		uint64_t cloudFileSize = sizeof(ZDCCloudFileHeader)
+		                       + cloudDataInfo.metadataSize
+		                       + cloudDataInfo.thumbnailSize
+		                       + cloudDataInfo.dataSize;
+		
+		if (cloudDataInfo && (cloudFileSize >= kSegmentedDownloadThreshold))
+		{
+			[self _downloadNodeDataInSegments: node
+			                      withContext: context
+			                             auth: auth
+			                          session: session
+			                   expectedLength: cloudFileSize];
+			return;
+		}
+	}
+	
 	NSMutableURLRequest *request =
 	  [S3Request getObject: cloudLocator.cloudPath.path
 	              inBucket: cloudLocator.bucket
@@ -2014,7 +2043,9 @@ static NSUInteger const kMaxFailCount = 8;
 
 	NSString *const resumeKey = [self resumeKeyForRequest:request];
 	
-	__block NSURLSessionDownloadTask *task = nil;
+	__block NSURLSessionTask *task = nil;
+	NSProgress *taskProgress = nil;
+	
 	if (canBackground)
 	{
 		// Background NSURLSession.
@@ -2065,7 +2096,7 @@ static NSUInteger const kMaxFailCount = 8;
 		void (^completionHandler)(NSURLResponse*, NSURL*, NSError*) =
 			^(NSURLResponse *response, NSURL *downloadedFileURL, NSError *error)
 		{
-			[weakSelf _downloadNodeDataTaskDidComplete: task
+			[weakSelf _downloadNodeDataTaskDidComplete: (NSURLSessionDownloadTask *)task
 			                               withContext: context
 			                                     error: error
 			                         downloadedFileURL: downloadedFileURL];
@@ -2081,14 +2112,45 @@ static NSUInteger const kMaxFailCount = 8;
 		
 		if (!task)
 		{
-			task = [session downloadTaskWithRequest: request
-				                            progress: nil
-				                         destination: destinationHandler
-			                      completionHandler: completionHandler];
+			// Stream the response into a cache file.
+			//
+			// The cloudFile is decrypted (and re-encrypted into cacheFile format) as the bytes arrive.
+			// So the file is ready to use as soon as the download completes,
+			// without another pass over the file to read the header or convert it.
+			//
+			// Note: Data tasks can't produce resumeData.
+			// We only get resumeData from tasks started before the file was streamed.
+			
+			dispatch_queue_t concurrentQueue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+			
+			ZDCCacheFileDownloadSink *sink =
+			  [[ZDCCacheFileDownloadSink alloc] initWithCacheFileURL: dstFileURL
+			                                           encryptionKey: node.encryptionKey
+			                                         completionQueue: concurrentQueue
+			                                         completionBlock:
+			^(ZDCCloudFileHeader header, NSURLResponse *response, NSError *error)
+			{
+				[weakSelf _downloadNodeDataDidComplete: response
+				                           withContext: context
+				                                 error: error
+				                     downloadedFileURL: (response ? dstFileURL : nil)
+				                        streamedHeader: &header];
+			}];
+			
+			// Important: Use the NSURLSession directly.
+			// Otherwise AFNetworking buffers the entire response in memory.
+			
+			NSURLSessionDataTask *dataTask = [session.session dataTaskWithRequest:request];
+			[zdc.sessionManager associateDataSink:sink withTask:dataTask inSession:session.session];
+			
+			task = dataTask;
+			taskProgress = sink.progress;
 		}
 	}
 
-	NSProgress *taskProgress = [session downloadProgressForTask:task];
+	if (taskProgress == nil) {
+		taskProgress = [session downloadProgressForTask:task];
+	}
 	if (taskProgress)
 	{
 		[context.ephemeralInfo.progress addChild: taskProgress
@@ -2119,15 +2181,166 @@ static NSUInteger const kMaxFailCount = 8;
 	}
 }
 
+/**
+ * Downloads a large file by fetching several byte ranges in parallel.
+ * The end result is the same file a single download task would produce.
+ */
+- (void)_downloadNodeDataInSegments:(ZDCNode *)node
+                        withContext:(ZDCDownloadContext *)context
+                               auth:(ZDCLocalUserAuth *)auth
+                            session:(AFURLSessionManager *)session
+                     expectedLength:(uint64_t)expectedLength
+{
+	ZDCLogAutoTrace();
+	
+	ZDCCloudLocator *cloudLocator = context.ephemeralInfo.cloudLocator;
+	
+	ZDCSegmentedDownloadRequestBlock requestBlock = ^NSURLRequest *(NSRange byteRange, NSString *eTag) {
+		
+		NSMutableURLRequest *request =
+		  [S3Request getObject: cloudLocator.cloudPath.path
+		              inBucket: cloudLocator.bucket
+		                region: cloudLocator.region
+		      outUrlComponents: nil];
+		
+		[request setHTTPRange:byteRange];
+		
+		if (eTag) {
+			// Ensures every range comes from the same version of the file.
+			[request setValue:eTag forHTTPHeaderField:@"If-Match"];
+		}
+		
+		// Important: The signature covers the headers. So the headers must be set before signing.
+		
+		[AWSSignature signRequest: request
+		               withRegion: cloudLocator.region
+		                  service: AWSService_S3
+		              accessKeyID: auth.aws_accessKeyID
+		                   secret: auth.aws_secret
+		                  session: auth.aws_session];
+		
+		return request;
+	};
+	
+	NSURL *dstFileURL = [zdc.directoryManager generateDownloadURL];
+	
+	ZDCSegmentedDownload *segmentedDownload =
+	  [[ZDCSegmentedDownload alloc] initWithSession: session
+	                                 sessionManager: zdc.sessionManager
+	                                   requestBlock: requestBlock
+	                                 destinationURL: dstFileURL];
+	
+	segmentedDownload.maxConcurrentSegments = context.options.maxConcurrentSegments;
+	segmentedDownload.expectedLength = expectedLength;
+	
+	[context.ephemeralInfo.progress addChild: segmentedDownload.progress
+	                    withPendingUnitCount: 0/* < dynamic: use child.totalUnitCount */];
+	
+	NSString *const downloadKey = context.nodeID;
+	__block BOOL shouldStart = NO;
+	
+	dispatch_sync(downloadQueue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		ZDCDownloadRef *ref = downloadDict[downloadKey];
+		if (ref && ref.tickets.count > 0)
+		{
+			shouldStart = YES;
+			ref.task = nil;
+			ref.isBackground = NO;
+			ref.segmentedDownload = segmentedDownload;
+		}
+		
+	#pragma clang diagnostic pop
+	}});
+	
+	if (!shouldStart) {
+		return;
+	}
+	
+	__weak typeof(self) weakSelf = self;
+	dispatch_queue_t concurrentQueue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+	
+	[segmentedDownload startWithCompletionQueue: concurrentQueue
+	                            completionBlock:^(NSURLResponse *response, NSURL *fileURL, NSError *error)
+	{
+		__strong typeof(self) strongSelf = weakSelf;
+		if (strongSelf == nil) return;
+		
+		dispatch_sync(strongSelf->downloadQueue, ^{ @autoreleasepool {
+			
+			ZDCDownloadRef *ref = strongSelf->downloadDict[downloadKey];
+			if (ref.segmentedDownload == segmentedDownload) {
+				ref.segmentedDownload = nil;
+			}
+		}});
+		
+		if ([error.domain isEqualToString:[NSError domainForClass:[ZDCSegmentedDownload class]]] &&
+		    (error.code == ZDCSegmentedDownloadErrorCode_VerificationFailed))
+		{
+			// The reassembled file doesn't match the eTag.
+			// Fallback to downloading the file using a single request.
+			
+			ZDCLogWarn(@"Segmented download failed verification - falling back to single request: %@",
+			           context.nodeID);
+			
+			context.options.maxConcurrentSegments = 1;
+		}
+		
+		[strongSelf _downloadNodeDataDidComplete: response
+		                             withContext: context
+		                                   error: error
+		                       downloadedFileURL: fileURL];
+	}];
+}
+
 - (void)_downloadNodeDataTaskDidComplete:(nullable NSURLSessionDownloadTask *)task
                              withContext:(ZDCDownloadContext *)context
                                    error:(nullable NSError *)error
                        downloadedFileURL:(nullable NSURL *)downloadedFileURL
+{
+	[self _downloadNodeDataDidComplete: task.response
+	                       withContext: context
+	                             error: error
+	                 downloadedFileURL: downloadedFileURL];
+}
+
+- (void)_downloadNodeDataDidComplete:(nullable NSURLResponse *)urlResponse
+                         withContext:(ZDCDownloadContext *)context
+                               error:(nullable NSError *)error
+                   downloadedFileURL:(nullable NSURL *)downloadedFileURL
+{
+	[self _downloadNodeDataDidComplete: urlResponse
+	                       withContext: context
+	                             error: error
+	                 downloadedFileURL: downloadedFileURL
+	                    streamedHeader: NULL];
+}
+
+/**
+ * @param streamedHeaderPtr
+ *   If non-NULL, the file was streamed (via ZDCCacheFileDownloadSink),
+ *   and is already in cacheFile format. The header is the header of the cloudFile.
+ */
+- (void)_downloadNodeDataDidComplete:(nullable NSURLResponse *)urlResponse
+                         withContext:(ZDCDownloadContext *)context
+                               error:(nullable NSError *)error
+                   downloadedFileURL:(nullable NSURL *)downloadedFileURL
+                      streamedHeader:(nullable const ZDCCloudFileHeader *)streamedHeaderPtr
 {
 	ZDCLogAutoTrace();
 	
 	NSString *const nodeID = context.nodeID;
 	
+	BOOL const isStreamed = (streamedHeaderPtr != NULL);
+	
+	ZDCCloudFileHeader streamedHeader;
+	bzero(&streamedHeader, sizeof(streamedHeader));
+	if (isStreamed) {
+		streamedHeader = *streamedHeaderPtr;
+	}
+	
 	__weak typeof(self) weakSelf = self;
 	
 	void (^failBlock)(NSError *) = ^(NSError *error) { @autoreleasepool {
@@ -2155,7 +2368,6 @@ static NSUInteger const kMaxFailCount = 8;
 		[strongSelf nodeDataDownloadSucceeded:nodeID header:info cryptoFile:cryptoFile];
 	}};
 	
-	NSURLResponse *urlResponse = task.response;
 	NSInteger statusCode = [urlResponse httpStatusCode];
 	
 	if (urlResponse && error)
@@ -2170,6 +2382,9 @@ static NSUInteger const kMaxFailCount = 8;
 	// - 304 : Not Modified    - due to If-None-Match header
 	// - 403 : Forbidden
 	// - 503 : Slow Down       - we're being throttled
+	//
+	// Segmented downloads report problems (e.g. file modified during download) via the error,
+	// and are retried like any other network error.
 
 	if (error || (statusCode == 503))
 	{
@@ -2259,17 +2474,25 @@ static NSUInteger const kMaxFailCount = 8;
 		ZDCCloudFileHeader header;
 		bzero(&header, sizeof(header));
 	
-		NSError *decryptionError = nil;
-		[CloudFile2CleartextInputStream decryptCloudFileURL: downloadedFileURL
-		                                  withEncryptionKey: node.encryptionKey
-		                                             header: &header
-		                                        rawMetadata: nil
-		                                       rawThumbnail: nil
-		                                              error: &decryptionError];
-		if (decryptionError)
+		if (isStreamed)
 		{
-			failBlock(decryptionError);
-			return;
+			// Already decrypted while the file was downloading
+			header = streamedHeader;
+		}
+		else
+		{
+			NSError *decryptionError = nil;
+			[CloudFile2CleartextInputStream decryptCloudFileURL: downloadedFileURL
+			                                  withEncryptionKey: node.encryptionKey
+			                                             header: &header
+			                                        rawMetadata: nil
+			                                       rawThumbnail: nil
+			                                              error: &decryptionError];
+			if (decryptionError)
+			{
+				failBlock(decryptionError);
+				return;
+			}
 		}
 	
 		NSString *eTag = [urlResponse eTag] ?: @"";
@@ -2280,9 +2503,11 @@ static NSUInteger const kMaxFailCount = 8;
 		                                               eTag: eTag
 		                                       lastModified: lastModified];
 	
+		ZDCCryptoFileFormat fileFormat = isStreamed ? ZDCCryptoFileFormat_CacheFile : ZDCCryptoFileFormat_CloudFile;
+		
 		ZDCCryptoFile *cryptoFile =
 		  [[ZDCCryptoFile alloc] initWithFileURL: downloadedFileURL
-		                              fileFormat: ZDCCryptoFileFormat_CloudFile
+		                              fileFormat: fileFormat
 		                           encryptionKey: node.encryptionKey
 		                             retainToken: nil];
 		
@@ -2698,6 +2923,21 @@ static NSUInteger const kMaxFailCount = 8;
 	}
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Tickets
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Invoked when somebody asks for `ticket.progress`.
+ *
+ * The ZDCProgressManager only calculates throughput & estimated time remaining for progress items
+ * that have actually been handed out. So we let it know.
+ */
+- (void)ticketProgressRequested:(NSProgress *)progress
+{
+	[zdc.progressManager monitorThroughputForProgress:progress];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Cancellation
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -2762,6 +3002,7 @@ static NSUInteger const kMaxFailCount = 8;
 			NSString *resumeKey = [self resumeKeyForRequest:ref.task.originalRequest];
 			
 			[self cancelTask:ref.task withResumeKey:resumeKey isBackground:ref.isBackground];
+			[ref.segmentedDownload cancel];
 			
 			if (outDependency) *outDependency = ref.dependency;
 			return ProcessTicketResult_Cancelled;
@@ -2781,6 +3022,7 @@ static NSUInteger const kMaxFailCount = 8;
 			if (allIgnored)
 			{
 				ref.task.priority = NSURLSessionTaskPriorityLow;
+				[ref.segmentedDownload setPriority:NSURLSessionTaskPriorityLow];
 				
 				if (outDependency) *outDependency = ref.dependency;
 				return ProcessTicketResult_Ignored;
@@ -3059,6 +3301,7 @@ static NSString *const k_canBackground = @"canBackground";
 #endif
 static NSString *const k_identityID    = @"identityID";
 static NSString *const k_completionTag = @"completionTag";
+static NSString *const k_maxSegments   = @"maxSegments";
 
 @implementation ZDCDownloadOptions
 
@@ -3069,7 +3312,16 @@ static NSString *const k_completionTag = @"completionTag";
 #endif
 @synthesize identityID = _identityID;
 @synthesize completionConsolidationTag = _completionConsolidationTag;
+@synthesize maxConcurrentSegments = _maxSegments;
 
+- (instancetype)init
+{
+	if ((self = [super init]))
+	{
+		_maxSegments = kDefaultMaxConcurrentSegments;
+	}
+	return self;
+}
 
 - (instancetype)initWithCoder:(NSCoder *)decoder
 {
@@ -3082,6 +3334,11 @@ static NSString *const k_completionTag = @"completionTag";
 	#endif
 		_identityID = [decoder decodeObjectForKey:k_identityID];
 		_completionConsolidationTag = [decoder decodeObjectForKey:k_completionTag];
+		
+		if ([decoder containsValueForKey:k_maxSegments])
+			_maxSegments = (NSUInteger)[decoder decodeIntegerForKey:k_maxSegments];
+		else
+			_maxSegments = kDefaultMaxConcurrentSegments;
 	}
 	return self;
 }
@@ -3095,6 +3352,7 @@ static NSString *const k_completionTag = @"completionTag";
 #endif
 	[coder encodeObject:_identityID forKey:k_identityID];
 	[coder encodeObject:_completionConsolidationTag forKey:k_completionTag];
+	[coder encodeInteger:(NSInteger)_maxSegments forKey:k_maxSegments];
 }
 
 - (id)copyWithZone:(NSZone *)zone
@@ -3107,6 +3365,7 @@ static NSString *const k_completionTag = @"completionTag";
 #endif
 	copy.identityID = [_identityID copy];
 	copy.completionConsolidationTag = [_completionConsolidationTag copy];
+	copy.maxConcurrentSegments = _maxSegments;
 	
 	return copy;
 }
@@ -3201,6 +3460,12 @@ static NSString *const k_completionTag = @"completionTag";
 	return self;
 }
 
+- (NSProgress *)progress
+{
+	[_owner ticketProgressRequested:progress];
+	return progress;
+}
+
 - (void)cancel
 {
 	[_owner processTicketRequest:self isCancellation:YES];
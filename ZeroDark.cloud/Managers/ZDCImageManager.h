@@ -26,6 +26,9 @@ NS_ASSUME_NONNULL_BEGIN
  *
  * The ImageProcessingBlock operates in a background thread,
  * and its results get cached in memory (into a configurable NSCache instance).
+ *
+ * Multiple images are decoded & processed concurrently.
+ * So the block may be invoked concurrently, and must be thread-safe.
  */
 typedef OSImage*_Nonnull (^ZDCImageProcessingBlock)(OSImage *image);
 
@@ -40,33 +43,75 @@ typedef OSImage*_Nonnull (^ZDCImageProcessingBlock)(OSImage *image);
 /**
  * Direct access to the underlying in-memory cache container.
  *
- * You can configure the cache directly (via either countLimit and/or totalCostLimit),
- * or you can flush the cache (via removeAllObjects function).
- *
- * All items put into the cache are assigned a cost value based on the size of the data in bytes.
- * So its generally recommended that you configure the cache using the totalCostLimit property.
+ * You can flush the cache (via removeAllObjects function).
  *
- * The default configuration is:
- * - countLimit = 0
- * - totalCostLimit = 5 MiB (i.e.: 1024 * 1024 * 5)
+ * All items put into the cache are assigned a cost value based on the size of the decoded bitmap in bytes
+ * (i.e. the memory the image actually occupies, not the size of the compressed image data).
+ * The totalCostLimit is managed via the `nodeThumbnailsCacheBudget` property,
+ * which is automatically reduced when the system reports memory pressure.
  */
 @property (nonatomic, readonly) NSCache *nodeThumbnailsCache;
 
 /**
  * Direct access to the underlying in-memory cache container.
  *
- * You can configure the cache directly (via either countLimit and/or totalCostLimit),
- * or you can flush the cache (via removeAllObjects function).
- *
- * All items put into the cache are assigned a cost value based on the size of the data in bytes.
- * So its generally recommended that you configure the cache using the totalCostLimit property.
+ * You can flush the cache (via removeAllObjects function).
  *
- * The default configuration is:
- * - countLimit = 0
- * - totalCostLimit = 5 MiB (i.e.: 1024 * 1024 * 5)
+ * All items put into the cache are assigned a cost value based on the size of the decoded bitmap in bytes
+ * (i.e. the memory the image actually occupies, not the size of the compressed image data).
+ * The totalCostLimit is managed via the `userAvatarsCacheBudget` property,
+ * which is automatically reduced when the system reports memory pressure.
  */
 @property (nonatomic, readonly) NSCache *userAvatarsCache;
 
+/**
+ * The memory budget (in bytes) for the nodeThumbnailsCache.
+ *
+ * While the system is under memory pressure, the cache is limited to a fraction of this budget.
+ * And if the pressure becomes critical, the cache is flushed.
+ * The full budget is restored once the pressure subsides.
+ *
+ * The default value scales with the device's physical memory (1/32), clamped to the range 16 - 128 MiB.
+ */
+@property (atomic, assign, readwrite) NSUInteger nodeThumbnailsCacheBudget;
+
+/**
+ * The memory budget (in bytes) for the userAvatarsCache.
+ * Memory pressure is handled in the same manner as the nodeThumbnailsCacheBudget.
+ *
+ * The default value scales with the device's physical memory (1/128), clamped to the range 4 - 32 MiB.
+ */
+@property (atomic, assign, readwrite) NSUInteger userAvatarsCacheBudget;
+
+/**
+ * The maximum number of images that may be decoded (and processed) concurrently.
+ *
+ * The default value depends on the number of active processors (within the range 2 - 4).
+ */
+@property (atomic, assign, readwrite) NSUInteger maxConcurrentDecodes;
+
+/**
+ * The maximum number of prefetches (for each of node thumbnails & user avatars) that may be in flight at once.
+ * This bounds the amount of prefetching work that can compete with on-screen requests.
+ *
+ * The default value is 4.
+ */
+@property (atomic, assign, readwrite) NSUInteger maxConcurrentPrefetches;
+
+#pragma mark Statistics
+
+/**
+ * The number of `fetchNodeThumbnail:` requests answered from the nodeThumbnailsCache.
+ * Prefetches aren't counted.
+ */
+@property (atomic, readonly) uint64_t nodeThumbnailsCacheHitCount;
+
+/**
+ * The number of `fetchNodeThumbnail:` requests that had to load the image (from disk or the cloud).
+ * Prefetches aren't counted.
+ */
+@property (atomic, readonly) uint64_t nodeThumbnailsCacheMissCount;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Node Thumbnails
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -408,6 +453,80 @@ typedef OSImage*_Nonnull (^ZDCImageProcessingBlock)(OSImage *image);
  */
 - (OSImage *)defaultMultiUserAvatar;
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Prefetching
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Prefetches node thumbnails into the in-memory cache (`nodeThumbnailsCache`),
+ * so they're ready by the time the corresponding cells are displayed.
+ *
+ * Each invocation replaces the previous list. So during scrolling, you can simply invoke this method
+ * with the upcoming range whenever the visible range changes. (E.g. from a UICollectionViewDataSourcePrefetching.)
+ *
+ * Here's how this works:
+ * - The list is processed in order, so the first items in the array are fetched first.
+ * - At most `maxConcurrentPrefetches` items are in flight at any one time.
+ * - Duplicate items, and items that are already in the in-memory cache, are coalesced.
+ * - Items that were in flight, but aren't in the new list, are cancelled.
+ *   This cancels the download (unless another request needs it), and skips the decode if it hasn't started yet.
+ * - Prefetched images are decoded at a lower priority than images requested via `fetchNodeThumbnail:::`.
+ *   So on-screen images always take precedence.
+ *
+ * To get a cache hit later, the options & processingID must match those you pass to `fetchNodeThumbnail:::`.
+ *
+ * @param nodeIDs
+ *   An ordered list of nodeIDs, highest priority first (nodeID == ZDCNode.uuid).
+ *   Pass an empty array to cancel all node thumbnail prefetches.
+ *
+ * @param options
+ *   If nil, the default options will be used.
+ *
+ * @param processingID
+ *   The processingID you pass to `fetchNodeThumbnail:withOptions:processingID:processingBlock:::`.
+ *   If nil, the unprocessed image is prefetched.
+ *
+ * @param imageProcessingBlock
+ *   The processingBlock you pass to `fetchNodeThumbnail:withOptions:processingID:processingBlock:::`.
+ *   Ignored if processingID is nil.
+ */
+- (void)prefetchNodeThumbnails:(NSArray<NSString*> *)nodeIDs
+                   withOptions:(nullable ZDCFetchOptions *)options
+                  processingID:(nullable NSString *)processingID
+               processingBlock:(nullable ZDCImageProcessingBlock)imageProcessingBlock;
+
+/**
+ * Prefetches user avatars into the in-memory cache (`userAvatarsCache`).
+ *
+ * This works the same as `prefetchNodeThumbnails:withOptions:processingID:processingBlock:`.
+ *
+ * @param userIDs
+ *   An ordered list of userIDs, highest priority first (userID == ZDCUser.uuid).
+ *   Pass an empty array to cancel all user avatar prefetches.
+ *
+ * @param options
+ *   If nil, the default options will be used.
+ *
+ * @param processingID
+ *   The processingID you pass to `fetchUserAvatar:withOptions:processingID:processingBlock:::`.
+ *   If nil, the unprocessed image is prefetched.
+ *
+ * @param imageProcessingBlock
+ *   The processingBlock you pass to `fetchUserAvatar:withOptions:processingID:processingBlock:::`.
+ *   Ignored if processingID is nil.
+ */
+- (void)prefetchUserAvatars:(NSArray<NSString*> *)userIDs
+                withOptions:(nullable ZDCFetchOptions *)options
+               processingID:(nullable NSString *)processingID
+            processingBlock:(nullable ZDCImageProcessingBlock)imageProcessingBlock;
+
+/**
+ * Cancels all in-flight & pending prefetches (both node thumbnails & user avatars).
+ *
+ * Requests made via the fetch methods are not affected.
+ */
+- (void)cancelAllPrefetches;
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -436,6 +555,20 @@ typedef OSImage*_Nonnull (^ZDCImageProcessingBlock)(OSImage *image);
  */
 @property (nonatomic, assign, readwrite) BOOL downloadIfMarkedAsNeedsDownload;
 
+/**
+ * Applies to Node Thumbnails:
+ *
+ * If non-zero, the image is downsampled while decoding, such that neither dimension exceeds this size (in pixels).
+ * This is much cheaper (in both time & memory) than decoding the full image and resizing it afterwards.
+ * Images that are already smaller are not upscaled.
+ *
+ * Pass the size at which you'll display the image (in pixels, i.e. taking the screen scale into account).
+ * Each size is cached separately, and is passed to your processingBlock (if any) in downsampled form.
+ *
+ * The default value is 0 (no downsampling).
+ */
+@property (nonatomic, assign, readwrite) CGFloat maxPixelSize;
+
 
 /**
  * Applies to User Avatars:
@@ -10,14 +10,19 @@
 #import "ZDCImageManagerPrivate.h"
 
 #import "Auth0Utilities.h"
+#import "ZDCConstantsPrivate.h"
 #import "ZDCDatabaseManagerPrivate.h"
 #import "ZDCDownloadManagerPrivate.h"
+#import "ZDCImageDecoder.h"
+#import "ZDCImagePrefetchQueue.h"
 #import "ZDCLogging.h"
+#import "ZDCNodeDownloadStatusCache.h"
 
 // Categories
 #import "NSError+ZeroDark.h"
 
 // Libraries
+#import <stdatomic.h>
 #import <YapDatabase/YapCache.h>
 
 // Log Levels: off, error, warn, info, verbose
@@ -31,6 +36,11 @@
 #endif
 #pragma unused(zdcLogLevel)
 
+// When the OS signals memory pressure, the caches are shrunk to a fraction of their budget.
+// They're restored once the pressure subsides.
+//
+static NSUInteger const kMemoryPressureWarningDivisor = 4;
+
 @interface ZDCCachedImageItem : NSObject
 
 - (instancetype)initWithKey:(NSString *)key image:(nullable OSImage *)image eTag:(nullable NSString *)eTag;
@@ -82,11 +92,33 @@
 	
 	NSMutableSet<NSString*> *cacheKeys_nodeThumnails;
 	NSMutableSet<NSString*> *cacheKeys_userAvatars;
+	
+	ZDCNodeDownloadStatusCache *downloadStatusCache;
+	
+	ZDCImageDecoder *imageDecoder;
+	
+	NSUInteger nodeThumbnailsCacheBudget; // accessed via cacheKeysQueue
+	NSUInteger userAvatarsCacheBudget;    // accessed via cacheKeysQueue
+	dispatch_source_memorypressure_flags_t memoryPressure; // accessed via cacheKeysQueue
+	dispatch_source_t memoryPressureSource;
+	
+	ZDCImagePrefetchQueue *nodeThumbnailsPrefetchQueue;
+	ZDCImagePrefetchQueue *userAvatarsPrefetchQueue;
+	
+	atomic_uint_least64_t nodeThumbnailsCacheHitCount;
+	atomic_uint_least64_t nodeThumbnailsCacheMissCount;
 }
 
 @synthesize nodeThumbnailsCache = nodeThumbnailsCache;
 @synthesize userAvatarsCache = userAvatarsCache;
 
+@dynamic nodeThumbnailsCacheBudget;
+@dynamic userAvatarsCacheBudget;
+@dynamic maxConcurrentDecodes;
+@dynamic maxConcurrentPrefetches;
+@dynamic nodeThumbnailsCacheHitCount;
+@dynamic nodeThumbnailsCacheMissCount;
+
 - (instancetype)init
 {
 	return nil; // To access this class use: ZeroDarkCloud.downloadManager
@@ -101,14 +133,25 @@
 		internal_roConnection = [zdc.databaseManager internal_roConnection];
 		processingQueue = dispatch_queue_create("ZDCImageManager-processing", DISPATCH_QUEUE_SERIAL);
 		
+		imageDecoder = [[ZDCImageDecoder alloc] initWithMaxConcurrentDecodes:0];
+		
+		atomic_init(&nodeThumbnailsCacheHitCount, 0);
+		atomic_init(&nodeThumbnailsCacheMissCount, 0);
+		
+		// The cost of each cached item is the size of its decoded bitmap.
+		// So the budget needs to scale with the device. (A single full-screen image can exceed 10 MiB.)
+		
+		nodeThumbnailsCacheBudget = [[self class] defaultCacheBudgetWithDivisor:32 min:16 max:128];
+		userAvatarsCacheBudget    = [[self class] defaultCacheBudgetWithDivisor:128 min:4 max:32];
+		
 		nodeThumbnailsCache = [[NSCache alloc] init];
 		userAvatarsCache = [[NSCache alloc] init];
 		
 		nodeThumbnailsCache.countLimit = 0;
-		nodeThumbnailsCache.totalCostLimit = (1024 * 1024 * 5); // 5 MiB
+		nodeThumbnailsCache.totalCostLimit = nodeThumbnailsCacheBudget;
 		
 		userAvatarsCache.countLimit = 0;
-		userAvatarsCache.totalCostLimit = (1024 * 1024 * 5); // 5 MiB
+		userAvatarsCache.totalCostLimit = userAvatarsCacheBudget;
 		
 		nodeThumbnailsCache.delegate = self;
 		userAvatarsCache.delegate = self;
@@ -126,10 +169,45 @@
 		cacheKeys_nodeThumnails = [[NSMutableSet alloc] init];
 		cacheKeys_userAvatars = [[NSMutableSet alloc] init];
 		
+		// Checking `nodeIsMarkedAsNeedsDownload` requires a database read.
+		// We mirror the value in memory, so that a cache hit doesn't require a transaction.
+		
+		downloadStatusCache = [[ZDCNodeDownloadStatusCache alloc] init];
+		
 		[[NSNotificationCenter defaultCenter] addObserver: self
 		                                         selector: @selector(diskManagerChanged:)
 		                                             name: ZDCDiskManagerChangedNotification
 		                                           object: zdc.diskManager];
+		
+		[[NSNotificationCenter defaultCenter] addObserver: self
+		                                         selector: @selector(nodeDownloadStatusChanged:)
+		                                             name: ZDCNodeDownloadStatusChangedNotification
+		                                           object: nil];
+		
+		[self startMemoryPressureSource];
+		
+		__weak typeof(self) weakSelf = self;
+		dispatch_queue_t prefetchQueue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0);
+		
+		nodeThumbnailsPrefetchQueue =
+		  [[ZDCImagePrefetchQueue alloc] initWithStartQueue: prefetchQueue
+		                                         startBlock:^(ZDCImagePrefetchTask *task)
+		{
+			__strong typeof(self) strongSelf = weakSelf;
+			if (strongSelf) {
+				[strongSelf startNodeThumbnailPrefetch:task];
+			}
+		}];
+		
+		userAvatarsPrefetchQueue =
+		  [[ZDCImagePrefetchQueue alloc] initWithStartQueue: prefetchQueue
+		                                         startBlock:^(ZDCImagePrefetchTask *task)
+		{
+			__strong typeof(self) strongSelf = weakSelf;
+			if (strongSelf) {
+				[strongSelf startUserAvatarPrefetch:task];
+			}
+		}];
 	}
 	return self;
 }
@@ -137,6 +215,172 @@
 - (void)dealloc
 {
 	[[NSNotificationCenter defaultCenter] removeObserver:self];
+	
+	if (memoryPressureSource) {
+		dispatch_source_cancel(memoryPressureSource);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Configuration
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns (physicalMemory / divisor), clamped to the given range (in MiB).
+ */
++ (NSUInteger)defaultCacheBudgetWithDivisor:(NSUInteger)divisor min:(NSUInteger)minMiB max:(NSUInteger)maxMiB
+{
+	unsigned long long physicalMemory = [[NSProcessInfo processInfo] physicalMemory];
+	
+	unsigned long long budget = physicalMemory / divisor;
+	budget = MAX(budget, (unsigned long long)minMiB * 1024 * 1024);
+	budget = MIN(budget, (unsigned long long)maxMiB * 1024 * 1024);
+	
+	return (NSUInteger)budget;
+}
+
+- (NSUInteger)nodeThumbnailsCacheBudget
+{
+	__block NSUInteger result = 0;
+	dispatch_sync(cacheKeysQueue, ^{
+		result = self->nodeThumbnailsCacheBudget;
+	});
+	
+	return result;
+}
+
+- (void)setNodeThumbnailsCacheBudget:(NSUInteger)budget
+{
+	dispatch_sync(cacheKeysQueue, ^{
+		self->nodeThumbnailsCacheBudget = budget;
+	});
+	
+	[self applyCacheBudgets];
+}
+
+- (NSUInteger)userAvatarsCacheBudget
+{
+	__block NSUInteger result = 0;
+	dispatch_sync(cacheKeysQueue, ^{
+		result = self->userAvatarsCacheBudget;
+	});
+	
+	return result;
+}
+
+- (void)setUserAvatarsCacheBudget:(NSUInteger)budget
+{
+	dispatch_sync(cacheKeysQueue, ^{
+		self->userAvatarsCacheBudget = budget;
+	});
+	
+	[self applyCacheBudgets];
+}
+
+- (NSUInteger)maxConcurrentDecodes
+{
+	return imageDecoder.maxConcurrentDecodes;
+}
+
+- (void)setMaxConcurrentDecodes:(NSUInteger)value
+{
+	imageDecoder.maxConcurrentDecodes = value;
+}
+
+- (NSUInteger)maxConcurrentPrefetches
+{
+	return nodeThumbnailsPrefetchQueue.maxInFlight;
+}
+
+- (void)setMaxConcurrentPrefetches:(NSUInteger)value
+{
+	nodeThumbnailsPrefetchQueue.maxInFlight = value;
+	userAvatarsPrefetchQueue.maxInFlight = value;
+}
+
+- (uint64_t)nodeThumbnailsCacheHitCount
+{
+	return atomic_load_explicit(&nodeThumbnailsCacheHitCount, memory_order_relaxed);
+}
+
+- (uint64_t)nodeThumbnailsCacheMissCount
+{
+	return atomic_load_explicit(&nodeThumbnailsCacheMissCount, memory_order_relaxed);
+}
+
+/**
+ * Updates the totalCostLimit of each cache, based on the configured budget & current memory pressure.
+ */
+- (void)applyCacheBudgets
+{
+	__block NSUInteger thumbnailsLimit = 0;
+	__block NSUInteger avatarsLimit = 0;
+	
+	dispatch_sync(cacheKeysQueue, ^{
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		thumbnailsLimit = nodeThumbnailsCacheBudget;
+		avatarsLimit = userAvatarsCacheBudget;
+		
+		if (memoryPressure & (DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL))
+		{
+			// Note: A totalCostLimit of zero means "no limit"
+			
+			thumbnailsLimit = MAX(1, thumbnailsLimit / kMemoryPressureWarningDivisor);
+			avatarsLimit = MAX(1, avatarsLimit / kMemoryPressureWarningDivisor);
+		}
+		
+	#pragma clang diagnostic pop
+	});
+	
+	// Lowering the totalCostLimit causes the NSCache to evict items (as needed) to get under the new limit.
+	
+	nodeThumbnailsCache.totalCostLimit = thumbnailsLimit;
+	userAvatarsCache.totalCostLimit = avatarsLimit;
+}
+
+- (void)startMemoryPressureSource
+{
+	dispatch_source_memorypressure_flags_t mask =
+	  DISPATCH_MEMORYPRESSURE_NORMAL | DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL;
+	
+	dispatch_queue_t bgQueue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+	
+	memoryPressureSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0, mask, bgQueue);
+	
+	__weak typeof(self) weakSelf = self;
+	dispatch_source_set_event_handler(memoryPressureSource, ^{ @autoreleasepool {
+		
+		__strong typeof(self) strongSelf = weakSelf;
+		if (strongSelf == nil) return;
+		
+		dispatch_source_memorypressure_flags_t flags =
+		  (dispatch_source_memorypressure_flags_t)dispatch_source_get_data(strongSelf->memoryPressureSource);
+		
+		[strongSelf handleMemoryPressure:flags];
+	}});
+	
+	dispatch_resume(memoryPressureSource);
+}
+
+- (void)handleMemoryPressure:(dispatch_source_memorypressure_flags_t)flags
+{
+	ZDCLogVerbose(@"Memory pressure: %lu", (unsigned long)flags);
+	
+	dispatch_sync(cacheKeysQueue, ^{
+		self->memoryPressure = flags;
+	});
+	
+	if (flags & DISPATCH_MEMORYPRESSURE_CRITICAL)
+	{
+		// Everything in the caches can be re-read from the DiskManager.
+		
+		[nodeThumbnailsCache removeAllObjects];
+		[userAvatarsCache removeAllObjects];
+	}
+	
+	[self applyCacheBudgets];
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -154,6 +398,17 @@
 	
 	BOOL isNodeThumbnails = (cache == nodeThumbnailsCache);
 	
+	if (isNodeThumbnails)
+	{
+		// Stop tracking the download status (it will be re-read if the thumbnail is fetched again).
+		// This keeps the downloadStatusCache from growing beyond the size of the thumbnail cache.
+		
+		NSString *nodeID = nil;
+		if ([self getNodeID:&nodeID fromCacheKey:key]) {
+			[downloadStatusCache removeNodeIDs:@[ nodeID ]];
+		}
+	}
+	
 	__weak typeof(self) weakSelf = self;
 	dispatch_async(cacheKeysQueue, ^{ @autoreleasepool {
 	
@@ -181,13 +436,35 @@
 	[self _flushUserAvatarsCache:changes.changedUsersIDs];
 }
 
+- (void)nodeDownloadStatusChanged:(NSNotification *)notification
+{
+	NSDictionary<NSString*, NSNumber*> *changes =
+	  notification.userInfo[ZDCNodeDownloadStatusChangedNotification_UserInfo_Changes];
+	
+	if (![changes isKindOfClass:[NSDictionary class]]) return;
+	
+	[downloadStatusCache applyChanges:changes];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Node Thumbnails
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-- (NSString *)cacheKeyForNodeID:(NSString *)nodeID processingID:(NSString *)processingID
+- (NSString *)cacheKeyForNodeID:(NSString *)nodeID
+                   processingID:(nullable NSString *)processingID
+                   maxPixelSize:(CGFloat)maxPixelSize
 {
-	return [NSString stringWithFormat:@"%@|%@", nodeID, processingID];
+	// Downsampled images are cached separately for each size.
+	
+	if (maxPixelSize > 0) {
+		return [NSString stringWithFormat:@"%@|%@|%.0f", nodeID, (processingID ?: @""), ceil(maxPixelSize)];
+	}
+	else if (processingID) {
+		return [NSString stringWithFormat:@"%@|%@", nodeID, processingID];
+	}
+	else {
+		return nodeID;
+	}
 }
 
 - (void)cacheNodeThumbnail:(nullable OSImage *)image
@@ -204,6 +481,50 @@
 	}});
 }
 
+/**
+ * Answers `[ZDCCloudTransaction nodeIsMarkedAsNeedsDownload:node.uuid components:ZDCNodeComponents_Thumbnail]`.
+ *
+ * The in-memory downloadStatusCache is consulted first.
+ * The database is only read if the node isn't being tracked yet (i.e. typically on a cache miss).
+ */
+- (BOOL)nodeThumbnailIsMarkedAsNeedsDownload:(ZDCNode *)node
+{
+	ZDCNodeComponents components = 0;
+	if ([downloadStatusCache getMarkedComponents:&components forNodeID:node.uuid])
+	{
+		return (components & ZDCNodeComponents_Thumbnail) != 0;
+	}
+	
+	uint64_t generation = downloadStatusCache.generation;
+	__block ZDCNodeComponents marked = 0;
+	
+	[internal_roConnection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		ZDCCloudTransaction *cloudTransaction =
+		  [self->zdc cloudTransaction:transaction forLocalUserID:node.localUserID];
+		
+		ZDCNodeComponents const list[] = {
+			ZDCNodeComponents_Header,
+			ZDCNodeComponents_Metadata,
+			ZDCNodeComponents_Thumbnail,
+			ZDCNodeComponents_Data
+		};
+		
+		for (NSUInteger i = 0; i < (sizeof(list) / sizeof(list[0])); i++)
+		{
+			if ([cloudTransaction nodeIsMarkedAsNeedsDownload:node.uuid components:list[i]]) {
+				marked |= list[i];
+			}
+		}
+	}];
+	
+	[downloadStatusCache setMarkedComponents: marked
+	                               forNodeID: node.uuid
+	                     ifGenerationMatches: generation];
+	
+	return (marked & ZDCNodeComponents_Thumbnail) != 0;
+}
+
 - (BOOL)getNodeID:(NSString **)outNodeID fromCacheKey:(NSString *)cacheKey
 {
 	NSString *nodeID = nil;
@@ -234,10 +555,13 @@
 {
 	ZDCLogAutoTrace();
 	
+	NSString *cacheKey = [self cacheKeyForNodeID:node.uuid processingID:nil maxPixelSize:options.maxPixelSize];
+	
 	return [self _fetchNodeThumbnail: node
-	                    withCacheKey: node.uuid
+	                    withCacheKey: cacheKey
 	                         options: options
 	                 processingBlock: nil
+	                    prefetchTask: nil
 	                   preFetchBlock: preFetchBlock
 	                  postFetchBlock: postFetchBlock];
 }
@@ -259,13 +583,14 @@
 	
 	NSString *cacheKey = nil;
 	if (processingID) {
-		cacheKey = [self cacheKeyForNodeID:node.uuid processingID:processingID];
+		cacheKey = [self cacheKeyForNodeID:node.uuid processingID:processingID maxPixelSize:options.maxPixelSize];
 	}
 	
 	return [self _fetchNodeThumbnail: node
 	                    withCacheKey: cacheKey
 	                         options: options
 	                 processingBlock: imageProcessingBlock
+	                    prefetchTask: nil
 	                   preFetchBlock: preFetchBlock
 	                  postFetchBlock: postFetchBlock];
 }
@@ -275,29 +600,29 @@
                withCacheKey:(nullable NSString *)cacheKey
                     options:(nullable ZDCFetchOptions *)inOptions
             processingBlock:(nullable ZDCImageProcessingBlock)imageProcessingBlock
+               prefetchTask:(nullable ZDCImagePrefetchTask *)prefetchTask
               preFetchBlock:(void(^)(OSImage *_Nullable image, BOOL willFetch))preFetchBlock
              postFetchBlock:(void(^)(OSImage *_Nullable image, NSError *_Nullable error))postFetchBlock
 {
 	ZDCFetchOptions *options = inOptions ? [inOptions copy] : [[ZDCFetchOptions alloc] init];
 	
-	__block BOOL nodeIsMarkedAsNeedsDownload = NO;
+	BOOL nodeIsMarkedAsNeedsDownload = NO;
 	if (options.downloadIfMarkedAsNeedsDownload)
 	{
-		[internal_roConnection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
-			
-			ZDCCloudTransaction *cloudTransaction =
-			  [self->zdc cloudTransaction:transaction forLocalUserID:node.localUserID];
-			
-			nodeIsMarkedAsNeedsDownload =
-			  [cloudTransaction nodeIsMarkedAsNeedsDownload: node.uuid
-			                                     components: ZDCNodeComponents_Thumbnail];
-		}];
+		nodeIsMarkedAsNeedsDownload = [self nodeThumbnailIsMarkedAsNeedsDownload:node];
 	}
 	
 	ZDCCachedImageItem *cachedItem = nil;
 	if (cacheKey)
 	{
 		cachedItem = [nodeThumbnailsCache objectForKey:cacheKey];
+		
+		if (prefetchTask == nil)
+		{
+			atomic_uint_least64_t *counter = cachedItem ? &nodeThumbnailsCacheHitCount : &nodeThumbnailsCacheMissCount;
+			atomic_fetch_add_explicit(counter, 1, memory_order_relaxed);
+		}
+		
 		if (cachedItem)
 		{
 			BOOL willFetch = NO;
@@ -308,6 +633,7 @@
 			
 			preFetchBlock(cachedItem.image, willFetch);
 			if (!willFetch) {
+				[prefetchTask finish];
 				return nil;
 			}
 		}
@@ -334,6 +660,7 @@
 		{
 			preFetchBlock(nil, requiresDownload);
 			if (!requiresDownload) {
+				[prefetchTask finish];
 				return nil;
 			}
 		}
@@ -343,34 +670,24 @@
 	}
 	
 	__weak typeof(self) weakSelf = self;
-	void (^processingBlock)(NSData*, NSString*, NSError*, BOOL) =
-		^(NSData *imageData, NSString *eTag, NSError *error, BOOL isDownload){ @autoreleasepool
+	__block BOOL didDownload = NO;
+	
+	void (^completionBlock)(OSImage*, NSUInteger, NSString*, NSError*, NSError*, BOOL) =
+		^(OSImage *image, NSUInteger cost, NSString *eTag, NSError *error, NSError *processingError, BOOL isDownload){ @autoreleasepool
 	{
 		// Executing on the processingQueue now
 		
-		OSImage *image = nil;
-		NSError *processingError = nil;
-		
-		if (imageData)
+		if (!isDownload && didDownload)
 		{
-			image = [[OSImage alloc] initWithData:imageData];
-			
-			if (image == nil)
-			{
-				NSString *msg = @"Unable to create image from thumbnail data";
-				processingError = [NSError errorWithClass:[self class] code:500 description:msg];
-			}
+			// Decodes run concurrently, so the (fresh) downloaded image may have been decoded first.
+			// Don't replace it with the (stale) version from disk.
+			return;
 		}
 		
-		if (image && imageProcessingBlock)
+		if (prefetchTask.isCancelled && image == nil)
 		{
-			image = imageProcessingBlock(image);
-			
-			if (image == nil)
-			{
-				NSString *msg = @"Your imageProcessingBlock returned a nil result";
-				processingError = [NSError errorWithClass:[self class] code:500 description:msg];
-			}
+			// The prefetch was cancelled before the image was decoded.
+			return;
 		}
 		
 		__strong typeof(self) strongSelf = weakSelf;
@@ -378,8 +695,7 @@
 		{
 			if (cacheKey && !error)
 			{
-				NSUInteger cost = imageData.length ?: 1;
-				[strongSelf cacheNodeThumbnail:image forKey:cacheKey withETag:eTag cost:cost];
+				[strongSelf cacheNodeThumbnail:image forKey:cacheKey withETag:eTag cost:(cost ?: 1)];
 			}
 			
 			if (isDownload && options.downloadIfMarkedAsNeedsDownload && !error)
@@ -405,11 +721,52 @@
 				postFetchBlock(image, error ?: processingError);
 			});
 		}
+		
+		if (isDownload || !requiresDownload) {
+			[prefetchTask finish];
+		}
 	}};
 	
+	ZDCImageDecoder *decoder = imageDecoder;
+	dispatch_queue_t decoderCompletionQueue = processingQueue;
+	
+	void (^processingBlock)(NSData*, NSString*, NSError*, BOOL) =
+		^(NSData *imageData, NSString *eTag, NSError *error, BOOL isDownload){ @autoreleasepool
+	{
+		// Executing on the processingQueue now
+		
+		if (imageData == nil)
+		{
+			completionBlock(nil, 0, eTag, error, nil, isDownload);
+			return;
+		}
+		
+		// Decode (and downsample & process) on the decoder's bounded concurrent queue,
+		// so that one large image doesn't hold up every other thumbnail.
+		//
+		// Prefetches are decoded at low priority, so they never delay an on-screen image.
+		// And if the prefetch is cancelled (e.g. scrolled off-screen) before the decode starts, it's skipped.
+		
+		BOOL (^isCancelled)(void) = nil;
+		if (prefetchTask) {
+			isCancelled = ^BOOL (void){
+				return prefetchTask.isCancelled;
+			};
+		}
+		
+		[decoder decodeImageData: imageData
+		            maxPixelSize: options.maxPixelSize
+		             lowPriority: (prefetchTask != nil)
+		             isCancelled: isCancelled
+		         processingBlock: imageProcessingBlock
+		         completionQueue: decoderCompletionQueue
+		         completionBlock:^(OSImage *image, NSUInteger cost, NSError *processingError)
+		{
+			completionBlock(image, cost, eTag, error, processingError, isDownload);
+		}];
+	}};
 	
 	ZDCDownloadTicket *downloadTicket = nil;
-	__block BOOL didDownload = NO;
 	
 	if (export.cryptoFile)
 	{
@@ -503,8 +860,10 @@
 	// ZDCNode.uuid is a NSUUID.
 	// Example NSUUID string (from Apple's docs): E621E1F8-C36C-495A-93FC-0C247A3E6E5F
 	
-	NSString *suffix = [NSString stringWithFormat:@"|%@", processingID];
-	NSUInteger expectedLength = 36 + 1 + processingID.length;
+	// Keys have the form "<nodeID>|<processingID>" or "<nodeID>|<processingID>|<maxPixelSize>".
+	
+	NSString *sizedPrefix = [NSString stringWithFormat:@"%@|", processingID];
+	NSUInteger nodeIDLength = 36 + 1;
 	
 	NSMutableArray *keys = [NSMutableArray array];
 	dispatch_sync(cacheKeysQueue, ^{ @autoreleasepool {
@@ -513,7 +872,10 @@
 		
 		for (NSString *key in cacheKeys_nodeThumnails)
 		{
-			if ((key.length == expectedLength) && [key hasSuffix:suffix]) {
+			if (key.length <= nodeIDLength) continue;
+			
+			NSString *suffix = [key substringFromIndex:nodeIDLength];
+			if ([suffix isEqualToString:processingID] || [suffix hasPrefix:sizedPrefix]) {
 				[keys addObject:key];
 			}
 		}
@@ -580,6 +942,54 @@
 	}});
 }
 
+/**
+ * Decodes the avatar (on the imageDecoder), and then runs the processingBlock.
+ * The completionBlock is invoked on the processingQueue.
+ */
+- (void)decodeUserAvatarData:(NSData *)imageData
+             processingBlock:(nullable ZDCImageProcessingBlock)imageProcessingBlock
+                prefetchTask:(nullable ZDCImagePrefetchTask *)prefetchTask
+             completionBlock:(ZDCImageDecoderCompletionBlock)completionBlock
+{
+	__block BOOL isPlaceholder = NO;
+	
+	ZDCImageProcessingBlock wrapperBlock = ^OSImage *(OSImage *image) {
+		
+		if (image.size.width < 16 || image.size.height < 16)
+		{
+			// Image has to be big enough.
+			// Some providers (like box) give a 1x1 image for no image.
+			isPlaceholder = YES;
+			return image;
+		}
+		
+		return imageProcessingBlock ? imageProcessingBlock(image) : image;
+	};
+	
+	BOOL (^isCancelled)(void) = nil;
+	if (prefetchTask) {
+		isCancelled = ^BOOL (void){
+			return prefetchTask.isCancelled;
+		};
+	}
+	
+	[imageDecoder decodeImageData: imageData
+	                 maxPixelSize: 0
+	                  lowPriority: (prefetchTask != nil)
+	                  isCancelled: isCancelled
+	              processingBlock: wrapperBlock
+	              completionQueue: processingQueue
+	              completionBlock:^(OSImage *image, NSUInteger cost, NSError *error)
+	{
+		if (isPlaceholder) {
+			completionBlock(nil, 0, nil);
+		}
+		else {
+			completionBlock(image, cost, error);
+		}
+	}];
+}
+
 /**
  * See header file for description.
  * Or view the api's online (for both Swift & Objective-C):
@@ -604,6 +1014,7 @@
 	                   identityID: identityID
 	                     cacheKey: cacheKey
 	              processingBlock: nil
+	                 prefetchTask: nil
 	                preFetchBlock: preFetchBlock
 	               postFetchBlock: postFetchBlock];
 }
@@ -637,6 +1048,7 @@
 	                   identityID: identityID
 	                     cacheKey: cacheKey
 	              processingBlock: imageProcessingBlock
+	                 prefetchTask: nil
 	                preFetchBlock: preFetchBlock
 	               postFetchBlock: postFetchBlock];
 }
@@ -646,6 +1058,7 @@
               identityID:(nullable NSString *)identityID
                 cacheKey:(nullable NSString *)cacheKey
          processingBlock:(nullable ZDCImageProcessingBlock)imageProcessingBlock
+            prefetchTask:(nullable ZDCImagePrefetchTask *)prefetchTask
            preFetchBlock:(void(^)(OSImage *_Nullable image, BOOL willFetch))preFetchBlock
           postFetchBlock:(void(^)(OSImage *_Nullable image, NSError *_Nullable error))postFetchBlock
 {
@@ -655,6 +1068,7 @@
 		if (cachedItem)
 		{
 			preFetchBlock(cachedItem.image, NO);
+			[prefetchTask finish];
 			return nil;
 		}
 	}
@@ -663,45 +1077,28 @@
 	if (export.isNilPlaceholder)
 	{
 		preFetchBlock(nil, NO);
+		[prefetchTask finish];
 		return nil;
 	}
 	
 	preFetchBlock(nil, YES);
 	
 	__weak typeof(self) weakSelf = self;
-	void (^processingBlock)(NSData*, NSError*) =
-		^(NSData *imageData, NSError *error){ @autoreleasepool
+	void (^completionBlock)(OSImage*, NSUInteger, NSError*) =
+		^(OSImage *image, NSUInteger cost, NSError *error){ @autoreleasepool
 	{
 		// Executing on the processingQueue now
 		
-		OSImage *image = nil;
-		if (imageData)
-		{
-			image = [[OSImage alloc] initWithData:imageData];
-			
-			if (image == nil)
-			{
-				NSString *msg = @"Unable to create image from cached thumbnail data";
-				error = [NSError errorWithClass:[self class] code:500 description:msg];
-			}
-			else if (image.size.height < 16 || image.size.height < 16)
-			{
-				// Image has to be big enough.
-				// Some providers (like box) give a 1x1 image for no image.
-				image = nil;
-			}
-		}
-		
-		if (image && imageProcessingBlock)
+		if (prefetchTask.isCancelled && image == nil)
 		{
-			image = imageProcessingBlock(image);
+			// The prefetch was cancelled before the image was decoded.
+			return;
 		}
 		
 		__strong typeof(self) strongSelf = weakSelf;
 		if (strongSelf && cacheKey && !error)
 		{
-			NSUInteger cost = imageData.length ?: 1;
-			[strongSelf cacheUserAvatar:image forKey:cacheKey withETag:nil cost:cost];
+			[strongSelf cacheUserAvatar:image forKey:cacheKey withETag:nil cost:(cost ?: 1)];
 		}
 		
 		if (postFetchBlock)
@@ -710,6 +1107,29 @@
 				postFetchBlock(image, error);
 			});
 		}
+		
+		[prefetchTask finish];
+	}};
+	
+	void (^processingBlock)(NSData*, NSError*) =
+		^(NSData *imageData, NSError *error){ @autoreleasepool
+	{
+		// Executing on the processingQueue now
+		
+		__strong typeof(self) strongSelf = weakSelf;
+		if (imageData == nil || strongSelf == nil)
+		{
+			completionBlock(nil, 0, error);
+			return;
+		}
+		
+		[strongSelf decodeUserAvatarData: imageData
+		                 processingBlock: imageProcessingBlock
+		                    prefetchTask: prefetchTask
+		                 completionBlock:^(OSImage *image, NSUInteger cost, NSError *decodeError)
+		{
+			completionBlock(image, cost, error ?: decodeError);
+		}];
 	}};
 	
 	if (export.cryptoFile)
@@ -786,39 +1206,15 @@
 	preFetchBlock(nil, YES);
 	
 	__weak typeof(self) weakSelf = self;
-	void (^processingBlock)(NSData*, NSError*) =
-		^(NSData *imageData, NSError *error){ @autoreleasepool
+	void (^completionBlock)(OSImage*, NSUInteger, NSError*) =
+		^(OSImage *image, NSUInteger cost, NSError *error){ @autoreleasepool
 	{
 		// Executing on the processingQueue now
 		
-		OSImage *image = nil;
-		if (imageData)
-		{
-			image = [[OSImage alloc] initWithData:imageData];
-			
-			if (image == nil)
-			{
-				NSString *msg = @"Unable to create image from cached thumbnail data";
-				error = [NSError errorWithClass:[self class] code:500 description:msg];
-			}
-			else if (image.size.height < 16 || image.size.height < 16)
-			{
-				// Image has to be big enough.
-				// Some providers (like box) give a 1x1 image for no image.
-				image = nil;
-			}
-		}
-		
-		if (image && imageProcessingBlock)
-		{
-			image = imageProcessingBlock(image);
-		}
-		
 		__strong typeof(self) strongSelf = weakSelf;
 		if (strongSelf && cacheKey)
 		{
-			NSUInteger cost = imageData.length ?: 1;
-			[strongSelf cacheUserAvatar:image forKey:cacheKey withETag:nil cost:cost];
+			[strongSelf cacheUserAvatar:image forKey:cacheKey withETag:nil cost:(cost ?: 1)];
 		}
 		
 		if (postFetchBlock)
@@ -829,6 +1225,27 @@
 		}
 	}};
 	
+	void (^processingBlock)(NSData*, NSError*) =
+		^(NSData *imageData, NSError *error){ @autoreleasepool
+	{
+		// Executing on the processingQueue now
+		
+		__strong typeof(self) strongSelf = weakSelf;
+		if (imageData == nil || strongSelf == nil)
+		{
+			completionBlock(nil, 0, error);
+			return;
+		}
+		
+		[strongSelf decodeUserAvatarData: imageData
+		                 processingBlock: imageProcessingBlock
+		                    prefetchTask: nil
+		                 completionBlock:^(OSImage *image, NSUInteger cost, NSError *decodeError)
+		{
+			completionBlock(image, cost, error ?: decodeError);
+		}];
+	}};
+	
 	ZDCDownloadTicket *ticket =
 	[zdc.downloadManager downloadUserAvatar: searchResult
 										  identityID: identityID
@@ -975,6 +1392,178 @@
 	return image;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Prefetching
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * See header file for description.
+ * Or view the api's online (for both Swift & Objective-C):
+ * https://apis.zerodark.cloud/Classes/ZDCImageManager.html
+ */
+- (void)prefetchNodeThumbnails:(NSArray<NSString*> *)nodeIDs
+                   withOptions:(nullable ZDCFetchOptions *)options
+                  processingID:(nullable NSString *)processingID
+               processingBlock:(nullable ZDCImageProcessingBlock)imageProcessingBlock
+{
+	ZDCLogAutoTrace();
+	
+	if (processingID == nil || imageProcessingBlock == nil)
+	{
+		// Same as the fetch methods: the result of an imageProcessingBlock is only cached if there's a processingID.
+		processingID = nil;
+		imageProcessingBlock = nil;
+	}
+	
+	NSMutableArray<ZDCImagePrefetchTask *> *tasks = [NSMutableArray arrayWithCapacity:nodeIDs.count];
+	for (NSString *nodeID in nodeIDs)
+	{
+		NSString *cacheKey =
+		  [self cacheKeyForNodeID:nodeID processingID:processingID maxPixelSize:options.maxPixelSize];
+		
+		ZDCImagePrefetchTask *task =
+		  [[ZDCImagePrefetchTask alloc] initWithKey: cacheKey
+		                                 identifier: nodeID
+		                                    options: options
+		                               processingID: processingID
+		                            processingBlock: imageProcessingBlock];
+		
+		[tasks addObject:task];
+	}
+	
+	[nodeThumbnailsPrefetchQueue setTasks:tasks];
+}
+
+/**
+ * See header file for description.
+ * Or view the api's online (for both Swift & Objective-C):
+ * https://apis.zerodark.cloud/Classes/ZDCImageManager.html
+ */
+- (void)prefetchUserAvatars:(NSArray<NSString*> *)userIDs
+                withOptions:(nullable ZDCFetchOptions *)options
+               processingID:(nullable NSString *)processingID
+            processingBlock:(nullable ZDCImageProcessingBlock)imageProcessingBlock
+{
+	ZDCLogAutoTrace();
+	
+	if (processingID == nil || imageProcessingBlock == nil)
+	{
+		// Same as the fetch methods: the result of an imageProcessingBlock is only cached if there's a processingID.
+		processingID = nil;
+		imageProcessingBlock = nil;
+	}
+	
+	// The cacheKey depends on the user's displayIdentity, which requires a database read.
+	// So the prefetch key is derived from the request instead, and the cacheKey is calculated when the task starts.
+	
+	NSMutableArray<ZDCImagePrefetchTask *> *tasks = [NSMutableArray arrayWithCapacity:userIDs.count];
+	for (NSString *userID in userIDs)
+	{
+		NSString *key = [NSString stringWithFormat:@"%@|%@|%@",
+		                   userID, (options.identityID ?: @""), (processingID ?: @"")];
+		
+		ZDCImagePrefetchTask *task =
+		  [[ZDCImagePrefetchTask alloc] initWithKey: key
+		                                 identifier: userID
+		                                    options: options
+		                               processingID: processingID
+		                            processingBlock: imageProcessingBlock];
+		
+		[tasks addObject:task];
+	}
+	
+	[userAvatarsPrefetchQueue setTasks:tasks];
+}
+
+/**
+ * See header file for description.
+ */
+- (void)cancelAllPrefetches
+{
+	ZDCLogAutoTrace();
+	
+	[nodeThumbnailsPrefetchQueue setTasks:@[]];
+	[userAvatarsPrefetchQueue setTasks:@[]];
+}
+
+/**
+ * Invoked by the nodeThumbnailsPrefetchQueue (on a low priority background queue).
+ */
+- (void)startNodeThumbnailPrefetch:(ZDCImagePrefetchTask *)task
+{
+	if (task.isCancelled) return;
+	
+	__block ZDCNode *node = nil;
+	[internal_roConnection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		node = [transaction objectForKey:task.identifier inCollection:kZDCCollection_Nodes];
+	}];
+	
+	if (![node isKindOfClass:[ZDCNode class]])
+	{
+		[task finish];
+		return;
+	}
+	
+	ZDCDownloadTicket *ticket =
+	  [self _fetchNodeThumbnail: node
+	               withCacheKey: task.key
+	                    options: task.options
+	            processingBlock: task.processingBlock
+	               prefetchTask: task
+	              preFetchBlock:^(OSImage *image, BOOL willFetch) {}
+	             postFetchBlock: nil];
+	
+	if (ticket) {
+		task.downloadTicket = ticket;
+	}
+}
+
+/**
+ * Invoked by the userAvatarsPrefetchQueue (on a low priority background queue).
+ */
+- (void)startUserAvatarPrefetch:(ZDCImagePrefetchTask *)task
+{
+	if (task.isCancelled) return;
+	
+	__block ZDCUser *user = nil;
+	[internal_roConnection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		user = [transaction objectForKey:task.identifier inCollection:kZDCCollection_Users];
+	}];
+	
+	if (![user isKindOfClass:[ZDCUser class]])
+	{
+		[task finish];
+		return;
+	}
+	
+	NSString *identityID = task.options.identityID;
+	if (identityID == nil) {
+		identityID = user.displayIdentity.identityID;
+	}
+	
+	NSString *cacheKey = nil;
+	if (task.processingID) {
+		cacheKey = [self cacheKeyForUserID:user.uuid identityID:identityID processingID:task.processingID];
+	} else {
+		cacheKey = [self cacheKeyForUserID:user.uuid identityID:identityID];
+	}
+	
+	ZDCDownloadTicket *ticket =
+	  [self _fetchUserAvatar: user
+	              identityID: identityID
+	                cacheKey: cacheKey
+	         processingBlock: task.processingBlock
+	            prefetchTask: task
+	           preFetchBlock:^(OSImage *image, BOOL willFetch) {}
+	          postFetchBlock: nil];
+	
+	if (ticket) {
+		task.downloadTicket = ticket;
+	}
+}
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -984,6 +1573,7 @@
 @implementation ZDCFetchOptions
 
 @synthesize downloadIfMarkedAsNeedsDownload = _downloadIfMarkedAsNeedsDownload;
+@synthesize maxPixelSize = _maxPixelSize;
 @synthesize identityID = _identityID;
 
 - (instancetype)init
@@ -1000,6 +1590,7 @@
 {
 	ZDCFetchOptions *copy = [[ZDCFetchOptions alloc] init];
 	copy->_downloadIfMarkedAsNeedsDownload = _downloadIfMarkedAsNeedsDownload;
+	copy->_maxPixelSize = _maxPixelSize;
 	copy->_identityID = _identityID;
 	
 	return copy;
@@ -18,6 +18,7 @@
 #import "ZDCDatabaseManagerPrivate.h"
 #import "ZDCLocalUserPrivate.h"
 #import "ZDCLogging.h"
+#import "ZDCPullManagerPrivate.h"
 #import "ZDCTrunkNodePrivate.h"
 #import "ZDCUserPrivate.h"
 #import "ZeroDarkCloudPrivate.h"
@@ -344,6 +345,7 @@ static NSString *const k_displayName = @"displayName";
 	// Delete the user's pullState.
 	
 	[transaction removeObjectForKey:localUserID inCollection:kZDCCollection_PullState];
+	[zdc.pullManager removeFullPullCheckpointForLocalUserID:localUserID transaction:transaction];
 	
 	// NOTES:
 	//
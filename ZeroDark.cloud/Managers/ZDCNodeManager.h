@@ -15,6 +15,7 @@
 #import "ZDCCloud.h"
 #import "ZDCCloudRcrd.h"
 #import "ZDCNode.h"
+#import "ZDCNodeAggregates.h"
 #import "ZDCPublicKey.h"
 #import "ZDCTreesystemPath.h"
 #import "ZDCTrunkNode.h"
@@ -477,6 +478,55 @@ NS_SWIFT_NAME(findNode(withCloudPath:bucket:region:localUserID:treeID:transactio
                                                     treeID:(NSString *)treeID
                                                transaction:(YapDatabaseReadTransaction *)transaction;
 
+/**
+ * Returns all ZDCNode.uuid's belonging to the given user (regardless of treeID) where ZDCNode.cloudID is non-nil.
+ *
+ * @note This list doesn't include trunk nodes.
+ */
+- (NSArray<NSString *> *)allUploadedNodeIDsWithLocalUserID:(NSString *)localUserID
+                                               transaction:(YapDatabaseReadTransaction *)transaction;
+
+/**
+ * Returns the number of nodes belonging to the given user (regardless of treeID).
+ *
+ * This is answered directly by the database (via a count query), without loading the list of nodeIDs.
+ *
+ * @note This count doesn't include trunk nodes.
+ */
+- (NSUInteger)numberOfNodesWithLocalUserID:(NSString *)localUserID
+                               transaction:(YapDatabaseReadTransaction *)transaction;
+
+/**
+ * Returns the number of nodes belonging to the given user (regardless of treeID) where ZDCNode.cloudID is non-nil.
+ *
+ * @note This count doesn't include trunk nodes.
+ */
+- (NSUInteger)numberOfUploadedNodesWithLocalUserID:(NSString *)localUserID
+                                       transaction:(YapDatabaseReadTransaction *)transaction;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Aggregates
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns summary information about the node's subtree:
+ * the number of descendants, the total cloud data size & the number of pending uploads.
+ *
+ * The aggregates are maintained incrementally by the framework (as nodes are inserted, modified, moved & deleted).
+ * So this is a single lookup, regardless of the size of the subtree.
+ * This is much faster than using `recursiveEnumerateNodesWithParentID:::` to calculate the same values.
+ *
+ * @param nodeID
+ *   The node of interest. (nodeID == ZDCNode.uuid)
+ *
+ * @param transaction
+ *   A database transaction - allows the method to read from the database.
+ *
+ * @return The aggregates, or nil if the node doesn't exist (or the aggregates haven't been calculated yet).
+ */
+- (nullable ZDCNodeAggregates *)aggregatesForNodeID:(NSString *)nodeID
+                                        transaction:(YapDatabaseReadTransaction *)transaction;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Permissions
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -512,6 +562,9 @@ NS_SWIFT_NAME(findNode(withCloudPath:bucket:region:localUserID:treeID:transactio
  * This method appends a number to the end of the name until it's unique.
  * For example, if the given node.name is "Foobar.ext", this method may return "Foobar 2.ext".
  *
+ * The number chosen is one past the highest number already in use by a sibling.
+ * (So if "Foobar 2.ext" & "Foobar 7.ext" exist, the result is "Foobar 8.ext".)
+ *
  * @param node
  *   The node that's in conflict with another node.
  *
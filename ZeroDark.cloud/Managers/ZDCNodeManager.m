@@ -14,6 +14,8 @@
 #import "ZDCDatabaseManager.h"
 #import "ZDCLocalUser.h"
 #import "ZDCLogging.h"
+#import "ZDCNamingConflictIndex.h"
+#import "ZDCNodePathCache.h"
 #import "ZDCNodePrivate.h"
 #import "ZDCPublicKey.h"
 #import "ZDCTreesystemPath.h"
@@ -232,8 +234,26 @@ static ZDCNodeManager *sharedInstance = nil;
 	ZDCLogAutoTrace();
 	NSParameterAssert(transaction != nil);
 	
+	ZDCNodePathCache *pathCache = [ZDCNodePathCache cacheForTransaction:transaction];
+	
+	// Fast path: we've already calculated the path for the parent.
+	//
+	// Note: We never memoize the path for the given node itself.
+	// It may be a modified copy that hasn't been written to the database.
+	
+	if (node && ![node isKindOfClass:[ZDCTrunkNode class]] && node.parentID && ![node.parentID hasSuffix:@"|graft"])
+	{
+		ZDCTreesystemPath *parentPath = [pathCache pathForNodeID:node.parentID transaction:transaction];
+		if (parentPath) {
+			return [parentPath pathByAppendingComponent:(node.name ?: @"")];
+		}
+	}
+	
 	ZDCTrunkNode *trunkNode = nil;
+	ZDCTreesystemPath *cachedPath = nil;
 	NSMutableArray<NSString *> *pathComponents = [NSMutableArray arrayWithCapacity:8];
+	NSMutableArray<ZDCNode *> *ancestors = [NSMutableArray arrayWithCapacity:8]; // nearest first
+	BOOL isGrafted = NO;
 	
 	while (node)
 	{
@@ -256,6 +276,8 @@ static ZDCNodeManager *sharedInstance = nil;
 		
 		if ([node.parentID hasSuffix:@"|graft"])
 		{
+			isGrafted = YES;
+			
 			NSString *localUserID = nil;
 			NSString *treeID = nil;
 			[ZDCNode getLocalUserID:&localUserID treeID:&treeID fromParentID:node.parentID];
@@ -267,15 +289,63 @@ static ZDCNodeManager *sharedInstance = nil;
 		}
 		else
 		{
+			if (!isGrafted)
+			{
+				cachedPath = [pathCache pathForNodeID:node.parentID transaction:transaction];
+				if (cachedPath) break;
+			}
+			
 			node = [transaction objectForKey:node.parentID inCollection:kZDCCollection_Nodes];
+			if (node && !isGrafted) {
+				[ancestors addObject:node];
+			}
 		}
 	}
 	
-	ZDCTreesystemTrunk trunk = (trunkNode ? trunkNode.trunk : ZDCTreesystemTrunk_Detached);
+	ZDCTreesystemPath *path = nil;
+	if (cachedPath)
+	{
+		NSArray<NSString *> *components = [cachedPath.pathComponents arrayByAddingObjectsFromArray:pathComponents];
+		
+		path = [[ZDCTreesystemPath alloc] initWithPathComponents: components
+		                                                   trunk: cachedPath.trunk];
+	}
+	else
+	{
+		ZDCTreesystemTrunk trunk = (trunkNode ? trunkNode.trunk : ZDCTreesystemTrunk_Detached);
+		
+		path = [[ZDCTreesystemPath alloc] initWithPathComponents: pathComponents
+		                                                   trunk: trunk];
+	}
+	
+	// Memoize the path for each ancestor (top-down).
+	// This only works for simple paths: ones that end at a trunk, and didn't hop across a graft.
+	
+	if (!isGrafted && (trunkNode || cachedPath))
+	{
+		NSArray<NSString *> *components = path.pathComponents;
+		NSUInteger count = components.count;
+		
+		for (NSUInteger i = ancestors.count; i > 0; i--)
+		{
+			ZDCNode *ancestor = ancestors[i-1];
+			
+			ZDCTreesystemPath *ancestorPath = nil;
+			if ([ancestor isKindOfClass:[ZDCTrunkNode class]])
+			{
+				ancestorPath = [[ZDCTreesystemPath alloc] initWithPathComponents:@[] trunk:path.trunk];
+			}
+			else
+			{
+				NSArray<NSString *> *ancestorComponents = [components subarrayWithRange:NSMakeRange(0, count - i)];
+				ancestorPath = [[ZDCTreesystemPath alloc] initWithPathComponents: ancestorComponents
+				                                                           trunk: path.trunk];
+			}
+			
+			[pathCache addNode:ancestor path:ancestorPath transaction:transaction];
+		}
+	}
 	
-	ZDCTreesystemPath *path =
-	  [[ZDCTreesystemPath alloc] initWithPathComponents: pathComponents
-	                                              trunk: trunk];
 	return path;
 }
 
@@ -858,16 +928,35 @@ static ZDCNodeManager *sharedInstance = nil;
 	}
 	else
 	{
+		ZDCNodePathCache *pathCache = [ZDCNodePathCache cacheForTransaction:transaction];
+		
 		NSString *parentID = containerID;
+		NSString *nodeID = nil;
 		
 		for (NSString *filename in path.pathComponents)
 		{
-			node = [self findNodeWithName:filename parentID:parentID transaction:transaction];
-			// Do not follow pointer here.
-			// If path ends in pointer, then the pointer node must be returned.
+			node = nil;
+			nodeID = [pathCache nodeIDForName:filename parentID:parentID transaction:transaction];
+			
+			if (nodeID == nil)
+			{
+				node = [self findNodeWithName:filename parentID:parentID transaction:transaction];
+				// Do not follow pointer here.
+				// If path ends in pointer, then the pointer node must be returned.
+				
+				if (node == nil) break;
+				
+				[pathCache addNode:node transaction:transaction];
+				nodeID = node.uuid;
+			}
 			
-			if (node == nil) break;
-			parentID = node.uuid;
+			parentID = nodeID;
+		}
+		
+		if (node == nil && nodeID)
+		{
+			// The last path component was a cache hit
+			node = [transaction objectForKey:nodeID inCollection:kZDCCollection_Nodes];
 		}
 	}
 
@@ -1412,11 +1501,35 @@ static ZDCNodeManager *sharedInstance = nil;
 	if (localUserID == nil) return [NSArray array];
 	
 	NSMutableArray *result = [NSMutableArray array];
+	YapDatabaseSecondaryIndexTransaction *secondaryIndexTransaction = nil;
 	YapDatabaseViewTransaction *flatViewTransaction = nil;
 	
-	if ((flatViewTransaction = [transaction ext:Ext_View_Flat]))
+	if ((secondaryIndexTransaction = [transaction ext:Ext_Index_Nodes]))
 	{
-		// Use Flat View for best performance.
+		// Use secondary index for best performance (uses sqlite indexes)
+		//
+		// WHERE localUserID = ?
+		//
+		// Note: trunk nodes aren't indexed by localUserID.
+		
+		NSString *queryString = [NSString stringWithFormat:@"WHERE %@ = ?", Index_Nodes_Column_LocalUserID];
+		YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:queryString, localUserID];
+		
+		[secondaryIndexTransaction enumerateKeysMatchingQuery:query usingBlock:
+		  ^(NSString *collection, NSString *key, BOOL *stop)
+		{
+			[result addObject:key];
+		}];
+	}
+	else if ((flatViewTransaction = [transaction ext:Ext_View_Flat]))
+	{
+		// Backup Plan (defensive programming)
+		//
+		// Secondary Index extension isn't ready yet.
+		// It must be still initializing / updating.
+		//
+		// The flat view is grouped by <localUserID, treeID>,
+		// so we have to find all the groups that belong to the user.
 		
 		NSMutableArray<NSString*> *treeIDs = [NSMutableArray array];
 		NSString *prefix = [localUserID stringByAppendingString:@"|"];
@@ -1545,8 +1658,8 @@ static ZDCNodeManager *sharedInstance = nil;
 		// - The flatViewTransaction can quickly give us a list of nodeIDs for the <localUserID, treeID>,
 		//   but doesn't tell us which are uploaded.
 		//
-		// - The secondaryIndexTransaction can quickly tell us which nodes are uploaded,
-		//   but doesn't tell us which <localUserID, treeID> they belong to.
+		// - The secondaryIndexTransaction can quickly tell us which of the user's nodes are uploaded,
+		//   but doesn't tell us which treeID they belong to.
 		//
 		// So we can combine the 2.
 		
@@ -1564,8 +1677,11 @@ static ZDCNodeManager *sharedInstance = nil;
 		
 		uploadedNodeIDs = [NSMutableArray arrayWithCapacity:nodeIDs.count];
 		
-		NSString *queryString = [NSString stringWithFormat:@"WHERE %@ IS NOT NULL", Index_Nodes_Column_CloudID];
-		YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:queryString];
+		NSString *queryString =
+		  [NSString stringWithFormat:@"WHERE %@ = ? AND %@ IS NOT NULL",
+		    Index_Nodes_Column_LocalUserID, Index_Nodes_Column_CloudID];
+		
+		YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:queryString, localUserID];
 		
 		[secondaryIndexTransaction enumerateKeysMatchingQuery:query usingBlock:
 		^(NSString *collection, NSString *nodeID, BOOL *stop)
@@ -1636,6 +1752,156 @@ static ZDCNodeManager *sharedInstance = nil;
 	return uploadedNodeIDs;
 }
 
+/**
+ * See header file for description.
+ * Or view the api's online (for both Swift & Objective-C):
+ * https://apis.zerodark.cloud/Classes/ZDCRestManager.html
+**/
+- (NSArray<NSString *> *)allUploadedNodeIDsWithLocalUserID:(NSString *)localUserID
+                                               transaction:(YapDatabaseReadTransaction *)transaction
+{
+	ZDCLogAutoTrace();
+	NSParameterAssert(transaction != nil);
+	
+	if (localUserID == nil) return [NSArray array];
+	
+	YapDatabaseSecondaryIndexTransaction *secondaryIndexTransaction = [transaction ext:Ext_Index_Nodes];
+	if (secondaryIndexTransaction)
+	{
+		// Use secondary index for best performance (uses sqlite indexes)
+		//
+		// WHERE localUserID = ? AND cloudID IS NOT NULL
+		
+		NSMutableArray<NSString *> *uploadedNodeIDs = [NSMutableArray array];
+		
+		NSString *queryString =
+		  [NSString stringWithFormat:@"WHERE %@ = ? AND %@ IS NOT NULL",
+		    Index_Nodes_Column_LocalUserID, Index_Nodes_Column_CloudID];
+		
+		YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:queryString, localUserID];
+		
+		[secondaryIndexTransaction enumerateKeysMatchingQuery:query usingBlock:
+		  ^(NSString *collection, NSString *nodeID, BOOL *stop)
+		{
+			[uploadedNodeIDs addObject:nodeID];
+		}];
+		
+		return uploadedNodeIDs;
+	}
+	else
+	{
+		// Backup Plan (defensive programming)
+		//
+		// Secondary Index extension isn't ready yet.
+		// It must be still initializing / updating.
+		
+		NSMutableArray<NSString *> *uploadedNodeIDs = [NSMutableArray array];
+		
+		for (NSString *nodeID in [self allNodeIDsWithLocalUserID:localUserID transaction:transaction])
+		{
+			ZDCNode *node = [transaction objectForKey:nodeID inCollection:kZDCCollection_Nodes];
+			if (node.cloudID)
+			{
+				[uploadedNodeIDs addObject:nodeID];
+			}
+		}
+		
+		return uploadedNodeIDs;
+	}
+}
+
+/**
+ * See header file for description.
+ * Or view the api's online (for both Swift & Objective-C):
+ * https://apis.zerodark.cloud/Classes/ZDCRestManager.html
+**/
+- (NSUInteger)numberOfNodesWithLocalUserID:(NSString *)localUserID
+                               transaction:(YapDatabaseReadTransaction *)transaction
+{
+	ZDCLogAutoTrace();
+	NSParameterAssert(transaction != nil);
+	
+	if (localUserID == nil) return 0;
+	
+	YapDatabaseSecondaryIndexTransaction *secondaryIndexTransaction = [transaction ext:Ext_Index_Nodes];
+	if (secondaryIndexTransaction)
+	{
+		// Use secondary index for best performance (SELECT COUNT)
+		
+		NSString *queryString = [NSString stringWithFormat:@"WHERE %@ = ?", Index_Nodes_Column_LocalUserID];
+		YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:queryString, localUserID];
+		
+		NSUInteger count = 0;
+		if ([secondaryIndexTransaction getNumberOfRows:&count matchingQuery:query]) {
+			return count;
+		}
+	}
+	
+	// Backup Plan (defensive programming)
+	
+	return [self allNodeIDsWithLocalUserID:localUserID transaction:transaction].count;
+}
+
+/**
+ * See header file for description.
+ * Or view the api's online (for both Swift & Objective-C):
+ * https://apis.zerodark.cloud/Classes/ZDCRestManager.html
+**/
+- (NSUInteger)numberOfUploadedNodesWithLocalUserID:(NSString *)localUserID
+                                       transaction:(YapDatabaseReadTransaction *)transaction
+{
+	ZDCLogAutoTrace();
+	NSParameterAssert(transaction != nil);
+	
+	if (localUserID == nil) return 0;
+	
+	YapDatabaseSecondaryIndexTransaction *secondaryIndexTransaction = [transaction ext:Ext_Index_Nodes];
+	if (secondaryIndexTransaction)
+	{
+		// Use secondary index for best performance (SELECT COUNT)
+		
+		NSString *queryString =
+		  [NSString stringWithFormat:@"WHERE %@ = ? AND %@ IS NOT NULL",
+		    Index_Nodes_Column_LocalUserID, Index_Nodes_Column_CloudID];
+		
+		YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:queryString, localUserID];
+		
+		NSUInteger count = 0;
+		if ([secondaryIndexTransaction getNumberOfRows:&count matchingQuery:query]) {
+			return count;
+		}
+	}
+	
+	// Backup Plan (defensive programming)
+	
+	return [self allUploadedNodeIDsWithLocalUserID:localUserID transaction:transaction].count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Aggregates
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * See header file for description.
+ * Or view the api's online (for both Swift & Objective-C):
+ * https://apis.zerodark.cloud/Classes/ZDCRestManager.html
+ */
+- (nullable ZDCNodeAggregates *)aggregatesForNodeID:(NSString *)nodeID
+                                        transaction:(YapDatabaseReadTransaction *)transaction
+{
+	ZDCLogAutoTrace();
+	NSParameterAssert(transaction != nil);
+	
+	if (nodeID == nil) return nil;
+	
+	id object = [transaction objectForKey:nodeID inCollection:kZDCCollection_NodeAggregates];
+	if ([object isKindOfClass:[ZDCNodeAggregates class]]) {
+		return (ZDCNodeAggregates *)object;
+	}
+	
+	return nil;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Permissions
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1748,6 +2014,61 @@ static ZDCNodeManager *sharedInstance = nil;
 		}
 	}
 	
+	// Directories can accumulate hundreds of "Untitled N" siblings.
+	// So rather than probing "Foo 2", "Foo 3", ... one lookup at a time,
+	// we start just past the highest suffix in use.
+	//
+	// The highest suffix is remembered by the ZDCNamingConflictIndex,
+	// which is kept up-to-date via the transaction hooks (see ZDCCloudTransaction).
+	// We still verify the candidate, and continue probing if it's taken.
+	// (E.g. if the treesystem view isn't available.)
+	
+	NSString *parentID = node.parentID;
+	
+	ZDCNode *parentNode = [transaction objectForKey:parentID inCollection:kZDCCollection_Nodes];
+	if (parentNode) {
+		parentNode = [self targetNodeForNode:parentNode transaction:transaction]; // follow pointer(s)
+		parentID = parentNode.uuid;
+	}
+	
+	ZDCNamingConflictIndex *index = [ZDCNamingConflictIndex indexForTransaction:transaction];
+	
+	NSNumber *highestSuffix =
+	  [index highestSuffixForBase: name_base
+	                    extension: name_ext
+	                     parentID: parentID
+	                  transaction: transaction];
+	
+	if (highestSuffix == nil)
+	{
+		uint64_t highest = 0;
+		NSString *holderID = nil;
+		
+		BOOL found =
+		  [self getHighestSuffix: &highest
+		                holderID: &holderID
+		                 forBase: name_base
+		               extension: name_ext
+		                parentID: parentID
+		             transaction: transaction];
+		
+		if (found)
+		{
+			[index setHighestSuffix: highest
+			               holderID: holderID
+			                forBase: name_base
+			              extension: name_ext
+			               parentID: parentID
+			            transaction: transaction];
+		}
+		
+		highestSuffix = @(highest);
+	}
+	
+	if (highestSuffix.unsignedLongLongValue >= numberToAppend) {
+		numberToAppend = highestSuffix.unsignedLongLongValue + 1;
+	}
+	
 	// Append increasing numbers until we find a name that's not in conflict.
 	
 	NSString *newName = nil;
@@ -1777,4 +2098,82 @@ static ZDCNodeManager *sharedInstance = nil;
 	return newName;
 }
 
+/**
+ * Finds the highest N for which a sibling named "name_base N.name_ext" exists (or zero if there are none),
+ * along with the nodeID of that sibling.
+ *
+ * The Ext_View_Treesystem_Name view has the children of each parent sorted by name.
+ * So all the "name_base *" siblings are in a contiguous range, which we can find via binary search.
+ * If the view isn't ready, we return NO, and the caller falls back to probing.
+ *
+ * @param parentID
+ *   The parent that actually holds the children (i.e. after following pointers).
+ */
+- (BOOL)getHighestSuffix:(uint64_t *)outHighest
+                holderID:(NSString **)outHolderID
+                 forBase:(NSString *)name_base
+               extension:(NSString *)name_ext
+                parentID:(NSString *)parentID
+             transaction:(YapDatabaseReadTransaction *)transaction
+{
+	if (parentID == nil) return NO;
+	
+	YapDatabaseAutoViewTransaction *treesystemViewTransaction = [transaction ext:Ext_View_Treesystem_Name];
+	if (treesystemViewTransaction == nil) return NO;
+	
+	NSString *prefix = [name_base stringByAppendingString:@" "];
+	NSUInteger prefixLength = prefix.length;
+	
+	YapDatabaseViewFind *find = [YapDatabaseViewFind withObjectBlock:
+	  ^(NSString *collection, NSString *key, id object)
+	{
+		__unsafe_unretained ZDCNode *node = (ZDCNode *)object;
+		
+		NSString *name = node.name ?: @"";
+		if (name.length > prefixLength) {
+			name = [name substringToIndex:prefixLength];
+		}
+		
+		return [name localizedCaseInsensitiveCompare:prefix];
+	}];
+	
+	if (outHighest) *outHighest = 0;
+	if (outHolderID) *outHolderID = nil;
+	
+	NSRange range = [treesystemViewTransaction findRangeInGroup:parentID using:find];
+	if (range.location == NSNotFound || range.length == 0) return YES;
+	
+	NSCharacterSet *nonDigits = [[NSCharacterSet decimalDigitCharacterSet] invertedSet];
+	__block uint64_t highest = 0;
+	__block NSString *holderID = nil;
+	
+	[treesystemViewTransaction enumerateKeysAndObjectsInGroup: parentID
+	                                              withOptions: 0
+	                                                    range: range
+	                                               usingBlock:
+	  ^(NSString *collection, NSString *key, id object, NSUInteger index, BOOL *stop)
+	{
+		__unsafe_unretained ZDCNode *node = (ZDCNode *)object;
+		
+		NSString *base = [node.name stringByDeletingPathExtension];
+		NSString *ext = [node.name pathExtension];
+		
+		if (base.length <= prefixLength) return; // from block
+		if ([ext localizedCaseInsensitiveCompare:name_ext] != NSOrderedSame) return; // from block
+		
+		NSString *suffix = [base substringFromIndex:prefixLength];
+		if ([suffix rangeOfCharacterFromSet:nonDigits].location != NSNotFound) return; // from block
+		
+		uint64_t number = strtoull([suffix UTF8String], NULL, 10);
+		if (number > highest) {
+			highest = number;
+			holderID = key;
+		}
+	}];
+	
+	if (outHighest) *outHighest = highest;
+	if (outHolderID) *outHolderID = holderID;
+	return YES;
+}
+
 @end
@@ -13,6 +13,7 @@
 
 @class ZDCCloudOperation;
 @class ZDCProgress;
+@class ZDCTransferStatistics;
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -590,6 +591,24 @@ typedef void (^UploadCompletionBlock)(BOOL success);
 - (void)removeUploadProgressForOperationUUID:(NSUUID *)operationID
                                  withSuccess:(BOOL)success;
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Transfer Statistics
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns aggregate statistics for all network transfers (uploads & downloads) of the given localUser.
+ *
+ * The byte counters are updated as data goes across the wire,
+ * and the throughput is calculated on demand (when you invoke this method).
+ * So this is a cheap way to display overall activity (e.g. "12.3 MB/s, 2 minutes remaining"),
+ * without having to fetch & observe every individual NSProgress.
+ *
+ * @param localUserID
+ *   The localUser for which you're interested. (localUserID == ZDCLocalUser.uuid)
+ *   Pass nil to get the statistics for all localUsers.
+ */
+- (ZDCTransferStatistics *)transferStatisticsForLocalUserID:(nullable NSString *)localUserID;
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -642,4 +661,46 @@ typedef void (^UploadCompletionBlock)(BOOL success);
 
 @end
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A snapshot of the network transfer statistics, as returned by `-[ZDCProgressManager transferStatisticsForLocalUserID:]`.
+ */
+@interface ZDCTransferStatistics : NSObject
+
+/**
+ * The total number of bytes uploaded (since the app was launched).
+ */
+@property (nonatomic, readonly) uint64_t bytesSent;
+
+/**
+ * The total number of bytes downloaded (since the app was launched).
+ */
+@property (nonatomic, readonly) uint64_t bytesReceived;
+
+/**
+ * The current upload speed, in bytes per second.
+ */
+@property (nonatomic, readonly) double uploadThroughput;
+
+/**
+ * The current download speed, in bytes per second.
+ */
+@property (nonatomic, readonly) double downloadThroughput;
+
+/**
+ * The number of bytes remaining for all in-flight uploads & downloads (that have a known size).
+ */
+@property (nonatomic, readonly) uint64_t bytesRemaining;
+
+/**
+ * The estimated time remaining (in seconds) for all in-flight uploads & downloads.
+ * Returns nil if there's nothing in flight, or if the throughput is currently zero.
+ */
+@property (nonatomic, readonly, nullable) NSNumber *estimatedTimeRemaining;
+
+@end
+
 NS_ASSUME_NONNULL_END
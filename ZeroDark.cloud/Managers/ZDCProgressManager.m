@@ -14,6 +14,10 @@
 #import "ZDCNode.h"
 #import "ZDCLogging.h"
 #import "ZDCProgress.h"
+#import "ZDCTransferCounters.h"
+
+// Libraries
+#import <YapDatabase/YapDatabaseAtomic.h>
 
 // Log Levels: off, error, warn, info, verbose
 // Log Flags : trace
@@ -45,6 +49,17 @@
 
 @end
 
+@interface ZDCTransferStatistics ()
+
+@property (nonatomic, assign, readwrite) uint64_t bytesSent;
+@property (nonatomic, assign, readwrite) uint64_t bytesReceived;
+@property (nonatomic, assign, readwrite) double uploadThroughput;
+@property (nonatomic, assign, readwrite) double downloadThroughput;
+@property (nonatomic, assign, readwrite) uint64_t bytesRemaining;
+@property (nonatomic, strong, readwrite, nullable) NSNumber *estimatedTimeRemaining;
+
+@end
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark -
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -72,6 +87,95 @@
 #pragma mark -
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Reverse lookup: localUserID => active identifiers (nodeIDs or operationUUIDs).
+ *
+ * Counted sets are used because the same identifier may be added multiple times.
+ * For example, a node may have several meta downloads in flight (with different components),
+ * or several upload operations.
+ *
+ * Not thread-safe. Only access within ZDCProgressManager's queue.
+ */
+@interface ZDCProgressIndex<ObjectType> : NSObject
+
+- (void)addObject:(ObjectType)object localUserID:(nullable NSString *)localUserID;
+- (void)removeObject:(ObjectType)object localUserID:(nullable NSString *)localUserID;
+
+- (NSMutableSet<ObjectType> *)allObjects;
+- (NSMutableSet<ObjectType> *)objectsForLocalUserID:(NSString *)localUserID;
+
+@end
+
+@implementation ZDCProgressIndex {
+	
+	NSCountedSet *all;
+	NSMutableDictionary<NSString*, NSCountedSet*> *perUser; // key == localUserID
+}
+
+- (instancetype)init
+{
+	if ((self = [super init]))
+	{
+		all = [[NSCountedSet alloc] init];
+		perUser = [[NSMutableDictionary alloc] init];
+	}
+	return self;
+}
+
+- (void)addObject:(id)object localUserID:(NSString *)localUserID
+{
+	if (object == nil) return;
+	
+	[all addObject:object];
+	
+	if (localUserID)
+	{
+		NSCountedSet *set = perUser[localUserID];
+		if (set == nil)
+		{
+			set = [[NSCountedSet alloc] init];
+			perUser[localUserID] = set;
+		}
+		
+		[set addObject:object];
+	}
+}
+
+- (void)removeObject:(id)object localUserID:(NSString *)localUserID
+{
+	if (object == nil) return;
+	
+	[all removeObject:object];
+	
+	if (localUserID)
+	{
+		NSCountedSet *set = perUser[localUserID];
+		[set removeObject:object];
+		
+		if (set.count == 0) {
+			perUser[localUserID] = nil;
+		}
+	}
+}
+
+- (NSMutableSet *)allObjects
+{
+	return [NSMutableSet setWithSet:all];
+}
+
+- (NSMutableSet *)objectsForLocalUserID:(NSString *)localUserID
+{
+	NSCountedSet *set = localUserID ? perUser[localUserID] : nil;
+	
+	return set ? [NSMutableSet setWithSet:set] : [NSMutableSet set];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 @interface ZDCNetworkSpeedInfo : NSObject
 
 @property (nonatomic, assign, readwrite) int64_t last_totalUnitCount;
@@ -110,12 +214,22 @@
 	dispatch_queue_t timerQueue;
 	dispatch_source_t timer;
 	NSMutableArray<NSProgress *> *monitoring;
+	NSMutableSet<NSProgress *> *registered;
+	
+	YAPUnfairLock countersLock;
+	NSMutableDictionary<NSString*, ZDCTransferCounters*> *transferCounters; // key == localUserID
+	ZDCTransferCounters *allTransferCounters;
 	
 	NSMutableDictionary<NSString *, ZDCProgressItem *> * metaDownloadDict;
 	NSMutableDictionary<NSString *, ZDCProgressItem *> * dataDownloadDict;
 	NSMutableDictionary<NSUUID   *, ZDCProgressItem *> * uploadDict;
 	NSMutableDictionary<NSString *, ZDCProgressItem *> * importDict;
 	
+	ZDCProgressIndex<NSString *> *metaDownloadIndex;
+	ZDCProgressIndex<NSString *> *dataDownloadIndex;
+	ZDCProgressIndex<NSUUID   *> *uploadOperationIndex;
+	ZDCProgressIndex<NSString *> *uploadNodeIndex;
+	
 	NSMutableArray<NSString *> *downloadOrder;
 	NSMutableArray<NSString *> *importOrder;
 }
@@ -138,12 +252,22 @@
 		
 		timerQueue = dispatch_queue_create("ZDCProgressManager-Timer", DISPATCH_QUEUE_SERIAL);
 		monitoring = [[NSMutableArray alloc] init];
+		registered = [[NSMutableSet alloc] init];
+		
+		countersLock = YAP_UNFAIR_LOCK_INIT;
+		transferCounters = [[NSMutableDictionary alloc] init];
+		allTransferCounters = [[ZDCTransferCounters alloc] initWithParent:nil];
 		
 		metaDownloadDict = [[NSMutableDictionary alloc] init];
 		dataDownloadDict = [[NSMutableDictionary alloc] init];
 		uploadDict       = [[NSMutableDictionary alloc] init];
 		importDict       = [[NSMutableDictionary alloc] init];
 		
+		metaDownloadIndex    = [[ZDCProgressIndex alloc] init];
+		dataDownloadIndex    = [[ZDCProgressIndex alloc] init];
+		uploadOperationIndex = [[ZDCProgressIndex alloc] init];
+		uploadNodeIndex      = [[ZDCProgressIndex alloc] init];
+		
 		downloadOrder = [[NSMutableArray alloc] init];
 		importOrder   = [[NSMutableArray alloc] init];
 	}
@@ -175,6 +299,49 @@
 #pragma mark Monitoring
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Calculating the throughput (& estimated time remaining) of a progress requires periodic sampling.
+ * Which is a waste of time if nobody is looking at the progress.
+ *
+ * So we only register the progress when it's added,
+ * and start monitoring it when it's handed out to somebody (e.g. via `dataDownloadProgressForNodeID:`).
+ */
+- (void)registerProgress:(NSProgress *)progress
+{
+	if (progress == nil) return;
+	NSAssert(dispatch_get_specific(IsOnQueueKey), @"Invoked on incorrect queue");
+	
+	[registered addObject:progress];
+}
+
+- (void)unregisterProgress:(NSProgress *)progress
+{
+	if (progress == nil) return;
+	NSAssert(dispatch_get_specific(IsOnQueueKey), @"Invoked on incorrect queue");
+	
+	[registered removeObject:progress];
+	[self stopMonitoringProgress:progress];
+}
+
+/**
+ * See ZDCProgressManagerPrivate.h
+ */
+- (void)monitorThroughputForProgress:(NSProgress *)progress
+{
+	if (progress == nil) return;
+	
+	dispatch_async(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		if ([registered containsObject:progress]) {
+			[self startMonitoringProgress:progress];
+		}
+		
+	#pragma clang diagnostic pop
+	}});
+}
+
 - (void)startMonitoringProgress:(NSProgress *)progress
 {
 	if (progress == nil) return;
@@ -417,47 +584,21 @@
  */
 - (NSSet<NSString *> *)allDownloadingNodeIDs
 {
-	__block NSSet<NSString *> *nodeIDs = nil;
+	__block NSSet<NSString *> *result = nil;
 	
 	dispatch_sync(queue, ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		NSMutableSet<NSString *> *_nodeIDs = nil;
-		
-		NSArray<NSString*> *metaKeys = [metaDownloadDict allKeys];
-		if (metaKeys.count > 0)
-		{
-			_nodeIDs = [NSMutableSet setWithCapacity:metaKeys.count];
-			
-			for (NSString *metaKey in metaKeys)
-			{
-				NSString *nodeID = nil;
-				[self getNodeID:&nodeID components:NULL fromMetaKey:metaKey];
-				
-				[_nodeIDs addObject:nodeID];
-			}
-		}
-		
-		NSArray<NSString *> *dataKeys = [dataDownloadDict allKeys];
-		if (dataKeys.count > 0)
-		{
-			if (_nodeIDs) {
-				[_nodeIDs addObjectsFromArray:dataKeys];
-			}
-			else {
-				nodeIDs = [NSSet setWithArray:dataKeys];
-			}
-		}
+		NSMutableSet<NSString *> *nodeIDs = [metaDownloadIndex allObjects];
+		[nodeIDs unionSet:[dataDownloadIndex allObjects]];
 		
-		if (_nodeIDs) {
-			nodeIDs = _nodeIDs;
-		}
+		result = nodeIDs;
 		
 	#pragma clang diagnostic pop
 	}});
 	
-	return nodeIDs ?: [NSSet set];
+	return result;
 }
 
 /**
@@ -467,45 +608,21 @@
  */
 - (NSSet<NSString *> *)allDownloadingNodeIDs:(NSString *)localUserID
 {
-	__block NSMutableSet<NSString *> *nodeIDs = nil;
+	__block NSSet<NSString *> *result = nil;
 	
 	dispatch_sync(queue, ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		[metaDownloadDict enumerateKeysAndObjectsUsingBlock:
-		  ^(NSString *metaKey, ZDCProgressItem *item, BOOL *stop)
-		{
-			if ([localUserID isEqualToString:item.localUserID])
-			{
-				if (nodeIDs == nil) {
-					nodeIDs = [NSMutableSet set];
-				}
-				
-				NSString *nodeID = nil;
-				[self getNodeID:&nodeID components:nil fromMetaKey:metaKey];
-				
-				[nodeIDs addObject:nodeID];
-			}
-		}];
+		NSMutableSet<NSString *> *nodeIDs = [metaDownloadIndex objectsForLocalUserID:localUserID];
+		[nodeIDs unionSet:[dataDownloadIndex objectsForLocalUserID:localUserID]];
 		
-		[dataDownloadDict enumerateKeysAndObjectsUsingBlock:
-		  ^(NSString *nodeID, ZDCProgressItem *item, BOOL *stop)
-		{
-			if ([localUserID isEqualToString:item.localUserID])
-			{
-				if (nodeIDs == nil) {
-					nodeIDs = [NSMutableSet set];
-				}
-				
-				[nodeIDs addObject:nodeID];
-			}
-		}];
+		result = nodeIDs;
 		
 	#pragma clang diagnostic pop
 	}});
 	
-	return nodeIDs ?: [NSSet set];
+	return result;
 }
 
 /**
@@ -525,6 +642,7 @@
 		ZDCProgressItem *item = dataDownloadDict[nodeID];
 		if (item) {
 			progress = item.progress;
+			[self startMonitoringProgress:progress];
 			return; // from block
 		}
 		
@@ -534,6 +652,7 @@
 			item = metaDownloadDict[metaKey];
 			if (item) {
 				progress = item.progress;
+				[self startMonitoringProgress:progress];
 				return; // from block
 			}
 		}
@@ -593,30 +712,18 @@
  */
 - (NSSet<NSString *> *)allMetaDownloadingNodeIDs
 {
-	__block NSMutableSet<NSString *> *nodeIDs = nil;
+	__block NSSet<NSString *> *result = nil;
 	
 	dispatch_sync(queue, ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		NSArray<NSString*> *metaKeys = [metaDownloadDict allKeys];
-		if (metaKeys.count > 0)
-		{
-			nodeIDs = [NSMutableSet setWithCapacity:metaKeys.count];
-			
-			for (NSString *metaKey in metaKeys)
-			{
-				NSString *nodeID = nil;
-				[self getNodeID:&nodeID components:NULL fromMetaKey:metaKey];
-				
-				[nodeIDs addObject:nodeID];
-			}
-		}
+		result = [metaDownloadIndex allObjects];
 		
 	#pragma clang diagnostic pop
 	}});
 	
-	return nodeIDs ?: [NSSet set];
+	return result;
 }
 
 /**
@@ -626,32 +733,18 @@
  */
 - (NSSet<NSString *> *)allMetaDownloadingNodeIDs:(NSString *)localUserID
 {
-	__block NSMutableSet<NSString *> *nodeIDs = nil;
+	__block NSSet<NSString *> *result = nil;
 	
 	dispatch_sync(queue, ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		[metaDownloadDict enumerateKeysAndObjectsUsingBlock:
-		  ^(NSString *metaKey, ZDCProgressItem *item, BOOL *stop)
-		{
-			if ([localUserID isEqualToString:item.localUserID])
-			{
-				if (nodeIDs == nil) {
-					nodeIDs = [NSMutableSet set];
-				}
-				
-				NSString *nodeID = nil;
-				[self getNodeID:&nodeID components:nil fromMetaKey:metaKey];
-				
-				[nodeIDs addObject:nodeID];
-			}
-		}];
+		result = [metaDownloadIndex objectsForLocalUserID:localUserID];
 		
 	#pragma clang diagnostic pop
 	}});
 	
-	return nodeIDs ?: [NSSet set];
+	return result;
 }
 
 /**
@@ -725,6 +818,7 @@
 			if (item)
 			{
 				progress = item.progress;
+				[self startMonitoringProgress:progress];
 		
 				if (completionBlock)
 				{
@@ -859,9 +953,10 @@
 					}
 				}
 			}
-			[self startMonitoringProgress:progress];
+			[self registerProgress:progress];
 			
 			metaDownloadDict[metaKey] = item;
+			[metaDownloadIndex addObject:nodeID localUserID:localUserID];
 			shouldPostNotification = YES;
 		}
 		
@@ -972,9 +1067,10 @@
 			completionQueues = item.completionQueues;
 			completionBlocks = item.completionBlocks;
 			
-			[self stopMonitoringProgress:item.progress];
+			[self unregisterProgress:item.progress];
 			
 			metaDownloadDict[metaKey] = nil;
+			[metaDownloadIndex removeObject:nodeID localUserID:localUserID];
 			shouldPostNotification = YES;
 		}
 		
@@ -1016,22 +1112,18 @@
  */
 - (NSSet<NSString *> *)allDataDownloadingNodeIDs
 {
-	__block NSSet<NSString *> *nodeIDs = nil;
+	__block NSSet<NSString *> *result = nil;
 	
 	dispatch_sync(queue, ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		NSArray<NSString *> *dataKeys = [dataDownloadDict allKeys];
-		if (dataKeys.count > 0)
-		{
-			nodeIDs = [NSSet setWithArray:dataKeys];
-		}
+		result = [dataDownloadIndex allObjects];
 		
 	#pragma clang diagnostic pop
 	}});
 	
-	return nodeIDs ?: [NSSet set];
+	return result;
 }
 
 /**
@@ -1041,29 +1133,18 @@
  */
 - (NSSet<NSString *> *)allDataDownloadingNodeIDs:(NSString *)localUserID
 {
-	__block NSMutableSet<NSString *> *nodeIDs = nil;
+	__block NSSet<NSString *> *result = nil;
 	
 	dispatch_sync(queue, ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		[dataDownloadDict enumerateKeysAndObjectsUsingBlock:
-		  ^(NSString *nodeID, ZDCProgressItem *item, BOOL *stop)
-		{
-			if ([localUserID isEqualToString:item.localUserID])
-			{
-				if (nodeIDs == nil) {
-					nodeIDs = [NSMutableSet set];
-				}
-				
-				[nodeIDs addObject:nodeID];
-			}
-		}];
+		result = [dataDownloadIndex objectsForLocalUserID:localUserID];
 		
 	#pragma clang diagnostic pop
 	}});
 	
-	return nodeIDs ?: [NSSet set];
+	return result;
 }
 
 /**
@@ -1096,6 +1177,7 @@
 		if (item)
 		{
 			progress = item.progress;
+			[self startMonitoringProgress:progress];
 	
 			if (completionBlock)
 			{
@@ -1201,9 +1283,10 @@
 					}
 				}
 			}
-			[self startMonitoringProgress:progress];
+			[self registerProgress:progress];
 			
 			dataDownloadDict[nodeID] = item;
+			[dataDownloadIndex addObject:nodeID localUserID:localUserID];
 			shouldPostNotification = YES;
 		}
 		
@@ -1302,9 +1385,10 @@
 			completionQueues = item.completionQueues;
 			completionBlocks = item.completionBlocks;
 			
-			[self stopMonitoringProgress:item.progress];
+			[self unregisterProgress:item.progress];
 			
 			dataDownloadDict[nodeID] = nil;
+			[dataDownloadIndex removeObject:nodeID localUserID:localUserID];
 			shouldPostNotification = YES;
 		}
 		
@@ -1345,18 +1429,18 @@
  */
 - (NSSet<NSUUID *> *)allUploadingOperationUUIDs
 {
-	__block NSSet<NSUUID *> *operationUUIDs = nil;
+	__block NSSet<NSUUID *> *result = nil;
 	
 	dispatch_sync(queue, ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		operationUUIDs = [NSSet setWithArray:[uploadDict allKeys]];
+		result = [uploadOperationIndex allObjects];
 		
 	#pragma clang diagnostic pop
 	}});
 	
-	return operationUUIDs ?: [NSSet set];
+	return result;
 }
 
 /**
@@ -1366,28 +1450,18 @@
  */
 - (NSSet<NSUUID *> *)allUploadingOperationUUIDs:(NSString *)localUserID
 {
-	__block NSMutableSet<NSUUID *> *operationUUIDs = nil;
+	__block NSSet<NSUUID *> *result = nil;
 	
 	dispatch_sync(queue, ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		[uploadDict enumerateKeysAndObjectsUsingBlock:
-		  ^(NSUUID *operationUUID, ZDCProgressItem *item, BOOL *stop)
-		{
-			if ([localUserID isEqualToString:item.localUserID])
-			{
-				if (operationUUIDs == nil)
-					operationUUIDs = [NSMutableSet set];
-				
-				[operationUUIDs addObject:operationUUID];
-			}
-		}];
+		result = [uploadOperationIndex objectsForLocalUserID:localUserID];
 		
 	#pragma clang diagnostic pop
 	}});
 	
-	return operationUUIDs ?: [NSSet set];
+	return result;
 }
 
 /**
@@ -1397,27 +1471,18 @@
  */
 - (NSSet<NSString *> *)allUploadingNodeIDs
 {
-	__block NSMutableSet<NSString *> *nodeIDs = nil;
+	__block NSSet<NSString *> *result = nil;
 	
 	dispatch_sync(queue, ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		nodeIDs = [NSMutableSet set];
-		
-		[uploadDict enumerateKeysAndObjectsUsingBlock:
-		  ^(NSUUID *operationUUID, ZDCProgressItem *item, BOOL *stop)
-		{
-			if (item.nodeID != nil) // might be nil for "delete-node:if-orphan" operations
-			{
-				[nodeIDs addObject:item.nodeID];
-			}
-		}];
+		result = [uploadNodeIndex allObjects];
 		
 	#pragma clang diagnostic pop
 	}});
 	
-	return nodeIDs ?: [NSSet set];
+	return result;
 }
 
 /**
@@ -1425,29 +1490,18 @@
 **/
 - (NSSet<NSString *> *)allUploadingNodeIDs:(NSString *)localUserID
 {
-	__block NSMutableSet<NSString *> *nodeIDs = nil;
+	__block NSSet<NSString *> *result = nil;
 	
 	dispatch_sync(queue, ^{ @autoreleasepool {
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
 		
-		[uploadDict enumerateKeysAndObjectsUsingBlock:
-		  ^(NSUUID *operationUUID, ZDCProgressItem *item, BOOL *stop)
-		{
-			if ([localUserID isEqualToString:item.localUserID] &&
-			    item.nodeID != nil) // might be nil for "delete-node:if-orphan" operations
-			{
-				if (nodeIDs == nil)
-					nodeIDs = [NSMutableSet set];
-				
-				[nodeIDs addObject:item.nodeID];
-			}
-		}];
+		result = [uploadNodeIndex objectsForLocalUserID:localUserID];
 		
 	#pragma clang diagnostic pop
 	}});
 	
-	return nodeIDs;
+	return result;
 }
 
 /**
@@ -1481,6 +1535,7 @@
 		if (item)
 		{
 			progress = item.progress;
+			[self startMonitoringProgress:progress];
 			
 			if (completionBlock)
 			{
@@ -1542,6 +1597,7 @@
 		if (matchingItem)
 		{
 			progress = matchingItem.progress;
+			[self startMonitoringProgress:progress];
 			
 			if (completionBlock)
 			{
@@ -1607,9 +1663,11 @@
 			//		}
 			//	}
 			}
-			[self startMonitoringProgress:progress];
+			[self registerProgress:progress];
 			
 			uploadDict[operation.uuid] = item;
+			[uploadOperationIndex addObject:operation.uuid localUserID:item.localUserID];
+			[uploadNodeIndex addObject:item.nodeID localUserID:item.localUserID]; // nodeID may be nil
 			shouldPostNotification = YES;
 		}
 		
@@ -1660,9 +1718,11 @@
 			completionQueues = item.completionQueues;
 			completionBlocks = item.completionBlocks;
 			
-			[self stopMonitoringProgress:item.progress];
+			[self unregisterProgress:item.progress];
 			
 			uploadDict[operationUUID] = nil;
+			[uploadOperationIndex removeObject:operationUUID localUserID:localUserID];
+			[uploadNodeIndex removeObject:nodeID localUserID:localUserID];
 			shouldPostNotification = YES;
 		}
 		
@@ -1694,6 +1754,113 @@
 	}
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Transfer Statistics
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * See ZDCProgressManagerPrivate.h
+ */
+- (ZDCTransferCounters *)transferCountersForLocalUserID:(NSString *)localUserID
+{
+	if (localUserID == nil) return allTransferCounters;
+	
+	ZDCTransferCounters *counters = nil;
+	
+	YAPUnfairLockLock(&countersLock);
+	{
+		counters = transferCounters[localUserID];
+		if (counters == nil)
+		{
+			counters = [[ZDCTransferCounters alloc] initWithParent:allTransferCounters];
+			transferCounters[localUserID] = counters;
+		}
+	}
+	YAPUnfairLockUnlock(&countersLock);
+	
+	return counters;
+}
+
+/**
+ * See header file for description.
+ * Or view the api's online (for both Swift & Objective-C):
+ * https://apis.zerodark.cloud/Classes/ZDCProgressManager.html
+ */
+- (ZDCTransferStatistics *)transferStatisticsForLocalUserID:(nullable NSString *)localUserID
+{
+	ZDCTransferCounters *counters = [self transferCountersForLocalUserID:localUserID];
+	
+	double uploadThroughput = 0;
+	double downloadThroughput = 0;
+	[counters sampleUploadThroughput:&uploadThroughput downloadThroughput:&downloadThroughput];
+	
+	__block uint64_t uploadBytesRemaining = 0;
+	__block uint64_t downloadBytesRemaining = 0;
+	
+	dispatch_sync(queue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wimplicit-retain-self"
+		
+		uint64_t (^remaining)(ZDCProgressItem*) = ^uint64_t (ZDCProgressItem *item){
+			
+			if (localUserID && ![item.localUserID isEqualToString:localUserID]) {
+				return 0;
+			}
+			
+			int64_t total = item.progress.totalUnitCount;
+			int64_t completed = item.progress.completedUnitCount;
+			
+			return (total > completed && completed >= 0) ? (uint64_t)(total - completed) : 0;
+		};
+		
+		for (ZDCProgressItem *item in [metaDownloadDict objectEnumerator]) {
+			downloadBytesRemaining += remaining(item);
+		}
+		for (ZDCProgressItem *item in [dataDownloadDict objectEnumerator]) {
+			downloadBytesRemaining += remaining(item);
+		}
+		for (ZDCProgressItem *item in [uploadDict objectEnumerator]) {
+			uploadBytesRemaining += remaining(item);
+		}
+		
+	#pragma clang diagnostic pop
+	}});
+	
+	ZDCTransferStatistics *stats = [[ZDCTransferStatistics alloc] init];
+	stats.bytesSent = counters.bytesSent;
+	stats.bytesReceived = counters.bytesReceived;
+	stats.uploadThroughput = uploadThroughput;
+	stats.downloadThroughput = downloadThroughput;
+	stats.bytesRemaining = uploadBytesRemaining + downloadBytesRemaining;
+	
+	// Uploads & downloads run in parallel, so the estimate is whichever direction finishes last.
+	
+	NSTimeInterval uploadTime = 0;
+	NSTimeInterval downloadTime = 0;
+	BOOL valid = (stats.bytesRemaining > 0);
+	
+	if (uploadBytesRemaining > 0)
+	{
+		if (uploadThroughput > 0)
+			uploadTime = (double)uploadBytesRemaining / uploadThroughput;
+		else
+			valid = NO;
+	}
+	if (downloadBytesRemaining > 0)
+	{
+		if (downloadThroughput > 0)
+			downloadTime = (double)downloadBytesRemaining / downloadThroughput;
+		else
+			valid = NO;
+	}
+	
+	if (valid) {
+		stats.estimatedTimeRemaining = @(MAX(uploadTime, downloadTime));
+	}
+	
+	return stats;
+}
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1710,3 +1877,18 @@
 @synthesize isDataUpload;
 
 @end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation ZDCTransferStatistics
+
+@synthesize bytesSent;
+@synthesize bytesReceived;
+@synthesize uploadThroughput;
+@synthesize downloadThroughput;
+@synthesize bytesRemaining;
+@synthesize estimatedTimeRemaining;
+
+@end
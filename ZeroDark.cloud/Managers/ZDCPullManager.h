@@ -95,4 +95,20 @@ typedef NS_ENUM(NSInteger, ZDCPullResult) {
  */
 - (void)abortPullForLocalUserID:(NSString *)localUserID treeID:(NSString *)treeID;
 
+/**
+ * Whether RCRD files should be fetched in batches via the server's fetch-proxy.
+ *
+ * RCRD files are tiny, so when pulling a large tree of small nodes,
+ * the per-request overhead of fetching each one directly from S3 dominates.
+ * The fetch-proxy allows many of them to be fetched in a single request.
+ *
+ * The fetch-proxy requires server-side support, which isn't available on all deployments.
+ * If the server doesn't support it, the framework falls back to fetching RCRD files directly.
+ * But until it has detected this, every RCRD fetch pays for the extra roundtrip.
+ * So only enable this if you know your server deployment includes the fetch-proxy.
+ *
+ * The default value is NO.
+ */
+@property (atomic, assign, readwrite) BOOL useFetchProxy;
+
 @end
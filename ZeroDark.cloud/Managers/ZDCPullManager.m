@@ -21,11 +21,13 @@
 #import "ZDCLogging.h"
 #import "ZDCNodePrivate.h"
 #import "ZDCChangeList.h"
+#import "ZDCPullCheckpoint.h"
 #import "ZDCPullItem.h"
 #import "ZDCPullStateManager.h"
 #import "ZDCPullTaskCompletion.h"
 #import "ZDCPullTaskResult.h"
 #import "ZDCPushManagerPrivate.h"
+#import "ZDCProxyFetch.h"
 #import "ZDCProxyList.h"
 #import "ZDCRestManager.h"
 #import "ZDCSyncManagerPrivate.h"
@@ -59,6 +61,11 @@
 
 static NSUInteger const kMaxFailCount = 8;
 
+/**
+ * During a quick pull, this is the maximum number of independent changes we'll process concurrently.
+ */
+static NSUInteger const kMaxConcurrentChanges = 4;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark -
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -69,10 +76,14 @@ static NSUInteger const kMaxFailCount = 8;
 	__weak ZeroDarkCloud *zdc;
 	
 	dispatch_queue_t concurrentQueue;
+	dispatch_queue_t changeQueue;
 	
 	ZDCPullStateManager *pullStateManager;
+	ZDCProxyFetch *proxyFetch;
 }
 
+@synthesize useFetchProxy = useFetchProxy;
+
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wimplicit-retain-self"
 
@@ -88,7 +99,9 @@ static NSUInteger const kMaxFailCount = 8;
 		zdc = owner;
 		
 		concurrentQueue = dispatch_queue_create("ZDCPullManager.concurrent", DISPATCH_QUEUE_CONCURRENT);
+		changeQueue = dispatch_queue_create("ZDCPullManager.change", DISPATCH_QUEUE_SERIAL);
 		pullStateManager = [[ZDCPullStateManager alloc] init];
+		proxyFetch = [[ZDCProxyFetch alloc] initWithOwner:owner];
 	}
 	return self;
 }
@@ -345,6 +358,16 @@ static NSUInteger const kMaxFailCount = 8;
 	ZDCPullTaskCompletion finalCompletionBlock =
 	^(YapDatabaseReadWriteTransaction *transaction, ZDCPullTaskResult *result) { @autoreleasepool {
 		
+		// During a quick pull, multiple changes are processed concurrently.
+		// So several may fail at (nearly) the same time, and each will invoke this block.
+		// The pull must only be stopped once.
+		
+		if (![pullState isFirstFinalCompletion])
+		{
+			ZDCLogTrace(@"[%@] FinishPull (ignored - already finished): %@", pullState.localUserID, result);
+			return;
+		}
+		
 		ZDCLogTrace(@"[%@] FinishPull: %@", pullState.localUserID, result);
 		
 		NSAssert(result != nil, @"Bad parameter for block: ZDCPullTaskResult");
@@ -367,6 +390,12 @@ static NSUInteger const kMaxFailCount = 8;
 				          inCollection: kZDCCollection_PullState];
 			}
 			
+			if (pullState.isFullPull)
+			{
+				// The full pull is complete, so the stored progress is no longer needed.
+				[self removeFullPullCheckpointForLocalUserID:pullState.localUserID transaction:transaction];
+			}
+			
 			[self processMissingItems:pullState transaction:transaction];
 			[self fetchUnknownUsers:pullState];
 			
@@ -447,9 +476,16 @@ static NSUInteger const kMaxFailCount = 8;
 	{
 		// We can do a "quick pull".
 		
+		NSUInteger inFlightCount = pullState.inFlightChangeCount;
+		
 		if (![pullInfo hasPendingChange])
 		{
-			if (pullState.hasProcessedChanges && !pullState.needsFetchMoreChanges)
+			if (inFlightCount > 0)
+			{
+				// Other changes are still being processed.
+				// Whichever finishes last will continue the pull.
+			}
+			else if (pullState.hasProcessedChanges && !pullState.needsFetchMoreChanges)
 			{
 				// We're done !
 				//
@@ -475,22 +511,55 @@ static NSUInteger const kMaxFailCount = 8;
 				        finalCompletion: finalCompletionBlock];
 			}
 		}
-		else
+		else if (inFlightCount < kMaxConcurrentChanges)
 		{
-			// Process next item in pendingChanges.
+			// Process the next batch of independent items in pendingChanges.
 			//
-			// When this method completes:
+			// If every pending change depends on a change that's currently in-flight,
+			// then the batch will be empty, and we simply wait for the in-flight changes to complete.
+			//
+			// When each change completes:
 			// - it will invoke continuePull again
 			
-			pullState.hasProcessedChanges = YES;
+			NSUInteger maxCount = kMaxConcurrentChanges - inFlightCount;
 			
-			NSOrderedSet<NSString *> *changeIDs = nil;
-			ZDCChangeItem *change = [pullInfo popNextPendingChange:&changeIDs];
+			NSArray<NSOrderedSet<NSString *> *> *batchChangeIDs = nil;
+			NSArray<ZDCChangeItem *> *batch =
+			  [pullInfo popIndependentPendingChanges: maxCount
+			                       inFlightChangeIDs: pullState.inFlightChangeIDs
+			                               changeIDs: &batchChangeIDs];
 			
-			[self processPendingChange: change
-			                 changeIDs: changeIDs
-			                 pullState: pullState
-			           finalCompletion: finalCompletionBlock];
+			if (batch.count > 0) {
+				pullState.hasProcessedChanges = YES;
+			}
+			
+			ZDCPullTaskCompletion changeFinalCompletionBlock =
+			^(YapDatabaseReadWriteTransaction *transaction, ZDCPullTaskResult *result) {
+				
+				// Multiple changes may be in-flight.
+				// Once the pull has been stopped (or aborted), the remaining changes are ignored.
+				// (The finalCompletionBlock itself guarantees it's only executed once.)
+				
+				if (![self->pullStateManager isPullCancelled:pullState]) {
+					finalCompletionBlock(transaction, result);
+				}
+			};
+			
+			// Mark the entire batch as in-flight before we start processing any of it.
+			// Otherwise a fast completion could hand out the same change twice.
+			
+			for (NSOrderedSet<NSString *> *changeIDs in batchChangeIDs)
+			{
+				[pullState addInFlightChangeIDs:changeIDs];
+			}
+			
+			[batch enumerateObjectsUsingBlock:^(ZDCChangeItem *change, NSUInteger idx, BOOL *stop) {
+				
+				[self processPendingChange: change
+				                 changeIDs: batchChangeIDs[idx]
+				                 pullState: pullState
+				           finalCompletion: changeFinalCompletionBlock];
+			}];
 		}
 	}
 	else
@@ -1017,23 +1086,10 @@ static NSUInteger const kMaxFailCount = 8;
 			return;
 		}
 		
-		ZDCChangeList *pullInfo =
-		  [transaction objectForKey: pullState.localUserID
-		               inCollection: kZDCCollection_PullState];
-		
-		pullInfo = [pullInfo copy];
-		[pullInfo didProcessChangeIDs:[changeIDs set]];
-		
-		[transaction setObject: pullInfo
-		                forKey: pullState.localUserID
-		          inCollection: kZDCCollection_PullState];
-		
-		[transaction addCompletionQueue:concurrentQueue completionBlock:^{
-			
-			[self continuePullWithPullInfo: pullInfo
-			                     pullState: pullState
-			               finalCompletion: finalCompletionBlock];
-		}];
+		[self didProcessChangeIDs: changeIDs
+		                pullState: pullState
+		              transaction: transaction
+		          finalCompletion: finalCompletionBlock];
 	}};
 	
 	[[self rwConnection] asyncReadWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
@@ -1301,23 +1357,10 @@ static NSUInteger const kMaxFailCount = 8;
 				return;
 			}
 	
-			ZDCChangeList *pullInfo =
-			  [transaction objectForKey: pullState.localUserID
-			               inCollection: kZDCCollection_PullState];
-	
-			pullInfo = [pullInfo copy];
-			[pullInfo didProcessChangeIDs:[changeIDs set]];
-	
-			[transaction setObject: pullInfo
-								 forKey: pullState.localUserID
-						 inCollection: kZDCCollection_PullState];
-	
-			[transaction addCompletionQueue:concurrentQueue completionBlock:^{
-	
-				[self continuePullWithPullInfo: pullInfo
-				                     pullState: pullState
-				               finalCompletion: finalCompletionBlock];
-			}];
+			[self didProcessChangeIDs: changeIDs
+			                pullState: pullState
+			              transaction: transaction
+			          finalCompletion: finalCompletionBlock];
 		};
 		
 		multiCompletion =
@@ -1640,23 +1683,10 @@ static NSUInteger const kMaxFailCount = 8;
 			return;
 		}
 		
-		ZDCChangeList *pullInfo =
-		  [transaction objectForKey: pullState.localUserID
-		               inCollection: kZDCCollection_PullState];
-		
-		pullInfo = [pullInfo copy];
-		[pullInfo didProcessChangeIDs:[changeIDs set]];
-		
-		[transaction setObject: pullInfo
-		                forKey: pullState.localUserID
-		          inCollection: kZDCCollection_PullState];
-		
-		[transaction addCompletionQueue:concurrentQueue completionBlock:^{
-		
-			[self continuePullWithPullInfo: pullInfo
-			                     pullState: pullState
-			               finalCompletion: finalCompletionBlock];
-		}];
+		[self didProcessChangeIDs: changeIDs
+		                pullState: pullState
+		              transaction: transaction
+		          finalCompletion: finalCompletionBlock];
 	}};
 	
 	[[self rwConnection] asyncReadWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
@@ -1928,23 +1958,10 @@ static NSUInteger const kMaxFailCount = 8;
 		
 		// Done !
 		
-		ZDCChangeList *pullInfo =
-		  [transaction objectForKey: pullState.localUserID
-		               inCollection: kZDCCollection_PullState];
-		
-		pullInfo = [pullInfo copy];
-		[pullInfo didProcessChangeIDs:[changeIDs set]];
-		
-		[transaction setObject: pullInfo
-		                forKey: pullState.localUserID
-		          inCollection: kZDCCollection_PullState];
-		
-		[transaction addCompletionQueue:concurrentQueue completionBlock:^{
-		
-			[self continuePullWithPullInfo: pullInfo
-			                     pullState: pullState
-			               finalCompletion: finalCompletionBlock];
-		}];
+		[self didProcessChangeIDs: changeIDs
+		                pullState: pullState
+		              transaction: transaction
+		          finalCompletion: finalCompletionBlock];
 	}];
 }
 
@@ -2042,24 +2059,65 @@ static NSUInteger const kMaxFailCount = 8;
           finalCompletion:(ZDCPullTaskCompletion)finalCompletionBlock
     transactionCompletion:(dispatch_block_t)transactionCompletionBlock
 {
-	NSString *const localUserID = pullState.localUserID;
-	
-	__block ZDCChangeList *pullInfo = nil;
-	
 	[[self rwConnection] asyncReadWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
 		
-		pullInfo = [transaction objectForKey:localUserID inCollection:kZDCCollection_PullState];
-		
-		pullInfo = [pullInfo copy];
-		[pullInfo didProcessChangeIDs:[changeIDs set]];
-		
-		[transaction setObject:pullInfo forKey:localUserID inCollection:kZDCCollection_PullState];
-		
 		if (transactionCompletionBlock){
 			[transaction addCompletionQueue:concurrentQueue completionBlock:transactionCompletionBlock];
 		}
 		
-	} completionQueue:concurrentQueue completionBlock:^{
+		[self didProcessChangeIDs: changeIDs
+		                pullState: pullState
+		              transaction: transaction
+		          finalCompletion: finalCompletionBlock];
+	}];
+}
+
+/**
+ * Marks the given changeIDs as processed, and continues the pull once the transaction completes.
+ *
+ * Multiple changes may be processed concurrently during a quick pull.
+ * So the continuation is invoked on a serial queue, in commit order.
+ * This ensures every continuation sees a ZDCChangeList that's at least as recent as the in-flight list.
+ *
+ * @param finalCompletionBlock
+ *   The block to invoke after the entire sync process is complete.
+**/
+- (void)didProcessChangeIDs:(NSOrderedSet<NSString *> *)changeIDs
+                  pullState:(ZDCPullState *)pullState
+                transaction:(YapDatabaseReadWriteTransaction *)transaction
+            finalCompletion:(ZDCPullTaskCompletion)finalCompletionBlock
+{
+	ZDCChangeList *pullInfo =
+	  [transaction objectForKey: pullState.localUserID
+	               inCollection: kZDCCollection_PullState];
+	
+	if (pullInfo.latestChangeID_local == nil)
+	{
+		// Another (concurrent) change triggered a fallback to a full pull.
+		// So the quick pull has been abandoned.
+		
+		[transaction addCompletionQueue:changeQueue completionBlock:^{
+			
+			[pullState removeInFlightChangeIDs:changeIDs];
+		}];
+		return;
+	}
+	
+	pullInfo = [pullInfo copy];
+	[pullInfo didProcessChangeIDs:[changeIDs set]];
+	
+	[transaction setObject: pullInfo
+	                forKey: pullState.localUserID
+	          inCollection: kZDCCollection_PullState];
+	
+	[transaction addCompletionQueue:changeQueue completionBlock:^{
+		
+		[pullState removeInFlightChangeIDs:changeIDs];
+		
+		if ([self->pullStateManager isPullCancelled:pullState])
+		{
+			return;
+		}
 		
 		[self continuePullWithPullInfo: pullInfo
 		                     pullState: pullState
@@ -2079,6 +2137,13 @@ static NSUInteger const kMaxFailCount = 8;
                         finalCompletion:(ZDCPullTaskCompletion)finalCompletionBlock
 {
 	NSString *const localUserID = pullState.localUserID;
+	
+	if (![pullState isFirstFallbackToFullPull])
+	{
+		// Another (concurrent) change already triggered the fallback.
+		return;
+	}
+	
 	ZDCLogTrace(@"[%@] FallbackToFullPull", localUserID);
 	
 	[[self rwConnection] asyncReadWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
@@ -2356,10 +2421,14 @@ static NSUInteger const kMaxFailCount = 8;
 	//    This is the list of nodes we know about, and expect to be on the server.
 	//    We need this information to detect if a a node has been deleted.
 	//
-	// 3. Do a full S3 LIST of the entire bucket.
+	// 3. Restore progress from a previous (interrupted) attempt, if possible.
+	//    See ZDCPullCheckpoint.
+	//
+	// 4. Do a full S3 LIST of the entire bucket.
 	//    This is a recursive process, and may require a few requests to get the entire set.
+	//    If we're resuming, this picks up where the previous listing left off.
 	//
-	// 4. Kick off the process to sync each container (in parallel)
+	// 5. Kick off the process to sync each container (in parallel)
 	// 
 	
 	__block NSString *bucket = nil;
@@ -2376,8 +2445,9 @@ static NSUInteger const kMaxFailCount = 8;
 	];
 	
 	NSMutableArray<ZDCTrunkNode *> *trunkNodes = [NSMutableArray arrayWithCapacity:trunkIDs.count];
+	__block ZDCPullCheckpoint *checkpoint = nil;
 	
-	[[self roConnection] asyncReadWithBlock:^(YapDatabaseReadTransaction *transaction) {
+	[[self rwConnection] asyncReadWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
 		
 		// Fetch needed information for the pull
 		
@@ -2412,6 +2482,11 @@ static NSUInteger const kMaxFailCount = 8;
 		
 		[pullState addUnprocessedIdentityIDs:expectedIdentityIDs];
 		
+		// Restore progress from a previous (interrupted) attempt.
+		// This must happen AFTER we've taken the snapshots above.
+		
+		checkpoint = [self prepareFullPullCheckpointWithPullState:pullState transaction:transaction];
+		
 	} completionQueue:concurrentQueue completionBlock:^{
 		
 		ZDCPullTaskMultiCompletion *multiCompletion = nil;
@@ -2454,6 +2529,7 @@ static NSUInteger const kMaxFailCount = 8;
 		          region: region
 		      withPrefix: prefix_root
 		      rootNodeID: localUserID
+		      checkpoint: checkpoint
 		       pullState: pullState
 		      completion:^(ZDCPullTaskResult *result)
 		{
@@ -2491,6 +2567,7 @@ static NSUInteger const kMaxFailCount = 8;
 		          region: region
 		      withPrefix: prefix_avatars
 		      rootNodeID: @"avatars"
+		      checkpoint: checkpoint
 		       pullState: pullState
 		      completion:^(ZDCPullTaskResult *result)
 		{
@@ -2514,16 +2591,36 @@ static NSUInteger const kMaxFailCount = 8;
 	}];
 }
 
+/**
+ * Lists every item in the bucket with the given prefix, and pushes the results into the pullState.
+ *
+ * @param checkpoint
+ *   If non-nil, every page of the listing is stored in the database as it arrives.
+ *   And if the checkpoint indicates that a previous attempt already fetched some (or all) pages,
+ *   then we continue from where that attempt left off.
+ *   (The previously fetched pages were already restored to the pullState.)
+**/
 - (void)listBucket:(NSString *)bucket
             region:(AWSRegion)region
         withPrefix:(NSString *)prefix
         rootNodeID:(NSString *)rootNodeID
+        checkpoint:(ZDCPullCheckpoint *)checkpoint
          pullState:(ZDCPullState *)pullState
         completion:(void(^)(ZDCPullTaskResult *result))completionBlock
 {
 	NSString *const localUserID = pullState.localUserID;
 	ZDCLogTrace(@"[%@] List bucket with prefix: %@", localUserID, prefix);
 	
+	if ([checkpoint isListingCompleteForRootNodeID:rootNodeID])
+	{
+		ZDCLogTrace(@"[%@] List bucket restored from checkpoint: %@", localUserID, prefix);
+		
+		dispatch_async(concurrentQueue, ^{ @autoreleasepool {
+			completionBlock([ZDCPullTaskResult success]);
+		}});
+		return;
+	}
+	
 	__block NSURLSessionDataTask *task = nil;
 	
 	__block void (^processingBlock)(NSURLResponse*, id, NSError *);
@@ -2531,7 +2628,8 @@ static NSUInteger const kMaxFailCount = 8;
 	__block void (^retryRequestBlock)(NSError *);
 	
 	__block NSUInteger failCount = 0;
-	__block NSString *continuationToken = nil;
+	__block NSString *continuationToken = [checkpoint continuationTokenForRootNodeID:rootNodeID];
+	__block NSUInteger pageIndex = [checkpoint pageCountForRootNodeID:rootNodeID];
 	
 	processingBlock = ^(NSURLResponse *urlResponse, id responseObject, NSError *error) { @autoreleasepool {
 		
@@ -2614,6 +2712,16 @@ static NSUInteger const kMaxFailCount = 8;
 		
 		[pullState pushList:s3Response.objectList withRootNodeID:rootNodeID];
 		
+		if (checkpoint)
+		{
+			[self checkpointListPage: s3Response.objectList
+			               pageIndex: pageIndex
+			       continuationToken: s3Response.nextContinuationToken
+			              rootNodeID: rootNodeID
+			               pullState: pullState];
+			pageIndex++;
+		}
+		
 		if (s3Response.nextContinuationToken)
 		{
 			failCount = 0;
@@ -2787,10 +2895,40 @@ static NSUInteger const kMaxFailCount = 8;
 		NSString *prefix = [NSString stringWithFormat:@"%@/%@/", treeID, node.dirPrefix];
 		NSArray<S3ObjectInfo *> *dirList = [pullState popListWithPrefix:prefix rootNodeID:rootNodeID];
 		
+		if (pullState.isFullPull && [self isCompletedDirectoryInFullPullCheckpoint:node pullState:pullState transaction:transaction])
+		{
+			// This directory (and everything beneath it) was already synced by a previous attempt,
+			// which was interrupted before the full pull could complete.
+			// The corresponding nodeIDs were removed from the unprocessed list when we restored the checkpoint.
+			
+			ZDCLogTrace(@"[%@] Sync node skipped (restored from checkpoint): %@",
+			            pullState.localUserID, log_path.fullPath);
+			
+			nodeCompletion(transaction, [ZDCPullTaskResult success]);
+			return;
+		}
+		
 		// Step 2 of 4
 		//
 		// Prep work for processing files & sub-directories.
 	
+		ZDCPullTaskCompletion dirCompletion = nodeCompletion;
+		if (pullState.isFullPull)
+		{
+			// Once the directory (and everything beneath it) has been synced, we record it in the checkpoint.
+			// This way, if the full pull gets interrupted, we won't have to sync it again.
+			
+			dirCompletion = ^(YapDatabaseReadWriteTransaction *transaction, ZDCPullTaskResult *result){
+				
+				if (result.pullResult == ZDCPullResult_Success)
+				{
+					[self checkpointCompletedDirectory:node pullState:pullState transaction:transaction];
+				}
+				
+				nodeCompletion(transaction, result);
+			};
+		}
+		
 		ZDCPullTaskMultiCompletion *multiCompletion = nil;
 		{ // Scoping
 			
@@ -2816,7 +2954,7 @@ static NSUInteger const kMaxFailCount = 8;
 			multiCompletion =
 			  [[ZDCPullTaskMultiCompletion alloc] initWithPendingCount: 1 // Yes, one is correct. See last step.
 			                                       taskCompletionBlock: taskCompletion
-			                                      finalCompletionBlock: nodeCompletion];
+			                                      finalCompletionBlock: dirCompletion];
 		}
 		
 		NSMutableArray<S3ObjectInfo *>* remainingFiles = [dirList mutableCopy];
@@ -2876,6 +3014,19 @@ static NSUInteger const kMaxFailCount = 8;
 		  [[ZDCNodeManager sharedInstance] parentNodeIDsForNode:node transaction:transaction];
 		parents = [parents arrayByAddingObject:node.uuid];
 		
+		// Every item in the dirList is a direct child of this node.
+		// So we can diff the listing against the local nodes in bulk:
+		// a single pass over the children gives us a cloudName => node table,
+		// and each listed item is then compared by eTag without any further lookups.
+		
+		NSString *const dirPrefix = node.dirPrefix;
+		NSDictionary<NSString*, ZDCNode*> *childrenByCloudName = nil;
+		if (dirList.count > 0) {
+			childrenByCloudName = [self childNodesByCloudNameForNode:node transaction:transaction];
+		}
+		
+		NSMutableArray<NSString*> *unchangedNodeIDs = [NSMutableArray arrayWithCapacity:dirList.count];
+		
 		S3ObjectInfo *nodeRcrd = nil;
 		S3ObjectInfo *nodeData = nil;
 	
@@ -2909,13 +3060,19 @@ static NSUInteger const kMaxFailCount = 8;
 			// 2. We have a matching ZDCCloudNode, but not a matching S4Node because we deleted it.
 			//    (i.e. we have a delete-node operation in the queue for the item)
 			
-			ZDCNode *node =
-			  [[ZDCNodeManager sharedInstance] findNodeWithCloudPath: rcrdCloudPath
-			                                                  bucket: bucket
-			                                                  region: region
-			                                             localUserID: pullState.localUserID
-			                                                  treeID: pullState.treeID
-			                                             transaction: transaction];
+			ZDCNode *node = childrenByCloudName[[rcrdCloudPath fileNameWithExt:nil]];
+			
+			if (node == nil && ![rcrdCloudPath.dirPrefix isEqualToString:dirPrefix])
+			{
+				// Defensive: the item isn't a direct child of the directory we're syncing.
+				
+				node = [[ZDCNodeManager sharedInstance] findNodeWithCloudPath: rcrdCloudPath
+				                                                       bucket: bucket
+				                                                       region: region
+				                                                  localUserID: pullState.localUserID
+				                                                       treeID: pullState.treeID
+				                                                  transaction: transaction];
+			}
 			
 			if (node == nil)
 			{
@@ -2970,7 +3127,8 @@ static NSUInteger const kMaxFailCount = 8;
 			else
 			{
 				// Node RCRD is up-to-date.
-				[pullState removeUnprocessedNodeID:node.uuid];
+				// Mark it as processed directly from the listing (no download required).
+				[unchangedNodeIDs addObject:node.uuid];
 				
 				if (nodeData && ![nodeData.eTag isEqualToString:node.eTag_data])
 				{
@@ -3029,6 +3187,8 @@ static NSUInteger const kMaxFailCount = 8;
 	
 		} // end: while ((nodeRcrd = PopFileWithExtension(kZDCCloudFileExtension_Rcrd)))
 		
+		[pullState removeUnprocessedNodeIDs:unchangedNodeIDs];
+		
 		// Step 4 of 4
 		//
 		// The pendingCount was initialized with a value of 1.
@@ -3045,6 +3205,37 @@ static NSUInteger const kMaxFailCount = 8;
 	}];
 }
 
+/**
+ * Returns a table of (cloudName => node) for every direct child of the given directory node.
+ *
+ * During a full pull, the listing already gives us the cloudPath & eTag(s) for every item in a directory.
+ * Building this table once per directory allows us to diff the listing against the local eTags in bulk,
+ * instead of searching for the matching node once per listed item.
+**/
+- (NSDictionary<NSString*, ZDCNode*> *)childNodesByCloudNameForNode:(ZDCNode *)node
+                                                        transaction:(YapDatabaseReadTransaction *)transaction
+{
+	ZDCNodeManager *const nodeManager = [ZDCNodeManager sharedInstance];
+	ZDCCloudPathManager *const cloudPathManager = [ZDCCloudPathManager sharedInstance];
+	
+	// Children of a pointer are stored under the pointee.
+	ZDCNode *parent = [nodeManager targetNodeForNode:node transaction:transaction] ?: node;
+	
+	NSMutableDictionary<NSString*, ZDCNode*> *result = [NSMutableDictionary dictionary];
+	
+	[nodeManager enumerateNodesWithParentID: parent.uuid
+	                            transaction: transaction
+	                             usingBlock:^(ZDCNode *child, BOOL *stop)
+	{
+		NSString *cloudName = [cloudPathManager cloudNameForNode:child transaction:transaction];
+		if (cloudName) {
+			result[cloudName] = child;
+		}
+	}];
+	
+	return result;
+}
+
 /**
  * Called when a RCRD is fetched which encapsulates a pointer to a non-local location.
  * E.g. we encounter a RCRD in Alice's local bucket that points to Bob's bucket.
@@ -3670,6 +3861,226 @@ static NSUInteger const kMaxFailCount = 8;
 	}];
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Full Pull Checkpoint
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Invoked at the start of a full pull (after the unprocessed snapshots have been taken).
+ *
+ * If there's a checkpoint from a previous (interrupted) attempt, anchored to the same change token,
+ * then we restore its progress into the pullState:
+ * - the bucket listing pages that were already fetched are pushed into the pullState
+ * - the nodes within completed directories are removed from the unprocessed list
+ *
+ * Otherwise any stale checkpoint is discarded, and a fresh one is created.
+ *
+ * @return
+ *   The checkpoint to use for the full pull.
+ *   May be nil if we don't know which change token the pull is anchored to.
+**/
+- (ZDCPullCheckpoint *)prepareFullPullCheckpointWithPullState:(ZDCPullState *)pullState
+                                                 transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+	NSString *const localUserID = pullState.localUserID;
+	
+	ZDCChangeList *pullInfo = [transaction objectForKey:localUserID inCollection:kZDCCollection_PullState];
+	NSString *changeToken = pullInfo.latestChangeID_remote;
+	
+	NSString *key = [ZDCPullCheckpoint keyForLocalUserID:localUserID];
+	ZDCPullCheckpoint *checkpoint = [transaction objectForKey:key inCollection:kZDCCollection_PullCheckpoint];
+	
+	if (checkpoint && ![checkpoint.changeToken isEqualToString:changeToken])
+	{
+		// The checkpoint was created for a different full pull (anchored to a different change token).
+		// We can't trust it.
+		
+		[self removeFullPullCheckpointForLocalUserID:localUserID transaction:transaction];
+		checkpoint = nil;
+	}
+	
+	if (checkpoint == nil)
+	{
+		if (changeToken)
+		{
+			checkpoint = [[ZDCPullCheckpoint alloc] initWithChangeToken:changeToken];
+			[transaction setObject:checkpoint forKey:key inCollection:kZDCCollection_PullCheckpoint];
+		}
+		
+		return checkpoint;
+	}
+	
+	ZDCLogTrace(@"[%@] Resuming full pull from checkpoint", localUserID);
+	
+	// Restore the bucket listing
+	
+	for (NSString *rootNodeID in [checkpoint listedRootNodeIDs])
+	{
+		NSUInteger pageCount = [checkpoint pageCountForRootNodeID:rootNodeID];
+		for (NSUInteger pageIndex = 0; pageIndex < pageCount; pageIndex++)
+		{
+			NSString *pageKey =
+			  [ZDCPullCheckpoint listPageKeyForLocalUserID: localUserID
+			                                    rootNodeID: rootNodeID
+			                                     pageIndex: pageIndex];
+			
+			NSArray<S3ObjectInfo *> *page = [transaction objectForKey:pageKey inCollection:kZDCCollection_PullCheckpoint];
+			if (page.count > 0) {
+				[pullState pushList:page withRootNodeID:rootNodeID];
+			}
+		}
+	}
+	
+	// Restore the completed directories.
+	//
+	// The children of a completed directory were processed by the previous attempt,
+	// except for those we stored in the checkpoint, which weren't found in the cloud.
+	// (Those are either deleted, or were moved & will be found in a different directory.)
+	
+	NSString *dirKeyPrefix = [ZDCPullCheckpoint directoryKeyPrefixForLocalUserID:localUserID];
+	NSMutableArray<NSString *> *dirKeys = [NSMutableArray array];
+	
+	[transaction enumerateKeysInCollection: kZDCCollection_PullCheckpoint
+	                            usingBlock:^(NSString *key, BOOL *stop)
+	{
+		if ([key hasPrefix:dirKeyPrefix]) {
+			[dirKeys addObject:key];
+		}
+	}];
+	
+	ZDCNodeManager *nodeManager = [ZDCNodeManager sharedInstance];
+	NSMutableArray<NSString *> *processedNodeIDs = [NSMutableArray array];
+	
+	for (NSString *dirKey in dirKeys)
+	{
+		NSString *dirNodeID = [dirKey substringFromIndex:dirKeyPrefix.length];
+		
+		NSArray<NSString *> *missing = [transaction objectForKey:dirKey inCollection:kZDCCollection_PullCheckpoint];
+		NSSet<NSString *> *missingNodeIDs = [NSSet setWithArray:missing];
+		
+		[nodeManager enumerateNodeIDsWithParentID: dirNodeID
+		                              transaction: transaction
+		                               usingBlock:^(NSString *nodeID, BOOL *stop)
+		{
+			if (![missingNodeIDs containsObject:nodeID]) {
+				[processedNodeIDs addObject:nodeID];
+			}
+		}];
+	}
+	
+	[pullState removeUnprocessedNodeIDs:processedNodeIDs];
+	
+	ZDCLogTrace(@"[%@] Restored %lu completed directories from checkpoint",
+	            localUserID, (unsigned long)dirKeys.count);
+	
+	return checkpoint;
+}
+
+/**
+ * Stores a page of the bucket listing, along with the continuation token for the next page.
+ * Both are written in the same transaction, so the checkpoint is always consistent.
+**/
+- (void)checkpointListPage:(NSArray<S3ObjectInfo *> *)objectList
+                 pageIndex:(NSUInteger)pageIndex
+         continuationToken:(NSString *)continuationToken
+                rootNodeID:(NSString *)rootNodeID
+                 pullState:(ZDCPullState *)pullState
+{
+	NSString *const localUserID = pullState.localUserID;
+	
+	[[self rwConnection] asyncReadWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+		
+		NSString *key = [ZDCPullCheckpoint keyForLocalUserID:localUserID];
+		ZDCPullCheckpoint *checkpoint = [transaction objectForKey:key inCollection:kZDCCollection_PullCheckpoint];
+		
+		if (checkpoint == nil || [checkpoint pageCountForRootNodeID:rootNodeID] != pageIndex)
+		{
+			// The checkpoint was discarded (pull completed, or restarted with a different anchor).
+			// Or this page has already been stored.
+			return;
+		}
+		
+		NSString *pageKey =
+		  [ZDCPullCheckpoint listPageKeyForLocalUserID: localUserID
+		                                    rootNodeID: rootNodeID
+		                                     pageIndex: pageIndex];
+		
+		[transaction setObject: (objectList ?: @[])
+		                forKey: pageKey
+		          inCollection: kZDCCollection_PullCheckpoint];
+		
+		checkpoint = [checkpoint copy];
+		[checkpoint didStoreListPageWithContinuationToken:continuationToken rootNodeID:rootNodeID];
+		
+		[transaction setObject:checkpoint forKey:key inCollection:kZDCCollection_PullCheckpoint];
+	}];
+}
+
+/**
+ * Invoked after a directory (and everything beneath it) has been synced during a full pull.
+**/
+- (void)checkpointCompletedDirectory:(ZDCNode *)node
+                           pullState:(ZDCPullState *)pullState
+                         transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+	NSString *const localUserID = pullState.localUserID;
+	
+	NSString *key = [ZDCPullCheckpoint keyForLocalUserID:localUserID];
+	if (![transaction hasObjectForKey:key inCollection:kZDCCollection_PullCheckpoint])
+	{
+		// The checkpoint was discarded (pull completed, or restarted with a different anchor).
+		return;
+	}
+	
+	// We store the children that we didn't find in the cloud.
+	// This allows us to restore the pullState's unprocessed list correctly when resuming.
+	
+	NSMutableArray<NSString *> *missingNodeIDs = [NSMutableArray array];
+	
+	[[ZDCNodeManager sharedInstance] enumerateNodeIDsWithParentID: node.uuid
+	                                                  transaction: transaction
+	                                                   usingBlock:^(NSString *nodeID, BOOL *stop)
+	{
+		if ([pullState isUnprocessedNodeID:nodeID]) {
+			[missingNodeIDs addObject:nodeID];
+		}
+	}];
+	
+	NSString *dirKey = [ZDCPullCheckpoint directoryKeyForLocalUserID:localUserID nodeID:node.uuid];
+	[transaction setObject:missingNodeIDs forKey:dirKey inCollection:kZDCCollection_PullCheckpoint];
+}
+
+- (BOOL)isCompletedDirectoryInFullPullCheckpoint:(ZDCNode *)node
+                                       pullState:(ZDCPullState *)pullState
+                                     transaction:(YapDatabaseReadTransaction *)transaction
+{
+	NSString *dirKey = [ZDCPullCheckpoint directoryKeyForLocalUserID:pullState.localUserID nodeID:node.uuid];
+	
+	return [transaction hasObjectForKey:dirKey inCollection:kZDCCollection_PullCheckpoint];
+}
+
+/**
+ * See header file for description.
+**/
+- (void)removeFullPullCheckpointForLocalUserID:(NSString *)localUserID
+                                   transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+	NSString *keyPrefix = [ZDCPullCheckpoint keyPrefixForLocalUserID:localUserID];
+	
+	NSMutableArray<NSString *> *keys = [NSMutableArray array];
+	[keys addObject:[ZDCPullCheckpoint keyForLocalUserID:localUserID]];
+	
+	[transaction enumerateKeysInCollection: kZDCCollection_PullCheckpoint
+	                            usingBlock:^(NSString *key, BOOL *stop)
+	{
+		if ([key hasPrefix:keyPrefix]) {
+			[keys addObject:key];
+		}
+	}];
+	
+	[transaction removeObjectsForKeys:keys inCollection:kZDCCollection_PullCheckpoint];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Pull Queue
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -5247,14 +5658,50 @@ static NSUInteger const kMaxFailCount = 8;
 	}};
 	
 	// Perform network request.
+	//
+	// Rcrd files are tiny, so the per-request overhead dominates.
+	// If enabled, we first try to fetch it as part of a batch (via the server's fetch-proxy).
+	// If that doesn't work out, we fall back to a direct S3 GET.
+	
+	void (^fetchDirect)(void) = ^{
+		
+		[self fetchKeyPath: nodeRcrdPath
+		            bucket: bucket
+		            region: region
+		           headers: nil
+		         failCount: 0
+		         pullState: pullState
+		        completion: processingBlock];
+	};
 	
-	[self fetchKeyPath: nodeRcrdPath
-	            bucket: bucket
-	            region: region
-	           headers: nil
-	         failCount: 0
-	         pullState: pullState
-	        completion: processingBlock];
+	if (!self.useFetchProxy)
+	{
+		fetchDirect();
+		return;
+	}
+	
+	[proxyFetch fetchRcrdWithPath: nodeRcrdPath
+	                       bucket: bucket
+	                       region: region
+	                    pullState: pullState
+	              completionQueue: concurrentQueue
+	              completionBlock:^(ZDCProxyFetchItem *item)
+	{
+		if (item)
+		{
+			ZDCPullTaskResult *result = [ZDCPullTaskResult success];
+			result.httpStatusCode = 200;
+			
+			processingBlock(item.data, item.eTag, item.lastModified, result);
+			return;
+		}
+		
+		if ([pullStateManager isPullCancelled:pullState]) {
+			return;
+		}
+		
+		fetchDirect();
+	}];
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -356,6 +356,24 @@ NS_ASSUME_NONNULL_BEGIN
                              forLocalUserID:(NSString *)localUserID
                                    withAuth:(ZDCLocalUserAuth *)auth;
 
+/**
+ * Batch fetch proxy, facilitated by ZeroDark server.
+ *
+ * RCRD files are tiny, so when syncing a large tree of small nodes,
+ * the per-request overhead of individual S3 GET requests dominates.
+ * This request asks the server to fetch many RCRD files (within the same bucket) in a single roundtrip.
+ *
+ * The server only returns files for which the requester has read permission.
+ * Any paths that are missing from the response should be fetched directly from S3.
+ */
+- (NSMutableURLRequest *)fetchProxyWithPaths:(NSArray<NSString *> *)paths
+                                      treeID:(NSString *)treeID
+                                      pullID:(NSString *)pullID
+                                    inBucket:(NSString *)bucket
+                                      region:(AWSRegion)region
+                              forLocalUserID:(NSString *)localUserID
+                                    withAuth:(ZDCLocalUserAuth *)auth;
+
 /**
  * Used during grafting if the target node cannot be located.
  *
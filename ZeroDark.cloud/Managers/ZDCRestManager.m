@@ -1622,6 +1622,69 @@
 	return request;
 }
 
+/**
+ * See header file for description.
+ * Or view the api's online (for both Swift & Objective-C):
+ * https://apis.zerodark.cloud/Classes/ZDCRestManager.html
+ */
+- (NSMutableURLRequest *)fetchProxyWithPaths:(NSArray<NSString *> *)paths
+                                      treeID:(NSString *)treeID
+                                      pullID:(NSString *)pullID
+                                    inBucket:(NSString *)bucket
+                                      region:(AWSRegion)region
+                              forLocalUserID:(NSString *)localUserID
+                                    withAuth:(ZDCLocalUserAuth *)auth
+{
+	__block ZDCLocalUser *localUser = nil;
+	[zdc.databaseManager.roDatabaseConnection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+		
+		ZDCUser *user = [transaction objectForKey:localUserID inCollection:kZDCCollection_Users];
+		if ([user isKindOfClass:[ZDCLocalUser class]]) {
+			localUser = (ZDCLocalUser *)user;
+		}
+	}];
+	
+	NSString *stage = localUser.aws_stage;
+	if (!stage)
+	{
+		stage = DEFAULT_AWS_STAGE;
+	}
+	
+	NSString *path = @"/fetchProxy";
+	
+	NSURLComponents *urlComponents = [self apiGatewayForRegion:region stage:stage path:path];
+	
+	NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:[urlComponents URL]];
+	request.HTTPMethod = @"POST";
+	
+	NSMutableDictionary *jsonDict = [NSMutableDictionary dictionaryWithCapacity:4];
+	
+	jsonDict[@"file_paths"] = paths;
+	jsonDict[@"app_prefix"] = treeID;
+	jsonDict[@"device_key"] = pullID;
+	jsonDict[@"bucket"]     = bucket;
+	
+	NSData *jsonData = [NSJSONSerialization dataWithJSONObject:jsonDict options:0 error:nil];
+	
+	request.HTTPBody = jsonData;
+	
+	// macOS will automatically add the following incorrect HTTP header:
+	// Content-Type: application/x-www-form-urlencoded
+	//
+	// So we explicitly set it here.
+	
+	[request setValue:@"application/json" forHTTPHeaderField:@"Content-Type"];
+	
+	[AWSSignature signRequest:request
+	               withRegion:region
+	                  service:AWSService_APIGateway
+	              accessKeyID:auth.aws_accessKeyID
+	                   secret:auth.aws_secret
+	                  session:auth.aws_session];
+	
+	return request;
+}
+
 /**
  * See header file for description.
  * Or view the api's online (for both Swift & Objective-C):
@@ -1,5 +1,20 @@
 #import <Foundation/Foundation.h>
 
+/**
+ * The known change commands, interned when the change item is parsed.
+ * Use this (instead of string comparisons against `command`) within tight loops.
+ */
+typedef NS_ENUM(NSInteger, ZDCChangeCommand) {
+	ZDCChangeCommand_Unknown = 0,
+	ZDCChangeCommand_PutIfMatch,       // "put-if-match"
+	ZDCChangeCommand_PutIfNonexistent, // "put-if-nonexistent"
+	ZDCChangeCommand_Move,             // "move"
+	ZDCChangeCommand_DeleteLeaf,       // "delete-leaf"
+	ZDCChangeCommand_DeleteNode,       // "delete-node"
+	ZDCChangeCommand_UpdateAvatar,     // "update-avatar"
+	ZDCChangeCommand_UpdateAuth0       // "update-auth0"
+};
+
 /**
  * Simple wrapper around NSDictionary for change items coming from the server.
  *
@@ -22,6 +37,7 @@
 @property (nonatomic, readonly) NSString *bucket;
 @property (nonatomic, readonly) NSString *region;
 @property (nonatomic, readonly) NSString *command;
+@property (nonatomic, readonly) ZDCChangeCommand commandType;
 
 @property (nonatomic, readonly) NSString *path;
 @property (nonatomic, readonly) NSString *fileID;
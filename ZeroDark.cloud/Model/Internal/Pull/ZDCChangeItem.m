@@ -19,6 +19,7 @@ static NSString *const k_deprecated_uuid = @"uuid";
 @protected
 	
 	NSDictionary *dict;
+	ZDCChangeCommand commandType;
 }
 
 @dynamic uuid;
@@ -27,6 +28,7 @@ static NSString *const k_deprecated_uuid = @"uuid";
 @dynamic bucket;
 @dynamic region;
 @dynamic command;
+@synthesize commandType = commandType;
 @dynamic path;
 @dynamic fileID;
 @dynamic eTag;
@@ -51,10 +53,32 @@ static NSString *const k_deprecated_uuid = @"uuid";
 	if ((self = [super init]))
 	{
 		dict = [inDict copy];
+		commandType = [[self class] commandTypeForCommand:self.command];
 	}
 	return self;
 }
 
++ (ZDCChangeCommand)commandTypeForCommand:(NSString *)command
+{
+	static NSDictionary<NSString*, NSNumber*> *commands = nil;
+	
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		commands = @{
+			@"put-if-match"       : @(ZDCChangeCommand_PutIfMatch),
+			@"put-if-nonexistent" : @(ZDCChangeCommand_PutIfNonexistent),
+			@"move"               : @(ZDCChangeCommand_Move),
+			@"delete-leaf"        : @(ZDCChangeCommand_DeleteLeaf),
+			@"delete-node"        : @(ZDCChangeCommand_DeleteNode),
+			@"update-avatar"      : @(ZDCChangeCommand_UpdateAvatar),
+			@"update-auth0"       : @(ZDCChangeCommand_UpdateAuth0)
+		};
+	});
+	
+	NSNumber *number = command ? commands[command] : nil;
+	return number ? (ZDCChangeCommand)[number integerValue] : ZDCChangeCommand_Unknown;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark NSCoding
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -64,6 +88,7 @@ static NSString *const k_deprecated_uuid = @"uuid";
 	if ((self = [super init]))
 	{
 		dict = [decoder decodeObjectForKey:@"dict"];
+		commandType = [[self class] commandTypeForCommand:self.command];
 	}
 	return self;
 }
@@ -78,4 +78,29 @@
  */
 - (ZDCChangeItem *)popNextPendingChange:(NSOrderedSet<NSString *> **)outChangeIDs;
 
+/**
+ * Returns the next batch of changes that can be processed concurrently.
+ *
+ * A dependency view is built over the pending changes (keyed by fileID, plus parent/move relationships).
+ * Only changes that don't depend on any earlier unprocessed (or in-flight) change are returned.
+ * Each returned change may be the result of the optimization engine merging multiple changes together.
+ *
+ * Since `didProcessChangeIDs:` only advances latestChangeID_local once every earlier change has been processed,
+ * the returned changes can be processed (and completed) in any order.
+ *
+ * @param maxCount
+ *   The maximum number of changes to return.
+ *
+ * @param inFlightChangeIDs
+ *   The changeIDs that are currently being processed.
+ *   These changes won't be returned again, and any changes that depend on them are blocked.
+ *
+ * @param outChangeIDs
+ *   Parallel array to the returned changes.
+ *   You should ALWAYS use the corresponding changeIDs when invoking `didProcessChangeIDs`.
+ */
+- (NSArray<ZDCChangeItem *> *)popIndependentPendingChanges:(NSUInteger)maxCount
+                                        inFlightChangeIDs:(NSSet<NSString *> *)inFlightChangeIDs
+                                                changeIDs:(NSArray<NSOrderedSet<NSString *> *> **)outChangeIDs;
+
 @end
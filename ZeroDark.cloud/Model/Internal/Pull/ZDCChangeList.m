@@ -1,4 +1,5 @@
 #import "ZDCChangeList.h"
+#import "ZDCChangeLog.h"
 #import "ZDCCloudPath.h"
 
 static int const kCurrentVersion = 1;
@@ -10,6 +11,11 @@ static NSString *const k_latestChangeID_remote    = @"latestChangeToken_remote";
 static NSString *const k_pendingChanges           = @"pendingChanges";
 static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
 
+/**
+ * How far into the pendingChanges list we're willing to look when searching for independent changes.
+ */
+static NSUInteger const kMaxDependencyLookahead = 256;
+
 @interface ZDCChangeList ()
 
 // Add readwrite access
@@ -19,7 +25,10 @@ static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
 // Declare as properties so S4DatabaseObject will monitor it for us.
 // (Ensure values cannot be changed when object is marked as immutable.)
 //
-@property (nonatomic, copy, readwrite) NSArray<ZDCChangeItem *> *pendingChanges;
+// Note: Copying a ZDCChangeLog is O(1), as the underlying storage is shared between copies.
+// So we always modify a copy of the log, and then set it via the property.
+//
+@property (nonatomic, copy, readwrite) ZDCChangeLog *pendingChanges;
 @property (nonatomic, copy, readwrite) NSSet<NSString *> *skippedPendingChangeIDs;
 @end
 
@@ -70,11 +79,14 @@ static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
 				}
 			}
 			
-			pendingChanges = [v1 copy];
+			pendingChanges = [[ZDCChangeLog alloc] initWithChanges:v1];
 		}
 		else
 		{
-			pendingChanges = [decoder decodeObjectForKey:k_pendingChanges];
+			NSArray<ZDCChangeItem *> *v1 = [decoder decodeObjectForKey:k_pendingChanges];
+			if (v1.count > 0) {
+				pendingChanges = [[ZDCChangeLog alloc] initWithChanges:v1];
+			}
 		}
 		
 		skippedPendingChangeIDs = [decoder decodeObjectForKey:k_skippedPendingChangeIDs];
@@ -91,7 +103,8 @@ static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
 	[coder encodeObject:latestChangeID_local forKey:k_latestChangeID_local];
 	[coder encodeObject:latestChangeID_remote forKey:k_latestChangeID_remote];
 	
-	[coder encodeObject:pendingChanges forKey:k_pendingChanges];
+	// The log is encoded as a plain array, which keeps the format compatible with previous versions.
+	[coder encodeObject:[pendingChanges allChanges] forKey:k_pendingChanges];
 	[coder encodeObject:skippedPendingChangeIDs forKey:k_skippedPendingChangeIDs];
 }
 
@@ -118,10 +131,15 @@ static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
 
 - (BOOL)hasPendingChange
 {
+	// Note: the first change is never in the skipped list (see didProcessChangeIDs:).
+	// So this loop generally exits on the first iteration.
+	
 	BOOL found = NO;
-	for (ZDCChangeItem *change in pendingChanges)
+	NSUInteger count = pendingChanges.count;
+	
+	for (NSUInteger i = 0; i < count; i++)
 	{
-		NSString *changeID = change.uuid;
+		NSString *changeID = [pendingChanges changeAtIndex:i].uuid;
 		if (![skippedPendingChangeIDs containsObject:changeID])
 		{
 			found = YES;
@@ -148,7 +166,7 @@ static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
 {
 	if ([latestChangeID_local isEqualToString:sinceChangeID])
 	{
-		self.pendingChanges = changes;
+		self.pendingChanges = [[ZDCChangeLog alloc] initWithChanges:changes];
 		self.latestChangeID_remote = latestChangeID;
 	}
 	else if (pendingChanges.count == 0)
@@ -159,7 +177,7 @@ static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
 		// This is likely due to the server sending us a bad change dictionary,
 		// which was subsequently dropped/ignored by the client (during conversion to ZDCChangeItem).
 		
-		self.pendingChanges = changes;
+		self.pendingChanges = [[ZDCChangeLog alloc] initWithChanges:changes];
 		self.latestChangeID_remote = latestChangeID;
 	}
 	else
@@ -173,27 +191,22 @@ static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
 		// So we just need match up the changeTokens from the 2 arrays,
 		// and then properly merge them.
 		
-		ZDCChangeItem *lastChange = [pendingChanges lastObject];
+		ZDCChangeItem *lastChange = [pendingChanges lastChange];
 		NSString *lastChangeID = lastChange.uuid;
 		
-		NSMutableArray<ZDCChangeItem *> *newPendingChanges = [pendingChanges mutableCopy];
-		BOOL found = NO;
-		
-		for (ZDCChangeItem *change in changes)
+		NSUInteger lastIndex = [changes indexOfObjectPassingTest:
+		  ^BOOL(ZDCChangeItem *change, NSUInteger idx, BOOL *stop)
 		{
-			if (found)
-			{
-				[newPendingChanges addObject:change];
-			}
-			else
-			{
-				NSString *changeID = change.uuid;
-				found = [lastChangeID isEqualToString:changeID];
-			}
-		}
+			return [lastChangeID isEqualToString:change.uuid];
+		}];
 		
-		if (found)
+		if (lastIndex != NSNotFound)
 		{
+			NSRange range = NSMakeRange(lastIndex + 1, changes.count - (lastIndex + 1));
+			
+			ZDCChangeLog *newPendingChanges = [pendingChanges copy];
+			[newPendingChanges addChanges:[changes subarrayWithRange:range]];
+			
 			self.pendingChanges = newPendingChanges;
 			self.latestChangeID_remote = latestChangeID;
 		}
@@ -202,39 +215,42 @@ static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
 
 - (void)didProcessChangeIDs:(NSSet<NSString *> *)processedChangeIDs
 {
+	// Changes may be processed out-of-order.
+	// So we add all processed changes to the skipped list,
+	// and then pop everything from the front of the list that's been processed.
+	//
+	// This ensures latestChangeID_local only ever advances in order.
+	//
+	// Performance: O(processedChangeIDs.count + popped.count)
+	
 	NSString *newLatestChangeID_local = latestChangeID_local;
-	NSMutableArray<ZDCChangeItem *> *newPendingChanges = [pendingChanges mutableCopy];
+	ZDCChangeLog *newPendingChanges = [pendingChanges copy];
 	
 	NSMutableSet<NSString *> *newSkippedPendingChangeIDs = [skippedPendingChangeIDs mutableCopy];
 	if (newSkippedPendingChangeIDs == nil) {
 		newSkippedPendingChangeIDs = [[NSMutableSet alloc] init];
 	}
 	
-	NSUInteger i = 0;
-	while (i < newPendingChanges.count)
+	for (NSString *changeID in processedChangeIDs)
 	{
-		ZDCChangeItem *change = newPendingChanges[i];
-		NSString *changeID = change.uuid;
-		
-		if ([processedChangeIDs containsObject:changeID] ||
-		    [skippedPendingChangeIDs containsObject:changeID])
+		if ([newPendingChanges indexOfChangeID:changeID] != NSNotFound)
 		{
-			if (i == 0)
-			{
-				[newPendingChanges removeObjectAtIndex:i];
-				[newSkippedPendingChangeIDs removeObject:changeID];
-				newLatestChangeID_local = changeID;
-			}
-			else
-			{
-				[newSkippedPendingChangeIDs addObject:changeID];
-				i++;
-			}
+			[newSkippedPendingChangeIDs addObject:changeID];
 		}
-		else
-		{
-			i++;
+	}
+	
+	ZDCChangeItem *firstChange = nil;
+	while ((firstChange = [newPendingChanges firstChange]))
+	{
+		NSString *changeID = firstChange.uuid;
+		
+		if (![newSkippedPendingChangeIDs containsObject:changeID]) {
+			break;
 		}
+		
+		[newPendingChanges removeFirstChange];
+		[newSkippedPendingChangeIDs removeObject:changeID];
+		newLatestChangeID_local = changeID;
 	}
 	
 	self.pendingChanges = newPendingChanges;
@@ -256,13 +272,13 @@ static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
 		
 		if (pendingChanges.count > 0)
 		{
-			ZDCChangeItem *firstChange = [pendingChanges firstObject];
+			ZDCChangeItem *firstChange = [pendingChanges firstChange];
 			NSString *firstChangeID = firstChange.uuid;
 			
 			if ([firstChangeID isEqualToString:oldChangeID])
 			{
-				NSMutableArray<ZDCChangeItem *> *newPendingChanges = [pendingChanges mutableCopy];
-				[newPendingChanges removeObjectAtIndex:0];
+				ZDCChangeLog *newPendingChanges = [pendingChanges copy];
+				[newPendingChanges removeFirstChange];
 				
 				self.pendingChanges = newPendingChanges;
 			}
@@ -289,18 +305,18 @@ static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
 	{
 		if (pendingChanges.count == 0)
 		{
-			self.pendingChanges = @[ change ];
+			self.pendingChanges = [[ZDCChangeLog alloc] initWithChanges:@[ change ]];
 		}
 	}
 	else
 	{
-		ZDCChangeItem *lastChange = [pendingChanges lastObject];
+		ZDCChangeItem *lastChange = [pendingChanges lastChange];
 		NSString *lastChangeID = lastChange.uuid;
 		
 		if ([lastChangeID isEqualToString:oldChangeID])
 		{
-			NSMutableArray<ZDCChangeItem *> *newPendingChanges = [pendingChanges mutableCopy];
-			[newPendingChanges addObject:change];
+			ZDCChangeLog *newPendingChanges = [pendingChanges copy];
+			[newPendingChanges addChange:change];
 			
 			self.pendingChanges = newPendingChanges;
 		}
@@ -324,6 +340,181 @@ static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
  * You should ALWAYS use the returned outChangeIDs when invoking `didProcessChangeIDs`.
 **/
 - (ZDCChangeItem *)popNextPendingChange:(NSOrderedSet<NSString *> **)outChangeIDs
+{
+	return [self mergedChangeAtIndex:0 excludingChangeIDs:nil changeIDs:outChangeIDs];
+}
+
+/**
+ * See header file for description.
+ */
+- (NSArray<ZDCChangeItem *> *)popIndependentPendingChanges:(NSUInteger)maxCount
+                                        inFlightChangeIDs:(NSSet<NSString *> *)inFlightChangeIDs
+                                                changeIDs:(NSArray<NSOrderedSet<NSString *> *> **)outChangeIDs
+{
+	// The dependency view is built by walking the list in order.
+	// Every change that we can't (or don't) start right now blocks all later changes that depend on it:
+	//
+	// - changes for the same fileID must be processed in order
+	//   (e.g. put-if-nonexistent + put-if-match, or rcrd + data)
+	//
+	// - a put-if-nonexistent may be creating the parent of a later put-if-nonexistent.
+	//   We can't know the dirPrefix of a node until we've downloaded its rcrd.
+	//   But we do know that siblings share the same dirPrefix, and a child never does.
+	//   So new nodes within the same directory can be pulled concurrently.
+	//
+	// - moves & delete-node's affect an entire subtree, so they act as a barrier.
+	//   They wait for everything before them, and everything after them waits for them.
+	//   The same goes for unknown commands.
+	
+	NSMutableArray<ZDCChangeItem *> *results = [NSMutableArray array];
+	NSMutableArray<NSOrderedSet<NSString *> *> *resultsChangeIDs = [NSMutableArray array];
+	
+	NSMutableSet<NSString *> *claimedChangeIDs = [NSMutableSet setWithSet:inFlightChangeIDs];
+	NSMutableSet<NSString *> *blockedKeys = [NSMutableSet set];
+	NSMutableSet<NSString *> *createDirPrefixes = [NSMutableSet set];
+	
+	BOOL hasInFlight = (inFlightChangeIDs.count > 0);
+	BOOL hasBlocked = NO;
+	
+	// In-flight changes claim their keys, regardless of their position in the list.
+	// This is because the optimization engine may have merged later changes into an earlier one.
+	//
+	// An in-flight put-if-nonexistent may also be creating the parent of a later put-if-nonexistent.
+	
+	for (NSString *inFlightChangeID in inFlightChangeIDs)
+	{
+		NSUInteger index = [pendingChanges indexOfChangeID:inFlightChangeID];
+		if (index != NSNotFound)
+		{
+			ZDCChangeItem *change = [pendingChanges changeAtIndex:index];
+			
+			if ([self isBarrierChange:change]) {
+				return results; // nothing else can run until the barrier completes
+			}
+			
+			[blockedKeys addObject:[ZDCChangeLog keyForChange:change]];
+			
+			if (change.commandType == ZDCChangeCommand_PutIfNonexistent)
+			{
+				NSString *dirPrefix = [[[ZDCCloudPath alloc] initWithPath:change.path] dirPrefix];
+				if (dirPrefix) {
+					[createDirPrefixes addObject:dirPrefix];
+				}
+			}
+		}
+	}
+	
+	NSUInteger lookahead = MIN(pendingChanges.count, kMaxDependencyLookahead);
+	for (NSUInteger i = 0; i < lookahead && results.count < maxCount; i++)
+	{
+		ZDCChangeItem *change = [pendingChanges changeAtIndex:i];
+		NSString *changeID = change.uuid;
+		
+		if ([claimedChangeIDs containsObject:changeID] ||
+		    [skippedPendingChangeIDs containsObject:changeID])
+		{
+			continue;
+		}
+		
+		NSString *key = [ZDCChangeLog keyForChange:change];
+		BOOL isBarrier = [self isBarrierChange:change];
+		BOOL isPutIfNonexistent = (change.commandType == ZDCChangeCommand_PutIfNonexistent);
+		NSString *dirPrefix = nil;
+		
+		if (isPutIfNonexistent) {
+			dirPrefix = [[[ZDCCloudPath alloc] initWithPath:change.path] dirPrefix];
+		}
+		
+		BOOL canStart = ![blockedKeys containsObject:key];
+		
+		if (canStart && isBarrier)
+		{
+			canStart = !hasBlocked && !hasInFlight && (results.count == 0);
+		}
+		if (canStart && isPutIfNonexistent)
+		{
+			for (NSString *prefix in createDirPrefixes)
+			{
+				if (![prefix isEqualToString:dirPrefix]) {
+					canStart = NO;
+					break;
+				}
+			}
+		}
+		
+		if (canStart)
+		{
+			NSOrderedSet<NSString *> *changeIDs = nil;
+			ZDCChangeItem *mergedChange = [self mergedChangeAtIndex: i
+			                                     excludingChangeIDs: claimedChangeIDs
+			                                              changeIDs: &changeIDs];
+			
+			// The optimization engine may have switched to a different command.
+			// E.g.: put-if-match(DATA) + move => move
+			
+			if (!isBarrier && [self isBarrierChange:mergedChange])
+			{
+				if (!hasBlocked && !hasInFlight && (results.count == 0))
+				{
+					[results addObject:mergedChange];
+					[resultsChangeIDs addObject:changeIDs];
+				}
+				break;
+			}
+			
+			[results addObject:mergedChange];
+			[resultsChangeIDs addObject:changeIDs];
+			[claimedChangeIDs unionSet:[changeIDs set]];
+		}
+		else
+		{
+			hasBlocked = YES;
+		}
+		
+		if (isBarrier) {
+			break;
+		}
+		
+		[blockedKeys addObject:key];
+		if (dirPrefix) {
+			[createDirPrefixes addObject:dirPrefix];
+		}
+	}
+	
+	if (outChangeIDs) *outChangeIDs = resultsChangeIDs;
+	return results;
+}
+
+/**
+ * Barrier changes may affect an entire subtree.
+ * They cannot be processed concurrently with any other change.
+ */
+- (BOOL)isBarrierChange:(ZDCChangeItem *)change
+{
+	switch (change.commandType)
+	{
+		case ZDCChangeCommand_PutIfMatch       :
+		case ZDCChangeCommand_PutIfNonexistent :
+		case ZDCChangeCommand_DeleteLeaf       :
+		case ZDCChangeCommand_UpdateAvatar     :
+		case ZDCChangeCommand_UpdateAuth0      : return NO;
+		
+		case ZDCChangeCommand_Move             :
+		case ZDCChangeCommand_DeleteNode       :
+		case ZDCChangeCommand_Unknown          :
+		default                                : return YES;
+	}
+}
+
+/**
+ * The optimization engine.
+ *
+ * Starts with the change at the given index, and attempts to merge it with subsequent changes for the same node.
+ * Changes listed in excludedChangeIDs (e.g. changes that are currently being processed) are ignored.
+ */
+- (ZDCChangeItem *)mergedChangeAtIndex:(NSUInteger)startIndex
+                    excludingChangeIDs:(NSSet<NSString *> *)excludedChangeIDs
+                             changeIDs:(NSOrderedSet<NSString *> **)outChangeIDs
 {
 	// We implement minor optimizations available during a quick sync.
 	// At this point in time, it only implements the low-hanging fruit.
@@ -333,7 +524,7 @@ static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
 	// This is due largely to the complexity of analyzing all the possible
 	// combinations of changes that could potentially be in the queue.
 	
-	ZDCChangeItem *nextChange = [pendingChanges firstObject];
+	ZDCChangeItem *nextChange = (startIndex < pendingChanges.count) ? [pendingChanges changeAtIndex:startIndex] : nil;
 	if (nextChange == nil)
 	{
 		if (outChangeIDs) *outChangeIDs = nil;
@@ -346,35 +537,41 @@ static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
 	[allChangeIDs addObject:nextChange.uuid];
 	[effectiveChangeIDs addObject:nextChange.uuid];
 	
-	NSString *const kPutIfMatch       = @"put-if-match";
-	NSString *const kPutIfNonexistent = @"put-if-nonexistent";
-	NSString *const kMove             = @"move";
-	NSString *const kDeleteLeaf       = @"delete-leaf";
-	NSString *const kDeleteNode       = @"delete-node";
-	NSString *const kUpdateAvatar     = @"update-avatar";
+	const ZDCChangeCommand kPutIfMatch       = ZDCChangeCommand_PutIfMatch;
+	const ZDCChangeCommand kPutIfNonexistent = ZDCChangeCommand_PutIfNonexistent;
+	const ZDCChangeCommand kMove             = ZDCChangeCommand_Move;
+	const ZDCChangeCommand kDeleteLeaf       = ZDCChangeCommand_DeleteLeaf;
+	const ZDCChangeCommand kDeleteNode       = ZDCChangeCommand_DeleteNode;
+	const ZDCChangeCommand kUpdateAvatar     = ZDCChangeCommand_UpdateAvatar;
 	
-	NSString *requiredFileID = nextChange.fileID;
 	ZDCMutableChangeItem *mergedChange = [nextChange mutableCopy];
 	
-	for (NSUInteger i = 1; i < pendingChanges.count; i++)
+	// Changes for a different fileID can't be merged with this one.
+	// So rather than scanning the entire list, we use the index to jump directly to changes for the same fileID.
+	//
+	// Note: Changes without a fileID (e.g. update-avatar) are indexed by path.
+	
+	NSString *key = [ZDCChangeLog keyForChange:nextChange];
+	NSIndexSet *indexes = [pendingChanges indexesOfChangesWithKey:key afterIndex:startIndex];
+	
+	for (NSUInteger i = [indexes firstIndex]; i != NSNotFound; i = [indexes indexGreaterThanIndex:i])
 	{
-		ZDCChangeItem *change = pendingChanges[i];
+		ZDCChangeItem *change = [pendingChanges changeAtIndex:i];
 		
-		if (requiredFileID && ![change.fileID isEqualToString:requiredFileID])
+		if ([excludedChangeIDs containsObject:change.uuid])
 		{
-			// Change is for a different fileID.
-			// Thus it can't be merged with this one.
+			// Change is already being processed (concurrently).
 			
 			continue;
 		}
 		
-		NSString *commandA = mergedChange.command;
-		NSString *commandB =       change.command;
+		ZDCChangeCommand commandA = mergedChange.commandType;
+		ZDCChangeCommand commandB =       change.commandType;
 		
-		if ([commandA isEqualToString:kPutIfMatch] ||
-			 [commandA isEqualToString:kPutIfNonexistent])
+		if ((commandA == kPutIfMatch) ||
+			 (commandA == kPutIfNonexistent))
 		{
-			if ([commandB isEqualToString:kPutIfMatch])
+			if (commandB == kPutIfMatch)
 			{
 				// Are both changes for the same component ? (rcrd vs data)
 				
@@ -404,7 +601,7 @@ static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
 					[effectiveChangeIDs addObject:change.uuid];
 				}
 			}
-			else if ([commandB isEqualToString:kPutIfNonexistent])
+			else if (commandB == kPutIfNonexistent)
 			{
 				// Are both changes for the same component ? (rcrd vs data)
 				
@@ -431,7 +628,7 @@ static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
 					break;
 				}
 			}
-			else if ([commandB isEqualToString:kMove])
+			else if (commandB == kMove)
 			{
 				// FOUND:
 				// - put-if-match + move
@@ -439,7 +636,7 @@ static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
 				//
 				// We've got updates to a file, followed by a move.
 				
-				if ([commandA isEqualToString:kPutIfNonexistent] ||
+				if ((commandA == kPutIfNonexistent) ||
 					 [skippedPendingChangeIDs containsObject:change.uuid])
 				{
 					// Two possibilities here:
@@ -507,8 +704,8 @@ static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
 					}
 				}
 			}
-			else if ([commandB isEqualToString:kDeleteLeaf] ||
-						[commandB isEqualToString:kDeleteNode])
+			else if ((commandB == kDeleteLeaf) ||
+						(commandB == kDeleteNode))
 			{
 				// FOUND:
 				// - put-if-match + delete
@@ -529,9 +726,9 @@ static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
 				break;
 			}
 		}
-		else if ([commandA isEqualToString:kMove])
+		else if (commandA == kMove)
 		{
-			if ([commandB isEqualToString:kPutIfMatch])
+			if (commandB == kPutIfMatch)
 			{
 				// FOUND:
 				// - move + put-if-match
@@ -556,7 +753,7 @@ static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
 					// Does NOT change effectiveChangeIDs
 				}
 			}
-			else if ([commandB isEqualToString:kPutIfNonexistent])
+			else if (commandB == kPutIfNonexistent)
 			{
 				// FOUND:
 				// - move + put-if-nonexistent
@@ -566,7 +763,7 @@ static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
 				
 				break;
 			}
-			else if ([commandB isEqualToString:kMove])
+			else if (commandB == kMove)
 			{
 				// FOUND:
 				// - move + move
@@ -579,8 +776,8 @@ static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
 				[allChangeIDs addObject:change.uuid];
 				[effectiveChangeIDs addObject:change.uuid];
 			}
-			else if ([commandB isEqualToString:kDeleteLeaf] ||
-						[commandB isEqualToString:kDeleteNode])
+			else if ((commandB == kDeleteLeaf) ||
+						(commandB == kDeleteNode))
 			{
 				// FOUND:
 				// - move + delete-leaf
@@ -602,9 +799,9 @@ static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
 				break;
 			}
 		}
-		else if ([commandA isEqualToString:kUpdateAvatar])
+		else if (commandA == kUpdateAvatar)
 		{
-			if ([commandB isEqualToString:kUpdateAvatar])
+			if (commandB == kUpdateAvatar)
 			{
 				// Are both changes for the same avatar ?
 				//
@@ -640,7 +837,7 @@ static NSString *const k_skippedPendingChangeIDs  = @"skippedPendingChangeIDs";
 			break;
 		}
 		
-	} // end: for (NSUInteger i = 1; i < pendingChanges.count; i++)
+	} // end: for (NSUInteger i = [indexes firstIndex]; i != NSNotFound; i = [indexes indexGreaterThanIndex:i])
 	
 	if (outChangeIDs) *outChangeIDs = effectiveChangeIDs;
 	return [mergedChange copy];
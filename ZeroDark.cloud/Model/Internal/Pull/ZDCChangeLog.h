@@ -0,0 +1,60 @@
+#import <Foundation/Foundation.h>
+
+#import "ZDCChangeItem.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Storage for the pending changes within a ZDCChangeList.
+ *
+ * This is a deque (O(1) removeFirstChange & addChange), with an index by changeID,
+ * and an index by key (fileID) which allows the optimization engine to find related changes
+ * without scanning the entire list.
+ *
+ * ZDCChangeList is a database object, which means it gets copied every time it's modified.
+ * To keep copies cheap, the underlying storage is shared between copies of the log.
+ * The storage is append-only, and each copy maintains its own window into it.
+ * Thus copying a log is O(1), and modifying a copy never affects the original.
+ */
+@interface ZDCChangeLog : NSObject <NSCopying>
+
+- (instancetype)initWithChanges:(nullable NSArray<ZDCChangeItem *> *)changes;
+
+/**
+ * Changes that must be processed in order (relative to each other) share the same key.
+ * This is generally the fileID. (Avatar changes don't have a fileID, so the path is used instead.)
+ */
++ (NSString *)keyForChange:(ZDCChangeItem *)change;
+
+/** The number of changes in the log. */
+@property (nonatomic, readonly) NSUInteger count;
+
+- (nullable ZDCChangeItem *)firstChange;
+- (nullable ZDCChangeItem *)lastChange;
+
+- (ZDCChangeItem *)changeAtIndex:(NSUInteger)index;
+
+/**
+ * Returns the index of the change with the given uuid, or NSNotFound.
+ */
+- (NSUInteger)indexOfChangeID:(NSString *)changeID;
+
+/**
+ * Returns the indexes of all changes with the given key (see `keyForChange:`) that come after the given index.
+ */
+- (NSIndexSet *)indexesOfChangesWithKey:(NSString *)key afterIndex:(NSUInteger)index;
+
+/**
+ * Returns every change in the log, in order.
+ * This is O(n), and is primarily used for NSCoding.
+ */
+- (NSArray<ZDCChangeItem *> *)allChanges;
+
+- (void)removeFirstChange;
+
+- (void)addChange:(ZDCChangeItem *)change;
+- (void)addChanges:(NSArray<ZDCChangeItem *> *)changes;
+
+@end
+
+NS_ASSUME_NONNULL_END
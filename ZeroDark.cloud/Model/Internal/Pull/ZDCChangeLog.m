@@ -0,0 +1,317 @@
+#import "ZDCChangeLog.h"
+
+/**
+ * Once this many changes have been removed from the front of the log (and they make up at least half the buffer),
+ * the remaining changes are moved into a fresh buffer. This keeps memory bounded, with O(1) amortized cost.
+ */
+static NSUInteger const kCompactionThreshold = 1024;
+
+/**
+ * The append-only storage that's shared between copies of a ZDCChangeLog.
+ *
+ * Copies of a ZDCChangeList may be read from multiple threads (e.g. via the database object cache),
+ * while a different copy is appending to the shared storage. So all access goes through the queue.
+ */
+@interface ZDCChangeLogBuffer : NSObject {
+@public
+
+	dispatch_queue_t queue;
+	
+	NSMutableArray<ZDCChangeItem *> *items;
+	NSMutableDictionary<NSString *, NSNumber *> *changeIDIndex;
+	NSMutableDictionary<NSString *, NSMutableIndexSet *> *keyIndex;
+}
+
+- (instancetype)initWithChanges:(NSArray<ZDCChangeItem *> *)changes;
+
+/** Must be invoked from within the queue. */
+- (void)_addChange:(ZDCChangeItem *)change;
+
+@end
+
+@implementation ZDCChangeLogBuffer
+
+- (instancetype)initWithChanges:(NSArray<ZDCChangeItem *> *)changes
+{
+	if ((self = [super init]))
+	{
+		queue = dispatch_queue_create("ZDCChangeLogBuffer", DISPATCH_QUEUE_SERIAL);
+		
+		items = [[NSMutableArray alloc] initWithCapacity:changes.count];
+		changeIDIndex = [[NSMutableDictionary alloc] initWithCapacity:changes.count];
+		keyIndex = [[NSMutableDictionary alloc] init];
+		
+		for (ZDCChangeItem *change in changes)
+		{
+			[self _addChange:change];
+		}
+	}
+	return self;
+}
+
+- (void)_addChange:(ZDCChangeItem *)change
+{
+	NSUInteger position = items.count;
+	[items addObject:change];
+	
+	NSString *changeID = change.uuid;
+	if (changeID) {
+		changeIDIndex[changeID] = @(position);
+	}
+	
+	NSString *key = [ZDCChangeLog keyForChange:change];
+	NSMutableIndexSet *positions = keyIndex[key];
+	if (positions == nil) {
+		positions = keyIndex[key] = [[NSMutableIndexSet alloc] init];
+	}
+	[positions addIndex:position];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation ZDCChangeLog {
+
+	ZDCChangeLogBuffer *buffer;
+	
+	NSUInteger head; // position (within buffer) of first change
+	NSUInteger tail; // position (within buffer) after last change
+}
+
++ (NSString *)keyForChange:(ZDCChangeItem *)change
+{
+	return change.fileID ?: (change.path ?: (change.uuid ?: @""));
+}
+
+- (instancetype)init
+{
+	return [self initWithChanges:nil];
+}
+
+- (instancetype)initWithChanges:(NSArray<ZDCChangeItem *> *)changes
+{
+	if ((self = [super init]))
+	{
+		buffer = [[ZDCChangeLogBuffer alloc] initWithChanges:(changes ?: @[])];
+		head = 0;
+		tail = changes.count;
+	}
+	return self;
+}
+
+- (instancetype)initWithBuffer:(ZDCChangeLogBuffer *)inBuffer
+{
+	if ((self = [super init]))
+	{
+		buffer = inBuffer;
+	}
+	return self;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark NSCopying
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (id)copyWithZone:(NSZone *)zone
+{
+	// Note: We intentionally skip initWithChanges: here, as it would allocate a buffer we're about to discard.
+	ZDCChangeLog *copy = [[[self class] allocWithZone:zone] initWithBuffer:buffer];
+	
+	copy->head = head;
+	copy->tail = tail;
+	
+	return copy;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Reading
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSUInteger)count
+{
+	return (tail - head);
+}
+
+- (ZDCChangeItem *)firstChange
+{
+	if (head == tail) return nil;
+	return [self changeAtIndex:0];
+}
+
+- (ZDCChangeItem *)lastChange
+{
+	if (head == tail) return nil;
+	return [self changeAtIndex:(tail - head - 1)];
+}
+
+- (ZDCChangeItem *)changeAtIndex:(NSUInteger)index
+{
+	NSAssert(index < (tail - head), @"Index out of bounds");
+	
+	__block ZDCChangeItem *change = nil;
+	
+	ZDCChangeLogBuffer *const buf = buffer;
+	NSUInteger const position = head + index;
+	
+	dispatch_sync(buf->queue, ^{
+	
+		change = buf->items[position];
+	});
+	
+	return change;
+}
+
+- (NSUInteger)indexOfChangeID:(NSString *)changeID
+{
+	if (changeID == nil) return NSNotFound;
+	
+	__block NSUInteger position = NSNotFound;
+	
+	ZDCChangeLogBuffer *const buf = buffer;
+	dispatch_sync(buf->queue, ^{
+	
+		NSNumber *number = buf->changeIDIndex[changeID];
+		if (number) {
+			position = [number unsignedIntegerValue];
+		}
+	});
+	
+	if (position == NSNotFound || position < head || position >= tail) {
+		return NSNotFound;
+	}
+	
+	return (position - head);
+}
+
+- (NSIndexSet *)indexesOfChangesWithKey:(NSString *)key afterIndex:(NSUInteger)index
+{
+	NSMutableIndexSet *result = [[NSMutableIndexSet alloc] init];
+	
+	NSUInteger const start = head + index + 1;
+	if (key == nil || start >= tail) {
+		return result;
+	}
+	
+	NSUInteger const offset = head;
+	NSRange const range = NSMakeRange(start, tail - start);
+	
+	ZDCChangeLogBuffer *const buf = buffer;
+	dispatch_sync(buf->queue, ^{
+	
+		NSIndexSet *positions = buf->keyIndex[key];
+		[positions enumerateRangesInRange:range options:0 usingBlock:^(NSRange subrange, BOOL *stop) {
+		
+			[result addIndexesInRange:NSMakeRange(subrange.location - offset, subrange.length)];
+		}];
+	});
+	
+	return result;
+}
+
+- (NSArray<ZDCChangeItem *> *)allChanges
+{
+	__block NSArray<ZDCChangeItem *> *result = nil;
+	
+	NSRange const range = NSMakeRange(head, tail - head);
+	
+	ZDCChangeLogBuffer *const buf = buffer;
+	dispatch_sync(buf->queue, ^{
+	
+		result = [buf->items subarrayWithRange:range];
+	});
+	
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Writing
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)removeFirstChange
+{
+	if (head == tail) return;
+	head++;
+	
+	if (head == tail)
+	{
+		// Empty - no reason to hold onto the old buffer.
+		
+		buffer = [[ZDCChangeLogBuffer alloc] initWithChanges:@[]];
+		head = 0;
+		tail = 0;
+	}
+	else if ((head >= kCompactionThreshold) && (head >= (tail - head)))
+	{
+		[self compact];
+	}
+}
+
+- (void)addChange:(ZDCChangeItem *)change
+{
+	if (change == nil) return;
+	[self addChanges:@[ change ]];
+}
+
+- (void)addChanges:(NSArray<ZDCChangeItem *> *)changes
+{
+	if (changes.count == 0) return;
+	
+	__block BOOL appended = NO;
+	
+	ZDCChangeLogBuffer *const buf = buffer;
+	NSUInteger const currentTail = tail;
+	
+	dispatch_sync(buf->queue, ^{
+	
+		// We can only append to the shared buffer if nobody else has appended to it yet.
+		// That is, if our window ends at the end of the buffer.
+		
+		if (buf->items.count == currentTail)
+		{
+			for (ZDCChangeItem *change in changes)
+			{
+				[buf _addChange:change];
+			}
+			appended = YES;
+		}
+	});
+	
+	if (appended)
+	{
+		tail += changes.count;
+	}
+	else
+	{
+		// Some other copy of the log has already appended to the shared buffer.
+		// So we fork.
+		
+		NSArray<ZDCChangeItem *> *existing = [self allChanges];
+		
+		buffer = [[ZDCChangeLogBuffer alloc] initWithChanges:[existing arrayByAddingObjectsFromArray:changes]];
+		head = 0;
+		tail = existing.count + changes.count;
+	}
+}
+
+- (void)compact
+{
+	NSArray<ZDCChangeItem *> *existing = [self allChanges];
+	
+	buffer = [[ZDCChangeLogBuffer alloc] initWithChanges:existing];
+	head = 0;
+	tail = existing.count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Description
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSString *)description
+{
+	return [[self allChanges] description];
+}
+
+@end
@@ -0,0 +1,84 @@
+#import <Foundation/Foundation.h>
+#import <ZDCSyncableObjC/ZDCObject.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * A full pull can take a long time for a large treesystem.
+ * And it's frequently interrupted (app suspension, network loss, auth refresh, etc).
+ *
+ * This class stores the progress of a full pull, so that an interrupted pull can resume where it left off,
+ * rather than re-listing the entire bucket & re-syncing every directory.
+ *
+ * The checkpoint is stored in the database (kZDCCollection_PullCheckpoint), keyed by localUserID.
+ * It only tracks small bits of metadata. The bulky items are stored as separate rows in the same collection:
+ *
+ * - listPageKey: an array of S3ObjectInfo items (one page of the bucket listing)
+ * - directoryKey: the nodeIDs of children that weren't found in the cloud when the directory completed
+ *
+ * A checkpoint is only valid for the change token that the full pull is anchored to.
+ * If the anchor changes (e.g. we fell back to a new full pull), the checkpoint must be discarded.
+ */
+@interface ZDCPullCheckpoint : ZDCObject <NSCoding, NSCopying>
+
+/**
+ * Use this when starting a (fresh) full pull.
+ */
+- (instancetype)initWithChangeToken:(NSString *)changeToken;
+
+/**
+ * The change token (ZDCChangeList.latestChangeID_remote) the full pull is anchored to.
+ */
+@property (nonatomic, copy, readonly) NSString *changeToken;
+
+/**
+ * The rootNodeIDs for which we've stored at least one page of the bucket listing.
+ */
+- (NSArray<NSString *> *)listedRootNodeIDs;
+
+/**
+ * Returns the continuation token to use for the next request in the bucket listing.
+ * Returns nil if the listing hasn't started, or if it has completed.
+ */
+- (nullable NSString *)continuationTokenForRootNodeID:(NSString *)rootNodeID;
+
+/**
+ * The number of listing pages that have been stored in the database.
+ */
+- (NSUInteger)pageCountForRootNodeID:(NSString *)rootNodeID;
+
+/**
+ * Returns YES if we've received the last page of the bucket listing.
+ */
+- (BOOL)isListingCompleteForRootNodeID:(NSString *)rootNodeID;
+
+/**
+ * Invoke this after storing a page of the bucket listing.
+ *
+ * @param continuationToken
+ *   The S3 continuation token for the next page.
+ *   Pass nil if this was the last page.
+ */
+- (void)didStoreListPageWithContinuationToken:(nullable NSString *)continuationToken
+                                   rootNodeID:(NSString *)rootNodeID;
+
+/** Database key for the checkpoint itself. */
++ (NSString *)keyForLocalUserID:(NSString *)localUserID;
+
+/** Database key for a page of the bucket listing. */
++ (NSString *)listPageKeyForLocalUserID:(NSString *)localUserID
+                             rootNodeID:(NSString *)rootNodeID
+                              pageIndex:(NSUInteger)pageIndex;
+
+/** Database key for a completed directory. */
++ (NSString *)directoryKeyForLocalUserID:(NSString *)localUserID nodeID:(NSString *)nodeID;
+
+/** All database keys (other than the checkpoint itself) for the localUserID start with this prefix. */
++ (NSString *)keyPrefixForLocalUserID:(NSString *)localUserID;
+
+/** The prefix used by directoryKeyForLocalUserID:nodeID:. */
++ (NSString *)directoryKeyPrefixForLocalUserID:(NSString *)localUserID;
+
+@end
+
+NS_ASSUME_NONNULL_END
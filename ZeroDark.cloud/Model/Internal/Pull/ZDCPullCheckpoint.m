@@ -0,0 +1,170 @@
+#import "ZDCPullCheckpoint.h"
+
+static int const kCurrentVersion = 0;
+#pragma unused(kCurrentVersion)
+
+static NSString *const k_version            = @"version";
+static NSString *const k_changeToken        = @"changeToken";
+static NSString *const k_continuationTokens = @"continuationTokens";
+static NSString *const k_pageCounts         = @"pageCounts";
+static NSString *const k_completedListings  = @"completedListings";
+
+@interface ZDCPullCheckpoint ()
+
+// Declare as properties so ZDCObject will monitor them for us.
+// (Ensure values cannot be changed when object is marked as immutable.)
+//
+@property (nonatomic, copy, readwrite) NSDictionary<NSString*, NSString*> *continuationTokens;
+@property (nonatomic, copy, readwrite) NSDictionary<NSString*, NSNumber*> *pageCounts;
+@property (nonatomic, copy, readwrite) NSSet<NSString*> *completedListings;
+
+@end
+
+
+@implementation ZDCPullCheckpoint
+
+@synthesize changeToken = changeToken;
+@synthesize continuationTokens = continuationTokens;
+@synthesize pageCounts = pageCounts;
+@synthesize completedListings = completedListings;
+
+- (instancetype)initWithChangeToken:(NSString *)inChangeToken
+{
+	if ((self = [super init]))
+	{
+		changeToken = [inChangeToken copy];
+	}
+	return self;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark NSCoding
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (id)initWithCoder:(NSCoder *)decoder
+{
+	if ((self = [super init]))
+	{
+		changeToken        = [decoder decodeObjectForKey:k_changeToken];
+		continuationTokens = [decoder decodeObjectForKey:k_continuationTokens];
+		pageCounts         = [decoder decodeObjectForKey:k_pageCounts];
+		completedListings  = [decoder decodeObjectForKey:k_completedListings];
+	}
+	return self;
+}
+
+- (void)encodeWithCoder:(NSCoder *)coder
+{
+	if (kCurrentVersion != 0) {
+		[coder encodeInt:kCurrentVersion forKey:k_version];
+	}
+	
+	[coder encodeObject:changeToken        forKey:k_changeToken];
+	[coder encodeObject:continuationTokens forKey:k_continuationTokens];
+	[coder encodeObject:pageCounts         forKey:k_pageCounts];
+	[coder encodeObject:completedListings  forKey:k_completedListings];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark NSCopying
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (id)copyWithZone:(NSZone *)zone
+{
+	ZDCPullCheckpoint *copy = [super copyWithZone:zone]; // [ZDCObject copyWithZone:]
+	
+	copy->changeToken = changeToken;
+	copy->continuationTokens = continuationTokens;
+	copy->pageCounts = pageCounts;
+	copy->completedListings = completedListings;
+	
+	return copy;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Listing
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSArray<NSString *> *)listedRootNodeIDs
+{
+	return [pageCounts allKeys] ?: @[];
+}
+
+- (NSString *)continuationTokenForRootNodeID:(NSString *)rootNodeID
+{
+	return continuationTokens[rootNodeID];
+}
+
+- (NSUInteger)pageCountForRootNodeID:(NSString *)rootNodeID
+{
+	return [pageCounts[rootNodeID] unsignedIntegerValue];
+}
+
+- (BOOL)isListingCompleteForRootNodeID:(NSString *)rootNodeID
+{
+	return [completedListings containsObject:rootNodeID];
+}
+
+- (void)didStoreListPageWithContinuationToken:(NSString *)continuationToken rootNodeID:(NSString *)rootNodeID
+{
+	if (rootNodeID == nil) return;
+	
+	NSMutableDictionary<NSString*, NSNumber*> *newPageCounts = [pageCounts mutableCopy];
+	if (newPageCounts == nil) {
+		newPageCounts = [[NSMutableDictionary alloc] initWithCapacity:2];
+	}
+	newPageCounts[rootNodeID] = @([self pageCountForRootNodeID:rootNodeID] + 1);
+	
+	NSMutableDictionary<NSString*, NSString*> *newContinuationTokens = [continuationTokens mutableCopy];
+	if (newContinuationTokens == nil) {
+		newContinuationTokens = [[NSMutableDictionary alloc] initWithCapacity:2];
+	}
+	newContinuationTokens[rootNodeID] = continuationToken;
+	
+	self.pageCounts = newPageCounts;
+	self.continuationTokens = newContinuationTokens;
+	
+	if (continuationToken == nil)
+	{
+		NSMutableSet<NSString*> *newCompletedListings = [completedListings mutableCopy];
+		if (newCompletedListings == nil) {
+			newCompletedListings = [[NSMutableSet alloc] initWithCapacity:2];
+		}
+		[newCompletedListings addObject:rootNodeID];
+		
+		self.completedListings = newCompletedListings;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Database Keys
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
++ (NSString *)keyForLocalUserID:(NSString *)localUserID
+{
+	return localUserID;
+}
+
++ (NSString *)keyPrefixForLocalUserID:(NSString *)localUserID
+{
+	return [NSString stringWithFormat:@"%@|", localUserID];
+}
+
++ (NSString *)listPageKeyForLocalUserID:(NSString *)localUserID
+                             rootNodeID:(NSString *)rootNodeID
+                              pageIndex:(NSUInteger)pageIndex
+{
+	return [NSString stringWithFormat:@"%@|list|%@|%lu", localUserID, rootNodeID, (unsigned long)pageIndex];
+}
+
++ (NSString *)directoryKeyPrefixForLocalUserID:(NSString *)localUserID
+{
+	return [NSString stringWithFormat:@"%@|dir|", localUserID];
+}
+
++ (NSString *)directoryKeyForLocalUserID:(NSString *)localUserID nodeID:(NSString *)nodeID
+{
+	return [[self directoryKeyPrefixForLocalUserID:localUserID] stringByAppendingString:nodeID];
+}
+
+@end
@@ -8,6 +8,7 @@
 **/
 
 #import "ZDCCloudDataInfo.h"
+#import "ZDCCompactCoding.h"
 
 // Encoding/Decoding Keys
 
@@ -22,6 +23,20 @@ static NSString *const k_thumbnailxxHash64 = @"thumbnailxxHash64";
 static NSString *const k_eTag              = @"eTag";
 static NSString *const k_lastModified      = @"lastModified";
 
+// Compact encoding tags
+
+enum {
+	kTag_metadataSize      = 1,
+	kTag_thumbnailSize     = 2,
+	kTag_dataSize          = 3,
+	kTag_thumbnailxxHash64 = 4,
+	kTag_eTag              = 5,
+	kTag_lastModified      = 6,
+};
+
+@interface ZDCCloudDataInfo () <ZDCCompactCoding>
+@end
+
 @implementation ZDCCloudDataInfo
 
 @synthesize metadataSize = metadataSize;
@@ -93,6 +108,42 @@ static NSString *const k_lastModified      = @"lastModified";
 	[coder encodeObject:lastModified forKey:k_lastModified];
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark ZDCCompactCoding
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (instancetype)initWithCompactDecoder:(ZDCCompactDecoder *)decoder
+{
+	if ((self = [super init]))
+	{
+		uint32_t tag = 0;
+		while ([decoder nextTag:&tag])
+		{
+			switch (tag)
+			{
+				case kTag_metadataSize      : metadataSize      = [decoder decodeUInt64]; break;
+				case kTag_thumbnailSize     : thumbnailSize     = [decoder decodeUInt64]; break;
+				case kTag_dataSize          : dataSize          = [decoder decodeUInt64]; break;
+				case kTag_thumbnailxxHash64 : thumbnailxxHash64 = [decoder decodeUInt64]; break;
+				case kTag_eTag              : eTag              = [decoder decodeString]; break;
+				case kTag_lastModified      : lastModified      = [decoder decodeDate]; break;
+				default                     : [decoder skipField]; break;
+			}
+		}
+	}
+	return self;
+}
+
+- (void)encodeWithCompactEncoder:(ZDCCompactEncoder *)encoder
+{
+	[encoder encodeUInt64:metadataSize      forTag:kTag_metadataSize];
+	[encoder encodeUInt64:thumbnailSize     forTag:kTag_thumbnailSize];
+	[encoder encodeUInt64:dataSize          forTag:kTag_dataSize];
+	[encoder encodeUInt64:thumbnailxxHash64 forTag:kTag_thumbnailxxHash64];
+	[encoder encodeString:eTag              forTag:kTag_eTag];
+	[encoder encodeDate:lastModified        forTag:kTag_lastModified];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark NSCopying
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
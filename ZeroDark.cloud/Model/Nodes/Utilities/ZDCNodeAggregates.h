@@ -0,0 +1,79 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Summary information about a node's subtree.
+ *
+ * The framework keeps these up-to-date as nodes are inserted, modified, moved & deleted.
+ * So you can answer questions such as "how many items are in this folder" or "how many bytes are in this folder",
+ * without having to enumerate (and deserialize) every node in the subtree.
+ *
+ * You can fetch the aggregates for a node via `-[ZDCNodeManager aggregatesForNodeID:transaction:]`.
+ *
+ * The ZDCNodeAggregates class is immutable.
+ */
+@interface ZDCNodeAggregates : NSObject <NSCoding, NSCopying>
+
+/**
+ * Creates a new instance using the given properties.
+ */
+- (instancetype)initWithParentID:(nullable NSString *)parentID
+                        dataSize:(uint64_t)dataSize
+              pendingUploadCount:(uint64_t)pendingUploadCount
+                 descendantCount:(uint64_t)descendantCount
+              descendantDataSize:(uint64_t)descendantDataSize
+    descendantPendingUploadCount:(uint64_t)descendantPendingUploadCount;
+
+/**
+ * The parentID of the node, at the time the aggregates were last updated.
+ */
+@property (nonatomic, copy, readonly, nullable) NSString *parentID;
+
+/**
+ * The size of the node's data in the cloud (i.e. `node.cloudDataInfo.dataSize`).
+ */
+@property (nonatomic, assign, readonly) uint64_t dataSize;
+
+/**
+ * The number of queued data uploads for the node.
+ */
+@property (nonatomic, assign, readonly) uint64_t pendingUploadCount;
+
+/**
+ * The number of descendants (children, grandchildren, etc).
+ */
+@property (nonatomic, assign, readonly) uint64_t descendantCount;
+
+/**
+ * The sum of `dataSize` for all descendants.
+ */
+@property (nonatomic, assign, readonly) uint64_t descendantDataSize;
+
+/**
+ * The sum of `pendingUploadCount` for all descendants.
+ */
+@property (nonatomic, assign, readonly) uint64_t descendantPendingUploadCount;
+
+/**
+ * Returns (dataSize + descendantDataSize).
+ */
+@property (nonatomic, readonly) uint64_t totalDataSize;
+
+/**
+ * Returns (pendingUploadCount + descendantPendingUploadCount).
+ */
+@property (nonatomic, readonly) uint64_t totalPendingUploadCount;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,155 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import "ZDCNodeAggregates.h"
+#import "ZDCCompactCoding.h"
+
+// Encoding/Decoding Keys
+
+static int const kCurrentVersion = 0;
+#pragma unused(kCurrentVersion)
+
+static NSString *const k_version                      = @"version";
+static NSString *const k_parentID                     = @"parentID";
+static NSString *const k_dataSize                     = @"dataSize";
+static NSString *const k_pendingUploadCount           = @"pendingUploadCount";
+static NSString *const k_descendantCount              = @"descendantCount";
+static NSString *const k_descendantDataSize           = @"descendantDataSize";
+static NSString *const k_descendantPendingUploadCount = @"descendantPendingUploadCount";
+
+// Compact encoding tags
+
+enum {
+	kTag_parentID                     = 1,
+	kTag_dataSize                     = 2,
+	kTag_pendingUploadCount           = 3,
+	kTag_descendantCount              = 4,
+	kTag_descendantDataSize           = 5,
+	kTag_descendantPendingUploadCount = 6,
+};
+
+@interface ZDCNodeAggregates () <ZDCCompactCoding>
+@end
+
+
+@implementation ZDCNodeAggregates
+
+@synthesize parentID = parentID;
+@synthesize dataSize = dataSize;
+@synthesize pendingUploadCount = pendingUploadCount;
+@synthesize descendantCount = descendantCount;
+@synthesize descendantDataSize = descendantDataSize;
+@synthesize descendantPendingUploadCount = descendantPendingUploadCount;
+
+@dynamic totalDataSize;
+@dynamic totalPendingUploadCount;
+
+- (instancetype)initWithParentID:(NSString *)inParentID
+                        dataSize:(uint64_t)inDataSize
+              pendingUploadCount:(uint64_t)inPendingUploadCount
+                 descendantCount:(uint64_t)inDescendantCount
+              descendantDataSize:(uint64_t)inDescendantDataSize
+    descendantPendingUploadCount:(uint64_t)inDescendantPendingUploadCount
+{
+	if ((self = [super init]))
+	{
+		parentID = [inParentID copy];
+		dataSize = inDataSize;
+		pendingUploadCount = inPendingUploadCount;
+		descendantCount = inDescendantCount;
+		descendantDataSize = inDescendantDataSize;
+		descendantPendingUploadCount = inDescendantPendingUploadCount;
+	}
+	return self;
+}
+
+#pragma mark NSCoding
+
+- (id)initWithCoder:(NSCoder *)decoder
+{
+	if ((self = [super init]))
+	{
+		parentID = [decoder decodeObjectForKey:k_parentID];
+		dataSize = (uint64_t)[decoder decodeInt64ForKey:k_dataSize];
+		pendingUploadCount = (uint64_t)[decoder decodeInt64ForKey:k_pendingUploadCount];
+		descendantCount = (uint64_t)[decoder decodeInt64ForKey:k_descendantCount];
+		descendantDataSize = (uint64_t)[decoder decodeInt64ForKey:k_descendantDataSize];
+		descendantPendingUploadCount = (uint64_t)[decoder decodeInt64ForKey:k_descendantPendingUploadCount];
+	}
+	return self;
+}
+
+- (void)encodeWithCoder:(NSCoder *)coder
+{
+	if (kCurrentVersion != 0) {
+		[coder encodeInt:kCurrentVersion forKey:k_version];
+	}
+	
+	[coder encodeObject:parentID forKey:k_parentID];
+	[coder encodeInt64:(int64_t)dataSize forKey:k_dataSize];
+	[coder encodeInt64:(int64_t)pendingUploadCount forKey:k_pendingUploadCount];
+	[coder encodeInt64:(int64_t)descendantCount forKey:k_descendantCount];
+	[coder encodeInt64:(int64_t)descendantDataSize forKey:k_descendantDataSize];
+	[coder encodeInt64:(int64_t)descendantPendingUploadCount forKey:k_descendantPendingUploadCount];
+}
+
+#pragma mark ZDCCompactCoding
+
+- (instancetype)initWithCompactDecoder:(ZDCCompactDecoder *)decoder
+{
+	if ((self = [super init]))
+	{
+		uint32_t tag = 0;
+		while ([decoder nextTag:&tag])
+		{
+			switch (tag)
+			{
+				case kTag_parentID                     : parentID = [decoder decodeString]; break;
+				case kTag_dataSize                     : dataSize = [decoder decodeUInt64]; break;
+				case kTag_pendingUploadCount           : pendingUploadCount = [decoder decodeUInt64]; break;
+				case kTag_descendantCount              : descendantCount = [decoder decodeUInt64]; break;
+				case kTag_descendantDataSize           : descendantDataSize = [decoder decodeUInt64]; break;
+				case kTag_descendantPendingUploadCount : descendantPendingUploadCount = [decoder decodeUInt64]; break;
+				default                                : [decoder skipField]; break;
+			}
+		}
+	}
+	return self;
+}
+
+- (void)encodeWithCompactEncoder:(ZDCCompactEncoder *)encoder
+{
+	[encoder encodeString:parentID forTag:kTag_parentID];
+	[encoder encodeUInt64:dataSize forTag:kTag_dataSize];
+	[encoder encodeUInt64:pendingUploadCount forTag:kTag_pendingUploadCount];
+	[encoder encodeUInt64:descendantCount forTag:kTag_descendantCount];
+	[encoder encodeUInt64:descendantDataSize forTag:kTag_descendantDataSize];
+	[encoder encodeUInt64:descendantPendingUploadCount forTag:kTag_descendantPendingUploadCount];
+}
+
+#pragma mark NSCopying
+
+- (id)copyWithZone:(NSZone *)zone
+{
+	return self; // immutable class
+}
+
+#pragma mark Convenience
+
+- (uint64_t)totalDataSize
+{
+	return dataSize + descendantDataSize;
+}
+
+- (uint64_t)totalPendingUploadCount
+{
+	return pendingUploadCount + descendantPendingUploadCount;
+}
+
+@end
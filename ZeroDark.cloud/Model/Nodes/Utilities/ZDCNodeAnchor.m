@@ -8,6 +8,7 @@
 **/
 
 #import "ZDCNodeAnchor.h"
+#import "ZDCCompactCoding.h"
 
 // Encoding/Decoding Keys
 
@@ -19,6 +20,17 @@ static NSString *const k_userID    = @"userID";
 static NSString *const k_treeID    = @"treeID";
 static NSString *const k_dirPrefix = @"dirPrefix";
 
+// Compact encoding tags
+
+enum {
+	kTag_userID    = 1,
+	kTag_treeID    = 2,
+	kTag_dirPrefix = 3,
+};
+
+@interface ZDCNodeAnchor () <ZDCCompactCoding>
+@end
+
 
 @implementation ZDCNodeAnchor
 
@@ -61,6 +73,34 @@ static NSString *const k_dirPrefix = @"dirPrefix";
 	[coder encodeObject:dirPrefix forKey:k_dirPrefix];
 }
 
+#pragma mark ZDCCompactCoding
+
+- (instancetype)initWithCompactDecoder:(ZDCCompactDecoder *)decoder
+{
+	if ((self = [super init]))
+	{
+		uint32_t tag = 0;
+		while ([decoder nextTag:&tag])
+		{
+			switch (tag)
+			{
+				case kTag_userID    : userID = [decoder decodeString]; break;
+				case kTag_treeID    : treeID = [decoder decodeString]; break;
+				case kTag_dirPrefix : dirPrefix = [decoder decodeString]; break;
+				default             : [decoder skipField]; break;
+			}
+		}
+	}
+	return self;
+}
+
+- (void)encodeWithCompactEncoder:(ZDCCompactEncoder *)encoder
+{
+	[encoder encodeString:userID forTag:kTag_userID];
+	[encoder encodeString:treeID forTag:kTag_treeID];
+	[encoder encodeString:dirPrefix forTag:kTag_dirPrefix];
+}
+
 #pragma mark NSCopying
 
 - (id)copyWithZone:(NSZone *)zone
@@ -9,6 +9,7 @@
 
 #import "ZDCShareItemPrivate.h"
 
+#import "ZDCCompactCoding.h"
 #import "ZDCObjectSubclass.h"
 #import "ZDCDictionary.h"
 #import "ZDCConstantsPrivate.h"
@@ -22,6 +23,18 @@ static NSString *const k_version   = @"version";
 static NSString *const k_dict      = @"dict";
 static NSString *const k_canAddKey = @"canAddKey";
 
+// Compact encoding tags
+
+enum {
+	kTag_canAddKey     = 1,
+	kTag_key           = 2, // repeated: each key is followed by its value
+	kTag_stringValue   = 3,
+	kTag_archivedValue = 4,
+};
+
+
+@interface ZDCShareItem () <ZDCCompactCoding>
+@end
 
 @implementation ZDCShareItem {
 	
@@ -91,6 +104,74 @@ static NSString *const k_canAddKey = @"canAddKey";
 	[coder encodeBool:canAddKey forKey:k_canAddKey];
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark ZDCCompactCoding
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (instancetype)initWithCompactDecoder:(ZDCCompactDecoder *)decoder
+{
+	if ((self = [super init]))
+	{
+		dict = [[ZDCDictionary alloc] init];
+		
+		NSString *key = nil;
+		
+		uint32_t tag = 0;
+		while ([decoder nextTag:&tag])
+		{
+			switch (tag)
+			{
+				case kTag_canAddKey:
+				{
+					canAddKey = [decoder decodeBool];
+					break;
+				}
+				case kTag_key:
+				{
+					key = [decoder decodeString];
+					break;
+				}
+				case kTag_stringValue:
+				case kTag_archivedValue:
+				{
+					id value = (tag == kTag_stringValue) ? [decoder decodeString] : [decoder decodeArchivedObject];
+					if (key && value) {
+						dict[key] = value;
+					}
+					key = nil;
+					break;
+				}
+				default:
+				{
+					[decoder skipField];
+					break;
+				}
+			}
+		}
+		
+		[dict clearChangeTracking];
+	}
+	return self;
+}
+
+- (void)encodeWithCompactEncoder:(ZDCCompactEncoder *)encoder
+{
+	[encoder encodeBool:canAddKey forTag:kTag_canAddKey];
+	
+	// Values are almost always strings (perms, key, pubKeyID).
+	// Anything else is archived.
+	
+	[dict enumerateKeysAndObjectsUsingBlock:^(NSString *key, id value, BOOL *stop) {
+		
+		[encoder encodeString:key forTag:kTag_key];
+		
+		if ([value isKindOfClass:[NSString class]])
+			[encoder encodeString:(NSString *)value forTag:kTag_stringValue];
+		else
+			[encoder encodeArchivedObject:value forTag:kTag_archivedValue];
+	}];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark NSCopying
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -9,6 +9,7 @@
 
 #import "ZDCShareList.h"
 
+#import "ZDCCompactCoding.h"
 #import "ZDCObjectSubclass.h"
 #import "ZDCDictionary.h"
 #import "ZDCConstantsPrivate.h"
@@ -21,6 +22,13 @@ static int const kCurrentVersion = 2;
 static NSString *const k_version = @"version";
 static NSString *const k_dict    = @"dict";
 
+// Compact encoding tags
+
+enum {
+	kTag_key  = 1, // repeated: each key is followed by its item
+	kTag_item = 2,
+};
+
 // Extern Constants
 
 /* extern */ NSString *const ZDCShareKeyType_User       = @"UID";
@@ -28,6 +36,9 @@ static NSString *const k_dict    = @"dict";
 /* extern */ NSString *const ZDCShareKeyType_Passphrase = @"PASS";
 
 
+@interface ZDCShareList () <ZDCCompactCoding>
+@end
+
 @implementation ZDCShareList {
 	
 	ZDCDictionary<NSString*, ZDCShareItem*> *dict;
@@ -97,6 +108,59 @@ static NSString *const k_dict    = @"dict";
 	[coder encodeObject:dict forKey:k_dict];
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark ZDCCompactCoding
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (instancetype)initWithCompactDecoder:(ZDCCompactDecoder *)decoder
+{
+	if ((self = [super init]))
+	{
+		dict = [[ZDCDictionary alloc] init];
+		
+		NSString *key = nil;
+		
+		uint32_t tag = 0;
+		while ([decoder nextTag:&tag])
+		{
+			switch (tag)
+			{
+				case kTag_key:
+				{
+					key = [decoder decodeString];
+					break;
+				}
+				case kTag_item:
+				{
+					ZDCShareItem *item = [decoder decodeObjectOfClass:[ZDCShareItem class]];
+					if (key && item) {
+						dict[key] = item;
+					}
+					key = nil;
+					break;
+				}
+				default:
+				{
+					[decoder skipField];
+					break;
+				}
+			}
+		}
+		
+		[dict clearChangeTracking];
+	}
+	return self;
+}
+
+- (void)encodeWithCompactEncoder:(ZDCCompactEncoder *)encoder
+{
+	[dict enumerateKeysAndObjectsUsingBlock:^(NSString *key, ZDCShareItem *item, BOOL *stop) {
+		
+		[encoder encodeString:key forTag:kTag_key];
+		[encoder encodeObject:(id<ZDCCompactCoding>)item forTag:kTag_item];
+	}];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark NSCopying
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -9,6 +9,7 @@
 
 #import "ZDCNodePrivate.h"
 #import "ZDCConstants.h"
+#import "ZDCCompactCoding.h"
 
 #import "NSData+S4.h"
 #import "NSDate+ZeroDark.h"
@@ -41,6 +42,34 @@ static NSString *const k_explicitCloudName     = @"explicitCloudName";
 static NSString *const k_anchor                = @"anchor";
 static NSString *const k_pointeeID             = @"pointeeID";
 
+// Compact Encoding Tags
+
+enum {
+	kTag_uuid              = 1,
+	kTag_localUserID       = 2,
+	kTag_parentID          = 3,
+	kTag_name              = 4,
+	kTag_shareList         = 5,
+	kTag_burnDate          = 6,
+	kTag_senderID          = 7,
+	kTag_pendingRecipient  = 8, // repeated
+	kTag_encryptionKey     = 9,
+	kTag_dirSalt           = 10,
+	kTag_dirPrefix         = 11,
+	kTag_cloudID           = 12,
+	kTag_eTag_rcrd         = 13,
+	kTag_eTag_data         = 14,
+	kTag_lastModified_rcrd = 15,
+	kTag_lastModified_data = 16,
+	kTag_cloudDataInfo     = 17,
+	kTag_explicitCloudName = 18,
+	kTag_anchor            = 19,
+	kTag_pointeeID         = 20,
+};
+
+@interface ZDCNode () <ZDCCompactCoding>
+@end
+
 
 @implementation ZDCNode
 
@@ -194,6 +223,104 @@ static NSString *const k_pointeeID             = @"pointeeID";
 	[coder encodeObject:pointeeID         forKey:k_pointeeID];
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark ZDCCompactCoding
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Used by the database serializer (see ZDCDatabaseManager).
+ * The NSCoding implementation above is still used for subclasses, and for reading older databases.
+**/
+
+- (instancetype)initWithCompactDecoder:(ZDCCompactDecoder *)decoder
+{
+	if ((self = [super init]))
+	{
+		NSMutableSet<NSString*> *_pendingRecipients = nil;
+		
+		uint32_t tag = 0;
+		while ([decoder nextTag:&tag])
+		{
+			switch (tag)
+			{
+				case kTag_uuid        : uuid        = [decoder decodeString]; break;
+				case kTag_localUserID : localUserID = [decoder decodeString]; break;
+				case kTag_parentID    : parentID    = [decoder decodeString]; break;
+				case kTag_name        : name        = [decoder decodeString]; break;
+				case kTag_shareList   : shareList   = [decoder decodeObjectOfClass:[ZDCShareList class]]; break;
+				case kTag_burnDate    : burnDate    = [decoder decodeDate]; break;
+				
+				case kTag_senderID : senderID = [decoder decodeString]; break;
+				case kTag_pendingRecipient :
+				{
+					NSString *recipient = [decoder decodeString];
+					if (recipient)
+					{
+						if (_pendingRecipients == nil) {
+							_pendingRecipients = [[NSMutableSet alloc] init];
+						}
+						[_pendingRecipients addObject:recipient];
+					}
+					break;
+				}
+				
+				case kTag_encryptionKey : encryptionKey = [decoder decodeData]; break;
+				case kTag_dirSalt       : dirSalt       = [decoder decodeData]; break;
+				case kTag_dirPrefix     : dirPrefix     = [decoder decodeString]; break;
+				
+				case kTag_cloudID           : cloudID           = [decoder decodeString]; break;
+				case kTag_eTag_rcrd         : eTag_rcrd         = [decoder decodeString]; break;
+				case kTag_eTag_data         : eTag_data         = [decoder decodeString]; break;
+				case kTag_lastModified_rcrd : lastModified_rcrd = [decoder decodeDate]; break;
+				case kTag_lastModified_data : lastModified_data = [decoder decodeDate]; break;
+				case kTag_cloudDataInfo     : cloudDataInfo     = [decoder decodeObjectOfClass:[ZDCCloudDataInfo class]]; break;
+				case kTag_explicitCloudName : explicitCloudName = [decoder decodeString]; break;
+				case kTag_anchor            : anchor            = [decoder decodeObjectOfClass:[ZDCNodeAnchor class]]; break;
+				case kTag_pointeeID         : pointeeID         = [decoder decodeString]; break;
+				
+				default : [decoder skipField]; break;
+			}
+		}
+		
+		pendingRecipients = [_pendingRecipients copy];
+		
+		if (shareList == nil) {
+			shareList = [[ZDCShareList alloc] init];
+		}
+	}
+	return self;
+}
+
+- (void)encodeWithCompactEncoder:(ZDCCompactEncoder *)encoder
+{
+	[encoder encodeString:uuid        forTag:kTag_uuid];
+	[encoder encodeString:localUserID forTag:kTag_localUserID];
+	[encoder encodeString:parentID    forTag:kTag_parentID];
+	[encoder encodeString:name        forTag:kTag_name];
+	[encoder encodeObject:(id<ZDCCompactCoding>)shareList forTag:kTag_shareList];
+	[encoder encodeDate:burnDate      forTag:kTag_burnDate];
+	
+	[encoder encodeString:senderID forTag:kTag_senderID];
+	for (NSString *recipient in pendingRecipients)
+	{
+		[encoder encodeString:recipient forTag:kTag_pendingRecipient];
+	}
+	
+	[encoder encodeData:encryptionKey forTag:kTag_encryptionKey];
+	[encoder encodeData:dirSalt       forTag:kTag_dirSalt];
+	[encoder encodeString:dirPrefix   forTag:kTag_dirPrefix];
+	
+	[encoder encodeString:cloudID           forTag:kTag_cloudID];
+	[encoder encodeString:eTag_rcrd         forTag:kTag_eTag_rcrd];
+	[encoder encodeString:eTag_data         forTag:kTag_eTag_data];
+	[encoder encodeDate:lastModified_rcrd   forTag:kTag_lastModified_rcrd];
+	[encoder encodeDate:lastModified_data   forTag:kTag_lastModified_data];
+	[encoder encodeObject:(id<ZDCCompactCoding>)cloudDataInfo forTag:kTag_cloudDataInfo];
+	[encoder encodeString:explicitCloudName forTag:kTag_explicitCloudName];
+	[encoder encodeObject:(id<ZDCCompactCoding>)anchor forTag:kTag_anchor];
+	[encoder encodeString:pointeeID         forTag:kTag_pointeeID];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark NSCopying
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
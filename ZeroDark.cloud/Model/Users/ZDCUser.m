@@ -10,6 +10,7 @@
 #import "ZDCUserPrivate.h"
 
 #import "Auth0Utilities.h"
+#import "ZDCCompactCoding.h"
 #import "NSData+S4.h"
 #import "NSString+ZeroDark.h"
 
@@ -36,6 +37,27 @@ static NSString *const k_preferredIdentityID    = @"preferedAuth0ID";  // histor
 
 static NSString *const kDeprecated_auth0_profiles = @"auth0_profiles";
 
+// Compact encoding tags
+
+enum {
+	kTag_uuid                   = 1,
+	kTag_publicKeyID            = 2,
+	kTag_blockchainProof        = 3, // archived
+	kTag_random_uuid            = 4,
+	kTag_random_encryptionKey   = 5,
+	kTag_aws_regionStr          = 6,
+	kTag_aws_bucket             = 7,
+	kTag_accountBlocked         = 8,
+	kTag_accountDeleted         = 9,
+	kTag_lastRefresh_profile    = 10,
+	kTag_lastRefresh_blockchain = 11,
+	kTag_identities             = 12, // archived
+	kTag_preferredIdentityID    = 13,
+};
+
+@interface ZDCUser () <ZDCCompactCoding>
+@end
+
 // Extern constants
 
 /* extern */ NSString *const kZDCAnonymousUserID = @"anonymoususerid1"; // must be 16 characters & zBase32
@@ -198,6 +220,82 @@ static NSString *const kDeprecated_auth0_profiles = @"auth0_profiles";
 	[coder encodeObject:preferredIdentityID forKey:k_preferredIdentityID];
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark ZDCCompactCoding
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Used by the database serializer (see ZDCDatabaseManager).
+// The blockchainProof & identities are small & infrequently read, so they're simply archived.
+
+- (instancetype)initWithCompactDecoder:(ZDCCompactDecoder *)decoder
+{
+	if ((self = [super init]))
+	{
+		aws_region = AWSRegion_Invalid; // region tag is omitted if invalid
+		
+		uint32_t tag = 0;
+		while ([decoder nextTag:&tag])
+		{
+			switch (tag)
+			{
+				case kTag_uuid : uuid = [decoder decodeString]; break;
+				
+				case kTag_publicKeyID     : publicKeyID = [decoder decodeString]; break;
+				case kTag_blockchainProof : blockchainProof = [decoder decodeArchivedObject]; break;
+				
+				case kTag_random_uuid          : random_uuid = [decoder decodeString]; break;
+				case kTag_random_encryptionKey : random_encryptionKey = [decoder decodeData]; break;
+				
+				case kTag_aws_regionStr : aws_region = [AWSRegions regionForName:[decoder decodeString]]; break;
+				case kTag_aws_bucket    : aws_bucket = [decoder decodeString]; break;
+				
+				case kTag_accountBlocked         : accountBlocked = [decoder decodeBool]; break;
+				case kTag_accountDeleted         : accountDeleted = [decoder decodeBool]; break;
+				case kTag_lastRefresh_profile    : lastRefresh_profile = [decoder decodeDate]; break;
+				case kTag_lastRefresh_blockchain : lastRefresh_blockchain = [decoder decodeDate]; break;
+				
+				case kTag_identities          : identities = [decoder decodeArchivedObject]; break;
+				case kTag_preferredIdentityID : preferredIdentityID = [decoder decodeString]; break;
+				
+				default : [decoder skipField]; break;
+			}
+		}
+		
+		// Sanitation (same as initWithCoder)
+		
+		if (!lastRefresh_profile) {
+			lastRefresh_profile = [NSDate dateWithTimeIntervalSinceReferenceDate:0];
+		}
+		
+		if (!lastRefresh_blockchain) {
+			lastRefresh_blockchain = [NSDate dateWithTimeIntervalSinceReferenceDate:0];
+		}
+	}
+	return self;
+}
+
+- (void)encodeWithCompactEncoder:(ZDCCompactEncoder *)encoder
+{
+	[encoder encodeString:uuid forTag:kTag_uuid];
+	
+	[encoder encodeString:publicKeyID forTag:kTag_publicKeyID];
+	[encoder encodeArchivedObject:blockchainProof forTag:kTag_blockchainProof];
+	
+	[encoder encodeString:random_uuid        forTag:kTag_random_uuid];
+	[encoder encodeData:random_encryptionKey forTag:kTag_random_encryptionKey];
+	
+	[encoder encodeString:[AWSRegions shortNameForRegion:aws_region] forTag:kTag_aws_regionStr];
+	[encoder encodeString:aws_bucket forTag:kTag_aws_bucket];
+	
+	[encoder encodeBool:accountBlocked forTag:kTag_accountBlocked];
+	[encoder encodeBool:accountDeleted forTag:kTag_accountDeleted];
+	[encoder encodeDate:lastRefresh_profile forTag:kTag_lastRefresh_profile];
+	[encoder encodeDate:lastRefresh_blockchain forTag:kTag_lastRefresh_blockchain];
+	
+	[encoder encodeArchivedObject:identities forTag:kTag_identities];
+	[encoder encodeString:preferredIdentityID forTag:kTag_preferredIdentityID];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark NSCopying
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
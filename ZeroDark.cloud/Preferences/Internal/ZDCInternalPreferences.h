@@ -34,6 +34,12 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property (atomic, nullable) NSArray<NSString *> *recentRecipients;
 
+/**
+ * Used by the DiskManager.
+ * Keys the content digests used to deduplicate cached files. (Generated on first use.)
+ */
+@property (atomic, nullable) NSData *diskManager_dedupeSecret;
+
 - (void)addRecentRecipient:(NSString *)userID;
 - (void)removeRecentRecipient:(NSString *)userID;
 
@@ -17,6 +17,7 @@
 NSString *const k_activityMonitor_lastActivityType  = @"lastActivityType";
 NSString *const k_lastProviderTableUpdate           = @"lastProviderTableUpdate";
 NSString *const k_recentRecipients                  = @"recentRecipients_2";
+NSString *const k_diskManager_dedupeSecret          = @"diskManager_dedupeSecret";
 
 - (instancetype)init
 {
@@ -132,5 +133,18 @@ NSString *const k_recentRecipients                  = @"recentRecipients_2";
 	[self setObject:[newRecents copy] forKey:k_recentRecipients];
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark diskManager_dedupeSecret
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+@dynamic diskManager_dedupeSecret;
+
+- (NSData *)diskManager_dedupeSecret
+{
+	return [self dataForKey:k_diskManager_dedupeSecret];
+}
+- (void)setDiskManager_dedupeSecret:(NSData *)secret
+{
+	[self setObject:secret forKey:k_diskManager_dedupeSecret];
+}
 
 @end
@@ -67,8 +67,26 @@
 		NSParameterAssert(cryptoFile.fileFormat == ZDCCryptoFileFormat_CacheFile);
 	}
 	
-	self = [self initWithCacheFileURL: cryptoFile.fileURL
-	                    encryptionKey: cryptoFile.encryptionKey];
+	if (cryptoFile.isPacked)
+	{
+		// The file is packed into a slab (e.g. a small thumbnail).
+		// So we read from the mapped range instead.
+		
+		NSError *error = nil;
+		NSData *packedData = [cryptoFile readPackedData:&error];
+		
+		if (packedData == nil) {
+			ZDCLogError(@"Error reading packed cryptoFile: %@", error);
+		}
+		
+		self = [self initWithCacheFileData: (packedData ?: [NSData data])
+		                     encryptionKey: cryptoFile.encryptionKey];
+	}
+	else
+	{
+		self = [self initWithCacheFileURL: cryptoFile.fileURL
+		                    encryptionKey: cryptoFile.encryptionKey];
+	}
 	
 	if (self)
 	{
@@ -241,6 +259,11 @@
 				newInputStream = [NSInputStream inputStreamWithURL:cacheFileURL];
 				newInputStream.delegate = self;
 			}
+			else if (cacheFileData)
+			{
+				newInputStream = [NSInputStream inputStreamWithData:cacheFileData];
+				newInputStream.delegate = self;
+			}
 			else if ([inputStream conformsToProtocol:@protocol(NSCopying)])
 			{
 				newInputStream = [inputStream copy];
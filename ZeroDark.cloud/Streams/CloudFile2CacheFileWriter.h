@@ -0,0 +1,85 @@
+/**
+ * ZeroDark.cloud
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import <Foundation/Foundation.h>
+
+#import "ZDCCloudFileHeader.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Converts from cloudFile (encrypted) format to cacheFile (encrypted) format, incrementally.
+ *
+ * The input is pushed into the writer as it becomes available (e.g. as bytes arrive from the network).
+ * Each chunk is decrypted, the header/metadata/thumbnail sections are stripped,
+ * and the data section is immediately re-encrypted into the cache file.
+ * So once the last byte of the cloudFile has been written, the cache file is complete,
+ * and there's no need for a separate conversion pass over the file.
+ *
+ * The metadata & thumbnail sections are discarded.
+ *
+ * The cache file is encrypted with the same key as the cloud file.
+ *
+ * This class is NOT thread-safe.
+ */
+@interface CloudFile2CacheFileWriter : NSObject
+
+/**
+ * Creates (or truncates) the file at the given URL.
+ *
+ * @param cacheFileURL
+ *   Where to write the cache file.
+ *
+ * @param encryptionKey
+ *   The key used to encrypt the cloudFile, which is also used to encrypt the cacheFile.
+ */
+- (instancetype)initWithCacheFileURL:(NSURL *)cacheFileURL
+                       encryptionKey:(NSData *)encryptionKey;
+
+/** The output file. */
+@property (nonatomic, readonly) NSURL *cacheFileURL;
+
+/**
+ * Set to YES as soon as the cloudFile header has been decrypted.
+ * (Which happens after writing the first 64 bytes.)
+ */
+@property (nonatomic, readonly) BOOL hasCloudFileHeader;
+
+/**
+ * The decrypted cloudFile header.
+ * Only valid if `hasCloudFileHeader` is YES.
+ */
+@property (nonatomic, readonly) ZDCCloudFileHeader cloudFileHeader;
+
+/** The number of cloudFile bytes that have been written to the receiver. */
+@property (nonatomic, readonly) uint64_t cloudFileBytesWritten;
+
+/**
+ * Decrypts/re-encrypts as much of the given data as possible,
+ * and buffers whatever remains (less than a single cipher block).
+ *
+ * @return YES on success, NO on failure. After a failure, the writer should be aborted.
+ */
+- (BOOL)writeCloudFileData:(NSData *)data error:(NSError *_Nullable *_Nullable)errorPtr;
+
+/**
+ * Appends the padding, and closes the cache file.
+ *
+ * Fails if the cloudFile was truncated (i.e. the data section wasn't received in full).
+ */
+- (BOOL)finish:(NSError *_Nullable *_Nullable)errorPtr;
+
+/**
+ * Closes & deletes the (partial) cache file.
+ */
+- (void)abort;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,482 @@
+/**
+ * ZeroDark.cloud
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import "CloudFile2CacheFileWriter.h"
+
+#import "ZDCCacheFileHeader.h"
+#import "ZDCConstants.h"
+#import "ZDCLogging.h"
+
+#import "NSError+POSIX.h"
+#import "NSError+S4.h"
+#import "NSError+ZeroDark.h"
+
+#import <S4Crypto/S4Crypto.h>
+#import <fcntl.h>
+#import <unistd.h>
+
+#if DEBUG
+  static const int zdcLogLevel = ZDCLogLevelWarning;
+#else
+  static const int zdcLogLevel = ZDCLogLevelWarning;
+#endif
+#pragma unused(zdcLogLevel)
+
+#define CKS4ERR  if ((err != kS4Err_NoErr)) { goto done; }
+
+static size_t const kOutBufferSize = (1024 * 64); // must be a multiple of every supported keyLength
+static size_t const kMaxKeyLength = 128;           // Threefish-1024
+
+
+@implementation CloudFile2CacheFileWriter
+{
+	NSData *             encryptionKey;
+	NSUInteger           keyLength;
+	
+	int                  fd;
+	BOOL                 isClosed;
+	
+	TBC_ContextRef       decryptTBC;
+	TBC_ContextRef       encryptTBC;
+	
+	uint8_t *            inBuffer;           // ciphertext that doesn't yet fill a cipher block
+	NSUInteger           inBufferLength;
+	uint64_t             totalBytesDecrypted;
+	
+	uint8_t              headerBuffer[sizeof(ZDCCloudFileHeader)];
+	NSUInteger           headerBufferLength;
+	
+	uint64_t             dataSectionStart;   // offset within the (cleartext) cloudFile
+	uint64_t             dataSectionEnd;
+	
+	uint8_t *            cacheBuffer;        // cleartext that doesn't yet fill a cipher block
+	NSUInteger           cacheBufferLength;
+	uint64_t             totalBytesEncrypted;
+	
+	uint8_t *            outBuffer;          // ciphertext waiting to be written to disk
+	size_t               outBufferLength;
+}
+
+@synthesize cacheFileURL = cacheFileURL;
+@synthesize hasCloudFileHeader = hasCloudFileHeader;
+@synthesize cloudFileHeader = cloudFileHeader;
+@synthesize cloudFileBytesWritten = cloudFileBytesWritten;
+
++ (Cipher_Algorithm)cipherAlgorithm:(NSData *)encryptionKey
+{
+	switch (encryptionKey.length * 8) // numBytes * 8 = numBits
+	{
+		case 256  : return kCipher_Algorithm_3FISH256;
+		case 512  : return kCipher_Algorithm_3FISH512;
+		case 1024 : return kCipher_Algorithm_3FISH1024;
+		default   : return kCipher_Algorithm_Invalid;
+	}
+}
+
+- (instancetype)initWithCacheFileURL:(NSURL *)inCacheFileURL
+                       encryptionKey:(NSData *)inEncryptionKey
+{
+	if ((self = [super init]))
+	{
+		cacheFileURL = [inCacheFileURL copy];
+		encryptionKey = [inEncryptionKey copy];
+		keyLength = encryptionKey.length;
+		
+		decryptTBC = kInvalidTBC_ContextRef;
+		encryptTBC = kInvalidTBC_ContextRef;
+		
+		fd = open([cacheFileURL.path fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		
+		if (keyLength > 0)
+		{
+			inBuffer = malloc(keyLength);
+			cacheBuffer = malloc(keyLength);
+		}
+		outBuffer = malloc(kOutBufferSize);
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	[self close];
+	
+	if (inBuffer) {
+		ZERO(inBuffer, keyLength);
+		free(inBuffer);
+	}
+	if (cacheBuffer) {
+		ZERO(cacheBuffer, keyLength);
+		free(cacheBuffer);
+	}
+	if (outBuffer) {
+		free(outBuffer);
+	}
+	
+	ZERO(headerBuffer, sizeof(headerBuffer));
+}
+
+- (void)close
+{
+	if (fd >= 0)
+	{
+		close(fd);
+		fd = -1;
+	}
+	
+	if (TBC_ContextRefIsValid(decryptTBC)) {
+		TBC_Free(decryptTBC);
+		decryptTBC = kInvalidTBC_ContextRef;
+	}
+	if (TBC_ContextRefIsValid(encryptTBC)) {
+		TBC_Free(encryptTBC);
+		encryptTBC = kInvalidTBC_ContextRef;
+	}
+	
+	isClosed = YES;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Public API
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (BOOL)writeCloudFileData:(NSData *)data error:(NSError **)errorPtr
+{
+	NSError *error = [self checkState];
+	if (error)
+	{
+		if (errorPtr) *errorPtr = error;
+		return NO;
+	}
+	
+	const uint8_t *bytes = data.bytes;
+	NSUInteger length = data.length;
+	NSUInteger offset = 0;
+	
+	cloudFileBytesWritten += length;
+	
+	while (offset < length)
+	{
+		if ((inBufferLength == 0) && ((length - offset) >= keyLength))
+		{
+			// Decrypt directly from the given data
+			
+			error = [self decryptBlock:(bytes + offset)];
+			offset += keyLength;
+		}
+		else
+		{
+			NSUInteger bytesToCopy = MIN(keyLength - inBufferLength, length - offset);
+			
+			memcpy(inBuffer + inBufferLength, bytes + offset, bytesToCopy);
+			inBufferLength += bytesToCopy;
+			offset += bytesToCopy;
+			
+			if (inBufferLength == keyLength)
+			{
+				error = [self decryptBlock:inBuffer];
+				inBufferLength = 0;
+			}
+		}
+		
+		if (error) break;
+	}
+	
+	if (errorPtr) *errorPtr = error;
+	return (error == nil);
+}
+
+- (BOOL)finish:(NSError **)errorPtr
+{
+	NSError *error = [self checkState];
+	
+	if (!error && (!hasCloudFileHeader || (totalBytesDecrypted < dataSectionEnd) || (inBufferLength > 0)))
+	{
+		error = [NSError errorWithClass:[self class] code:400 description:@"Incomplete cloudFile"];
+	}
+	
+	if (!error)
+	{
+		// We always force padding at the end of the file.
+		// This matches Cleartext2CacheFileInputStream.
+		
+		NSUInteger padLength = keyLength - (NSUInteger)((sizeof(ZDCCacheFileHeader) + cloudFileHeader.dataSize) % keyLength);
+		
+		NSUInteger padNumber = padLength;
+		while (padNumber > UINT8_MAX) {
+			padNumber -= UINT8_MAX;
+		}
+		
+		uint8_t pad[kMaxKeyLength];
+		NSAssert(padLength <= sizeof(pad), @"Unexpected keyLength");
+		
+		uint8_t *p = pad;
+		S4_StorePad((uint8_t)padNumber, padLength, &p);
+		
+		error = [self appendCacheFileBytes:pad length:padLength];
+	}
+	
+	if (!error)
+	{
+		NSAssert(cacheBufferLength == 0, @"Cache file isn't aligned to the cipher block size");
+		
+		error = [self flush];
+	}
+	
+	if (error)
+	{
+		[self abort];
+		
+		if (errorPtr) *errorPtr = error;
+		return NO;
+	}
+	
+	[self close];
+	
+	if (errorPtr) *errorPtr = nil;
+	return YES;
+}
+
+- (void)abort
+{
+	[self close];
+	
+	[[NSFileManager defaultManager] removeItemAtURL:cacheFileURL error:nil];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Internal
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSError *)checkState
+{
+	if (isClosed) {
+		return [NSError errorWithClass:[self class] code:400 description:@"Writer is closed"];
+	}
+	if (fd < 0) {
+		return [NSError errorWithPOSIXCode:EBADF];
+	}
+	if ([[self class] cipherAlgorithm:encryptionKey] == kCipher_Algorithm_Invalid) {
+		return [NSError errorWithClass:[self class] code:400 description:@"Unsupported encryptionKey length"];
+	}
+	
+	return nil;
+}
+
+/**
+ * Decrypts a single cipher block (keyLength bytes) of the cloudFile,
+ * and then forwards whatever belongs in the cache file.
+ */
+- (NSError *)decryptBlock:(const uint8_t *)cipherBlock
+{
+	S4Err err = kS4Err_NoErr;
+	NSError *error = nil;
+	
+	uint8_t *block = alloca(keyLength);
+	
+	// Set/Reset Tweakable Block Cipher (TBC) if:
+	//
+	// - we're on a block boundary
+	// - we just initialized the TBC
+	//
+	BOOL needsSetTweak = NO;
+	if (!TBC_ContextRefIsValid(decryptTBC))
+	{
+		err = TBC_Init([[self class] cipherAlgorithm:encryptionKey], encryptionKey.bytes, keyLength, &decryptTBC); CKS4ERR;
+		needsSetTweak = YES;
+	}
+	else
+	{
+		needsSetTweak = ((totalBytesDecrypted % kZDCNode_TweakBlockSizeInBytes) == 0);
+	}
+	
+	if (needsSetTweak)
+	{
+		uint64_t tweakBlockNum = (uint64_t)(totalBytesDecrypted / kZDCNode_TweakBlockSizeInBytes);
+		uint64_t tweak[2] = {tweakBlockNum, 0};
+		
+		err = TBC_SetTweek(decryptTBC, tweak, sizeof(tweak)); CKS4ERR;
+	}
+	
+	err = TBC_Decrypt(decryptTBC, cipherBlock, block); CKS4ERR;
+	
+	{ // Process the cleartext
+	
+		uint64_t blockStart = totalBytesDecrypted;
+		uint64_t blockEnd = blockStart + keyLength;
+		
+		totalBytesDecrypted += keyLength;
+		
+		if (!hasCloudFileHeader)
+		{
+			NSUInteger bytesToCopy = MIN(keyLength, sizeof(headerBuffer) - headerBufferLength);
+			
+			memcpy(headerBuffer + headerBufferLength, block, bytesToCopy);
+			headerBufferLength += bytesToCopy;
+			
+			if (headerBufferLength == sizeof(headerBuffer))
+			{
+				error = [self parseHeader];
+				if (error) goto done;
+			}
+		}
+		
+		if (hasCloudFileHeader)
+		{
+			uint64_t start = MAX(blockStart, dataSectionStart);
+			uint64_t end = MIN(blockEnd, dataSectionEnd);
+			
+			if (start < end)
+			{
+				error = [self appendCacheFileBytes: block + (start - blockStart)
+				                            length: (NSUInteger)(end - start)];
+			}
+		}
+	}
+
+done:
+
+	ZERO(block, keyLength);
+	
+	if (err != kS4Err_NoErr) {
+		error = [NSError errorWithS4Error:err];
+	}
+	
+	return error;
+}
+
+- (NSError *)parseHeader
+{
+	uint8_t *p = headerBuffer;
+	
+	cloudFileHeader.magic = S4_Load64(&p);
+	if (cloudFileHeader.magic != kZDCCloudFileContextMagic)
+	{
+		return [NSError errorWithClass:[self class] code:400 description:@"File signature incorrect."];
+	}
+	
+	cloudFileHeader.metadataSize  = S4_Load64(&p);
+	cloudFileHeader.thumbnailSize = S4_Load64(&p);
+	cloudFileHeader.dataSize      = S4_Load64(&p);
+	
+	cloudFileHeader.thumbnailxxHash64 = S4_Load64(&p);
+	
+	cloudFileHeader.version = S4_Load8(&p);
+	
+	hasCloudFileHeader = YES;
+	
+	dataSectionStart = sizeof(ZDCCloudFileHeader) + cloudFileHeader.metadataSize + cloudFileHeader.thumbnailSize;
+	dataSectionEnd = dataSectionStart + cloudFileHeader.dataSize;
+	
+	// The cache file starts with its own header
+	
+	uint8_t cacheFileHeader[sizeof(ZDCCacheFileHeader)];
+	p = cacheFileHeader;
+	
+	S4_Store64(kZDCCacheFileContextMagic,      &p);
+	S4_Store64(cloudFileHeader.dataSize,       &p);
+	S4_StorePad(0, kZDCCacheFileReservedBytes, &p); // reserved
+	
+	return [self appendCacheFileBytes:cacheFileHeader length:sizeof(cacheFileHeader)];
+}
+
+/**
+ * Encrypts the given cleartext (in cacheFile format), buffering whatever doesn't fill a cipher block.
+ */
+- (NSError *)appendCacheFileBytes:(const uint8_t *)bytes length:(NSUInteger)length
+{
+	S4Err err = kS4Err_NoErr;
+	NSError *error = nil;
+	
+	NSUInteger offset = 0;
+	while (offset < length)
+	{
+		const uint8_t *src = NULL;
+		
+		if ((cacheBufferLength == 0) && ((length - offset) >= keyLength))
+		{
+			src = bytes + offset;
+			offset += keyLength;
+		}
+		else
+		{
+			NSUInteger bytesToCopy = MIN(keyLength - cacheBufferLength, length - offset);
+			
+			memcpy(cacheBuffer + cacheBufferLength, bytes + offset, bytesToCopy);
+			cacheBufferLength += bytesToCopy;
+			offset += bytesToCopy;
+			
+			if (cacheBufferLength < keyLength) {
+				break;
+			}
+			
+			src = cacheBuffer;
+			cacheBufferLength = 0;
+		}
+		
+		BOOL needsSetTweak = NO;
+		if (!TBC_ContextRefIsValid(encryptTBC))
+		{
+			err = TBC_Init([[self class] cipherAlgorithm:encryptionKey], encryptionKey.bytes, keyLength, &encryptTBC); CKS4ERR;
+			needsSetTweak = YES;
+		}
+		else
+		{
+			needsSetTweak = ((totalBytesEncrypted % kZDCNode_TweakBlockSizeInBytes) == 0);
+		}
+		
+		if (needsSetTweak)
+		{
+			uint64_t tweakBlockNum = (uint64_t)(totalBytesEncrypted / kZDCNode_TweakBlockSizeInBytes);
+			uint64_t tweak[2] = {tweakBlockNum, 0};
+			
+			err = TBC_SetTweek(encryptTBC, tweak, sizeof(tweak)); CKS4ERR;
+		}
+		
+		if ((kOutBufferSize - outBufferLength) < keyLength)
+		{
+			error = [self flush];
+			if (error) break;
+		}
+		
+		err = TBC_Encrypt(encryptTBC, src, (outBuffer + outBufferLength)); CKS4ERR;
+		
+		outBufferLength += keyLength;
+		totalBytesEncrypted += keyLength;
+	}
+
+done:
+
+	if (err != kS4Err_NoErr) {
+		error = [NSError errorWithS4Error:err];
+	}
+	
+	return error;
+}
+
+- (NSError *)flush
+{
+	size_t written = 0;
+	while (written < outBufferLength)
+	{
+		ssize_t result = write(fd, outBuffer + written, outBufferLength - written);
+		if (result < 0)
+		{
+			if (errno == EINTR) continue;
+			return [NSError errorWithPOSIXCode:errno];
+		}
+		
+		written += (size_t)result;
+	}
+	
+	outBufferLength = 0;
+	return nil;
+}
+
+@end
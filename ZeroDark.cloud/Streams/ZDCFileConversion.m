@@ -1273,11 +1273,12 @@ done:
 	
 	if (cryptoFile.fileFormat == ZDCCryptoFileFormat_CacheFile)
 	{
-		return [self decryptCacheFile: cryptoFile.fileURL
-		                encryptionKey: cryptoFile.encryptionKey
-		                  retainToken: cryptoFile.retainToken
-		              completionQueue: completionQueue
-		              completionBlock: completionBlock];
+		return [self _decryptCacheFile: cryptoFile.fileURL
+		                     fileRange: cryptoFile.fileRange
+		                 encryptionKey: cryptoFile.encryptionKey
+		                   retainToken: cryptoFile.retainToken
+		               completionQueue: completionQueue
+		               completionBlock: completionBlock];
 	}
 	else if (cryptoFile.fileFormat == ZDCCryptoFileFormat_CloudFile)
 	{
@@ -1316,11 +1317,16 @@ done:
 	
 	if (cryptoFile.fileFormat == ZDCCryptoFileFormat_CacheFile)
 	{
-		return [self decryptCacheFile: cryptoFile.fileURL
-		                encryptionKey: cryptoFile.encryptionKey
-		                  retainToken: cryptoFile.retainToken
-		               toOutputStream: outputStream
-		                        error: outError];
+		NSError *error =
+		  [self _decryptCacheFile: cryptoFile.fileURL
+		                fileRange: cryptoFile.fileRange
+		            encryptionKey: cryptoFile.encryptionKey
+		              retainToken: cryptoFile.retainToken
+		           toOutputStream: outputStream
+		             withProgress: nil];
+		
+		if (outError) *outError = error;
+		return (error == nil);
 	}
 	else if (cryptoFile.fileFormat == ZDCCryptoFileFormat_CloudFile)
 	{
@@ -1347,10 +1353,11 @@ done:
 	
 	if (cryptoFile.fileFormat == ZDCCryptoFileFormat_CacheFile)
 	{
-		return [self decryptCacheFileIntoMemory: cryptoFile.fileURL
-		                          encryptionKey: cryptoFile.encryptionKey
-		                            retainToken: cryptoFile.retainToken
-		                                  error: outError];
+		return [self _decryptCacheFileIntoMemory: cryptoFile.fileURL
+		                               fileRange: cryptoFile.fileRange
+		                           encryptionKey: cryptoFile.encryptionKey
+		                             retainToken: cryptoFile.retainToken
+		                                   error: outError];
 	}
 	else if (cryptoFile.fileFormat == ZDCCryptoFileFormat_CloudFile)
 	{
@@ -1378,11 +1385,12 @@ done:
 	
 	if (cryptoFile.fileFormat == ZDCCryptoFileFormat_CacheFile)
 	{
-		return [self decryptCacheFileIntoMemory: cryptoFile.fileURL
-		                          encryptionKey: cryptoFile.encryptionKey
-		                            retainToken: cryptoFile.retainToken
-		                        completionQueue: completionQueue
-		                        completionBlock: completionBlock];
+		return [self _decryptCacheFileIntoMemory: cryptoFile.fileURL
+		                               fileRange: cryptoFile.fileRange
+		                           encryptionKey: cryptoFile.encryptionKey
+		                             retainToken: cryptoFile.retainToken
+		                         completionQueue: completionQueue
+		                         completionBlock: completionBlock];
 	}
 	else if (cryptoFile.fileFormat == ZDCCryptoFileFormat_CloudFile)
 	{
@@ -1422,6 +1430,21 @@ done:
                      retainToken:(nullable id)retainToken
                  completionQueue:(nullable dispatch_queue_t)completionQueue
                  completionBlock:(void (^)(NSURL *cleartexFileURL, NSError *error))completionBlock
+{
+	return [self _decryptCacheFile: inFileURL
+	                     fileRange: NSMakeRange(NSNotFound, 0)
+	                 encryptionKey: encryptionKey
+	                   retainToken: retainToken
+	               completionQueue: completionQueue
+	               completionBlock: completionBlock];
+}
+
++ (NSProgress *)_decryptCacheFile:(NSURL *)inFileURL
+                        fileRange:(NSRange)fileRange
+                    encryptionKey:(NSData *)encryptionKey
+                      retainToken:(nullable id)retainToken
+                  completionQueue:(nullable dispatch_queue_t)completionQueue
+                  completionBlock:(void (^)(NSURL *cleartexFileURL, NSError *error))completionBlock
 {
 	ZDCLogAutoTrace();
 	
@@ -1494,10 +1517,11 @@ done:
 		// Run decryption
 		
 		error = [self _decryptCacheFile: inFileURL
-		                 encryptionKey: encryptionKey
-		                   retainToken: retainToken
-		                toOutputStream: outStream
-		                  withProgress: nil];
+		                      fileRange: fileRange
+		                  encryptionKey: encryptionKey
+		                    retainToken: retainToken
+		                 toOutputStream: outStream
+		                   withProgress: nil];
 		
 		NotifyAndCleanup(error);
 	}});
@@ -1518,6 +1542,7 @@ done:
 	
 	NSError *error =
 	 [self _decryptCacheFile: inFileURL
+	               fileRange: NSMakeRange(NSNotFound, 0)
 	           encryptionKey: encryptionKey
 	             retainToken: retainToken
 	          toOutputStream: outStream
@@ -1534,6 +1559,19 @@ done:
                                   encryptionKey:(NSData *)encryptionKey
                                     retainToken:(nullable id)retainToken
                                           error:(NSError *_Nullable *_Nullable)outError
+{
+	return [self _decryptCacheFileIntoMemory: inFileURL
+	                               fileRange: NSMakeRange(NSNotFound, 0)
+	                           encryptionKey: encryptionKey
+	                             retainToken: retainToken
+	                                   error: outError];
+}
+
++ (nullable NSData *)_decryptCacheFileIntoMemory:(NSURL *)inFileURL
+                                       fileRange:(NSRange)fileRange
+                                   encryptionKey:(NSData *)encryptionKey
+                                     retainToken:(nullable id)retainToken
+                                           error:(NSError *_Nullable *_Nullable)outError
 {
 	ZDCLogAutoTrace();
 	
@@ -1553,6 +1591,7 @@ done:
 	// Run decryption
 	
 	error = [self _decryptCacheFile: inFileURL
+	                      fileRange: fileRange
 	                  encryptionKey: encryptionKey
 	                    retainToken: retainToken
 	                 toOutputStream: outStream
@@ -1578,6 +1617,21 @@ done:
                                retainToken:(nullable id)retainToken
                            completionQueue:(nullable dispatch_queue_t)completionQueue
                            completionBlock:(void (^)(NSData *_Nullable cleartext, NSError *_Nullable error))completionBlock
+{
+	return [self _decryptCacheFileIntoMemory: inFileURL
+	                               fileRange: NSMakeRange(NSNotFound, 0)
+	                           encryptionKey: encryptionKey
+	                             retainToken: retainToken
+	                         completionQueue: completionQueue
+	                         completionBlock: completionBlock];
+}
+
++ (NSProgress *)_decryptCacheFileIntoMemory:(NSURL *)inFileURL
+                                  fileRange:(NSRange)fileRange
+                              encryptionKey:(NSData *)encryptionKey
+                                retainToken:(nullable id)retainToken
+                            completionQueue:(nullable dispatch_queue_t)completionQueue
+                            completionBlock:(void (^)(NSData *_Nullable cleartext, NSError *_Nullable error))completionBlock
 {
 	ZDCLogAutoTrace();
 	
@@ -1636,10 +1690,11 @@ done:
 		// Run decryption
 		
 		error = [self _decryptCacheFile: inFileURL
+		                      fileRange: fileRange
 		                  encryptionKey: encryptionKey
-		                   retainToken: retainToken
-		                toOutputStream: outStream
-		                  withProgress: nil];
+		                    retainToken: retainToken
+		                 toOutputStream: outStream
+		                   withProgress: nil];
 		
 		NotifyAndCleanup(error);
 	}});
@@ -1648,6 +1703,7 @@ done:
 }
 
 + (nullable NSError *)_decryptCacheFile:(NSURL *)inFileURL
+                              fileRange:(NSRange)fileRange
                           encryptionKey:(NSData *)encryptionKey
                             retainToken:(nullable id)retainToken
                          toOutputStream:(NSOutputStream *)outStream
@@ -1672,9 +1728,25 @@ done:
 	
 	// Instantiate stream(s)
 	
-	inStream = [[CacheFile2CleartextInputStream alloc] initWithCacheFileURL: inFileURL
-	                                                          encryptionKey: encryptionKey];
-	inStream.retainToken = retainToken;
+	if (fileRange.location != NSNotFound)
+	{
+		// The cachefile is packed into a slab (e.g. a small thumbnail).
+		
+		ZDCCryptoFile *cryptoFile =
+		  [[ZDCCryptoFile alloc] initWithFileURL: inFileURL
+		                               fileRange: fileRange
+		                              fileFormat: ZDCCryptoFileFormat_CacheFile
+		                           encryptionKey: encryptionKey
+		                             retainToken: retainToken];
+		
+		inStream = [[CacheFile2CleartextInputStream alloc] initWithCryptoFile:cryptoFile];
+	}
+	else
+	{
+		inStream = [[CacheFile2CleartextInputStream alloc] initWithCacheFileURL: inFileURL
+		                                                          encryptionKey: encryptionKey];
+		inStream.retainToken = retainToken;
+	}
 	
 	if (inStream == nil)
 	{
@@ -1696,9 +1768,16 @@ done:
 	
 	resourceValues = [inFileURL resourceValuesForKeys:keys error:nil];
 	
-	number = resourceValues[NSURLFileSizeKey];
-	if (number != nil) {
-		fileSize = [number unsignedIntegerValue];
+	if (fileRange.location != NSNotFound)
+	{
+		fileSize = fileRange.length;
+	}
+	else
+	{
+		number = resourceValues[NSURLFileSizeKey];
+		if (number != nil) {
+			fileSize = [number unsignedIntegerValue];
+		}
 	}
 	
 	if (progress && fileSize > 0) {
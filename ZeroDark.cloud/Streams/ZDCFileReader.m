@@ -26,6 +26,22 @@
  */
 - (instancetype)initWithCryptoFile:(ZDCCryptoFile *)cryptoFile
 {
+	if (cryptoFile.isPacked)
+	{
+		// Packed files are always in the CacheFile format.
+		// The stream knows how to read from the slab range.
+		
+		if ((self = [super init]))
+		{
+			encryptionKey = [cryptoFile.encryptionKey copy];
+			
+			if (cryptoFile.fileFormat == ZDCCryptoFileFormat_CacheFile) {
+				stream = [[CacheFile2CleartextInputStream alloc] initWithCryptoFile:cryptoFile];
+			}
+		}
+		return self;
+	}
+	
 	return [self initWithFileURL: cryptoFile.fileURL
 	                      format: cryptoFile.fileFormat
 	               encryptionKey: cryptoFile.encryptionKey
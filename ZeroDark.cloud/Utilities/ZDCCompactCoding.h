@@ -0,0 +1,143 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class ZDCCompactEncoder;
+@class ZDCCompactDecoder;
+
+/**
+ * A compact binary alternative to NSCoding.
+ *
+ * NSKeyedArchiver is flexible, but it's slow, and the output is large (every key string is stored in every archive).
+ * This matters for the model classes we store (and read) in large numbers, such as ZDCNode.
+ *
+ * The format is a sequence of tagged fields, similar to protocol buffers:
+ *
+ * - Each field starts with a varint header: (tag << 3) | wireType
+ * - wireType 0 : varint (integers, bools)
+ * - wireType 1 : 8 bytes, little endian (doubles, dates)
+ * - wireType 2 : varint length + bytes (strings, data, nested objects)
+ *
+ * Nil values (and zero integers) are simply omitted.
+ * Unknown tags are skipped by the decoder, so fields can be added without breaking older versions.
+ * And a tag number must never be reused for a different field.
+ */
+@protocol ZDCCompactCoding <NSObject>
+@required
+
+- (void)encodeWithCompactEncoder:(ZDCCompactEncoder *)encoder;
+
+- (nullable instancetype)initWithCompactDecoder:(ZDCCompactDecoder *)decoder;
+
+@end
+
+/**
+ * Writes fields into a buffer.
+ */
+@interface ZDCCompactEncoder : NSObject
+
+/** The encoded fields. */
+@property (nonatomic, readonly) NSData *encodedData;
+
+- (void)encodeUInt64:(uint64_t)value forTag:(uint32_t)tag;
+- (void)encodeBool:(BOOL)value forTag:(uint32_t)tag;
+- (void)encodeDouble:(double)value forTag:(uint32_t)tag;
+
+- (void)encodeDate:(nullable NSDate *)date forTag:(uint32_t)tag;
+- (void)encodeString:(nullable NSString *)string forTag:(uint32_t)tag;
+- (void)encodeData:(nullable NSData *)data forTag:(uint32_t)tag;
+
+/** Encodes a nested object (using its ZDCCompactCoding implementation). */
+- (void)encodeObject:(nullable id<ZDCCompactCoding>)object forTag:(uint32_t)tag;
+
+/**
+ * Encodes a nested object using NSKeyedArchiver.
+ * For values that are rare enough that a compact encoding isn't worth it.
+ */
+- (void)encodeArchivedObject:(nullable id<NSCoding>)object forTag:(uint32_t)tag;
+
+@end
+
+/**
+ * Reads fields from a buffer.
+ *
+ * Typical usage:
+ * ```
+ * uint32_t tag = 0;
+ * while ([decoder nextTag:&tag])
+ * {
+ *   switch (tag)
+ *   {
+ *     case 1  : name = [decoder decodeString]; break;
+ *     default : [decoder skipField]; break;
+ *   }
+ * }
+ * ```
+ */
+@interface ZDCCompactDecoder : NSObject
+
+- (instancetype)initWithData:(NSData *)data;
+
+/**
+ * Moves to the next field.
+ * Returns NO when the end of the buffer is reached (or the buffer is malformed).
+ */
+- (BOOL)nextTag:(uint32_t *)outTag;
+
+/** Set if the buffer is malformed. The decoded object should be discarded. */
+@property (nonatomic, readonly) BOOL hasError;
+
+// Each of these methods consumes the current field.
+// If the field's wireType doesn't match, the field is skipped & a default value is returned.
+
+- (uint64_t)decodeUInt64;
+- (BOOL)decodeBool;
+- (double)decodeDouble;
+
+- (nullable NSDate *)decodeDate;
+- (nullable NSString *)decodeString;
+- (nullable NSData *)decodeData;
+
+- (nullable id)decodeObjectOfClass:(Class)cls;
+- (nullable id)decodeArchivedObject;
+
+- (void)skipField;
+
+@end
+
+/**
+ * Used by the database serializer/deserializer.
+ *
+ * Compact data starts with a 4 byte magic header (which can't be confused with NSKeyedArchiver output),
+ * followed by the class tag & the encoded fields.
+ */
+@interface ZDCCompactSerialization : NSObject
+
+/**
+ * Returns nil if the object's class doesn't support the compact format.
+ * (In which case the caller should fallback to NSKeyedArchiver.)
+ */
++ (nullable NSData *)dataWithObject:(id)object;
+
+/**
+ * Returns YES if the data starts with the compact magic header.
+ */
++ (BOOL)isCompactData:(NSData *)data;
+
+/**
+ * Decodes compact data. Returns nil if the data is malformed.
+ */
++ (nullable id)objectWithData:(NSData *)data;
+
+@end
+
+NS_ASSUME_NONNULL_END
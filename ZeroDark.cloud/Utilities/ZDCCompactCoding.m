@@ -0,0 +1,553 @@
+/**
+ * ZeroDark.cloud Framework
+ *
+ * Homepage      : https://www.zerodark.cloud
+ * GitHub        : https://github.com/4th-ATechnologies/ZeroDark.cloud
+ * Documentation : https://zerodarkcloud.readthedocs.io/en/latest/
+ * API Reference : https://apis.zerodark.cloud
+**/
+
+#import "ZDCCompactCoding.h"
+
+#import "ZDCNode.h"
+#import "ZDCNodeAggregates.h"
+#import "ZDCUser.h"
+
+typedef NS_ENUM(uint8_t, ZDCWireType) {
+	ZDCWireType_Varint  = 0,
+	ZDCWireType_Fixed64 = 1,
+	ZDCWireType_Bytes   = 2,
+};
+
+/**
+ * The magic header is followed by the format version.
+ * NSKeyedArchiver output always starts with "bplist", so there's no ambiguity.
+ */
+static uint8_t const kMagic[3] = { 0xFF, 'Z', 'C' };
+static uint8_t const kFormatVersion = 1;
+
+/**
+ * Class tags for the top-level object.
+ * These values are stored in the database, so they must never change.
+ */
+typedef NS_ENUM(uint64_t, ZDCCompactClassTag) {
+	ZDCCompactClassTag_Node           = 1,
+	ZDCCompactClassTag_User           = 2,
+	ZDCCompactClassTag_NodeAggregates = 3,
+};
+
+@interface ZDCCompactEncoder ()
+- (void)appendBytes:(const void *)bytes length:(NSUInteger)length;
+- (void)writeVarint:(uint64_t)value;
+@end
+
+@interface ZDCCompactDecoder ()
+- (instancetype)initWithData:(NSData *)data range:(NSRange)range;
+- (BOOL)readVarint:(uint64_t *)outValue;
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation ZDCCompactEncoder {
+
+	NSMutableData *buffer;
+}
+
+@dynamic encodedData;
+
+- (instancetype)init
+{
+	if ((self = [super init]))
+	{
+		buffer = [[NSMutableData alloc] initWithCapacity:256];
+	}
+	return self;
+}
+
+- (NSData *)encodedData
+{
+	return buffer;
+}
+
+#pragma mark Primitives
+
+- (void)appendBytes:(const void *)bytes length:(NSUInteger)length
+{
+	[buffer appendBytes:bytes length:length];
+}
+
+- (void)writeVarint:(uint64_t)value
+{
+	uint8_t bytes[10];
+	NSUInteger length = 0;
+	
+	while (value >= 0x80)
+	{
+		bytes[length++] = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	bytes[length++] = (uint8_t)value;
+	
+	[buffer appendBytes:bytes length:length];
+}
+
+- (void)writeTag:(uint32_t)tag wireType:(ZDCWireType)wireType
+{
+	[self writeVarint:(((uint64_t)tag << 3) | wireType)];
+}
+
+- (void)writeFixed64:(uint64_t)value
+{
+	uint64_t littleEndian = CFSwapInt64HostToLittle(value);
+	[buffer appendBytes:&littleEndian length:sizeof(littleEndian)];
+}
+
+#pragma mark Fields
+
+- (void)encodeUInt64:(uint64_t)value forTag:(uint32_t)tag
+{
+	if (value == 0) return;
+	
+	[self writeTag:tag wireType:ZDCWireType_Varint];
+	[self writeVarint:value];
+}
+
+- (void)encodeBool:(BOOL)value forTag:(uint32_t)tag
+{
+	[self encodeUInt64:(value ? 1 : 0) forTag:tag];
+}
+
+- (void)encodeDouble:(double)value forTag:(uint32_t)tag
+{
+	uint64_t bits = 0;
+	memcpy(&bits, &value, sizeof(bits));
+	
+	[self writeTag:tag wireType:ZDCWireType_Fixed64];
+	[self writeFixed64:bits];
+}
+
+- (void)encodeDate:(NSDate *)date forTag:(uint32_t)tag
+{
+	if (date == nil) return;
+	
+	[self encodeDouble:date.timeIntervalSinceReferenceDate forTag:tag];
+}
+
+- (void)encodeString:(NSString *)string forTag:(uint32_t)tag
+{
+	if (string == nil) return;
+	
+	// Avoid creating an intermediate NSData (this is the hot path).
+	// The worst case for UTF-8 is 3 bytes per UTF-16 code unit.
+	
+	NSUInteger maxLength = [string maximumLengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+	uint8_t stackBuffer[256];
+	
+	if (maxLength <= sizeof(stackBuffer))
+	{
+		NSUInteger usedLength = 0;
+		BOOL ok = [string getBytes:stackBuffer
+		                 maxLength:sizeof(stackBuffer)
+		                usedLength:&usedLength
+		                  encoding:NSUTF8StringEncoding
+		                   options:0
+		                     range:NSMakeRange(0, string.length)
+		            remainingRange:NULL];
+		
+		if (ok)
+		{
+			[self writeTag:tag wireType:ZDCWireType_Bytes];
+			[self writeVarint:usedLength];
+			[buffer appendBytes:stackBuffer length:usedLength];
+			return;
+		}
+	}
+	
+	NSData *utf8 = [string dataUsingEncoding:NSUTF8StringEncoding allowLossyConversion:YES];
+	[self encodeData:(utf8 ?: [NSData data]) forTag:tag];
+}
+
+- (void)encodeData:(NSData *)data forTag:(uint32_t)tag
+{
+	if (data == nil) return;
+	
+	[self writeTag:tag wireType:ZDCWireType_Bytes];
+	[self writeVarint:data.length];
+	[buffer appendData:data];
+}
+
+- (void)encodeObject:(id<ZDCCompactCoding>)object forTag:(uint32_t)tag
+{
+	if (object == nil) return;
+	
+	ZDCCompactEncoder *nested = [[ZDCCompactEncoder alloc] init];
+	[object encodeWithCompactEncoder:nested];
+	
+	[self encodeData:nested->buffer forTag:tag];
+}
+
+- (void)encodeArchivedObject:(id<NSCoding>)object forTag:(uint32_t)tag
+{
+	if (object == nil) return;
+	
+	[self encodeData:[NSKeyedArchiver archivedDataWithRootObject:object] forTag:tag];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation ZDCCompactDecoder {
+
+	NSData *data; // retains the bytes
+	const uint8_t *bytes;
+	NSUInteger length;
+	NSUInteger offset;
+	
+	ZDCWireType wireType;
+	BOOL hasField;
+}
+
+@synthesize hasError = hasError;
+
+- (instancetype)initWithData:(NSData *)inData
+{
+	return [self initWithData:inData range:NSMakeRange(0, inData.length)];
+}
+
+- (instancetype)initWithData:(NSData *)inData range:(NSRange)range
+{
+	if ((self = [super init]))
+	{
+		data = inData;
+		bytes = (const uint8_t *)inData.bytes + range.location;
+		length = range.length;
+		offset = 0;
+	}
+	return self;
+}
+
+#pragma mark Primitives
+
+- (BOOL)readVarint:(uint64_t *)outValue
+{
+	uint64_t value = 0;
+	uint32_t shift = 0;
+	
+	while (offset < length && shift < 64)
+	{
+		uint8_t byte = bytes[offset++];
+		value |= ((uint64_t)(byte & 0x7F) << shift);
+		
+		if ((byte & 0x80) == 0)
+		{
+			*outValue = value;
+			return YES;
+		}
+		shift += 7;
+	}
+	
+	hasError = YES;
+	*outValue = 0;
+	return NO;
+}
+
+- (BOOL)readFixed64:(uint64_t *)outValue
+{
+	if (length - offset < sizeof(uint64_t))
+	{
+		hasError = YES;
+		*outValue = 0;
+		return NO;
+	}
+	
+	uint64_t littleEndian = 0;
+	memcpy(&littleEndian, bytes + offset, sizeof(littleEndian));
+	offset += sizeof(littleEndian);
+	
+	*outValue = CFSwapInt64LittleToHost(littleEndian);
+	return YES;
+}
+
+/**
+ * Reads the length prefix of a ZDCWireType_Bytes field,
+ * and returns the range of the bytes (relative to the underlying data).
+ */
+- (BOOL)readBytesRange:(NSRange *)outRange
+{
+	uint64_t bytesLength = 0;
+	if (![self readVarint:&bytesLength]) return NO;
+	
+	if (bytesLength > (length - offset))
+	{
+		hasError = YES;
+		return NO;
+	}
+	
+	NSUInteger base = (NSUInteger)(bytes - (const uint8_t *)data.bytes);
+	*outRange = NSMakeRange(base + offset, (NSUInteger)bytesLength);
+	
+	offset += (NSUInteger)bytesLength;
+	return YES;
+}
+
+/**
+ * Returns NO (and skips the field) if the current field doesn't have the expected wireType.
+ */
+- (BOOL)beginField:(ZDCWireType)expectedWireType
+{
+	if (!hasField) return NO;
+	hasField = NO;
+	
+	if (wireType != expectedWireType)
+	{
+		hasField = YES;
+		[self skipField];
+		return NO;
+	}
+	
+	return YES;
+}
+
+#pragma mark Fields
+
+- (BOOL)nextTag:(uint32_t *)outTag
+{
+	if (hasField) {
+		[self skipField]; // previous field wasn't consumed
+	}
+	
+	if (hasError || offset >= length) return NO;
+	
+	uint64_t header = 0;
+	if (![self readVarint:&header]) return NO;
+	
+	uint64_t tag = (header >> 3);
+	wireType = (ZDCWireType)(header & 0x07);
+	
+	if (tag == 0 || tag > UINT32_MAX || wireType > ZDCWireType_Bytes)
+	{
+		hasError = YES;
+		return NO;
+	}
+	
+	hasField = YES;
+	if (outTag) *outTag = (uint32_t)tag;
+	return YES;
+}
+
+- (uint64_t)decodeUInt64
+{
+	if (![self beginField:ZDCWireType_Varint]) return 0;
+	
+	uint64_t value = 0;
+	[self readVarint:&value];
+	return value;
+}
+
+- (BOOL)decodeBool
+{
+	return ([self decodeUInt64] != 0);
+}
+
+- (double)decodeDouble
+{
+	if (![self beginField:ZDCWireType_Fixed64]) return 0.0;
+	
+	uint64_t bits = 0;
+	[self readFixed64:&bits];
+	
+	double value = 0.0;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+- (NSDate *)decodeDate
+{
+	if (!hasField || wireType != ZDCWireType_Fixed64)
+	{
+		[self skipField];
+		return nil;
+	}
+	
+	return [NSDate dateWithTimeIntervalSinceReferenceDate:[self decodeDouble]];
+}
+
+- (NSString *)decodeString
+{
+	if (![self beginField:ZDCWireType_Bytes]) return nil;
+	
+	NSRange range;
+	if (![self readBytesRange:&range]) return nil;
+	
+	return [[NSString alloc] initWithBytes:((const uint8_t *)data.bytes + range.location)
+	                                length:range.length
+	                              encoding:NSUTF8StringEncoding];
+}
+
+- (NSData *)decodeData
+{
+	if (![self beginField:ZDCWireType_Bytes]) return nil;
+	
+	NSRange range;
+	if (![self readBytesRange:&range]) return nil;
+	
+	return [data subdataWithRange:range];
+}
+
+- (id)decodeObjectOfClass:(Class)cls
+{
+	if (![self beginField:ZDCWireType_Bytes]) return nil;
+	
+	NSRange range;
+	if (![self readBytesRange:&range]) return nil;
+	
+	if (![cls conformsToProtocol:@protocol(ZDCCompactCoding)]) return nil;
+	
+	ZDCCompactDecoder *nested = [[ZDCCompactDecoder alloc] initWithData:data range:range];
+	id object = [[cls alloc] initWithCompactDecoder:nested];
+	
+	if (nested->hasError)
+	{
+		hasError = YES;
+		return nil;
+	}
+	
+	return object;
+}
+
+- (id)decodeArchivedObject
+{
+	NSData *archive = [self decodeData];
+	if (archive == nil) return nil;
+	
+	id object = nil;
+	@try {
+		object = [NSKeyedUnarchiver unarchiveObjectWithData:archive];
+	}
+	@catch (NSException *exception) {}
+	
+	return object;
+}
+
+- (void)skipField
+{
+	if (!hasField) return;
+	hasField = NO;
+	
+	switch (wireType)
+	{
+		case ZDCWireType_Varint:
+		{
+			uint64_t ignored = 0;
+			[self readVarint:&ignored];
+			break;
+		}
+		case ZDCWireType_Fixed64:
+		{
+			uint64_t ignored = 0;
+			[self readFixed64:&ignored];
+			break;
+		}
+		case ZDCWireType_Bytes:
+		{
+			NSRange ignored;
+			[self readBytesRange:&ignored];
+			break;
+		}
+	}
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation ZDCCompactSerialization
+
+/**
+ * Only exact class matches are supported.
+ * Subclasses (e.g. ZDCTrunkNode, ZDCLocalUser) have their own properties,
+ * so they continue to use NSKeyedArchiver.
+ */
++ (ZDCCompactClassTag)classTagForObject:(id)object
+{
+	Class cls = [object class];
+	
+	if (cls == [ZDCNode class])           return ZDCCompactClassTag_Node;
+	if (cls == [ZDCUser class])           return ZDCCompactClassTag_User;
+	if (cls == [ZDCNodeAggregates class]) return ZDCCompactClassTag_NodeAggregates;
+	
+	return 0;
+}
+
++ (Class)classForClassTag:(uint64_t)classTag
+{
+	switch (classTag)
+	{
+		case ZDCCompactClassTag_Node           : return [ZDCNode class];
+		case ZDCCompactClassTag_User           : return [ZDCUser class];
+		case ZDCCompactClassTag_NodeAggregates : return [ZDCNodeAggregates class];
+		default                                : return nil;
+	}
+}
+
++ (NSData *)dataWithObject:(id)object
+{
+	ZDCCompactClassTag classTag = [self classTagForObject:object];
+	if (classTag == 0) return nil;
+	
+	if (![object conformsToProtocol:@protocol(ZDCCompactCoding)]) return nil;
+	
+	ZDCCompactEncoder *encoder = [[ZDCCompactEncoder alloc] init];
+	[encoder appendBytes:kMagic length:sizeof(kMagic)];
+	[encoder appendBytes:&kFormatVersion length:sizeof(kFormatVersion)];
+	[encoder writeVarint:classTag];
+	
+	[(id<ZDCCompactCoding>)object encodeWithCompactEncoder:encoder];
+	
+	return encoder.encodedData;
+}
+
++ (BOOL)isCompactData:(NSData *)data
+{
+	if (data.length < (sizeof(kMagic) + 1)) return NO;
+	
+	return (memcmp(data.bytes, kMagic, sizeof(kMagic)) == 0);
+}
+
++ (id)objectWithData:(NSData *)data
+{
+	if (![self isCompactData:data]) return nil;
+	
+	const uint8_t *bytes = (const uint8_t *)data.bytes;
+	uint8_t formatVersion = bytes[sizeof(kMagic)];
+	
+	if (formatVersion != kFormatVersion)
+	{
+		// Written by a newer version of the framework (that changed the format in an incompatible way).
+		return nil;
+	}
+	
+	NSUInteger headerLength = sizeof(kMagic) + 1;
+	ZDCCompactDecoder *decoder =
+	  [[ZDCCompactDecoder alloc] initWithData:data range:NSMakeRange(headerLength, data.length - headerLength)];
+	
+	uint64_t classTag = 0;
+	if (![decoder readVarint:&classTag]) return nil;
+	
+	Class cls = [self classForClassTag:classTag];
+	if (![cls conformsToProtocol:@protocol(ZDCCompactCoding)]) return nil;
+	
+	id object = [[cls alloc] initWithCompactDecoder:decoder];
+	if (decoder.hasError) return nil;
+	
+	return object;
+}
+
+@end
@@ -14,7 +14,10 @@
 #import "ZDCCloudPathManager.h"
 #import "ZDCDatabaseManager.h"
 #import "ZDCLogging.h"
+#import "ZDCNamingConflictIndex.h"
+#import "ZDCNodeAggregator.h"
 #import "ZDCNodeManager.h"
+#import "ZDCNodePathCache.h"
 #import "ZDCNodePrivate.h"
 
 #import "NSData+S4.h"
@@ -38,7 +41,10 @@
 @end
 
 
-@implementation ZDCCloudTransaction
+@implementation ZDCCloudTransaction {
+	
+	NSMutableDictionary<NSString*, NSNumber*> *downloadStatusChanges;
+}
 
 - (NSString *)localUserID
 {
@@ -2375,6 +2381,8 @@
 	
 	NSString *key = [self internalTaggingKeyForNodeID:nodeID];
 	[self setTag:@(components) forKey:key withIdentifier:nil];
+	
+	[self didChangeDownloadStatus:(components & ZDCNodeComponents_All) forNodeID:nodeID];
 }
 
 /**
@@ -2453,7 +2461,43 @@
 		else {
 			[self setTag:@(newComponents) forKey:key withIdentifier:nil];
 		}
+		
+		if (newComponents != existingComponents) {
+			[self didChangeDownloadStatus:newComponents forNodeID:nodeID];
+		}
+	}
+}
+
+/**
+ * Records the new status, and posts a ZDCNodeDownloadStatusChangedNotification once the transaction completes.
+ * This allows in-memory caches (e.g. the ImageManager) to track the status without a database read.
+ */
+- (void)didChangeDownloadStatus:(ZDCNodeComponents)components forNodeID:(NSString *)nodeID
+{
+	if (downloadStatusChanges == nil)
+	{
+		downloadStatusChanges = [[NSMutableDictionary alloc] init];
+		
+		NSDictionary *changes = downloadStatusChanges;
+		
+		__unsafe_unretained YapDatabaseReadWriteTransaction *rwTransaction =
+		  (YapDatabaseReadWriteTransaction *)databaseTransaction;
+		
+		dispatch_queue_t bgQueue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+		
+		[rwTransaction addCompletionQueue:bgQueue completionBlock:^{
+			
+			NSDictionary *userInfo = @{
+				ZDCNodeDownloadStatusChangedNotification_UserInfo_Changes: [changes copy]
+			};
+			
+			[[NSNotificationCenter defaultCenter] postNotificationName: ZDCNodeDownloadStatusChangedNotification
+			                                                    object: nil
+			                                                  userInfo: userInfo];
+		}];
 	}
+	
+	downloadStatusChanges[nodeID] = @(components);
 }
 
 /**
@@ -3834,6 +3878,7 @@
 	if ([operation isKindOfClass:[ZDCCloudOperation class]])
 	{
 		[self maybeDeleteDetachedNodes:(ZDCCloudOperation *)operation];
+		[self updateNodeAggregatesForOperation:(ZDCCloudOperation *)operation added:NO];
 	}
 }
 
@@ -3842,6 +3887,39 @@
 	if ([operation isKindOfClass:[ZDCCloudOperation class]])
 	{
 		[self maybeDeleteDetachedNodes:(ZDCCloudOperation *)operation];
+		[self updateNodeAggregatesForOperation:(ZDCCloudOperation *)operation added:NO];
+	}
+}
+
+/**
+ * Overrides YapDatabaseCloudCoreTransaction.
+ */
+- (BOOL)addOperation:(YapDatabaseCloudCoreOperation *)operation
+{
+	BOOL result = [super addOperation:operation];
+	
+	if (result && [operation isKindOfClass:[ZDCCloudOperation class]])
+	{
+		[self updateNodeAggregatesForOperation:(ZDCCloudOperation *)operation added:YES];
+	}
+	
+	return result;
+}
+
+/**
+ * The node aggregates include the number of queued data uploads (see ZDCNodeAggregator).
+ */
+- (void)updateNodeAggregatesForOperation:(ZDCCloudOperation *)op added:(BOOL)added
+{
+	if (!op.isPutNodeDataOperation || op.nodeID == nil) return;
+	
+	YapDatabaseReadWriteTransaction *rwTransaction = (YapDatabaseReadWriteTransaction *)databaseTransaction;
+	
+	if (added) {
+		[ZDCNodeAggregator didAddUploadOperation:op.uuid forNodeID:op.nodeID transaction:rwTransaction];
+	}
+	else {
+		[ZDCNodeAggregator didRemoveUploadOperation:op.uuid transaction:rwTransaction];
 	}
 }
 
@@ -3849,6 +3927,58 @@
 #pragma mark Transaction Hooks
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * The ZDCNodeManager caches path resolution (see ZDCNodePathCache).
+ * Modified nodes may invalidate entries in the cache.
+ *
+ * Note: Inserted nodes don't affect the cache, since it doesn't store negative results.
+ */
+- (void)pathCacheDidUpdateNode:(ZDCNode *)node
+{
+	YapDatabaseReadWriteTransaction *rwTransaction = (YapDatabaseReadWriteTransaction *)databaseTransaction;
+	
+	[[ZDCNodePathCache existingCacheForTransaction:rwTransaction] didUpdateNode:node transaction:rwTransaction];
+}
+
+- (void)pathCacheDidRemoveNodeID:(NSString *)nodeID
+{
+	YapDatabaseReadWriteTransaction *rwTransaction = (YapDatabaseReadWriteTransaction *)databaseTransaction;
+	
+	[[ZDCNodePathCache existingCacheForTransaction:rwTransaction] didRemoveNodeID:nodeID transaction:rwTransaction];
+}
+
+/**
+ * The ZDCNodeManager remembers the highest "name N.ext" in use by siblings (see ZDCNamingConflictIndex).
+ * Inserted, modified & removed nodes may affect those entries.
+ */
+- (void)namingIndexDidUpdateNode:(ZDCNode *)node
+{
+	YapDatabaseReadWriteTransaction *rwTransaction = (YapDatabaseReadWriteTransaction *)databaseTransaction;
+	
+	[[ZDCNamingConflictIndex existingIndexForTransaction:rwTransaction] didUpdateNode:node transaction:rwTransaction];
+}
+
+- (void)namingIndexDidRemoveNodeID:(NSString *)nodeID
+{
+	YapDatabaseReadWriteTransaction *rwTransaction = (YapDatabaseReadWriteTransaction *)databaseTransaction;
+	
+	[[ZDCNamingConflictIndex existingIndexForTransaction:rwTransaction] didRemoveNodeID:nodeID
+	                                                                       transaction:rwTransaction];
+}
+
+/**
+ * YapDatabaseExtensionTransaction Hook, invoked after the read-write transaction has been committed.
+ * (Not invoked if the transaction is rolled back.)
+ */
+- (void)didCommitTransaction
+{
+	YapDatabaseReadWriteTransaction *rwTransaction = (YapDatabaseReadWriteTransaction *)databaseTransaction;
+	
+	[[ZDCNamingConflictIndex existingIndexForTransaction:rwTransaction] didCommitTransaction:rwTransaction];
+	
+	[super didCommitTransaction];
+}
+
 /**
  * YapDatabaseReadWriteTransaction Hook, invoked post-op.
  *
@@ -3867,6 +3997,11 @@
 	ZDCLogAutoTrace();
 	
 	[super didInsertObject:object forCollectionKey:collectionKey withMetadata:metadata rowid:rowid];
+	
+	if ([object isKindOfClass:[ZDCNode class]])
+	{
+		[self namingIndexDidUpdateNode:(ZDCNode *)object];
+	}
 }
 
 /**
@@ -3887,6 +4022,12 @@
 	ZDCLogAutoTrace();
 	
 	[super didUpdateObject:object forCollectionKey:collectionKey withMetadata:metadata rowid:rowid];
+	
+	if ([object isKindOfClass:[ZDCNode class]])
+	{
+		[self pathCacheDidUpdateNode:(ZDCNode *)object];
+		[self namingIndexDidUpdateNode:(ZDCNode *)object];
+	}
 }
 
 /**
@@ -3903,6 +4044,12 @@
 	ZDCLogAutoTrace();
 	
 	[super didReplaceObject:object forCollectionKey:collectionKey withRowid:rowid];
+	
+	if ([object isKindOfClass:[ZDCNode class]])
+	{
+		[self pathCacheDidUpdateNode:(ZDCNode *)object];
+		[self namingIndexDidUpdateNode:(ZDCNode *)object];
+	}
 }
 
 /**
@@ -3928,6 +4075,9 @@
 		
 		[self removeAllTagsForKey:nodeID];
 		[self removeAllTagsForKey:internalKey];
+		
+		[self pathCacheDidRemoveNodeID:nodeID];
+		[self namingIndexDidRemoveNodeID:nodeID];
 	}
 }
 
@@ -3968,6 +4118,9 @@
 			
 			[self removeAllTagsForKey:nodeID];
 			[self removeAllTagsForKey:internalKey];
+			
+			[self pathCacheDidRemoveNodeID:nodeID];
+			[self namingIndexDidRemoveNodeID:nodeID];
 		}
 	}
 }